@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Compares two runs of neuroh5_microbench.
+
+Both inputs are JSON reports written with
+
+    neuroh5_microbench --benchmark_out=<file> --benchmark_repetitions=<n>
+
+With repetitions, the median of each benchmark is compared; otherwise
+the single measurement is. Prints the ratio of the contender to the
+baseline time for each benchmark and exits with status 1 if any
+benchmark is slower than the baseline by more than the threshold.
+"""
+
+import argparse
+import json
+import statistics
+import sys
+
+
+def load_times(path, metric):
+    with open(path) as f:
+        report = json.load(f)
+    samples = {}
+    for bm in report["benchmarks"]:
+        if bm.get("run_type", "iteration") != "iteration":
+            continue
+        name = bm.get("run_name", bm["name"])
+        samples.setdefault(name, []).append(bm[metric])
+    return {name: statistics.median(values) for name, values in samples.items()}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="JSON report of the baseline run")
+    parser.add_argument("contender", help="JSON report of the run to compare")
+    parser.add_argument("--metric", choices=["real_time", "cpu_time"], default="cpu_time",
+                        help="time to compare (default: cpu_time)")
+    parser.add_argument("--threshold", type=float, default=0.05,
+                        help="relative slowdown reported as a regression (default: 0.05)")
+    args = parser.parse_args()
+
+    baseline = load_times(args.baseline, args.metric)
+    contender = load_times(args.contender, args.metric)
+
+    width = max([len(name) for name in baseline] + [len("benchmark")])
+    print("%-*s %14s %14s %8s" % (width, "benchmark", "baseline", "contender", "ratio"))
+    regressions = []
+    for name in sorted(set(baseline) | set(contender)):
+        if name not in baseline or name not in contender:
+            print("%-*s %14s" % (width, name,
+                                 "only in " + ("baseline" if name in baseline else "contender")))
+            continue
+        ratio = contender[name] / baseline[name] if baseline[name] > 0 else float("inf")
+        flag = ""
+        if ratio > 1.0 + args.threshold:
+            flag = "  slower"
+            regressions.append(name)
+        elif ratio < 1.0 - args.threshold:
+            flag = "  faster"
+        print("%-*s %14.4g %14.4g %8.3f%s" % (width, name, baseline[name], contender[name], ratio, flag))
+
+    if regressions:
+        print("\n%d benchmark(s) slower than the baseline by more than %.0f%%"
+              % (len(regressions), 100 * args.threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
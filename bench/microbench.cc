@@ -0,0 +1,400 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file microbench.cc
+///
+///  Microbenchmarks of the in-memory hot paths of the readers and
+///  writers: rank partitioning of edges, trees and cell attributes,
+///  their serialization, attribute map insertion, permutation sorting
+///  and tree validation. The inputs are synthetic and built in memory,
+///  so no MPI launch or HDF5 file is needed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "path_names.hh"
+#include "attr_map.hh"
+#include "attr_val.hh"
+#include "append_rank_edge_map.hh"
+#include "append_rank_attr_map.hh"
+#include "append_rank_tree_map.hh"
+#include "serialize_edge.hh"
+#include "serialize_cell_attributes.hh"
+#include "sort_permutation.hh"
+#include "contract_tree.hh"
+#include "validate_tree.hh"
+
+#include <benchmark/benchmark.h>
+#include <hdf5.h>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace neuroh5;
+
+namespace
+{
+  // number of ranks that cells are partitioned to
+  const size_t num_ranks = 16;
+
+  node_rank_map_t round_robin_rank_map (const size_t num_cells)
+  {
+    node_rank_map_t node_rank_map;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        node_rank_map[gid].insert(gid % num_ranks);
+      }
+    return node_rank_map;
+  }
+
+  /// A projection in DBS format with a single destination block, random
+  /// sources and one float edge attribute.
+  struct synth_projection_t
+  {
+    vector<DST_BLK_PTR_T> dst_blk_ptr;
+    vector<NODE_IDX_T>    dst_idx;
+    vector<DST_PTR_T>     dst_ptr;
+    vector<NODE_IDX_T>    src_idx;
+    vector<string>        attr_namespaces;
+    map<string, data::NamedAttrVal> edge_attr_map;
+    node_rank_map_t       node_rank_map;
+
+    synth_projection_t (const size_t num_dst, const size_t degree)
+    {
+      mt19937 gen(num_dst * degree);
+      uniform_int_distribution<NODE_IDX_T> src_dist(0, num_dst - 1);
+      uniform_real_distribution<float> weight_dist(0.0f, 1.0f);
+
+      dst_blk_ptr = { 0, (DST_BLK_PTR_T)num_dst };
+      dst_idx = { 0 };
+      dst_ptr.push_back(0);
+      vector<float> weights;
+      for (size_t i = 0; i < num_dst; i++)
+        {
+          for (size_t k = 0; k < degree; k++)
+            {
+              src_idx.push_back(src_dist(gen));
+              weights.push_back(weight_dist(gen));
+            }
+          dst_ptr.push_back(src_idx.size());
+        }
+      attr_namespaces.push_back("Synapses");
+      edge_attr_map["Synapses"].insert(string("weight"), weights);
+      node_rank_map = round_robin_rank_map(num_dst);
+    }
+
+    void append_rank_edge_map (rank_edge_map_t& rank_edge_map) const
+    {
+      size_t num_edges = 0;
+      data::append_rank_edge_map(0, num_ranks, 0, 0, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                 attr_namespaces, edge_attr_map, node_rank_map,
+                                 num_edges, rank_edge_map, EdgeMapDst);
+    }
+  };
+
+  /// Cell attributes with one float and one uint32 attribute per cell.
+  data::NamedAttrMap synth_attr_map (const size_t num_cells, const size_t attr_len)
+  {
+    vector<CELL_IDX_T> cell_index;
+    vector<ATTR_PTR_T> ptr(1, 0);
+    vector<float> float_values;
+    vector<uint32_t> uint32_values;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        cell_index.push_back(gid);
+        for (size_t i = 0; i < attr_len; i++)
+          {
+            float_values.push_back(gid + 0.5f * i);
+            uint32_values.push_back(gid + i);
+          }
+        ptr.push_back(float_values.size());
+      }
+    data::NamedAttrMap attr_map;
+    attr_map.insert(string("x"), cell_index, ptr, float_values);
+    attr_map.insert(string("index"), cell_index, ptr, uint32_values);
+    return attr_map;
+  }
+
+  /// A random tree in which each point continues the branch of the
+  /// previous point or, with probability 0.1, starts a new branch.
+  neurotree_t synth_tree (mt19937& gen, const CELL_IDX_T gid, const size_t num_points)
+  {
+    uniform_real_distribution<float> u(0.0f, 1.0f);
+    deque<PARENT_NODE_IDX_T> parents;
+    deque<SWC_TYPE_T> swc_types;
+    deque<COORD_T> xcoords, ycoords, zcoords;
+    deque<REALVAL_T> radiuses;
+    deque<LAYER_IDX_T> layers;
+    for (size_t i = 0; i < num_points; i++)
+      {
+        PARENT_NODE_IDX_T parent = -1;
+        if (i > 0)
+          {
+            parent = i - 1;
+            if (u(gen) < 0.1f)
+              {
+                uniform_int_distribution<size_t> branch_dist(0, i - 1);
+                parent = branch_dist(gen);
+              }
+          }
+        parents.push_back(parent);
+        swc_types.push_back(i == 0 ? 1 : 3);
+        xcoords.push_back(u(gen));
+        ycoords.push_back(u(gen));
+        zcoords.push_back(u(gen));
+        radiuses.push_back(1.0f);
+        layers.push_back(0);
+      }
+    deque<SECTION_IDX_T> src_vector, dst_vector, sec_vector;
+    cell::contract_tree(parents, swc_types, NULL, 0, src_vector, dst_vector, sec_vector);
+    return make_tuple(gid, src_vector, dst_vector, sec_vector, xcoords, ycoords, zcoords,
+                      radiuses, layers, parents, swc_types);
+  }
+
+  template <class T>
+  void insert_tree_column (data::NamedAttrMap& attr_map, const string& name,
+                           const CELL_IDX_T gid, const deque<T>& values)
+  {
+    attr_map.AttrMap::insert(attr_map.insert_name<T>(name), gid, values);
+  }
+
+  /// Tree attributes in the layout returned by the tree readers.
+  data::NamedAttrMap synth_tree_attr_map (const size_t num_trees, const size_t num_points)
+  {
+    mt19937 gen(num_trees);
+    data::NamedAttrMap attr_map;
+    for (CELL_IDX_T gid = 0; gid < num_trees; gid++)
+      {
+        const neurotree_t tree = synth_tree(gen, gid, num_points);
+        insert_tree_column(attr_map, hdf5::SRCSEC, gid, get<1>(tree));
+        insert_tree_column(attr_map, hdf5::DSTSEC, gid, get<2>(tree));
+        insert_tree_column(attr_map, hdf5::SECTION, gid, get<3>(tree));
+        insert_tree_column(attr_map, hdf5::X_COORD, gid, get<4>(tree));
+        insert_tree_column(attr_map, hdf5::Y_COORD, gid, get<5>(tree));
+        insert_tree_column(attr_map, hdf5::Z_COORD, gid, get<6>(tree));
+        insert_tree_column(attr_map, hdf5::RADIUS, gid, get<7>(tree));
+        insert_tree_column(attr_map, hdf5::LAYER, gid, get<8>(tree));
+        insert_tree_column(attr_map, hdf5::PARENT, gid, get<9>(tree));
+        insert_tree_column(attr_map, hdf5::SWCTYPE, gid, get<10>(tree));
+      }
+    return attr_map;
+  }
+}
+
+
+static void BM_append_rank_edge_map (benchmark::State& state)
+{
+  const synth_projection_t prj(state.range(0), state.range(1));
+  for (auto _ : state)
+    {
+      rank_edge_map_t rank_edge_map;
+      prj.append_rank_edge_map(rank_edge_map);
+      benchmark::DoNotOptimize(rank_edge_map);
+    }
+  state.SetItemsProcessed(state.iterations() * prj.src_idx.size());
+}
+BENCHMARK(BM_append_rank_edge_map)->Args({10000, 100})->Args({100000, 10})->Unit(benchmark::kMillisecond);
+
+
+static void BM_serialize_rank_edge_map (benchmark::State& state)
+{
+  const synth_projection_t prj(state.range(0), state.range(1));
+  rank_edge_map_t rank_edge_map;
+  prj.append_rank_edge_map(rank_edge_map);
+  size_t bytes = 0;
+  for (auto _ : state)
+    {
+      size_t num_packed_edges = 0;
+      vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+      vector<char> sendbuf;
+      data::serialize_rank_edge_map(num_ranks, 0, rank_edge_map, num_packed_edges,
+                                    sendcounts, sendbuf, sdispls);
+      benchmark::DoNotOptimize(sendbuf.data());
+      bytes += sendbuf.size();
+    }
+  state.SetItemsProcessed(state.iterations() * prj.src_idx.size());
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_serialize_rank_edge_map)->Args({10000, 100})->Args({100000, 10})->Unit(benchmark::kMillisecond);
+
+
+static void BM_deserialize_rank_edge_map (benchmark::State& state)
+{
+  const synth_projection_t prj(state.range(0), state.range(1));
+  rank_edge_map_t rank_edge_map;
+  prj.append_rank_edge_map(rank_edge_map);
+  size_t num_packed_edges = 0;
+  vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+  vector<char> sendbuf;
+  data::serialize_rank_edge_map(num_ranks, 0, rank_edge_map, num_packed_edges,
+                                sendcounts, sendbuf, sdispls);
+  for (auto _ : state)
+    {
+      edge_map_t edge_map;
+      size_t num_unpacked_nodes = 0, num_unpacked_edges = 0;
+      data::deserialize_rank_edge_map(num_ranks, sendbuf, sendcounts, sdispls, edge_map,
+                                      num_unpacked_nodes, num_unpacked_edges);
+      benchmark::DoNotOptimize(edge_map);
+    }
+  state.SetItemsProcessed(state.iterations() * prj.src_idx.size());
+  state.SetBytesProcessed(state.iterations() * sendbuf.size());
+}
+BENCHMARK(BM_deserialize_rank_edge_map)->Args({10000, 100})->Args({100000, 10})->Unit(benchmark::kMillisecond);
+
+
+static void BM_append_rank_attr_map (benchmark::State& state)
+{
+  const data::NamedAttrMap attr_map = synth_attr_map(state.range(0), state.range(1));
+  const node_rank_map_t node_rank_map = round_robin_rank_map(state.range(0));
+  for (auto _ : state)
+    {
+      map <rank_t, data::AttrMap> rank_attr_map;
+      data::append_rank_attr_map(attr_map, node_rank_map, rank_attr_map);
+      benchmark::DoNotOptimize(rank_attr_map);
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_append_rank_attr_map)->Args({100000, 3})->Args({10000, 100})->Unit(benchmark::kMillisecond);
+
+
+static void BM_serialize_rank_attr_map (benchmark::State& state)
+{
+  const data::NamedAttrMap attr_map = synth_attr_map(state.range(0), state.range(1));
+  map <rank_t, data::AttrMap> rank_attr_map;
+  data::append_rank_attr_map(attr_map, round_robin_rank_map(state.range(0)), rank_attr_map);
+  size_t bytes = 0;
+  for (auto _ : state)
+    {
+      vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+      vector<char> sendbuf;
+      data::serialize_rank_attr_map(num_ranks, 0, rank_attr_map, sendcounts, sendbuf, sdispls);
+      benchmark::DoNotOptimize(sendbuf.data());
+      bytes += sendbuf.size();
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_serialize_rank_attr_map)->Args({100000, 3})->Args({10000, 100})->Unit(benchmark::kMillisecond);
+
+
+static void BM_deserialize_rank_attr_map (benchmark::State& state)
+{
+  const data::NamedAttrMap attr_map = synth_attr_map(state.range(0), state.range(1));
+  map <rank_t, data::AttrMap> rank_attr_map;
+  data::append_rank_attr_map(attr_map, round_robin_rank_map(state.range(0)), rank_attr_map);
+  vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+  vector<char> sendbuf;
+  data::serialize_rank_attr_map(num_ranks, 0, rank_attr_map, sendcounts, sendbuf, sdispls);
+  for (auto _ : state)
+    {
+      data::NamedAttrMap all_attr_map;
+      all_attr_map.insert_name<float>("x");
+      all_attr_map.insert_name<uint32_t>("index");
+      data::deserialize_rank_attr_map(num_ranks, sendbuf, sendcounts, sdispls, all_attr_map);
+      benchmark::DoNotOptimize(all_attr_map);
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * sendbuf.size());
+}
+BENCHMARK(BM_deserialize_rank_attr_map)->Args({100000, 3})->Args({10000, 100})->Unit(benchmark::kMillisecond);
+
+
+static void BM_AttrMap_insert (benchmark::State& state)
+{
+  const size_t num_cells = state.range(0), attr_len = state.range(1);
+  vector<CELL_IDX_T> cell_index;
+  vector<ATTR_PTR_T> ptr(1, 0);
+  vector<float> values;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      cell_index.push_back(gid);
+      values.insert(values.end(), attr_len, (float)gid);
+      ptr.push_back(values.size());
+    }
+  for (auto _ : state)
+    {
+      data::AttrMap attr_map;
+      attr_map.insert(cell_index, ptr, values);
+      benchmark::DoNotOptimize(attr_map);
+    }
+  state.SetItemsProcessed(state.iterations() * values.size());
+}
+BENCHMARK(BM_AttrMap_insert)->Args({100000, 3})->Args({10000, 100})->Unit(benchmark::kMillisecond);
+
+
+static void BM_append_rank_tree_map (benchmark::State& state)
+{
+  data::NamedAttrMap attr_map = synth_tree_attr_map(state.range(0), state.range(1));
+  const node_rank_map_t node_rank_map = round_robin_rank_map(state.range(0));
+  for (auto _ : state)
+    {
+      map <rank_t, map<CELL_IDX_T, neurotree_t> > rank_tree_map;
+      data::append_rank_tree_map(attr_map, node_rank_map, rank_tree_map);
+      benchmark::DoNotOptimize(rank_tree_map);
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_append_rank_tree_map)->Args({1000, 100})->Args({100, 2000})->Unit(benchmark::kMillisecond);
+
+
+static void BM_sort_permutation (benchmark::State& state)
+{
+  // value ranges as sorted by the selection readers
+  mt19937 gen(state.range(0));
+  uniform_int_distribution<hsize_t> dist(0, 1000 * state.range(0));
+  vector< pair<hsize_t, hsize_t> > ranges(state.range(0));
+  for (auto& range : ranges)
+    {
+      range = make_pair(dist(gen), 10);
+    }
+  auto compare_range_idx = [](const pair<hsize_t, hsize_t>& a, const pair<hsize_t, hsize_t>& b)
+    { return (a.first < b.first); };
+  for (auto _ : state)
+    {
+      vector<size_t> p = data::sort_permutation(ranges, compare_range_idx);
+      benchmark::DoNotOptimize(p.data());
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_sort_permutation)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+
+static void BM_apply_permutation_in_place (benchmark::State& state)
+{
+  mt19937 gen(state.range(0));
+  vector<size_t> p(state.range(0));
+  iota(p.begin(), p.end(), 0);
+  shuffle(p.begin(), p.end(), gen);
+  vector<CELL_IDX_T> values(state.range(0));
+  iota(values.begin(), values.end(), 0);
+  for (auto _ : state)
+    {
+      data::apply_permutation_in_place(values, p);
+      benchmark::DoNotOptimize(values.data());
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_apply_permutation_in_place)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+
+static void BM_validate_tree (benchmark::State& state)
+{
+  mt19937 gen(state.range(0));
+  const neurotree_t tree = synth_tree(gen, 0, state.range(0));
+  cell::tree_workspace_t ws;
+  for (auto _ : state)
+    {
+      cell::validate_tree(tree, ws);
+    }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_validate_tree)->Arg(100)->Arg(10000)->Unit(benchmark::kMicrosecond);
+
+
+BENCHMARK_MAIN();
@@ -6,10 +6,13 @@
 #include <forward_list>
 
 #include "neuroh5_types.hh"
+#include "tree_template_set.hh"
 #include "cell_index.hh"
 #include "cell_attributes.hh"
 #include "compact_optional.hh"
 #include "optional_value.hh"
+#include "thread_pool.hh"
+#include "path_names.hh"
 #include "throw_assert.hh"
 
 namespace neuroh5
@@ -37,7 +40,9 @@ namespace neuroh5
      std::vector<LAYER_IDX_T>& all_layers,        // Layer
      std::vector<SECTION_IDX_T>& all_sections,    // Section
      std::vector<PARENT_NODE_IDX_T>& all_parents, // Parent
-     std::vector<SWC_TYPE_T>& all_swc_types // SWC Types
+     std::vector<SWC_TYPE_T>& all_swc_types, // SWC Types
+     // if not NULL, the trees are copied on the threads of pool
+     data::thread_pool* pool = NULL
      );
     
     int build_singleton_tree_datasets
@@ -73,7 +78,8 @@ namespace neuroh5
      const set<size_t>              &io_rank_set,
      CellPtr ptr_type = CellPtr(PtrOwner),
      const size_t chunk_size = 4000,
-     const size_t value_chunk_size = 4000
+     const size_t value_chunk_size = 4000,
+     const std::string& name_space = hdf5::TREES
      );
 
     int append_trees
@@ -85,6 +91,38 @@ namespace neuroh5
      std::forward_list<neurotree_t> &tree_list,
      size_t io_size,
      const size_t chunk_size = 4000,
+     const size_t value_chunk_size = 4000,
+     const std::string& name_space = hdf5::TREES
+     );
+
+    /*****************************************************************************
+     * Save morphology templates to HDF5. The id of each template tree
+     * is its template id.
+     *****************************************************************************/
+    int append_tree_templates
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     std::forward_list<neurotree_t> &template_list,
+     size_t io_size,
+     const size_t chunk_size = 4000,
+     const size_t value_chunk_size = 4000
+     );
+
+    /*****************************************************************************
+     * Save the template id and translation of each cell in template_refs
+     * to HDF5; the templates themselves are not written.
+     *****************************************************************************/
+    int append_tree_template_index
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     const data::TreeTemplateSet& template_refs,
+     size_t io_size,
+     const size_t chunk_size = 4000,
      const size_t value_chunk_size = 4000
      );
 
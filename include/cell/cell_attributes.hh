@@ -11,6 +11,8 @@
 #include <mpi.h>
 
 #include "mpe_seq.hh"
+#include "mpi_trace.hh"
+#include "thread_pool.hh"
 #include "neuroh5_types.hh"
 #include "alltoallv_template.hh"
 #include "infer_datatype.hh"
@@ -18,8 +20,10 @@
 #include "path_names.hh"
 #include "hdf5_cell_attributes.hh"
 #include "exists_dataset.hh"
+#include "group_flag.hh"
 #include "file_access.hh"
 #include "attr_map.hh"
+#include "attr_predicate.hh"
 #include "compact_optional.hh"
 #include "optional_value.hh"
 #include "range_sample.hh"
@@ -92,7 +96,9 @@ namespace neuroh5
      const CELL_IDX_T& pop_start,
      data::NamedAttrMap&    attr_values,
      size_t offset = 0,
-     size_t numitems = 0
+     size_t numitems = 0,
+     // decompresses the values; a pool of its own is used if NULL
+     data::thread_pool* pool = NULL
      );
 
     void read_cell_attribute_selection
@@ -117,7 +123,10 @@ namespace neuroh5
      const string& pop_name,
      const CELL_IDX_T& pop_start,
      const std::vector<CELL_IDX_T>&  selection,
-     data::NamedAttrMap& attr_values
+     data::NamedAttrMap& attr_values,
+     // if not empty, only cells and values that match the predicate
+     // are sent by the I/O ranks
+     const data::AttrPredicate& predicate = data::AttrPredicate()
      );
     
     int scatter_read_cell_attributes
@@ -135,7 +144,10 @@ namespace neuroh5
      // if positive, these arguments specify offset and number of entries to read
      // from the entries available to the current rank
      size_t offset   = 0,
-     size_t numitems = 0
+     size_t numitems = 0,
+     // if not empty, only cells and values that match the predicate
+     // are sent by the I/O ranks
+     const data::AttrPredicate& predicate = data::AttrPredicate()
      );
 
     
@@ -242,6 +254,9 @@ namespace neuroh5
                                          chunk_size, value_chunk_size
                                          );
         }
+      // appended cells may precede existing ones
+      throw_assert(hdf5::clear_group_flag(file, attr_prefix, hdf5::SORTED) >= 0,
+                   "append_cell_attribute: unable to clear sorted flag of " << attr_prefix);
 
       vector<CELL_IDX_T> rindex;
 
@@ -539,11 +554,16 @@ namespace neuroh5
     
       if (is_io_rank)
         {
-          append_cell_attribute<T>(file,
-                                   attr_namespace, pop_name, pop_start, attr_name,
-                                   gid_recvbuf, attr_ptr, value_recvbuf,
-                                   data_type, index_type, ptr_type, 
-                                   chunk_size, value_chunk_size, cache_size);
+          {
+            mpi::trace_scope trace("append_cell_attribute_map.write");
+            append_cell_attribute<T>(file,
+                                     attr_namespace, pop_name, pop_start, attr_name,
+                                     gid_recvbuf, attr_ptr, value_recvbuf,
+                                     data_type, index_type, ptr_type, 
+                                     chunk_size, value_chunk_size, cache_size);
+            trace.add_items(value_recvbuf.size());
+            trace.add_bytes(value_recvbuf.size() * sizeof(T));
+          }
         }
 
       if (is_io_rank)
@@ -788,6 +808,9 @@ namespace neuroh5
                                              chunk_size, value_chunk_size
                                              );
             }
+          const string attr_prefix = hdf5::cell_attribute_prefix(attr_namespace, pop_name);
+          throw_assert(hdf5::clear_group_flag(file, attr_prefix, hdf5::SORTED) >= 0,
+                       "write_cell_attribute: unable to clear sorted flag of " << attr_prefix);
           status = H5Fclose(file);
           throw_assert(status == 0, "append_cell_attribute: unable to close HDF5 file");
         }
@@ -990,11 +1013,16 @@ namespace neuroh5
 
       if (is_io_rank)
         {
-          write_cell_attribute<T>(io_comm, file_name,
-                                  attr_namespace, pop_name, pop_start, attr_name,
-                                  gid_recvbuf, attr_ptr, value_recvbuf,
-                                  data_type, index_type, ptr_type, 
-                                  chunk_size, value_chunk_size, cache_size);
+          {
+            mpi::trace_scope trace("write_cell_attribute_map.write");
+            write_cell_attribute<T>(io_comm, file_name,
+                                    attr_namespace, pop_name, pop_start, attr_name,
+                                    gid_recvbuf, attr_ptr, value_recvbuf,
+                                    data_type, index_type, ptr_type, 
+                                    chunk_size, value_chunk_size, cache_size);
+            trace.add_items(value_recvbuf.size());
+            trace.add_bytes(value_recvbuf.size() * sizeof(T));
+          }
         }
       
       throw_assert(MPI_Barrier(io_comm) == MPI_SUCCESS,
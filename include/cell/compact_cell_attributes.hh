@@ -0,0 +1,69 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file compact_cell_attributes.hh
+///
+///  Compaction of cell attribute namespaces: rewrites the attributes of
+///  a namespace sorted by cell index, without duplicate cells and with
+///  chunk sizes chosen from the sizes of the values.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef COMPACT_CELL_ATTRIBUTES_HH
+#define COMPACT_CELL_ATTRIBUTES_HH
+
+#include <mpi.h>
+
+#include <string>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    /// Target size in bytes of the chunks of compacted datasets.
+    const size_t COMPACT_CHUNK_BYTES = 1024*1024;
+
+    /// @brief Rewrites all attributes of a cell attribute namespace in
+    ///        ascending cell index order. Collective on comm.
+    ///
+    /// Namespaces built by many append calls contain the cells in the
+    /// order in which they were appended and may contain the same cell
+    /// more than once; of those entries, the one written last is kept.
+    /// Each attribute is rewritten with its own cell index and
+    /// attribute pointer, with chunks of about chunk_bytes bytes (but
+    /// no larger than the dataset), and the namespace is marked as
+    /// sorted, which allows the selection readers to search the index
+    /// directly and to read the values of consecutive cells as one
+    /// range. The flag is removed by any later append to the
+    /// namespace. The compacted namespace replaces the original one in
+    /// the same file; the space of the original datasets is reclaimed
+    /// only by repacking the file (e.g. with h5repack).
+    ///
+    /// @param comm          MPI communicator
+    ///
+    /// @param file_name     NeuroH5 file
+    ///
+    /// @param name_space    Cell attribute namespace
+    ///
+    /// @param pop_name      Population name
+    ///
+    /// @param chunk_bytes   Target chunk size in bytes
+    ///
+    /// @param cache_size    HDF5 chunk cache size
+    void compact_cell_attributes
+    (
+     MPI_Comm           comm,
+     const std::string& file_name,
+     const std::string& name_space,
+     const std::string& pop_name,
+     const size_t       chunk_bytes = COMPACT_CHUNK_BYTES,
+     const size_t       cache_size = 1*1024*1024
+     );
+
+  }
+}
+
+#endif
@@ -4,7 +4,7 @@
 ///
 ///  Definition for tree contraction routine.
 ///
-///  Copyright (C) 2016-2021 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 #ifndef CONTRACT_TREE_HH
 #define CONTRACT_TREE_HH
@@ -13,34 +13,51 @@
 #include <deque>
 
 #include "neuroh5_types.hh"
-#include "ngraph.hh"
+#include "tree_workspace.hh"
 
 namespace neuroh5
 {
   namespace cell
   {
-    void contract_tree_bfs (const NGraph::Graph &A,
-                            const std::deque<SWC_TYPE_T>& types,
-                            NGraph::Graph::vertex_set& roots,
-                            NGraph::Graph &S, contraction_map_t& contraction_map,
-                            NGraph::Graph::vertex sp, NGraph::Graph::vertex spp);
-    void contract_tree_dfs (const NGraph::Graph &A, 
-                            const std::deque<SWC_TYPE_T>& types,
-                            NGraph::Graph::vertex_set& roots,
-                            NGraph::Graph &S, contraction_map_t& contraction_map,
-                            NGraph::Graph::vertex sp, NGraph::Graph::vertex spp);
-    void contract_tree_regions_bfs (const NGraph::Graph &A,
-                                    const std::deque<LAYER_IDX_T>& regions,
-                                    const std::deque<SWC_TYPE_T>& types,
-                                    NGraph::Graph::vertex_set& roots,
-                                    NGraph::Graph &S, contraction_map_t& contraction_map,
-                                    NGraph::Graph::vertex sp, NGraph::Graph::vertex spp);
-    void contract_tree_regions_dfs (const NGraph::Graph &A,
-                                    const std::deque<LAYER_IDX_T>& regions,
-                                    const std::deque<SWC_TYPE_T>& types,
-                                    NGraph::Graph::vertex_set& roots,
-                                    NGraph::Graph &S, contraction_map_t& contraction_map,
-                                    NGraph::Graph::vertex sp, NGraph::Graph::vertex spp);
+    /// @brief Contracts the point tree given by a parent array into
+    ///        sections, i.e. unbranched paths of points with the same
+    ///        type (and the same region, if regions is given). Runs in
+    ///        time linear in the number of points, without recursion.
+    ///
+    /// @param parents     Parent id of each point, or a negative value
+    ///                    for roots. Point i has id node_base + i.
+    ///
+    /// @param types       SWC type of each point
+    ///
+    /// @param regions     Region (layer) of each point, or NULL if
+    ///                    sections are not split at region changes
+    ///
+    /// @param node_base   Id of the first point
+    ///
+    /// @param src_vector  Source section of each section edge
+    ///
+    /// @param dst_vector  Destination section of each section edge
+    ///
+    /// @param sec_vector  Number of sections, followed by the number of
+    ///                    points and the point ids of each section
+    ///
+    /// @param ws          Scratch space
+    void contract_tree (const std::deque<PARENT_NODE_IDX_T>& parents,
+                        const std::deque<SWC_TYPE_T>& types,
+                        const std::deque<LAYER_IDX_T>* regions,
+                        const NODE_IDX_T node_base,
+                        std::deque<SECTION_IDX_T>& src_vector,
+                        std::deque<SECTION_IDX_T>& dst_vector,
+                        std::deque<SECTION_IDX_T>& sec_vector,
+                        tree_workspace_t& ws);
+
+    void contract_tree (const std::deque<PARENT_NODE_IDX_T>& parents,
+                        const std::deque<SWC_TYPE_T>& types,
+                        const std::deque<LAYER_IDX_T>* regions,
+                        const NODE_IDX_T node_base,
+                        std::deque<SECTION_IDX_T>& src_vector,
+                        std::deque<SECTION_IDX_T>& dst_vector,
+                        std::deque<SECTION_IDX_T>& sec_vector);
   }
 }
 
@@ -4,9 +4,15 @@
 #include <hdf5.h>
 #include <mpi.h>
 
+#include <set>
+#include <string>
 #include <vector>
 #include <forward_list>
 
+#include "neuroh5_types.hh"
+#include "tree_batch.hh"
+#include "tree_template_set.hh"
+
 namespace neuroh5
 {
 
@@ -15,7 +21,7 @@ namespace neuroh5
     /*****************************************************************************
      * Load tree data structures from HDF5
      *****************************************************************************/
-    
+
     int read_trees
     (
      MPI_Comm comm,
@@ -28,6 +34,40 @@ namespace neuroh5
      bool collective = true
      );
 
+    /// Reads the Trees columns of a population directly into a
+    /// TreeBatch, without building per-tree containers. Stored trees
+    /// are in file order, followed by the trees of cells that refer to
+    /// a morphology template. If tree_mask is not empty, only the
+    /// named Trees attributes (e.g. hdf5::X_COORD) are read; the other
+    /// columns of the batch are left empty.
+    int read_trees
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     size_t offset = 0,
+     size_t numitems = 0,
+     const std::set<std::string>& tree_mask = std::set<std::string>()
+     );
+
+    /// Reads the stored trees of a population into tree_batch, and the
+    /// cells that refer to a morphology template into template_set,
+    /// without expanding the templates.
+    int read_trees
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     data::TreeTemplateSet &template_set,
+     size_t offset = 0,
+     size_t numitems = 0,
+     const std::set<std::string>& tree_mask = std::set<std::string>()
+     );
+
     int read_tree_selection
     (
      MPI_Comm comm,
@@ -37,6 +77,52 @@ namespace neuroh5
      std::forward_list<neurotree_t> &tree_list,
      const std::vector<CELL_IDX_T>&  selection
      );
+
+    int read_tree_selection
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     const std::vector<CELL_IDX_T>&  selection,
+     const std::set<std::string>& tree_mask = std::set<std::string>()
+     );
+
+    int read_tree_selection
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     data::TreeTemplateSet &template_set,
+     const std::vector<CELL_IDX_T>&  selection,
+     const std::set<std::string>& tree_mask = std::set<std::string>()
+     );
+
+    /// Reads the selected morphology templates of a population; the
+    /// index of template_batch holds the template ids.
+    int read_tree_templates
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     data::TreeBatch &template_batch,
+     const std::vector<CELL_IDX_T>&  template_selection,
+     const std::set<std::string>& tree_mask = std::set<std::string>()
+     );
+
+    /// Returns the sorted ids of all cells that have a tree, either
+    /// stored or given by a morphology template.
+    int read_tree_index
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     std::vector<CELL_IDX_T>& tree_index
+     );
   }
 
 }
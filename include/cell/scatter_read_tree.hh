@@ -4,11 +4,13 @@
 #include <hdf5.h>
 #include <mpi.h>
 
+#include <set>
 #include <vector>
 #include <map>
 
 #include "neuroh5_types.hh"
 #include "attr_map.hh"
+#include "tree_batch.hh"
 
 namespace neuroh5
 {
@@ -36,6 +38,26 @@ namespace neuroh5
      size_t numitems = 0
      );
 
+    /// As above, but the trees received by this rank are stored in a
+    /// TreeBatch, in order of the I/O rank that read them. If tree_mask
+    /// is not empty, only the named Trees attributes are read and sent.
+    int scatter_read_trees
+    (
+     MPI_Comm                              all_comm,
+     const std::string&                    file_name,
+     const int                             io_size,
+     const std::vector<std::string>       &attr_name_spaces,
+     // A vector that maps nodes to compute ranks
+     const node_rank_map_t                &node_rank_map,
+     const string                         &pop_name,
+     const CELL_IDX_T                      pop_start,
+     data::TreeBatch                      &tree_batch,
+     std::map<string, data::NamedAttrMap> &attr_maps,
+     size_t offset = 0,
+     size_t numitems = 0,
+     const std::set<std::string>          &tree_mask = std::set<std::string>()
+     );
+
     int scatter_read_tree_selection
     (
      MPI_Comm                        all_comm,
@@ -49,6 +71,20 @@ namespace neuroh5
      map<CELL_IDX_T, neurotree_t>    &tree_map,
      map<string, data::NamedAttrMap> &attr_maps
      );
+
+    int scatter_read_tree_selection
+    (
+     MPI_Comm                        all_comm,
+     const string                   &file_name,
+     const int                       io_size,
+     const vector<string>           &attr_name_spaces,
+     const string                    &pop_name,
+     const CELL_IDX_T                 pop_start,
+     const std::vector<CELL_IDX_T>&  selection,
+     data::TreeBatch                 &tree_batch,
+     map<string, data::NamedAttrMap> &attr_maps,
+     const std::set<std::string>     &tree_mask = std::set<std::string>()
+     );
   }
 }
 
@@ -0,0 +1,103 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file spatial_index.hh
+///
+///  Distributed spatial index over cell coordinates, for radius and
+///  nearest-neighbor queries of distance-dependent connectivity.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+#ifndef SPATIAL_INDEX_HH
+#define SPATIAL_INDEX_HH
+
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "path_names.hh"
+#include "kd_tree.hh"
+#include "thread_pool.hh"
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    /// Spatial index of the cells of a population. Each rank indexes
+    /// its share of the cells in a k-d tree and knows the bounding box
+    /// of the cells of every rank, so that queries are only sent to
+    /// ranks that may hold neighbors.
+    struct spatial_index_t
+    {
+      data::KDTree         tree;
+      // bounding box (min x, y, z, max x, y, z) of the cells of each rank
+      std::vector<COORD_T> rank_bounds;
+    };
+
+    /// Neighbors of a batch of query points in compressed sparse row
+    /// form: the neighbors of query i are index[ptr[i]..ptr[i+1]) at
+    /// the corresponding distances, in order of increasing distance
+    /// and then cell index.
+    struct neighbor_csr_t
+    {
+      std::vector<ATTR_PTR_T> ptr;
+      std::vector<CELL_IDX_T> index;
+      std::vector<COORD_T>    distance;
+    };
+
+    /// Builds a spatial index from the cells given on each rank; coords
+    /// holds x, y, z of each cell. Collective over comm.
+    void build_spatial_index
+    (
+     MPI_Comm                       comm,
+     const std::vector<CELL_IDX_T>& gids,
+     const std::vector<COORD_T>&    coords,
+     spatial_index_t&               index
+     );
+
+    /// Builds a spatial index from the coordinate attributes of a
+    /// population in the given cell attribute namespace. The cells are
+    /// distributed over the ranks in the same way as by
+    /// read_cell_attributes. Collective over comm.
+    void build_spatial_index
+    (
+     MPI_Comm                        comm,
+     const std::string&              file_name,
+     const std::string&              name_space,
+     const std::string&              pop_name,
+     const CELL_IDX_T&               pop_start,
+     spatial_index_t&                index,
+     const std::vector<std::string>& coord_names = { hdf5::X_COORD, hdf5::Y_COORD, hdf5::Z_COORD }
+     );
+
+    /// Finds all cells within distance radius of each of the query
+    /// points given on this rank; queries holds x, y, z of each point.
+    /// Collective over comm, but each rank may pass a different number
+    /// of query points.
+    void spatial_radius_query
+    (
+     MPI_Comm                    comm,
+     const spatial_index_t&      index,
+     const std::vector<COORD_T>& queries,
+     const COORD_T               radius,
+     data::thread_pool&          pool,
+     neighbor_csr_t&             neighbors
+     );
+
+    /// Finds the k cells nearest to each of the query points given on
+    /// this rank. Collective over comm.
+    void spatial_knn_query
+    (
+     MPI_Comm                    comm,
+     const spatial_index_t&      index,
+     const std::vector<COORD_T>& queries,
+     const size_t                k,
+     data::thread_pool&          pool,
+     neighbor_csr_t&             neighbors
+     );
+  }
+}
+
+#endif
@@ -0,0 +1,76 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_cell_attributes.hh
+///
+///  Combines the cell attributes written to separate part files into one
+///  namespace of a master file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef STITCH_CELL_ATTRIBUTES_HH
+#define STITCH_CELL_ATTRIBUTES_HH
+
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    /// @brief Creates a cell attribute namespace in file_name that
+    ///        contains the attributes of the same namespace in the part
+    ///        files. Collective on comm.
+    ///
+    /// The parts are typically written by separate I/O groups, each
+    /// with the existing append functions and its own communicator, so
+    /// that no file is shared between groups. There is no part-writing
+    /// mode: the caller splits its communicator into the groups (e.g.
+    /// with MPI_Comm_split), chooses one part file name per group, and
+    /// creates and appends to the part with the group communicator, so
+    /// that the collective transfers of the append functions only
+    /// involve the ranks of the group. The cell indices and
+    /// values of each attribute become virtual datasets over the
+    /// parts, in the order of part_file_names, and only the attribute
+    /// pointers are copied, rebased to the positions of the parts. The
+    /// parts must therefore be kept with the master file, unless
+    /// copy_parts is true; part files in the same directory are referred
+    /// to by their base names. With copy_parts, the part datasets are
+    /// copied into the master file as stored, without decompressing
+    /// the values, and the virtual datasets refer to the copies. A cell
+    /// contained in more than one part is read as if it had been
+    /// appended more than once. An existing namespace of the same name
+    /// in file_name is replaced, and the new namespace can be read but
+    /// not appended to.
+    ///
+    /// @param comm             MPI communicator
+    ///
+    /// @param file_name        Master file, which must contain the
+    ///                         population definitions
+    ///
+    /// @param part_file_names  Part files, in order
+    ///
+    /// @param name_space       Cell attribute namespace
+    ///
+    /// @param pop_name         Population name
+    ///
+    /// @param copy_parts       Copy the part datasets into file_name
+    void stitch_cell_attributes
+    (
+     MPI_Comm                        comm,
+     const std::string&              file_name,
+     const std::vector<std::string>& part_file_names,
+     const std::string&              name_space,
+     const std::string&              pop_name,
+     const bool                      copy_parts = false
+     );
+
+  }
+}
+
+#endif
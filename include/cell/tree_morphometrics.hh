@@ -0,0 +1,78 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_morphometrics.hh
+///
+///  Morphometric quantities of batches of trees.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+#ifndef TREE_MORPHOMETRICS_HH
+#define TREE_MORPHOMETRICS_HH
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "neuroh5_types.hh"
+#include "thread_pool.hh"
+#include "tree_batch.hh"
+
+namespace neuroh5
+{
+  namespace cell
+  {
+    // names of the cell attributes produced by compute_tree_morphometrics
+    const std::string SECTION_LENGTH       = "Section Length";
+    const std::string SECTION_BRANCH_ORDER = "Section Branch Order";
+    const std::string PATH_DISTANCE        = "Path Distance";
+    const std::string LAYER_LENGTH         = "Layer Length";
+    const std::string BOUNDING_BOX         = "Bounding Box";
+    const std::string TOTAL_LENGTH         = "Total Length";
+
+    /// Morphometric quantities of a batch of trees, stored like cell
+    /// attributes: the values of tree i occupy [ptr[i], ptr[i+1]) of
+    /// each column. Quantities with a fixed number of values per tree
+    /// have no pointer array.
+    struct tree_morphometrics_t
+    {
+      std::vector<CELL_IDX_T> index;
+
+      // per section: length along the section points, and number of
+      // branch points between the section and the root section
+      std::vector<ATTR_PTR_T> section_ptr;
+      std::vector<float>      section_length;
+      std::vector<uint16_t>   section_branch_order;
+
+      // per point: path distance to the root point
+      std::vector<ATTR_PTR_T> point_ptr;
+      std::vector<float>      path_distance;
+
+      // per tree: dendritic length in each of num_layers layers,
+      // bounding box (min x, y, z, max x, y, z), and total length
+      size_t                  num_layers;
+      std::vector<float>      layer_length;
+      std::vector<float>      bounding_box;
+      std::vector<float>      total_length;
+
+      size_t size () const { return index.size(); }
+
+      /// Adds the values of each tree to per-attribute maps, as
+      /// expected by append_cell_attribute_maps.
+      void append_attr_maps (std::map<std::string, std::map<CELL_IDX_T, std::deque<float> > >& float_values,
+                             std::map<std::string, std::map<CELL_IDX_T, std::deque<uint16_t> > >& uint16_values) const;
+    };
+
+    /// Computes the morphometrics of all trees of a batch, using the
+    /// threads of the given pool. The batch must contain the point
+    /// coordinates, layers, SWC types, parents and section topology.
+    /// Layer lengths only include dendritic (SWC type 3 or 4) segments,
+    /// and the number of layers is one more than the largest layer
+    /// index in the batch.
+    void compute_tree_morphometrics (const data::TreeBatch& tree_batch,
+                                     data::thread_pool& pool,
+                                     tree_morphometrics_t& morph);
+  }
+}
+
+#endif
@@ -0,0 +1,53 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_workspace.hh
+///
+///  Scratch arrays for tree contraction and validation.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+#ifndef TREE_WORKSPACE_HH
+#define TREE_WORKSPACE_HH
+
+#include <vector>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace cell
+  {
+    /// Arrays reused by contract_tree and validate_tree. Keeping one
+    /// workspace per thread and passing it to successive calls means
+    /// that processing a tree only allocates when it is larger than
+    /// every tree seen before.
+    struct tree_workspace_t
+    {
+      struct frame_t
+      {
+        size_t     node;            // first node of the section walk
+        size_t     parent_section;  // section of the parent node
+        NODE_IDX_T parent_node;     // id of the parent node
+      };
+
+      // children of each node in compressed sparse row form
+      std::vector<size_t>     child_ptr;
+      std::vector<size_t>     children;
+      std::vector<size_t>     roots;
+      std::vector<frame_t>    stack;
+
+      // contracted sections: members of section s are
+      // section_nodes[section_ptr[s] .. section_ptr[s+1])
+      std::vector<size_t>     section_ptr;
+      std::vector<NODE_IDX_T> section_nodes;
+      std::vector<size_t>     edge_src, edge_dst, edge_ptr;
+
+      // validation
+      std::vector<uint8_t>    node_seen;
+      std::vector<uint32_t>   section_indegree;
+      std::vector<uint8_t>    section_exists;
+    };
+  }
+}
+
+#endif
@@ -4,18 +4,35 @@
 ///
 ///  Definition for tree validation.
 ///
-///  Copyright (C) 2016-2017 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 #ifndef VALIDATE_TREE_HH
 #define VALIDATE_TREE_HH
 
+#include <forward_list>
+
 #include "neuroh5_types.hh"
+#include "tree_workspace.hh"
+#include "thread_pool.hh"
+#include "tree_batch.hh"
 
 namespace neuroh5
 {
   namespace cell
   {
+    void validate_tree(const neurotree_t& tree, tree_workspace_t& ws);
     void validate_tree(const neurotree_t& tree);
+
+    /// Validates all trees in the list, using the threads of the given
+    /// pool. Throws if any tree is invalid.
+    void validate_trees(const std::forward_list<neurotree_t>& tree_list,
+                        data::thread_pool& pool);
+
+    /// Validates tree i of a batch.
+    void validate_tree(const data::TreeBatch& tree_batch, size_t i, tree_workspace_t& ws);
+
+    void validate_trees(const data::TreeBatch& tree_batch,
+                        data::thread_pool& pool);
   }
 }
 
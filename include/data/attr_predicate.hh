@@ -0,0 +1,90 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file attr_predicate.hh
+///
+///  Predicates over cell attribute values, for filtering attributes on the
+///  I/O ranks before they are distributed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef ATTR_PREDICATE_HH
+#define ATTR_PREDICATE_HH
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include "attr_map.hh"
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    enum AttrComparison
+      {
+        AttrEqual,
+        AttrNotEqual,
+        AttrLess,
+        AttrLessEqual,
+        AttrGreater,
+        AttrGreaterEqual
+      };
+
+    /// Parses one of "==", "!=", "<", "<=", ">", ">=".
+    AttrComparison parse_attr_comparison (const std::string& op);
+
+    /// Returns the result of the comparison a <op> b.
+    bool compare_attr_value (const AttrComparison comparison, const double a, const double b);
+
+    struct attr_condition_t
+    {
+      std::string    attr_name;
+      AttrComparison comparison;
+      double         value;
+    };
+
+    /// Conjunction of comparisons of attribute values with constants.
+    ///
+    /// The conditions of a cell are evaluated element by element over
+    /// its values of the condition attributes, which must all have the
+    /// same length. Cells without any matching element, or without
+    /// values of a condition attribute, are removed. Of the remaining
+    /// cells, every attribute with the same number of values as the
+    /// condition attributes keeps only the values of the matching
+    /// elements, so that a predicate on a scalar attribute such as a
+    /// layer selects whole cells, and a predicate on a per-synapse
+    /// attribute such as a synapse type selects synapses.
+    struct AttrPredicate
+    {
+      std::vector<attr_condition_t> conditions;
+
+      bool empty () const { return conditions.empty(); }
+
+      AttrPredicate& add (const std::string& attr_name, const AttrComparison comparison,
+                          const double value)
+      {
+        attr_condition_t condition = { attr_name, comparison, value };
+        conditions.push_back(condition);
+        return *this;
+      }
+
+      /// Adds the attributes used by the predicate to a non-empty
+      /// attribute mask, so that they are read, and returns the names
+      /// that were not already in the mask.
+      std::set<std::string> extend_mask (std::set<std::string>& attr_mask) const;
+    };
+
+    /// Removes the cells and values that do not match the predicate.
+    void filter_attr_map (const AttrPredicate& predicate, NamedAttrMap& attr_values);
+
+    /// Removes the named attributes, such as the ones added to the mask
+    /// only to evaluate a predicate, and renumbers the remaining
+    /// attributes of each type.
+    void erase_attrs (const std::set<std::string>& attr_names, NamedAttrMap& attr_values);
+
+  }
+}
+
+#endif
@@ -0,0 +1,75 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file kd_tree.hh
+///
+///  Static k-d tree over points in three dimensions.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef KD_TREE_HH
+#define KD_TREE_HH
+
+#include <utility>
+#include <vector>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// A k-d tree stored implicitly in contiguous arrays: the points
+    /// of a subtree occupy a range [begin, end) of the point arrays,
+    /// the point at the middle of the range splits it along the
+    /// dimension split_dim[middle], and ranges of at most leaf_size
+    /// points are searched exhaustively.
+    class KDTree
+    {
+    public:
+      /// A neighbor given by its distance and id.
+      typedef std::pair<COORD_T, CELL_IDX_T> neighbor_t;
+
+      KDTree () : leaf_size(16) {}
+
+      /// Builds the tree over points with the given ids; coords holds
+      /// x, y, z of each point.
+      void build (const std::vector<CELL_IDX_T>& ids, const std::vector<COORD_T>& coords,
+                  size_t leaf_size = 16);
+
+      size_t size () const { return index.size(); }
+      bool empty () const { return index.empty(); }
+
+      /// Returns the bounding box (min x, y, z, max x, y, z) of the
+      /// points; an empty tree has an empty box with min > max.
+      void bounds (COORD_T box[6]) const;
+
+      /// Appends all points within distance radius of q to result.
+      void radius_query (const COORD_T q[3], COORD_T radius,
+                         std::vector<neighbor_t>& result) const;
+
+      /// Appends the k points nearest to q to result, in order of
+      /// increasing distance; ties are broken by id.
+      void knn_query (const COORD_T q[3], size_t k,
+                      std::vector<neighbor_t>& result) const;
+
+    private:
+      void build_range (size_t begin, size_t end, std::vector<size_t>& perm,
+                        const std::vector<COORD_T>& coords);
+      void radius_range (size_t begin, size_t end, const COORD_T q[3], COORD_T radius2,
+                         std::vector<neighbor_t>& result) const;
+      void knn_range (size_t begin, size_t end, const COORD_T q[3], size_t k,
+                      std::vector<neighbor_t>& heap) const;
+      COORD_T distance2 (size_t i, const COORD_T q[3]) const;
+
+      size_t                  leaf_size;
+      std::vector<CELL_IDX_T> index;      // point ids in tree order
+      std::vector<COORD_T>    points;     // x, y, z of each point in tree order
+      std::vector<uint8_t>    split_dim;  // split dimension of each range middle
+    };
+
+  }
+}
+
+#endif
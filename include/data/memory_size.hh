@@ -0,0 +1,51 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file memory_size.hh
+///
+///  Estimates of the heap memory held by the main data structures,
+///  used for memory accounting.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef MEMORY_SIZE_HH
+#define MEMORY_SIZE_HH
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "attr_map.hh"
+#include "tree_batch.hh"
+
+#include <cstddef>
+#include <map>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// Approximate bookkeeping cost of a node of a std::map or std::set,
+    /// in addition to its value.
+    const size_t map_node_overhead = 4 * sizeof(void*);
+
+    template <class T>
+    size_t vector_bytes (const std::vector<T>& v)
+    {
+      return v.capacity() * sizeof(T);
+    }
+
+    size_t attr_val_bytes (const AttrVal& v);
+
+    size_t edge_map_bytes (const edge_map_t& edge_map);
+
+    size_t rank_edge_map_bytes (const rank_edge_map_t& rank_edge_map);
+
+    size_t attr_map_bytes (const AttrMap& attr_map);
+
+    size_t tree_batch_bytes (const TreeBatch& tree_batch);
+
+  }
+}
+
+#endif
@@ -44,6 +44,15 @@ namespace neuroh5
                                     size_t& num_unpacked_edges
                                     );
     
+    /// Moves the edges of edge_map into prj_edge_map, appending to the
+    /// adjacency and attribute values of destinations already present;
+    /// edge_map is left empty.
+    void merge_edge_map (edge_map_t& edge_map,
+                         edge_map_t& prj_edge_map,
+                         size_t& num_merged_nodes,
+                         size_t& num_merged_edges
+                         );
+    
     void deserialize_edge_map (const vector<char> &recvbuf,
                                edge_map_t& prj_edge_map,
                                size_t& num_unpacked_nodes,
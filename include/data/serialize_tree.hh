@@ -18,6 +18,7 @@
 #include <forward_list>
 
 #include "neuroh5_types.hh"
+#include "tree_batch.hh"
 
 namespace neuroh5
 {
@@ -42,6 +43,21 @@ namespace neuroh5
                                      const vector<int>& recvcounts,
                                      const vector<int>& rdispls,
                                      forward_list<neurotree_t> &all_tree_list);
+
+    void serialize_rank_tree_batch (const size_t num_ranks,
+                                    const size_t start_rank,
+                                    const std::map <rank_t, TreeBatch>& rank_tree_batch,
+                                    std::vector<int>& sendcounts,
+                                    std::vector<char> &sendbuf,
+                                    std::vector<int> &sdispls);
+
+    /// Appends the trees received from each rank to all_tree_batch, in
+    /// order of source rank.
+    void deserialize_rank_tree_batch (const size_t num_ranks,
+                                      const std::vector<char> &recvbuf,
+                                      const std::vector<int>& recvcounts,
+                                      const std::vector<int>& rdispls,
+                                      TreeBatch &all_tree_batch);
   }
 }
 #endif
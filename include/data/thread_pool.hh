@@ -0,0 +1,200 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file thread_pool.hh
+///
+///  Fixed-size pool of worker threads for data-parallel loops over
+///  independent items (e.g. trees) within a single MPI rank.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef THREAD_POOL_HH
+#define THREAD_POOL_HH
+
+#include <cstdlib>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// Returns the number of threads to use per MPI rank, as given by
+    /// the environment variable NEUROH5_NUM_THREADS, or 1 if it is not
+    /// set. The default is conservative because ranks usually already
+    /// occupy all cores of a node.
+    inline size_t default_num_threads ()
+    {
+      const char* s = std::getenv("NEUROH5_NUM_THREADS");
+      if (s != NULL)
+        {
+          long n = std::atol(s);
+          if (n > 0)
+            {
+              return n;
+            }
+        }
+      return 1;
+    }
+
+    /// Pool of worker threads executing parallel_for loops. The calling
+    /// thread participates as worker 0, so a pool of size 1 runs loops
+    /// serially without creating any threads.
+    class thread_pool
+    {
+    public:
+      explicit thread_pool (size_t num_threads = default_num_threads())
+        : num_workers(num_threads > 0 ? num_threads : 1),
+          job(NULL), generation(0), num_active(0), stop(false)
+      {
+        for (size_t w=1; w<num_workers; w++)
+          {
+            workers.push_back(std::thread(&thread_pool::worker_loop, this, w));
+          }
+      }
+
+      ~thread_pool ()
+      {
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          stop = true;
+        }
+        job_cv.notify_all();
+        for (auto& t : workers)
+          {
+            t.join();
+          }
+      }
+
+      size_t size () const { return num_workers; }
+
+      /// Calls f(i, worker) for every i in [0, n), where worker is the
+      /// index in [0, size()) of the thread executing the call, for use
+      /// with per-thread scratch space. Items are handed out in chunks
+      /// of grain consecutive indices. Blocks until all items are
+      /// done; the first exception thrown by f is rethrown here.
+      template <class F>
+      void parallel_for (size_t n, F f, size_t grain = 1)
+      {
+        if (grain == 0)
+          {
+            grain = 1;
+          }
+        if ((num_workers == 1) || (n <= grain))
+          {
+            for (size_t i=0; i<n; i++)
+              {
+                f(i, 0);
+              }
+            return;
+          }
+
+        std::atomic<size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        std::function<void(size_t)> body = [&] (size_t worker)
+          {
+            while (true)
+              {
+                size_t begin = next.fetch_add(grain);
+                if (begin >= n)
+                  {
+                    break;
+                  }
+                size_t end = (begin + grain < n) ? begin + grain : n;
+                try
+                  {
+                    for (size_t i=begin; i<end; i++)
+                      {
+                        f(i, worker);
+                      }
+                  }
+                catch (...)
+                  {
+                    std::lock_guard<std::mutex> guard(error_mutex);
+                    if (!error)
+                      {
+                        error = std::current_exception();
+                      }
+                    next = n;
+                  }
+              }
+          };
+
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          job = &body;
+          num_active = num_workers - 1;
+          generation++;
+        }
+        job_cv.notify_all();
+
+        body(0);
+
+        {
+          std::unique_lock<std::mutex> lock(mutex);
+          done_cv.wait(lock, [this] { return num_active == 0; });
+          job = NULL;
+        }
+
+        if (error)
+          {
+            std::rethrow_exception(error);
+          }
+      }
+
+    private:
+      thread_pool (const thread_pool&);
+      thread_pool& operator= (const thread_pool&);
+
+      void worker_loop (size_t worker)
+      {
+        size_t seen_generation = 0;
+        while (true)
+          {
+            std::function<void(size_t)>* current_job = NULL;
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              job_cv.wait(lock, [&] { return stop || (generation != seen_generation); });
+              if (stop)
+                {
+                  return;
+                }
+              seen_generation = generation;
+              current_job = job;
+            }
+
+            (*current_job)(worker);
+
+            {
+              std::unique_lock<std::mutex> lock(mutex);
+              num_active--;
+              if (num_active == 0)
+                {
+                  done_cv.notify_one();
+                }
+            }
+          }
+      }
+
+      const size_t              num_workers;
+      std::vector<std::thread>  workers;
+      std::mutex                mutex;
+      std::condition_variable   job_cv, done_cv;
+      std::function<void(size_t)>* job;
+      size_t                    generation;
+      size_t                    num_active;
+      bool                      stop;
+    };
+
+  }
+}
+
+#endif
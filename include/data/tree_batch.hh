@@ -0,0 +1,185 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_batch.hh
+///
+///  Contiguous column storage for a set of trees.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef TREE_BATCH_HH
+#define TREE_BATCH_HH
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <forward_list>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// Read-only view of a contiguous range of a column.
+    template <class T>
+    struct column_view
+    {
+      const T* ptr;
+      size_t   len;
+
+      column_view () : ptr(NULL), len(0) {}
+      column_view (const T* p, size_t n) : ptr(p), len(n) {}
+
+      size_t size () const { return len; }
+      const T& operator[] (size_t i) const { return ptr[i]; }
+      const T* begin () const { return ptr; }
+      const T* end () const { return ptr + len; }
+    };
+
+    /// Bit flags that select the columns of a TreeBatch.
+    enum TreeField
+      {
+        TreeFieldX        = 1 << 0,
+        TreeFieldY        = 1 << 1,
+        TreeFieldZ        = 1 << 2,
+        TreeFieldRadius   = 1 << 3,
+        TreeFieldLayer    = 1 << 4,
+        TreeFieldParent   = 1 << 5,
+        TreeFieldSWCType  = 1 << 6,
+        TreeFieldSrc      = 1 << 7,
+        TreeFieldDst      = 1 << 8,
+        TreeFieldSections = 1 << 9,
+
+        TreeFieldCoords   = TreeFieldX | TreeFieldY | TreeFieldZ,
+        TreeFieldPoints   = TreeFieldCoords | TreeFieldRadius | TreeFieldLayer |
+                            TreeFieldParent | TreeFieldSWCType,
+        TreeFieldTopology = TreeFieldSrc | TreeFieldDst | TreeFieldSections,
+        TreeFieldAll      = TreeFieldPoints | TreeFieldTopology
+      };
+
+    /// Returns the field flags that correspond to a set of Trees
+    /// attribute names (e.g. hdf5::X_COORD); an empty mask selects all
+    /// fields.
+    uint32_t tree_field_mask (const std::set<std::string>& tree_mask);
+
+    /// A set of trees stored in the same layout as the Trees group of
+    /// a NeuroH5 file: each tree attribute is one contiguous column,
+    /// and the values of tree i occupy [ptr[i], ptr[i+1]) of the
+    /// columns that share the pointer array ptr. Point attributes
+    /// share attr_ptr, the section array uses sec_ptr, and the section
+    /// topology uses topo_ptr. Columns that are not in fields are left
+    /// empty; a pointer array none of whose columns is present only
+    /// holds zeros.
+    class TreeBatch
+    {
+    public:
+      std::vector<CELL_IDX_T>        index;     // tree gids
+      std::vector<ATTR_PTR_T>        attr_ptr;
+      std::vector<SEC_PTR_T>         sec_ptr;
+      std::vector<TOPO_PTR_T>        topo_ptr;
+
+      std::vector<SECTION_IDX_T>     src;       // section topology
+      std::vector<SECTION_IDX_T>     dst;
+      std::vector<SECTION_IDX_T>     sections;  // section point lists
+      std::vector<COORD_T>           x, y, z;   // point attributes
+      std::vector<REALVAL_T>         radius;
+      std::vector<LAYER_IDX_T>       layer;
+      std::vector<PARENT_NODE_IDX_T> parent;
+      std::vector<SWC_TYPE_T>        swc_type;
+
+      uint32_t                       fields;    // TreeField flags of the columns present
+
+      TreeBatch ();
+
+      bool has (uint32_t f) const { return (fields & f) == f; }
+
+      size_t size () const { return index.size(); }
+      bool empty () const { return index.empty(); }
+      void clear ();
+
+      /// Checks that the pointer arrays are consistent with the columns.
+      void validate () const;
+
+      size_t num_points (size_t i) const { return attr_ptr[i+1] - attr_ptr[i]; }
+
+      /// Returns the values of tree i in column v, or an empty view if
+      /// field f is not present.
+      template <class T, class P>
+      column_view<T> column (uint32_t f, const std::vector<T>& v, const std::vector<P>& ptr, size_t i) const
+      { return has(f) ? column_view<T>(v.data() + ptr[i], ptr[i+1] - ptr[i]) : column_view<T>(); }
+
+      column_view<SECTION_IDX_T> tree_src (size_t i) const
+      { return column<SECTION_IDX_T>(TreeFieldSrc, src, topo_ptr, i); }
+      column_view<SECTION_IDX_T> tree_dst (size_t i) const
+      { return column<SECTION_IDX_T>(TreeFieldDst, dst, topo_ptr, i); }
+      column_view<SECTION_IDX_T> tree_sections (size_t i) const
+      { return column<SECTION_IDX_T>(TreeFieldSections, sections, sec_ptr, i); }
+      column_view<COORD_T> tree_x (size_t i) const
+      { return column<COORD_T>(TreeFieldX, x, attr_ptr, i); }
+      column_view<COORD_T> tree_y (size_t i) const
+      { return column<COORD_T>(TreeFieldY, y, attr_ptr, i); }
+      column_view<COORD_T> tree_z (size_t i) const
+      { return column<COORD_T>(TreeFieldZ, z, attr_ptr, i); }
+      column_view<REALVAL_T> tree_radius (size_t i) const
+      { return column<REALVAL_T>(TreeFieldRadius, radius, attr_ptr, i); }
+      column_view<LAYER_IDX_T> tree_layer (size_t i) const
+      { return column<LAYER_IDX_T>(TreeFieldLayer, layer, attr_ptr, i); }
+      column_view<PARENT_NODE_IDX_T> tree_parent (size_t i) const
+      { return column<PARENT_NODE_IDX_T>(TreeFieldParent, parent, attr_ptr, i); }
+      column_view<SWC_TYPE_T> tree_swc_type (size_t i) const
+      { return column<SWC_TYPE_T>(TreeFieldSWCType, swc_type, attr_ptr, i); }
+
+      /// Appends a tree given as a tuple of deques.
+      void append (const neurotree_t& tree);
+
+      /// Appends tree i of another batch.
+      void append (const TreeBatch& other, size_t i);
+
+      /// Appends all trees of another batch.
+      void append (const TreeBatch& other);
+
+      /// Returns tree i as a tuple of deques.
+      neurotree_t tree (size_t i) const;
+
+      /// Prepends all trees to tree_list in increasing order of gid,
+      /// so that the list ends up ordered by decreasing gid.
+      void to_list (std::forward_list<neurotree_t>& tree_list) const;
+
+      /// Inserts all trees into tree_map.
+      void to_map (std::map<CELL_IDX_T, neurotree_t>& tree_map) const;
+
+      template <class Archive>
+      void serialize (Archive& ar)
+      {
+        ar(fields, index, attr_ptr, sec_ptr, topo_ptr,
+           src, dst, sections, x, y, z, radius, layer, parent, swc_type);
+      }
+
+    private:
+      /// Adopts the fields of other if this batch is empty, and
+      /// otherwise checks that both batches have the same fields.
+      void match_fields (const TreeBatch& other);
+
+      template <class T, class C>
+      void append_deque (uint32_t f, const C& from, std::vector<T>& to)
+      {
+        if (has(f))
+          to.insert(to.end(), from.begin(), from.end());
+      }
+
+      template <class T, class P>
+      void append_range (uint32_t f, const std::vector<T>& from, const std::vector<P>& ptr,
+                         size_t i, std::vector<T>& to)
+      {
+        if (has(f))
+          to.insert(to.end(), from.begin() + ptr[i], from.begin() + ptr[i+1]);
+      }
+    };
+
+  }
+}
+
+#endif
@@ -0,0 +1,71 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_template_set.hh
+///
+///  Trees given as references to shared morphology templates.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef TREE_TEMPLATE_SET_HH
+#define TREE_TEMPLATE_SET_HH
+
+#include <vector>
+#include <map>
+
+#include "neuroh5_types.hh"
+#include "tree_batch.hh"
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// A set of cells whose morphology is one of a small number of
+    /// template trees, optionally translated. Each template is stored
+    /// once in templates (its index entry is the template id), no
+    /// matter how many cells refer to it.
+    class TreeTemplateSet
+    {
+    public:
+      TreeBatch               templates;
+      std::vector<CELL_IDX_T> index;            // cell gids
+      std::vector<CELL_IDX_T> template_index;   // template id of each cell
+      std::vector<COORD_T>    offset;           // x, y, z translation of each cell
+
+      size_t size () const { return index.size(); }
+      bool empty () const { return index.empty(); }
+      void clear ();
+
+      /// Adds a reference from cell gid to template template_id.
+      void append_ref (CELL_IDX_T gid, CELL_IDX_T template_id,
+                       COORD_T dx = 0.0, COORD_T dy = 0.0, COORD_T dz = 0.0);
+
+      /// Adds reference i of another set, together with its template
+      /// if it is not already present.
+      void append_ref (const TreeTemplateSet& other, size_t i);
+
+      /// Expands every reference into a full tree and appends it to
+      /// tree_batch, in the order of the references.
+      void resolve (TreeBatch& tree_batch) const;
+
+      template <class Archive>
+      void serialize (Archive& ar)
+      {
+        ar(templates, index, template_index, offset);
+      }
+
+      /// Returns the position of a template in templates, or
+      /// templates.size() if it is not present.
+      size_t find_template (CELL_IDX_T template_id) const;
+
+    private:
+      // lookup table from template id to position, rebuilt on demand
+      // after templates changes (e.g. after deserialization)
+      mutable std::map<CELL_IDX_T, size_t> template_pos;
+    };
+
+  }
+}
+
+#endif
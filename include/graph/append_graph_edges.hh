@@ -0,0 +1,82 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file append_graph_edges.hh
+///
+///  Top-level functions for appending edges given as flat arrays
+///  (COO or CSR form) to graphs in DBS (Destination Block Sparse) format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef APPEND_GRAPH_EDGES_HH
+#define APPEND_GRAPH_EDGES_HH
+
+#include "neuroh5_types.hh"
+#include "attr_map.hh"
+#include "attr_index.hh"
+
+#include <hdf5.h>
+#include <mpi.h>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+    /// @brief Appends edges given in coordinate (COO) form. The edges
+    ///        do not need to be sorted or grouped by destination; they
+    ///        are redistributed to the I/O ranks by destination, sorted
+    ///        locally and written as DBS blocks.
+    ///
+    /// @param all_comm        MPI communicator
+    ///
+    /// @param io_size         Number of I/O ranks
+    ///
+    /// @param file_name       Output file name
+    ///
+    /// @param src_pop_name    Source population name
+    ///
+    /// @param dst_pop_name    Destination population name
+    ///
+    /// @param edge_attr_index Attribute names and indices for each namespace
+    ///
+    /// @param dst             Destination node indices, one per edge.
+    ///                        Cleared on return.
+    ///
+    /// @param src             Source node indices, one per edge.
+    ///                        Cleared on return.
+    ///
+    /// @param edge_attr_map   Attribute columns for each namespace, with
+    ///                        one value per edge. Cleared on return.
+    ///
+    /// @return                zero on success
+    int append_graph_edges
+    (
+     MPI_Comm         all_comm,
+     const int        io_size,
+     const std::string&    file_name,
+     const std::string&    src_pop_name,
+     const std::string&    dst_pop_name,
+     const std::map <std::string, std::pair <size_t, data::AttrIndex > >& edge_attr_index,
+     std::vector<NODE_IDX_T>& dst,
+     std::vector<NODE_IDX_T>& src,
+     std::map <std::string, data::NamedAttrVal>& edge_attr_map,
+     const hsize_t      chunk_size = 4096
+     );
+
+    /// @brief Expands destinations given in compressed sparse row
+    ///        form (unique destinations and num_dst+1 pointers into the
+    ///        source array) into one destination per edge.
+    void expand_csr_destinations
+    (
+     const std::vector<NODE_IDX_T>& dst_index,
+     const std::vector<DST_PTR_T>&  dst_ptr,
+     std::vector<NODE_IDX_T>&       dst
+     );
+
+  }
+}
+
+#endif
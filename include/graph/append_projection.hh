@@ -30,6 +30,33 @@ namespace neuroh5
      const bool collective = true
      );
 
+    /// @brief Appends a projection given in compressed sparse row form.
+    ///
+    /// dst_index holds the sorted destination indices that are local to
+    /// this rank, dst_index_ptr holds dst_index.size()+1 offsets into
+    /// src_idx (source indices relative to src_start), and edge_attr_map
+    /// holds one attribute column per edge for each namespace in
+    /// edge_attr_index.
+    void append_projection
+    (
+     MPI_Comm                  comm,
+     hid_t                     file,
+     const std::string&        src_pop_name,
+     const std::string&        dst_pop_name,
+     const NODE_IDX_T&         src_start,
+     const NODE_IDX_T&         src_end,
+     const NODE_IDX_T&         dst_start,
+     const NODE_IDX_T&         dst_end,
+     const std::vector<NODE_IDX_T>& dst_index,
+     const std::vector<DST_PTR_T>&  dst_index_ptr,
+     const std::vector<NODE_IDX_T>& src_idx,
+     const std::map <std::string, data::NamedAttrVal>& edge_attr_map,
+     const std::map <std::string, std::pair <size_t, data::AttrIndex > >& edge_attr_index,
+     const hsize_t            chunk_size = 4096,
+     const hsize_t            block_size = 1000000,
+     const bool collective = true
+     );
+
 
   }
 }
@@ -24,7 +24,15 @@ namespace neuroh5
 {
   namespace graph
   {
-  /// @brief Partitions the given projections to minimize the edge cut for each MPI rank
+  /// @brief Assigns all nodes to Nparts parts, so that the parts have
+  ///        nearly equal sums of in-degree and nearly equal numbers of
+  ///        nodes. The in-degree of each node is normalized by the
+  ///        number of edges of each projection and summed over the
+  ///        projections. Each rank assigns the nodes of a contiguous range
+  ///        to local bins in order of decreasing in-degree (longest
+  ///        processing time first), and the local bins of all ranks are
+  ///        then combined into parts by Karmarkar-Karp differencing. Nodes
+  ///        without incoming edges fill the parts up to equal sizes.
   ///
   /// @param comm          MPI communicator
   ///
@@ -32,12 +40,16 @@ namespace neuroh5
   ///
   /// @param prj_names     Vector of projection names to be read
   ///
-  /// @param io_size       Number of I/O ranks (those ranks that conduct I/O operations)
-  ///
   /// @param Nparts        Number of partitions
   ///
-  /// @param parts         Updated with node vectors containing the partitioner output
-  ///                      (assignment of graph nodes to MPI ranks)
+  /// @param node_start    Updated with the first node of the range of this rank
+  ///
+  /// @param parts         Updated with the part of each node of the range of
+  ///                      this rank
+  ///
+  /// @param part_weights  Updated with the sum of normalized in-degree of each part
+  ///
+  /// @param part_sizes    Updated with the number of nodes of each part
   ///
   /// @return              HDF5 error code
 
@@ -46,10 +58,11 @@ namespace neuroh5
      MPI_Comm comm,
      const std::string& input_file_name,
      const std::vector< std::pair<std::string, std::string> > prj_names,
-     const size_t io_size,
      const size_t Nparts,
+     NODE_IDX_T &node_start,
      std::vector<NODE_IDX_T> &parts,
-     std::vector<double> &part_weights
+     std::vector<double> &part_weights,
+     std::vector<size_t> &part_sizes
      );
 
   }
@@ -0,0 +1,91 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file edge_attr_filter.hh
+///
+///  Selection of edge attribute columns and filtering of edges by
+///  attribute values on the I/O ranks, before edges are distributed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef EDGE_ATTR_FILTER_HH
+#define EDGE_ATTR_FILTER_HH
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "attr_predicate.hh"
+#include "thread_pool.hh"
+
+#include <mpi.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Edge attributes to read and edges to keep when reading a
+    /// projection.
+    struct EdgeAttrFilter
+    {
+      /// Names of the attributes to read from each namespace; all
+      /// attributes are read from namespaces without an entry.
+      std::map<std::string, std::set<std::string> > attr_masks;
+
+      /// Predicates on the attributes of each namespace, evaluated
+      /// element-wise over the edges read by a rank; an edge is kept
+      /// only if it satisfies the predicates of all namespaces.
+      /// Attributes used by a predicate are read even if they are not
+      /// in the attribute mask or their namespace is not requested,
+      /// but they are only returned if requested.
+      std::map<std::string, data::AttrPredicate> predicates;
+
+      bool empty () const { return attr_masks.empty() && predicates.empty(); }
+    };
+
+    /// @brief Reads the edge attributes in the given namespaces that are
+    ///        selected by the filter mask, and removes the edges that do
+    ///        not satisfy the filter predicates from the destination
+    ///        pointer, source index and attribute values. Collective on
+    ///        comm.
+    ///
+    /// @param edge_base      Edge offset (returned by read_projection_datasets)
+    ///
+    /// @param edge_count     Number of edges read by this rank
+    ///
+    /// @param dst_ptr        Destination pointer, updated to point into the
+    ///                       filtered source index
+    ///
+    /// @param src_idx        Source index, updated with the kept edges
+    ///
+    /// @param edge_attr_map  Updated with the attribute values of the kept
+    ///                       edges, for each namespace in attr_namespaces
+    ///
+    /// @param pool           If not NULL, the threads of the read on which
+    ///                       compressed values are decompressed
+    ///
+    /// @return               zero on success
+    int read_filtered_edge_attributes
+    (
+     MPI_Comm                                   comm,
+     const std::string&                         file_name,
+     const std::string&                         src_pop_name,
+     const std::string&                         dst_pop_name,
+     const std::vector<std::string>&            attr_namespaces,
+     const EdgeAttrFilter&                      edge_filter,
+     const DST_PTR_T                            edge_base,
+     const DST_PTR_T                            edge_count,
+     std::vector<DST_PTR_T>&                    dst_ptr,
+     std::vector<NODE_IDX_T>&                   src_idx,
+     std::map<std::string, data::NamedAttrVal>& edge_attr_map,
+     data::thread_pool*                         pool = NULL
+     );
+
+  }
+}
+
+#endif
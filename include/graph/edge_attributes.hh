@@ -7,6 +7,7 @@
 #include "attr_kind_datatype.hh"
 #include "hdf5_edge_attributes.hh"
 #include "exists_dataset.hh"
+#include "thread_pool.hh"
 
 #include <hdf5.h>
 #include <mpi.h>
@@ -104,6 +105,10 @@ namespace neuroh5
     ///
     /// @param attr_values    An EdgeNamedAttr object that holds attribute
     //                        values.
+    ///
+    /// @param pool           If not NULL, the threads on which compressed
+    ///                       values are decompressed; it is created once
+    ///                       by the top-level read (see hdf5::read_chunks).
     extern herr_t read_edge_attributes
     (
      MPI_Comm              comm,
@@ -116,7 +121,8 @@ namespace neuroh5
      const DST_PTR_T       edge_count,
      const AttrKind        attr_kind,
      data::NamedAttrVal&   attr_values,
-     bool collective = true
+     bool collective = true,
+     data::thread_pool*    pool = NULL
      );
 
     extern int read_all_edge_attributes
@@ -129,7 +135,8 @@ namespace neuroh5
      const DST_PTR_T                                    edge_base,
      const DST_PTR_T                                    edge_count,
      const std::vector< std::pair<std::string,AttrKind> >& edge_attr_info,
-     data::NamedAttrVal&                              edge_attr_values
+     data::NamedAttrVal&                              edge_attr_values,
+     data::thread_pool*                               pool = NULL
      );
     
     extern herr_t read_edge_attribute_selection
@@ -147,7 +154,8 @@ namespace neuroh5
      const vector< pair<hsize_t,hsize_t> >& src_idx_ranges,
      const AttrKind        attr_kind,
      data::NamedAttrVal&   attr_values,
-     bool collective = true
+     bool collective = true,
+     data::thread_pool*    pool = NULL
      );
 
     extern int read_all_edge_attribute_selection
@@ -163,7 +171,8 @@ namespace neuroh5
      const vector<DST_PTR_T>&    selection_dst_ptr,
      const vector< pair<hsize_t,hsize_t> >& src_idx_ranges,
      const std::vector< std::pair<std::string,AttrKind> >& edge_attr_info,
-     data::NamedAttrVal&         edge_attr_values
+     data::NamedAttrVal&         edge_attr_values,
+     data::thread_pool*          pool = NULL
      );
 
 
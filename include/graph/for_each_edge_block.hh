@@ -0,0 +1,125 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file for_each_edge_block.hh
+///
+///  Streaming traversal of the edges of a projection in windows of DBS
+///  (Destination Block Sparse) blocks, without building an edge map.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef FOR_EACH_EDGE_BLOCK_HH
+#define FOR_EACH_EDGE_BLOCK_HH
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "edge_attr_filter.hh"
+
+#include <mpi.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// A window of the edges of a projection, as read by one rank. The
+    /// arrays are the DBS arrays returned by read_projection_datasets:
+    /// destination indices are relative to the destination population,
+    /// source indices to the source population, and destination
+    /// pointers to the start of src_idx. Attribute columns have one
+    /// value per element of src_idx.
+    struct edge_block_t
+    {
+      NODE_IDX_T                 src_start, dst_start;
+      DST_BLK_PTR_T              block_base;
+      DST_PTR_T                  edge_base;
+      std::vector<DST_BLK_PTR_T> dst_blk_ptr;
+      std::vector<NODE_IDX_T>    dst_idx;
+      std::vector<DST_PTR_T>     dst_ptr;
+      std::vector<NODE_IDX_T>    src_idx;
+      std::map<std::string, data::NamedAttrVal> edge_attr_map;
+
+      edge_block_t () : src_start(0), dst_start(0), block_base(0), edge_base(0) {}
+
+      size_t num_edges () const { return src_idx.size(); }
+
+      /// Calls f(dst, low, high) for every destination in the window,
+      /// where dst is the global destination index and src_idx[low,
+      /// high) are the sources of its edges.
+      template <class F>
+      void for_each_dst (F f) const
+      {
+        if (dst_blk_ptr.size() == 0)
+          {
+            return;
+          }
+        const size_t dst_ptr_size = dst_ptr.size();
+        for (size_t b = 0; b < dst_blk_ptr.size()-1; ++b)
+          {
+            const NODE_IDX_T dst_base = dst_idx[b] + dst_start;
+            for (size_t i = dst_blk_ptr[b], ii = 0; i < dst_blk_ptr[b+1]; ++i, ++ii)
+              {
+                if (i < dst_ptr_size-1)
+                  {
+                    f(dst_base + ii, (size_t)dst_ptr[i], (size_t)dst_ptr[i+1]);
+                  }
+              }
+          }
+      }
+    };
+
+    typedef std::function<void (const edge_block_t&)> edge_block_callback_t;
+
+    /// @brief Reads the edges of a projection in consecutive windows of
+    ///        DBS blocks and passes each window to a callback, so that
+    ///        at most two windows are held in memory at any time.
+    ///        Collective on comm: every rank reads a contiguous part of
+    ///        each window, and the callback is invoked on every rank
+    ///        once per window, possibly with no edges.
+    ///
+    /// @param comm            MPI communicator
+    ///
+    /// @param file_name       Input file name
+    ///
+    /// @param src_pop_name    Source population name
+    ///
+    /// @param dst_pop_name    Destination population name
+    ///
+    /// @param attr_namespaces Edge attribute namespaces to read
+    ///
+    /// @param block_window    Number of DBS blocks read by each rank per
+    ///                        window
+    ///
+    /// @param callback        Function called with each window
+    ///
+    /// @param overlap         If true, the callback runs on a separate
+    ///                        thread while the next window is read; it
+    ///                        must then not call MPI or HDF5
+    ///
+    /// @param edge_filter     Edge attributes to read and predicates that
+    ///                        edges must satisfy
+    ///
+    /// @return                the total number of edges passed to the
+    ///                        callback on this rank
+    size_t for_each_edge_block
+    (
+     MPI_Comm                         comm,
+     const std::string&               file_name,
+     const std::string&               src_pop_name,
+     const std::string&               dst_pop_name,
+     const std::vector<std::string>&  attr_namespaces,
+     const size_t                     block_window,
+     const edge_block_callback_t&     callback,
+     const bool                       overlap = false,
+     const EdgeAttrFilter&            edge_filter = EdgeAttrFilter()
+     );
+
+  }
+}
+
+#endif
@@ -0,0 +1,69 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file merge_files.hh
+///
+///  Merges the projections and cell attribute namespaces of several
+///  NeuroH5 files into one file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef MERGE_FILES_HH
+#define MERGE_FILES_HH
+
+#include <mpi.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// @brief Creates file_name with the populations of the input files
+    ///        and merges into it the given projections and cell
+    ///        attribute namespaces of the input files. Collective on
+    ///        comm.
+    ///
+    /// The input files must define the same populations; the new file
+    /// allows the population pairs of all input files. Each projection
+    /// and namespace is merged with stitch_projection and
+    /// stitch_cell_attributes, in the order of input_file_names, and
+    /// input files that do not contain it are skipped. If both
+    /// prj_names and name_spaces are empty, they are set to all
+    /// projections and all namespaces of the input files, except for
+    /// the morphology namespaces, which are stored in a different
+    /// layout. file_name must not exist.
+    ///
+    /// @param comm              MPI communicator
+    ///
+    /// @param file_name         Output file
+    ///
+    /// @param input_file_names  Input files, in order
+    ///
+    /// @param prj_names         Projections, as (source, destination)
+    ///                          population names
+    ///
+    /// @param name_spaces       Namespaces, as (population, namespace)
+    ///                          names
+    ///
+    /// @param copy_parts        Copy the datasets of the input files
+    ///                          into file_name
+    void merge_files
+    (
+     MPI_Comm                                          comm,
+     const std::string&                                file_name,
+     const std::vector<std::string>&                   input_file_names,
+     std::vector< std::pair<std::string,std::string> >& prj_names,
+     std::vector< std::pair<std::string,std::string> >& name_spaces,
+     const bool                                        copy_parts = false
+     );
+
+  }
+}
+
+#endif
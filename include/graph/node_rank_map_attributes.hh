@@ -0,0 +1,59 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file node_rank_map_attributes.hh
+///
+///  Storage of node-to-rank assignments as cell attributes, so that the
+///  output of a partitioner can be reused across runs.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef NODE_RANK_MAP_ATTRIBUTES_HH
+#define NODE_RANK_MAP_ATTRIBUTES_HH
+
+#include "neuroh5_types.hh"
+
+#include <mpi.h>
+
+#include <string>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+    /// name of the cell attribute that holds the ranks of each cell
+    const std::string NODE_RANK = "Rank";
+
+    /// Writes the ranks of the cells in the given node-to-rank map as
+    /// attribute NODE_RANK of the given namespace. The map must contain
+    /// only cells of the given population and be the same on all
+    /// ranks, unless distributed is true, in which case each cell must
+    /// be in the map of exactly one rank. Collective on comm.
+    void append_node_rank_map
+    (
+     MPI_Comm               comm,
+     const std::string&     file_name,
+     const std::string&     name_space,
+     const std::string&     pop_name,
+     const CELL_IDX_T&      pop_start,
+     const node_rank_map_t& node_rank_map,
+     const size_t           io_size,
+     const bool             distributed = false
+     );
+
+    /// Reads the ranks of the cells of a population written by
+    /// append_node_rank_map, and adds them to the node-to-rank map on
+    /// all ranks. Collective on comm.
+    void read_node_rank_map
+    (
+     MPI_Comm               comm,
+     const std::string&     file_name,
+     const std::string&     name_space,
+     const std::string&     pop_name,
+     const CELL_IDX_T&      pop_start,
+     node_rank_map_t&       node_rank_map
+     );
+  }
+}
+
+#endif
@@ -0,0 +1,81 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file partition_graph_lp.hh
+///
+///  Distributed graph partitioning by size-constrained label propagation.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef PARTITION_GRAPH_LP_HH
+#define PARTITION_GRAPH_LP_HH
+
+#include "neuroh5_types.hh"
+
+#include <mpi.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+  /// @brief Partitions the nodes of the populations connected by the
+  ///        given projections so as to reduce the number of cut edges,
+  ///        while balancing both the number of nodes and the total
+  ///        in-degree of each partition. Starting from an initial
+  ///        partition, nodes repeatedly move to the partition to which
+  ///        most of their neighbors (in either edge direction) belong,
+  ///        as long as no partition exceeds its maximum load. In even
+  ///        rounds nodes only move to higher-numbered partitions and in
+  ///        odd rounds to lower-numbered ones, which prevents
+  ///        neighbors from swapping partitions back and forth. Each
+  ///        rank owns a contiguous range of nodes, and only the
+  ///        partitions of the neighbors of its nodes owned by other
+  ///        ranks are exchanged in each round.
+  ///
+  /// @param comm          MPI communicator
+  ///
+  /// @param file_name     Input file name
+  ///
+  /// @param prj_names     Source and destination populations of the
+  ///                      projections to be read
+  ///
+  /// @param io_size       Number of I/O ranks (those ranks that conduct I/O
+  ///                      operations)
+  ///
+  /// @param nparts        Number of partitions
+  ///
+  /// @param num_iterations Maximum number of label propagation rounds
+  ///
+  /// @param imbalance     Allowed relative excess of the node count and
+  ///                      in-degree of a partition over the average
+  ///
+  /// @param node_rank_map If not empty on entry, the initial partition of
+  ///                      every node; otherwise, the initial partition cuts
+  ///                      the nodes into contiguous ranges of equal weight.
+  ///                      Updated with the partition of every node, which
+  ///                      is gathered once all rounds are done.
+  ///
+  /// @param edge_cut      Updated with the number of edges between nodes in
+  ///                      different partitions
+  ///
+  /// @return              zero on success
+    int partition_graph_lp
+    (
+     MPI_Comm                                                 comm,
+     const std::string&                                       file_name,
+     const std::vector< std::pair<std::string, std::string> >& prj_names,
+     const size_t                                             io_size,
+     const size_t                                             nparts,
+     const size_t                                             num_iterations,
+     const double                                             imbalance,
+     node_rank_map_t&                                         node_rank_map,
+     size_t&                                                  edge_cut
+     );
+  }
+}
+
+#endif
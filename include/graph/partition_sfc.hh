@@ -0,0 +1,145 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file partition_sfc.hh
+///
+///  Partitioning of cells along space-filling curves through their
+///  coordinates.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef PARTITION_SFC_HH
+#define PARTITION_SFC_HH
+
+#include "neuroh5_types.hh"
+#include "path_names.hh"
+
+#include <mpi.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    enum SpaceFillingCurve
+      {
+        CurveHilbert,
+        CurveMorton
+      };
+
+    /// Number of bits per dimension of the grid on which curve keys are
+    /// computed.
+    const size_t sfc_bits = 21;
+
+    /// Position of grid point p (with coordinates of sfc_bits bits)
+    /// along the Morton (Z-order) curve.
+    uint64_t morton_key (const uint32_t p[3]);
+
+    /// Position of grid point p (with coordinates of sfc_bits bits)
+    /// along the Hilbert curve.
+    uint64_t hilbert_key (const uint32_t p[3]);
+
+    /// @brief Partitions cells into nparts parts of consecutive cells
+    ///        along a space-filling curve, so that the parts have nearly
+    ///        equal total weight. Collective on comm.
+    ///
+    /// @param comm          MPI communicator
+    ///
+    /// @param gids          Cells given on this rank; each cell must be given
+    ///                      on one rank only
+    ///
+    /// @param coords        x, y, z coordinates of each cell
+    ///
+    /// @param weights       Weight of each cell, or empty for unit weights
+    ///
+    /// @param nparts        Number of partitions
+    ///
+    /// @param curve         Space-filling curve along which cells are ordered
+    ///
+    /// @param node_rank_map Updated with the partition of the cells in the
+    ///                      parts p with p % size == rank; the assignment is
+    ///                      not replicated on all ranks. The scatter readers
+    ///                      require a replicated map, as returned by
+    ///                      replicate_node_rank_map.
+    void partition_sfc
+    (
+     MPI_Comm                       comm,
+     const std::vector<CELL_IDX_T>& gids,
+     const std::vector<COORD_T>&    coords,
+     const std::vector<double>&     weights,
+     const size_t                   nparts,
+     const SpaceFillingCurve        curve,
+     node_rank_map_t&               node_rank_map
+     );
+
+    /// @brief Partitions the cells of a population along a space-filling
+    ///        curve through their coordinates. If source populations are
+    ///        given, each cell is weighted by one plus its in-degree in
+    ///        the projections from these populations, as given by the
+    ///        destination pointers of the projections. The in-degree of
+    ///        each cell is summed on rank gid % size rather than over the
+    ///        whole population on every rank. Collective on comm.
+    ///
+    /// @param comm          MPI communicator
+    ///
+    /// @param file_name     Input file name
+    ///
+    /// @param coord_namespace Cell attribute namespace with the cell coordinates
+    ///
+    /// @param pop_name      Population name
+    ///
+    /// @param pop_start     Index of the first cell of the population
+    ///
+    /// @param src_pop_names Source populations of the projections to the given
+    ///                      population that determine the cell weights
+    ///
+    /// @param nparts        Number of partitions
+    ///
+    /// @param curve         Space-filling curve along which cells are ordered
+    ///
+    /// @param node_rank_map Updated with the partition of the cells in the
+    ///                      parts p with p % size == rank, as with
+    ///                      partition_sfc
+    ///
+    /// @param coord_names   Names of the x, y and z coordinate attributes
+    void partition_population_sfc
+    (
+     MPI_Comm                        comm,
+     const std::string&              file_name,
+     const std::string&              coord_namespace,
+     const std::string&              pop_name,
+     const CELL_IDX_T&               pop_start,
+     const std::vector<std::string>& src_pop_names,
+     const size_t                    nparts,
+     const SpaceFillingCurve         curve,
+     node_rank_map_t&                node_rank_map,
+     const std::vector<std::string>& coord_names = { hdf5::X_COORD, hdf5::Y_COORD, hdf5::Z_COORD }
+     );
+
+    /// @brief Gathers a node-to-rank map distributed over the ranks of
+    ///        comm, such as the result of partition_sfc, so that every
+    ///        rank holds the assignment of all cells. The scatter readers
+    ///        send the cells that are not in the map round-robin, so a
+    ///        distributed map must be replicated before it is passed to
+    ///        them; they also take the parts as ranks, so nparts must not
+    ///        exceed the number of ranks of the read. Collective on comm.
+    ///
+    /// @param comm          MPI communicator
+    ///
+    /// @param node_rank_map The cells assigned on this rank; updated with
+    ///                      the cells assigned on all ranks
+    void replicate_node_rank_map
+    (
+     MPI_Comm                       comm,
+     node_rank_map_t&               node_rank_map
+     );
+
+  }
+
+}
+
+#endif
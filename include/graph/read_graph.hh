@@ -12,6 +12,7 @@
 #define READ_GRAPH_HH
 
 #include "neuroh5_types.hh"
+#include "edge_attr_filter.hh"
 
 #include <mpi.h>
 
@@ -47,6 +48,9 @@ namespace neuroh5
     /// @param total_prj_num_edges  Updated with the total number of edges in
     ///                             the graph
     ///
+    /// @param edge_filter   Edge attributes to read and predicates that
+    ///                      edges must satisfy
+    ///
     /// @return              HDF5 error code
 
     extern int read_graph
@@ -59,7 +63,8 @@ namespace neuroh5
      vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
      size_t&                          total_num_nodes,
      size_t&                          local_prj_num_edges,
-     size_t&                          total_prj_num_edges
+     size_t&                          total_prj_num_edges,
+     const EdgeAttrFilter&            edge_filter = EdgeAttrFilter()
      );
   }
 }
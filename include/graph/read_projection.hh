@@ -12,6 +12,7 @@
 #define READ_PROJECTION_HH
 
 #include "neuroh5_types.hh"
+#include "edge_attr_filter.hh"
 
 #include <mpi.h>
 
@@ -58,6 +59,9 @@ namespace neuroh5
     ///
     /// @param src_idx       Source Index (source indices of edges)
     ///
+    /// @param edge_filter   Edge attributes to read and predicates that
+    ///                      edges must satisfy
+    ///
     /// @return              HDF5 error code
     extern herr_t read_projection
     (
@@ -79,7 +83,8 @@ namespace neuroh5
      hsize_t&                        total_read_blocks,
      size_t                          offset = 0,
      size_t                          numitems = 0,
-     bool collective = true
+     bool collective = true,
+     const EdgeAttrFilter&           edge_filter = EdgeAttrFilter()
      );
   }
 }
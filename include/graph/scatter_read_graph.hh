@@ -13,6 +13,7 @@
 #define SCATTER_READ_GRAPH_HH
 
 #include "neuroh5_types.hh"
+#include "edge_attr_filter.hh"
 #include "read_graph.hh"
 
 #include <mpi.h>
@@ -49,6 +50,9 @@ namespace neuroh5
     /// @param total_num_nodes  Updated with the total number of nodes
     ///                         (vertices) in the graph
     ///
+    /// @param edge_filter   Edge attributes to read and predicates that
+    ///                      edges must satisfy, evaluated on the I/O ranks
+    ///
     /// @return              HDF5 error code
     int scatter_read_graph
     (
@@ -63,7 +67,8 @@ namespace neuroh5
      std::vector < edge_map_t >& prj_vector,
      vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
      size_t &local_num_nodes, size_t &total_num_nodes,
-     size_t &local_num_edges, size_t &total_num_edges
+     size_t &local_num_edges, size_t &total_num_edges,
+     const EdgeAttrFilter& edge_filter = EdgeAttrFilter()
      );
   }
 }
@@ -13,6 +13,7 @@
 #define SCATTER_READ_PROJECTION_HH
 
 #include "neuroh5_types.hh"
+#include "edge_attr_filter.hh"
 
 #include <mpi.h>
 
@@ -40,7 +41,8 @@ namespace neuroh5
                                  std::vector < map <string, std::vector < std::vector<string> > > > & edge_attr_names_vector,
                                  size_t &local_num_nodes, size_t &local_num_edges, size_t &total_num_edges,
                                  hsize_t &total_read_blocks,
-                                 size_t offset = 0, size_t numitems = 0);
+                                 size_t offset = 0, size_t numitems = 0,
+                                 const EdgeAttrFilter& edge_filter = EdgeAttrFilter());
   }
 }
 
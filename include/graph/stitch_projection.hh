@@ -0,0 +1,72 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_projection.hh
+///
+///  Combines the edges of a projection written to separate part files
+///  into one projection of a master file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef STITCH_PROJECTION_HH
+#define STITCH_PROJECTION_HH
+
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// @brief Creates a projection in file_name that contains the edges
+    ///        of the same projection in the part files. Collective on
+    ///        comm.
+    ///
+    /// As with cell::stitch_cell_attributes, the parts are written
+    /// beforehand by the caller, for instance by each I/O group with
+    /// append_graph on a communicator of its own and a part file name
+    /// of its own; this function only combines them.
+    ///
+    /// The destination block index, the source index and the edge
+    /// attributes become virtual datasets over the parts, in the order
+    /// of part_file_names, and the destination block pointers and
+    /// destination pointers are copied, rebased to the positions of
+    /// the parts. Parts without the projection are skipped; the other
+    /// parts must all have the same edge attributes. The parts must be
+    /// kept with the master file, unless copy_parts is true, in which
+    /// case the part datasets are copied into the master file as
+    /// stored, without decompressing them. An existing projection of
+    /// the same populations in file_name is replaced, and the new
+    /// projection can be read but not appended to.
+    ///
+    /// @param comm             MPI communicator
+    ///
+    /// @param file_name        Master file, which must contain the
+    ///                         population and projection definitions
+    ///
+    /// @param part_file_names  Part files, in order
+    ///
+    /// @param src_pop_name     Source population name
+    ///
+    /// @param dst_pop_name     Destination population name
+    ///
+    /// @param copy_parts       Copy the part datasets into file_name
+    void stitch_projection
+    (
+     MPI_Comm                        comm,
+     const std::string&              file_name,
+     const std::vector<std::string>& part_file_names,
+     const std::string&              src_pop_name,
+     const std::string&              dst_pop_name,
+     const bool                      copy_parts = false
+     );
+
+  }
+}
+
+#endif
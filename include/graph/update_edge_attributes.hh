@@ -0,0 +1,77 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file update_edge_attributes.hh
+///
+///  Functions for overwriting the edge attributes of an existing
+///  projection in place, without rewriting its DBS (Destination Block
+///  Sparse) arrays.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef UPDATE_EDGE_ATTRIBUTES_HH
+#define UPDATE_EDGE_ATTRIBUTES_HH
+
+#include "neuroh5_types.hh"
+#include "attr_index.hh"
+
+#include <mpi.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// @brief Overwrites edge attribute values of an existing projection
+    ///        in place. Collective on comm; ranks without edges pass an
+    ///        empty edge map.
+    ///
+    /// The edge positions in the file are determined from the DBS
+    /// destination pointers of the projection, so edge_map must be
+    /// keyed by destination and hold, for each of its destinations, all
+    /// edges of that destination in file order, such as the edge maps
+    /// returned by read_graph or scatter_read_graph without edge
+    /// predicates. Each destination must be held by at most one rank.
+    ///
+    /// @param comm             MPI communicator
+    ///
+    /// @param file_name        File that contains the projection
+    ///
+    /// @param src_pop_name     Source population name
+    ///
+    /// @param dst_pop_name     Destination population name
+    ///
+    /// @param edge_attr_index  Attributes to write: for each namespace
+    ///                         in the file, the position of its values in
+    ///                         the attribute vector of the edge tuples and
+    ///                         the names of its attributes. A namespace or
+    ///                         attribute that does not exist yet is
+    ///                         created with one (zero-initialized) value
+    ///                         per edge of the projection, so that values
+    ///                         read from one namespace can be written to
+    ///                         a new one that shares the same edges.
+    ///
+    /// @param edge_map         Edges whose attribute values are written
+    ///
+    /// @param chunk_size       Chunk size of created attribute datasets
+    ///
+    /// @return                 HDF5 error code
+    int update_edge_attributes
+    (
+     MPI_Comm                 comm,
+     const std::string&       file_name,
+     const std::string&       src_pop_name,
+     const std::string&       dst_pop_name,
+     const std::map <std::string, std::pair <size_t, data::AttrIndex > >& edge_attr_index,
+     const edge_map_t&        edge_map,
+     const size_t             chunk_size = 4000
+     );
+
+  }
+}
+
+#endif
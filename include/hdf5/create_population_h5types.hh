@@ -0,0 +1,51 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file create_population_h5types.hh
+///
+///  Creates the population definitions of a NeuroH5 file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef CREATE_POPULATION_H5TYPES_HH
+#define CREATE_POPULATION_H5TYPES_HH
+
+#include <hdf5.h>
+
+#include <set>
+#include <utility>
+
+#include "neuroh5_types.hh"
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    /// @brief Creates the H5Types group of a file with the population
+    ///        label enumeration, the population ranges and the valid
+    ///        population projections, in the layout read by
+    ///        cell::read_population_labels, read_population_ranges and
+    ///        read_population_combos. Not collective; the file must be
+    ///        open for writing by a single process.
+    ///
+    /// @param file        File handle
+    ///
+    /// @param pop_labels  Population index and name of each population
+    ///
+    /// @param pop_ranges  Range of each population, by population index
+    ///
+    /// @param pop_pairs   Valid (source, destination) population pairs
+    ///
+    /// @return            0 on success
+    int create_population_h5types
+    (
+     hid_t                                        file,
+     const pop_label_map_t&                       pop_labels,
+     const pop_range_map_t&                       pop_ranges,
+     const std::set< std::pair<pop_t, pop_t> >&   pop_pairs
+     );
+  }
+}
+
+#endif
@@ -2,7 +2,9 @@
 #define FILE_ACCESS_HH
 
 #include "hdf5.h"
+#include <mpi.h>
 
+#include <string>
 #include <vector>
 
 namespace neuroh5
@@ -27,6 +29,34 @@ namespace neuroh5
      hid_t &file
      );
 
+    /*****************************************************************************
+     * Property lists for reading with the ranks of a communicator.  A
+     * communicator with a single rank reads through the POSIX (sec2)
+     * driver with a large sieve buffer and chunk cache and independent
+     * transfers, bypassing the MPI-IO layer; larger communicators use
+     * the MPI-IO driver with collective transfers.
+     *****************************************************************************/
+
+    /// Size of the data sieve buffer and of the chunk cache of files
+    /// read by a single rank.
+    const size_t SERIAL_SIEVE_BUF_SIZE = 4*1024*1024;
+    const size_t SERIAL_CHUNK_CACHE_SIZE = 64*1024*1024;
+
+    bool is_serial_comm
+    (
+     MPI_Comm comm
+     );
+
+    hid_t read_access_plist
+    (
+     MPI_Comm comm
+     );
+
+    hid_t read_transfer_plist
+    (
+     MPI_Comm comm
+     );
+
     int what_is_open(hid_t fid, int mask=H5F_OBJ_ALL) ;
 
     
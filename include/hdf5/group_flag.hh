@@ -0,0 +1,59 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file group_flag.hh
+///
+///  Boolean flags stored as HDF5 attributes of a group, used to record
+///  properties of the datasets in the group (e.g. that a cell attribute
+///  namespace is sorted by cell index).
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef GROUP_FLAG_HH
+#define GROUP_FLAG_HH
+
+#include "hdf5.h"
+
+#include <string>
+
+namespace neuroh5
+{
+
+  namespace hdf5
+  {
+    /*****************************************************************************
+     * Returns true if the group has the given flag set; false if the
+     * group or the flag do not exist
+     *****************************************************************************/
+    bool get_group_flag
+    (
+     hid_t  loc,
+     const std::string& path,
+     const std::string& name
+     );
+
+    /*****************************************************************************
+     * Sets a flag of an existing group. Collective if the file was
+     * opened for parallel access.
+     *****************************************************************************/
+    herr_t set_group_flag
+    (
+     hid_t  loc,
+     const std::string& path,
+     const std::string& name
+     );
+
+    /*****************************************************************************
+     * Removes a flag of a group, if the group and the flag exist.
+     * Collective if the file was opened for parallel access.
+     *****************************************************************************/
+    herr_t clear_group_flag
+    (
+     hid_t  loc,
+     const std::string& path,
+     const std::string& name
+     );
+  }
+}
+
+#endif
@@ -13,6 +13,7 @@
 #include "exists_group.hh"
 #include "file_access.hh"
 #include "read_template.hh"
+#include "thread_pool.hh"
 #include "write_template.hh"
 #include "sort_permutation.hh"
 #include "throw_assert.hh"
@@ -70,7 +71,10 @@ namespace neuroh5
      std::vector<ATTR_PTR_T> & value_ptr,
      std::vector<T> &          value,
      size_t offset = 0,
-     size_t numitems = 0
+     size_t numitems = 0,
+     // if not NULL, the values are decompressed on the threads of
+     // pool, which is created once by the top-level read
+     data::thread_pool* pool = NULL
      )
     {
       herr_t status = 0;
@@ -110,11 +114,7 @@ namespace neuroh5
           hsize_t block = end - start;
     
           /* Create property list for collective dataset operations. */
-          hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-          
-          status = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-          throw_assert(status >= 0,
-                       "read_cell_attribute: error in H5Pset_dxpl_mpio");
+          hid_t rapl = read_transfer_plist(comm);
           
           string value_path = path + "/" + ATTR_VAL;
 
@@ -151,7 +151,7 @@ namespace neuroh5
           
           value.resize(value_block, 0);
           status = read<T> (loc, value_path, value_start, value_block,
-                            ntype, value, rapl);
+                            ntype, value, rapl, pool);
           
           throw_assert(H5Tclose(ntype)  >= 0, "error in H5Tclose");
           status = H5Pclose(rapl);
@@ -175,7 +175,10 @@ namespace neuroh5
      const std::vector<ATTR_PTR_T>&  ptr,
      std::vector<CELL_IDX_T> & selection_index,
      std::vector<ATTR_PTR_T> & selection_ptr,
-     std::vector<T> &          values
+     std::vector<T> &          values,
+     // true if the index is known to be unique and in ascending
+     // order, e.g. after compact_cell_attributes
+     const bool                sorted = false
      )
     {
       herr_t status = 0;
@@ -189,6 +192,7 @@ namespace neuroh5
       
       hsize_t dset_size = index.size();
       vector< pair<hsize_t,hsize_t> > ranges;
+      vector<ptrdiff_t> selection_pos;
 
       auto compare_idx = [](const CELL_IDX_T& a, const CELL_IDX_T& b) { return (a < b); };
       
@@ -198,7 +202,45 @@ namespace neuroh5
           string value_path = path + "/" + ATTR_VAL;
 
           ATTR_PTR_T selection_ptr_pos = 0;
-          if (ptr.size() > 0)
+          if ((ptr.size() > 0) && sorted)
+            {
+              // the index can be searched directly, and the values of
+              // consecutive cells are adjacent in the value dataset
+              vector<CELL_IDX_T> sorted_selection(selection);
+              std::sort(sorted_selection.begin(), sorted_selection.end());
+              sorted_selection.erase(std::unique(sorted_selection.begin(), sorted_selection.end()),
+                                     sorted_selection.end());
+
+              auto it = index.begin();
+              for (const CELL_IDX_T& s : sorted_selection)
+                {
+                  if (s < pop_start) continue;
+                  it = std::lower_bound(it, index.end(), s);
+                  if (it == index.end()) break;
+                  if (*it != s) continue;
+
+                  ptrdiff_t pos = it - index.begin();
+                  hsize_t value_start=ptr[pos];
+                  hsize_t value_block=ptr[pos+1]-value_start;
+
+                  selection_index.push_back(s);
+                  selection_ptr.push_back(selection_ptr_pos);
+                  selection_ptr_pos += value_block;
+
+                  if (value_block == 0) continue;
+                  if ((ranges.size() > 0) &&
+                      (ranges.back().first + ranges.back().second == value_start))
+                    {
+                      ranges.back().second += value_block;
+                    }
+                  else
+                    {
+                      ranges.push_back(make_pair(value_start, value_block));
+                    }
+                }
+              selection_ptr.push_back(selection_ptr_pos);
+            }
+          else if (ptr.size() > 0)
             {
 	      vector<size_t> p = data::sort_permutation(index, compare_idx);
 	      std::vector<CELL_IDX_T> sorted_index = data::apply_permutation(index, p);
@@ -216,14 +258,19 @@ namespace neuroh5
 
                       ranges.push_back(make_pair(value_start, value_block));
                       selection_index.push_back(s);
+                      selection_pos.push_back(pos);
                     }
                 }
           
 
-	      auto compare_range_idx = [](const std::pair<hsize_t, hsize_t>& a, const std::pair<hsize_t, hsize_t>& b) 
-		{ return (a.first < b.first); };
+              // order by position in the index rather than by value
+              // offset, since cells without values share their offset
+              // with the next cell, and the order must be the same for
+              // all attributes with the same index
+	      auto compare_pos = [](const ptrdiff_t& a, const ptrdiff_t& b) 
+		{ return (a < b); };
 	  
-	      vector<size_t> range_sort_p = data::sort_permutation(ranges, compare_range_idx);
+	      vector<size_t> range_sort_p = data::sort_permutation(selection_pos, compare_pos);
 	      
 	      data::apply_permutation_in_place(selection_index, range_sort_p);
 	      data::apply_permutation_in_place(ranges, range_sort_p);
@@ -248,11 +295,7 @@ namespace neuroh5
           throw_assert(H5Dclose(dset)   >= 0, "error in H5Dclose");
 
           /* Create property list for collective dataset operations. */
-          hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-
-          status = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-          throw_assert(status >= 0,
-                       "read_cell_attribute_selection: error in H5Pset_dxpl_mpio");
+          hid_t rapl = read_transfer_plist(comm);
               
           values.resize(selection_ptr_pos, 0);
 
@@ -15,6 +15,8 @@ namespace neuroh5
     const std::string H5_TYPES    = "H5Types";
     const std::string POP_LABELS  = "Population labels";
     const std::string POP_COMBS   = "Valid population projections";
+    const std::string POP_RANGE   = "Population range";
+    const std::string POP_PRJ_TYPE = "Population projections";
   
     const std::string TREES      = "Trees";
     const std::string X_COORD    = "X Coordinate";
@@ -30,11 +32,27 @@ namespace neuroh5
     const std::string CELL_INDEX = "Cell Index";
     const std::string NODE_INDEX = "Node Index";
 
+    // morphology templates shared by many cells: the templates are
+    // stored in the Trees layout, indexed by template id, and each cell
+    // refers to a template and an optional translation
+    const std::string TREE_TEMPLATES      = "Tree Templates";
+    const std::string TREE_TEMPLATE_INDEX = "Tree Template Index";
+    const std::string TEMPLATE_ID         = "Template";
+    const std::string TEMPLATE_OFFSET     = "Template Offset";
+
     const std::string ATTR_PTR   = "Attribute Pointer";
     const std::string TOPO_PTR   = "Topology Pointer";
     const std::string SEC_PTR    = "Section Pointer";
     const std::string ATTR_VAL   = "Attribute Value";
 
+    // flag of a cell attribute namespace whose attributes have unique
+    // cell indices in ascending order
+    const std::string SORTED     = "Sorted";
+
+    // group of the datasets of part files copied into a file whose
+    // virtual datasets combine them
+    const std::string PARTS      = "Parts";
+
     const std::string DST_BLK_PTR = "Destination Block Pointer";
     const std::string DST_BLK_IDX = "Destination Block Index";
     const std::string DST_PTR     = "Destination Pointer";
@@ -0,0 +1,64 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file read_chunks.hh
+///
+///  Reads compressed one-dimensional datasets chunk by chunk, decompressing
+///  the chunks on the worker threads of a rank.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef READ_CHUNKS_HH
+#define READ_CHUNKS_HH
+
+#include <hdf5.h>
+
+#include <utility>
+#include <vector>
+
+#include "thread_pool.hh"
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    /// Returns true if read_chunks can read the dataset with the given
+    /// memory type using the threads of pool: the pool has more than
+    /// one thread, the dataset is one-dimensional, chunked and
+    /// compressed with deflate, optionally after shuffle, its file type
+    /// is the memory type, and the file is not accessed through MPI-IO,
+    /// which does not support direct chunk reads. The result depends
+    /// only on the dataset and file, so all ranks of a collective read
+    /// agree on it.
+    ///
+    /// As a consequence, reads of files opened by more than one rank of
+    /// a parallel HDF5 build always use H5Dread and decompress on the
+    /// calling thread; the threads of the pool are only used by serial
+    /// builds and by reads on a single-rank communicator, which open
+    /// the file with the sec2 driver (see read_access_plist).
+    bool can_read_chunks
+    (
+     hid_t               dset,
+     hid_t               ntype,
+     data::thread_pool&  pool
+     );
+
+    /// Reads the elements in the given (start, count) ranges of dset
+    /// into consecutive positions of buf. The stored chunks are fetched
+    /// with H5Dread_chunk by the calling thread and inflated in parallel
+    /// on the threads of pool directly into buf; unallocated chunks are
+    /// read as the fill value. The dataset must satisfy can_read_chunks.
+    herr_t read_chunks
+    (
+     hid_t                                            dset,
+     hid_t                                            ntype,
+     const std::vector< std::pair<hsize_t,hsize_t> >& ranges,
+     void*                                            buf,
+     data::thread_pool&                               pool
+     );
+
+  }
+}
+
+#endif
@@ -9,6 +9,7 @@
 //==============================================================================
 
 #include "neuroh5_types.hh"
+#include "thread_pool.hh"
 
 using namespace std;
 
@@ -18,7 +19,9 @@ namespace neuroh5
   {
     
     /**************************************************************************
-     * Read the basic DBS graph structure
+     * Read the basic DBS graph structure. If pool is not NULL, compressed
+     * datasets are decompressed on its threads (see hdf5::read_chunks);
+     * the pool is created once by the top-level read.
      *************************************************************************/
 
     herr_t read_projection_datasets
@@ -38,7 +41,8 @@ namespace neuroh5
      hsize_t&                   local_read_blocks,
      size_t                     offset = 0,
      size_t                     numitems = 0,
-     bool collective = true
+     bool collective = true,
+     data::thread_pool*         pool = NULL
      );
 
     herr_t read_projection_node_datasets
@@ -52,7 +56,8 @@ namespace neuroh5
      vector<DST_BLK_PTR_T>&     dst_blk_ptr,
      vector<NODE_IDX_T>&        dst_idx,
      vector<DST_PTR_T>&         dst_ptr,
-     bool collective = true
+     bool collective = true,
+     data::thread_pool*         pool = NULL
      );
 
   }
@@ -8,6 +8,8 @@
 #include <cstdio>
 
 #include "exists_dataset.hh"
+#include "read_chunks.hh"
+#include "thread_pool.hh"
 #include "throw_assert.hh"
 
 
@@ -25,7 +27,10 @@ namespace neuroh5
      const hsize_t&     len,
      hid_t              ntype,
      std::vector<T>&    v,
-     hid_t rapl
+     hid_t rapl,
+     // if given, eligible compressed datasets are decompressed on
+     // the threads of the pool (see can_read_chunks)
+     data::thread_pool* pool = NULL
      )
     {
       herr_t ierr = 0;
@@ -59,7 +64,15 @@ namespace neuroh5
 	    }
 	  throw_assert(ierr >= 0,
                        "hdf5::read: error in H5Sselect_hyperslab");
-	  ierr = H5Dread(dset, ntype, mspace, fspace, rapl, v.data());
+	  if ((pool != NULL) && can_read_chunks(dset, ntype, *pool))
+	    {
+	      std::vector< std::pair<hsize_t,hsize_t> > ranges(1, std::make_pair(start, len));
+	      ierr = read_chunks(dset, ntype, ranges, v.data(), *pool);
+	    }
+	  else
+	    {
+	      ierr = H5Dread(dset, ntype, mspace, fspace, rapl, v.data());
+	    }
 	  throw_assert(ierr >= 0,
                        "hdf5::read: error in H5Dread");
 	  
@@ -83,7 +96,10 @@ namespace neuroh5
      hid_t              ntype,
      const std::vector< std::pair<hsize_t,hsize_t> >& ranges,
      std::vector<T>&    v,
-     hid_t rapl
+     hid_t rapl,
+     // if given, eligible compressed datasets are decompressed on
+     // the threads of the pool (see can_read_chunks)
+     data::thread_pool* pool = NULL
      )
     {
       hsize_t len = 0;
@@ -134,7 +150,7 @@ namespace neuroh5
 		}
 	      else
 		{
-		  vector <hsize_t> coords;
+		  std::vector <hsize_t> coords;
 		  for (const auto& range : ranges)
 		    {
 		      hsize_t start = range.first;
@@ -158,7 +174,14 @@ namespace neuroh5
 	    }
 
           v.resize(len);
-	  ierr = H5Dread(dset, ntype, mspace, fspace, rapl, v.data());
+	  if ((pool != NULL) && can_read_chunks(dset, ntype, *pool))
+	    {
+	      ierr = read_chunks(dset, ntype, ranges, v.data(), *pool);
+	    }
+	  else
+	    {
+	      ierr = H5Dread(dset, ntype, mspace, fspace, rapl, v.data());
+	    }
 	  throw_assert(ierr >= 0,
                        "hdf5::read_selection: error in H5Dread");
 	  
@@ -0,0 +1,95 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_datasets.hh
+///
+///  Datasets of a file that combine the datasets of the same path in a
+///  sequence of part files: concatenations of the part datasets as
+///  HDF5 virtual datasets, and concatenations of part pointer datasets
+///  with rebased pointer values.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef STITCH_DATASETS_HH
+#define STITCH_DATASETS_HH
+
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    /*****************************************************************************
+     * Creates a virtual dataset at path that concatenates the
+     * one-dimensional datasets at the same path in the part files, in
+     * the given order. Parts of size zero are skipped and need not
+     * contain the dataset. Part files in the directory of file_name are
+     * referred to by their base name, so that the files can be moved
+     * together. If copy_parts is true, the part datasets are first
+     * copied into the PARTS group of file, chunk by chunk without
+     * decompressing them, and the virtual dataset refers to the
+     * copies, so that the part files are no longer needed.
+     *****************************************************************************/
+    herr_t create_stitched_dataset
+    (
+     hid_t                           file,
+     const std::string&              file_name,
+     const std::string&              path,
+     hid_t                           ftype,
+     const std::vector<std::string>& part_file_names,
+     const std::vector<hsize_t>&     part_sizes,
+     const bool                      copy_parts = false
+     );
+
+    /*****************************************************************************
+     * Removes the group at path, if it exists, together with the copies
+     * of part datasets made for it by create_stitched_dataset
+     *****************************************************************************/
+    herr_t remove_stitched_group
+    (
+     hid_t              file,
+     const std::string& path
+     );
+
+    /*****************************************************************************
+     * Creates the dataset at path for the concatenation of the pointer
+     * datasets of the parts; part_sizes are the numbers of pointers of
+     * the parts without the final pointer, which only the last
+     * non-empty part contributes.
+     *****************************************************************************/
+    herr_t create_stitched_pointer_dataset
+    (
+     hid_t                       file,
+     const std::string&          path,
+     hid_t                       ftype,
+     const std::vector<hsize_t>& part_sizes,
+     const hsize_t               chunk_size = 4000
+     );
+
+    /*****************************************************************************
+     * Reads the pointer datasets at path of the part files, adds
+     * part_offsets[p] to the pointers of part p, and writes them to the
+     * dataset created by create_stitched_pointer_dataset. Collective on
+     * comm: each rank reads a contiguous range of parts with independent
+     * I/O and writes the corresponding contiguous range of the dataset.
+     *****************************************************************************/
+    void write_stitched_pointers
+    (
+     MPI_Comm                        comm,
+     hid_t                           file,
+     const std::string&              path,
+     const std::vector<std::string>& part_file_names,
+     const std::vector<hsize_t>&     part_sizes,
+     const std::vector<uint64_t>&    part_offsets
+     );
+
+  }
+}
+
+#endif
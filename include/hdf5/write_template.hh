@@ -93,6 +93,83 @@ namespace neuroh5
       }
 
 
+    /// Writes values to the given ranges (start, count) of an existing
+    /// dataset. The ranges must be sorted by start and must not overlap,
+    /// and v holds the values of the ranges in that order.
+    template<class T>
+      herr_t write_selection
+      (
+       const hid_t&       loc,
+       const std::string& name,
+       const hid_t&       ntype,
+       const std::vector< std::pair<hsize_t,hsize_t> >& ranges,
+       const std::vector<T>&    v,
+       const hid_t        wapl
+       )
+      {
+        herr_t ierr = 0;
+
+        hsize_t len = 0;
+        for (const auto& range : ranges)
+          {
+            len += range.second;
+          }
+        throw_assert(len == v.size(),
+                     "write_selection: number of values does not match the selection of dataset " << name);
+
+        hid_t dset = H5Dopen2(loc, name.c_str(), H5P_DEFAULT);
+        throw_assert(dset >= 0,
+                     "write_selection: unable to open dataset " << name);
+
+        hid_t fspace = H5Dget_space(dset);
+        throw_assert(fspace >= 0, "error in H5Dget_space");
+        hid_t mspace = H5Screate_simple(1, &len, NULL);
+        throw_assert(mspace >= 0, "error in H5Screate_simple");
+
+        if (len > 0)
+          {
+            bool first_iter = true;
+            hsize_t one = 1;
+            for (const auto& range : ranges)
+              {
+                if (range.second == 0)
+                  continue;
+                ierr = H5Sselect_hyperslab(fspace, first_iter ? H5S_SELECT_SET : H5S_SELECT_OR,
+                                           &range.first, NULL, &one, &range.second);
+                throw_assert(ierr >= 0,
+                             "write_selection: unable to select hyperslab "
+                             << range.first << ":" << range.second << " from dataset " << name);
+                first_iter = false;
+              }
+            ierr = H5Sselect_all(mspace);
+            throw_assert(ierr >= 0,
+                         "write_selection: error in H5Sselect_all on dataset " << name);
+          }
+        else
+          {
+            ierr = H5Sselect_none(fspace);
+            throw_assert(ierr >= 0,
+                         "write_selection: error in H5Sselect_none on dataset " << name);
+            ierr = H5Sselect_none(mspace);
+            throw_assert(ierr >= 0,
+                         "write_selection: error in H5Sselect_none on dataset " << name);
+          }
+
+        T dummy;
+        ierr = H5Dwrite(dset, ntype, mspace, fspace, wapl, (len > 0) ? &v[0] : &dummy);
+        throw_assert(ierr >= 0, "write_selection: error in H5Dwrite on dataset " << name);
+
+        ierr = H5Sclose(mspace);
+        throw_assert(ierr >= 0, "error in H5Sclose");
+        ierr = H5Sclose(fspace);
+        throw_assert(ierr >= 0, "error in H5Sclose");
+        ierr = H5Dclose(dset);
+        throw_assert(ierr >= 0, "error in H5Dclose");
+
+        return ierr;
+      }
+
+
   }
 }
 
@@ -0,0 +1,53 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mapped_file.hh
+///
+///  Read-only memory mapping of a byte range of a file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef MAPPED_FILE_HH
+#define MAPPED_FILE_HH
+
+#include <cstddef>
+#include <string>
+
+namespace neuroh5
+{
+  namespace io
+  {
+
+    /// Returns the size in bytes of the given file.
+    size_t file_size (const std::string& file_name);
+
+    /// Maps bytes [offset, offset+length) of a file read-only into
+    /// memory; the mapping is released when the object is destroyed.
+    /// A length that extends past the end of the file is truncated.
+    class mapped_file
+    {
+    public:
+      mapped_file (const std::string& file_name, size_t offset, size_t length);
+      mapped_file (const std::string& file_name);
+      ~mapped_file ();
+
+      const char* begin () const { return data_begin; }
+      const char* end () const { return data_end; }
+      size_t size () const { return data_end - data_begin; }
+
+    private:
+      mapped_file (const mapped_file&);
+      mapped_file& operator= (const mapped_file&);
+
+      void map (const std::string& file_name, size_t offset, size_t length);
+
+      void*        map_addr;
+      size_t       map_length;
+      const char*  data_begin;
+      const char*  data_end;
+    };
+
+  }
+}
+
+#endif
@@ -0,0 +1,58 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file read_txt_edges.hh
+///
+///  Parallel reading of edge lists in text format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef READ_TXT_EDGES_HH
+#define READ_TXT_EDGES_HH
+
+#include <mpi.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+
+namespace neuroh5
+{
+  namespace io
+  {
+    /// @brief Reads edges from one or more text files, each line of
+    ///        which holds a destination index, a source index, and the
+    ///        attribute values for each namespace in num_attrs (in
+    ///        namespace order, and by type in the order float, uint8,
+    ///        uint16, uint32, int8, int16, int32). The total number of bytes in all files is split
+    ///        evenly over the ranks of comm, and each rank parses the
+    ///        lines that start in its byte range. Collective on comm.
+    ///
+    /// @param comm            MPI communicator
+    ///
+    /// @param file_names      Input file names
+    ///
+    /// @param num_attrs       Number of attributes of each type, for
+    ///                        each attribute namespace
+    ///
+    /// @param dst             Destination indices, one per edge
+    ///
+    /// @param src             Source indices, one per edge
+    ///
+    /// @param edge_attr_map   Attribute columns for each namespace
+    ///
+    /// @return                zero on success
+    int read_txt_edges (MPI_Comm                                    comm,
+                        const std::vector<std::string>&             file_names,
+                        const std::map <std::string, std::vector <size_t> >&  num_attrs,
+                        std::vector <NODE_IDX_T>&                   dst,
+                        std::vector <NODE_IDX_T>&                   src,
+                        std::map <std::string, neuroh5::data::NamedAttrVal>& edge_attr_map);
+
+  }
+}
+
+#endif
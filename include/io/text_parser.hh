@@ -0,0 +1,239 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file text_parser.hh
+///
+///  Minimal numeric parsers for whitespace-separated text records held
+///  in memory (e.g. memory-mapped edge lists and SWC files).
+///
+///  All parsers take a cursor and the end of the buffer, skip leading
+///  blanks (but not newlines), and advance the cursor past the parsed
+///  value. They return false without consuming a newline if no value
+///  is present on the current line, or if the value is outside the
+///  range of the result type.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef TEXT_PARSER_HH
+#define TEXT_PARSER_HH
+
+#include <cstdint>
+#include <cmath>
+#include <limits>
+
+namespace neuroh5
+{
+  namespace io
+  {
+
+    inline bool is_blank (const char c)
+    {
+      return (c == ' ') || (c == '\t') || (c == '\r') || (c == ',');
+    }
+
+    inline void skip_blanks (const char*& p, const char* end)
+    {
+      while ((p < end) && is_blank(*p))
+        {
+          p++;
+        }
+    }
+
+    /// Advances the cursor past the next newline, or to the end of the
+    /// buffer.
+    inline void skip_line (const char*& p, const char* end)
+    {
+      while ((p < end) && (*p != '\n'))
+        {
+          p++;
+        }
+      if (p < end)
+        {
+          p++;
+        }
+    }
+
+    /// Returns true if the rest of the current line is blank or a
+    /// comment starting with '#'.
+    inline bool is_empty_line (const char* p, const char* end)
+    {
+      skip_blanks(p, end);
+      return (p == end) || (*p == '\n') || (*p == '#');
+    }
+
+    /// Returns true if the next value on the current line starts with
+    /// a digit or a sign.
+    inline bool is_number_next (const char* p, const char* end)
+    {
+      skip_blanks(p, end);
+      if ((p < end) && ((*p == '-') || (*p == '+')))
+        {
+          p++;
+        }
+      return (p < end) && (*p >= '0') && (*p <= '9');
+    }
+
+    inline bool parse_uint (const char*& p, const char* end, uint64_t& value)
+    {
+      skip_blanks(p, end);
+      if ((p < end) && (*p == '+'))
+        {
+          p++;
+        }
+      if ((p == end) || (*p < '0') || (*p > '9'))
+        {
+          return false;
+        }
+      uint64_t v = 0;
+      bool overflow = false;
+      while ((p < end) && (*p >= '0') && (*p <= '9'))
+        {
+          const uint64_t digit = (uint64_t)(*p - '0');
+          overflow = overflow || (v > (std::numeric_limits<uint64_t>::max() - digit) / 10);
+          v = v*10 + digit;
+          p++;
+        }
+      value = v;
+      return !overflow;
+    }
+
+    inline bool parse_int (const char*& p, const char* end, int64_t& value)
+    {
+      skip_blanks(p, end);
+      bool negative = false;
+      if ((p < end) && ((*p == '-') || (*p == '+')))
+        {
+          negative = (*p == '-');
+          p++;
+        }
+      uint64_t v = 0;
+      if (!parse_uint(p, end, v))
+        {
+          return false;
+        }
+      const uint64_t max_magnitude = (uint64_t)std::numeric_limits<int64_t>::max() +
+        (negative ? 1 : 0);
+      if (v > max_magnitude)
+        {
+          return false;
+        }
+      value = negative ? (int64_t)(0 - v) : (int64_t)v;
+      return true;
+    }
+
+    /// Parses a decimal floating point number with optional fraction
+    /// and exponent. The result is exact for up to 19 significant
+    /// digits and decimal exponents within the range of exact powers
+    /// of ten in double precision.
+    inline bool parse_double (const char*& p, const char* end, double& value)
+    {
+      static const double exact_powers[] =
+        { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+          1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+      skip_blanks(p, end);
+      bool negative = false;
+      if ((p < end) && ((*p == '-') || (*p == '+')))
+        {
+          negative = (*p == '-');
+          p++;
+        }
+
+      uint64_t mantissa = 0;
+      int exp10 = 0, num_digits = 0;
+      bool has_digits = false;
+      while ((p < end) && (*p >= '0') && (*p <= '9'))
+        {
+          if (num_digits < 19)
+            {
+              mantissa = mantissa*10 + (uint64_t)(*p - '0');
+              if (mantissa > 0) num_digits++;
+            }
+          else
+            {
+              exp10++;
+            }
+          has_digits = true;
+          p++;
+        }
+      if ((p < end) && (*p == '.'))
+        {
+          p++;
+          while ((p < end) && (*p >= '0') && (*p <= '9'))
+            {
+              if (num_digits < 19)
+                {
+                  mantissa = mantissa*10 + (uint64_t)(*p - '0');
+                  if (mantissa > 0) num_digits++;
+                  exp10--;
+                }
+              has_digits = true;
+              p++;
+            }
+        }
+      if (!has_digits)
+        {
+          return false;
+        }
+      if ((p < end) && ((*p == 'e') || (*p == 'E')))
+        {
+          const char* q = p+1;
+          int64_t e = 0;
+          if (parse_int(q, end, e))
+            {
+              exp10 += (int)e;
+              p = q;
+            }
+        }
+
+      double v = (double)mantissa;
+      if ((exp10 >= 0) && (exp10 <= 22))
+        {
+          v *= exact_powers[exp10];
+        }
+      else if ((exp10 < 0) && (exp10 >= -22))
+        {
+          v /= exact_powers[-exp10];
+        }
+      else
+        {
+          v *= std::pow(10.0, (double)exp10);
+        }
+      value = negative ? -v : v;
+      return true;
+    }
+
+    template <class T>
+    inline bool parse_unsigned (const char*& p, const char* end, T& value)
+    {
+      uint64_t v;
+      if (!parse_uint(p, end, v)) return false;
+      if (v > (uint64_t)std::numeric_limits<T>::max()) return false;
+      value = (T)v;
+      return true;
+    }
+
+    template <class T>
+    inline bool parse_signed (const char*& p, const char* end, T& value)
+    {
+      int64_t v;
+      if (!parse_int(p, end, v)) return false;
+      if ((v < (int64_t)std::numeric_limits<T>::min()) ||
+          (v > (int64_t)std::numeric_limits<T>::max())) return false;
+      value = (T)v;
+      return true;
+    }
+
+    template <class T>
+    inline bool parse_real (const char*& p, const char* end, T& value)
+    {
+      double v;
+      if (!parse_double(p, end, v)) return false;
+      value = (T)v;
+      return true;
+    }
+
+  }
+}
+
+#endif
@@ -16,6 +16,7 @@
 #include <map>
 
 #include "mpi_debug.hh"
+#include "mpi_trace.hh"
 #include "throw_assert.hh"
 #include "neuroh5_types.hh"
 #include "attr_map.hh"
@@ -49,6 +50,7 @@ namespace neuroh5
       rank = srank;
       size = ssize;
 
+      trace_scope trace("alltoallv");
       
     /***************************************************************************
      * Send MPI data with Alltoallv 
@@ -87,6 +89,8 @@ namespace neuroh5
 
       //assert(recvbuf_size > 0);
       recvbuf.resize(recvbuf_size, 0);
+      trace.add_items(recvbuf_size);
+      trace.add_bytes(recvbuf_size * sizeof(T));
 
       size_t global_recvbuf_size=0;
       {
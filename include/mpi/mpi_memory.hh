@@ -0,0 +1,146 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mpi_memory.hh
+///
+///  Accounting of the bytes held by the major data structures of the
+///  collective readers, with per-rank high-water marks, and a per-rank
+///  memory budget used to plan the I/O ranks and rounds of a read.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef MPI_MEMORY_HH
+#define MPI_MEMORY_HH
+
+#include <mpi.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    /// Name of the category that accumulates all other categories.
+    extern const char* const MEMORY_TOTAL;
+
+    /// Bytes held by a category of data structures on one rank.
+    struct memory_stats_t
+    {
+      uint64_t current;
+      uint64_t high_water;
+
+      memory_stats_t () : current(0), high_water(0) {}
+    };
+
+    /// High-water marks of a category over the ranks of a communicator.
+    struct memory_summary_t
+    {
+      uint64_t ranks;
+      uint64_t min_high_water;
+      uint64_t max_high_water;
+      double   mean_high_water;
+    };
+
+    /// Adds bytes to the current size of a category and of the total,
+    /// updating their high-water marks.
+    void memory_acquire (const char* category, const uint64_t bytes);
+
+    /// Subtracts bytes from the current size of a category and of the
+    /// total.
+    void memory_release (const char* category, const uint64_t bytes);
+
+    /// Resets the high-water marks of this rank to the current sizes.
+    void memory_reset ();
+
+    /// Returns the current sizes and high-water marks of this rank.
+    std::map<std::string, memory_stats_t> memory_local_stats ();
+
+    /// Aggregates the high-water marks over all ranks. Collective on
+    /// comm; the result is returned on every rank.
+    std::map<std::string, memory_summary_t> memory_summary (MPI_Comm comm);
+
+    /// Formats a summary as a table with one category per line.
+    std::string format_memory_summary (const std::map<std::string, memory_summary_t>& summary);
+
+    /// Sets the number of bytes that the readers may hold on each rank;
+    /// zero disables the budget. The budget is initially read from the
+    /// environment variable NEUROH5_MEMORY_BUDGET, which accepts an
+    /// optional K, M or G suffix.
+    void set_memory_budget (const uint64_t bytes);
+
+    uint64_t memory_budget ();
+
+    /// Number of I/O ranks and number of rounds of a collective read.
+    struct read_plan_t
+    {
+      size_t io_size;
+      size_t rounds;
+    };
+
+    /// Plans a collective read of data_bytes bytes partitioned over
+    /// num_items items (e.g. DBS blocks or trees). Every rank keeps
+    /// about recv_factor times its share of the data, and every I/O
+    /// rank transiently holds about io_factor times its share of a
+    /// round. The number of I/O ranks is first enlarged up to comm_size
+    /// and the read is then split into rounds until the estimate fits
+    /// in the budget. If even the received data alone exceeds the
+    /// budget, all ranks read and each round is kept within the
+    /// budget. Without a budget, io_size and a single round are
+    /// returned.
+    read_plan_t plan_read (const uint64_t data_bytes, const size_t num_items,
+                           const size_t comm_size, const size_t io_size,
+                           const double io_factor, const double recv_factor);
+
+    /// Accounts the given number of bytes to a category for the
+    /// lifetime of the enclosing scope. The category name must outlive
+    /// the scope, e.g. a string literal.
+    class memory_scope
+    {
+    public:
+      explicit memory_scope (const char* category, const uint64_t bytes = 0)
+        : category(category), bytes(0)
+      {
+        add(bytes);
+      }
+
+      ~memory_scope ()
+      {
+        memory_release(category, bytes);
+      }
+
+      void add (const uint64_t n)
+      {
+        memory_acquire(category, n);
+        bytes += n;
+      }
+
+      /// Replaces the accounted bytes, e.g. after a buffer was resized.
+      void set (const uint64_t n)
+      {
+        if (n > bytes)
+          {
+            memory_acquire(category, n - bytes);
+          }
+        else
+          {
+            memory_release(category, bytes - n);
+          }
+        bytes = n;
+      }
+
+    private:
+      memory_scope (const memory_scope&);
+      memory_scope& operator= (const memory_scope&);
+
+      const char* category;
+      uint64_t bytes;
+    };
+
+  }
+}
+
+#endif
@@ -0,0 +1,112 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mpi_trace.hh
+///
+///  Timing and volume counters for the phases of the collective readers
+///  and writers, with aggregation across ranks and export to the Chrome
+///  trace event format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef MPI_TRACE_HH
+#define MPI_TRACE_HH
+
+#include <mpi.h>
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    /// Accumulated cost of a phase on one rank.
+    struct phase_stats_t
+    {
+      uint64_t calls;
+      double   seconds;
+      uint64_t bytes;
+      uint64_t items;
+
+      phase_stats_t () : calls(0), seconds(0.0), bytes(0), items(0) {}
+    };
+
+    /// Cost of a phase over the ranks of a communicator. Times are the
+    /// per-rank totals; the mean is over the ranks that ran the phase.
+    struct phase_summary_t
+    {
+      uint64_t ranks;
+      uint64_t calls;
+      double   min_seconds;
+      double   max_seconds;
+      double   mean_seconds;
+      uint64_t bytes;
+      uint64_t items;
+    };
+
+    /// Enables or disables the recording of individual trace events
+    /// for write_trace. Phase totals are always accumulated. Tracing
+    /// is initially enabled if the environment variable NEUROH5_TRACE
+    /// is set to a non-zero value.
+    void set_trace_enabled (const bool enabled);
+
+    bool trace_enabled ();
+
+    /// Adds a completed phase to the totals of this rank.
+    void trace_record (const char* phase, const std::chrono::steady_clock::time_point& start,
+                       const std::chrono::steady_clock::time_point& end,
+                       const uint64_t bytes, const uint64_t items);
+
+    /// Clears the phase totals and trace events of this rank.
+    void trace_reset ();
+
+    /// Returns the phase totals of this rank.
+    std::map<std::string, phase_stats_t> trace_local_stats ();
+
+    /// Aggregates the phase totals over all ranks. Collective on comm;
+    /// the result is returned on every rank.
+    std::map<std::string, phase_summary_t> trace_summary (MPI_Comm comm);
+
+    /// Formats a summary as a table with one phase per line.
+    std::string format_trace_summary (const std::map<std::string, phase_summary_t>& summary);
+
+    /// Writes the trace events of all ranks to a JSON file in the Chrome
+    /// trace event format, which can be loaded in Perfetto or
+    /// chrome://tracing, with one process per rank. Collective on comm.
+    void write_trace (MPI_Comm comm, const std::string& file_name);
+
+    /// Times the enclosing scope as an instance of the given phase, with
+    /// optional byte and element counts. The phase name must outlive
+    /// the scope, e.g. a string literal.
+    class trace_scope
+    {
+    public:
+      explicit trace_scope (const char* phase)
+        : phase(phase), start(std::chrono::steady_clock::now()), bytes(0), items(0)
+      {}
+
+      ~trace_scope ()
+      {
+        trace_record(phase, start, std::chrono::steady_clock::now(), bytes, items);
+      }
+
+      void add_bytes (const uint64_t n) { bytes += n; }
+      void add_items (const uint64_t n) { items += n; }
+
+    private:
+      trace_scope (const trace_scope&);
+      trace_scope& operator= (const trace_scope&);
+
+      const char* phase;
+      const std::chrono::steady_clock::time_point start;
+      uint64_t bytes, items;
+    };
+
+  }
+}
+
+#endif
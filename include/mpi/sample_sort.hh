@@ -0,0 +1,320 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file sample_sort.hh
+///
+///  Distributed sample sort and bucket redistribution of integer keys
+///  with an arbitrary number of payload columns.
+///
+///  The typical usage is:
+///
+///    mpi::bucket_plan_t plan;
+///    mpi::sample_sort(comm, keys, plan);
+///    mpi::bucket_exchange(comm, plan, payload_1);
+///    mpi::bucket_exchange(comm, plan, payload_2);
+///
+///  after which keys and every payload column are globally sorted by
+///  key: all keys on rank r are less than or equal to the keys on rank
+///  r+1, and equal keys are always placed on the same rank.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef SAMPLE_SORT_HH
+#define SAMPLE_SORT_HH
+
+#include <mpi.h>
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
+#include "neuroh5_types.hh"
+#include "infer_mpi_datatype.hh"
+#include "throw_assert.hh"
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    /// Inputs smaller than this are sorted with std::stable_sort
+    /// rather than radix sort.
+    const size_t radix_sort_threshold = 256;
+
+    /// Number of samples taken per bucket when selecting splitters.
+    const size_t sample_sort_oversampling = 64;
+
+    /// Describes how local elements are sent to their destination
+    /// ranks, and how received elements are ordered.
+    struct bucket_plan_t
+    {
+      /// order in which the local elements are sent
+      std::vector<size_t> send_perm;
+      std::vector<int> sendcounts, sdispls;
+      std::vector<int> recvcounts, rdispls;
+      /// order that sorts the received elements by key (may be empty)
+      std::vector<size_t> recv_perm;
+    };
+
+
+    /// @brief Stable least-significant-digit radix sort of unsigned
+    ///        integer keys. If perm has the same size as keys on
+    ///        entry, it is taken as the initial order, which allows
+    ///        lexicographic sorting by successive calls with the least
+    ///        significant key first. On return, perm holds the indices
+    ///        of keys in sorted order.
+    template <class K>
+    void radix_sort_permutation
+    (
+     const std::vector<K>& keys,
+     std::vector<size_t>&  perm
+     )
+    {
+      static_assert(std::is_unsigned<K>::value,
+                    "radix_sort_permutation: key type must be unsigned");
+
+      const size_t n = keys.size();
+      if (perm.size() != n)
+        {
+          perm.resize(n);
+          std::iota(perm.begin(), perm.end(), 0);
+        }
+
+      if (n < radix_sort_threshold)
+        {
+          std::stable_sort(perm.begin(), perm.end(),
+                           [&] (const size_t& a, const size_t& b)
+                           { return keys[a] < keys[b]; });
+          return;
+        }
+
+      K max_key = 0;
+      for (size_t i = 0; i < n; i++)
+        {
+          max_key = std::max(max_key, keys[i]);
+        }
+
+      const size_t key_bits = sizeof(K) * 8;
+      std::vector<size_t> sorted_perm(n);
+      for (size_t shift = 0; (shift < key_bits) && ((max_key >> shift) > 0); shift += 8)
+        {
+          size_t counts[257] = { 0 };
+          for (size_t i = 0; i < n; i++)
+            {
+              counts[((keys[perm[i]] >> shift) & 0xff) + 1]++;
+            }
+          for (size_t d = 1; d < 257; d++)
+            {
+              counts[d] += counts[d-1];
+            }
+          for (size_t i = 0; i < n; i++)
+            {
+              sorted_perm[counts[(keys[perm[i]] >> shift) & 0xff]++] = perm[i];
+            }
+          perm.swap(sorted_perm);
+        }
+    }
+
+
+    /// @brief Reorders a column according to the given permutation,
+    ///        such that column[i] becomes column[perm[i]].
+    template <class T>
+    void permute_column
+    (
+     const std::vector<size_t>& perm,
+     std::vector<T>&            column
+     )
+    {
+      throw_assert(perm.size() == column.size(),
+                   "permute_column: permutation and column have different sizes");
+      std::vector<T> sorted_column(column.size());
+      for (size_t i = 0; i < perm.size(); i++)
+        {
+          sorted_column[i] = column[perm[i]];
+        }
+      column.swap(sorted_column);
+    }
+
+
+    /// @brief Computes a send plan given the destination rank of each
+    ///        local element, and exchanges the element counts with all
+    ///        ranks. Collective on comm.
+    void bucket_plan
+    (
+     MPI_Comm                   comm,
+     const std::vector<rank_t>& dest_ranks,
+     bucket_plan_t&             plan
+     );
+
+
+    /// @brief Selects num_buckets-1 splitters by regular sampling of the
+    ///        keys on all ranks. Key k belongs to bucket
+    ///        upper_bound(splitters, k). Collective on comm.
+    template <class K>
+    void sample_splitters
+    (
+     MPI_Comm              comm,
+     const std::vector<K>& keys,
+     const size_t          num_buckets,
+     std::vector<K>&       splitters
+     )
+    {
+      int ssize;
+      throw_assert(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS,
+                   "sample_splitters: unable to obtain size of MPI communicator");
+      throw_assert_nomsg(num_buckets > 0);
+      const size_t size = ssize;
+
+      splitters.clear();
+
+      size_t num_keys = keys.size(), total_num_keys = 0;
+      throw_assert(MPI_Allreduce(&num_keys, &total_num_keys, 1, MPI_SIZE_T, MPI_SUM, comm) == MPI_SUCCESS,
+                   "sample_splitters: error in MPI_Allreduce");
+      if ((total_num_keys == 0) || (num_buckets == 1))
+        {
+          return;
+        }
+
+      // Each rank contributes a number of samples proportional to its
+      // number of keys, taken at regular intervals of its sorted keys.
+      const size_t total_num_samples = num_buckets * sample_sort_oversampling;
+      size_t num_samples = std::min(num_keys, (num_keys * total_num_samples + total_num_keys - 1) / total_num_keys);
+
+      std::vector<K> local_samples;
+      if (num_samples > 0)
+        {
+          std::vector<size_t> perm;
+          radix_sort_permutation(keys, perm);
+          for (size_t i = 0; i < num_samples; i++)
+            {
+              local_samples.push_back(keys[perm[(i * num_keys) / num_samples]]);
+            }
+        }
+
+      int sample_count = num_samples;
+      std::vector<int> sample_counts(size, 0), sample_displs(size+1, 0);
+      throw_assert(MPI_Allgather(&sample_count, 1, MPI_INT,
+                                 &sample_counts[0], 1, MPI_INT, comm) == MPI_SUCCESS,
+                   "sample_splitters: error in MPI_Allgather");
+      for (size_t p = 0; p < size; p++)
+        {
+          sample_displs[p+1] = sample_displs[p] + sample_counts[p];
+        }
+
+      K dummy = K();
+      std::vector<K> all_samples(sample_displs[size]);
+      throw_assert(MPI_Allgatherv(local_samples.data(), sample_count, infer_mpi_datatype(dummy),
+                                  all_samples.data(), &sample_counts[0], &sample_displs[0],
+                                  infer_mpi_datatype(dummy), comm) == MPI_SUCCESS,
+                   "sample_splitters: error in MPI_Allgatherv");
+
+      std::vector<size_t> perm;
+      radix_sort_permutation(all_samples, perm);
+      for (size_t b = 1; b < num_buckets; b++)
+        {
+          splitters.push_back(all_samples[perm[(b * all_samples.size()) / num_buckets]]);
+        }
+    }
+
+
+    /// @brief Computes a send plan that sends each key to the rank of
+    ///        its bucket according to the given splitters. If
+    ///        bucket_ranks is empty, bucket b is sent to rank b;
+    ///        otherwise to bucket_ranks[b]. Collective on comm.
+    template <class K>
+    void bucket_plan
+    (
+     MPI_Comm                   comm,
+     const std::vector<K>&      keys,
+     const std::vector<K>&      splitters,
+     const std::vector<rank_t>& bucket_ranks,
+     bucket_plan_t&             plan
+     )
+    {
+      std::vector<rank_t> dest_ranks(keys.size());
+      for (size_t i = 0; i < keys.size(); i++)
+        {
+          size_t b = std::upper_bound(splitters.begin(), splitters.end(), keys[i]) - splitters.begin();
+          dest_ranks[i] = bucket_ranks.empty() ? b : bucket_ranks[b];
+        }
+      bucket_plan(comm, dest_ranks, plan);
+    }
+
+
+    /// @brief Sends a column according to the plan and orders the
+    ///        received elements according to plan.recv_perm, if it is
+    ///        not empty. Collective on comm.
+    template <class T>
+    void bucket_exchange
+    (
+     MPI_Comm             comm,
+     const bucket_plan_t& plan,
+     std::vector<T>&      column
+     )
+    {
+      throw_assert(column.size() == plan.send_perm.size(),
+                   "bucket_exchange: column size does not match plan");
+
+      std::vector<T> sendbuf(column.size());
+      for (size_t i = 0; i < plan.send_perm.size(); i++)
+        {
+          sendbuf[i] = column[plan.send_perm[i]];
+        }
+
+      size_t recvbuf_size = 0;
+      for (size_t p = 0; p < plan.recvcounts.size(); p++)
+        {
+          recvbuf_size += plan.recvcounts[p];
+        }
+      column.clear();
+      column.resize(recvbuf_size);
+
+      T dummy = T();
+      throw_assert(MPI_Alltoallv(sendbuf.data(), &plan.sendcounts[0], &plan.sdispls[0],
+                                 infer_mpi_datatype(dummy),
+                                 column.data(), &plan.recvcounts[0], &plan.rdispls[0],
+                                 infer_mpi_datatype(dummy), comm) == MPI_SUCCESS,
+                   "bucket_exchange: error in MPI_Alltoallv");
+
+      if (!plan.recv_perm.empty())
+        {
+          permute_column(plan.recv_perm, column);
+        }
+    }
+
+
+    /// @brief Globally sorts the keys distributed over the ranks of
+    ///        comm. On return, keys holds the local part of the sorted
+    ///        sequence and plan can be used with bucket_exchange to
+    ///        carry payload columns along. If bucket_ranks is not
+    ///        empty, the keys are distributed only to the given ranks,
+    ///        in that order. Collective on comm.
+    template <class K>
+    void sample_sort
+    (
+     MPI_Comm                   comm,
+     std::vector<K>&            keys,
+     bucket_plan_t&             plan,
+     const std::vector<rank_t>& bucket_ranks = std::vector<rank_t>()
+     )
+    {
+      int ssize;
+      throw_assert(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS,
+                   "sample_sort: unable to obtain size of MPI communicator");
+      const size_t num_buckets = bucket_ranks.empty() ? (size_t)ssize : bucket_ranks.size();
+
+      std::vector<K> splitters;
+      sample_splitters(comm, keys, num_buckets, splitters);
+      bucket_plan(comm, keys, splitters, bucket_ranks, plan);
+
+      plan.recv_perm.clear();
+      bucket_exchange(comm, plan, keys);
+      radix_sort_permutation(keys, plan.recv_perm);
+      permute_column(plan.recv_perm, keys);
+    }
+
+  }
+}
+
+#endif
@@ -31,6 +31,8 @@
 #include <vector>
 #include <deque>
 #include <forward_list>
+#include <memory>
+#include <numeric>
 
 #include <hdf5.h>
 #include <mpi.h>
@@ -42,12 +44,18 @@
 #include "neuroh5_types.hh"
 #include "cell_populations.hh"
 #include "cell_attributes.hh"
+#include "compact_cell_attributes.hh"
+#include "stitch_cell_attributes.hh"
+#include "stitch_projection.hh"
 #include "path_names.hh"
 #include "create_file_toplevel.hh"
 #include "read_tree.hh"
 #include "validate_tree.hh"
+#include "tree_morphometrics.hh"
+#include "spatial_index.hh"
 #include "append_tree.hh"
 #include "scatter_read_tree.hh"
+#include "tree_batch.hh"
 #include "cell_index.hh"
 #include "dataset_num_elements.hh"
 #include "num_projection_blocks.hh"
@@ -63,10 +71,18 @@
 #include "bcast_graph.hh"
 #include "write_graph.hh"
 #include "append_graph.hh"
+#include "append_graph_edges.hh"
+#include "update_edge_attributes.hh"
 #include "projection_names.hh"
 #include "edge_attributes.hh"
+#include "edge_attr_filter.hh"
 #include "serialize_data.hh"
 #include "split_intervals.hh"
+#include "partition_sfc.hh"
+#include "node_rank_map_attributes.hh"
+#include "partition_graph_lp.hh"
+#include "mpi_memory.hh"
+#include "mpi_trace.hh"
 
 #if PY_MAJOR_VERSION >= 3
 #define Py_TPFLAGS_HAVE_ITER ((Py_ssize_t)0)
@@ -795,6 +811,31 @@ void get_edge_attr_index (PyObject *py_edge_values,
 }
 
 
+template<class T>
+void append_edge_attr_column (PyObject *py_attr_values,
+                              const AttrIndex& attr_index,
+                              const string& attr_name,
+                              vector< vector<T> >& attr_columns)
+{
+  attr_columns.resize(attr_index.size_attr_index<T>());
+  py_array_to_vector<T>(py_attr_values, attr_columns[attr_index.attr_index<T>(attr_name)]);
+}
+
+template<class T>
+void py_index_array_to_vector (PyObject *py_array, int npy_type,
+                               vector<T>& values)
+{
+  throw_assert(PyArray_Check(py_array),
+               "append_graph_edges: argument is not an array");
+  PyObject *py_cast_array = PyArray_FROM_OTF(py_array, npy_type,
+                                             NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+  throw_assert(py_cast_array != NULL,
+               "append_graph_edges: unable to convert index array");
+  py_array_to_vector<T>(py_cast_array, values);
+  Py_DECREF(py_cast_array);
+}
+
+
 void build_edge_map (PyObject *py_edge_values,
                      const map <string, pair <size_t, AttrIndex > >& edge_attr_index,
                      edge_map_t& edge_map)
@@ -1035,31 +1076,48 @@ void build_edge_maps (int rank, PyObject *py_edge_dict,
 }
 
 
-PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
-                              const map <string, NamedAttrMap>& attr_maps,
-                              const bool topology, const bool validate)
+/* Returns a NumPy array with the values of a column of a TreeBatch.
+ * The array is a view into the batch, with py_owner as the base
+ * object that keeps the batch alive.
+ */
+template <class T>
+PyObject* py_tree_column(const data::column_view<T>& values, const int npy_type, PyObject *py_owner)
 {
-  const CELL_IDX_T idx = get<0>(tree);
-  throw_assert(idx == key,
-               "py_build_tree_value: tree index mismatch");
-
-  if (validate)
+  npy_intp dims[1], ind = 0;
+  dims[0] = values.size();
+  if ((py_owner == NULL) || (values.size() == 0))
     {
-      cell::validate_tree(tree);
+      PyObject *py_value = (PyObject *)PyArray_SimpleNew(1, dims, npy_type);
+      T *py_value_ptr = (T *)PyArray_GetPtr((PyArrayObject *)py_value, &ind);
+      std::copy(values.begin(), values.end(), py_value_ptr);
+      return py_value;
     }
+  PyObject *py_value = PyArray_SimpleNewFromData(1, dims, npy_type, (void *)values.begin());
+  Py_INCREF(py_owner);
+  PyArray_SetBaseObject((PyArrayObject *)py_value, py_owner);
+  return py_value;
+}
 
-  const deque<SECTION_IDX_T> & src_vector=get<1>(tree);
-  const deque<SECTION_IDX_T> & dst_vector=get<2>(tree);
-  const deque<SECTION_IDX_T> & sections=get<3>(tree);
-  const deque<COORD_T> & xcoords=get<4>(tree);
-  const deque<COORD_T> & ycoords=get<5>(tree);
-  const deque<COORD_T> & zcoords=get<6>(tree);
-  const deque<REALVAL_T> & radiuses=get<7>(tree);
-  const deque<LAYER_IDX_T> & layers=get<8>(tree);
-  const deque<PARENT_NODE_IDX_T> & parents=get<9>(tree);
-  const deque<SWC_TYPE_T> & swc_types=get<10>(tree);
+
+template <class SecCol, class CoordCol, class RealCol, class LayerCol, class ParentCol, class TypeCol>
+PyObject* py_build_tree_columns(const CELL_IDX_T idx,
+                                const SecCol& src_vector,
+                                const SecCol& dst_vector,
+                                const SecCol& sections,
+                                const CoordCol& xcoords,
+                                const CoordCol& ycoords,
+                                const CoordCol& zcoords,
+                                const RealCol& radiuses,
+                                const LayerCol& layers,
+                                const ParentCol& parents,
+                                const TypeCol& swc_types,
+                                PyObject *py_owner,
+                                const map <string, NamedAttrMap>& attr_maps,
+                                const bool topology,
+                                const uint32_t fields = data::TreeFieldAll)
+{
                            
-  size_t num_nodes = xcoords.size();
+  size_t num_nodes = parents.size();
   npy_intp ind = 0;
 
   PyObject *py_section_topology = NULL;
@@ -1120,16 +1178,12 @@ PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
 
       npy_intp topology_dims[1];
       topology_dims[0] = src_vector.size();
-      py_section_src = (PyObject *)PyArray_SimpleNew(1, topology_dims, NPY_UINT16);
-      SECTION_IDX_T *section_src_ptr = (SECTION_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_section_src, &ind);
-      py_section_dst = (PyObject *)PyArray_SimpleNew(1, topology_dims, NPY_UINT16);
-      SECTION_IDX_T *section_dst_ptr = (SECTION_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_section_dst, &ind);
+      py_section_src = py_tree_column(src_vector, NPY_UINT16, py_owner);
+      py_section_dst = py_tree_column(dst_vector, NPY_UINT16, py_owner);
       py_section_loc = (PyObject *)PyArray_SimpleNew(1, topology_dims, NPY_UINT32);
       NODE_IDX_T *section_loc_ptr = (NODE_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_section_loc, &ind);
       for (size_t s = 0; s < src_vector.size(); s++)
         {
-          section_src_ptr[s] = src_vector[s];
-          section_dst_ptr[s] = dst_vector[s];
           auto node_map_it = section_node_map.find(src_vector[s]);
           throw_assert (node_map_it != section_node_map.end(),
                         "py_build_tree_value: invalid section index in tree source vector");
@@ -1184,27 +1238,12 @@ PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
     }
   else
     {
-      npy_intp topology_dims[1];
-      topology_dims[0] = src_vector.size();
-      py_section_src = (PyObject *)PyArray_SimpleNew(1, topology_dims, NPY_UINT16);
-      SECTION_IDX_T *section_src_ptr = (SECTION_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_section_src, &ind);
-      py_section_dst = (PyObject *)PyArray_SimpleNew(1, topology_dims, NPY_UINT16);
-      SECTION_IDX_T *section_dst_ptr = (SECTION_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_section_dst, &ind);
-      for (size_t s = 0; s < src_vector.size(); s++)
-        {
-          section_src_ptr[s] = src_vector[s];
-          section_dst_ptr[s] = dst_vector[s];
-        }
-
-      
-      npy_intp sections_dims[1];
-      sections_dims[0] = sections.size();
-      py_sections = (PyObject *)PyArray_SimpleNew(1, sections_dims, NPY_UINT16);
-      SECTION_IDX_T *sections_ptr = (SECTION_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_sections, &ind);
-      for (size_t p = 0; p < sections.size(); p++)
-        {
-          sections_ptr[p] = sections[p];
-        }
+      if (fields & data::TreeFieldSrc)
+        py_section_src = py_tree_column(src_vector, NPY_UINT16, py_owner);
+      if (fields & data::TreeFieldDst)
+        py_section_dst = py_tree_column(dst_vector, NPY_UINT16, py_owner);
+      if (fields & data::TreeFieldSections)
+        py_sections = py_tree_column(sections, NPY_UINT16, py_owner);
     }
   
                            
@@ -1212,52 +1251,57 @@ PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
   npy_intp dims[1];
   dims[0] = num_nodes;
 
-  PyObject *py_xcoords = (PyObject *)PyArray_SimpleNew(1, dims, NPY_FLOAT);
-  float *xcoords_ptr = (float *)PyArray_GetPtr((PyArrayObject *)py_xcoords, &ind);
-  PyObject *py_ycoords = (PyObject *)PyArray_SimpleNew(1, dims, NPY_FLOAT);
-  float *ycoords_ptr = (float *)PyArray_GetPtr((PyArrayObject *)py_ycoords, &ind);
-  PyObject *py_zcoords = (PyObject *)PyArray_SimpleNew(1, dims, NPY_FLOAT);
-  float *zcoords_ptr = (float *)PyArray_GetPtr((PyArrayObject *)py_zcoords, &ind);
-  PyObject *py_radiuses = (PyObject *)PyArray_SimpleNew(1, dims, NPY_FLOAT);
-  float *radiuses_ptr = (float *)PyArray_GetPtr((PyArrayObject *)py_radiuses, &ind);
-  PyObject *py_layers = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT8);
-  LAYER_IDX_T *layers_ptr = (LAYER_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_layers, &ind);
-  PyObject *py_parents = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT32);
-  PARENT_NODE_IDX_T *parents_ptr = (PARENT_NODE_IDX_T *)PyArray_GetPtr((PyArrayObject *)py_parents, &ind);
-  PyObject *py_swc_types = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT8);
-  SWC_TYPE_T *swc_types_ptr = (SWC_TYPE_T *)PyArray_GetPtr((PyArrayObject *)py_swc_types, &ind);
-  for (size_t j = 0; j < xcoords.size(); j++)
+  PyObject *py_treeval = PyDict_New();
+
+  // fields that were not read are left out of the tree dictionary
+  if (fields & data::TreeFieldX)
     {
-      xcoords_ptr[j]   = xcoords[j];
-      ycoords_ptr[j]   = ycoords[j];
-      zcoords_ptr[j]   = zcoords[j];
-      radiuses_ptr[j]  = radiuses[j];
-      layers_ptr[j]    = layers[j];
-      parents_ptr[j]   = parents[j];
-      swc_types_ptr[j] = swc_types[j];
+      PyObject *py_xcoords = py_tree_column(xcoords, NPY_FLOAT, py_owner);
+      PyDict_SetItemString(py_treeval, "x", py_xcoords);
+      Py_DECREF(py_xcoords);
     }
-                           
-  PyObject *py_treeval = PyDict_New();
-  PyDict_SetItemString(py_treeval, "x", py_xcoords);
-  Py_DECREF(py_xcoords);
 
-  PyDict_SetItemString(py_treeval, "y", py_ycoords);
-  Py_DECREF(py_ycoords);
+  if (fields & data::TreeFieldY)
+    {
+      PyObject *py_ycoords = py_tree_column(ycoords, NPY_FLOAT, py_owner);
+      PyDict_SetItemString(py_treeval, "y", py_ycoords);
+      Py_DECREF(py_ycoords);
+    }
                            
-  PyDict_SetItemString(py_treeval, "z", py_zcoords);
-  Py_DECREF(py_zcoords);
+  if (fields & data::TreeFieldZ)
+    {
+      PyObject *py_zcoords = py_tree_column(zcoords, NPY_FLOAT, py_owner);
+      PyDict_SetItemString(py_treeval, "z", py_zcoords);
+      Py_DECREF(py_zcoords);
+    }
 
-  PyDict_SetItemString(py_treeval, "radius", py_radiuses);
-  Py_DECREF(py_radiuses);
+  if (fields & data::TreeFieldRadius)
+    {
+      PyObject *py_radiuses = py_tree_column(radiuses, NPY_FLOAT, py_owner);
+      PyDict_SetItemString(py_treeval, "radius", py_radiuses);
+      Py_DECREF(py_radiuses);
+    }
                            
-  PyDict_SetItemString(py_treeval, "layer", py_layers);
-  Py_DECREF(py_layers);
+  if (fields & data::TreeFieldLayer)
+    {
+      PyObject *py_layers = py_tree_column(layers, NPY_INT8, py_owner);
+      PyDict_SetItemString(py_treeval, "layer", py_layers);
+      Py_DECREF(py_layers);
+    }
                            
-  PyDict_SetItemString(py_treeval, "parent", py_parents);
-  Py_DECREF(py_parents);
+  if (fields & data::TreeFieldParent)
+    {
+      PyObject *py_parents = py_tree_column(parents, NPY_INT32, py_owner);
+      PyDict_SetItemString(py_treeval, "parent", py_parents);
+      Py_DECREF(py_parents);
+    }
                            
-  PyDict_SetItemString(py_treeval, "swc_type", py_swc_types);
-  Py_DECREF(py_swc_types);
+  if (fields & data::TreeFieldSWCType)
+    {
+      PyObject *py_swc_types = py_tree_column(swc_types, NPY_INT8, py_owner);
+      PyDict_SetItemString(py_treeval, "swc_type", py_swc_types);
+      Py_DECREF(py_swc_types);
+    }
 
   if (topology)
     {
@@ -1274,19 +1318,21 @@ PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
     }
   else
     {
-      throw_assert(py_sections != NULL,
-                   "py_build_tree_value: invalid sections in tree");
-      throw_assert(py_section_src != NULL,
-                   "py_build_tree_value: invalid source section vector in tree");
-      throw_assert(py_section_dst != NULL,
-                   "py_build_tree_value: invalid destination section vector in tree");
-
-      PyDict_SetItemString(py_treeval, "sections", py_sections);
-      Py_DECREF(py_sections);
-      PyDict_SetItemString(py_treeval, "src", py_section_src);
-      Py_DECREF(py_section_src);
-      PyDict_SetItemString(py_treeval, "dst", py_section_dst);
-      Py_DECREF(py_section_dst);
+      if (py_sections != NULL)
+        {
+          PyDict_SetItemString(py_treeval, "sections", py_sections);
+          Py_DECREF(py_sections);
+        }
+      if (py_section_src != NULL)
+        {
+          PyDict_SetItemString(py_treeval, "src", py_section_src);
+          Py_DECREF(py_section_src);
+        }
+      if (py_section_dst != NULL)
+        {
+          PyDict_SetItemString(py_treeval, "dst", py_section_dst);
+          Py_DECREF(py_section_dst);
+        }
     }
                            
   for (auto const& attr_map_entry : attr_maps)
@@ -1414,18 +1460,237 @@ PyObject* py_build_tree_value(const CELL_IDX_T key, const neurotree_t &tree,
   return py_treeval;
 }
 
+
+/* Builds the value of tree i of a batch. The returned arrays are views
+ * into the batch and hold a reference to py_owner.
+ */
+PyObject* py_build_tree_value(const data::TreeBatch& tree_batch, const size_t i, PyObject *py_owner,
+                              const map <string, NamedAttrMap>& attr_maps,
+                              const bool topology, const bool validate)
+{
+  // partial trees are neither validated nor given a section topology
+  // unless the required fields were read
+  if (validate && tree_batch.has(data::TreeFieldAll))
+    {
+      cell::tree_workspace_t ws;
+      cell::validate_tree(tree_batch, i, ws);
+    }
+
+  return py_build_tree_columns(tree_batch.index[i],
+                               tree_batch.tree_src(i), tree_batch.tree_dst(i), tree_batch.tree_sections(i),
+                               tree_batch.tree_x(i), tree_batch.tree_y(i), tree_batch.tree_z(i),
+                               tree_batch.tree_radius(i), tree_batch.tree_layer(i),
+                               tree_batch.tree_parent(i), tree_batch.tree_swc_type(i),
+                               py_owner, attr_maps,
+                               topology && tree_batch.has(data::TreeFieldTopology | data::TreeFieldParent),
+                               tree_batch.fields);
+}
+
+/* Converts a collection of tree dictionary keys (e.g. "x", "parent",
+ * "src") to the names of the corresponding Trees attributes.
+ */
+void py_tree_field_names(PyObject *py_tree_fields, set<string>& tree_mask)
+{
+  static const map<string, string> tree_field_names =
+    {
+      { "x",        hdf5::X_COORD },
+      { "y",        hdf5::Y_COORD },
+      { "z",        hdf5::Z_COORD },
+      { "radius",   hdf5::RADIUS },
+      { "layer",    hdf5::LAYER },
+      { "parent",   hdf5::PARENT },
+      { "swc_type", hdf5::SWCTYPE },
+      { "sections", hdf5::SECTION },
+      { "src",      hdf5::SRCSEC },
+      { "dst",      hdf5::DSTSEC }
+    };
+
+  tree_mask.clear();
+  if ((py_tree_fields == NULL) || (py_tree_fields == Py_None))
+    {
+      return;
+    }
+
+  PyObject *py_iter = PyObject_GetIter(py_tree_fields);
+  throw_assert(py_iter != NULL,
+               "py_tree_field_names: tree_fields must be a collection of strings");
+  PyObject *pyval;
+  while((pyval = PyIter_Next(py_iter)))
+    {
+      const string name(PyStr_ToCString (pyval));
+      Py_DECREF(pyval);
+      auto it = tree_field_names.find(name);
+      throw_assert(it != tree_field_names.end(),
+                   "py_tree_field_names: unknown tree field " << name);
+      tree_mask.insert(it->second);
+    }
+  Py_DECREF(py_iter);
+}
+
+/* Adds the values [begin, end) of a morphometrics column to a
+ * dictionary of cell attributes.
+ */
+template <class T>
+void py_morphometrics_attr(PyObject *py_attrs, const string& attr_name,
+                           const vector<T>& values, size_t begin, size_t end,
+                           const int npy_type)
+{
+  npy_intp dims[1], ind = 0;
+  dims[0] = end - begin;
+  PyObject *py_value = (PyObject *)PyArray_SimpleNew(1, dims, npy_type);
+  T *py_value_ptr = (T *)PyArray_GetPtr((PyArrayObject *)py_value, &ind);
+  std::copy(values.begin() + begin, values.begin() + end, py_value_ptr);
+  PyDict_SetItemString(py_attrs, attr_name.c_str(), py_value);
+  Py_DECREF(py_value);
+}
+
+/* Copies a vector into a new one-dimensional array.
+ */
+template <class T>
+PyObject* py_array_from_vector(const vector<T>& values, const int npy_type)
+{
+  npy_intp dims[1], ind = 0;
+  dims[0] = values.size();
+  PyObject *py_array = (PyObject *)PyArray_SimpleNew(1, dims, npy_type);
+  if (values.size() > 0)
+    {
+      T *py_array_ptr = (T *)PyArray_GetPtr((PyArrayObject *)py_array, &ind);
+      std::copy(values.begin(), values.end(), py_array_ptr);
+    }
+  return py_array;
+}
+
+/* Moves a vector into a heap-allocated one owned by a capsule, and
+ * returns a one-dimensional array that refers to its data without
+ * copying; the capsule is the base object of the array.
+ */
+template <class T>
+static void py_vector_capsule_destructor(PyObject *py_capsule)
+{
+  vector<T> *values_ptr = (vector<T> *)PyCapsule_GetPointer(py_capsule, "neuroh5.vector");
+  delete values_ptr;
+}
+
+template <class T>
+PyObject* py_array_from_moved_vector(vector<T>& values, const int npy_type)
+{
+  if (values.size() == 0)
+    {
+      return py_array_from_vector(values, npy_type);
+    }
+  vector<T> *values_ptr = new vector<T>();
+  values_ptr->swap(values);
+  npy_intp dims[1];
+  dims[0] = values_ptr->size();
+  PyObject *py_array = PyArray_SimpleNewFromData(1, dims, npy_type, values_ptr->data());
+  PyObject *py_capsule = PyCapsule_New(values_ptr, "neuroh5.vector",
+                                       &py_vector_capsule_destructor<T>);
+  PyArray_SetBaseObject((PyArrayObject *)py_array, py_capsule);
+  return py_array;
+}
+
+/* Builds an attribute predicate from a list of (attribute name,
+ * comparison, value) tuples, such as [('syn_type', '==', 1)].
+ */
+void py_attr_predicate(PyObject *py_predicate, data::AttrPredicate& predicate)
+{
+  if ((py_predicate == NULL) || (py_predicate == Py_None))
+    {
+      return;
+    }
+  PyObject *py_iter = PyObject_GetIter(py_predicate);
+  throw_assert(py_iter != NULL,
+               "py_attr_predicate: predicate must be a list of (attribute, comparison, value) tuples");
+  PyObject *pyval;
+  while((pyval = PyIter_Next(py_iter)))
+    {
+      throw_assert(PyTuple_Check(pyval) && (PyTuple_Size(pyval) == 3),
+                   "py_attr_predicate: predicate must be a list of (attribute, comparison, value) tuples");
+      const char *attr_name = PyStr_ToCString(PyTuple_GetItem(pyval, 0));
+      const char *comparison = PyStr_ToCString(PyTuple_GetItem(pyval, 1));
+      double value = PyFloat_AsDouble(PyTuple_GetItem(pyval, 2));
+      throw_assert(!PyErr_Occurred(),
+                   "py_attr_predicate: predicate value of attribute " << attr_name << " must be a number");
+      predicate.add(string(attr_name), data::parse_attr_comparison(string(comparison)), value);
+      Py_DECREF(pyval);
+    }
+  Py_DECREF(py_iter);
+}
+
+/* Builds an edge attribute filter from a dictionary of namespaces to
+ * sets of attribute names to read, such as {'Synapses': {'syn_id'}},
+ * and a dictionary of namespaces to predicates as accepted by
+ * py_attr_predicate.
+ */
+void py_edge_attr_filter(PyObject *py_mask, PyObject *py_predicate, graph::EdgeAttrFilter& edge_filter)
+{
+  PyObject *py_key, *py_value;
+  Py_ssize_t pos = 0;
+  if ((py_mask != NULL) && (py_mask != Py_None))
+    {
+      throw_assert(PyDict_Check(py_mask),
+                   "py_edge_attr_filter: mask must be a dictionary of namespaces to sets of attribute names");
+      while (PyDict_Next(py_mask, &pos, &py_key, &py_value))
+        {
+          const char *attr_namespace = PyStr_ToCString(py_key);
+          set<string>& attr_mask = edge_filter.attr_masks[string(attr_namespace)];
+          PyObject *py_iter = PyObject_GetIter(py_value);
+          throw_assert(py_iter != NULL,
+                       "py_edge_attr_filter: mask must be a dictionary of namespaces to sets of attribute names");
+          PyObject *pyval;
+          while((pyval = PyIter_Next(py_iter)))
+            {
+              attr_mask.insert(string(PyStr_ToCString(pyval)));
+              Py_DECREF(pyval);
+            }
+          Py_DECREF(py_iter);
+        }
+    }
+  pos = 0;
+  if ((py_predicate != NULL) && (py_predicate != Py_None))
+    {
+      throw_assert(PyDict_Check(py_predicate),
+                   "py_edge_attr_filter: predicate must be a dictionary of namespaces to predicates");
+      while (PyDict_Next(py_predicate, &pos, &py_key, &py_value))
+        {
+          const char *attr_namespace = PyStr_ToCString(py_key);
+          py_attr_predicate(py_value, edge_filter.predicates[string(attr_namespace)]);
+        }
+    }
+}
+
+/* Wraps a shared pointer to a tree batch in a capsule, which serves as
+ * the base object of the arrays that refer to the batch.
+ */
+static void py_tree_batch_capsule_destructor(PyObject *py_capsule)
+{
+  shared_ptr<data::TreeBatch> *tree_batch_ptr =
+    (shared_ptr<data::TreeBatch> *)PyCapsule_GetPointer(py_capsule, "neuroh5.TreeBatch");
+  delete tree_batch_ptr;
+}
+
+PyObject* py_tree_batch_capsule(const shared_ptr<data::TreeBatch>& tree_batch)
+{
+  return PyCapsule_New(new shared_ptr<data::TreeBatch>(tree_batch), "neuroh5.TreeBatch",
+                       &py_tree_batch_capsule_destructor);
+}
+
 /* NeuroH5TreeIterState - in-memory tree iterator instance.
  *
  * seq_index: index of the next id in the sequence to yield
+ * tree_order: order in which the trees of the batch are yielded
+ * py_tree_batch: capsule that owns the batch, and is the base
+ * object of the yielded arrays
  *
  */
 typedef struct {
   Py_ssize_t seq_index, count;
                            
-  forward_list <neurotree_t> tree_list;
+  shared_ptr<data::TreeBatch> tree_batch;
+  PyObject *py_tree_batch;
+  vector<size_t> tree_order;
   vector<string> attr_name_spaces;
   map <string, NamedAttrMap> attr_maps;
-  forward_list<neurotree_t>::const_iterator it_tree;
   bool topology_flag;
   bool validate_flag;
   
@@ -1445,6 +1710,7 @@ PyObject* NeuroH5TreeIter_iter(PyObject *self)
 
 static void NeuroH5TreeIter_dealloc(PyNeuroH5TreeIterState *py_state)
 {
+  Py_XDECREF(py_state->state->py_tree_batch);
   delete py_state->state;
   Py_TYPE(py_state)->tp_free(py_state);
 }
@@ -1453,19 +1719,20 @@ static void NeuroH5TreeIter_dealloc(PyNeuroH5TreeIterState *py_state)
 PyObject* NeuroH5TreeIter_iternext(PyObject *self)
 {
   PyNeuroH5TreeIterState *py_state = (PyNeuroH5TreeIterState *)self;
-  if (py_state->state->it_tree != py_state->state->tree_list.cend())
+  if (py_state->state->seq_index < py_state->state->count)
     {
-      const neurotree_t &tree = *(py_state->state->it_tree);
-      const CELL_IDX_T key = get<0>(tree);
+      const data::TreeBatch &tree_batch = *(py_state->state->tree_batch);
+      const size_t i = py_state->state->tree_order[py_state->state->seq_index];
+      const CELL_IDX_T key = tree_batch.index[i];
       const map <string, NamedAttrMap>& attr_maps = py_state->state->attr_maps;
 
-      PyObject *treeval = py_build_tree_value(key, tree, attr_maps,
+      PyObject *treeval = py_build_tree_value(tree_batch, i, py_state->state->py_tree_batch,
+                                              attr_maps,
                                               py_state->state->topology_flag,
                                               py_state->state->validate_flag);
       throw_assert(treeval != NULL,
                    "NeuroH5TreeIter: invalid tree value");
       
-      py_state->state->it_tree++;
       py_state->state->seq_index++;
 
       PyObject *result = Py_BuildValue("lN", key, treeval);
@@ -1515,11 +1782,14 @@ static PyTypeObject PyNeuroH5TreeIter_Type = {
 
 
 
+/* Creates an iterator over a batch of trees. Trees are yielded in
+ * order of decreasing index.
+ */
 static PyObject *
-NeuroH5TreeIter_FromList(const forward_list <neurotree_t>& tree_list,
-                         const vector<string>& attr_name_spaces,
-                         const map <string, NamedAttrMap>& attr_maps,
-                         const bool topology_flag, const bool validate_flag)
+NeuroH5TreeIter_FromBatch(data::TreeBatch& tree_batch,
+                          const vector<string>& attr_name_spaces,
+                          const map <string, NamedAttrMap>& attr_maps,
+                          const bool topology_flag, const bool validate_flag)
 {
 
   PyNeuroH5TreeIterState *p = PyObject_New(PyNeuroH5TreeIterState, &PyNeuroH5TreeIter_Type);
@@ -1533,12 +1803,20 @@ NeuroH5TreeIter_FromList(const forward_list <neurotree_t>& tree_list,
 
   p->state = new NeuroH5TreeIterState();
 
+  p->state->tree_batch    = make_shared<data::TreeBatch>();
+  std::swap(*(p->state->tree_batch), tree_batch);
+  p->state->py_tree_batch = py_tree_batch_capsule(p->state->tree_batch);
+
+  const vector<CELL_IDX_T>& index = p->state->tree_batch->index;
+  p->state->tree_order.resize(index.size());
+  std::iota(p->state->tree_order.begin(), p->state->tree_order.end(), 0);
+  std::stable_sort(p->state->tree_order.begin(), p->state->tree_order.end(),
+                   [&index] (size_t a, size_t b) { return index[a] > index[b]; });
+
   p->state->seq_index     = 0;
-  p->state->count         = std::distance(tree_list.cbegin(), tree_list.cend());
-  p->state->tree_list     = tree_list;
+  p->state->count         = index.size();
   p->state->attr_name_spaces = attr_name_spaces;
   p->state->attr_maps  = attr_maps;
-  p->state->it_tree    = p->state->tree_list.cbegin();
   p->state->topology_flag = topology_flag;
   p->state->validate_flag = validate_flag;
 
@@ -1548,30 +1826,6 @@ NeuroH5TreeIter_FromList(const forward_list <neurotree_t>& tree_list,
 
 
 
-static PyObject *
-NeuroH5TreeIter_FromMap(const map<CELL_IDX_T, neurotree_t>& tree_map,
-                        const vector<string>& attr_name_spaces,
-                        const map <string, NamedAttrMap>& attr_maps,
-                        const bool topology_flag, const bool validate_flag)
-
-{
-  forward_list <neurotree_t> tree_list;
-
-  std::transform (tree_map.cbegin(), tree_map.cend(),
-                  std::front_inserter(tree_list),
-                  [] (const map<CELL_IDX_T, neurotree_t>::value_type& kv)
-                  { return kv.second; });
-
-                           
-  return (PyObject *)NeuroH5TreeIter_FromList(tree_list,
-                                              attr_name_spaces,
-                                              attr_maps,
-                                              topology_flag,
-                                              validate_flag);
-}
-
-
-
 
 PyObject* py_build_cell_attr_values_dict(const CELL_IDX_T key, 
                                          const NamedAttrMap& attr_map,
@@ -2466,136 +2720,59 @@ PyObject* py_build_edge_value(const NODE_IDX_T key,
 }
 
 
-PyObject* py_build_edge_tuple_value (const NODE_IDX_T key,
-                                     const edge_tuple_t& et,
-                                     const vector<string>& edge_attr_name_spaces)
+template <class T>
+static void py_take_edge_attr_arrays (vector< vector<T> >& attr_values, const int npy_type,
+                                      PyObject *py_attrval)
 {
-  int status;
-  const vector<NODE_IDX_T>& adj_vector = get<0>(et);
-  const vector<AttrVal>& edge_attr_vector = get<1>(et);
-
-  npy_intp dims[1], ind = 0;
-  dims[0] = adj_vector.size();
-                
-  PyObject *adj_arr = PyArray_SimpleNew(1, dims, NPY_UINT32);
-  uint32_t *adj_ptr = (uint32_t *)PyArray_GetPtr((PyArrayObject *)adj_arr, &ind);
-  
-  for (size_t j = 0; j < adj_vector.size(); j++)
+  for (size_t i = 0; i < attr_values.size(); i++)
     {
-      adj_ptr[j] = adj_vector[j];
+      PyObject *py_arr = py_array_from_moved_vector(attr_values[i], npy_type);
+      int status = PyList_Append(py_attrval, py_arr);
+      throw_assert(status == 0,
+                   "py_take_edge_tuple_value: unable to append to list");
+      Py_DECREF(py_arr);
     }
+}
+
+/* Builds the (adjacency array, {namespace: [attribute arrays]}) value
+ * of an edge tuple. The adjacency and attribute vectors of the tuple
+ * are moved into the returned arrays instead of being copied; et is
+ * left empty.
+ */
+PyObject* py_take_edge_tuple_value (const NODE_IDX_T key,
+                                    edge_tuple_t& et,
+                                    const vector<string>& edge_attr_name_spaces)
+{
+  vector<NODE_IDX_T>& adj_vector = get<0>(et);
+  vector<AttrVal>& edge_attr_vector = get<1>(et);
+
+  PyObject *adj_arr = py_array_from_moved_vector(adj_vector, NPY_UINT32);
   
   PyObject *py_attrmap  = PyDict_New();
   size_t namespace_index=0;
-  for (auto const & edge_attr_values : edge_attr_vector)
+  for (auto & edge_attr_values : edge_attr_vector)
     {
       PyObject *py_attrval  = PyList_New(0);
-          
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<float>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_FLOAT);
-          float *ptr = (float *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<float>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                       "py_build_edge_tuple_value: unable to append to list");
-          
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<uint8_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_UINT8);
-          uint8_t *ptr = (uint8_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<uint8_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<uint16_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_UINT16);
-          uint16_t *ptr = (uint16_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<uint16_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<uint32_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_UINT32);
-          uint32_t *ptr = (uint32_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<uint32_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<int8_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT8);
-          int8_t *ptr = (int8_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<int8_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<int16_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT16);
-          int16_t *ptr = (int16_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<int16_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
-      for (size_t i = 0; i < edge_attr_values.size_attr_vec<int32_t>(); i++)
-        {
-          PyObject *py_arr = (PyObject *)PyArray_SimpleNew(1, dims, NPY_INT32);
-          int32_t *ptr = (int32_t *)PyArray_GetPtr((PyArrayObject *)py_arr, &ind);
-          for (size_t j = 0; j < adj_vector.size(); j++)
-            {
-              ptr[j] = edge_attr_values.at<int32_t>(i,j); 
-            }
-          status = PyList_Append(py_attrval, py_arr);
-          throw_assert(status == 0,
-                   "py_build_edge_tuple_value: unable to append to list");
-          Py_DECREF(py_arr);
-        }
+      py_take_edge_attr_arrays(edge_attr_values.float_values, NPY_FLOAT, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.uint8_values, NPY_UINT8, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.uint16_values, NPY_UINT16, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.uint32_values, NPY_UINT32, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.int8_values, NPY_INT8, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.int16_values, NPY_INT16, py_attrval);
+      py_take_edge_attr_arrays(edge_attr_values.int32_values, NPY_INT32, py_attrval);
           
       PyDict_SetItemString(py_attrmap, edge_attr_name_spaces[namespace_index].c_str(), py_attrval);
       Py_DECREF(py_attrval);
 
       namespace_index++;
     }
+  edge_attr_vector.clear();
                 
   PyObject *py_edgeval  = PyTuple_New(2);
   PyTuple_SetItem(py_edgeval, 0, adj_arr);
   PyTuple_SetItem(py_edgeval, 1, py_attrmap);
 
   return py_edgeval;
-
 }
 
 
@@ -2743,7 +2920,7 @@ typedef struct {
   edge_map_t edge_map;
   vector<string> edge_attr_name_spaces;
   
-  edge_map_iter_t it_edge;
+  edge_map_t::iterator it_edge;
   
 } NeuroH5EdgeIterState;
 
@@ -2769,12 +2946,13 @@ static void NeuroH5EdgeIter_dealloc(PyNeuroH5EdgeIterState *py_state)
 PyObject* NeuroH5EdgeIter_iternext(PyObject *self)
 {
   PyNeuroH5EdgeIterState *py_state = (PyNeuroH5EdgeIterState *)self;
-  if (py_state->state->it_edge != py_state->state->edge_map.cend())
+  if (py_state->state->it_edge != py_state->state->edge_map.end())
     {
       const NODE_IDX_T key      = py_state->state->it_edge->first;
-      const edge_tuple_t& et    = py_state->state->it_edge->second;
+      edge_tuple_t& et          = py_state->state->it_edge->second;
 
-      PyObject* py_edge_tuple_value = py_build_edge_tuple_value (key, et, py_state->state->edge_attr_name_spaces);
+      // each edge is yielded once, so its vectors are moved to the arrays
+      PyObject* py_edge_tuple_value = py_take_edge_tuple_value (key, et, py_state->state->edge_attr_name_spaces);
       throw_assert(py_edge_tuple_value != NULL,
                    "NeuroH5EdgeIter: invalid edge tuple value");
 
@@ -2827,7 +3005,7 @@ static PyTypeObject PyNeuroH5EdgeIter_Type = {
 
 
 static PyObject *
-NeuroH5EdgeIter_FromMap(const edge_map_t& prj_edge_map,
+NeuroH5EdgeIter_FromMap(edge_map_t& prj_edge_map,
                         const vector <string>& edge_attr_name_spaces)
 {
 
@@ -2847,7 +3025,7 @@ NeuroH5EdgeIter_FromMap(const edge_map_t& prj_edge_map,
   p->state->count         = prj_edge_map.size();
   p->state->edge_map      = std::move(prj_edge_map);
   p->state->edge_attr_name_spaces = edge_attr_name_spaces;
-  p->state->it_edge       = p->state->edge_map.cbegin();
+  p->state->it_edge       = p->state->edge_map.begin();
   
   return (PyObject *)p;
 }
@@ -2867,6 +3045,7 @@ extern "C"
     char *input_file_name;
     PyObject *py_attr_name_spaces=NULL;
     PyObject *py_comm = NULL;
+    PyObject *py_mask = NULL, *py_predicate = NULL;
     MPI_Comm *comm_ptr  = NULL;
     size_t total_num_nodes, total_num_edges = 0, local_num_edges = 0;
 
@@ -2874,14 +3053,19 @@ extern "C"
                                    "file_name",
                                    "namespaces",
                                    "comm",
+                                   "mask",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OO", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOOO", (char **)kwlist,
                                      &input_file_name,
                                      &py_attr_name_spaces,
-                                     &py_comm))
+                                     &py_comm, &py_mask, &py_predicate))
       return NULL;
 
+    graph::EdgeAttrFilter edge_filter;
+    py_edge_attr_filter(py_mask, py_predicate, edge_filter);
+
     PyObject *py_prj_dict = PyDict_New();
     MPI_Comm comm;
 
@@ -2922,7 +3106,8 @@ extern "C"
 
     graph::read_graph(comm, std::string(input_file_name), edge_attr_name_spaces,
                       prj_names, prj_vector, edge_attr_name_vector,
-                      total_num_nodes, local_num_edges, total_num_edges);
+                      total_num_nodes, local_num_edges, total_num_edges,
+                      edge_filter);
     status = MPI_Comm_free(&comm);
     throw_assert(status == MPI_SUCCESS,
                  "py_read_graph: unable to free MPI communicator");
@@ -2933,7 +3118,7 @@ extern "C"
     
     for (size_t i = 0; i < prj_vector.size(); i++)
       {
-        edge_map_t prj_edge_map = prj_vector[i];
+        edge_map_t& prj_edge_map = prj_vector[i];
 
         PyObject *py_edge_iter = NeuroH5EdgeIter_FromMap(prj_edge_map, edge_attr_name_spaces);
 
@@ -2981,6 +3166,7 @@ extern "C"
     PyObject *py_prj_dict = PyDict_New();
     unsigned long io_size; int size;
     PyObject *py_comm = NULL;
+    PyObject *py_mask = NULL, *py_predicate = NULL;
     MPI_Comm *comm_ptr = NULL;
     
     char *input_file_name;
@@ -2994,15 +3180,21 @@ extern "C"
                                    "namespaces",
                                    "map_type",
                                    "io_size",
+                                   "mask",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOOOik", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOOOikOO", (char **)kwlist,
                                      &input_file_name, &py_comm, 
                                      &py_node_allocation, &py_prj_names,
                                      &py_attr_name_spaces,
-                                     &opt_edge_map_type, &io_size))
+                                     &opt_edge_map_type, &io_size,
+                                     &py_mask, &py_predicate))
       return NULL;
 
+    graph::EdgeAttrFilter edge_filter;
+    py_edge_attr_filter(py_mask, py_predicate, edge_filter);
+
     MPI_Comm comm;
 
     if ((py_comm != NULL) && (py_comm != Py_None))
@@ -3093,7 +3285,8 @@ extern "C"
                               io_size, edge_attr_name_spaces, prj_names, node_rank_map,
                               prj_vector, edge_attr_name_vector,
                               local_num_nodes, total_num_nodes,
-                              local_num_edges, total_num_edges);
+                              local_num_edges, total_num_edges,
+                              edge_filter);
     status = MPI_Comm_free(&comm);
     throw_assert(status == MPI_SUCCESS,
                  "py_read_graph: unable to free MPI communicator");
@@ -3104,7 +3297,7 @@ extern "C"
     
     for (size_t i = 0; i < prj_vector.size(); i++)
       {
-        edge_map_t prj_edge_map = prj_vector[i];
+        edge_map_t& prj_edge_map = prj_vector[i];
 
         PyObject *py_edge_iter = NeuroH5EdgeIter_FromMap(prj_edge_map, edge_attr_name_spaces);
 
@@ -3149,6 +3342,7 @@ extern "C"
     PyObject *py_comm = NULL;
     MPI_Comm *comm_ptr  = NULL;
     PyObject *py_attr_name_spaces=NULL;
+    PyObject *py_mask = NULL, *py_predicate = NULL;
     size_t total_num_nodes, total_num_edges = 0, local_num_edges = 0;
     
     static const char *kwlist[] = {
@@ -3156,13 +3350,19 @@ extern "C"
                                    "comm",
                                    "namespaces",
                                    "map_type",
+                                   "mask",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOi", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OOiOO", (char **)kwlist,
                                      &input_file_name, &py_comm, 
-                                     &py_attr_name_spaces, &opt_edge_map_type))
+                                     &py_attr_name_spaces, &opt_edge_map_type,
+                                     &py_mask, &py_predicate))
       return NULL;
 
+    graph::EdgeAttrFilter edge_filter;
+    py_edge_attr_filter(py_mask, py_predicate, edge_filter);
+
     MPI_Comm comm;
 
     if ((py_comm != NULL) && (py_comm != Py_None))
@@ -3215,7 +3415,8 @@ extern "C"
 
     graph::bcast_graph(comm, edge_map_type, std::string(input_file_name),
                        edge_attr_name_spaces, prj_names, prj_vector, edge_attr_name_vector, 
-                       total_num_nodes, local_num_edges, total_num_edges);
+                       total_num_nodes, local_num_edges, total_num_edges,
+                       edge_filter);
     status = MPI_Comm_free(&comm);
     throw_assert(status == MPI_SUCCESS,
                  "py_bcast_graph: unable to free MPI communicator");
@@ -3256,16 +3457,16 @@ extern "C"
     for (size_t i = 0; i < prj_vector.size(); i++)
       {
         PyObject *py_edge_dict = PyDict_New();
-        edge_map_t prj_edge_map = prj_vector[i];
+        edge_map_t& prj_edge_map = prj_vector[i];
         
         if (prj_edge_map.size() > 0)
           {
-            for (auto const& it : prj_edge_map)
+            for (auto& it : prj_edge_map)
               {
                 const NODE_IDX_T key_node = it.first;
-                const edge_tuple_t& et    = it.second;
+                edge_tuple_t& et          = it.second;
 
-                PyObject* py_edge_tuple_value = py_build_edge_tuple_value (key_node, et, edge_attr_name_spaces);
+                PyObject* py_edge_tuple_value = py_take_edge_tuple_value (key_node, et, edge_attr_name_spaces);
 
                 PyObject *key = PyLong_FromLong(key_node);
                 PyDict_SetItem(py_edge_dict, key, py_edge_tuple_value);
@@ -3399,7 +3600,7 @@ extern "C"
     
     for (size_t i = 0; i < prj_vector.size(); i++)
       {
-        edge_map_t prj_edge_map = prj_vector[i];
+        edge_map_t& prj_edge_map = prj_vector[i];
 
         PyObject *py_edge_iter = NeuroH5EdgeIter_FromMap(prj_edge_map, edge_attr_name_spaces);
 
@@ -3542,7 +3743,7 @@ extern "C"
     
     for (size_t i = 0; i < prj_vector.size(); i++)
       {
-        edge_map_t prj_edge_map = prj_vector[i];
+        edge_map_t& prj_edge_map = prj_vector[i];
 
         PyObject *py_edge_iter = NeuroH5EdgeIter_FromMap(prj_edge_map, edge_attr_name_spaces);
 
@@ -3803,15 +4004,354 @@ extern "C"
   }
   
   PyDoc_STRVAR(
-    read_population_names_doc,
-    "read_population_names(file_name, comm=None)\n"
+    append_graph_edges_doc,
+    "append_graph_edges(file_name, src_pop_name, dst_pop_name, dst, src, edge_attrs=None, dst_ptr=None, comm=None, io_size=0, chunk_size=4000)\n"
     "--\n"
     "\n"
-    "Returns the names of all populations for which attributes exist in the given file.\n"
+    "Appends edges given as flat arrays to a projection in Destination Block Sparse format.\n"
+    "\n"
+    "The edges do not need to be sorted; they are redistributed by destination\n"
+    "among the I/O ranks and sorted before writing. All ranks in the communicator\n"
+    "must call this function, including ranks without edges.\n"
+    "\n"
     "Parameters\n"
     "----------\n"
     "file_name : string\n"
-    "    The NeuroH5 file to read.\n"
+    "    Name of the NeuroH5 file.\n"
+    "\n"
+    "src_pop_name : string\n"
+    "    Name of the source population.\n"
+    "\n"
+    "dst_pop_name : string\n"
+    "    Name of the destination population.\n"
+    "\n"
+    "dst : numpy.ndarray\n"
+    "    Destination gids, one per edge; or, if dst_ptr is given, one per destination.\n"
+    "\n"
+    "src : numpy.ndarray\n"
+    "    Source gids, one per edge.\n"
+    "\n"
+    "edge_attrs : dict\n"
+    "    Optional dictionary of the form { namespace: { attr_name: numpy.ndarray } }\n"
+    "    with one attribute value per edge. Namespaces and attribute names must be\n"
+    "    the same on all ranks.\n"
+    "\n"
+    "dst_ptr : numpy.ndarray\n"
+    "    Optional compressed sparse row pointer array of length len(dst)+1; if given,\n"
+    "    the sources of destination dst[i] are src[dst_ptr[i]:dst_ptr[i+1]].\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "io_size : int\n"
+    "    Optional number of I/O ranks.\n"
+    "\n"
+    "chunk_size : int\n"
+    "    Optional HDF5 chunk size.\n"
+    "\n");
+
+  static PyObject *py_append_graph_edges (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *py_dst, *py_src;
+    PyObject *py_edge_attrs = NULL;
+    PyObject *py_dst_ptr = NULL;
+    PyObject *py_comm = NULL;
+    MPI_Comm *comm_ptr = NULL;
+    char *file_name_arg, *src_pop_name_arg, *dst_pop_name_arg;
+    unsigned long io_size = 0;
+    const unsigned long default_chunk_size = 4000;
+    unsigned long chunk_size = default_chunk_size;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "src_pop_name",
+                                   "dst_pop_name",
+                                   "dst",
+                                   "src",
+                                   "edge_attrs",
+                                   "dst_ptr",
+                                   "comm",
+                                   "io_size",
+                                   "chunk_size",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sssOO|OOOkk", (char **)kwlist,
+                                     &file_name_arg, &src_pop_name_arg, &dst_pop_name_arg,
+                                     &py_dst, &py_src, &py_edge_attrs, &py_dst_ptr,
+                                     &py_comm, &io_size, &chunk_size))
+      return NULL;
+
+    MPI_Comm comm;
+
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_append_graph_edges: invalid MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_append_graph_edges: invalid MPI communicator");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_append_graph_edges: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_append_graph_edges: unable to duplicate MPI communicator");
+      }
+
+    int size;
+    status = MPI_Comm_size(comm, &size);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_append_graph_edges: unable to obtain size of MPI communicator");
+    if (io_size == 0)
+      {
+        io_size = size;
+      }
+
+    string file_name = string(file_name_arg);
+    string src_pop_name = string(src_pop_name_arg);
+    string dst_pop_name = string(dst_pop_name_arg);
+
+    vector<NODE_IDX_T> dst, src;
+    py_index_array_to_vector<NODE_IDX_T>(py_dst, NPY_UINT32, dst);
+    py_index_array_to_vector<NODE_IDX_T>(py_src, NPY_UINT32, src);
+
+    if ((py_dst_ptr != NULL) && (py_dst_ptr != Py_None))
+      {
+        vector<DST_PTR_T> dst_ptr;
+        vector<NODE_IDX_T> dst_index;
+        py_index_array_to_vector<DST_PTR_T>(py_dst_ptr, NPY_UINT64, dst_ptr);
+        dst_index.swap(dst);
+        graph::expand_csr_destinations(dst_index, dst_ptr, dst);
+      }
+
+    map <string, pair <size_t, AttrIndex > > edge_attr_index;
+    map <string, NamedAttrVal> edge_attr_map;
+
+    if ((py_edge_attrs != NULL) && (py_edge_attrs != Py_None))
+      {
+        throw_assert(PyDict_Check(py_edge_attrs),
+                     "py_append_graph_edges: edge_attrs argument is not a dictionary");
+
+        map <string, AttrSet> attr_set_map;
+        PyObject *py_attr_namespace, *py_attr_namespace_value;
+        Py_ssize_t attr_namespace_pos = 0;
+        while (PyDict_Next(py_edge_attrs, &attr_namespace_pos, &py_attr_namespace, &py_attr_namespace_value))
+          {
+            throw_assert(PyStr_Check(py_attr_namespace),
+                         "py_append_graph_edges: namespace is not a string");
+            string attr_namespace = string(PyStr_ToCString(py_attr_namespace));
+            AttrSet& attr_set = attr_set_map[attr_namespace];
+
+            PyObject *py_attr_key, *py_attr_values;
+            Py_ssize_t attr_pos = 0;
+            while (PyDict_Next(py_attr_namespace_value, &attr_pos, &py_attr_key, &py_attr_values))
+              {
+                throw_assert(PyArray_Check(py_attr_values),
+                             "py_append_graph_edges: attribute value is not an array");
+                string attr_name = string(PyStr_ToCString(py_attr_key));
+                switch (PyArray_TYPE((PyArrayObject *)py_attr_values))
+                  {
+                  case NPY_UINT32: attr_set.add<uint32_t>(attr_name); break;
+                  case NPY_UINT16: attr_set.add<uint16_t>(attr_name); break;
+                  case NPY_UINT8:  attr_set.add<uint8_t>(attr_name);  break;
+                  case NPY_INT32:  attr_set.add<int32_t>(attr_name);  break;
+                  case NPY_INT16:  attr_set.add<int16_t>(attr_name);  break;
+                  case NPY_INT8:   attr_set.add<int8_t>(attr_name);   break;
+                  case NPY_FLOAT:  attr_set.add<float>(attr_name);    break;
+                  default:
+                    throw runtime_error("Unsupported attribute type");
+                    break;
+                  }
+              }
+          }
+
+        map <string, AttrSet>::const_iterator ns_first = attr_set_map.cbegin();
+        for (auto ns_it=attr_set_map.cbegin(); ns_it != attr_set_map.cend(); ++ns_it)
+          {
+            size_t attr_ns_index = distance(ns_first, ns_it);
+            edge_attr_index[ns_it->first] = make_pair(attr_ns_index, AttrIndex(ns_it->second));
+          }
+
+        attr_namespace_pos = 0;
+        while (PyDict_Next(py_edge_attrs, &attr_namespace_pos, &py_attr_namespace, &py_attr_namespace_value))
+          {
+            string attr_namespace = string(PyStr_ToCString(py_attr_namespace));
+            const AttrIndex& attr_index = edge_attr_index[attr_namespace].second;
+            NamedAttrVal& edge_attr = edge_attr_map[attr_namespace];
+
+            PyObject *py_attr_key, *py_attr_values;
+            Py_ssize_t attr_pos = 0;
+            while (PyDict_Next(py_attr_namespace_value, &attr_pos, &py_attr_key, &py_attr_values))
+              {
+                string attr_name = string(PyStr_ToCString(py_attr_key));
+                switch (PyArray_TYPE((PyArrayObject *)py_attr_values))
+                  {
+                  case NPY_UINT32:
+                    append_edge_attr_column<uint32_t>(py_attr_values, attr_index, attr_name, edge_attr.uint32_values);
+                    break;
+                  case NPY_UINT16:
+                    append_edge_attr_column<uint16_t>(py_attr_values, attr_index, attr_name, edge_attr.uint16_values);
+                    break;
+                  case NPY_UINT8:
+                    append_edge_attr_column<uint8_t>(py_attr_values, attr_index, attr_name, edge_attr.uint8_values);
+                    break;
+                  case NPY_INT32:
+                    append_edge_attr_column<int32_t>(py_attr_values, attr_index, attr_name, edge_attr.int32_values);
+                    break;
+                  case NPY_INT16:
+                    append_edge_attr_column<int16_t>(py_attr_values, attr_index, attr_name, edge_attr.int16_values);
+                    break;
+                  case NPY_INT8:
+                    append_edge_attr_column<int8_t>(py_attr_values, attr_index, attr_name, edge_attr.int8_values);
+                    break;
+                  case NPY_FLOAT:
+                    append_edge_attr_column<float>(py_attr_values, attr_index, attr_name, edge_attr.float_values);
+                    break;
+                  default:
+                    break;
+                  }
+              }
+          }
+      }
+
+    status = graph::append_graph_edges(comm, io_size, file_name, src_pop_name, dst_pop_name,
+                                       edge_attr_index, dst, src, edge_attr_map, chunk_size);
+    throw_assert(status >= 0,
+                 "py_append_graph_edges: unable to append projection");
+
+    status = MPI_Barrier(comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_append_graph_edges: barrier error");
+    status = MPI_Comm_free(&comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_append_graph_edges: unable to free MPI communicator");
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyDoc_STRVAR(
+    update_graph_attributes_doc,
+    "update_graph_attributes(file_name, src_pop_name, dst_pop_name, edges, comm=None, chunk_size=4000)\n"
+    "--\n"
+    "\n"
+    "Overwrites the edge attribute values of an existing projection in place.\n"
+    "\n"
+    "The connectivity of the projection is not rewritten; only the given attribute\n"
+    "values are written at the positions of the edges in the file, e.g. to checkpoint\n"
+    "synaptic weights after plasticity. The edges of each destination must be those\n"
+    "returned by read_graph or scatter_read_graph, in the same order, and each\n"
+    "destination must be given on at most one rank. Namespaces or attributes that do\n"
+    "not exist in the file are created. All ranks in the communicator must call this\n"
+    "function, including ranks without edges.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of the NeuroH5 file.\n"
+    "\n"
+    "src_pop_name : string\n"
+    "    Name of the source population.\n"
+    "\n"
+    "dst_pop_name : string\n"
+    "    Name of the destination population.\n"
+    "\n"
+    "edges : dict\n"
+    "    Dictionary of the form { dst_gid: (src_gids, { namespace: { attr_name: numpy.ndarray } }) }.\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "chunk_size : int\n"
+    "    Optional HDF5 chunk size of created attribute datasets.\n"
+    "\n");
+
+  static PyObject *py_update_graph_attributes (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *edge_values = NULL;
+    PyObject *py_comm  = NULL;
+    MPI_Comm *comm_ptr = NULL;
+    char *file_name_arg, *src_pop_name_arg, *dst_pop_name_arg;
+    const unsigned long default_chunk_size = 4000;
+    unsigned long chunk_size = default_chunk_size;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "src_pop_name",
+                                   "dst_pop_name",
+                                   "edges",
+                                   "comm",
+                                   "chunk_size",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sssO|Ok", (char **)kwlist,
+                                     &file_name_arg, &src_pop_name_arg, &dst_pop_name_arg,
+                                     &edge_values, &py_comm, &chunk_size))
+      return NULL;
+
+    throw_assert(PyDict_Check(edge_values),
+                 "py_update_graph_attributes: edges argument is not a dictionary");
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_update_graph_attributes: invalid MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_update_graph_attributes: invalid MPI communicator");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_update_graph_attributes: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_update_graph_attributes: unable to duplicate MPI communicator");
+      }
+
+    string file_name = string(file_name_arg);
+    string src_pop_name = string(src_pop_name_arg);
+    string dst_pop_name = string(dst_pop_name_arg);
+
+    edge_map_t edge_map;
+    map <string, pair <size_t, AttrIndex > > edge_attr_index;
+
+    get_edge_attr_index (edge_values, edge_attr_index);
+    build_edge_map(edge_values, edge_attr_index, edge_map);
+
+    status = graph::update_edge_attributes(comm, file_name, src_pop_name, dst_pop_name,
+                                           edge_attr_index, edge_map, chunk_size);
+    throw_assert(status >= 0,
+                 "py_update_graph_attributes: unable to update edge attributes");
+
+    status = MPI_Barrier(comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_update_graph_attributes: barrier error");
+    status = MPI_Comm_free(&comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_update_graph_attributes: unable to free MPI communicator");
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyDoc_STRVAR(
+    read_population_names_doc,
+    "read_population_names(file_name, comm=None)\n"
+    "--\n"
+    "\n"
+    "Returns the names of all populations for which attributes exist in the given file.\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    The NeuroH5 file to read.\n"
     "    \n"
     "    .. warning::\n"
     "       The given file must be a valid HDF5 file that contains /H5Types and /Populations groups.\n"
@@ -4643,7 +5183,7 @@ extern "C"
   
   PyDoc_STRVAR(
     read_trees_doc,
-    "read_trees(file_name, population_name, namespaces=[], topology=True, validate=True, comm=None)\n"
+    "read_trees(file_name, population_name, namespaces=[], topology=True, validate=True, comm=None, tree_fields=None)\n"
     "--\n"
     "\n"
     "Reads neuronal tree morphologies contained in the given file. "
@@ -4669,6 +5209,11 @@ extern "C"
     "validate : boolean\n"
     "    An optional flag that specifies whether the tree should be validated.\n"
     "\n"
+    "tree_fields : string collection\n"
+    "    An optional collection of tree fields to read (x, y, z, radius, layer, parent, swc_type, sections, src, dst). "
+    "If given, only these fields are read and returned, and partial trees are not validated; "
+    "the section topology is only returned if parent, sections, src and dst are all read.\n"
+    "\n"
     "comm : MPI communicator\n"
     "    Optional MPI communicator. If None, the world communicator will be used.\n"
     "\n"
@@ -4710,6 +5255,7 @@ extern "C"
     MPI_Comm *comm_ptr  = NULL;
     char *file_name, *pop_name;
     PyObject *py_attr_name_spaces=NULL;
+    PyObject *py_tree_fields=NULL;
     
     static const char *kwlist[] = {
                                    "file_name",
@@ -4719,15 +5265,17 @@ extern "C"
                                    "namespaces",
                                    "topology",
                                    "validate",
+                                   "tree_fields",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOii", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOiiO", (char **)kwlist,
                                      &file_name, &pop_name, &py_comm, &py_mask, 
                                      &py_attr_name_spaces, 
-                                     &topology_flag, &validate_flag))
+                                     &topology_flag, &validate_flag, &py_tree_fields))
       return NULL;
 
-    set<string> attr_mask;
+    set<string> attr_mask, tree_mask;
+    py_tree_field_names(py_tree_fields, tree_mask);
 
     if (py_mask != NULL)
       {
@@ -4818,11 +5366,11 @@ extern "C"
     }
 
     
-    forward_list<neurotree_t> tree_list;
+    data::TreeBatch tree_batch;
 
     status = cell::read_trees (comm, string(file_name),
                                string(pop_name), pop_start,
-                               tree_list);
+                               tree_batch, 0, 0, tree_mask);
     throw_assert (status >= 0,
                  "py_read_trees: unable to read trees");
 
@@ -4842,11 +5390,11 @@ extern "C"
                  "py_read_trees: unable to free MPI communicator");
 
 
-    PyObject* py_tree_iter = NeuroH5TreeIter_FromList(tree_list,
-                                                      attr_name_spaces,
-                                                      attr_maps,
-                                                      topology_flag>0,
-                                                      validate_flag>0);
+    PyObject* py_tree_iter = NeuroH5TreeIter_FromBatch(tree_batch,
+                                                       attr_name_spaces,
+                                                       attr_maps,
+                                                       topology_flag>0,
+                                                       validate_flag>0);
 
     PyObject *py_result_tuple = PyTuple_New(2);
     PyTuple_SetItem(py_result_tuple, 0, py_tree_iter);
@@ -4859,7 +5407,7 @@ extern "C"
 
   PyDoc_STRVAR(
     scatter_read_trees_doc,
-    "scatter_read_trees(file_name, population_name, namespaces=[], topology=True, validate=True, node_allocation=None, comm=None, io_size=0)\n"
+    "scatter_read_trees(file_name, population_name, namespaces=[], topology=True, validate=True, node_allocation=None, comm=None, io_size=0, tree_fields=None)\n"
     "--\n"
     "\n"
     "Reads neuronal tree morphologies contained in the given file and scatters them to their assigned ranks. "
@@ -4888,6 +5436,11 @@ extern "C"
     "validate : boolean\n"
     "    An optional flag that specifies whether the tree should be validated.\n"
     "\n"
+    "tree_fields : string collection\n"
+    "    An optional collection of tree fields to read (x, y, z, radius, layer, parent, swc_type, sections, src, dst). "
+    "If given, only these fields are read and returned, and partial trees are not validated; "
+    "the section topology is only returned if parent, sections, src and dst are all read.\n"
+    "\n"
     "comm : MPI communicator\n"
     "    Optional MPI communicator. If None, the world communicator will be used.\n"
     "\n"
@@ -4933,6 +5486,7 @@ extern "C"
     char *file_name, *pop_name;
     PyObject *py_node_allocation=NULL;
     PyObject *py_attr_name_spaces=NULL;
+    PyObject *py_tree_fields=NULL;
     node_rank_map_t node_rank_map;
     static const char *kwlist[] = {
                                    "file_name",
@@ -4943,13 +5497,17 @@ extern "C"
                                    "topology",
                                    "validate",
                                    "io_size",
+                                   "tree_fields",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOiik", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOiikO", (char **)kwlist,
                                      &file_name, &pop_name, &py_comm, 
                                      &py_node_allocation, &py_attr_name_spaces,
-                                     &topology_flag, &validate_flag, &io_size))
+                                     &topology_flag, &validate_flag, &io_size,
+                                     &py_tree_fields))
       return NULL;
+    set<string> tree_mask;
+    py_tree_field_names(py_tree_fields, tree_mask);
     MPI_Comm comm;
 
     if ((py_comm != NULL) && (py_comm != Py_None))
@@ -5044,16 +5602,15 @@ extern "C"
         // round-robin node to rank assignment from file
 
         vector<CELL_IDX_T> cell_index;
-        throw_assert(cell::read_cell_index(comm,
+        throw_assert(cell::read_tree_index(comm,
                                            string(file_name),
                                            string(pop_name),
-                                           hdf5::TREES,
+                                           pop_start,
                                            cell_index) >= 0,
                      "scatter_read_trees: unable to read cell index");
 
         for (size_t i = 0; i < cell_index.size(); i++)
           {
-            cell_index[i] += pop_start;
             throw_assert((cell_index[i] >= pop_start) &&
                          (cell_index[i] < (pop_start + pop_count)),
                          "scatter_read_trees: invalid index " << cell_index[i]);
@@ -5070,23 +5627,24 @@ extern "C"
       }
     
 
-    map<CELL_IDX_T, neurotree_t> tree_map;
+    data::TreeBatch tree_batch;
     map<string, NamedAttrMap> attr_maps;
     
     status = cell::scatter_read_trees (comm, string(file_name),
                                        io_size, attr_name_spaces,
                                        node_rank_map, string(pop_name),
                                        pop_start,
-                                       tree_map, attr_maps);
+                                       tree_batch, attr_maps,
+                                       0, 0, tree_mask);
     throw_assert (status >= 0,
                  "py_scatter_read_trees: unable to read trees");
 
 
-    PyObject* py_tree_iter = NeuroH5TreeIter_FromMap(tree_map,
-                                                     attr_name_spaces,
-                                                     attr_maps,
-                                                     topology_flag>0,
-                                                     validate_flag>0);
+    PyObject* py_tree_iter = NeuroH5TreeIter_FromBatch(tree_batch,
+                                                       attr_name_spaces,
+                                                       attr_maps,
+                                                       topology_flag>0,
+                                                       validate_flag>0);
 
     PyObject *py_result_tuple = PyTuple_New(2);
     PyTuple_SetItem(py_result_tuple, 0, py_tree_iter);
@@ -5103,7 +5661,7 @@ extern "C"
 
   PyDoc_STRVAR(
     read_tree_selection_doc,
-    "read_tree_selection(file_name, population_name, selection, namespaces=[], topology=True, validate=True, comm=None)\n"
+    "read_tree_selection(file_name, population_name, selection, namespaces=[], topology=True, validate=True, comm=None, tree_fields=None)\n"
     "--\n"
     "\n"
     "Reads selected neuronal tree morphologies contained in the given file. "
@@ -5132,6 +5690,11 @@ extern "C"
     "validate : boolean\n"
     "    An optional flag that specifies whether the tree should be validated.\n"
     "\n"
+    "tree_fields : string collection\n"
+    "    An optional collection of tree fields to read (x, y, z, radius, layer, parent, swc_type, sections, src, dst). "
+    "If given, only these fields are read and returned, and partial trees are not validated; "
+    "the section topology is only returned if parent, sections, src and dst are all read.\n"
+    "\n"
     "comm : MPI communicator\n"
     "    Optional MPI communicator. If None, the world communicator will be used.\n"
     "\n"
@@ -5173,6 +5736,7 @@ extern "C"
     char *file_name, *pop_name;
     PyObject *py_attr_name_spaces=NULL;
     PyObject *py_selection=NULL;
+    PyObject *py_tree_fields=NULL;
     vector <CELL_IDX_T> selection;
 
     static const char *kwlist[] = {
@@ -5184,18 +5748,20 @@ extern "C"
                                    "namespaces",
                                    "topology",
                                    "validate",
+                                   "tree_fields",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssO|OOOii", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssO|OOOiiO", (char **)kwlist,
                                      &file_name, &pop_name,
                                      &py_selection, &py_comm, 
                                      &py_attr_name_spaces, &py_mask,
-                                     &topology_flag, &validate_flag))
+                                     &topology_flag, &validate_flag, &py_tree_fields))
       return NULL;
     throw_assert(PyList_Check(py_selection) > 0,
                  "py_read_tree_selection: unable to read tree selection");
 
-    set<string> attr_mask;
+    set<string> attr_mask, tree_mask;
+    py_tree_field_names(py_tree_fields, tree_mask);
 
     if (py_mask != NULL)
       {
@@ -5296,11 +5862,11 @@ extern "C"
         pop_count = it->second.count;
     }
 
-    forward_list<neurotree_t> tree_list;
+    data::TreeBatch tree_batch;
 
     status = cell::read_tree_selection (comm, string(file_name),
                                         string(pop_name), pop_start,
-                                        tree_list, selection);
+                                        tree_batch, selection, tree_mask);
     throw_assert (status >= 0,
                   "py_read_tree_selection: unable to read trees");
 
@@ -5319,11 +5885,11 @@ extern "C"
                  "py_read_tree_selection: unable to free MPI communicator");
 
 
-    PyObject* py_tree_iter = NeuroH5TreeIter_FromList(tree_list,
-                                                      attr_name_spaces,
-                                                      attr_maps,
-                                                      topology_flag>0,
-                                                      validate_flag>0);
+    PyObject* py_tree_iter = NeuroH5TreeIter_FromBatch(tree_batch,
+                                                       attr_name_spaces,
+                                                       attr_maps,
+                                                       topology_flag>0,
+                                                       validate_flag>0);
 
     PyObject *py_result_tuple = PyTuple_New(2);
     PyTuple_SetItem(py_result_tuple, 0, py_tree_iter);
@@ -5344,6 +5910,7 @@ extern "C"
     char *file_name, *pop_name;
     PyObject *py_attr_name_spaces=NULL;
     PyObject *py_selection=NULL;
+    PyObject *py_tree_fields=NULL;
     vector <CELL_IDX_T> selection;
 
 
@@ -5357,16 +5924,19 @@ extern "C"
                                    "topology",
                                    "validate",
                                    "io_size",
+                                   "tree_fields",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssO|OOOiik", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssO|OOOiikO", (char **)kwlist,
                                      &file_name, &pop_name,
                                      &py_selection, &py_comm, &py_mask,
                                      &py_attr_name_spaces, 
-                                     &topology_flag, &validate_flag, &io_size))
+                                     &topology_flag, &validate_flag, &io_size,
+                                     &py_tree_fields))
       return NULL;
 
-    set<string> attr_mask;
+    set<string> attr_mask, tree_mask;
+    py_tree_field_names(py_tree_fields, tree_mask);
 
     if (py_mask != NULL)
       {
@@ -5481,23 +6051,24 @@ extern "C"
     }
 
     map <string, NamedAttrMap> attr_maps;
-    map<CELL_IDX_T, neurotree_t> tree_map;
+    data::TreeBatch tree_batch;
 
     status = cell::scatter_read_tree_selection (comm, string(file_name), io_size,
                                                 attr_name_spaces, 
                                                 string(pop_name), pop_start,
-                                                selection, tree_map, attr_maps);
+                                                selection, tree_batch, attr_maps,
+                                                tree_mask);
     throw_assert (status >= 0,
                   "py_scatter_read_tree_selection: unable to read trees");
 
     throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
                  "py_scatter_read_tree_selection: unable to free MPI communicator");
 
-    PyObject* py_tree_iter = NeuroH5TreeIter_FromMap(tree_map,
-                                                     attr_name_spaces,
-                                                     attr_maps,
-                                                     topology_flag>0,
-                                                     validate_flag>0);
+    PyObject* py_tree_iter = NeuroH5TreeIter_FromBatch(tree_batch,
+                                                       attr_name_spaces,
+                                                       attr_maps,
+                                                       topology_flag>0,
+                                                       validate_flag>0);
 
     PyObject *py_result_tuple = PyTuple_New(2);
     PyTuple_SetItem(py_result_tuple, 0, py_tree_iter);
@@ -5508,55 +6079,746 @@ extern "C"
 
 
   PyDoc_STRVAR(
-    scatter_read_cell_attributes_doc,
-    "scatter_read_cell_attributes(file_name, population_name, namespaces, node_allocation=None, comm=None, io_size=0)\n"
+    tree_morphometrics_doc,
+    "tree_morphometrics(trees, num_threads=0)\n"
     "--\n"
     "\n"
-    "Reads cell attributes for all cell gids contained in the given file and namespaces, using scalable parallel read/scatter."
-    "Each rank will be assigned an equal number of cell gids, with the exception of the last rank if the number of cells is not evenly divisible by the number of ranks. \n"
+    "Computes morphometric quantities of all trees held by a tree iterator, using a pool of threads. "
+    "The result can be written with append_cell_attributes. \n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "trees : tree iterator\n"
+    "    A tree iterator returned by read_trees, read_tree_selection, scatter_read_trees or scatter_read_tree_selection. "
+    "The trees must include the fields x, y, z, layer, parent, swc_type, sections, src and dst.\n"
+    "\n"
+    "num_threads : int\n"
+    "    Number of threads to use. If 0, the value of the environment variable NEUROH5_NUM_THREADS is used, or 1 if it is not set.\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "dict\n"
+    "    A dictionary that maps each gid to a dictionary with the following attributes: \n"
+    "    - Section Length: length of each section along its points (float ndarray)\n"
+    "    - Section Branch Order: number of branching sections between each section and the root section (uint16 ndarray)\n"
+    "    - Path Distance: path distance of each point to the root point (float ndarray)\n"
+    "    - Layer Length: dendritic length in each layer (float ndarray)\n"
+    "    - Bounding Box: minimum x, y, z and maximum x, y, z coordinates (float ndarray)\n"
+    "    - Total Length: total length of the tree (float ndarray)\n"
+    "\n");
+
+  static PyObject *py_tree_morphometrics (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    PyObject *py_trees = NULL;
+    unsigned long num_threads = 0;
+
+    static const char *kwlist[] = {
+                                   "trees",
+                                   "num_threads",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|k", (char **)kwlist,
+                                     &py_trees, &num_threads))
+      return NULL;
+
+    if (!PyObject_TypeCheck(py_trees, &PyNeuroH5TreeIter_Type))
+      {
+        PyErr_SetString(PyExc_TypeError, "tree_morphometrics: argument trees must be a tree iterator");
+        return NULL;
+      }
+
+    const data::TreeBatch& tree_batch = *(((PyNeuroH5TreeIterState *)py_trees)->state->tree_batch);
+
+    cell::tree_morphometrics_t morph;
+    {
+      data::thread_pool pool((num_threads > 0) ? num_threads : data::default_num_threads());
+      cell::compute_tree_morphometrics(tree_batch, pool, morph);
+    }
+
+    PyObject *py_result = PyDict_New();
+    for (size_t i = 0; i < morph.size(); i++)
+      {
+        PyObject *py_attrs = PyDict_New();
+        py_morphometrics_attr(py_attrs, cell::SECTION_LENGTH, morph.section_length,
+                              morph.section_ptr[i], morph.section_ptr[i+1], NPY_FLOAT);
+        py_morphometrics_attr(py_attrs, cell::SECTION_BRANCH_ORDER, morph.section_branch_order,
+                              morph.section_ptr[i], morph.section_ptr[i+1], NPY_UINT16);
+        py_morphometrics_attr(py_attrs, cell::PATH_DISTANCE, morph.path_distance,
+                              morph.point_ptr[i], morph.point_ptr[i+1], NPY_FLOAT);
+        py_morphometrics_attr(py_attrs, cell::LAYER_LENGTH, morph.layer_length,
+                              i*morph.num_layers, (i+1)*morph.num_layers, NPY_FLOAT);
+        py_morphometrics_attr(py_attrs, cell::BOUNDING_BOX, morph.bounding_box,
+                              6*i, 6*(i+1), NPY_FLOAT);
+        py_morphometrics_attr(py_attrs, cell::TOTAL_LENGTH, morph.total_length,
+                              i, i+1, NPY_FLOAT);
+
+        PyObject *py_gid = PyLong_FromLong((long)morph.index[i]);
+        PyDict_SetItem(py_result, py_gid, py_attrs);
+        Py_DECREF(py_gid);
+        Py_DECREF(py_attrs);
+      }
+
+    return py_result;
+  }
+
+
+  PyDoc_STRVAR(
+    query_cell_neighbors_doc,
+    "query_cell_neighbors(file_name, population_name, queries, namespace='Coordinates', radius=-1.0, k=0, coord_names=None, comm=None, num_threads=0)\n"
+    "--\n"
+    "\n"
+    "Finds the cells of a population near a set of query points, for example to determine the candidate sources of distance-dependent connections. "
+    "The coordinates of the cells are read from a cell attribute namespace and indexed in a k-d tree distributed over the ranks of the communicator. "
+    "Exactly one of radius or k must be given. This function is collective, but each rank may pass a different number of query points. \n"
     "\n"
     "Parameters\n"
     "----------\n"
     "file_name : string\n"
-    "    The NeuroH5 file to read.\n"
-    "    \n"
-    "    .. warning::\n"
-    "       The given file must be a valid HDF5 file that contains /H5Types and /Populations groups.\n"
+    "    Name of NeuroH5 file that contains the cell coordinates.\n"
     "\n"
     "population_name : string\n"
-    "    Name of population from which to read.\n"
+    "    Name of population of the cells to be indexed.\n"
     "\n"
-    "namespaces : string list\n"
-    "    The namespaces for which cell attributes will be read.\n"
+    "queries : numpy array\n"
+    "    Array of shape (n, 3) with the x, y, z coordinates of the query points of this rank.\n"
     "\n"
-    "comm : MPI communicator\n"
-    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "namespace : string\n"
+    "    Name of the cell attribute namespace that contains the cell coordinates.\n"
     "\n"
-    "io_size : \n"
-    "    Optional number of ranks performing I/O operations. If 0, this number will be equal to the size of the MPI communicator.\n"
+    "radius : float\n"
+    "    If non-negative, all cells within this distance of each query point are returned.\n"
     "\n"
-    "node_allocation : \n"
-    "    Optional iterable that with gids assigned to rank. If None, round-robin assignment will be used.\n"
+    "k : int\n"
+    "    If positive, the k cells nearest to each query point are returned.\n"
     "\n"
-    "mask : set of string\n"
-    "    Optional set of attributes to be read. If not set, all attributes in the namespace will be read.\n"
+    "coord_names : list of strings\n"
+    "    Names of the x, y and z coordinate attributes. The default is ['X Coordinate', 'Y Coordinate', 'Z Coordinate'].\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "num_threads : int\n"
+    "    Number of threads to use for answering queries. If 0, the value of the environment variable NEUROH5_NUM_THREADS is used, or 1 if it is not set.\n"
     "\n"
     "Returns\n"
     "-------\n"
-    "Dictionary of the form { namespace: cell_iter }, where: \n"
-    "cell_iter : iterator\n"
-    "   An iterator that returns pairs (gid, attr_dict) where gid is the cell id and attr_dict is a dictionary with attribute key-value pairs. \n"
+    "(ptr, gids, distances) : tuple\n"
+    "    Neighbors in compressed sparse row form: the neighbors of query point i are gids[ptr[i]:ptr[i+1]] "
+    "at distances distances[ptr[i]:ptr[i+1]], in order of increasing distance and then gid.\n"
     "\n");
 
-  static PyObject *py_scatter_read_cell_attributes (PyObject *self, PyObject *args, PyObject *kwds)
+  static PyObject *py_query_cell_neighbors (PyObject *self, PyObject *args, PyObject *kwds)
   {
-    int status;
+    herr_t status;
     PyObject *py_comm = NULL;
-    PyObject *py_mask = NULL;
     MPI_Comm *comm_ptr  = NULL;
-    unsigned long io_size = 0;
-    char *file_name, *pop_name;
-    PyObject *py_node_allocation=NULL;
+    PyObject *py_queries = NULL;
+    PyObject *py_coord_names = NULL;
+    const string default_namespace = "Coordinates";
+    char *file_name, *pop_name, *attr_namespace = (char *)default_namespace.c_str();
+    double radius = -1.0;
+    unsigned long k = 0, num_threads = 0;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "population_name",
+                                   "queries",
+                                   "namespace",
+                                   "radius",
+                                   "k",
+                                   "coord_names",
+                                   "comm",
+                                   "num_threads",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssO|sdkOOk", (char **)kwlist,
+                                     &file_name, &pop_name, &py_queries, &attr_namespace,
+                                     &radius, &k, &py_coord_names, &py_comm, &num_threads))
+      return NULL;
+
+    if ((radius >= 0.0) == (k > 0))
+      {
+        PyErr_SetString(PyExc_ValueError, "query_cell_neighbors: exactly one of radius and k must be given");
+        return NULL;
+      }
+
+    vector<COORD_T> queries;
+    {
+      PyArrayObject *py_query_array =
+        (PyArrayObject *)PyArray_FROM_OTF(py_queries, NPY_FLOAT, NPY_ARRAY_IN_ARRAY | NPY_ARRAY_FORCECAST);
+      if (py_query_array == NULL)
+        {
+          return NULL;
+        }
+      const size_t num_queries = PyArray_SIZE(py_query_array) / 3;
+      if (!(((PyArray_NDIM(py_query_array) == 2) && (PyArray_DIM(py_query_array, 1) == 3)) ||
+            (PyArray_SIZE(py_query_array) == 0)))
+        {
+          Py_DECREF(py_query_array);
+          PyErr_SetString(PyExc_ValueError, "query_cell_neighbors: queries must be an array of shape (n, 3)");
+          return NULL;
+        }
+      const COORD_T *query_ptr = (const COORD_T *)PyArray_DATA(py_query_array);
+      queries.assign(query_ptr, query_ptr + 3*num_queries);
+      Py_DECREF(py_query_array);
+    }
+
+    vector<string> coord_names = { hdf5::X_COORD, hdf5::Y_COORD, hdf5::Z_COORD };
+    if ((py_coord_names != NULL) && (py_coord_names != Py_None))
+      {
+        coord_names.clear();
+        PyObject *py_iter = PyObject_GetIter(py_coord_names);
+        throw_assert(py_iter != NULL,
+                     "py_query_cell_neighbors: argument coord_names must be a list of strings");
+        PyObject *pyval;
+        while((pyval = PyIter_Next(py_iter)))
+          {
+            coord_names.push_back(string(PyStr_ToCString(pyval)));
+            Py_DECREF(pyval);
+          }
+        Py_DECREF(py_iter);
+        throw_assert(coord_names.size() == 3,
+                     "py_query_cell_neighbors: argument coord_names must contain three names");
+      }
+
+    MPI_Comm comm;
+
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_query_cell_neighbors: unable to obtain MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_query_cell_neighbors: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_query_cell_neighbors: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_query_cell_neighbors: unable to duplicate MPI communicator");
+      }
+
+    pop_label_map_t pop_labels;
+    status = cell::read_population_labels(comm, string(file_name), pop_labels);
+    throw_assert (status >= 0,
+                  "py_query_cell_neighbors: unable to read population labels");
+
+    // Determine index of population to be read
+    pop_t pop_idx=0; bool pop_idx_set=false;
+    for (auto& x: pop_labels)
+      {
+        if (get<1>(x) == pop_name)
+          {
+            pop_idx = get<0>(x);
+            pop_idx_set = true;
+          }
+      }
+    if (!pop_idx_set)
+      {
+        throw_err(std::string("py_query_cell_neighbors: ") + "Population " + pop_name + " not found");
+      }
+
+    size_t n_nodes;
+    pop_range_map_t pop_ranges;
+    throw_assert(cell::read_population_ranges(comm, string(file_name), pop_ranges, n_nodes) >= 0,
+                 "py_query_cell_neighbors: unable to read population ranges");
+    CELL_IDX_T pop_start = 0;
+    {
+      auto it = pop_ranges.find(pop_idx);
+      throw_assert(it != pop_ranges.end(),
+                   "py_query_cell_neighbors: invalid population index");
+      pop_start = it->second.start;
+    }
+
+    cell::neighbor_csr_t neighbors;
+    {
+      cell::spatial_index_t index;
+      cell::build_spatial_index(comm, string(file_name), string(attr_namespace), string(pop_name),
+                                pop_start, index, coord_names);
+
+      data::thread_pool pool((num_threads > 0) ? num_threads : data::default_num_threads());
+      if (k > 0)
+        {
+          cell::spatial_knn_query(comm, index, queries, k, pool, neighbors);
+        }
+      else
+        {
+          cell::spatial_radius_query(comm, index, queries, radius, pool, neighbors);
+        }
+    }
+
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_query_cell_neighbors: unable to free MPI communicator");
+
+    PyObject *py_result_tuple = PyTuple_New(3);
+    PyTuple_SetItem(py_result_tuple, 0, py_array_from_vector(neighbors.ptr, NPY_UINT64));
+    PyTuple_SetItem(py_result_tuple, 1, py_array_from_vector(neighbors.index, NPY_UINT32));
+    PyTuple_SetItem(py_result_tuple, 2, py_array_from_vector(neighbors.distance, NPY_FLOAT));
+
+    return py_result_tuple;
+  }
+
+
+  PyDoc_STRVAR(
+    partition_cells_doc,
+    "partition_cells(file_name, population_name, namespace='Coordinates', curve='hilbert', projection_sources=None, coord_names=None, comm=None, output_namespace=None, io_size=0)\n"
+    "--\n"
+    "\n"
+    "Assigns the cells of a population to the ranks of the communicator by cutting a space-filling curve through the cell coordinates into pieces of nearly equal weight, "
+    "so that each rank receives a spatially compact group of cells. "
+    "The result can be passed as node_allocation to the scatter_read functions. \n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of NeuroH5 file that contains the cell coordinates.\n"
+    "\n"
+    "population_name : string\n"
+    "    Name of population of the cells to be partitioned.\n"
+    "\n"
+    "namespace : string\n"
+    "    Name of the cell attribute namespace that contains the cell coordinates.\n"
+    "\n"
+    "curve : string\n"
+    "    Space-filling curve along which cells are ordered: 'hilbert' or 'morton'.\n"
+    "\n"
+    "projection_sources : list of strings\n"
+    "    Optional source populations of projections to the given population. If given, each cell is weighted by one plus its in-degree in these projections; otherwise all cells have equal weight.\n"
+    "\n"
+    "coord_names : list of strings\n"
+    "    Names of the x, y and z coordinate attributes. The default is ['X Coordinate', 'Y Coordinate', 'Z Coordinate'].\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "output_namespace : string\n"
+    "    If given, the rank of each cell is written to attribute 'Rank' of this cell attribute namespace, for reuse by later runs.\n"
+    "\n"
+    "io_size : int\n"
+    "    Number of I/O ranks used to write the ranks.\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "numpy array\n"
+    "    The gids of the cells assigned to this rank.\n"
+    "\n");
+
+  static PyObject *py_partition_cells (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    herr_t status;
+    PyObject *py_comm = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    PyObject *py_projection_sources = NULL;
+    PyObject *py_coord_names = NULL;
+    const string default_namespace = "Coordinates";
+    const string default_curve = "hilbert";
+    char *file_name, *pop_name, *attr_namespace = (char *)default_namespace.c_str(),
+      *curve_arg = (char *)default_curve.c_str(), *output_namespace = NULL;
+    unsigned long io_size = 0;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "population_name",
+                                   "namespace",
+                                   "curve",
+                                   "projection_sources",
+                                   "coord_names",
+                                   "comm",
+                                   "output_namespace",
+                                   "io_size",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|ssOOOzk", (char **)kwlist,
+                                     &file_name, &pop_name, &attr_namespace, &curve_arg,
+                                     &py_projection_sources, &py_coord_names, &py_comm,
+                                     &output_namespace, &io_size))
+      return NULL;
+
+    graph::SpaceFillingCurve curve;
+    if (string(curve_arg) == "hilbert")
+      {
+        curve = graph::CurveHilbert;
+      }
+    else if (string(curve_arg) == "morton")
+      {
+        curve = graph::CurveMorton;
+      }
+    else
+      {
+        PyErr_SetString(PyExc_ValueError, "partition_cells: curve must be 'hilbert' or 'morton'");
+        return NULL;
+      }
+
+    vector<string> src_pop_names;
+    if ((py_projection_sources != NULL) && (py_projection_sources != Py_None))
+      {
+        PyObject *py_iter = PyObject_GetIter(py_projection_sources);
+        throw_assert(py_iter != NULL,
+                     "py_partition_cells: argument projection_sources must be a list of strings");
+        PyObject *pyval;
+        while((pyval = PyIter_Next(py_iter)))
+          {
+            src_pop_names.push_back(string(PyStr_ToCString(pyval)));
+            Py_DECREF(pyval);
+          }
+        Py_DECREF(py_iter);
+      }
+
+    vector<string> coord_names = { hdf5::X_COORD, hdf5::Y_COORD, hdf5::Z_COORD };
+    if ((py_coord_names != NULL) && (py_coord_names != Py_None))
+      {
+        coord_names.clear();
+        PyObject *py_iter = PyObject_GetIter(py_coord_names);
+        throw_assert(py_iter != NULL,
+                     "py_partition_cells: argument coord_names must be a list of strings");
+        PyObject *pyval;
+        while((pyval = PyIter_Next(py_iter)))
+          {
+            coord_names.push_back(string(PyStr_ToCString(pyval)));
+            Py_DECREF(pyval);
+          }
+        Py_DECREF(py_iter);
+        throw_assert(coord_names.size() == 3,
+                     "py_partition_cells: argument coord_names must contain three names");
+      }
+
+    MPI_Comm comm;
+
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_partition_cells: unable to obtain MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_partition_cells: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_partition_cells: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_partition_cells: unable to duplicate MPI communicator");
+      }
+
+    int rank, size;
+    throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                 "py_partition_cells: unable to obtain size of MPI communicator");
+    throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                 "py_partition_cells: unable to obtain rank of MPI communicator");
+
+    pop_label_map_t pop_labels;
+    status = cell::read_population_labels(comm, string(file_name), pop_labels);
+    throw_assert (status >= 0,
+                  "py_partition_cells: unable to read population labels");
+
+    // Determine index of population to be read
+    pop_t pop_idx=0; bool pop_idx_set=false;
+    for (auto& x: pop_labels)
+      {
+        if (get<1>(x) == pop_name)
+          {
+            pop_idx = get<0>(x);
+            pop_idx_set = true;
+          }
+      }
+    if (!pop_idx_set)
+      {
+        throw_err(std::string("py_partition_cells: ") + "Population " + pop_name + " not found");
+      }
+
+    size_t n_nodes;
+    pop_range_map_t pop_ranges;
+    throw_assert(cell::read_population_ranges(comm, string(file_name), pop_ranges, n_nodes) >= 0,
+                 "py_partition_cells: unable to read population ranges");
+    CELL_IDX_T pop_start = 0;
+    {
+      auto it = pop_ranges.find(pop_idx);
+      throw_assert(it != pop_ranges.end(),
+                   "py_partition_cells: invalid population index");
+      pop_start = it->second.start;
+    }
+
+    node_rank_map_t node_rank_map;
+    graph::partition_population_sfc(comm, string(file_name), string(attr_namespace), string(pop_name),
+                                    pop_start, src_pop_names, size, curve, node_rank_map,
+                                    coord_names);
+
+    if (output_namespace != NULL)
+      {
+        graph::append_node_rank_map(comm, string(file_name), string(output_namespace), string(pop_name),
+                                    pop_start, node_rank_map, (io_size > 0) ? io_size : size, true);
+      }
+
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_partition_cells: unable to free MPI communicator");
+
+    vector<CELL_IDX_T> node_allocation;
+    for (auto const& element : node_rank_map)
+      {
+        if (element.second.count(rank) > 0)
+          {
+            node_allocation.push_back(element.first);
+          }
+      }
+
+    return py_array_from_vector(node_allocation, NPY_UINT32);
+  }
+
+
+  PyDoc_STRVAR(
+    partition_graph_doc,
+    "partition_graph(file_name, projections=None, nparts=0, iterations=10, imbalance=0.05, initial_namespace=None, comm=None, output_namespace=None, io_size=0)\n"
+    "--\n"
+    "\n"
+    "Partitions the cells of the populations connected by the given projections so as to reduce the number of edges between partitions, "
+    "while balancing both the number of cells and the total in-degree of each partition. "
+    "Cells move between partitions by size-constrained label propagation, which does not require ParMETIS. "
+    "The result can be passed as node_allocation to the scatter_read functions. \n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of NeuroH5 file that contains the projections.\n"
+    "\n"
+    "projections : list of (source, destination) tuples\n"
+    "    Projections whose edges are partitioned. If None, all projections in the file are used.\n"
+    "\n"
+    "nparts : int\n"
+    "    Number of partitions. If 0, the size of the communicator is used.\n"
+    "\n"
+    "iterations : int\n"
+    "    Maximum number of label propagation rounds.\n"
+    "\n"
+    "imbalance : float\n"
+    "    Allowed relative excess of the cell count and in-degree of a partition over the average.\n"
+    "\n"
+    "initial_namespace : string\n"
+    "    If given, the initial partition of each cell is read from attribute 'Rank' of this cell attribute namespace, for example as written by partition_cells; "
+    "otherwise the cells are initially cut into contiguous ranges.\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "output_namespace : string\n"
+    "    If given, the partition of each cell is written to attribute 'Rank' of this cell attribute namespace, for reuse by later runs.\n"
+    "\n"
+    "io_size : int\n"
+    "    Number of I/O ranks used to read the projections and write the partitions.\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "(numpy array, int)\n"
+    "    The gids of the cells in the partition with the index of this rank, and the number of edges between partitions.\n"
+    "\n");
+
+  static PyObject *py_partition_graph (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    herr_t status;
+    PyObject *py_comm = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    PyObject *py_prj_names = NULL;
+    char *file_name, *initial_namespace = NULL, *output_namespace = NULL;
+    unsigned long nparts = 0, iterations = 10, io_size = 0;
+    double imbalance = 0.05;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "projections",
+                                   "nparts",
+                                   "iterations",
+                                   "imbalance",
+                                   "initial_namespace",
+                                   "comm",
+                                   "output_namespace",
+                                   "io_size",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|OkkdzOzk", (char **)kwlist,
+                                     &file_name, &py_prj_names, &nparts, &iterations, &imbalance,
+                                     &initial_namespace, &py_comm, &output_namespace, &io_size))
+      return NULL;
+
+    MPI_Comm comm;
+
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_partition_graph: unable to obtain MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_partition_graph: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_partition_graph: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_partition_graph: unable to duplicate MPI communicator");
+      }
+
+    int rank, size;
+    throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                 "py_partition_graph: unable to obtain size of MPI communicator");
+    throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                 "py_partition_graph: unable to obtain rank of MPI communicator");
+
+    if (nparts == 0)
+      {
+        nparts = size;
+      }
+    if (io_size == 0)
+      {
+        io_size = size;
+      }
+
+    vector< pair<string,string> > prj_names;
+    if ((py_prj_names != NULL) && (py_prj_names != Py_None))
+      {
+        for (size_t i = 0; (Py_ssize_t)i < PyList_Size(py_prj_names); i++)
+          {
+            PyObject *pyval = PyList_GetItem(py_prj_names, (Py_ssize_t)i);
+            PyObject *p1    = PyTuple_GetItem(pyval, 0);
+            PyObject *p2    = PyTuple_GetItem(pyval, 1);
+            const char *s1        = PyStr_ToCString (p1);
+            const char *s2        = PyStr_ToCString (p2);
+            prj_names.push_back(make_pair(string(s1), string(s2)));
+          }
+      }
+    else
+      {
+        status = graph::read_projection_names(comm, string(file_name), prj_names);
+        throw_assert(status >= 0,
+                     "py_partition_graph: unable to read projection names");
+      }
+
+    pop_label_map_t pop_labels;
+    status = cell::read_population_labels(comm, string(file_name), pop_labels);
+    throw_assert (status >= 0,
+                  "py_partition_graph: unable to read population labels");
+
+    size_t n_nodes;
+    pop_range_map_t pop_ranges;
+    throw_assert(cell::read_population_ranges(comm, string(file_name), pop_ranges, n_nodes) >= 0,
+                 "py_partition_graph: unable to read population ranges");
+
+    set<string> pop_names;
+    for (auto const& prj : prj_names)
+      {
+        pop_names.insert(prj.first);
+        pop_names.insert(prj.second);
+      }
+
+    node_rank_map_t node_rank_map;
+    if (initial_namespace != NULL)
+      {
+        for (auto const& x : pop_labels)
+          {
+            if (pop_names.find(x.second) != pop_names.end())
+              {
+                graph::read_node_rank_map(comm, string(file_name), string(initial_namespace), x.second,
+                                          pop_ranges[x.first].start, node_rank_map);
+              }
+          }
+      }
+
+    size_t edge_cut = 0;
+    graph::partition_graph_lp(comm, string(file_name), prj_names, io_size, nparts, iterations,
+                              imbalance, node_rank_map, edge_cut);
+
+    if (output_namespace != NULL)
+      {
+        for (auto const& x : pop_labels)
+          {
+            if (pop_names.find(x.second) == pop_names.end())
+              continue;
+            const pop_range_t& range = pop_ranges[x.first];
+            node_rank_map_t pop_rank_map(node_rank_map.lower_bound(range.start),
+                                         node_rank_map.lower_bound(range.start + range.count));
+            graph::append_node_rank_map(comm, string(file_name), string(output_namespace), x.second,
+                                        range.start, pop_rank_map, io_size);
+          }
+      }
+
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_partition_graph: unable to free MPI communicator");
+
+    vector<CELL_IDX_T> node_allocation;
+    for (auto const& element : node_rank_map)
+      {
+        if (element.second.count(rank) > 0)
+          {
+            node_allocation.push_back(element.first);
+          }
+      }
+
+    PyObject *py_node_allocation = py_array_from_vector(node_allocation, NPY_UINT32);
+    return Py_BuildValue("(Nk)", py_node_allocation, (unsigned long)edge_cut);
+  }
+
+
+  PyDoc_STRVAR(
+    scatter_read_cell_attributes_doc,
+    "scatter_read_cell_attributes(file_name, population_name, namespaces, node_allocation=None, comm=None, io_size=0, predicate=None)\n"
+    "--\n"
+    "\n"
+    "Reads cell attributes for all cell gids contained in the given file and namespaces, using scalable parallel read/scatter."
+    "Each rank will be assigned an equal number of cell gids, with the exception of the last rank if the number of cells is not evenly divisible by the number of ranks. \n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    The NeuroH5 file to read.\n"
+    "    \n"
+    "    .. warning::\n"
+    "       The given file must be a valid HDF5 file that contains /H5Types and /Populations groups.\n"
+    "\n"
+    "population_name : string\n"
+    "    Name of population from which to read.\n"
+    "\n"
+    "namespaces : string list\n"
+    "    The namespaces for which cell attributes will be read.\n"
+    "\n"
+    "comm : MPI communicator\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "io_size : \n"
+    "    Optional number of ranks performing I/O operations. If 0, this number will be equal to the size of the MPI communicator.\n"
+    "\n"
+    "node_allocation : \n"
+    "    Optional iterable that with gids assigned to rank. If None, round-robin assignment will be used.\n"
+    "\n"
+    "mask : set of string\n"
+    "    Optional set of attributes to be read. If not set, all attributes in the namespace will be read.\n"
+    "\n"
+    "predicate : list of (string, string, number) tuples\n"
+    "    Optional conditions (attribute, comparison, value) that must all hold, where comparison is one of '==', '!=', '<', '<=', '>', '>='. "
+    "The conditions are evaluated on the I/O ranks over the values of each cell, so that cells without matching values are not sent, "
+    "and attributes with as many values as the condition attributes only keep the matching values, e.g. [('syn_type', '==', 0)].\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "Dictionary of the form { namespace: cell_iter }, where: \n"
+    "cell_iter : iterator\n"
+    "   An iterator that returns pairs (gid, attr_dict) where gid is the cell id and attr_dict is a dictionary with attribute key-value pairs. \n"
+    "\n");
+
+  static PyObject *py_scatter_read_cell_attributes (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *py_comm = NULL;
+    PyObject *py_mask = NULL;
+    PyObject *py_predicate = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    unsigned long io_size = 0;
+    char *file_name, *pop_name;
+    PyObject *py_node_allocation=NULL;
     PyObject *py_attr_name_spaces=NULL;
     node_rank_map_t node_rank_map;
     vector <string> attr_name_spaces;
@@ -5572,14 +6834,18 @@ extern "C"
                                    "namespaces",
                                    "io_size",
                                    "return_type",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOOks", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|OOOOksO", (char **)kwlist,
                                      &file_name, &pop_name, &py_comm, &py_mask, 
                                      &py_node_allocation, &py_attr_name_spaces,
-                                     &io_size, &return_type_arg))
+                                     &io_size, &return_type_arg, &py_predicate))
       return NULL;
 
+    data::AttrPredicate predicate;
+    py_attr_predicate(py_predicate, predicate);
+
     if (return_type_arg != NULL)
       {
         string return_type_str = string(return_type_arg);
@@ -5717,7 +6983,9 @@ extern "C"
                                                      node_rank_map,
                                                      string(pop_name),
                                                      pop_start,
-                                                     attr_map);
+                                                     attr_map,
+                                                     0, 0,
+                                                     predicate);
         throw_assert (status >= 0,
                       "py_scatter_read_cell_attributes: unable to read cell attributes");
                       
@@ -6149,7 +7417,7 @@ extern "C"
   
   PyDoc_STRVAR(
     scatter_read_cell_attribute_selection_doc,
-    "scatter_read_cell_attribute_selection(file_name, population_name, selection, namespace, io_size=0, comm=None)\n"
+    "scatter_read_cell_attribute_selection(file_name, population_name, selection, namespace, io_size=0, comm=None, predicate=None)\n"
     "--\n"
     "\n"
     "Reads cell attributes for the given cell gids from the given file and namespace, using the specified io_size number of ranks for I/O operations and scattering the data to the respective ranks according to the selection. \n"
@@ -6177,6 +7445,9 @@ extern "C"
     "comm : MPI communicator\n"
     "    Optional MPI communicator. If None, the world communicator will be used.\n"
     "\n"
+    "predicate : list of (string, string, number) tuples\n"
+    "    Optional conditions (attribute, comparison, value) that the I/O ranks apply before sending the selected cells, as in scatter_read_cell_attributes.\n"
+    "\n"
     "Returns\n"
     "-------\n"
     "cell_iter : iterator\n"
@@ -6188,6 +7459,7 @@ extern "C"
     herr_t status;
     PyObject *py_comm = NULL;
     PyObject *py_mask = NULL;
+    PyObject *py_predicate = NULL;
     MPI_Comm *comm_ptr  = NULL;
     const string default_namespace = "Attributes";
     char *file_name, *pop_name, *attr_namespace = (char *)default_namespace.c_str();
@@ -6206,14 +7478,18 @@ extern "C"
                                    "mask",
                                    "io_size",
                                    "return_type",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssOs|OOks", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ssOs|OOksO", (char **)kwlist,
                                      &file_name, &pop_name, &py_selection,
                                      &attr_namespace, &py_comm, &py_mask,
-                                     &io_size, &return_type_arg))
+                                     &io_size, &return_type_arg, &py_predicate))
       return NULL;
 
+    data::AttrPredicate predicate;
+    py_attr_predicate(py_predicate, predicate);
+
     if (return_type_arg != NULL)
       {
         string return_type_str = string(return_type_arg);
@@ -6337,7 +7613,7 @@ extern "C"
     cell::scatter_read_cell_attribute_selection (comm, string(file_name), io_size,
                                                  string(attr_namespace), attr_mask,
                                                  string(pop_name), pop_start,
-                                                 selection, attr_values);
+                                                 selection, attr_values, predicate);
     vector<vector<string>> attr_names;
     attr_values.attr_names(attr_names);
     throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
@@ -6888,61 +8164,355 @@ extern "C"
           pop_count = it->second.count;
         }
 
-    
-    
-        int npy_type=0;
-    
-        vector<string> attr_names;
-        vector<int> attr_types;
-        
-        map<string, map<CELL_IDX_T, deque<uint32_t> >> all_attr_values_uint32;
-        map<string, map<CELL_IDX_T, deque<int32_t> >> all_attr_values_int32;
-        map<string, map<CELL_IDX_T, deque<uint16_t> >> all_attr_values_uint16;
-        map<string, map<CELL_IDX_T, deque<int16_t> >> all_attr_values_int16;
-        map<string, map<CELL_IDX_T, deque<uint8_t> >>  all_attr_values_uint8;
-        map<string, map<CELL_IDX_T, deque<int8_t> >>  all_attr_values_int8;
-        map<string, map<CELL_IDX_T, deque<float> >>  all_attr_values_float;
+    
+    
+        int npy_type=0;
+    
+        vector<string> attr_names;
+        vector<int> attr_types;
+        
+        map<string, map<CELL_IDX_T, deque<uint32_t> >> all_attr_values_uint32;
+        map<string, map<CELL_IDX_T, deque<int32_t> >> all_attr_values_int32;
+        map<string, map<CELL_IDX_T, deque<uint16_t> >> all_attr_values_uint16;
+        map<string, map<CELL_IDX_T, deque<int16_t> >> all_attr_values_int16;
+        map<string, map<CELL_IDX_T, deque<uint8_t> >>  all_attr_values_uint8;
+        map<string, map<CELL_IDX_T, deque<int8_t> >>  all_attr_values_int8;
+        map<string, map<CELL_IDX_T, deque<float> >>  all_attr_values_float;
+
+        const data::optional_hid dflt_data_type;
+
+        build_cell_attr_value_maps(idx_values,
+                                   all_attr_values_uint32,
+                                   all_attr_values_uint16,
+                                   all_attr_values_uint8,
+                                   all_attr_values_int32,
+                                   all_attr_values_int16,
+                                   all_attr_values_int8,
+                                   all_attr_values_float);
+
+        cell::append_cell_attribute_maps (data_comm, file_name,
+                                          attr_namespace, pop_name, pop_start,
+                                          all_attr_values_uint32,
+                                          all_attr_values_int32,
+                                          all_attr_values_uint16,
+                                          all_attr_values_int16,
+                                          all_attr_values_uint8,
+                                          all_attr_values_int8,
+                                          all_attr_values_float,
+                                          io_size, dflt_data_type,
+                                          IndexOwner, CellPtr(PtrOwner),
+                                          chunk_size, value_chunk_size, cache_size);
+      }
+    
+    throw_assert(MPI_Barrier(data_comm) == MPI_SUCCESS,
+                 "py_append_cell_attributes: error in MPI barrier on data communicator");
+    throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                 "py_append_cell_attributes: error in MPI barrier");
+
+    throw_assert(MPI_Comm_free(&data_comm) == MPI_SUCCESS,
+                 "py_append_cell_attributes: unable to free data MPI communicator");
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_append_cell_attributes: unable to free MPI communicator");
+    
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+
+  PyDoc_STRVAR(
+    compact_cell_attributes_doc,
+    "compact_cell_attributes(file_name, pop_name, namespace='Attributes', comm=None, chunk_bytes=1048576, cache_size=1048576)\n"
+    "--\n"
+    "\n"
+    "Rewrites the attributes of a cell attribute namespace sorted by cell id.\n"
+    "\n"
+    "Of cells that were written more than once, e.g. by repeated calls to\n"
+    "append_cell_attributes, the values written last are kept. The datasets are\n"
+    "rewritten with chunk sizes chosen from the number and size of the values, and\n"
+    "the namespace is marked as sorted, which speeds up reading selections of\n"
+    "cells. The mark is removed by later appends to the namespace. All ranks in\n"
+    "the communicator must call this function.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of the NeuroH5 file.\n"
+    "\n"
+    "pop_name : string\n"
+    "    Name of the population.\n"
+    "\n"
+    "namespace : string\n"
+    "    Optional name of the attribute namespace.\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "chunk_bytes : int\n"
+    "    Optional target size in bytes of the HDF5 chunks of the rewritten datasets.\n"
+    "\n"
+    "cache_size : int\n"
+    "    Optional HDF5 chunk cache size.\n"
+    "\n");
+
+  static PyObject *py_compact_cell_attributes (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    const string default_namespace = "Attributes";
+    PyObject *py_comm = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    unsigned long chunk_bytes = cell::COMPACT_CHUNK_BYTES;
+    unsigned long cache_size = 1*1024*1024;
+    char *file_name_arg, *pop_name_arg, *namespace_arg = (char *)default_namespace.c_str();
+    herr_t status;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "pop_name",
+                                   "namespace",
+                                   "comm",
+                                   "chunk_bytes",
+                                   "cache_size",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "ss|sOkk", (char **)kwlist,
+                                     &file_name_arg, &pop_name_arg,
+                                     &namespace_arg, &py_comm,
+                                     &chunk_bytes, &cache_size))
+      return NULL;
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_compact_cell_attributes: pointer to MPI communicator is null");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_compact_cell_attributes: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_compact_cell_attributes: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_compact_cell_attributes: unable to duplicate MPI communicator");
+      }
+
+    cell::compact_cell_attributes(comm, string(file_name_arg), string(namespace_arg),
+                                  string(pop_name_arg), chunk_bytes, cache_size);
+
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_compact_cell_attributes: unable to free MPI communicator");
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  static void get_part_file_names (PyObject *py_part_file_names, vector<string>& part_file_names)
+  {
+    throw_assert(PyList_Check(py_part_file_names) > 0,
+                 "get_part_file_names: part_file_names is not a list");
+    for (Py_ssize_t i = 0; i < PyList_Size(py_part_file_names); i++)
+      {
+        PyObject *py_part_file_name = PyList_GetItem(py_part_file_names, i);
+        const char *part_file_name = PyStr_ToCString(py_part_file_name);
+        throw_assert(part_file_name != NULL,
+                     "get_part_file_names: invalid part file name");
+        part_file_names.push_back(string(part_file_name));
+      }
+  }
+
+
+  PyDoc_STRVAR(
+    stitch_cell_attributes_doc,
+    "stitch_cell_attributes(file_name, part_file_names, pop_name, namespace='Attributes', copy_parts=False, comm=None)\n"
+    "--\n"
+    "\n"
+    "Creates a cell attribute namespace that combines the namespaces of part files.\n"
+    "\n"
+    "The part files are typically written by separate groups of ranks, each calling\n"
+    "append_cell_attributes with its own communicator and part file, so that no\n"
+    "file is shared between the groups. The cell indices and values of the\n"
+    "namespace in file_name are virtual datasets over the part files, which must\n"
+    "be kept with it unless copy_parts is True, and only the attribute pointers are\n"
+    "copied. An existing namespace of the same name is replaced; the new namespace\n"
+    "can be read but not appended to. All ranks in the communicator must call this\n"
+    "function.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of the NeuroH5 file, which must contain the population definitions.\n"
+    "\n"
+    "part_file_names : list\n"
+    "    Names of the part files, in order.\n"
+    "\n"
+    "pop_name : string\n"
+    "    Name of the population.\n"
+    "\n"
+    "namespace : string\n"
+    "    Optional name of the attribute namespace.\n"
+    "\n"
+    "copy_parts : bool\n"
+    "    Optional flag that specifies whether to copy the part datasets into file_name\n"
+    "    as stored, without decompressing them.\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n");
+
+  static PyObject *py_stitch_cell_attributes (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    const string default_namespace = "Attributes";
+    PyObject *py_comm = NULL, *py_part_file_names = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    char *file_name_arg, *pop_name_arg, *namespace_arg = (char *)default_namespace.c_str();
+    int copy_parts_flag = 0;
+    herr_t status;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "part_file_names",
+                                   "pop_name",
+                                   "namespace",
+                                   "copy_parts",
+                                   "comm",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sOs|siO", (char **)kwlist,
+                                     &file_name_arg, &py_part_file_names, &pop_name_arg,
+                                     &namespace_arg, &copy_parts_flag, &py_comm))
+      return NULL;
+
+    vector<string> part_file_names;
+    get_part_file_names(py_part_file_names, part_file_names);
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_stitch_cell_attributes: pointer to MPI communicator is null");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_stitch_cell_attributes: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stitch_cell_attributes: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stitch_cell_attributes: unable to duplicate MPI communicator");
+      }
+
+    cell::stitch_cell_attributes(comm, string(file_name_arg), part_file_names,
+                                 string(namespace_arg), string(pop_name_arg),
+                                 copy_parts_flag > 0);
+
+    throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
+                 "py_stitch_cell_attributes: unable to free MPI communicator");
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+
+  PyDoc_STRVAR(
+    stitch_graph_doc,
+    "stitch_graph(file_name, part_file_names, src_pop_name, dst_pop_name, copy_parts=False, comm=None)\n"
+    "--\n"
+    "\n"
+    "Creates a projection that combines the edges of the projection in part files.\n"
+    "\n"
+    "The part files are typically written by separate groups of ranks, each calling\n"
+    "append_graph with its own communicator and part file. The source indices and\n"
+    "edge attributes of the projection in file_name are virtual datasets over the\n"
+    "part files, which must be kept with it unless copy_parts is True, and only the\n"
+    "destination pointers are copied. Parts without the projection are skipped; the others must have the\n"
+    "same edge attributes. An existing projection of the same populations is\n"
+    "replaced; the new projection can be read but not appended to. All ranks in\n"
+    "the communicator must call this function.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Name of the NeuroH5 file, which must contain the population and projection\n"
+    "    definitions.\n"
+    "\n"
+    "part_file_names : list\n"
+    "    Names of the part files, in order.\n"
+    "\n"
+    "src_pop_name : string\n"
+    "    Name of the source population.\n"
+    "\n"
+    "dst_pop_name : string\n"
+    "    Name of the destination population.\n"
+    "\n"
+    "copy_parts : bool\n"
+    "    Optional flag that specifies whether to copy the part datasets into file_name\n"
+    "    as stored, without decompressing them.\n"
+    "\n"
+    "comm : MPIComm\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n");
+
+  static PyObject *py_stitch_graph (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    PyObject *py_comm = NULL, *py_part_file_names = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    char *file_name_arg, *src_pop_name_arg, *dst_pop_name_arg;
+    int copy_parts_flag = 0;
+    herr_t status;
 
-        const data::optional_hid dflt_data_type;
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "part_file_names",
+                                   "src_pop_name",
+                                   "dst_pop_name",
+                                   "copy_parts",
+                                   "comm",
+                                   NULL};
 
-        build_cell_attr_value_maps(idx_values,
-                                   all_attr_values_uint32,
-                                   all_attr_values_uint16,
-                                   all_attr_values_uint8,
-                                   all_attr_values_int32,
-                                   all_attr_values_int16,
-                                   all_attr_values_int8,
-                                   all_attr_values_float);
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "sOss|iO", (char **)kwlist,
+                                     &file_name_arg, &py_part_file_names,
+                                     &src_pop_name_arg, &dst_pop_name_arg,
+                                     &copy_parts_flag, &py_comm))
+      return NULL;
 
-        cell::append_cell_attribute_maps (data_comm, file_name,
-                                          attr_namespace, pop_name, pop_start,
-                                          all_attr_values_uint32,
-                                          all_attr_values_int32,
-                                          all_attr_values_uint16,
-                                          all_attr_values_int16,
-                                          all_attr_values_uint8,
-                                          all_attr_values_int8,
-                                          all_attr_values_float,
-                                          io_size, dflt_data_type,
-                                          IndexOwner, CellPtr(PtrOwner),
-                                          chunk_size, value_chunk_size, cache_size);
+    vector<string> part_file_names;
+    get_part_file_names(py_part_file_names, part_file_names);
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_stitch_graph: pointer to MPI communicator is null");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_stitch_graph: MPI communicator is null");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stitch_graph: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stitch_graph: unable to duplicate MPI communicator");
       }
-    
-    throw_assert(MPI_Barrier(data_comm) == MPI_SUCCESS,
-                 "py_append_cell_attributes: error in MPI barrier on data communicator");
-    throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
-                 "py_append_cell_attributes: error in MPI barrier");
 
-    throw_assert(MPI_Comm_free(&data_comm) == MPI_SUCCESS,
-                 "py_append_cell_attributes: unable to free data MPI communicator");
+    graph::stitch_projection(comm, string(file_name_arg), part_file_names,
+                             string(src_pop_name_arg), string(dst_pop_name_arg),
+                             copy_parts_flag > 0);
+
     throw_assert(MPI_Comm_free(&comm) == MPI_SUCCESS,
-                 "py_append_cell_attributes: unable to free MPI communicator");
-    
+                 "py_stitch_graph: unable to free MPI communicator");
+
     Py_INCREF(Py_None);
     return Py_None;
   }
 
-
   static PyObject *py_append_cell_trees (PyObject *self, PyObject *args, PyObject *kwds)
   {
     PyObject *idx_values;
@@ -7204,6 +8774,7 @@ extern "C"
    * seq_index: index of the next edge in the sequence to yield
    * start_index: starting index of the next batch of edges to read from file
    * cache_size: how many edge blocks to read from file at at time
+   * edge_filter: edge attributes to read and predicates on edges
    *
    */
   typedef struct {
@@ -7223,6 +8794,7 @@ extern "C"
     edge_map_iter_t edge_map_iter;
     map <string, vector< vector<string> > > edge_attr_names;
     vector<string> edge_attr_name_spaces;
+    graph::EdgeAttrFilter edge_filter;
     string src_pop_name, dst_pop_name;
     size_t total_num_nodes, local_num_nodes, total_num_edges, local_num_edges;
     hsize_t total_read_blocks;
@@ -7244,6 +8816,7 @@ extern "C"
    * seq_index: index of the next tree in the sequence to yield
    * start_index: starting index of the next batch of trees to read from file
    * cache_size: how many trees to read from file at at time
+   * tree_mask: Trees attributes to read (all if empty)
    *
    */
   typedef struct {
@@ -7257,12 +8830,15 @@ extern "C"
     string file_name;
     MPI_Comm comm;
     pop_range_map_t pop_ranges;
-    map<CELL_IDX_T, neurotree_t> tree_map;
+    shared_ptr<data::TreeBatch> tree_batch;
+    PyObject *py_tree_batch;
+    vector<size_t> tree_order;
+    size_t tree_pos;
     vector<string> attr_name_spaces;
     map <string, NamedAttrMap> attr_maps;
     map <string, vector< vector <string> > > attr_names;
-    map<CELL_IDX_T, neurotree_t>::const_iterator it_tree;
     node_rank_map_t node_rank_map;
+    set<string> tree_mask;
     bool topology_flag;
     bool validate_flag;
     
@@ -7284,6 +8860,7 @@ extern "C"
    * seq_index: index of the next id in the sequence to yield
    * start_index: starting index of the next batch of trees to read from file
    * cache_size: how many trees to read from file at at time
+   * tree_mask: Trees attributes to read (all if empty)
    *
    */
   typedef struct {
@@ -7328,6 +8905,7 @@ extern "C"
     unsigned int io_size=0, cache_size=1;
     char *file_name, *src_pop_name, *dst_pop_name;
     PyObject* py_attr_name_spaces = NULL;
+    PyObject *py_mask = NULL, *py_predicate = NULL;
     pop_range_map_t pop_ranges;
     set< pair<pop_t, pop_t> > pop_pairs;
     pop_label_map_t pop_labels;
@@ -7343,14 +8921,20 @@ extern "C"
                                    "comm",
                                    "io_size",
                                    "cache_size",
+                                   "mask",
+                                   "predicate",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sss|OiOii", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "sss|OiOiiOO", (char **)kwlist,
                                      &file_name, &src_pop_name, &dst_pop_name, 
                                      &py_attr_name_spaces, &opt_edge_map_type,
-                                     &py_comm, &io_size, &cache_size))
+                                     &py_comm, &io_size, &cache_size,
+                                     &py_mask, &py_predicate))
       return NULL;
 
+    graph::EdgeAttrFilter edge_filter;
+    py_edge_attr_filter(py_mask, py_predicate, edge_filter);
+
     MPI_Comm comm;
 
     if ((py_comm != NULL) && (py_comm != Py_None))
@@ -7450,6 +9034,7 @@ extern "C"
     py_ngg->state->edge_map_iter   = py_ngg->state->edge_map.cbegin();
     py_ngg->state->edge_map_type   = edge_map_type;
     py_ngg->state->edge_attr_name_spaces = attr_name_spaces;
+    py_ngg->state->edge_filter     = edge_filter;
     py_ngg->state->total_num_nodes = total_num_nodes;
     py_ngg->state->local_num_nodes = 0;
     py_ngg->state->total_num_edges = 0;
@@ -7509,6 +9094,7 @@ extern "C"
     unsigned int io_size=0, cache_size=1;
     char *file_name, *pop_name;
     PyObject* py_attr_name_spaces = NULL;
+    PyObject* py_tree_fields = NULL;
     vector<string> attr_name_spaces;
 
     static const char *kwlist[] = {
@@ -7521,12 +9107,14 @@ extern "C"
                                    "node_allocation",
                                    "io_size",
                                    "cache_size",
+                                   "tree_fields",
                                    NULL};
 
-    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|OiiOOii", (char **)kwlist,
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "ss|OiiOOiiO", (char **)kwlist,
                                      &file_name, &pop_name, 
                                      &py_attr_name_spaces, &topology_flag, &validate_flag,
-                                     &py_comm, &py_node_allocation, &io_size, &cache_size))
+                                     &py_comm, &py_node_allocation, &io_size, &cache_size,
+                                     &py_tree_fields))
       return NULL;
 
     MPI_Comm comm;
@@ -7601,19 +9189,14 @@ extern "C"
     }
     
     vector<CELL_IDX_T> tree_index;
-    throw_assert(cell::read_cell_index(comm,
+    throw_assert(cell::read_tree_index(comm,
                                        string(file_name),
                                        string(pop_name),
-                                       hdf5::TREES,
+                                       pop_start,
                                        tree_index) >= 0,
                  "NeuroH5TreeGen: unable to read cell index");
-    std::sort(tree_index.begin(), tree_index.end());
     
     size_t count = tree_index.size();
-    for (size_t i=0; i<tree_index.size(); i++)
-      {
-        tree_index[i] += pop_start;
-      }
 
     /* Create a new generator state and initialize it */
     PyNeuroH5TreeGenState *py_ntrg = (PyNeuroH5TreeGenState *)type->tp_alloc(type, 0);
@@ -7651,10 +9234,11 @@ extern "C"
     py_ntrg->state->attr_name_spaces  = attr_name_spaces;
     py_ntrg->state->topology_flag  = topology_flag;
     py_ntrg->state->validate_flag  = validate_flag;
+    py_tree_field_names(py_tree_fields, py_ntrg->state->tree_mask);
 
-    map<CELL_IDX_T, neurotree_t> tree_map;
-    py_ntrg->state->tree_map = tree_map;
-    py_ntrg->state->it_tree  = py_ntrg->state->tree_map.cbegin();
+    py_ntrg->state->tree_batch    = make_shared<data::TreeBatch>();
+    py_ntrg->state->py_tree_batch = NULL;
+    py_ntrg->state->tree_pos      = 0;
 
     return (PyObject *)py_ntrg;
   }
@@ -7845,6 +9429,7 @@ extern "C"
         throw_assert(status == MPI_SUCCESS,
                      "NeuroH5TreeGen: unable to free MPI communicator");
       }
+    Py_XDECREF(py_ntrg->state->py_tree_batch);
     delete py_ntrg->state;
     Py_TYPE(py_ntrg)->tp_free(py_ntrg);
   }
@@ -7903,11 +9488,16 @@ extern "C"
           // If the end of the current cache block has been reached,
           // and the iterator has not exceed its locally assigned elements,
           // read the next block
-          if ((py_ntrg->state->it_tree == py_ntrg->state->tree_map.cend()) &&
+          if ((py_ntrg->state->tree_pos == py_ntrg->state->tree_order.size()) &&
               (py_ntrg->state->cache_index < py_ntrg->state->count))
             {
               int status;
-              py_ntrg->state->tree_map.clear();
+              // Arrays yielded from the previous block keep their
+              // batch alive through its capsule
+              Py_CLEAR(py_ntrg->state->py_tree_batch);
+              py_ntrg->state->tree_batch = make_shared<data::TreeBatch>();
+              py_ntrg->state->tree_order.clear();
+              py_ntrg->state->tree_pos = 0;
               py_ntrg->state->attr_maps.clear();
 
               throw_assert(MPI_Barrier(py_ntrg->state->comm) == MPI_SUCCESS, "NeuroH5TreeGen: MPI_Barrier error");
@@ -7919,10 +9509,11 @@ extern "C"
                                                  py_ntrg->state->node_rank_map,
                                                  py_ntrg->state->pop_name,
                                                  py_ntrg->state->pop_start,
-                                                 py_ntrg->state->tree_map,
+                                                 *(py_ntrg->state->tree_batch),
                                                  py_ntrg->state->attr_maps,
                                                  py_ntrg->state->cache_index,
-                                                 py_ntrg->state->cache_size);
+                                                 py_ntrg->state->cache_size,
+                                                 py_ntrg->state->tree_mask);
               throw_assert (status >= 0,
                             "NeuroH5TreeGen: error in call to cell::scatter_read_trees");
 
@@ -7932,10 +9523,18 @@ extern "C"
                 {
                   py_ntrg->state->cache_index += py_ntrg->state->comm_size * py_ntrg->state->cache_size;
                 }
-              py_ntrg->state->it_tree = py_ntrg->state->tree_map.cbegin();
+              py_ntrg->state->py_tree_batch = py_tree_batch_capsule(py_ntrg->state->tree_batch);
+
+              // trees are yielded in order of increasing index
+              const vector<CELL_IDX_T>& index = py_ntrg->state->tree_batch->index;
+              vector<size_t>& tree_order = py_ntrg->state->tree_order;
+              tree_order.resize(index.size());
+              std::iota(tree_order.begin(), tree_order.end(), 0);
+              std::stable_sort(tree_order.begin(), tree_order.end(),
+                               [&index] (size_t a, size_t b) { return index[a] < index[b]; });
             }
 
-          if (py_ntrg->state->it_tree == py_ntrg->state->tree_map.cend())
+          if (py_ntrg->state->tree_pos == py_ntrg->state->tree_order.size())
             {
               if (py_ntrg->state->seq_index == py_ntrg->state->max_local_count)
                 {
@@ -7960,9 +9559,11 @@ extern "C"
             }
           else
             {
-              CELL_IDX_T key = py_ntrg->state->it_tree->first;
-              const neurotree_t &tree = py_ntrg->state->it_tree->second;
-              PyObject *elem = py_build_tree_value(key, tree, py_ntrg->state->attr_maps,
+              const data::TreeBatch &tree_batch = *(py_ntrg->state->tree_batch);
+              const size_t i = py_ntrg->state->tree_order[py_ntrg->state->tree_pos];
+              CELL_IDX_T key = tree_batch.index[i];
+              PyObject *elem = py_build_tree_value(tree_batch, i, py_ntrg->state->py_tree_batch,
+                                                   py_ntrg->state->attr_maps,
                                                    py_ntrg->state->topology_flag,
                                                    py_ntrg->state->validate_flag);
               throw_assert(elem != NULL,
@@ -7973,7 +9574,7 @@ extern "C"
                * (elem will be NULL so we also return NULL).
                */
               result = Py_BuildValue("lN", key, elem);
-              py_ntrg->state->it_tree++;
+              py_ntrg->state->tree_pos++;
               py_ntrg->state->seq_index++;
             }
           break;
@@ -8239,7 +9840,8 @@ extern "C"
                                             py_ngg->state->total_num_edges,
                                             py_ngg->state->total_read_blocks,
                                             py_ngg->state->block_index,
-                                            py_ngg->state->cache_size);
+                                            py_ngg->state->cache_size,
+                                            py_ngg->state->edge_filter);
 
     throw_assert (status >= 0, "NeuroH5ProjectionGen: read_projection error");
     throw_assert(prj_vector.size() > 0, "NeuroH5ProjectionGen: empty projection");
@@ -8532,6 +10134,330 @@ extern "C"
     neuroh5_prj_gen_new,           /* tp_new */
   };
 
+  PyDoc_STRVAR(
+    stats_doc,
+    "stats(comm=None, reset=False)\n"
+    "--\n"
+    "\n"
+    "Returns the time spent and the data volume processed in each phase of the\n"
+    "collective readers and writers, aggregated over the ranks of the given\n"
+    "communicator. Collective on comm.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "comm : MPI communicator\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "reset : bool\n"
+    "    If True, the counters of all ranks are cleared after being read.\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "stats : dict\n"
+    "    A dictionary of phase name -> dict with keys 'ranks', 'calls', 'min',\n"
+    "    'mean', 'max' (per-rank total seconds), 'bytes' and 'items'.\n"
+    "\n");
+
+  static PyObject *py_stats (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *py_comm = NULL;
+    int reset = 0;
+    MPI_Comm *comm_ptr  = NULL;
+
+    static const char *kwlist[] = {
+                                   "comm",
+                                   "reset",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Oi", (char **)kwlist,
+                                     &py_comm, &reset))
+      return NULL;
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_stats: invalid MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_stats: invalid MPI communicator");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stats: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_stats: unable to duplicate MPI communicator");
+      }
+
+    map<string, mpi::phase_summary_t> summary = mpi::trace_summary(comm);
+    if (reset)
+      {
+        mpi::trace_reset();
+      }
+    status = MPI_Comm_free(&comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_stats: unable to free MPI communicator");
+
+    PyObject *py_stats_dict = PyDict_New();
+    for (auto const& it : summary)
+      {
+        const mpi::phase_summary_t& s = it.second;
+        PyObject *py_phase_dict = PyDict_New();
+        PyObject *py_value;
+
+        py_value = PyLong_FromUnsignedLongLong(s.ranks);
+        PyDict_SetItemString(py_phase_dict, "ranks", py_value);
+        Py_DECREF(py_value);
+        py_value = PyLong_FromUnsignedLongLong(s.calls);
+        PyDict_SetItemString(py_phase_dict, "calls", py_value);
+        Py_DECREF(py_value);
+        py_value = PyFloat_FromDouble(s.min_seconds);
+        PyDict_SetItemString(py_phase_dict, "min", py_value);
+        Py_DECREF(py_value);
+        py_value = PyFloat_FromDouble(s.mean_seconds);
+        PyDict_SetItemString(py_phase_dict, "mean", py_value);
+        Py_DECREF(py_value);
+        py_value = PyFloat_FromDouble(s.max_seconds);
+        PyDict_SetItemString(py_phase_dict, "max", py_value);
+        Py_DECREF(py_value);
+        py_value = PyLong_FromUnsignedLongLong(s.bytes);
+        PyDict_SetItemString(py_phase_dict, "bytes", py_value);
+        Py_DECREF(py_value);
+        py_value = PyLong_FromUnsignedLongLong(s.items);
+        PyDict_SetItemString(py_phase_dict, "items", py_value);
+        Py_DECREF(py_value);
+
+        PyDict_SetItemString(py_stats_dict, it.first.c_str(), py_phase_dict);
+        Py_DECREF(py_phase_dict);
+      }
+
+    return py_stats_dict;
+  }
+
+
+  PyDoc_STRVAR(
+    write_trace_doc,
+    "write_trace(file_name, comm=None)\n"
+    "--\n"
+    "\n"
+    "Writes the trace events recorded on all ranks to a JSON file in the\n"
+    "Chrome trace event format, which can be opened with Perfetto or\n"
+    "chrome://tracing. Events are only recorded while tracing is enabled,\n"
+    "see set_trace. Collective on comm.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "file_name : string\n"
+    "    Output file name; the file is written by rank 0.\n"
+    "\n"
+    "comm : MPI communicator\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n");
+
+  static PyObject *py_write_trace (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *py_comm = NULL;
+    MPI_Comm *comm_ptr  = NULL;
+    char *file_name;
+
+    static const char *kwlist[] = {
+                                   "file_name",
+                                   "comm",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s|O", (char **)kwlist,
+                                     &file_name, &py_comm))
+      return NULL;
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_write_trace: invalid MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_write_trace: invalid MPI communicator");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_write_trace: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_write_trace: unable to duplicate MPI communicator");
+      }
+
+    mpi::write_trace(comm, string(file_name));
+
+    status = MPI_Comm_free(&comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_write_trace: unable to free MPI communicator");
+
+    Py_RETURN_NONE;
+  }
+
+
+  PyDoc_STRVAR(
+    set_trace_doc,
+    "set_trace(enabled)\n"
+    "--\n"
+    "\n"
+    "Enables or disables the recording of trace events on this rank. Phase\n"
+    "totals returned by stats are always accumulated. Tracing is initially\n"
+    "enabled if the environment variable NEUROH5_TRACE is set to a non-zero\n"
+    "value.\n"
+    "\n");
+
+  static PyObject *py_set_trace (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int enabled = 0;
+
+    static const char *kwlist[] = {
+                                   "enabled",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i", (char **)kwlist, &enabled))
+      return NULL;
+
+    mpi::set_trace_enabled(enabled != 0);
+
+    Py_RETURN_NONE;
+  }
+
+
+  PyDoc_STRVAR(
+    memory_stats_doc,
+    "memory_stats(comm=None, reset=False)\n"
+    "--\n"
+    "\n"
+    "Returns the high-water marks of the bytes held by the data structures of\n"
+    "the collective readers (raw DBS arrays, partitioned edge, tree and\n"
+    "attribute maps, send and receive buffers, and result maps), aggregated\n"
+    "over the ranks of the given communicator. The category 'total' holds\n"
+    "the high-water mark of the sum of all categories. Collective on comm.\n"
+    "\n"
+    "Parameters\n"
+    "----------\n"
+    "comm : MPI communicator\n"
+    "    Optional MPI communicator. If None, the world communicator will be used.\n"
+    "\n"
+    "reset : bool\n"
+    "    If True, the high-water marks of all ranks are reset after being read.\n"
+    "\n"
+    "Returns\n"
+    "-------\n"
+    "stats : dict\n"
+    "    A dictionary of category name -> dict with keys 'ranks', 'min',\n"
+    "    'mean' and 'max' (per-rank high-water marks in bytes).\n"
+    "\n");
+
+  static PyObject *py_memory_stats (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    int status;
+    PyObject *py_comm = NULL;
+    int reset = 0;
+    MPI_Comm *comm_ptr  = NULL;
+
+    static const char *kwlist[] = {
+                                   "comm",
+                                   "reset",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "|Oi", (char **)kwlist,
+                                     &py_comm, &reset))
+      return NULL;
+
+    MPI_Comm comm;
+    if ((py_comm != NULL) && (py_comm != Py_None))
+      {
+        comm_ptr = PyMPIComm_Get(py_comm);
+        throw_assert(comm_ptr != NULL,
+                     "py_memory_stats: invalid MPI communicator");
+        throw_assert(*comm_ptr != MPI_COMM_NULL,
+                     "py_memory_stats: invalid MPI communicator");
+        status = MPI_Comm_dup(*comm_ptr, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_memory_stats: unable to duplicate MPI communicator");
+      }
+    else
+      {
+        status = MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+        throw_assert(status == MPI_SUCCESS,
+                     "py_memory_stats: unable to duplicate MPI communicator");
+      }
+
+    map<string, mpi::memory_summary_t> summary = mpi::memory_summary(comm);
+    if (reset)
+      {
+        mpi::memory_reset();
+      }
+    status = MPI_Comm_free(&comm);
+    throw_assert(status == MPI_SUCCESS,
+                 "py_memory_stats: unable to free MPI communicator");
+
+    PyObject *py_stats_dict = PyDict_New();
+    for (auto const& it : summary)
+      {
+        const mpi::memory_summary_t& s = it.second;
+        PyObject *py_category_dict = PyDict_New();
+        PyObject *py_value;
+
+        py_value = PyLong_FromUnsignedLongLong(s.ranks);
+        PyDict_SetItemString(py_category_dict, "ranks", py_value);
+        Py_DECREF(py_value);
+        py_value = PyLong_FromUnsignedLongLong(s.min_high_water);
+        PyDict_SetItemString(py_category_dict, "min", py_value);
+        Py_DECREF(py_value);
+        py_value = PyFloat_FromDouble(s.mean_high_water);
+        PyDict_SetItemString(py_category_dict, "mean", py_value);
+        Py_DECREF(py_value);
+        py_value = PyLong_FromUnsignedLongLong(s.max_high_water);
+        PyDict_SetItemString(py_category_dict, "max", py_value);
+        Py_DECREF(py_value);
+
+        PyDict_SetItemString(py_stats_dict, it.first.c_str(), py_category_dict);
+        Py_DECREF(py_category_dict);
+      }
+
+    return py_stats_dict;
+  }
+
+
+  PyDoc_STRVAR(
+    set_memory_budget_doc,
+    "set_memory_budget(nbytes)\n"
+    "--\n"
+    "\n"
+    "Sets the number of bytes that the collective readers may hold on each\n"
+    "rank. When a read would exceed the budget, the number of I/O ranks is\n"
+    "increased and, if necessary, the read is split into rounds. A value of\n"
+    "zero disables the budget. The budget is initially read from the\n"
+    "environment variable NEUROH5_MEMORY_BUDGET, which accepts an optional\n"
+    "K, M or G suffix. All ranks must use the same budget.\n"
+    "\n");
+
+  static PyObject *py_set_memory_budget (PyObject *self, PyObject *args, PyObject *kwds)
+  {
+    unsigned long long nbytes = 0;
+
+    static const char *kwlist[] = {
+                                   "nbytes",
+                                   NULL};
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "K", (char **)kwlist, &nbytes))
+      return NULL;
+
+    mpi::set_memory_budget(nbytes);
+
+    Py_RETURN_NONE;
+  }
+
   
   static PyMethodDef module_methods[] = {
     { "read_population_ranges", (PyCFunction)py_read_population_ranges, METH_VARARGS | METH_KEYWORDS,
@@ -8550,6 +10476,14 @@ extern "C"
       scatter_read_trees_doc },
     { "scatter_read_tree_selection", (PyCFunction)py_scatter_read_tree_selection, METH_VARARGS | METH_KEYWORDS,
       scatter_read_trees_doc },
+    { "tree_morphometrics", (PyCFunction)py_tree_morphometrics, METH_VARARGS | METH_KEYWORDS,
+      tree_morphometrics_doc },
+    { "query_cell_neighbors", (PyCFunction)py_query_cell_neighbors, METH_VARARGS | METH_KEYWORDS,
+      query_cell_neighbors_doc },
+    { "partition_cells", (PyCFunction)py_partition_cells, METH_VARARGS | METH_KEYWORDS,
+      partition_cells_doc },
+    { "partition_graph", (PyCFunction)py_partition_graph, METH_VARARGS | METH_KEYWORDS,
+      partition_graph_doc },
     { "read_cell_attribute_info", (PyCFunction)py_read_cell_attribute_info, METH_VARARGS | METH_KEYWORDS,
       read_cell_attribute_info_doc },
     { "read_cell_attribute_selection", (PyCFunction)py_read_cell_attribute_selection, METH_VARARGS | METH_KEYWORDS,
@@ -8566,6 +10500,10 @@ extern "C"
       "Writes attributes for the given range of cells." },
     { "append_cell_attributes", (PyCFunction)py_append_cell_attributes, METH_VARARGS | METH_KEYWORDS,
       "Appends additional attributes for the given range of cells." },
+    { "compact_cell_attributes", (PyCFunction)py_compact_cell_attributes, METH_VARARGS | METH_KEYWORDS,
+      compact_cell_attributes_doc },
+    { "stitch_cell_attributes", (PyCFunction)py_stitch_cell_attributes, METH_VARARGS | METH_KEYWORDS,
+      stitch_cell_attributes_doc },
     { "append_cell_trees", (PyCFunction)py_append_cell_trees, METH_VARARGS | METH_KEYWORDS,
       "Appends tree morphologies." },
     { "read_graph", (PyCFunction)py_read_graph, METH_VARARGS | METH_KEYWORDS,
@@ -8582,6 +10520,22 @@ extern "C"
       "Writes graph connectivity in Destination Block Sparse format." },
     { "append_graph", (PyCFunction)py_append_graph, METH_VARARGS | METH_KEYWORDS,
       "Appends graph connectivity in Destination Block Sparse format." },
+    { "append_graph_edges", (PyCFunction)py_append_graph_edges, METH_VARARGS | METH_KEYWORDS,
+      append_graph_edges_doc },
+    { "update_graph_attributes", (PyCFunction)py_update_graph_attributes, METH_VARARGS | METH_KEYWORDS,
+      update_graph_attributes_doc },
+    { "stitch_graph", (PyCFunction)py_stitch_graph, METH_VARARGS | METH_KEYWORDS,
+      stitch_graph_doc },
+    { "stats", (PyCFunction)py_stats, METH_VARARGS | METH_KEYWORDS,
+      stats_doc },
+    { "write_trace", (PyCFunction)py_write_trace, METH_VARARGS | METH_KEYWORDS,
+      write_trace_doc },
+    { "set_trace", (PyCFunction)py_set_trace, METH_VARARGS | METH_KEYWORDS,
+      set_trace_doc },
+    { "memory_stats", (PyCFunction)py_memory_stats, METH_VARARGS | METH_KEYWORDS,
+      memory_stats_doc },
+    { "set_memory_budget", (PyCFunction)py_set_memory_budget, METH_VARARGS | METH_KEYWORDS,
+      set_memory_budget_doc },
     { NULL, NULL, 0, NULL }
   };
 }
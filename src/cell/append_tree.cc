@@ -11,6 +11,7 @@
 #include <hdf5.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <deque>
 #include <vector>
 #include <forward_list>
@@ -25,11 +26,14 @@
 #include "enum_type.hh"
 #include "path_names.hh"
 #include "serialize_tree.hh"
+#include "mpi_trace.hh"
+#include "tree_template_set.hh"
 #include "cell_index.hh"
 #include "cell_attributes.hh"
 #include "create_file_toplevel.hh"
 #include "compact_optional.hh"
 #include "optional_value.hh"
+#include "thread_pool.hh"
 #include "throw_assert.hh"
 
 
@@ -59,7 +63,8 @@ namespace neuroh5
      std::vector<LAYER_IDX_T>& all_layers,        // Layer
      std::vector<SECTION_IDX_T>& all_sections,    // Section
      std::vector<PARENT_NODE_IDX_T>& all_parents, // Parent
-     std::vector<SWC_TYPE_T>& all_swc_types // SWC Types
+     std::vector<SWC_TYPE_T>& all_swc_types, // SWC Types
+     data::thread_pool* pool
      )
     {
       herr_t status; 
@@ -86,6 +91,10 @@ namespace neuroh5
       status = MPI_Allgather(&local_ptr_size, 1, MPI_SIZE_T, &ptr_size_vector[0], 1, MPI_SIZE_T, comm);
       throw_assert_nomsg(status == MPI_SUCCESS);
 
+      // Sizes and offsets of each tree are computed serially, after
+      // which the trees are copied into the flattened arrays in
+      // parallel
+      std::vector<const neurotree_t*> trees;
       for_each(tree_list.cbegin(),
                tree_list.cend(),
                [&] (const neurotree_t& tree)
@@ -126,16 +135,7 @@ namespace neuroh5
                  sec_ptr.push_back(sec_size+sec_ptr.back());
 
                  all_index_vector.push_back(idx);
-                 all_src_vector.insert(all_src_vector.end(),src_vector.begin(),src_vector.end());
-                 all_dst_vector.insert(all_dst_vector.end(),dst_vector.begin(),dst_vector.end());
-                 all_sections.insert(all_sections.end(),sections.begin(),sections.end());
-                 all_xcoords.insert(all_xcoords.end(),xcoords.begin(),xcoords.end());
-                 all_ycoords.insert(all_ycoords.end(),ycoords.begin(),ycoords.end());
-                 all_zcoords.insert(all_zcoords.end(),zcoords.begin(),zcoords.end());
-                 all_radiuses.insert(all_radiuses.end(),radiuses.begin(),radiuses.end());
-                 all_layers.insert(all_layers.end(),layers.begin(),layers.end());
-                 all_parents.insert(all_parents.end(),parents.begin(),parents.end());
-                 all_swc_types.insert(all_swc_types.end(),swc_types.begin(),swc_types.end());
+                 trees.push_back(&tree);
                  
                  all_attr_size = all_attr_size + attr_size;
                  all_sec_size  = all_sec_size + sec_size;
@@ -143,6 +143,51 @@ namespace neuroh5
                  
                });
 
+      const size_t topo_offset = all_src_vector.size();
+      const size_t attr_offset = all_xcoords.size();
+      const size_t sec_offset  = all_sections.size();
+
+      all_src_vector.resize(topo_offset + all_topo_size);
+      all_dst_vector.resize(topo_offset + all_topo_size);
+      all_sections.resize(sec_offset + all_sec_size);
+      all_xcoords.resize(attr_offset + all_attr_size);
+      all_ycoords.resize(attr_offset + all_attr_size);
+      all_zcoords.resize(attr_offset + all_attr_size);
+      all_radiuses.resize(attr_offset + all_attr_size);
+      all_layers.resize(attr_offset + all_attr_size);
+      all_parents.resize(attr_offset + all_attr_size);
+      all_swc_types.resize(attr_offset + all_attr_size);
+
+      auto copy_tree = [&] (size_t i, size_t worker)
+        {
+          const neurotree_t& tree = *trees[i];
+          const size_t topo_pos = topo_offset + topo_ptr[i];
+          const size_t attr_pos = attr_offset + attr_ptr[i];
+          const size_t sec_pos  = sec_offset + sec_ptr[i];
+          
+          std::copy(get<1>(tree).begin(), get<1>(tree).end(), all_src_vector.begin() + topo_pos);
+          std::copy(get<2>(tree).begin(), get<2>(tree).end(), all_dst_vector.begin() + topo_pos);
+          std::copy(get<3>(tree).begin(), get<3>(tree).end(), all_sections.begin() + sec_pos);
+          std::copy(get<4>(tree).begin(), get<4>(tree).end(), all_xcoords.begin() + attr_pos);
+          std::copy(get<5>(tree).begin(), get<5>(tree).end(), all_ycoords.begin() + attr_pos);
+          std::copy(get<6>(tree).begin(), get<6>(tree).end(), all_zcoords.begin() + attr_pos);
+          std::copy(get<7>(tree).begin(), get<7>(tree).end(), all_radiuses.begin() + attr_pos);
+          std::copy(get<8>(tree).begin(), get<8>(tree).end(), all_layers.begin() + attr_pos);
+          std::copy(get<9>(tree).begin(), get<9>(tree).end(), all_parents.begin() + attr_pos);
+          std::copy(get<10>(tree).begin(), get<10>(tree).end(), all_swc_types.begin() + attr_pos);
+        };
+      if (pool != NULL)
+        {
+          pool->parallel_for(trees.size(), copy_tree, 16);
+        }
+      else
+        {
+          for (size_t i = 0; i < trees.size(); i++)
+            {
+              copy_tree(i, 0);
+            }
+        }
+
       return 0;
     }
 
@@ -289,9 +334,11 @@ namespace neuroh5
      const set<size_t>              &io_rank_set,
      CellPtr                        ptr_type,
      const size_t                   chunk_size,
-     const size_t                   value_chunk_size
+     const size_t                   value_chunk_size,
+     const std::string&             name_space
      )
     {
+      mpi::trace_scope trace_total("append_trees");
       herr_t status=0; 
       size_t io_size=0;
 
@@ -351,15 +398,23 @@ namespace neuroh5
                    tree_map.insert(make_pair(gid, tree));
                  });
           
-        data::serialize_rank_tree_map (size, rank, rank_tree_map, sendcounts, sendbuf, sdispls);
+        {
+          mpi::trace_scope trace("append_trees.serialize");
+          data::serialize_rank_tree_map (size, rank, rank_tree_map, sendcounts, sendbuf, sdispls);
+          trace.add_bytes(sendbuf.size());
+        }
         
         throw_assert_nomsg(mpi::alltoallv_vector<char>(comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
                                                        recvcounts, rdispls, recvbuf) >= 0);
         sendbuf.clear();
         sendbuf.shrink_to_fit();
         
-        data::deserialize_rank_tree_list (size, recvbuf, recvcounts, rdispls,
-                                          local_tree_list);
+        {
+          mpi::trace_scope trace("append_trees.deserialize");
+          data::deserialize_rank_tree_list (size, recvbuf, recvcounts, rdispls,
+                                            local_tree_list);
+          trace.add_bytes(recvbuf.size());
+        }
       }
 
       std::vector<SEC_PTR_T> sec_ptr;
@@ -388,13 +443,15 @@ namespace neuroh5
             }
           else
             {
+              // the threads given by NEUROH5_NUM_THREADS copy the trees
+              data::thread_pool pool;
               status = build_tree_datasets(io_comm,
                                            local_tree_list,
                                            sec_ptr, topo_ptr, attr_ptr,
                                            all_index_vector, all_src_vector, all_dst_vector,
                                            all_xcoords, all_ycoords, all_zcoords, 
                                            all_radiuses, all_layers, all_sections,
-                                           all_parents, all_swc_types);
+                                           all_parents, all_swc_types, &pool);
               throw_assert_nomsg(status >= 0);
             }
           
@@ -409,8 +466,8 @@ namespace neuroh5
       const data::optional_hid section_data_type(SECTION_IDX_H5_NATIVE_T);
       const data::optional_hid swc_data_type(SWC_TYPE_H5_NATIVE_T);
 
-      string attr_ptr_owner_path = hdf5::cell_attribute_path(hdf5::TREES, pop_name, hdf5::X_COORD) + "/" + hdf5::ATTR_PTR;
-      string sec_ptr_owner_path  = hdf5::cell_attribute_path(hdf5::TREES, pop_name, hdf5::SRCSEC) + "/" + hdf5::SEC_PTR;
+      string attr_ptr_owner_path = hdf5::cell_attribute_path(name_space, pop_name, hdf5::X_COORD) + "/" + hdf5::ATTR_PTR;
+      string sec_ptr_owner_path  = hdf5::cell_attribute_path(name_space, pop_name, hdf5::SRCSEC) + "/" + hdf5::SEC_PTR;
 
       
       hid_t file;
@@ -423,56 +480,56 @@ namespace neuroh5
                        "append_trees: invalid file handle");
           
           append_cell_index (io_comm, file, pop_name, pop_start,
-                             hdf5::TREES, all_index_vector);
+                             name_space, all_index_vector);
           
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::X_COORD,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::X_COORD,
                                  all_index_vector, attr_ptr, all_xcoords,
                                  coord_data_type, IndexShared,
                                  CellPtr (PtrOwner, hdf5::ATTR_PTR),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::Y_COORD,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::Y_COORD,
                                  all_index_vector, attr_ptr, all_ycoords,
                                  coord_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::Z_COORD,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::Z_COORD,
                                  all_index_vector, attr_ptr, all_zcoords,
                                  coord_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::RADIUS,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::RADIUS,
                                  all_index_vector, attr_ptr, all_radiuses,
                                  dflt_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::LAYER,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::LAYER,
                                  all_index_vector, attr_ptr, all_layers,
                                  layer_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::PARENT,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::PARENT,
                                  all_index_vector, attr_ptr, all_parents,
                                  parent_node_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
           
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::SWCTYPE,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::SWCTYPE,
                                  all_index_vector, attr_ptr, all_swc_types,
                                  swc_data_type, IndexShared,
                                  CellPtr (PtrShared, attr_ptr_owner_path),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::SRCSEC,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::SRCSEC,
                                  all_index_vector, topo_ptr, all_src_vector,
                                  section_data_type, IndexShared,
                                  CellPtr (PtrOwner, hdf5::SEC_PTR),
                                  chunk_size, value_chunk_size);
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::DSTSEC,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::DSTSEC,
                                  all_index_vector, topo_ptr, all_dst_vector,
                                  section_data_type, IndexShared,
                                  CellPtr (PtrShared, sec_ptr_owner_path),
                                  chunk_size, value_chunk_size);
           
-          append_cell_attribute (file, hdf5::TREES, pop_name, pop_start, hdf5::SECTION,
+          append_cell_attribute (file, name_space, pop_name, pop_start, hdf5::SECTION,
                                  all_index_vector, sec_ptr, all_sections,
                                  section_data_type, IndexShared,
                                  CellPtr (PtrOwner, hdf5::SEC_PTR),
@@ -499,7 +556,8 @@ namespace neuroh5
      std::forward_list<neurotree_t> &tree_list,
      size_t                         io_size,
      const size_t                   chunk_size,
-     const size_t                   value_chunk_size
+     const size_t                   value_chunk_size,
+     const std::string&             name_space
      )
     {
       herr_t status;
@@ -554,7 +612,8 @@ namespace neuroh5
         }
       
       status = append_trees(comm, io_comm, file, pop_name, pop_start, tree_list,
-                            io_rank_set,  CellPtr(PtrOwner), chunk_size, value_chunk_size);
+                            io_rank_set,  CellPtr(PtrOwner), chunk_size, value_chunk_size,
+                            name_space);
       throw_assert_nomsg(status >= 0);
 
       if (is_io_rank)
@@ -568,6 +627,105 @@ namespace neuroh5
       return 0;
     }
 
+
+    /*****************************************************************************
+     * Save morphology templates to HDF5
+     *****************************************************************************/
+    int append_tree_templates
+    (
+     MPI_Comm                       comm,
+     const std::string&             file_name,
+     const std::string&             pop_name,
+     std::forward_list<neurotree_t> &template_list,
+     size_t                         io_size,
+     const size_t                   chunk_size,
+     const size_t                   value_chunk_size
+     )
+    {
+      // templates are indexed by template id, not by cell id
+      const CELL_IDX_T template_start = 0;
+      return append_trees(comm, file_name, pop_name, template_start, template_list,
+                          io_size, chunk_size, value_chunk_size,
+                          hdf5::TREE_TEMPLATES);
+    }
+
+
+    /*****************************************************************************
+     * Save the template references of cells to HDF5
+     *****************************************************************************/
+    int append_tree_template_index
+    (
+     MPI_Comm                       comm,
+     const std::string&             file_name,
+     const std::string&             pop_name,
+     const CELL_IDX_T&              pop_start,
+     const data::TreeTemplateSet&   template_refs,
+     size_t                         io_size,
+     const size_t                   chunk_size,
+     const size_t                   value_chunk_size
+     )
+    {
+      throw_assert((template_refs.template_index.size() == template_refs.size()) &&
+                   (template_refs.offset.size() == 3*template_refs.size()),
+                   "append_tree_template_index: reference arrays do not match number of cells");
+
+      map<string, map<CELL_IDX_T, deque<uint32_t> > > attr_values_uint32;
+      map<string, map<CELL_IDX_T, deque<int32_t> > > attr_values_int32;
+      map<string, map<CELL_IDX_T, deque<uint16_t> > > attr_values_uint16;
+      map<string, map<CELL_IDX_T, deque<int16_t> > > attr_values_int16;
+      map<string, map<CELL_IDX_T, deque<uint8_t> > > attr_values_uint8;
+      map<string, map<CELL_IDX_T, deque<int8_t> > > attr_values_int8;
+      map<string, map<CELL_IDX_T, deque<float> > > attr_values_float;
+
+      map<CELL_IDX_T, deque<uint32_t> >& template_id_map = attr_values_uint32[hdf5::TEMPLATE_ID];
+      map<CELL_IDX_T, deque<float> > template_offset_map;
+
+      int local_has_offset = 0, has_offset = 0;
+      for (size_t i=0; i<template_refs.size(); i++)
+        {
+          const CELL_IDX_T gid = template_refs.index[i];
+          template_id_map[gid].push_back(template_refs.template_index[i]);
+
+          deque<float>& offset = template_offset_map[gid];
+          for (size_t d=0; d<3; d++)
+            {
+              const COORD_T v = template_refs.offset[3*i+d];
+              offset.push_back(v);
+              if (v != 0.0)
+                {
+                  local_has_offset = 1;
+                }
+            }
+        }
+
+      size_t local_num_refs = template_refs.size(), num_refs = 0;
+      throw_assert(MPI_Allreduce(&local_num_refs, &num_refs, 1, MPI_SIZE_T, MPI_SUM, comm) == MPI_SUCCESS,
+                   "append_tree_template_index: error in MPI_Allreduce");
+      if (num_refs == 0)
+        {
+          return 0;
+        }
+      throw_assert(MPI_Allreduce(&local_has_offset, &has_offset, 1, MPI_INT, MPI_MAX, comm) == MPI_SUCCESS,
+                   "append_tree_template_index: error in MPI_Allreduce");
+
+      // translations are only stored if at least one cell is translated
+      if (has_offset)
+        {
+          attr_values_float[hdf5::TEMPLATE_OFFSET].swap(template_offset_map);
+        }
+
+      const data::optional_hid dflt_data_type;
+      append_cell_attribute_maps (comm, file_name, hdf5::TREE_TEMPLATE_INDEX, pop_name, pop_start,
+                                  attr_values_uint32, attr_values_int32,
+                                  attr_values_uint16, attr_values_int16,
+                                  attr_values_uint8, attr_values_int8,
+                                  attr_values_float, io_size, dflt_data_type,
+                                  IndexOwner, CellPtr(PtrOwner),
+                                  chunk_size, value_chunk_size);
+
+      return 0;
+    }
+
     
   }
 }
@@ -26,7 +26,12 @@
 #include "serialize_data.hh"
 #include "serialize_cell_attributes.hh"
 #include "range_sample.hh"
+#include "sample_sort.hh"
 #include "mpe_seq.hh"
+#include "memory_size.hh"
+#include "mpi_memory.hh"
+#include "mpi_trace.hh"
+#include "thread_pool.hh"
 #include "debug.hh"
 #include "throw_assert.hh"
 
@@ -34,6 +39,7 @@
 #include <mpi.h>
 
 #include <cstdint>
+#include <memory>
 #include <unistd.h>
 #include <string>
 #include <type_traits>
@@ -570,6 +576,14 @@ namespace neuroh5
       throw_assert(status == 0,
                    "create_cell_attribute_datasets: unable to set allocation time");
 #ifdef H5_HAS_PARALLEL_DEFLATE
+      // byte shuffling groups the similar high-order bytes of
+      // multi-byte values, which compress better
+      if (H5Tget_size(ftype) > 1)
+        {
+          status = H5Pset_shuffle(value_plist);
+          throw_assert(status == 0,
+                       "create_cell_attribute_datasets: unable to add shuffle filter");
+        }
       status = H5Pset_deflate(value_plist, 9);
       throw_assert(status == 0,
                    "create_cell_attribute_datasets: unable to add deflate filter");
@@ -725,9 +739,11 @@ namespace neuroh5
      const CELL_IDX_T& pop_start,
      data::NamedAttrMap& attr_values,
      size_t offset,
-     size_t numitems
+     size_t numitems,
+     data::thread_pool* pool
      )
     {
+      mpi::trace_scope trace_total("read_cell_attributes");
       herr_t status; 
 
       unsigned int rank, size;
@@ -798,15 +814,21 @@ namespace neuroh5
       }
 
       // get a file handle and retrieve the MPI info
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-#ifdef HDF5_IS_PARALLEL
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
-#endif
+      hid_t fapl = hdf5::read_access_plist(comm);
       // TODO: configurable elink cache
       // throw_assert_nomsg(H5Pset_elink_file_cache_size(fapl, 10) >= 0);
       hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
       throw_assert_nomsg(file >= 0);
 
+      // a read that is not part of a larger one decompresses the values
+      // on a pool of its own
+      unique_ptr<data::thread_pool> read_pool;
+      if (pool == NULL)
+        {
+          read_pool.reset(new data::thread_pool());
+          pool = read_pool.get();
+        }
+
       for (size_t i=0; i<attr_info.size(); i++)
         {
           vector<CELL_IDX_T>  value_index;
@@ -832,7 +854,7 @@ namespace neuroh5
                   status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                      index, ptr, value_index, value_ptr,
                                                      attr_values_uint32,
-                                                     offset, numitems);
+                                                     offset, numitems, pool);
                   attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint32);
                 }
               else if (attr_size == 2)
@@ -840,7 +862,7 @@ namespace neuroh5
                   vector<uint16_t> attr_values_uint16;
                   status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                      index, ptr, value_index, value_ptr, attr_values_uint16,
-                                                     offset, numitems);
+                                                     offset, numitems, pool);
                   attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint16);
                 }
               else if (attr_size == 1)
@@ -848,7 +870,7 @@ namespace neuroh5
                   vector<uint8_t> attr_values_uint8;
                   status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                      index, ptr, value_index, value_ptr, attr_values_uint8,
-                                                     offset, numitems);
+                                                     offset, numitems, pool);
                   attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint8);
                 }
               else
@@ -863,7 +885,7 @@ namespace neuroh5
                     vector<int32_t> attr_values_int32;
                     status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                        index, ptr, value_index, value_ptr, attr_values_int32,
-                                                       offset, numitems);
+                                                       offset, numitems, pool);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int32);
                   }
                 else if (attr_size == 2)
@@ -871,7 +893,7 @@ namespace neuroh5
                     vector<int16_t> attr_values_int16;
                     status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                        index, ptr, value_index, value_ptr, attr_values_int16,
-                                                       offset, numitems);
+                                                       offset, numitems, pool);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int16);
                   }
                 else if (attr_size == 1)
@@ -879,7 +901,7 @@ namespace neuroh5
                     vector<int8_t> attr_values_int8;
                     status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                        index, ptr, value_index, value_ptr, attr_values_int8,
-                                                       offset, numitems);
+                                                       offset, numitems, pool);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int8);
                   }
                 else
@@ -893,7 +915,7 @@ namespace neuroh5
                 vector<float> attr_values_float;
                 status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                    index, ptr, value_index, value_ptr, attr_values_float,
-                                                   offset, numitems);
+                                                   offset, numitems, pool);
                 attr_values.insert(attr_name, value_index, value_ptr, attr_values_float);
               }
               break;
@@ -904,7 +926,7 @@ namespace neuroh5
                     vector<uint8_t> attr_values_uint8;
                     status = hdf5::read_cell_attribute(comm, file, attr_path, pop_start,
                                                        index, ptr, value_index, value_ptr, attr_values_uint8,
-                                                       offset, numitems);
+                                                       offset, numitems, pool);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint8);
                   }
                 else
@@ -942,9 +964,11 @@ namespace neuroh5
      // if positive, these arguments specify offset and number of entries to read
      // from the entries available to the current rank
      size_t offset,
-     size_t numitems
+     size_t numitems,
+     const data::AttrPredicate& predicate
      )
     {
+      mpi::trace_scope trace_total("scatter_read_cell_attributes");
       int srank, ssize; size_t rank, size;
       throw_assert_nomsg(MPI_Comm_size(all_comm, &ssize) >= 0);
       throw_assert_nomsg(MPI_Comm_rank(all_comm, &srank) >= 0);
@@ -965,30 +989,61 @@ namespace neuroh5
     
       vector<char> sendbuf; 
       vector<int> sendcounts(size,0), sdispls(size,0), recvcounts(size,0), rdispls(size,0);
+      mpi::memory_scope sendbuf_memory("scatter_read_cell_attributes.send_buffer");
 
       set<size_t> io_rank_set;
       data::range_sample(size, io_size, io_rank_set);
       bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
 
+      map <rank_t, data::AttrMap > rank_attr_map;
+      mpi::memory_scope rank_attr_map_memory("scatter_read_cell_attributes.rank_attr_map");
+
       if (is_io_rank)
         {
           // Am I an I/O rank?
           MPI_Comm_split(all_comm,io_color,rank,&io_comm);
           MPI_Comm_set_errhandler(io_comm, MPI_ERRORS_RETURN);
 
-
-
-          map <rank_t, data::AttrMap > rank_attr_map;
           {
             data::NamedAttrMap  attr_values;
-            read_cell_attributes(io_comm, file_name, attr_name_space, attr_mask, pop_name, pop_start,
-                                 attr_values, offset, numitems * size);
-            data::append_rank_attr_map(attr_values, node_rank_map, rank_attr_map);
+            set<string> read_attr_mask(attr_mask);
+            const set<string> predicate_attrs = predicate.extend_mask(read_attr_mask);
+            {
+              mpi::trace_scope trace("scatter_read_cell_attributes.read");
+              // the threads given by NEUROH5_NUM_THREADS decompress the values
+              data::thread_pool pool;
+              read_cell_attributes(io_comm, file_name, attr_name_space, read_attr_mask, pop_name, pop_start,
+                                   attr_values, offset, numitems * size, &pool);
+            }
+            data::filter_attr_map(predicate, attr_values);
+            data::erase_attrs(predicate_attrs, attr_values);
+            mpi::memory_scope attr_values_memory("scatter_read_cell_attributes.io_attr_map",
+                                                 data::attr_map_bytes(attr_values));
+            {
+              mpi::trace_scope trace("scatter_read_cell_attributes.append_rank_attr_map");
+              data::append_rank_attr_map(attr_values, node_rank_map, rank_attr_map);
+            }
+            for (auto const& it : rank_attr_map)
+              {
+                rank_attr_map_memory.add(data::attr_map_bytes(it.second));
+              }
             attr_values.num_attrs(num_attrs);
             attr_values.attr_names(attr_names);
           }
 
-          data::serialize_rank_attr_map (size, rank, rank_attr_map, sendcounts, sendbuf, sdispls);
+          // a single rank keeps its attributes in rank_attr_map and
+          // inserts them below without serializing them
+          if (size > 1)
+            {
+              {
+                mpi::trace_scope trace("scatter_read_cell_attributes.serialize");
+                data::serialize_rank_attr_map (size, rank, rank_attr_map, sendcounts, sendbuf, sdispls);
+                trace.add_bytes(sendbuf.size());
+              }
+              sendbuf_memory.set(data::vector_bytes(sendbuf));
+              rank_attr_map.clear();
+              rank_attr_map_memory.set(0);
+            }
         }
       else
         {
@@ -1059,41 +1114,55 @@ namespace neuroh5
           attr_map.insert_name<int32_t>(attr_names[data::AttrMap::attr_index_int32][i]);
         }
     
-      // 6. Each ALL_COMM rank sends an attribute set size to
-      //    every other ALL_COMM rank (non IO_COMM ranks pass zero)
+      if (size == 1)
+        {
+          for (auto& it : rank_attr_map)
+            {
+              attr_map.insert_map(std::move(it.second));
+            }
+          rank_attr_map.clear();
+          rank_attr_map_memory.set(0);
+        }
+      else
+        {
+          // 6. Each ALL_COMM rank sends an attribute set size to
+          //    every other ALL_COMM rank (non IO_COMM ranks pass zero)
     
-      throw_assert_nomsg(MPI_Alltoall(&sendcounts[0], 1, MPI_INT,
-                          &recvcounts[0], 1, MPI_INT, all_comm) >= 0);
+          throw_assert_nomsg(MPI_Alltoall(&sendcounts[0], 1, MPI_INT,
+                              &recvcounts[0], 1, MPI_INT, all_comm) >= 0);
     
-      // 7. Each ALL_COMM rank accumulates the vector sizes and allocates
-      //    a receive buffer, recvcounts, and rdispls
-      size_t recvbuf_size;
-      vector<char> recvbuf;
+          // 7. Each ALL_COMM rank accumulates the vector sizes and allocates
+          //    a receive buffer, recvcounts, and rdispls
+          size_t recvbuf_size;
+          vector<char> recvbuf;
 
-      recvbuf_size = recvcounts[0];
-      for (int p = 1; p < ssize; ++p)
-        {
-          rdispls[p] = rdispls[p-1] + recvcounts[p-1];
-          recvbuf_size += recvcounts[p];
-        }
-      if (recvbuf_size > 0)
-        recvbuf.resize(recvbuf_size);
+          recvbuf_size = recvcounts[0];
+          for (int p = 1; p < ssize; ++p)
+            {
+              rdispls[p] = rdispls[p-1] + recvcounts[p-1];
+              recvbuf_size += recvcounts[p];
+            }
+          if (recvbuf_size > 0)
+            recvbuf.resize(recvbuf_size);
 
-      // 8. Each ALL_COMM rank participates in the MPI_Alltoallv
-      throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
-                                                     recvcounts, rdispls, recvbuf) >= 0);
+          // 8. Each ALL_COMM rank participates in the MPI_Alltoallv
+          throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
+                                                         recvcounts, rdispls, recvbuf) >= 0);
+          mpi::memory_scope recvbuf_memory("scatter_read_cell_attributes.recv_buffer", data::vector_bytes(recvbuf));
 
-    
-      sendbuf.clear();
-      sendbuf.shrink_to_fit();
+          sendbuf.clear();
+          sendbuf.shrink_to_fit();
+          sendbuf_memory.set(0);
 
-      if (recvbuf.size() > 0)
-        {
-          data::deserialize_rank_attr_map (size, recvbuf, recvcounts, rdispls, attr_map);
+          if (recvbuf.size() > 0)
+            {
+              mpi::trace_scope trace("scatter_read_cell_attributes.deserialize");
+              data::deserialize_rank_attr_map (size, recvbuf, recvcounts, rdispls, attr_map);
+              trace.add_bytes(recvbuf.size());
+            }
         }
-      recvbuf.clear();
-      recvbuf.shrink_to_fit();
-      
+      mpi::memory_scope attr_map_memory("scatter_read_cell_attributes.attr_map", data::attr_map_bytes(attr_map));
+
 
       return 0;
     }
@@ -1113,6 +1182,7 @@ namespace neuroh5
      size_t numitems
      )
     {
+      mpi::trace_scope trace_total("bcast_cell_attributes");
       herr_t status; 
       
       unsigned int rank, size;
@@ -1148,10 +1218,7 @@ namespace neuroh5
         }
 
       // get a file handle and retrieve the MPI info
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-#ifdef HDF5_IS_PARALLEL
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, io_comm, MPI_INFO_NULL) >= 0);
-#endif
+      hid_t fapl = hdf5::read_access_plist(io_comm);
     
       hid_t file;
       if (rank == (unsigned int)root)
@@ -1159,6 +1226,8 @@ namespace neuroh5
 
           file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
           throw_assert_nomsg(file >= 0);
+          // the threads given by NEUROH5_NUM_THREADS decompress the values
+          data::thread_pool pool;
         
           for (size_t i=0; i<attr_info.size(); i++)
             {
@@ -1185,7 +1254,7 @@ namespace neuroh5
                         vector<uint32_t> attr_map_uint32;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_uint32);
+                                                           attr_map_uint32, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_uint32);
                       }
                     else if (attr_size == 2)
@@ -1193,7 +1262,7 @@ namespace neuroh5
                         vector<uint16_t> attr_map_uint16;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_uint16);
+                                                           attr_map_uint16, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_uint16);
                       }
                     else if (attr_size == 1)
@@ -1201,7 +1270,7 @@ namespace neuroh5
                         vector<uint8_t> attr_map_uint8;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_uint8);
+                                                           attr_map_uint8, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_uint8);
                       }
                     else
@@ -1217,7 +1286,7 @@ namespace neuroh5
                         vector<int32_t> attr_map_int32;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_int32);
+                                                           attr_map_int32, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_int32);
                       }
                     else if (attr_size == 2)
@@ -1225,7 +1294,7 @@ namespace neuroh5
                         vector<uint16_t> attr_map_int16;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_int16);
+                                                           attr_map_int16, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_int16);
                       }
                     else if (attr_size == 1)
@@ -1233,7 +1302,7 @@ namespace neuroh5
                         vector<uint8_t> attr_map_int8;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_int8);
+                                                           attr_map_int8, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_int8);
                       }
                     else
@@ -1247,7 +1316,7 @@ namespace neuroh5
                     vector<float> attr_map_float;
                     status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                        index, ptr, value_index, value_ptr,
-                                                       attr_map_float);
+                                                       attr_map_float, 0, 0, &pool);
                     attr_map.insert(attr_name, value_index, value_ptr, attr_map_float);
                   }
                   break;
@@ -1258,7 +1327,7 @@ namespace neuroh5
                         vector<uint8_t> attr_map_uint8;
                         status = hdf5::read_cell_attribute(io_comm, file, attr_path, pop_start,
                                                            index, ptr, value_index, value_ptr,
-                                                           attr_map_uint8);
+                                                           attr_map_uint8, 0, 0, &pool);
                         attr_map.insert(attr_name, value_index, value_ptr, attr_map_uint8);
                       }
                     else
@@ -1384,6 +1453,7 @@ namespace neuroh5
      data::NamedAttrMap& attr_values
      )
     {
+      mpi::trace_scope trace_total("read_cell_attribute_selection");
       herr_t status; 
       unsigned int rank, size;
       throw_assert_nomsg(MPI_Comm_size(comm, (int*)&size) >= 0);
@@ -1419,11 +1489,7 @@ namespace neuroh5
       }
 
       // get a file handle and retrieve the MPI info
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-#ifdef HDF5_IS_PARALLEL
-      throw_assert(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0,
-                   "read_cell_attribute_selection: error setting MPI driver for file access");
-#endif
+      hid_t fapl = hdf5::read_access_plist(comm);
       
       hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
       throw_assert(file >= 0,
@@ -1432,7 +1498,10 @@ namespace neuroh5
       status = H5Pclose(fapl);
       throw_assert(status == 0,
                    "read_cell_attribute_selection: unable to close file access property list");
-      
+
+      const bool sorted = hdf5::get_group_flag(file, hdf5::cell_attribute_prefix(name_space, pop_name),
+                                               hdf5::SORTED);
+
       for (size_t i=0; i<attr_info.size(); i++)
         {
           vector<ATTR_PTR_T> value_ptr;
@@ -1456,7 +1525,7 @@ namespace neuroh5
                     vector<uint32_t> attr_values_uint32;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_uint32);
+                                                                 attr_values_uint32, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint32);
                   }
                 else if (attr_size == 2)
@@ -1464,7 +1533,7 @@ namespace neuroh5
                     vector<uint16_t> attr_values_uint16;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_uint16);
+                                                                 attr_values_uint16, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint16);
                   }
                 else if (attr_size == 1)
@@ -1472,7 +1541,7 @@ namespace neuroh5
                     vector<uint8_t> attr_values_uint8;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_uint8);
+                                                                 attr_values_uint8, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint8);
                   }
                 else
@@ -1488,7 +1557,7 @@ namespace neuroh5
                     vector<int32_t> attr_values_int32;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_int32);
+                                                                 attr_values_int32, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int32);
                   }
                 else if (attr_size == 2)
@@ -1496,7 +1565,7 @@ namespace neuroh5
                     vector<int16_t> attr_values_int16;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_int16);
+                                                                 attr_values_int16, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int16);
                   }
                 else if (attr_size == 1)
@@ -1504,7 +1573,7 @@ namespace neuroh5
                     vector<int8_t> attr_values_int8;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_int8);
+                                                                 attr_values_int8, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_int8);
                   }
                 else
@@ -1518,7 +1587,7 @@ namespace neuroh5
                 vector<float> attr_values_float;
                 status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                              selection, index, ptr, value_index, value_ptr,
-                                                             attr_values_float);
+                                                             attr_values_float, sorted);
                 attr_values.insert(attr_name, value_index, value_ptr, attr_values_float);
               }
               break;
@@ -1529,7 +1598,7 @@ namespace neuroh5
                     vector<uint8_t> attr_values_uint8;
                     status = hdf5::read_cell_attribute_selection(comm, file, attr_path, pop_start,
                                                                  selection, index, ptr, value_index, value_ptr,
-                                                                 attr_values_uint8);
+                                                                 attr_values_uint8, sorted);
                     attr_values.insert(attr_name, value_index, value_ptr, attr_values_uint8);
                   }
                 else
@@ -1561,9 +1630,11 @@ namespace neuroh5
      const string& pop_name,
      const CELL_IDX_T& pop_start,
      const std::vector<CELL_IDX_T>&  selection,
-     data::NamedAttrMap& attr_values
+     data::NamedAttrMap& attr_values,
+     const data::AttrPredicate& predicate
      )
     {
+      mpi::trace_scope trace_total("scatter_read_cell_attribute_selection");
       herr_t status; 
       throw_assert_nomsg(io_size > 0);
 
@@ -1573,49 +1644,6 @@ namespace neuroh5
       throw_assert_nomsg(MPI_Comm_size(comm, (int*)&size) >= 0);
       throw_assert_nomsg(MPI_Comm_rank(comm, (int*)&rank) >= 0);
 
-      vector<CELL_IDX_T> all_selections;
-      node_rank_map_t node_rank_map;
-      {
-        vector<size_t> sendbuf_selection_size(size, selection_size);
-        vector<size_t> recvbuf_selection_size(size);
-        vector<int> recvcounts(size, 0);
-        vector<int> displs(size+1, 0);
-        
-        // Each COMM rank sends its selection to every other COMM rank
-        throw_assert_nomsg(MPI_Allgather(&sendbuf_selection_size[0], 1, MPI_SIZE_T,
-                                         &recvbuf_selection_size[0], 1, MPI_SIZE_T, comm)
-                           == MPI_SUCCESS);
-#ifdef NEUROH5_DEBUG
-        throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
-#endif
-
-        size_t total_selection_size = 0;
-        for (size_t p=0; p<size; p++)
-          {
-            total_selection_size = total_selection_size + recvbuf_selection_size[p];
-            displs[p+1] = displs[p] + recvbuf_selection_size[p];
-            recvcounts[p] = recvbuf_selection_size[p];
-          }
-
-        all_selections.resize(total_selection_size);
-        throw_assert_nomsg(MPI_Allgatherv(&selection[0], selection_size, MPI_CELL_IDX_T,
-                                          &all_selections[0], &recvcounts[0], &displs[0], MPI_CELL_IDX_T,
-                                          comm) == MPI_SUCCESS);
-#ifdef NEUROH5_DEBUG
-        throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
-#endif
-        // Construct node rank map based on selection information.
-        for (rank_t p=0; p<size; p++)
-          {
-            for (size_t i = displs[p]; i<displs[p+1]; i++)
-              {
-                node_rank_map[all_selections[i]].insert(p);
-              }
-            
-          }
-        
-      }
-          
       vector<int> sendcounts(size,0), sdispls(size,0), recvcounts(size,0), rdispls(size,0);
       vector<char> sendbuf; 
 
@@ -1639,6 +1667,35 @@ namespace neuroh5
       
       // I/O rank with lowest data rank 
       size_t io_root_data_rank = *(io_rank_set.begin());
+
+      // Redistribute the selection with a distributed sample sort, so
+      // that each I/O rank receives a sorted, contiguous range of the
+      // selected indices, along with the ranks that requested them.
+      vector<CELL_IDX_T> io_selection;
+      node_rank_map_t node_rank_map;
+      {
+        vector<CELL_IDX_T> selection_keys(selection);
+        vector<rank_t> selection_ranks(selection_size, rank);
+        vector<rank_t> io_ranks(io_rank_set.begin(), io_rank_set.end());
+
+        {
+          mpi::trace_scope trace("scatter_read_cell_attribute_selection.sort");
+          mpi::bucket_plan_t plan;
+          mpi::sample_sort(comm, selection_keys, plan, io_ranks);
+          mpi::bucket_exchange(comm, plan, selection_ranks);
+          trace.add_items(selection_size);
+        }
+
+        for (size_t i=0; i<selection_keys.size(); i++)
+          {
+            const CELL_IDX_T s = selection_keys[i];
+            if (io_selection.empty() || (io_selection.back() != s))
+              {
+                io_selection.push_back(s);
+              }
+            node_rank_map[s].insert(selection_ranks[i]);
+          }
+      }
       
       if (is_io_rank)
         {
@@ -1646,39 +1703,31 @@ namespace neuroh5
           MPI_Comm_split(comm, io_color, rank, &io_comm);
           MPI_Comm_set_errhandler(io_comm, MPI_ERRORS_RETURN);
           
-          unsigned int io_rank, io_size;
-          throw_assert_nomsg(MPI_Comm_size(io_comm, (int*)&io_size) >= 0);
-          throw_assert_nomsg(MPI_Comm_rank(io_comm, (int*)&io_rank) >= 0);
-          
-          std::vector<CELL_IDX_T> io_selection;
-          {
-            std::set<CELL_IDX_T> io_selection_set;
-            size_t s_index = 0;
-            for (const CELL_IDX_T& s : all_selections)
-              {
-                if ((s_index % io_size) == io_rank)
-                  {
-                    io_selection_set.insert(s);
-                  }
-                s_index++;
-              }
-            for (const CELL_IDX_T& s : io_selection_set)
-              {
-                io_selection.push_back(s);
-              }
-            
-          }
           map <rank_t, data::AttrMap > rank_attr_map;
           {
             data::NamedAttrMap  attr_values;
-            read_cell_attribute_selection(io_comm, file_name, attr_name_space, attr_mask, pop_name, pop_start,
-                                          io_selection, attr_values);
-            data::append_rank_attr_map(attr_values, node_rank_map, rank_attr_map);
+            set<string> read_attr_mask(attr_mask);
+            const set<string> predicate_attrs = predicate.extend_mask(read_attr_mask);
+            {
+              mpi::trace_scope trace("scatter_read_cell_attribute_selection.read");
+              read_cell_attribute_selection(io_comm, file_name, attr_name_space, read_attr_mask, pop_name, pop_start,
+                                            io_selection, attr_values);
+            }
+            data::filter_attr_map(predicate, attr_values);
+            data::erase_attrs(predicate_attrs, attr_values);
+            {
+              mpi::trace_scope trace("scatter_read_cell_attribute_selection.append_rank_attr_map");
+              data::append_rank_attr_map(attr_values, node_rank_map, rank_attr_map);
+            }
             attr_values.num_attrs(num_attrs);
             attr_values.attr_names(attr_names);
           }
           
-          data::serialize_rank_attr_map (size, rank, rank_attr_map, sendcounts, sendbuf, sdispls);
+          {
+            mpi::trace_scope trace("scatter_read_cell_attribute_selection.serialize");
+            data::serialize_rank_attr_map (size, rank, rank_attr_map, sendcounts, sendbuf, sdispls);
+            trace.add_bytes(sendbuf.size());
+          }
           throw_assert_nomsg(MPI_Barrier(io_comm) == MPI_SUCCESS);
         }
       else
@@ -1779,7 +1828,9 @@ namespace neuroh5
       
       if (recvbuf.size() > 0)
         {
+          mpi::trace_scope trace("scatter_read_cell_attribute_selection.deserialize");
           data::deserialize_rank_attr_map (size, recvbuf, recvcounts, rdispls, attr_values);
+          trace.add_bytes(recvbuf.size());
         }
       recvbuf.clear();
     }
@@ -1806,6 +1857,7 @@ namespace neuroh5
                                      const size_t cache_size
                                      )
     {
+      mpi::trace_scope trace_total("append_cell_attribute_maps");
       herr_t status;
       int ssize, srank; size_t size, rank; size_t io_size_value=0;
       throw_assert(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS, "error in MPI_Comm_size");
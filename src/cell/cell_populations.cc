@@ -317,7 +317,7 @@ namespace neuroh5
               for (size_t i=0; i<num_labels; i++)
                 {
                   char namebuf[MAX_POP_NAME_LEN];
-                  int member_val;
+                  int member_val = 0;
                   ierr = H5Tget_member_value(pop_labels_type, i, &member_val);
                   throw_assert_nomsg(ierr >= 0);
                   ierr = H5Tenum_nameof(pop_labels_type, &member_val, namebuf, MAX_POP_NAME_LEN);
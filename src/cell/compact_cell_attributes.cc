@@ -0,0 +1,375 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file compact_cell_attributes.cc
+///
+///  Compaction of cell attribute namespaces.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "compact_cell_attributes.hh"
+#include "cell_attributes.hh"
+#include "hdf5_cell_attributes.hh"
+#include "path_names.hh"
+#include "exists_dataset.hh"
+#include "group_flag.hh"
+#include "file_access.hh"
+#include "read_template.hh"
+#include "rank_range.hh"
+#include "serialize_data.hh"
+#include "mpi_trace.hh"
+#include "throw_assert.hh"
+
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    /// Suffix of the namespace into which the attributes are written
+    /// before it replaces the original namespace.
+    static const string compact_suffix = ".compact";
+
+    static size_t compact_chunk_size (const size_t num_elements, const size_t element_size,
+                                      const size_t chunk_bytes)
+    {
+      const size_t chunk_size = max((size_t)1, chunk_bytes / max((size_t)1, element_size));
+      return max((size_t)1, min(chunk_size, num_elements));
+    }
+
+    /*****************************************************************************
+     * Returns the positions in the index of the cells to keep, in
+     * ascending cell order. Of the entries of a cell that occurs more
+     * than once, the last one is kept.
+     *****************************************************************************/
+    static void compact_cell_index (const vector<CELL_IDX_T>& index,
+                                    vector<size_t>& positions)
+    {
+      vector<size_t> p(index.size());
+      iota(p.begin(), p.end(), 0);
+      stable_sort(p.begin(), p.end(),
+                  [&index] (const size_t& a, const size_t& b)
+                  { return index[a] < index[b]; });
+
+      positions.clear();
+      for (size_t i = 0; i < p.size(); i++)
+        {
+          if ((i+1 < p.size()) && (index[p[i+1]] == index[p[i]]))
+            {
+              continue;
+            }
+          positions.push_back(p[i]);
+        }
+    }
+
+    /*****************************************************************************
+     * Reads the values of this rank's part of the compacted cells and
+     * writes them to the compacted attribute
+     *****************************************************************************/
+    template <typename T>
+    static void compact_cell_attribute (MPI_Comm comm,
+                                        hid_t file,
+                                        const string& path,
+                                        const string& compact_path,
+                                        const vector<CELL_IDX_T>& index,
+                                        const vector<ATTR_PTR_T>& ptr,
+                                        const vector<size_t>& positions)
+    {
+      mpi::trace_scope trace("compact_cell_attributes.attribute");
+
+      int ssize, srank;
+      throw_assert_nomsg(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &srank) == MPI_SUCCESS);
+
+      vector< pair<hsize_t,hsize_t> > rank_ranges;
+      mpi::rank_ranges(positions.size(), ssize, rank_ranges);
+      const size_t start = rank_ranges[srank].first;
+      const size_t end   = start + rank_ranges[srank].second;
+
+      // the values are read in file order and then placed in cell order
+      vector<size_t> value_order;
+      for (size_t i = start; i < end; i++)
+        {
+          const size_t pos = positions[i];
+          if (ptr[pos+1] > ptr[pos])
+            {
+              value_order.push_back(i);
+            }
+        }
+      sort(value_order.begin(), value_order.end(),
+           [&] (const size_t& a, const size_t& b)
+           { return ptr[positions[a]] < ptr[positions[b]]; });
+
+      vector< pair<hsize_t,hsize_t> > ranges;
+      vector<ATTR_PTR_T> value_offsets(end - start, 0);
+      ATTR_PTR_T num_values = 0;
+      for (const size_t i : value_order)
+        {
+          const size_t pos = positions[i];
+          const hsize_t value_start = ptr[pos];
+          const hsize_t value_block = ptr[pos+1] - value_start;
+          value_offsets[i - start] = num_values;
+          num_values += value_block;
+          if ((ranges.size() > 0) && (ranges.back().first + ranges.back().second == value_start))
+            {
+              ranges.back().second += value_block;
+            }
+          else
+            {
+              ranges.push_back(make_pair(value_start, value_block));
+            }
+        }
+
+      T dummy;
+      hid_t ftype = infer_datatype(dummy);
+      throw_assert(ftype >= 0, "compact_cell_attributes: error in infer_datatype");
+      hid_t ntype = H5Tget_native_type(ftype, H5T_DIR_ASCEND);
+      throw_assert(ntype >= 0, "compact_cell_attributes: error in H5Tget_native_type");
+
+      vector<T> file_values(num_values);
+      hid_t rapl = hdf5::read_transfer_plist(comm);
+      throw_assert(hdf5::read_selection<T>(file, path + "/" + hdf5::ATTR_VAL, ntype,
+                                           ranges, file_values, rapl) >= 0,
+                   "compact_cell_attributes: error reading values of " << path);
+      throw_assert(H5Pclose(rapl) >= 0, "compact_cell_attributes: error in H5Pclose");
+      throw_assert(H5Tclose(ntype) >= 0, "compact_cell_attributes: error in H5Tclose");
+
+      vector<CELL_IDX_T> compact_index;
+      vector<ATTR_PTR_T> compact_ptr;
+      vector<T> compact_values;
+      compact_index.reserve(end - start);
+      compact_ptr.reserve(end - start + 1);
+      compact_values.reserve(num_values);
+      for (size_t i = start; i < end; i++)
+        {
+          const size_t pos = positions[i];
+          const ATTR_PTR_T offset = value_offsets[i - start];
+          compact_index.push_back(index[pos]);
+          compact_ptr.push_back(compact_values.size());
+          compact_values.insert(compact_values.end(),
+                                file_values.begin() + offset,
+                                file_values.begin() + offset + (ptr[pos+1] - ptr[pos]));
+        }
+      compact_ptr.push_back(compact_values.size());
+
+      hdf5::write_cell_attribute<T>(comm, file, compact_path,
+                                    compact_index, compact_ptr, compact_values,
+                                    IndexOwner, CellPtr(PtrOwner));
+
+      trace.add_items(compact_index.size());
+      trace.add_bytes(compact_values.size() * sizeof(T));
+    }
+
+
+    void compact_cell_attributes
+    (
+     MPI_Comm      comm,
+     const string& file_name,
+     const string& name_space,
+     const string& pop_name,
+     const size_t  chunk_bytes,
+     const size_t  cache_size
+     )
+    {
+      mpi::trace_scope trace_total("compact_cell_attributes");
+      herr_t status;
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      // the cell indices are kept relative to the population start
+      vector< tuple<string,AttrKind,vector<CELL_IDX_T>,vector<ATTR_PTR_T> > > attr_info;
+      if (rank == 0)
+        {
+          status = get_cell_attribute_index_ptr (file_name, name_space, pop_name, 0, attr_info);
+          throw_assert(status >= 0,
+                       "compact_cell_attributes: error in get_cell_attribute_index_ptr");
+        }
+      {
+        vector<char> sendbuf; size_t sendbuf_size=0;
+        if (rank == 0)
+          {
+            data::serialize_data(attr_info, sendbuf);
+            sendbuf_size = sendbuf.size();
+          }
+
+        throw_assert(MPI_Bcast(&sendbuf_size, 1, MPI_SIZE_T, 0, comm) == MPI_SUCCESS,
+                     "compact_cell_attributes: error in MPI_Bcast");
+        sendbuf.resize(sendbuf_size);
+        throw_assert(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS,
+                     "compact_cell_attributes: error in MPI_Bcast");
+
+        if (rank != 0)
+          {
+            data::deserialize_data(sendbuf, attr_info);
+          }
+      }
+      throw_assert(attr_info.size() > 0,
+                   "compact_cell_attributes: namespace " << name_space <<
+                   " of population " << pop_name << " has no attributes");
+
+      vector< vector<size_t> > attr_positions(attr_info.size());
+      for (size_t i=0; i<attr_info.size(); i++)
+        {
+          const vector<CELL_IDX_T>& index = get<2>(attr_info[i]);
+          const vector<ATTR_PTR_T>& ptr   = get<3>(attr_info[i]);
+          throw_assert((index.size() == 0) || (ptr.size() == index.size()+1),
+                       "compact_cell_attributes: attribute " << get<0>(attr_info[i]) <<
+                       " has no attribute pointer for each cell");
+          compact_cell_index(index, attr_positions[i]);
+        }
+
+      const string compact_name_space = name_space + compact_suffix;
+      const string attr_prefix = hdf5::cell_attribute_prefix(name_space, pop_name);
+      const string compact_attr_prefix = hdf5::cell_attribute_prefix(compact_name_space, pop_name);
+
+      // create the compacted datasets
+      if (rank == 0)
+        {
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+          throw_assert(file >= 0,
+                       "compact_cell_attributes: unable to open file " << file_name);
+
+          // left over from an interrupted compaction
+          if (hdf5::exists_dataset (file, compact_attr_prefix) > 0)
+            {
+              throw_assert(H5Ldelete(file, compact_attr_prefix.c_str(), H5P_DEFAULT) >= 0,
+                           "compact_cell_attributes: unable to remove " << compact_attr_prefix);
+            }
+
+          for (size_t i=0; i<attr_info.size(); i++)
+            {
+              const string& attr_name = get<0>(attr_info[i]);
+              const vector<size_t>& positions = attr_positions[i];
+              const vector<ATTR_PTR_T>& ptr = get<3>(attr_info[i]);
+
+              const string value_path = hdf5::cell_attribute_path(name_space, pop_name, attr_name) +
+                "/" + hdf5::ATTR_VAL;
+              hid_t dset = H5Dopen2(file, value_path.c_str(), H5P_DEFAULT);
+              throw_assert(dset >= 0,
+                           "compact_cell_attributes: unable to open dataset " << value_path);
+              hid_t ftype = H5Dget_type(dset);
+              throw_assert(ftype >= 0, "compact_cell_attributes: error in H5Dget_type");
+              throw_assert(H5Dclose(dset) >= 0, "compact_cell_attributes: error in H5Dclose");
+
+              size_t num_values = 0;
+              for (const size_t pos : positions)
+                {
+                  num_values += ptr[pos+1] - ptr[pos];
+                }
+
+              create_cell_attribute_datasets(file, compact_name_space, pop_name, attr_name,
+                                             ftype, IndexOwner, CellPtr(PtrOwner),
+                                             compact_chunk_size(positions.size()+1, sizeof(ATTR_PTR_T),
+                                                                chunk_bytes),
+                                             compact_chunk_size(num_values, H5Tget_size(ftype),
+                                                                chunk_bytes));
+              throw_assert(H5Tclose(ftype) >= 0, "compact_cell_attributes: error in H5Tclose");
+            }
+
+          throw_assert(H5Fclose(file) >= 0,
+                       "compact_cell_attributes: unable to close file " << file_name);
+        }
+      throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                   "compact_cell_attributes: error in MPI_Barrier");
+
+      hid_t file = hdf5::open_file(comm, file_name, true, true, cache_size);
+      for (size_t i=0; i<attr_info.size(); i++)
+        {
+          if (attr_positions[i].size() == 0)
+            {
+              continue;
+            }
+
+          const string& attr_name = get<0>(attr_info[i]);
+          const AttrKind attr_kind = get<1>(attr_info[i]);
+          const size_t attr_size = attr_kind.size;
+          const vector<CELL_IDX_T>& index = get<2>(attr_info[i]);
+          const vector<ATTR_PTR_T>& ptr = get<3>(attr_info[i]);
+          const string path = hdf5::cell_attribute_path(name_space, pop_name, attr_name);
+          const string compact_path = hdf5::cell_attribute_path(compact_name_space, pop_name, attr_name);
+
+          switch (attr_kind.type)
+            {
+            case UIntVal:
+              if (attr_size == 4)
+                {
+                  compact_cell_attribute<uint32_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else if (attr_size == 2)
+                {
+                  compact_cell_attribute<uint16_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else if (attr_size == 1)
+                {
+                  compact_cell_attribute<uint8_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else
+                {
+                  throw runtime_error("Unsupported integer attribute size");
+                }
+              break;
+            case SIntVal:
+              if (attr_size == 4)
+                {
+                  compact_cell_attribute<int32_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else if (attr_size == 2)
+                {
+                  compact_cell_attribute<int16_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else if (attr_size == 1)
+                {
+                  compact_cell_attribute<int8_t>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+                }
+              else
+                {
+                  throw runtime_error("Unsupported integer attribute size");
+                }
+              break;
+            case FloatVal:
+              compact_cell_attribute<float>(comm, file, path, compact_path, index, ptr, attr_positions[i]);
+              break;
+            default:
+              throw runtime_error("Unsupported attribute type");
+              break;
+            }
+        }
+      throw_assert(hdf5::close_file(file) >= 0,
+                   "compact_cell_attributes: unable to close file " << file_name);
+      throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                   "compact_cell_attributes: error in MPI_Barrier");
+
+      // replace the original namespace
+      if (rank == 0)
+        {
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+          throw_assert(file >= 0,
+                       "compact_cell_attributes: unable to open file " << file_name);
+          throw_assert(H5Ldelete(file, attr_prefix.c_str(), H5P_DEFAULT) >= 0,
+                       "compact_cell_attributes: unable to remove " << attr_prefix);
+          throw_assert(H5Lmove(file, compact_attr_prefix.c_str(), file, attr_prefix.c_str(),
+                               H5P_DEFAULT, H5P_DEFAULT) >= 0,
+                       "compact_cell_attributes: unable to rename " << compact_attr_prefix);
+          throw_assert(hdf5::set_group_flag(file, attr_prefix, hdf5::SORTED) >= 0,
+                       "compact_cell_attributes: unable to set sorted flag of " << attr_prefix);
+          throw_assert(H5Fclose(file) >= 0,
+                       "compact_cell_attributes: unable to close file " << file_name);
+        }
+      throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                   "compact_cell_attributes: error in MPI_Barrier");
+    }
+
+  }
+}
@@ -4,337 +4,232 @@
 ///
 ///  Tree contraction routine.
 ///
-///  Copyright (C) 2016-2019 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 
 #include "debug.hh"
 
 #include <cstdio>
-#include <set>
-#include <map>
 #include <vector>
 #include <deque>
-#include "ngraph.hh"
 
 #include "neuroh5_types.hh"
+#include "contract_tree.hh"
+#include "throw_assert.hh"
 
 using namespace std;
-using namespace NGraph;
 
 namespace neuroh5
 {
   namespace cell
   {
-  
-    void contract_tree_bfs (const Graph &A,
-                            const deque<SWC_TYPE_T>& types, 
-                            Graph::vertex_set& roots,
-                            Graph &S, contraction_map_t& contraction_map,
-                            Graph::vertex sp, Graph::vertex spp)
+
+    /*
+     * Sections are built by a depth-first walk over the points. Each
+     * walk starts a new section at a point, unless the parent section
+     * has only a single point, in which case that section is extended
+     * instead. The walk follows single children until it reaches a
+     * terminal point, a branch point, or a change of type or region.
+     * At a branch point, a walk is started for each child; at a type
+     * or region change, a walk is started at the changed point. A
+     * terminal section with a single point is prefixed with the parent
+     * point, so that every section has at least two points.
+     *
+     * Walks are kept on an explicit stack and children are visited in
+     * increasing id order. A section is only ever extended while it
+     * is the most recently created section, so section members can be
+     * stored contiguously.
+     */
+    void contract_tree (const deque<PARENT_NODE_IDX_T>& parents,
+                        const deque<SWC_TYPE_T>& types,
+                        const deque<LAYER_IDX_T>* regions,
+                        const NODE_IDX_T node_base,
+                        deque<SECTION_IDX_T>& src_vector,
+                        deque<SECTION_IDX_T>& dst_vector,
+                        deque<SECTION_IDX_T>& sec_vector,
+                        tree_workspace_t& ws)
     {
-    
-      for ( Graph::vertex_set::const_iterator p = roots.begin(); p != roots.end(); ++p)
+      const size_t num_nodes = parents.size();
+      throw_assert(types.size() == num_nodes,
+                   "contract_tree: mismatch between number of points and number of types");
+      throw_assert((regions == NULL) || (regions->size() == num_nodes),
+                   "contract_tree: mismatch between number of points and number of regions");
+
+      // Children of each point, by counting sort on the parent index;
+      // children end up in increasing order
+      ws.child_ptr.assign(num_nodes+1, 0);
+      ws.children.resize(num_nodes);
+      ws.roots.clear();
+      for (size_t i=0; i<num_nodes; i++)
         {
-          deque <Graph::vertex> section_members; 
-          Graph::vertex s, v = Graph::node (p); 
-          LAYER_IDX_T p_type = types[v];
-                                     
-          if (contraction_map[sp].size() > 1)
+          const PARENT_NODE_IDX_T parent = parents[i];
+          if (parent < 0)
             {
-              // creates an entry in the section map for this node
-              section_members.push_back(v);
-              // creates a new section node in the contraction map
-              s = contraction_map.size();
-              // insert new entry into contraction map
-              // (key is section node, values is the set of nodes that are section members)
-              contraction_map.insert(make_pair(s,section_members));
-            
-              // creates an entry in the section graph
-              S.insert_vertex(s);
-            
-              // adds an edge from parent section to new section
-              S.insert_edge(sp,s);
+              ws.roots.push_back(i);
             }
           else
             {
-              s = sp;
-              contraction_map[s].push_back(v);
-            }
-        
-          // identifies the node neighbors
-          Graph::vertex_set outs = A.out_neighbors(v);
-          bool type_change = false;
-        
-          while ((outs.size() == 1) && (!(type_change)))
-            {
-              v = Graph::node(outs.cbegin());
-              if (types[v] != p_type)
-                {
-                  type_change = true;
-                }
-              else
-                {
-                  // adds the output node to the section map for the current section
-                  contraction_map[s].push_back(v);
-                  // obtains the neighbors of the next node
-                  outs = A.out_neighbors(v);
-                }
-            }
-          // if node is terminal, insert parent to ensure section has more than one node
-          if ((outs.size() == 0) && (contraction_map[s].size() == 1))
-            {
-              if (spp != v)
-                contraction_map[s].insert (contraction_map[s].begin(), spp);
-            }
-        
-          // if the node is a branching point or region change point, recurse to create new section entry
-          if ((outs.size() > 1) || type_change)
-            {
-              contract_tree_bfs(A, types, outs, S, contraction_map, s, v);
+              const size_t p = (size_t)parent - node_base;
+              throw_assert(((NODE_IDX_T)parent >= node_base) && (p < num_nodes) && (p != i),
+                           "contract_tree: invalid parent " << parent << " of point " << node_base+i);
+              ws.child_ptr[p+1]++;
             }
         }
+      for (size_t i=0; i<num_nodes; i++)
+        {
+          ws.child_ptr[i+1] += ws.child_ptr[i];
+        }
+      {
+        // child_ptr[p] is used as the insertion cursor for p and ends
+        // up as the end of its children; shift back afterwards
+        for (size_t i=0; i<num_nodes; i++)
+          {
+            const PARENT_NODE_IDX_T parent = parents[i];
+            if (parent >= 0)
+              {
+                const size_t p = (size_t)parent - node_base;
+                ws.children[ws.child_ptr[p]++] = i;
+              }
+          }
+        for (size_t i=num_nodes; i>0; i--)
+          {
+            ws.child_ptr[i] = ws.child_ptr[i-1];
+          }
+        ws.child_ptr[0] = 0;
+      }
+
+      ws.section_ptr.clear();
+      ws.section_nodes.clear();
+      ws.edge_src.clear();
+      ws.edge_dst.clear();
+      ws.stack.clear();
+
+      if (ws.roots.size() > 0)
+        {
+          // section 0 exists from the start, and is extended by the first root
+          ws.section_ptr.push_back(0);
+        }
 
-    }
+      for (size_t r=ws.roots.size(); r>0; r--)
+        {
+          tree_workspace_t::frame_t f = { ws.roots[r-1], 0, 0 };
+          ws.stack.push_back(f);
+        }
 
-    void contract_tree_dfs (const Graph &A, 
-                            const deque<SWC_TYPE_T>& types, 
-                            Graph::vertex_set& roots,
-                            Graph &S, contraction_map_t& contraction_map,
-                            Graph::vertex sp, Graph::vertex spp)
-    {
-      for ( Graph::vertex_set::const_iterator p = roots.begin(); p != roots.end(); ++p)
+      while (!ws.stack.empty())
         {
-          deque <Graph::vertex> section_members; 
-          Graph::vertex s, v = Graph::node (p); 
-          SWC_TYPE_T p_type = types[v];
+          const tree_workspace_t::frame_t f = ws.stack.back();
+          ws.stack.pop_back();
+
+          size_t v = f.node;
+          const SWC_TYPE_T p_type = types[v];
+          const LAYER_IDX_T p_region = (regions != NULL) ? (*regions)[v] : 0;
 
-          
-          if (contraction_map[sp].size() > 1)
+          size_t s;
+          const size_t num_sections = ws.section_ptr.size();
+          const size_t sp_size =
+            ((f.parent_section+1 < num_sections) ? ws.section_ptr[f.parent_section+1] : ws.section_nodes.size())
+            - ws.section_ptr[f.parent_section];
+          if (sp_size > 1)
             {
-              // creates an entry in the section map for this node
-              section_members.push_back(v);
-              // creates a new section node in the contraction map
-              s = contraction_map.size();
-              // insert new entry into contraction map
-              // (key is section node, values is the set of nodes that are section members)
-              contraction_map.insert(make_pair(s,section_members));
-            
-              // creates an entry in the section graph
-              S.insert_vertex(s);
-            
-              // adds an edge from parent section to new section
-              S.insert_edge(sp,s);
+              s = num_sections;
+              ws.section_ptr.push_back(ws.section_nodes.size());
+              ws.edge_src.push_back(f.parent_section);
+              ws.edge_dst.push_back(s);
             }
           else
             {
-              s = sp;
-              contraction_map[s].push_back(v);
+              s = f.parent_section;
+              throw_assert_nomsg(s+1 == num_sections);
             }
+          ws.section_nodes.push_back(node_base + v);
 
-          // identifies the node neighbors
-          Graph::vertex_set outs = A.out_neighbors(v);
-          bool type_change = false;
-
-          while ((outs.size() == 1) && (!(type_change)))
+          bool change = false;
+          while (ws.child_ptr[v+1] - ws.child_ptr[v] == 1)
             {
-              v = Graph::node(outs.cbegin());
-              if (types[v] != p_type)
-                {
-                  type_change = true;
-                }
-              else
+              const size_t c = ws.children[ws.child_ptr[v]];
+              v = c;
+              if (((regions != NULL) && ((*regions)[c] != p_region)) || (types[c] != p_type))
                 {
-                  // adds the output node to the section map for the current section
-                  contraction_map[s].push_back(v);
-                  // obtains the neighbors of the next node
-                  outs = A.out_neighbors(v);
+                  change = true;
+                  break;
                 }
+              ws.section_nodes.push_back(node_base + c);
             }
 
-          // if node is terminal, insert parent to ensure section has more than one node
-          if ((outs.size() == 0) && (contraction_map[s].size() == 1))
-            {
-              if (spp != v)
-                contraction_map[s].insert (contraction_map[s].begin(), spp);
-            }
-          
-          // if the node is a branching point, recurse to create new section entry
-          if ((outs.size() > 1) || type_change)
+          const NODE_IDX_T v_id = node_base + v;
+          if (change)
             {
-              for ( Graph::vertex_set::const_iterator out = outs.cbegin(); out != outs.cend(); ++out)
-                {
-                  Graph::vertex_set new_root;
-                  new_root.insert(Graph::node(out));
-                  contract_tree_dfs(A, types, new_root, S, contraction_map, s, v);
-                }
+              tree_workspace_t::frame_t g = { v, s, v_id };
+              ws.stack.push_back(g);
+              continue;
             }
-        }
-
-    }
 
-    void contract_tree_regions_bfs (const Graph &A,
-                                    const deque<LAYER_IDX_T>& regions,
-                                    const deque<SWC_TYPE_T>& types, 
-                                    Graph::vertex_set& roots,
-                                    Graph &S, contraction_map_t& contraction_map,
-                                    Graph::vertex sp, Graph::vertex spp)
-    {
-    
-      for ( Graph::vertex_set::const_iterator p = roots.begin(); p != roots.end(); ++p)
-        {
-        
-          deque <Graph::vertex> section_members; 
-          Graph::vertex s, v = Graph::node (p); 
-          LAYER_IDX_T p_region = regions[v];
-          SWC_TYPE_T p_type = types[v];
-                                     
-          if (contraction_map[sp].size() > 1)
-            {
-              // creates an entry in the section map for this node
-              section_members.push_back(v);
-              // creates a new section node in the contraction map
-              s = contraction_map.size();
-              // insert new entry into contraction map
-              // (key is section node, values is the set of nodes that are section members)
-              contraction_map.insert(make_pair(s,section_members));
-            
-              // creates an entry in the section graph
-              S.insert_vertex(s);
-            
-              // adds an edge from parent section to new section
-              S.insert_edge(sp,s);
-            }
-          else
+          const size_t num_children = ws.child_ptr[v+1] - ws.child_ptr[v];
+          if ((num_children == 0) &&
+              (ws.section_nodes.size() - ws.section_ptr[s] == 1) &&
+              (f.parent_node != v_id))
             {
-              s = sp;
-              contraction_map[s].push_back(v);
-            }
-        
-          // identifies the node neighbors
-          Graph::vertex_set outs = A.out_neighbors(v);
-          bool region_change = false;
-          bool type_change = false;
-        
-          while ((outs.size() == 1) && (!(region_change || type_change)))
-            {
-              // adds the output node to the section map for the current section
-              v = Graph::node(outs.cbegin());
-              if (regions[v] != p_region)
-                {
-                  region_change = true;
-                }
-              else if (types[v] != p_type)
-                {
-                  type_change = true;
-                }
-              else
-                {
-                  contraction_map[s].push_back(v);
-                  // obtains the neighbors of the next node
-                  outs = A.out_neighbors(v);
-                }
+              // terminal section with a single point: prefix the parent
+              ws.section_nodes.back() = f.parent_node;
+              ws.section_nodes.push_back(v_id);
             }
 
-          // if node is terminal, insert parent to ensure section has more than one node
-          if ((outs.size() == 0) && (contraction_map[s].size() == 1))
-            {
-              if (spp != v)
-                contraction_map[s].insert (contraction_map[s].begin(), spp);
-            }
-        
-          // if the node is a branching point or region change point, recurse to create new section entry
-          if ((outs.size() > 1) || region_change || type_change)
+          for (size_t k=ws.child_ptr[v+1]; k>ws.child_ptr[v]; k--)
             {
-              contract_tree_regions_bfs(A, regions, types, outs, S, contraction_map, s, v);
+              tree_workspace_t::frame_t g = { ws.children[k-1], s, v_id };
+              ws.stack.push_back(g);
             }
         }
 
-    }
+      const size_t num_sections = ws.section_ptr.size();
+      ws.section_ptr.push_back(ws.section_nodes.size());
 
-    void contract_tree_regions_dfs (const Graph &A,
-                                    const deque<LAYER_IDX_T>& regions,
-                                    const deque<SWC_TYPE_T>& types, 
-                                    Graph::vertex_set& roots,
-                                    Graph &S, contraction_map_t& contraction_map,
-                                    Graph::vertex sp, Graph::vertex spp)
-    {
-    
-      for ( Graph::vertex_set::const_iterator p = roots.begin(); p != roots.end(); ++p)
+      sec_vector.push_back(num_sections);
+      for (size_t s=0; s<num_sections; s++)
         {
-          deque <Graph::vertex> section_members; 
-          Graph::vertex s, v = Graph::node (p); 
-          LAYER_IDX_T p_region = regions[v];
-          SWC_TYPE_T p_type = types[v];
-
-          if (contraction_map[sp].size() > 1)
-            {
-              //if (spp != v) section_members.push_back(spp);
-              // creates an entry in the section map for this node
-              section_members.push_back(v);
-              // creates a new section node in the contraction map
-              s = contraction_map.size();
-              // insert new entry into contraction map
-              // (key is section node, values is the set of nodes that are section members)
-              contraction_map.insert(make_pair(s,section_members));
-            
-              // creates an entry in the section graph
-              S.insert_vertex(s);
-            
-              // adds an edge from parent section to new section
-              S.insert_edge(sp,s);
-            }
-          else
-            {
-              s = sp;
-              contraction_map[s].push_back(v);
-            }
-
-          // identifies the node neighbors
-          Graph::vertex_set outs = A.out_neighbors(v);
-          bool region_change = false;
-          bool type_change = false;
-        
-          while ((outs.size() == 1) && (!(region_change || type_change)))
-            {
-              // adds the output node to the section map for the current section
-              v = Graph::node(outs.cbegin());
-              if (regions[v] != p_region)
-                {
-                  region_change = true;
-                }
-              else if (types[v] != p_type)
-                {
-                  type_change = true;
-                }
-              else
-                {
-                  contraction_map[s].push_back(v);
-                  // obtains the neighbors of the next node
-                  outs = A.out_neighbors(v);
-                }
-            }
-
-          // if node is terminal, insert parent to ensure section has more than one node
-          if ((outs.size() == 0) && (contraction_map[s].size() == 1))
-            {
-              if (spp != v)
-                contraction_map[s].insert (contraction_map[s].begin(), spp);
-            }
+          sec_vector.push_back(ws.section_ptr[s+1] - ws.section_ptr[s]);
+          sec_vector.insert(sec_vector.end(),
+                            ws.section_nodes.begin() + ws.section_ptr[s],
+                            ws.section_nodes.begin() + ws.section_ptr[s+1]);
+        }
 
-          // if the node is a branching point, recurse to create new section entry
-          if ((outs.size() > 1) || region_change || type_change)
-            {
-              for ( Graph::vertex_set::const_iterator out = outs.begin(); out != outs.end(); ++out)
-                {
-                  Graph::vertex_set new_root;
-                  new_root.insert(*out);
-                  contract_tree_regions_dfs(A, regions, types, new_root, S, contraction_map, s, v);
-                }
-            }
+      // Section edges ordered by source; destinations are already
+      // increasing, so a stable counting sort by source suffices
+      const size_t num_edges = ws.edge_src.size();
+      ws.edge_ptr.assign(num_sections+1, 0);
+      for (size_t e=0; e<num_edges; e++)
+        {
+          ws.edge_ptr[ws.edge_src[e]+1]++;
         }
+      for (size_t s=0; s<num_sections; s++)
+        {
+          ws.edge_ptr[s+1] += ws.edge_ptr[s];
+        }
+      const size_t src_offset = src_vector.size(), dst_offset = dst_vector.size();
+      src_vector.resize(src_offset + num_edges);
+      dst_vector.resize(dst_offset + num_edges);
+      for (size_t e=0; e<num_edges; e++)
+        {
+          const size_t pos = ws.edge_ptr[ws.edge_src[e]]++;
+          src_vector[src_offset + pos] = ws.edge_src[e];
+          dst_vector[dst_offset + pos] = ws.edge_dst[e];
+        }
+    }
 
+    void contract_tree (const deque<PARENT_NODE_IDX_T>& parents,
+                        const deque<SWC_TYPE_T>& types,
+                        const deque<LAYER_IDX_T>* regions,
+                        const NODE_IDX_T node_base,
+                        deque<SECTION_IDX_T>& src_vector,
+                        deque<SECTION_IDX_T>& dst_vector,
+                        deque<SECTION_IDX_T>& sec_vector)
+    {
+      tree_workspace_t ws;
+      contract_tree(parents, types, regions, node_base,
+                    src_vector, dst_vector, sec_vector, ws);
     }
 
   }
-  
+
 }
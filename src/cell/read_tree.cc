@@ -4,60 +4,360 @@
 ///
 ///  Read tree structures.
 ///
-///  Copyright (C) 2016-2021 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 
 #include <mpi.h>
 #include <hdf5.h>
 
 #include <vector>
+#include <algorithm>
 #include <set>
 #include <forward_list>
 
 #include "neuroh5_types.hh"
+#include "read_tree.hh"
+#include "tree_batch.hh"
+#include "tree_template_set.hh"
 #include "cell_attributes.hh"
-#include "attr_map.hh"
+#include "hdf5_cell_attributes.hh"
+#include "file_access.hh"
+#include "path_names.hh"
+#include "serialize_data.hh"
+#include "mpi_trace.hh"
 #include "throw_assert.hh"
 
+using namespace std;
+
 namespace neuroh5
 {
 
   namespace cell
   {
 
-    void append_tree_list (const CELL_IDX_T pop_start,
-                           data::NamedAttrMap&       attr_values,
-                           std::forward_list<neurotree_t>& tree_list)
+    typedef vector< tuple<string,AttrKind,vector<CELL_IDX_T>,vector<ATTR_PTR_T> > > tree_attr_info_t;
+
+    /// Reads a contiguous range of trees.
+    struct tree_range_reader
+    {
+      size_t offset, numitems;
+
+      template <class T>
+      void operator() (MPI_Comm comm, hid_t file, const string& path, const CELL_IDX_T pop_start,
+                       const vector<CELL_IDX_T>& index, const vector<ATTR_PTR_T>& ptr,
+                       vector<CELL_IDX_T>& value_index, vector<ATTR_PTR_T>& value_ptr,
+                       vector<T>& values) const
+      {
+        hdf5::read_cell_attribute(comm, file, path, pop_start, index, ptr,
+                                  value_index, value_ptr, values,
+                                  offset, numitems);
+      }
+    };
+
+    /// Reads a selection of trees.
+    struct tree_selection_reader
+    {
+      const vector<CELL_IDX_T>& selection;
+
+      template <class T>
+      void operator() (MPI_Comm comm, hid_t file, const string& path, const CELL_IDX_T pop_start,
+                       const vector<CELL_IDX_T>& index, const vector<ATTR_PTR_T>& ptr,
+                       vector<CELL_IDX_T>& value_index, vector<ATTR_PTR_T>& value_ptr,
+                       vector<T>& values) const
+      {
+        hdf5::read_cell_attribute_selection(comm, file, path, pop_start, selection,
+                                            index, ptr, value_index, value_ptr, values);
+      }
+    };
+
+    /// Reads one Trees attribute into a batch column. The first column
+    /// read for a given pointer array sets the pointer; subsequent
+    /// columns must agree with it.
+    template <class T, class Reader>
+    void read_tree_column (MPI_Comm comm, hid_t file, const string& name_space,
+                           const string& pop_name, const CELL_IDX_T pop_start,
+                           const tree_attr_info_t& attr_info, const string& attr_name,
+                           const Reader& reader,
+                           vector<CELL_IDX_T>& index, vector<ATTR_PTR_T>& ptr,
+                           bool first, vector<T>& values)
+    {
+      size_t attr_pos = attr_info.size();
+      for (size_t i=0; i<attr_info.size(); i++)
+        {
+          if (get<0>(attr_info[i]) == attr_name)
+            {
+              attr_pos = i;
+              break;
+            }
+        }
+      throw_assert(attr_pos < attr_info.size(),
+                   "read_trees: attribute " << attr_name << " not found in population " << pop_name);
+      throw_assert(get<1>(attr_info[attr_pos]).size == sizeof(T),
+                   "read_trees: unexpected size of attribute " << attr_name);
+
+      const string attr_path = hdf5::cell_attribute_path (name_space, pop_name, attr_name);
+
+      vector<CELL_IDX_T> value_index;
+      vector<ATTR_PTR_T> value_ptr;
+      values.clear();
+      reader(comm, file, attr_path, pop_start,
+             get<2>(attr_info[attr_pos]), get<3>(attr_info[attr_pos]),
+             value_index, value_ptr, values);
+
+      if (value_ptr.size() == 0)
+        {
+          value_ptr.push_back(0);
+        }
+
+      if (first)
+        {
+          ptr.swap(value_ptr);
+          if (index.size() == 0)
+            {
+              index.swap(value_index);
+            }
+          else
+            {
+              throw_assert(index == value_index,
+                           "read_trees: index of attribute " << attr_name << " differs from other attributes");
+            }
+        }
+      else
+        {
+          throw_assert(index == value_index,
+                       "read_trees: index of attribute " << attr_name << " differs from other attributes");
+          throw_assert(ptr == value_ptr,
+                       "read_trees: pointer of attribute " << attr_name << " differs from other attributes");
+        }
+    }
+
+    /// Reads a batch column if its field is selected in the batch.
+    template <class T, class Reader>
+    void read_tree_field (MPI_Comm comm, hid_t file, const string& name_space,
+                          const string& pop_name, const CELL_IDX_T pop_start,
+                          const tree_attr_info_t& attr_info, const Reader& reader,
+                          data::TreeBatch& tree_batch, uint32_t field, const string& attr_name,
+                          vector<ATTR_PTR_T>& ptr, bool& ptr_read, vector<T>& values)
+    {
+      if (tree_batch.has(field))
+        {
+          read_tree_column(comm, file, name_space, pop_name, pop_start, attr_info, attr_name, reader,
+                           tree_batch.index, ptr, !ptr_read, values);
+          ptr_read = true;
+        }
+    }
+
+    /// Reads the attribute index and pointers of a namespace on rank 0
+    /// and broadcasts them to all ranks.
+    void bcast_tree_attr_info (MPI_Comm comm, const string& file_name,
+                               const string& name_space, const string& pop_name,
+                               const CELL_IDX_T& pop_start, tree_attr_info_t& attr_info)
+    {
+      int rank;
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      vector<char> sendbuf; size_t sendbuf_size=0;
+      if (rank == 0)
+        {
+          herr_t status = get_cell_attribute_index_ptr (file_name, name_space, pop_name, pop_start, attr_info);
+          throw_assert(status == 0,
+                       "read_trees: error in get_cell_attribute_index_ptr");
+          data::serialize_data(attr_info, sendbuf);
+          sendbuf_size = sendbuf.size();
+        }
+
+      throw_assert(MPI_Bcast(&sendbuf_size, 1, MPI_SIZE_T, 0, comm) == MPI_SUCCESS,
+                   "read_trees: error in MPI_Bcast");
+      sendbuf.resize(sendbuf_size);
+      throw_assert(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS,
+                   "read_trees: error in MPI_Bcast");
+
+      if (rank != 0)
+        {
+          data::deserialize_data(sendbuf, attr_info);
+        }
+    }
+
+    hid_t open_tree_file (MPI_Comm comm, const string& file_name, hid_t& fapl)
+    {
+      fapl = hdf5::read_access_plist(comm);
+      hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
+      throw_assert(file >= 0, "read_trees: unable to open file " << file_name);
+      return file;
+    }
+
+    void close_tree_file (hid_t file, hid_t fapl)
     {
-      
-      for (CELL_IDX_T idx : attr_values.index_set)
+      herr_t status = H5Fclose(file);
+      throw_assert_nomsg(status == 0);
+      status = H5Pclose(fapl);
+      throw_assert_nomsg(status == 0);
+    }
+
+    /// Reads trees stored in the Trees layout under the given namespace.
+    template <class Reader>
+    void read_tree_batch
+    (
+     MPI_Comm comm,
+     const string& file_name,
+     const string& name_space,
+     const string& pop_name,
+     const CELL_IDX_T& pop_start,
+     const Reader& reader,
+     const uint32_t fields,
+     tree_attr_info_t& attr_info,
+     data::TreeBatch& tree_batch
+     )
+    {
+      tree_batch.clear();
+      tree_batch.fields = fields;
+
+      bcast_tree_attr_info(comm, file_name, name_space, pop_name, pop_start, attr_info);
+
+      if (attr_info.size() == 0)
         {
-          const deque<SECTION_IDX_T>& src_vector = attr_values.find_name<SECTION_IDX_T>(hdf5::SRCSEC, idx);
-          const deque<SECTION_IDX_T>& dst_vector = attr_values.find_name<SECTION_IDX_T>(hdf5::DSTSEC, idx);
-
-          const deque<SECTION_IDX_T>& sections = attr_values.find_name<SECTION_IDX_T>(hdf5::SECTION, idx);
-        
-          const deque<COORD_T>& xcoords =  attr_values.find_name<COORD_T>(hdf5::X_COORD, idx);
-          const deque<COORD_T>& ycoords =  attr_values.find_name<COORD_T>(hdf5::Y_COORD, idx);
-          const deque<COORD_T>& zcoords =  attr_values.find_name<COORD_T>(hdf5::Z_COORD, idx);
-
-          const deque<REALVAL_T>& radiuses    =  attr_values.find_name<REALVAL_T>(hdf5::RADIUS, idx);
-          const deque<LAYER_IDX_T>& layers    =  attr_values.find_name<LAYER_IDX_T>(hdf5::LAYER, idx);
-          const deque<PARENT_NODE_IDX_T>& parents = attr_values.find_name<PARENT_NODE_IDX_T>(hdf5::PARENT, idx);
-          const deque<SWC_TYPE_T> swc_types   = attr_values.find_name<SWC_TYPE_T>(hdf5::SWCTYPE, idx);
-
-          CELL_IDX_T gid = idx;
-          tree_list.push_front(make_tuple(gid,
-                                          src_vector, dst_vector, sections,
-                                          xcoords,ycoords,zcoords,
-                                          radiuses,layers,parents,
-                                          swc_types));
+          return;
         }
+
+      hid_t fapl;
+      hid_t file = open_tree_file(comm, file_name, fapl);
+
+      vector<CELL_IDX_T>& index = tree_batch.index;
+
+      // a pointer array is taken from the first column read that uses it
+      bool attr_read = false, topo_read = false, sec_read = false;
+
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldX, hdf5::X_COORD, tree_batch.attr_ptr, attr_read, tree_batch.x);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldY, hdf5::Y_COORD, tree_batch.attr_ptr, attr_read, tree_batch.y);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldZ, hdf5::Z_COORD, tree_batch.attr_ptr, attr_read, tree_batch.z);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldRadius, hdf5::RADIUS, tree_batch.attr_ptr, attr_read, tree_batch.radius);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldLayer, hdf5::LAYER, tree_batch.attr_ptr, attr_read, tree_batch.layer);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldParent, hdf5::PARENT, tree_batch.attr_ptr, attr_read, tree_batch.parent);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldSWCType, hdf5::SWCTYPE, tree_batch.attr_ptr, attr_read, tree_batch.swc_type);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldSrc, hdf5::SRCSEC, tree_batch.topo_ptr, topo_read, tree_batch.src);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldDst, hdf5::DSTSEC, tree_batch.topo_ptr, topo_read, tree_batch.dst);
+      read_tree_field(comm, file, name_space, pop_name, pop_start, attr_info, reader, tree_batch,
+                      data::TreeFieldSections, hdf5::SECTION, tree_batch.sec_ptr, sec_read, tree_batch.sections);
+
+      // pointers of groups that were not read describe empty columns
+      if (!attr_read) tree_batch.attr_ptr.assign(index.size()+1, 0);
+      if (!topo_read) tree_batch.topo_ptr.assign(index.size()+1, 0);
+      if (!sec_read) tree_batch.sec_ptr.assign(index.size()+1, 0);
+
+      close_tree_file(file, fapl);
+
+      tree_batch.validate();
+    }
+
+
+    /// Reads the template references of the selected cells, and each
+    /// template referenced by them once. Cells that have a stored tree
+    /// (listed in tree_attr_info) are skipped, since stored trees take
+    /// precedence over templates.
+    template <class Reader>
+    void read_tree_template_set
+    (
+     MPI_Comm comm,
+     const string& file_name,
+     const string& pop_name,
+     const CELL_IDX_T& pop_start,
+     const Reader& reader,
+     const std::set<std::string>& tree_mask,
+     const tree_attr_info_t& tree_attr_info,
+     data::TreeTemplateSet& template_set
+     )
+    {
+      template_set.clear();
+
+      tree_attr_info_t attr_info;
+      bcast_tree_attr_info(comm, file_name, hdf5::TREE_TEMPLATE_INDEX, pop_name, pop_start, attr_info);
+
+      if (attr_info.size() == 0)
+        {
+          return;
+        }
+
+      bool has_offset = false;
+      for (auto const& info : attr_info)
+        {
+          if (get<0>(info) == hdf5::TEMPLATE_OFFSET)
+            {
+              has_offset = true;
+            }
+        }
+
+      hid_t fapl;
+      hid_t file = open_tree_file(comm, file_name, fapl);
+
+      vector<CELL_IDX_T> index;
+      vector<ATTR_PTR_T> ptr;
+      vector<CELL_IDX_T> template_ids;
+      read_tree_column(comm, file, hdf5::TREE_TEMPLATE_INDEX, pop_name, pop_start, attr_info,
+                       hdf5::TEMPLATE_ID, reader, index, ptr, true, template_ids);
+
+      map<CELL_IDX_T, size_t> offset_pos;
+      vector<COORD_T> offsets;
+      if (has_offset)
+        {
+          vector<CELL_IDX_T> offset_index;
+          vector<ATTR_PTR_T> offset_ptr;
+          read_tree_column(comm, file, hdf5::TREE_TEMPLATE_INDEX, pop_name, pop_start, attr_info,
+                           hdf5::TEMPLATE_OFFSET, reader, offset_index, offset_ptr, true, offsets);
+          for (size_t i=0; i<offset_index.size(); i++)
+            {
+              throw_assert(offset_ptr[i+1] - offset_ptr[i] == 3,
+                           "read_trees: template offset of cell " << offset_index[i] <<
+                           " must have three components");
+              offset_pos.insert(make_pair(offset_index[i], offset_ptr[i]));
+            }
+        }
+
+      close_tree_file(file, fapl);
+
+      set<CELL_IDX_T> stored;
+      if (tree_attr_info.size() > 0)
+        {
+          const vector<CELL_IDX_T>& stored_index = get<2>(tree_attr_info[0]);
+          stored.insert(stored_index.begin(), stored_index.end());
+        }
+
+      for (size_t i=0; i<index.size(); i++)
+        {
+          throw_assert(ptr[i+1] - ptr[i] == 1,
+                       "read_trees: cell " << index[i] << " must refer to exactly one template");
+          const CELL_IDX_T gid = index[i];
+          if (stored.find(gid) != stored.end())
+            {
+              continue;
+            }
+          auto it = offset_pos.find(gid);
+          if (it != offset_pos.end())
+            {
+              template_set.append_ref(gid, template_ids[ptr[i]],
+                                      offsets[it->second], offsets[it->second+1], offsets[it->second+2]);
+            }
+          else
+            {
+              template_set.append_ref(gid, template_ids[ptr[i]]);
+            }
+        }
+
+      // each referenced template is read once, regardless of the number
+      // of cells that refer to it
+      read_tree_templates(comm, file_name, pop_name, template_set.templates,
+                          template_set.template_index, tree_mask);
     }
 
-    
 
-  
     /*****************************************************************************
      * Load tree data structures from HDF5
      *****************************************************************************/
@@ -67,25 +367,58 @@ namespace neuroh5
      const std::string& file_name,
      const std::string& pop_name,
      const CELL_IDX_T& pop_start,
-     std::forward_list<neurotree_t> &tree_list,
-     size_t offset = 0,
-     size_t numitems = 0,
-     bool collective = true
+     data::TreeBatch &tree_batch,
+     data::TreeTemplateSet &template_set,
+     size_t offset,
+     size_t numitems,
+     const std::set<std::string>& tree_mask
      )
     {
-      unsigned int rank, size;
-      throw_assert_nomsg(MPI_Comm_size(comm, (int*)&size) == MPI_SUCCESS);
-      throw_assert_nomsg(MPI_Comm_rank(comm, (int*)&rank) == MPI_SUCCESS);
+      mpi::trace_scope trace_total("read_trees");
+      tree_range_reader reader = { offset, numitems };
+      tree_attr_info_t attr_info;
+      read_tree_batch(comm, file_name, hdf5::TREES, pop_name, pop_start, reader,
+                      data::tree_field_mask(tree_mask), attr_info, tree_batch);
+      read_tree_template_set(comm, file_name, pop_name, pop_start, reader, tree_mask,
+                             attr_info, template_set);
+      return 0;
+    }
 
-      data::NamedAttrMap attr_values;
-      set<string> attr_mask;
-      
-      read_cell_attributes (comm, file_name, hdf5::TREES, attr_mask,
-                            pop_name, pop_start, attr_values,
-                            offset, numitems);
+    int read_trees
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     size_t offset,
+     size_t numitems,
+     const std::set<std::string>& tree_mask
+     )
+    {
+      data::TreeTemplateSet template_set;
+      read_trees(comm, file_name, pop_name, pop_start, tree_batch, template_set,
+                 offset, numitems, tree_mask);
+      template_set.resolve(tree_batch);
+      return 0;
+    }
 
-      append_tree_list (pop_start, attr_values, tree_list);
-    
+    int read_trees
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     std::forward_list<neurotree_t> &tree_list,
+     size_t offset,
+     size_t numitems,
+     bool collective
+     )
+    {
+      data::TreeBatch tree_batch;
+      read_trees (comm, file_name, pop_name, pop_start, tree_batch,
+                  offset, numitems);
+      tree_batch.to_list(tree_list);
       return 0;
     }
 
@@ -93,6 +426,52 @@ namespace neuroh5
     /*****************************************************************************
      * Load tree data structures from HDF5
      *****************************************************************************/
+    int read_tree_selection
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     data::TreeTemplateSet &template_set,
+     const std::vector<CELL_IDX_T>&  selection,
+     const std::set<std::string>& tree_mask
+     )
+    {
+      mpi::trace_scope trace_total("read_tree_selection");
+      // each selected tree is read once
+      vector<CELL_IDX_T> unique_selection(selection);
+      sort(unique_selection.begin(), unique_selection.end());
+      unique_selection.erase(unique(unique_selection.begin(), unique_selection.end()),
+                             unique_selection.end());
+
+      tree_selection_reader reader = { unique_selection };
+      tree_attr_info_t attr_info;
+      read_tree_batch(comm, file_name, hdf5::TREES, pop_name, pop_start, reader,
+                      data::tree_field_mask(tree_mask), attr_info, tree_batch);
+      read_tree_template_set(comm, file_name, pop_name, pop_start, reader, tree_mask,
+                             attr_info, template_set);
+      return 0;
+    }
+
+    int read_tree_selection
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     data::TreeBatch &tree_batch,
+     const std::vector<CELL_IDX_T>&  selection,
+     const std::set<std::string>& tree_mask
+     )
+    {
+      data::TreeTemplateSet template_set;
+      read_tree_selection(comm, file_name, pop_name, pop_start, tree_batch, template_set,
+                          selection, tree_mask);
+      template_set.resolve(tree_batch);
+      return 0;
+    }
+
     int read_tree_selection
     (
      MPI_Comm comm,
@@ -103,16 +482,74 @@ namespace neuroh5
      const std::vector<CELL_IDX_T>&  selection
      )
     {
-      data::NamedAttrMap attr_values;
-      set<string> attr_mask;
-      
-      read_cell_attribute_selection (comm, file_name, hdf5::TREES, attr_mask,
-                                     pop_name, pop_start, 
-                                     selection, attr_values);
-      append_tree_list (pop_start, attr_values, tree_list);
-    
+      data::TreeBatch tree_batch;
+      read_tree_selection (comm, file_name, pop_name, pop_start, tree_batch, selection);
+      tree_batch.to_list(tree_list);
+      return 0;
+    }
+
+
+    /*****************************************************************************
+     * Load morphology templates from HDF5
+     *****************************************************************************/
+    int read_tree_templates
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     data::TreeBatch &template_batch,
+     const std::vector<CELL_IDX_T>&  template_selection,
+     const std::set<std::string>& tree_mask
+     )
+    {
+      vector<CELL_IDX_T> unique_selection(template_selection);
+      sort(unique_selection.begin(), unique_selection.end());
+      unique_selection.erase(unique(unique_selection.begin(), unique_selection.end()),
+                             unique_selection.end());
+
+      tree_selection_reader reader = { unique_selection };
+      tree_attr_info_t attr_info;
+      read_tree_batch(comm, file_name, hdf5::TREE_TEMPLATES, pop_name, 0, reader,
+                      data::tree_field_mask(tree_mask), attr_info, template_batch);
+      return 0;
+    }
+
+
+    /*****************************************************************************
+     * Determine the ids of all cells that have a tree
+     *****************************************************************************/
+    int read_tree_index
+    (
+     MPI_Comm comm,
+     const std::string& file_name,
+     const std::string& pop_name,
+     const CELL_IDX_T& pop_start,
+     std::vector<CELL_IDX_T>& tree_index
+     )
+    {
+      tree_attr_info_t tree_attr_info, template_attr_info;
+      bcast_tree_attr_info(comm, file_name, hdf5::TREES, pop_name, pop_start, tree_attr_info);
+      bcast_tree_attr_info(comm, file_name, hdf5::TREE_TEMPLATE_INDEX, pop_name, pop_start, template_attr_info);
+
+      tree_index.clear();
+      if (tree_attr_info.size() > 0)
+        {
+          const vector<CELL_IDX_T>& index = get<2>(tree_attr_info[0]);
+          tree_index.insert(tree_index.end(), index.begin(), index.end());
+        }
+      for (auto const& info : template_attr_info)
+        {
+          if (get<0>(info) == hdf5::TEMPLATE_ID)
+            {
+              const vector<CELL_IDX_T>& index = get<2>(info);
+              tree_index.insert(tree_index.end(), index.begin(), index.end());
+            }
+        }
+
+      sort(tree_index.begin(), tree_index.end());
+      tree_index.erase(unique(tree_index.begin(), tree_index.end()), tree_index.end());
       return 0;
     }
-    
+
   }
 }
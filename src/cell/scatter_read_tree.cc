@@ -4,30 +4,35 @@
 ///
 ///  Read and scatter tree structures.
 ///
-///  Copyright (C) 2016-2021 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 
 #include <mpi.h>
 #include <hdf5.h>
 
+#include <algorithm>
 #include <vector>
 #include <map>
 #include <set>
 
 #include "neuroh5_types.hh"
 #include "attr_map.hh"
+#include "tree_batch.hh"
+#include "tree_template_set.hh"
 #include "cell_attributes.hh"
-#include "rank_range.hh"
+#include "read_tree.hh"
+#include "scatter_read_tree.hh"
 #include "range_sample.hh"
-#include "append_tree_map.hh"
-#include "append_rank_tree_map.hh"
-#include "append_rank_attr_map.hh"
 #include "alltoallv_template.hh"
+#include "sample_sort.hh"
 #include "serialize_tree.hh"
-#include "serialize_cell_attributes.hh"
+#include "serialize_data.hh"
 #include "dataset_num_elements.hh"
 #include "path_names.hh"
-#include "read_template.hh"
+#include "memory_size.hh"
+#include "mpi_debug.hh"
+#include "mpi_memory.hh"
+#include "mpi_trace.hh"
 #include "throw_assert.hh"
 #include "debug.hh"
 
@@ -38,7 +43,200 @@ namespace neuroh5
 
   namespace cell
   {
-  
+
+    /*****************************************************************************
+     * Partitions a batch of trees by destination rank
+     *****************************************************************************/
+    void append_rank_tree_batch (const data::TreeBatch& tree_batch,
+                                 const node_rank_map_t& node_rank_map,
+                                 map <rank_t, data::TreeBatch> &rank_tree_batch)
+    {
+      for (size_t i=0; i<tree_batch.size(); i++)
+        {
+          const CELL_IDX_T gid = tree_batch.index[i];
+          auto it = node_rank_map.find(gid);
+          throw_assert(it != node_rank_map.end(),
+                       "append_rank_tree_batch: index " << gid << " not found in node rank map");
+
+          for (auto dst_rank : it->second)
+            {
+              rank_tree_batch[dst_rank].append(tree_batch, i);
+            }
+        }
+    }
+
+    /*****************************************************************************
+     * Sends the trees partitioned by the I/O ranks to their destination ranks
+     *****************************************************************************/
+    void exchange_tree_batch (MPI_Comm all_comm, const size_t size, const size_t rank,
+                              const map <rank_t, data::TreeBatch> &rank_tree_batch,
+                              data::TreeBatch &tree_batch)
+    {
+      if (size == 1)
+        {
+          // a single rank appends its trees without serializing them
+          for (auto const& it : rank_tree_batch)
+            {
+              tree_batch.append(it.second);
+            }
+          return;
+        }
+
+      vector<char> sendbuf;
+      vector<int> sendcounts(size,0), sdispls(size,0);
+      mpi::memory_scope sendbuf_memory("exchange_tree_batch.send_buffer");
+
+      if (rank_tree_batch.size() > 0)
+        {
+          {
+            mpi::trace_scope trace("exchange_tree_batch.serialize");
+            data::serialize_rank_tree_batch (size, rank, rank_tree_batch, sendcounts, sendbuf, sdispls);
+            trace.add_bytes(sendbuf.size());
+          }
+          sendbuf_memory.set(data::vector_bytes(sendbuf));
+        }
+
+      vector<int> recvcounts, rdispls;
+      vector<char> recvbuf;
+
+      throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
+                                                     recvcounts, rdispls, recvbuf) >= 0);
+      mpi::memory_scope recvbuf_memory("exchange_tree_batch.recv_buffer", data::vector_bytes(recvbuf));
+      sendbuf.clear();
+      sendbuf.shrink_to_fit();
+      sendbuf_memory.set(0);
+
+      if (recvbuf.size() > 0)
+        {
+          {
+            mpi::trace_scope trace("exchange_tree_batch.deserialize");
+            data::deserialize_rank_tree_batch (size, recvbuf, recvcounts, rdispls, tree_batch);
+            trace.add_bytes(recvbuf.size());
+          }
+        }
+    }
+
+
+    /*****************************************************************************
+     * Partitions a set of template references by destination rank; each
+     * destination receives only the templates its cells refer to
+     *****************************************************************************/
+    void append_rank_tree_template_set (const data::TreeTemplateSet& template_set,
+                                        const node_rank_map_t& node_rank_map,
+                                        map <rank_t, data::TreeTemplateSet> &rank_template_set)
+    {
+      for (size_t i=0; i<template_set.size(); i++)
+        {
+          const CELL_IDX_T gid = template_set.index[i];
+          auto it = node_rank_map.find(gid);
+          throw_assert(it != node_rank_map.end(),
+                       "append_rank_tree_template_set: index " << gid << " not found in node rank map");
+
+          for (auto dst_rank : it->second)
+            {
+              rank_template_set[dst_rank].append_ref(template_set, i);
+            }
+        }
+    }
+
+    /*****************************************************************************
+     * Sends template references to their destination ranks, where they
+     * are expanded and appended to tree_batch
+     *****************************************************************************/
+    void exchange_tree_template_set (MPI_Comm all_comm, const size_t size, const size_t rank,
+                                     const map <rank_t, data::TreeTemplateSet> &rank_template_set,
+                                     data::TreeBatch &tree_batch)
+    {
+      if (size == 1)
+        {
+          for (auto const& it : rank_template_set)
+            {
+              it.second.resolve(tree_batch);
+            }
+          return;
+        }
+
+      vector<char> sendbuf;
+      vector<int> sendcounts(size,0), sdispls(size,0);
+
+      for (size_t r=0; r<size; r++)
+        {
+          sdispls[r] = sendbuf.size();
+          auto it = rank_template_set.find(r);
+          if (it != rank_template_set.end())
+            {
+              data::serialize_data(it->second, sendbuf);
+            }
+          sendcounts[r] = sendbuf.size() - sdispls[r];
+        }
+
+      vector<int> recvcounts, rdispls;
+      vector<char> recvbuf;
+
+      throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
+                                                     recvcounts, rdispls, recvbuf) >= 0);
+      sendbuf.clear();
+      sendbuf.shrink_to_fit();
+
+      for (size_t r=0; r<size; r++)
+        {
+          if (recvcounts[r] > 0)
+            {
+              vector<char> rankbuf(recvbuf.begin() + rdispls[r],
+                                   recvbuf.begin() + rdispls[r] + recvcounts[r]);
+              data::TreeTemplateSet template_set;
+              data::deserialize_data(rankbuf, template_set);
+              template_set.resolve(tree_batch);
+            }
+        }
+    }
+
+
+    /*****************************************************************************
+     * Determines the number of cells of a population that are read by
+     * range, the larger of the number of stored trees and the number of
+     * template references, since read_trees applies the same range to
+     * both, and the number of bytes of their attributes
+     *****************************************************************************/
+    static void tree_read_size (MPI_Comm comm, const string& file_name, const string& pop_name,
+                                uint64_t& num_cells, uint64_t& data_bytes)
+    {
+      int rank;
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      vector<uint64_t> counts(2, 0);
+      if (rank == 0)
+        {
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+          throw_assert_nomsg(file >= 0);
+          for (const string& name_space : { hdf5::TREES, hdf5::TREE_TEMPLATE_INDEX })
+            {
+              vector< pair<string,AttrKind> > attr_info;
+              throw_assert_nomsg(get_cell_attributes(file_name, name_space, pop_name, attr_info) >= 0);
+
+              uint64_t num_name_space_cells = 0;
+              for (auto const& it : attr_info)
+                {
+                  const string attr_path = hdf5::cell_attribute_path(name_space, pop_name, it.first);
+                  const hsize_t num_ptrs = hdf5::dataset_num_elements(file, attr_path + "/" + hdf5::ATTR_PTR);
+                  if (num_name_space_cells == 0)
+                    {
+                      num_name_space_cells = hdf5::dataset_num_elements(file, attr_path + "/" + hdf5::CELL_INDEX);
+                    }
+                  counts[1] += num_ptrs * sizeof(ATTR_PTR_T) +
+                    hdf5::dataset_num_elements(file, attr_path + "/" + hdf5::ATTR_VAL) * it.second.size;
+                }
+              counts[0] = max(counts[0], num_name_space_cells);
+            }
+          throw_assert_nomsg(H5Fclose(file) >= 0);
+        }
+      throw_assert_nomsg(MPI_Bcast(&counts[0], counts.size(), MPI_UINT64_T, 0, comm) == MPI_SUCCESS);
+
+      num_cells  = counts[0];
+      data_bytes = counts[1];
+    }
+
+
     /*****************************************************************************
      * Load tree data structures from HDF5 and scatter to all ranks
      *****************************************************************************/
@@ -52,15 +250,14 @@ namespace neuroh5
      const node_rank_map_t           &node_rank_map,
      const string                    &pop_name,
      const CELL_IDX_T                 pop_start,
-     map<CELL_IDX_T, neurotree_t>    &tree_map,
+     data::TreeBatch                 &tree_batch,
      map<string, data::NamedAttrMap> &attr_maps,
      size_t offset,
-     size_t numitems
+     size_t numitems,
+     const set<string>               &tree_mask
      )
     {
-      std::vector<char> sendbuf; 
-      std::vector<int> sendcounts, sdispls;
-    
+      mpi::trace_scope trace_total("scatter_read_trees");
       MPI_Comm all_comm;
       // MPI Communicator for I/O ranks
       MPI_Comm io_comm;
@@ -71,8 +268,8 @@ namespace neuroh5
 
       throw_assert(MPI_Comm_dup(comm, &(all_comm)) == MPI_SUCCESS,
                    "scatter_read_tree: unable to duplicate MPI communicator");
-    
-      int srank, ssize; size_t rank=0, size=0, io_rank;
+
+      int srank, ssize; size_t rank=0, size=0;
       throw_assert_nomsg(MPI_Comm_size(all_comm, &ssize) == MPI_SUCCESS);
       throw_assert_nomsg(MPI_Comm_rank(all_comm, &srank) == MPI_SUCCESS);
       throw_assert_nomsg(srank >= 0);
@@ -80,8 +277,34 @@ namespace neuroh5
       rank = srank;
       size = ssize;
 
+      // With a memory budget, the I/O set is enlarged and the trees are
+      // read in rounds so that the I/O ranks, which hold the trees they
+      // read, the trees partitioned by rank and the send buffer at the
+      // same time, stay within the budget.
+      mpi::read_plan_t plan = { (size_t)io_size, 1 };
+      // the rounds split the range of cells read from both the Trees
+      // and the Tree Template Index namespaces
+      size_t num_read_cells = 0;
+      if (mpi::memory_budget() > 0)
+        {
+          uint64_t num_cells = 0, data_bytes = 0;
+          tree_read_size(all_comm, file_name, pop_name, num_cells, data_bytes);
+          if (offset < num_cells)
+            {
+              num_read_cells = num_cells - offset;
+              if (numitems > 0)
+                {
+                  num_read_cells = min(num_read_cells, numitems * size);
+                }
+              data_bytes = (uint64_t)((double)data_bytes * num_read_cells / num_cells);
+            }
+          plan = mpi::plan_read(data_bytes, num_read_cells, size, io_size, 3.0, 2.0);
+          mpi::MPI_DEBUG(all_comm, "scatter_read_trees: ", pop_name, ": reading ", num_read_cells,
+                         " cells with ", plan.io_size, " I/O ranks in ", plan.rounds, " rounds");
+        }
+
       set<size_t> io_rank_set;
-      data::range_sample(size, io_size, io_rank_set);
+      data::range_sample(size, plan.io_size, io_rank_set);
       bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
 
       // Am I an I/O rank?
@@ -90,69 +313,80 @@ namespace neuroh5
           throw_assert(MPI_Comm_split(all_comm,io_color,rank,&io_comm) == MPI_SUCCESS,
                        "scatter_read_trees: error in MPI_Comm_split");
           MPI_Comm_set_errhandler(io_comm, MPI_ERRORS_RETURN);
-          throw_assert_nomsg(MPI_Comm_rank(io_comm, &srank) == MPI_SUCCESS);
-          io_rank = srank;
         }
       else
         {
           MPI_Comm_split(all_comm,0,rank,&io_comm);
         }
-    
-      sendcounts.resize(size,0);
-      sdispls.resize(size,0);
-      sendbuf.resize(0);
 
 #ifdef NEUROH5_DEBUG
       throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
 #endif
 
-      if (is_io_rank)
+      // ranks that receive no trees still report the requested fields
+      if (tree_batch.empty())
         {
-          map <rank_t, map<CELL_IDX_T, neurotree_t> > rank_tree_map;
-          {
-            data::NamedAttrMap attr_values;
-            set <string> attr_mask;
-            
-            read_cell_attributes (io_comm, file_name, hdf5::TREES, attr_mask,
-                                  pop_name, pop_start, attr_values,
-                                  offset, numitems * size);
-
-            data::append_rank_tree_map(attr_values, node_rank_map, rank_tree_map);
-          }
-          data::serialize_rank_tree_map (size, rank, rank_tree_map, sendcounts, sendbuf, sdispls);
+          tree_batch.fields = data::tree_field_mask(tree_mask);
         }
 
+      mpi::memory_scope tree_batch_memory("scatter_read_trees.tree_batch");
+      const size_t round_cells = (plan.rounds > 1) ? (num_read_cells + plan.rounds - 1) / plan.rounds : 0;
+      for (size_t round = 0; round < plan.rounds; round++)
+        {
+          size_t round_offset = offset, round_numitems = numitems * size;
+          if (plan.rounds > 1)
+            {
+              round_offset   = offset + round * round_cells;
+              round_numitems = min(round_cells, num_read_cells - min(num_read_cells, round * round_cells));
+              if (round_numitems == 0)
+                {
+                  break;
+                }
+            }
+
+          map <rank_t, data::TreeBatch> rank_tree_batch;
+          map <rank_t, data::TreeTemplateSet> rank_template_set;
+          mpi::memory_scope rank_tree_batch_memory("scatter_read_trees.rank_tree_batch");
+          if (is_io_rank)
+            {
+              data::TreeBatch io_tree_batch;
+              data::TreeTemplateSet io_template_set;
+              {
+                mpi::trace_scope trace("scatter_read_trees.read");
+                read_trees (io_comm, file_name, pop_name, pop_start, io_tree_batch, io_template_set,
+                            round_offset, round_numitems, tree_mask);
+              }
+              mpi::memory_scope io_tree_batch_memory("scatter_read_trees.io_tree_batch",
+                                                     data::tree_batch_bytes(io_tree_batch));
+              append_rank_tree_batch(io_tree_batch, node_rank_map, rank_tree_batch);
+              append_rank_tree_template_set(io_template_set, node_rank_map, rank_template_set);
+              for (auto const& it : rank_tree_batch)
+                {
+                  rank_tree_batch_memory.add(data::tree_batch_bytes(it.second));
+                }
+            }
 
 #ifdef NEUROH5_DEBUG
-      throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
+          throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
 #endif
 
+          exchange_tree_batch(all_comm, size, rank, rank_tree_batch, tree_batch);
+          rank_tree_batch.clear();
+          rank_tree_batch_memory.set(0);
+          exchange_tree_template_set(all_comm, size, rank, rank_template_set, tree_batch);
+          rank_template_set.clear();
+          tree_batch_memory.set(data::tree_batch_bytes(tree_batch));
+        }
+
       throw_assert_nomsg(MPI_Barrier(io_comm) == MPI_SUCCESS);
       throw_assert_nomsg(MPI_Comm_free(&io_comm) == MPI_SUCCESS);
 
-      {
-        vector<int> recvcounts, rdispls;
-        vector<char> recvbuf;
-
-        throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
-                                                       recvcounts, rdispls, recvbuf) >= 0);
-        sendbuf.clear();
-        sendbuf.shrink_to_fit();
-
-        if (recvbuf.size() > 0)
-          {
-            data::deserialize_rank_tree_map (size, recvbuf, recvcounts, rdispls, tree_map);
-          }
-        recvbuf.clear();
-        recvbuf.shrink_to_fit();
-      }
-
       for (string attr_name_space : attr_name_spaces)
         {
           data::NamedAttrMap attr_map;
           set <string> attr_mask;
 
-          scatter_read_cell_attributes(all_comm, file_name, io_size,
+          scatter_read_cell_attributes(all_comm, file_name, plan.io_size,
                                        attr_name_space, attr_mask, node_rank_map,
                                        pop_name, pop_start, attr_map,
                                        offset, numitems);
@@ -160,7 +394,32 @@ namespace neuroh5
         }
 
       throw_assert_nomsg(MPI_Comm_free(&all_comm) == MPI_SUCCESS);
-    
+
+      return 0;
+    }
+
+
+    int scatter_read_trees
+    (
+     MPI_Comm                        comm,
+     const string                   &file_name,
+     const int                       io_size,
+     const vector<string>           &attr_name_spaces,
+     // A vector that maps nodes to compute ranks
+     const node_rank_map_t           &node_rank_map,
+     const string                    &pop_name,
+     const CELL_IDX_T                 pop_start,
+     map<CELL_IDX_T, neurotree_t>    &tree_map,
+     map<string, data::NamedAttrMap> &attr_maps,
+     size_t offset,
+     size_t numitems
+     )
+    {
+      data::TreeBatch tree_batch;
+      scatter_read_trees (comm, file_name, io_size, attr_name_spaces, node_rank_map,
+                          pop_name, pop_start, tree_batch, attr_maps,
+                          offset, numitems);
+      tree_batch.to_map(tree_map);
       return 0;
     }
 
@@ -171,33 +430,125 @@ namespace neuroh5
      const string                   &file_name,
      const int                       io_size,
      const vector<string>           &attr_name_spaces,
-     // A vector that maps nodes to compute ranks
      const string                    &pop_name,
      const CELL_IDX_T                 pop_start,
      const std::vector<CELL_IDX_T>&  selection,
-     map<CELL_IDX_T, neurotree_t>    &tree_map,
-     map<string, data::NamedAttrMap> &attr_maps
+     data::TreeBatch                 &tree_batch,
+     map<string, data::NamedAttrMap> &attr_maps,
+     const set<string>               &tree_mask
      )
     {
+      mpi::trace_scope trace_total("scatter_read_tree_selection");
+      throw_assert_nomsg(io_size > 0);
 
-      data::NamedAttrMap attr_values;
-      set <string> attr_mask;
+      int srank, ssize; size_t rank=0, size=0;
+      throw_assert_nomsg(MPI_Comm_size(all_comm, &ssize) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(all_comm, &srank) == MPI_SUCCESS);
+      rank = srank;
+      size = ssize;
+
+      size_t io_data_size = io_size;
+      if (io_data_size > size)
+        io_data_size = size;
+
+      set<size_t> io_rank_set;
+      data::range_sample(size, io_data_size, io_rank_set);
+      bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
+
+      // Redistribute the selection so that each I/O rank receives a
+      // sorted, contiguous range of the selected indices, along with
+      // the ranks that requested them.
+      vector<CELL_IDX_T> io_selection;
+      node_rank_map_t node_rank_map;
+      {
+        vector<CELL_IDX_T> selection_keys(selection);
+        vector<rank_t> selection_ranks(selection.size(), rank);
+        vector<rank_t> io_ranks(io_rank_set.begin(), io_rank_set.end());
 
-      scatter_read_cell_attribute_selection (all_comm, file_name, io_size, hdf5::TREES, attr_mask,
-                                             pop_name, pop_start, selection, attr_values);
-      append_tree_map(attr_values, tree_map);
+        mpi::bucket_plan_t plan;
+        mpi::sample_sort(all_comm, selection_keys, plan, io_ranks);
+        mpi::bucket_exchange(all_comm, plan, selection_ranks);
 
+        for (size_t i=0; i<selection_keys.size(); i++)
+          {
+            const CELL_IDX_T s = selection_keys[i];
+            if (io_selection.empty() || (io_selection.back() != s))
+              {
+                io_selection.push_back(s);
+              }
+            node_rank_map[s].insert(selection_ranks[i]);
+          }
+      }
+
+      MPI_Comm io_comm;
+      int io_color = 1;
+      map <rank_t, data::TreeBatch> rank_tree_batch;
+      map <rank_t, data::TreeTemplateSet> rank_template_set;
+      if (is_io_rank)
+        {
+          MPI_Comm_split(all_comm, io_color, rank, &io_comm);
+          MPI_Comm_set_errhandler(io_comm, MPI_ERRORS_RETURN);
+
+          data::TreeBatch io_tree_batch;
+          data::TreeTemplateSet io_template_set;
+          {
+            mpi::trace_scope trace("scatter_read_tree_selection.read");
+            read_tree_selection (io_comm, file_name, pop_name, pop_start, io_tree_batch, io_template_set,
+                                 io_selection, tree_mask);
+          }
+          append_rank_tree_batch(io_tree_batch, node_rank_map, rank_tree_batch);
+          append_rank_tree_template_set(io_template_set, node_rank_map, rank_template_set);
+        }
+      else
+        {
+          MPI_Comm_split(all_comm, 0, rank, &io_comm);
+        }
+      throw_assert_nomsg(MPI_Comm_free(&io_comm) == MPI_SUCCESS);
+
+      // ranks that receive no trees still report the requested fields
+      if (tree_batch.empty())
+        {
+          tree_batch.fields = data::tree_field_mask(tree_mask);
+        }
+      exchange_tree_batch(all_comm, size, rank, rank_tree_batch, tree_batch);
+      rank_tree_batch.clear();
+      exchange_tree_template_set(all_comm, size, rank, rank_template_set, tree_batch);
+      rank_template_set.clear();
+
+      set <string> attr_mask;
       for (string attr_name_space : attr_name_spaces)
         {
           scatter_read_cell_attribute_selection(all_comm, file_name,  io_size,
-                                                attr_name_space, attr_mask, 
-                                                pop_name, pop_start, selection, 
+                                                attr_name_space, attr_mask,
+                                                pop_name, pop_start, selection,
                                                 attr_maps[attr_name_space]);
 
         }
 #ifdef NEUROH5_DEBUG
       throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
-#endif    
+#endif
+      return 0;
+    }
+
+
+    int scatter_read_tree_selection
+    (
+     MPI_Comm                        all_comm,
+     const string                   &file_name,
+     const int                       io_size,
+     const vector<string>           &attr_name_spaces,
+     // A vector that maps nodes to compute ranks
+     const string                    &pop_name,
+     const CELL_IDX_T                 pop_start,
+     const std::vector<CELL_IDX_T>&  selection,
+     map<CELL_IDX_T, neurotree_t>    &tree_map,
+     map<string, data::NamedAttrMap> &attr_maps
+     )
+    {
+      data::TreeBatch tree_batch;
+      scatter_read_tree_selection (all_comm, file_name, io_size, attr_name_spaces,
+                                   pop_name, pop_start, selection, tree_batch, attr_maps);
+      tree_batch.to_map(tree_map);
       return 0;
     }
 
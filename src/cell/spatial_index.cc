@@ -0,0 +1,328 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file spatial_index.cc
+///
+///  Distributed spatial index over cell coordinates, for radius and
+///  nearest-neighbor queries of distance-dependent connectivity.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <algorithm>
+#include <set>
+#include <typeindex>
+
+#include "spatial_index.hh"
+#include "cell_attributes.hh"
+#include "alltoallv_template.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    void build_spatial_index
+    (
+     MPI_Comm                  comm,
+     const vector<CELL_IDX_T>& gids,
+     const vector<COORD_T>&    coords,
+     spatial_index_t&          index
+     )
+    {
+      int size;
+      throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                   "build_spatial_index: unable to obtain MPI communicator size");
+
+      index.tree.build(gids, coords);
+
+      COORD_T bounds[6];
+      index.tree.bounds(bounds);
+      index.rank_bounds.resize(6*size);
+      throw_assert(MPI_Allgather(bounds, 6, MPI_COORD_T,
+                                 &index.rank_bounds[0], 6, MPI_COORD_T, comm) == MPI_SUCCESS,
+                   "build_spatial_index: error in MPI_Allgather");
+    }
+
+    void build_spatial_index
+    (
+     MPI_Comm              comm,
+     const string&         file_name,
+     const string&         name_space,
+     const string&         pop_name,
+     const CELL_IDX_T&     pop_start,
+     spatial_index_t&      index,
+     const vector<string>& coord_names
+     )
+    {
+      throw_assert(coord_names.size() == 3,
+                   "build_spatial_index: three coordinate attribute names are required");
+
+      data::NamedAttrMap attr_values;
+      set<string> attr_mask(coord_names.begin(), coord_names.end());
+      read_cell_attributes(comm, file_name, name_space, attr_mask, pop_name, pop_start, attr_values);
+
+      const map<string, size_t>& name_map = attr_values.attr_name_map[type_index(typeid(COORD_T))];
+      vector<const map<CELL_IDX_T, deque<COORD_T> >*> coord_maps;
+      for (const string& coord_name : coord_names)
+        {
+          auto it = name_map.find(coord_name);
+          throw_assert(it != name_map.end(),
+                       "build_spatial_index: coordinate attribute " << coord_name <<
+                       " of type float not found in namespace " << name_space);
+          coord_maps.push_back(&attr_values.attr_map<COORD_T>(it->second));
+        }
+
+      vector<CELL_IDX_T> gids;
+      vector<COORD_T> coords;
+      gids.reserve(attr_values.index_set.size());
+      coords.reserve(3*attr_values.index_set.size());
+      for (const CELL_IDX_T gid : attr_values.index_set)
+        {
+          gids.push_back(gid);
+          for (size_t d=0; d<3; d++)
+            {
+              auto it = coord_maps[d]->find(gid);
+              throw_assert((it != coord_maps[d]->end()) && (it->second.size() > 0),
+                           "build_spatial_index: cell " << gid << " has no value for attribute " <<
+                           coord_names[d]);
+              coords.push_back(it->second[0]);
+            }
+        }
+
+      build_spatial_index(comm, gids, coords, index);
+    }
+
+    /// Squared distance from a point to a bounding box.
+    static COORD_T box_distance2 (const COORD_T* box, const COORD_T* q)
+    {
+      COORD_T dist2 = 0.0;
+      for (size_t d=0; d<3; d++)
+        {
+          COORD_T diff = 0.0;
+          if (q[d] < box[d])
+            {
+              diff = box[d] - q[d];
+            }
+          else if (q[d] > box[d+3])
+            {
+              diff = q[d] - box[d+3];
+            }
+          dist2 += diff*diff;
+        }
+      return dist2;
+    }
+
+    /// Sends each query point to the ranks listed for it, answers the
+    /// received queries with the local tree, and returns the answers
+    /// of all ranks for each query point.
+    template <class Answer>
+    static void exchange_queries
+    (
+     MPI_Comm                                      comm,
+     const vector<COORD_T>&                        queries,
+     const vector< vector<size_t> >&               rank_queries,
+     const Answer&                                 answer,
+     data::thread_pool&                            pool,
+     vector< vector<data::KDTree::neighbor_t> >&   results
+     )
+    {
+      const size_t size = rank_queries.size();
+
+      vector<int> sendcounts(size, 0), sdispls(size, 0), recvcounts(size, 0), rdispls(size, 0);
+      vector<COORD_T> query_sendbuf, query_recvbuf;
+      for (size_t r=0; r<size; r++)
+        {
+          sdispls[r] = query_sendbuf.size();
+          for (const size_t i : rank_queries[r])
+            {
+              query_sendbuf.insert(query_sendbuf.end(), &queries[3*i], &queries[3*i] + 3);
+            }
+          sendcounts[r] = query_sendbuf.size() - sdispls[r];
+        }
+      throw_assert_nomsg(mpi::alltoallv_vector<COORD_T>(comm, MPI_COORD_T, sendcounts, sdispls, query_sendbuf,
+                                                        recvcounts, rdispls, query_recvbuf) >= 0);
+
+      // answer the received queries
+      const size_t num_received = query_recvbuf.size() / 3;
+      vector< vector<data::KDTree::neighbor_t> > answers(num_received);
+      pool.parallel_for(num_received,
+                        [&] (size_t i, size_t worker)
+                        {
+                          answer(&query_recvbuf[3*i], answers[i]);
+                        }, 16);
+
+      // return the number of neighbors, the neighbors and their
+      // distances for each received query
+      vector<int> count_sendcounts(size, 0), count_sdispls(size, 0),
+        count_recvcounts(size, 0), count_rdispls(size, 0);
+      vector<int> neighbor_sendcounts(size, 0), neighbor_sdispls(size, 0),
+        neighbor_recvcounts(size, 0), neighbor_rdispls(size, 0);
+      vector<uint32_t> count_sendbuf, count_recvbuf;
+      vector<CELL_IDX_T> gid_sendbuf, gid_recvbuf;
+      vector<COORD_T> distance_sendbuf, distance_recvbuf;
+      count_sendbuf.reserve(num_received);
+      for (size_t r=0, i=0; r<size; r++)
+        {
+          count_sdispls[r] = count_sendbuf.size();
+          neighbor_sdispls[r] = gid_sendbuf.size();
+          for (size_t j=0; j<(size_t)recvcounts[r]/3; j++, i++)
+            {
+              count_sendbuf.push_back(answers[i].size());
+              for (const auto& neighbor : answers[i])
+                {
+                  distance_sendbuf.push_back(neighbor.first);
+                  gid_sendbuf.push_back(neighbor.second);
+                }
+            }
+          count_sendcounts[r] = count_sendbuf.size() - count_sdispls[r];
+          neighbor_sendcounts[r] = gid_sendbuf.size() - neighbor_sdispls[r];
+        }
+      answers.clear();
+
+      throw_assert_nomsg(mpi::alltoallv_vector<uint32_t>(comm, MPI_UINT32_T, count_sendcounts, count_sdispls,
+                                                         count_sendbuf, count_recvcounts, count_rdispls,
+                                                         count_recvbuf) >= 0);
+      throw_assert_nomsg(mpi::alltoallv_vector<CELL_IDX_T>(comm, MPI_CELL_IDX_T, neighbor_sendcounts, neighbor_sdispls,
+                                                           gid_sendbuf, neighbor_recvcounts, neighbor_rdispls,
+                                                           gid_recvbuf) >= 0);
+      throw_assert_nomsg(mpi::alltoallv_vector<COORD_T>(comm, MPI_COORD_T, neighbor_sendcounts, neighbor_sdispls,
+                                                        distance_sendbuf, neighbor_recvcounts, neighbor_rdispls,
+                                                        distance_recvbuf) >= 0);
+
+      results.assign(queries.size() / 3, vector<data::KDTree::neighbor_t>());
+      for (size_t r=0; r<size; r++)
+        {
+          throw_assert((size_t)count_recvcounts[r] == rank_queries[r].size(),
+                       "spatial index: rank " << r << " returned " << count_recvcounts[r] <<
+                       " answers for " << rank_queries[r].size() << " queries");
+          size_t pos = neighbor_rdispls[r];
+          for (size_t j=0; j<rank_queries[r].size(); j++)
+            {
+              vector<data::KDTree::neighbor_t>& result = results[rank_queries[r][j]];
+              const uint32_t count = count_recvbuf[count_rdispls[r] + j];
+              for (size_t p=pos; p<pos+count; p++)
+                {
+                  result.push_back(make_pair(distance_recvbuf[p], gid_recvbuf[p]));
+                }
+              pos += count;
+            }
+        }
+    }
+
+    /// Sorts the neighbors of each query and stores the first max_count
+    /// of them (all if max_count is 0) in compressed sparse row form.
+    static void make_neighbor_csr (vector< vector<data::KDTree::neighbor_t> >& results,
+                                   const size_t max_count, neighbor_csr_t& neighbors)
+    {
+      neighbors.ptr.resize(results.size()+1);
+      neighbors.ptr[0] = 0;
+      neighbors.index.clear();
+      neighbors.distance.clear();
+      for (size_t i=0; i<results.size(); i++)
+        {
+          vector<data::KDTree::neighbor_t>& result = results[i];
+          sort(result.begin(), result.end());
+          if ((max_count > 0) && (result.size() > max_count))
+            {
+              result.resize(max_count);
+            }
+          for (const auto& neighbor : result)
+            {
+              neighbors.distance.push_back(neighbor.first);
+              neighbors.index.push_back(neighbor.second);
+            }
+          neighbors.ptr[i+1] = neighbors.index.size();
+        }
+    }
+
+    void spatial_radius_query
+    (
+     MPI_Comm               comm,
+     const spatial_index_t& index,
+     const vector<COORD_T>& queries,
+     const COORD_T          radius,
+     data::thread_pool&     pool,
+     neighbor_csr_t&        neighbors
+     )
+    {
+      throw_assert(queries.size() % 3 == 0,
+                   "spatial_radius_query: query coordinates must be given as x, y, z triples");
+      throw_assert(radius >= 0.0,
+                   "spatial_radius_query: radius must be non-negative");
+
+      const size_t size = index.rank_bounds.size() / 6;
+      const size_t num_queries = queries.size() / 3;
+      const COORD_T radius2 = radius*radius;
+
+      // send each query only to the ranks with cells within radius
+      vector< vector<size_t> > rank_queries(size);
+      for (size_t i=0; i<num_queries; i++)
+        {
+          for (size_t r=0; r<size; r++)
+            {
+              if (box_distance2(&index.rank_bounds[6*r], &queries[3*i]) <= radius2)
+                {
+                  rank_queries[r].push_back(i);
+                }
+            }
+        }
+
+      const data::KDTree& tree = index.tree;
+      vector< vector<data::KDTree::neighbor_t> > results;
+      exchange_queries(comm, queries, rank_queries,
+                       [&tree, radius] (const COORD_T* q, vector<data::KDTree::neighbor_t>& result)
+                       {
+                         tree.radius_query(q, radius, result);
+                       },
+                       pool, results);
+
+      make_neighbor_csr(results, 0, neighbors);
+    }
+
+    void spatial_knn_query
+    (
+     MPI_Comm               comm,
+     const spatial_index_t& index,
+     const vector<COORD_T>& queries,
+     const size_t           k,
+     data::thread_pool&     pool,
+     neighbor_csr_t&        neighbors
+     )
+    {
+      throw_assert(queries.size() % 3 == 0,
+                   "spatial_knn_query: query coordinates must be given as x, y, z triples");
+
+      const size_t size = index.rank_bounds.size() / 6;
+      const size_t num_queries = queries.size() / 3;
+
+      // the k nearest cells of a rank are not bounded by distance, so
+      // each query is sent to every rank that has cells
+      vector< vector<size_t> > rank_queries(size);
+      for (size_t r=0; r<size; r++)
+        {
+          if ((k > 0) && (index.rank_bounds[6*r] <= index.rank_bounds[6*r+3]))
+            {
+              for (size_t i=0; i<num_queries; i++)
+                {
+                  rank_queries[r].push_back(i);
+                }
+            }
+        }
+
+      const data::KDTree& tree = index.tree;
+      vector< vector<data::KDTree::neighbor_t> > results;
+      exchange_queries(comm, queries, rank_queries,
+                       [&tree, k] (const COORD_T* q, vector<data::KDTree::neighbor_t>& result)
+                       {
+                         tree.knn_query(q, k, result);
+                       },
+                       pool, results);
+
+      make_neighbor_csr(results, k, neighbors);
+    }
+
+  }
+}
@@ -0,0 +1,186 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_cell_attributes.cc
+///
+///  Combines the cell attributes of part files into one namespace.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "stitch_cell_attributes.hh"
+#include "stitch_datasets.hh"
+#include "path_names.hh"
+#include "exists_dataset.hh"
+#include "group_contents.hh"
+#include "dataset_num_elements.hh"
+#include "file_access.hh"
+#include "serialize_data.hh"
+#include "mpi_trace.hh"
+#include "throw_assert.hh"
+
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    void stitch_cell_attributes
+    (
+     MPI_Comm              comm,
+     const string&         file_name,
+     const vector<string>& part_file_names,
+     const string&         name_space,
+     const string&         pop_name,
+     const bool            copy_parts
+     )
+    {
+      mpi::trace_scope trace_total("stitch_cell_attributes");
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      const size_t num_parts = part_file_names.size();
+      const string attr_prefix = hdf5::cell_attribute_prefix(name_space, pop_name);
+
+      // attribute names with the number of cells and values in each part
+      vector< tuple<string,vector<hsize_t>,vector<hsize_t> > > attr_parts;
+      if (rank == 0)
+        {
+          map<string, size_t> attr_pos;
+          vector<hid_t> attr_ftypes;
+          for (size_t p = 0; p < num_parts; p++)
+            {
+              hid_t part_file = H5Fopen(part_file_names[p].c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+              throw_assert(part_file >= 0,
+                           "stitch_cell_attributes: unable to open file " << part_file_names[p]);
+              if (!(hdf5::exists_dataset (part_file, attr_prefix) > 0))
+                {
+                  throw_assert(H5Fclose(part_file) >= 0,
+                               "stitch_cell_attributes: unable to close file " << part_file_names[p]);
+                  continue;
+                }
+
+              vector<string> attr_names;
+              throw_assert(hdf5::group_contents(MPI_COMM_SELF, part_file, attr_prefix, attr_names) >= 0,
+                           "stitch_cell_attributes: unable to read namespace " << attr_prefix <<
+                           " of " << part_file_names[p]);
+              for (const string& attr_name : attr_names)
+                {
+                  const string path = hdf5::cell_attribute_path(name_space, pop_name, attr_name);
+                  const string value_path = path + "/" + hdf5::ATTR_VAL;
+                  // shared cell indices are stored next to the attributes
+                  if (!(hdf5::exists_dataset (part_file, value_path) > 0))
+                    {
+                      continue;
+                    }
+
+                  hid_t dset = H5Dopen2(part_file, value_path.c_str(), H5P_DEFAULT);
+                  throw_assert(dset >= 0,
+                               "stitch_cell_attributes: unable to open dataset " << value_path);
+                  hid_t ftype = H5Dget_type(dset);
+                  throw_assert(ftype >= 0, "stitch_cell_attributes: error in H5Dget_type");
+                  throw_assert(H5Dclose(dset) >= 0, "stitch_cell_attributes: error in H5Dclose");
+
+                  auto it = attr_pos.find(attr_name);
+                  if (it == attr_pos.end())
+                    {
+                      it = attr_pos.insert(make_pair(attr_name, attr_parts.size())).first;
+                      attr_parts.push_back(make_tuple(attr_name, vector<hsize_t>(num_parts, 0),
+                                                      vector<hsize_t>(num_parts, 0)));
+                      attr_ftypes.push_back(ftype);
+                    }
+                  else
+                    {
+                      throw_assert(H5Tequal(attr_ftypes[it->second], ftype) > 0,
+                                   "stitch_cell_attributes: attribute " << attr_name <<
+                                   " has a different type in " << part_file_names[p]);
+                      throw_assert(H5Tclose(ftype) >= 0, "stitch_cell_attributes: error in H5Tclose");
+                    }
+
+                  hsize_t index_size = hdf5::dataset_num_elements(part_file, path + "/" + hdf5::CELL_INDEX);
+                  hsize_t ptr_size   = hdf5::dataset_num_elements(part_file, path + "/" + hdf5::ATTR_PTR);
+                  throw_assert((ptr_size == index_size+1) || ((index_size == 0) && (ptr_size <= 1)),
+                               "stitch_cell_attributes: attribute " << attr_name << " of " <<
+                               part_file_names[p] << " has no attribute pointer for each cell");
+                  get<1>(attr_parts[it->second])[p] = index_size;
+                  get<2>(attr_parts[it->second])[p] = hdf5::dataset_num_elements(part_file, value_path);
+                }
+              throw_assert(H5Fclose(part_file) >= 0,
+                           "stitch_cell_attributes: unable to close file " << part_file_names[p]);
+            }
+
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+          throw_assert(file >= 0,
+                       "stitch_cell_attributes: unable to open file " << file_name);
+          hdf5::remove_stitched_group(file, attr_prefix);
+          for (size_t i=0; i<attr_parts.size(); i++)
+            {
+              const string path = hdf5::cell_attribute_path(name_space, pop_name, get<0>(attr_parts[i]));
+              hdf5::create_stitched_dataset(file, file_name, path + "/" + hdf5::CELL_INDEX,
+                                            CELL_IDX_H5_FILE_T, part_file_names, get<1>(attr_parts[i]),
+                                            copy_parts);
+              hdf5::create_stitched_pointer_dataset(file, path + "/" + hdf5::ATTR_PTR,
+                                                    ATTR_PTR_H5_FILE_T, get<1>(attr_parts[i]));
+              hdf5::create_stitched_dataset(file, file_name, path + "/" + hdf5::ATTR_VAL,
+                                            attr_ftypes[i], part_file_names, get<2>(attr_parts[i]),
+                                            copy_parts);
+              throw_assert(H5Tclose(attr_ftypes[i]) >= 0, "stitch_cell_attributes: error in H5Tclose");
+            }
+          throw_assert(H5Fclose(file) >= 0,
+                       "stitch_cell_attributes: unable to close file " << file_name);
+        }
+
+      {
+        vector<char> sendbuf; size_t sendbuf_size=0;
+        if (rank == 0)
+          {
+            data::serialize_data(attr_parts, sendbuf);
+            sendbuf_size = sendbuf.size();
+          }
+
+        throw_assert(MPI_Bcast(&sendbuf_size, 1, MPI_SIZE_T, 0, comm) == MPI_SUCCESS,
+                     "stitch_cell_attributes: error in MPI_Bcast");
+        sendbuf.resize(sendbuf_size);
+        throw_assert(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS,
+                     "stitch_cell_attributes: error in MPI_Bcast");
+
+        if (rank != 0)
+          {
+            data::deserialize_data(sendbuf, attr_parts);
+          }
+      }
+
+      // the attribute pointers of each part are offset by the number of
+      // values in the preceding parts
+      hid_t file = hdf5::open_file(comm, file_name, true, true);
+      for (size_t i=0; i<attr_parts.size(); i++)
+        {
+          const string path = hdf5::cell_attribute_path(name_space, pop_name, get<0>(attr_parts[i]));
+          const vector<hsize_t>& value_sizes = get<2>(attr_parts[i]);
+          vector<uint64_t> part_offsets(num_parts, 0);
+          for (size_t p = 1; p < num_parts; p++)
+            {
+              part_offsets[p] = part_offsets[p-1] + value_sizes[p-1];
+            }
+          hdf5::write_stitched_pointers(comm, file, path + "/" + hdf5::ATTR_PTR,
+                                        part_file_names, get<1>(attr_parts[i]), part_offsets);
+          trace_total.add_items(1);
+        }
+      throw_assert(hdf5::close_file(file) >= 0,
+                   "stitch_cell_attributes: unable to close file " << file_name);
+      throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                   "stitch_cell_attributes: error in MPI_Barrier");
+    }
+
+  }
+}
@@ -0,0 +1,289 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_morphometrics.cc
+///
+///  Morphometric quantities of batches of trees.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <algorithm>
+
+#include "tree_morphometrics.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace cell
+  {
+
+    // SWC types of basal and apical dendrite points
+    static const SWC_TYPE_T swc_basal_dendrite  = 3;
+    static const SWC_TYPE_T swc_apical_dendrite = 4;
+
+    /// Scratch arrays of one thread, reused across trees.
+    struct morphometrics_workspace_t
+    {
+      vector<float>    segment_length;
+      vector<int32_t>  section_parent;
+      vector<uint32_t> section_children;
+      vector<uint8_t>  done;
+      vector<size_t>   chain;
+    };
+
+    /// Computes values[k] = values[parent(k)] + step(k) for the n nodes
+    /// of a tree, where parent(k) < 0 denotes a root with value 0.
+    /// Trees whose parents precede their children, as is usual for
+    /// SWC files, are done in one forward pass; otherwise the path to
+    /// an already computed node is followed for each node.
+    template <class Parent, class Step, class T>
+    static void accumulate_from_root (const CELL_IDX_T gid, const size_t n,
+                                      const Parent& parent, const Step& step, T* values,
+                                      morphometrics_workspace_t& ws)
+    {
+      bool ordered = true;
+      for (size_t k=0; k<n; k++)
+        {
+          const long p = parent(k);
+          throw_assert(p < (long)n,
+                       "tree " << gid << ": parent index " << p << " is out of range");
+          if (p >= (long)k)
+            {
+              ordered = false;
+            }
+        }
+
+      if (ordered)
+        {
+          for (size_t k=0; k<n; k++)
+            {
+              const long p = parent(k);
+              values[k] = ((p < 0) ? 0 : values[p]) + step(k);
+            }
+          return;
+        }
+
+      ws.done.assign(n, 0);
+      for (size_t k=0; k<n; k++)
+        {
+          ws.chain.clear();
+          size_t j = k;
+          while (ws.done[j] == 0)
+            {
+              ws.chain.push_back(j);
+              throw_assert(ws.chain.size() <= n,
+                           "tree " << gid << ": parent relation contains a cycle");
+              const long p = parent(j);
+              if (p < 0)
+                {
+                  break;
+                }
+              j = p;
+            }
+          for (auto it = ws.chain.rbegin(); it != ws.chain.rend(); ++it)
+            {
+              const size_t m = *it;
+              const long p = parent(m);
+              values[m] = ((p < 0) ? 0 : values[p]) + step(m);
+              ws.done[m] = 1;
+            }
+        }
+    }
+
+    static void compute_tree_morphometrics (const data::TreeBatch& tree_batch, const size_t i,
+                                            tree_morphometrics_t& morph,
+                                            morphometrics_workspace_t& ws)
+    {
+      const CELL_IDX_T gid = tree_batch.index[i];
+      const data::column_view<COORD_T> xs = tree_batch.tree_x(i);
+      const data::column_view<COORD_T> ys = tree_batch.tree_y(i);
+      const data::column_view<COORD_T> zs = tree_batch.tree_z(i);
+      const data::column_view<LAYER_IDX_T> layers = tree_batch.tree_layer(i);
+      const data::column_view<PARENT_NODE_IDX_T> parents = tree_batch.tree_parent(i);
+      const data::column_view<SWC_TYPE_T> swc_types = tree_batch.tree_swc_type(i);
+      const data::column_view<SECTION_IDX_T> sections = tree_batch.tree_sections(i);
+      const data::column_view<SECTION_IDX_T> src = tree_batch.tree_src(i);
+      const data::column_view<SECTION_IDX_T> dst = tree_batch.tree_dst(i);
+
+      const size_t num_points = xs.size();
+      const COORD_T *x = xs.begin(), *y = ys.begin(), *z = zs.begin();
+      const PARENT_NODE_IDX_T *parent = parents.begin();
+
+      // length of the segment from each point to its parent
+      ws.segment_length.resize(num_points);
+      float *segment_length = ws.segment_length.data();
+      for (size_t k=0; k<num_points; k++)
+        {
+          const long p = parent[k];
+          throw_assert(p < (long)num_points,
+                       "tree " << gid << ": parent index " << p << " is out of range");
+          if (p < 0)
+            {
+              segment_length[k] = 0.0;
+            }
+          else
+            {
+              const float dx = x[k] - x[p], dy = y[k] - y[p], dz = z[k] - z[p];
+              segment_length[k] = sqrt(dx*dx + dy*dy + dz*dz);
+            }
+        }
+
+      // path distance to the root
+      float *path_distance = morph.path_distance.data() + morph.point_ptr[i];
+      accumulate_from_root(gid, num_points,
+                           [parent] (size_t k) { return (long)parent[k]; },
+                           [segment_length] (size_t k) { return segment_length[k]; },
+                           path_distance, ws);
+
+      // total and per-layer dendritic length
+      float total_length = 0.0;
+      float *layer_length = morph.layer_length.data() + i*morph.num_layers;
+      for (size_t k=0; k<num_points; k++)
+        {
+          total_length += segment_length[k];
+          const SWC_TYPE_T swc_type = swc_types[k];
+          if ((layers[k] >= 0) &&
+              ((swc_type == swc_basal_dendrite) || (swc_type == swc_apical_dendrite)))
+            {
+              layer_length[layers[k]] += segment_length[k];
+            }
+        }
+      morph.total_length[i] = total_length;
+
+      // bounding box
+      float *bounding_box = morph.bounding_box.data() + 6*i;
+      if (num_points > 0)
+        {
+          bounding_box[0] = *min_element(x, x + num_points);
+          bounding_box[1] = *min_element(y, y + num_points);
+          bounding_box[2] = *min_element(z, z + num_points);
+          bounding_box[3] = *max_element(x, x + num_points);
+          bounding_box[4] = *max_element(y, y + num_points);
+          bounding_box[5] = *max_element(z, z + num_points);
+        }
+
+      // section lengths along consecutive section points
+      const size_t num_sections = morph.section_ptr[i+1] - morph.section_ptr[i];
+      float *section_length = morph.section_length.data() + morph.section_ptr[i];
+      size_t sections_pos = 1;
+      for (size_t s=0; s<num_sections; s++)
+        {
+          throw_assert(sections_pos < sections.size(),
+                       "tree " << gid << ": section array is shorter than the number of sections");
+          const size_t num_section_points = sections[sections_pos++];
+          throw_assert(sections_pos + num_section_points <= sections.size(),
+                       "tree " << gid << ": section extends past the end of the section array");
+          float length = 0.0;
+          for (size_t p=1; p<num_section_points; p++)
+            {
+              const size_t a = sections[sections_pos+p-1], b = sections[sections_pos+p];
+              throw_assert((a < num_points) && (b < num_points),
+                           "tree " << gid << ": section point index is out of range");
+              const float dx = x[b] - x[a], dy = y[b] - y[a], dz = z[b] - z[a];
+              length += sqrt(dx*dx + dy*dy + dz*dz);
+            }
+          section_length[s] = length;
+          sections_pos += num_section_points;
+        }
+
+      // branch order: the number of sections with more than one child
+      // on the path from the root section
+      ws.section_parent.assign(num_sections, -1);
+      ws.section_children.assign(num_sections, 0);
+      for (size_t e=0; e<src.size(); e++)
+        {
+          throw_assert((src[e] < num_sections) && (dst[e] < num_sections),
+                       "tree " << gid << ": section topology refers to an unknown section");
+          ws.section_parent[dst[e]] = src[e];
+          ws.section_children[src[e]]++;
+        }
+      const int32_t *section_parent = ws.section_parent.data();
+      const uint32_t *section_children = ws.section_children.data();
+      uint16_t *branch_order = morph.section_branch_order.data() + morph.section_ptr[i];
+      accumulate_from_root(gid, num_sections,
+                           [section_parent] (size_t s) { return (long)section_parent[s]; },
+                           [section_parent, section_children] (size_t s)
+                           {
+                             const int32_t p = section_parent[s];
+                             return (uint16_t)(((p >= 0) && (section_children[p] > 1)) ? 1 : 0);
+                           },
+                           branch_order, ws);
+    }
+
+    void compute_tree_morphometrics (const data::TreeBatch& tree_batch,
+                                     data::thread_pool& pool,
+                                     tree_morphometrics_t& morph)
+    {
+      throw_assert(tree_batch.has(data::TreeFieldCoords | data::TreeFieldLayer | data::TreeFieldParent |
+                                  data::TreeFieldSWCType | data::TreeFieldTopology),
+                   "compute_tree_morphometrics: tree batch lacks fields required for morphometrics");
+
+      const size_t num_trees = tree_batch.size();
+      morph.index = tree_batch.index;
+      morph.point_ptr = tree_batch.attr_ptr;
+
+      // the output ranges of every tree are known in advance, so that
+      // threads write to disjoint parts of the result columns
+      morph.section_ptr.resize(num_trees+1);
+      morph.section_ptr[0] = 0;
+      for (size_t i=0; i<num_trees; i++)
+        {
+          const size_t num_sections =
+            (tree_batch.sec_ptr[i+1] > tree_batch.sec_ptr[i]) ? tree_batch.sections[tree_batch.sec_ptr[i]] : 0;
+          morph.section_ptr[i+1] = morph.section_ptr[i] + num_sections;
+        }
+
+      LAYER_IDX_T max_layer = -1;
+      for (auto layer : tree_batch.layer)
+        {
+          max_layer = max(max_layer, layer);
+        }
+      morph.num_layers = max_layer + 1;
+
+      morph.section_length.assign(morph.section_ptr[num_trees], 0.0);
+      morph.section_branch_order.assign(morph.section_ptr[num_trees], 0);
+      morph.path_distance.assign(morph.point_ptr[num_trees], 0.0);
+      morph.layer_length.assign(num_trees*morph.num_layers, 0.0);
+      morph.bounding_box.assign(6*num_trees, 0.0);
+      morph.total_length.assign(num_trees, 0.0);
+
+      vector<morphometrics_workspace_t> workspaces(pool.size());
+      pool.parallel_for(num_trees,
+                        [&] (size_t i, size_t worker)
+                        {
+                          compute_tree_morphometrics(tree_batch, i, morph, workspaces[worker]);
+                        }, 64);
+    }
+
+    template <class T>
+    static void append_attr_values (const string& attr_name, const CELL_IDX_T gid,
+                                    const vector<T>& values, size_t begin, size_t end,
+                                    map<string, map<CELL_IDX_T, deque<T> > >& attr_values)
+    {
+      attr_values[attr_name][gid] = deque<T>(values.begin() + begin, values.begin() + end);
+    }
+
+    void tree_morphometrics_t::append_attr_maps (map<string, map<CELL_IDX_T, deque<float> > >& float_values,
+                                                 map<string, map<CELL_IDX_T, deque<uint16_t> > >& uint16_values) const
+    {
+      for (size_t i=0; i<index.size(); i++)
+        {
+          const CELL_IDX_T gid = index[i];
+          append_attr_values(SECTION_LENGTH, gid, section_length, section_ptr[i], section_ptr[i+1],
+                             float_values);
+          append_attr_values(SECTION_BRANCH_ORDER, gid, section_branch_order, section_ptr[i], section_ptr[i+1],
+                             uint16_values);
+          append_attr_values(PATH_DISTANCE, gid, path_distance, point_ptr[i], point_ptr[i+1],
+                             float_values);
+          append_attr_values(LAYER_LENGTH, gid, layer_length, i*num_layers, (i+1)*num_layers,
+                             float_values);
+          append_attr_values(BOUNDING_BOX, gid, bounding_box, 6*i, 6*(i+1), float_values);
+          append_attr_values(TOTAL_LENGTH, gid, total_length, i, i+1, float_values);
+        }
+    }
+
+  }
+}
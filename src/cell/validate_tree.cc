@@ -4,18 +4,19 @@
 ///
 ///  Validate tree structure.
 ///
-///  Copyright (C) 2016-2021 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 
 
 #include "debug.hh"
 
-#include <set>
 #include <deque>
+#include <vector>
+#include <forward_list>
 
 #include "neuroh5_types.hh"
+#include "validate_tree.hh"
 #include "throw_assert.hh"
-#include "ngraph.hh"
 
 
 using namespace std;
@@ -24,25 +25,30 @@ namespace neuroh5
 
   namespace cell
   {
-    
-    void validate_tree(const neurotree_t& tree)
+
+    /// Validation is written against generic column containers, so
+    /// that it applies both to trees stored as deques and to the
+    /// column views of a TreeBatch.
+    template <class SecCol, class CoordCol, class RealCol, class LayerCol, class ParentCol, class TypeCol>
+    void validate_tree_columns(const CELL_IDX_T tree_id,
+                               const SecCol& src_vector,
+                               const SecCol& dst_vector,
+                               const SecCol& sections,
+                               const CoordCol& xcoords,
+                               const CoordCol& ycoords,
+                               const CoordCol& zcoords,
+                               const RealCol& radiuses,
+                               const LayerCol& layers,
+                               const ParentCol& parents,
+                               const TypeCol& swc_types,
+                               tree_workspace_t& ws)
     {
-      const CELL_IDX_T tree_id = get<0>(tree);
-      const std::deque<SECTION_IDX_T> & src_vector=get<1>(tree);
-      const std::deque<SECTION_IDX_T> & dst_vector=get<2>(tree);
-      const std::deque<SECTION_IDX_T> & sections=get<3>(tree);
-      const std::deque<COORD_T> & xcoords=get<4>(tree);
-      const std::deque<COORD_T> & ycoords=get<5>(tree);
-      const std::deque<COORD_T> & zcoords=get<6>(tree);
-      const std::deque<REALVAL_T> & radiuses=get<7>(tree);
-      const std::deque<LAYER_IDX_T> & layers=get<8>(tree);
-      const deque<PARENT_NODE_IDX_T> & parents=get<9>(tree);
-      const deque<SWC_TYPE_T> & swc_types=get<10>(tree);
 
       throw_assert_nomsg(src_vector.size() > 0);
       throw_assert_nomsg(dst_vector.size() > 0);
       throw_assert_nomsg(sections.size() > 0);
-      
+      throw_assert_nomsg(src_vector.size() == dst_vector.size());
+
       size_t num_xpoints = xcoords.size();
       size_t num_ypoints = ycoords.size();
       size_t num_zpoints = zcoords.size();
@@ -58,56 +64,116 @@ namespace neuroh5
 
       size_t num_nodes = num_xpoints, sections_ptr=1;
 
-      set<NODE_IDX_T> all_section_nodes;
-      
+      // every point must belong to at least one section
+      ws.node_seen.assign(num_nodes+1, 0);
+      size_t num_section_nodes_seen = 0;
+
       while (sections_ptr < sections.size())
         {
-          std::vector<NODE_IDX_T> section_nodes;
           size_t num_section_nodes = sections[sections_ptr];
           sections_ptr++;
+          throw_assert(sections_ptr + num_section_nodes <= sections.size(),
+                       "tree " << tree_id << ": section extends past the end of the section array");
           for (size_t p = 0; p < num_section_nodes; p++)
             {
-                        
               NODE_IDX_T node_idx = sections[sections_ptr];
-              if (!(node_idx <= num_nodes))
+              throw_assert(node_idx <= num_nodes,
+                           "tree " << tree_id << ": node index " << node_idx <<
+                           " is out of range (number of nodes is " << num_nodes << ")");
+              if (ws.node_seen[node_idx] == 0)
                 {
-                  printf("tree id = %u\n",tree_id);
-                  printf("node_idx = %u\n",node_idx);
-                  printf("num_nodes = %lu\n", num_nodes);
+                  ws.node_seen[node_idx] = 1;
+                  num_section_nodes_seen++;
                 }
-              throw_assert_nomsg(node_idx <= num_nodes);
-              all_section_nodes.insert(node_idx);
               sections_ptr++;
             }
-      
+
         }
-  
-      throw_assert_nomsg(all_section_nodes.size() == num_nodes);
 
-      Graph S;
+      throw_assert_nomsg(num_section_nodes_seen == num_nodes);
 
+      // the section graph consists of the sections and all edge
+      // endpoints, and must have exactly one vertex without incoming
+      // edges
+      size_t num_vertices = num_sections;
+      for (size_t e = 0; e < src_vector.size(); e++)
+        {
+          num_vertices = max(num_vertices, (size_t)src_vector[e]+1);
+          num_vertices = max(num_vertices, (size_t)dst_vector[e]+1);
+        }
+      ws.section_exists.assign(num_vertices, 0);
+      ws.section_indegree.assign(num_vertices, 0);
       for (size_t s = 0; s < num_sections; s++)
         {
-          S.insert_vertex(s);
+          ws.section_exists[s] = 1;
         }
       for (size_t e = 0; e < src_vector.size(); e++)
         {
-          S.insert_edge(src_vector[e], dst_vector[e]);
+          ws.section_exists[src_vector[e]] = 1;
+          ws.section_exists[dst_vector[e]] = 1;
+          ws.section_indegree[dst_vector[e]]++;
         }
 
       size_t root_count = 0;
-      for (Graph::const_iterator p=S.begin(); p != S.end(); p++)
-          {
-            Graph::vertex v = Graph::node (p); 
-            Graph::vertex_set in = S.in_neighbors(v);
-            if (in.size() == 0)
-              {
-                root_count++;
-              }
-            
-          }
-
-      throw_assert(root_count == 1, "tree must have only one root");
+      for (size_t s = 0; s < num_vertices; s++)
+        {
+          if ((ws.section_exists[s] != 0) && (ws.section_indegree[s] == 0))
+            {
+              root_count++;
+            }
+        }
+
+      throw_assert(root_count == 1, "tree " << tree_id << ": tree must have only one root");
+    }
+
+    void validate_tree(const neurotree_t& tree, tree_workspace_t& ws)
+    {
+      validate_tree_columns(get<0>(tree), get<1>(tree), get<2>(tree), get<3>(tree),
+                            get<4>(tree), get<5>(tree), get<6>(tree), get<7>(tree),
+                            get<8>(tree), get<9>(tree), get<10>(tree), ws);
+    }
+
+    void validate_tree(const data::TreeBatch& tree_batch, size_t i, tree_workspace_t& ws)
+    {
+      validate_tree_columns(tree_batch.index[i],
+                            tree_batch.tree_src(i), tree_batch.tree_dst(i), tree_batch.tree_sections(i),
+                            tree_batch.tree_x(i), tree_batch.tree_y(i), tree_batch.tree_z(i),
+                            tree_batch.tree_radius(i), tree_batch.tree_layer(i),
+                            tree_batch.tree_parent(i), tree_batch.tree_swc_type(i), ws);
+    }
+
+    void validate_tree(const neurotree_t& tree)
+    {
+      tree_workspace_t ws;
+      validate_tree(tree, ws);
+    }
+
+    void validate_trees(const forward_list<neurotree_t>& tree_list,
+                        data::thread_pool& pool)
+    {
+      vector<const neurotree_t*> trees;
+      for (auto & tree : tree_list)
+        {
+          trees.push_back(&tree);
+        }
+
+      vector<tree_workspace_t> workspaces(pool.size());
+      pool.parallel_for(trees.size(),
+                        [&] (size_t i, size_t worker)
+                        {
+                          validate_tree(*trees[i], workspaces[worker]);
+                        }, 64);
+    }
+
+    void validate_trees(const data::TreeBatch& tree_batch,
+                        data::thread_pool& pool)
+    {
+      vector<tree_workspace_t> workspaces(pool.size());
+      pool.parallel_for(tree_batch.size(),
+                        [&] (size_t i, size_t worker)
+                        {
+                          validate_tree(tree_batch, i, workspaces[worker]);
+                        }, 64);
     }
 
   }
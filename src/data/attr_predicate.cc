@@ -0,0 +1,280 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file attr_predicate.cc
+///
+///  Predicates over cell attribute values, for filtering attributes on the
+///  I/O ranks before they are distributed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+#include "attr_predicate.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    AttrComparison parse_attr_comparison (const string& op)
+    {
+      if (op == "==")
+        return AttrEqual;
+      if (op == "!=")
+        return AttrNotEqual;
+      if (op == "<")
+        return AttrLess;
+      if (op == "<=")
+        return AttrLessEqual;
+      if (op == ">")
+        return AttrGreater;
+      if (op == ">=")
+        return AttrGreaterEqual;
+      throw_assert(false, "parse_attr_comparison: unknown comparison " << op);
+      return AttrEqual;
+    }
+
+    set<string> AttrPredicate::extend_mask (set<string>& attr_mask) const
+    {
+      set<string> added;
+      if (!attr_mask.empty())
+        {
+          for (const attr_condition_t& condition : conditions)
+            {
+              if (attr_mask.insert(condition.attr_name).second)
+                {
+                  added.insert(condition.attr_name);
+                }
+            }
+        }
+      return added;
+    }
+
+    bool compare_attr_value (const AttrComparison comparison, const double a, const double b)
+    {
+      switch (comparison)
+        {
+        case AttrEqual:        return a == b;
+        case AttrNotEqual:     return a != b;
+        case AttrLess:         return a < b;
+        case AttrLessEqual:    return a <= b;
+        case AttrGreater:      return a > b;
+        case AttrGreaterEqual: return a >= b;
+        }
+      return false;
+    }
+
+    /// Condition attribute located in an attribute map.
+    struct located_condition_t
+    {
+      type_index     type;
+      size_t         attr_index;
+      AttrComparison comparison;
+      double         value;
+    };
+
+    template<class T>
+    static bool locate_attr (const NamedAttrMap& attr_values, const string& attr_name,
+                             located_condition_t& located)
+    {
+      auto type_it = attr_values.attr_name_map.find(type_index(typeid(T)));
+      if (type_it != attr_values.attr_name_map.end())
+        {
+          auto name_it = type_it->second.find(attr_name);
+          if (name_it != type_it->second.end())
+            {
+              located.type = type_index(typeid(T));
+              located.attr_index = name_it->second;
+              return true;
+            }
+        }
+      return false;
+    }
+
+    /// Applies a condition to the values of a cell: on the first
+    /// condition, mask is initialized with the matching elements, and
+    /// on later conditions it is narrowed. Returns false if the cell has
+    /// no values of the attribute.
+    template<class T>
+    static bool apply_condition (const NamedAttrMap& attr_values, const located_condition_t& condition,
+                                 const CELL_IDX_T cell, const bool first, vector<bool>& mask)
+    {
+      const map<CELL_IDX_T, deque<T> >& value_map = attr_values.attr_map<T>(condition.attr_index);
+      auto it = value_map.find(cell);
+      if (it == value_map.end())
+        {
+          return false;
+        }
+      const deque<T>& values = it->second;
+      if (first)
+        {
+          mask.assign(values.size(), true);
+        }
+      else
+        {
+          throw_assert(values.size() == mask.size(),
+                       "filter_attr_map: condition attributes of cell " << cell <<
+                       " have different numbers of values");
+        }
+      for (size_t i=0; i<values.size(); i++)
+        {
+          mask[i] = mask[i] && compare_attr_value(condition.comparison, (double)values[i], condition.value);
+        }
+      return true;
+    }
+
+    static bool apply_condition (const NamedAttrMap& attr_values, const located_condition_t& condition,
+                                 const CELL_IDX_T cell, const bool first, vector<bool>& mask)
+    {
+      if (condition.type == type_index(typeid(float)))
+        return apply_condition<float>(attr_values, condition, cell, first, mask);
+      if (condition.type == type_index(typeid(uint8_t)))
+        return apply_condition<uint8_t>(attr_values, condition, cell, first, mask);
+      if (condition.type == type_index(typeid(int8_t)))
+        return apply_condition<int8_t>(attr_values, condition, cell, first, mask);
+      if (condition.type == type_index(typeid(uint16_t)))
+        return apply_condition<uint16_t>(attr_values, condition, cell, first, mask);
+      if (condition.type == type_index(typeid(int16_t)))
+        return apply_condition<int16_t>(attr_values, condition, cell, first, mask);
+      if (condition.type == type_index(typeid(uint32_t)))
+        return apply_condition<uint32_t>(attr_values, condition, cell, first, mask);
+      return apply_condition<int32_t>(attr_values, condition, cell, first, mask);
+    }
+
+    /// Keeps the masked values of a cell in every attribute with as
+    /// many values as the mask.
+    template<class T>
+    static void select_values (vector< map<CELL_IDX_T, deque<T> > >& value_maps,
+                               const CELL_IDX_T cell, const vector<bool>& mask)
+    {
+      for (map<CELL_IDX_T, deque<T> >& value_map : value_maps)
+        {
+          auto it = value_map.find(cell);
+          if ((it != value_map.end()) && (it->second.size() == mask.size()))
+            {
+              deque<T>& values = it->second;
+              size_t k = 0;
+              for (size_t i=0; i<values.size(); i++)
+                {
+                  if (mask[i])
+                    {
+                      values[k++] = values[i];
+                    }
+                }
+              values.resize(k);
+            }
+        }
+    }
+
+    void filter_attr_map (const AttrPredicate& predicate, NamedAttrMap& attr_values)
+    {
+      if (predicate.empty())
+        {
+          return;
+        }
+
+      vector<located_condition_t> conditions;
+      for (const attr_condition_t& condition : predicate.conditions)
+        {
+          located_condition_t located = { type_index(typeid(void)), 0, condition.comparison, condition.value };
+          const bool found =
+            locate_attr<float>(attr_values, condition.attr_name, located) ||
+            locate_attr<uint8_t>(attr_values, condition.attr_name, located) ||
+            locate_attr<int8_t>(attr_values, condition.attr_name, located) ||
+            locate_attr<uint16_t>(attr_values, condition.attr_name, located) ||
+            locate_attr<int16_t>(attr_values, condition.attr_name, located) ||
+            locate_attr<uint32_t>(attr_values, condition.attr_name, located) ||
+            locate_attr<int32_t>(attr_values, condition.attr_name, located);
+          throw_assert(found,
+                       "filter_attr_map: predicate attribute " << condition.attr_name << " not found");
+          conditions.push_back(located);
+        }
+
+      const vector<CELL_IDX_T> cells(attr_values.index_set.begin(), attr_values.index_set.end());
+      vector<bool> mask;
+      for (const CELL_IDX_T cell : cells)
+        {
+          bool has_values = true;
+          for (size_t c=0; has_values && (c<conditions.size()); c++)
+            {
+              has_values = apply_condition(attr_values, conditions[c], cell, c == 0, mask);
+            }
+
+          size_t num_selected = 0;
+          if (has_values)
+            {
+              for (size_t i=0; i<mask.size(); i++)
+                {
+                  num_selected += mask[i] ? 1 : 0;
+                }
+            }
+
+          if (num_selected == 0)
+            {
+              attr_values.erase(cell);
+            }
+          else if (num_selected < mask.size())
+            {
+              select_values(attr_values.float_values, cell, mask);
+              select_values(attr_values.uint8_values, cell, mask);
+              select_values(attr_values.int8_values, cell, mask);
+              select_values(attr_values.uint16_values, cell, mask);
+              select_values(attr_values.int16_values, cell, mask);
+              select_values(attr_values.uint32_values, cell, mask);
+              select_values(attr_values.int32_values, cell, mask);
+            }
+        }
+    }
+
+    template<class T>
+    static void erase_attrs (const set<string>& attr_names, NamedAttrMap& attr_values)
+    {
+      auto type_it = attr_values.attr_name_map.find(type_index(typeid(T)));
+      if (type_it == attr_values.attr_name_map.end())
+        {
+          return;
+        }
+      map<string, size_t>& name_map = type_it->second;
+      vector< map<CELL_IDX_T, deque<T> > >& value_maps = attr_values.attr_maps<T>();
+      for (const string& attr_name : attr_names)
+        {
+          auto attr_it = name_map.find(attr_name);
+          if (attr_it == name_map.end())
+            {
+              continue;
+            }
+          const size_t attr_index = attr_it->second;
+          name_map.erase(attr_it);
+          value_maps.erase(value_maps.begin() + attr_index);
+          for (auto& it : name_map)
+            {
+              if (it.second > attr_index)
+                {
+                  it.second--;
+                }
+            }
+        }
+    }
+
+    void erase_attrs (const set<string>& attr_names, NamedAttrMap& attr_values)
+    {
+      erase_attrs<float>(attr_names, attr_values);
+      erase_attrs<uint8_t>(attr_names, attr_values);
+      erase_attrs<int8_t>(attr_names, attr_values);
+      erase_attrs<uint16_t>(attr_names, attr_values);
+      erase_attrs<int16_t>(attr_names, attr_values);
+      erase_attrs<uint32_t>(attr_names, attr_values);
+      erase_attrs<int32_t>(attr_names, attr_values);
+    }
+
+  }
+}
@@ -0,0 +1,226 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file kd_tree.cc
+///
+///  Static k-d tree over points in three dimensions.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+#include "kd_tree.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    void KDTree::build (const vector<CELL_IDX_T>& ids, const vector<COORD_T>& coords,
+                        size_t leaf_size)
+    {
+      throw_assert(coords.size() == 3*ids.size(),
+                   "KDTree::build: number of coordinates does not match number of points");
+
+      this->leaf_size = (leaf_size > 0) ? leaf_size : 1;
+
+      const size_t n = ids.size();
+      vector<size_t> perm(n);
+      iota(perm.begin(), perm.end(), 0);
+      split_dim.assign(n, 0);
+
+      build_range(0, n, perm, coords);
+
+      index.resize(n);
+      points.resize(3*n);
+      for (size_t i=0; i<n; i++)
+        {
+          index[i] = ids[perm[i]];
+          points[3*i]   = coords[3*perm[i]];
+          points[3*i+1] = coords[3*perm[i]+1];
+          points[3*i+2] = coords[3*perm[i]+2];
+        }
+    }
+
+    void KDTree::build_range (size_t begin, size_t end, vector<size_t>& perm,
+                              const vector<COORD_T>& coords)
+    {
+      if (end - begin <= leaf_size)
+        {
+          return;
+        }
+
+      // split along the dimension of largest extent
+      COORD_T lo[3], hi[3];
+      for (size_t d=0; d<3; d++)
+        {
+          lo[d] = numeric_limits<COORD_T>::max();
+          hi[d] = numeric_limits<COORD_T>::lowest();
+        }
+      for (size_t i=begin; i<end; i++)
+        {
+          for (size_t d=0; d<3; d++)
+            {
+              lo[d] = min(lo[d], coords[3*perm[i]+d]);
+              hi[d] = max(hi[d], coords[3*perm[i]+d]);
+            }
+        }
+      uint8_t dim = 0;
+      for (uint8_t d=1; d<3; d++)
+        {
+          if (hi[d] - lo[d] > hi[dim] - lo[dim])
+            {
+              dim = d;
+            }
+        }
+
+      const size_t middle = begin + (end - begin) / 2;
+      nth_element(perm.begin() + begin, perm.begin() + middle, perm.begin() + end,
+                  [&coords, dim] (size_t a, size_t b)
+                  { return coords[3*a+dim] < coords[3*b+dim]; });
+      split_dim[middle] = dim;
+
+      build_range(begin, middle, perm, coords);
+      build_range(middle+1, end, perm, coords);
+    }
+
+    void KDTree::bounds (COORD_T box[6]) const
+    {
+      for (size_t d=0; d<3; d++)
+        {
+          box[d]   = numeric_limits<COORD_T>::max();
+          box[d+3] = numeric_limits<COORD_T>::lowest();
+        }
+      for (size_t i=0; i<index.size(); i++)
+        {
+          for (size_t d=0; d<3; d++)
+            {
+              box[d]   = min(box[d], points[3*i+d]);
+              box[d+3] = max(box[d+3], points[3*i+d]);
+            }
+        }
+    }
+
+    COORD_T KDTree::distance2 (size_t i, const COORD_T q[3]) const
+    {
+      const COORD_T dx = points[3*i] - q[0], dy = points[3*i+1] - q[1], dz = points[3*i+2] - q[2];
+      return dx*dx + dy*dy + dz*dz;
+    }
+
+    void KDTree::radius_query (const COORD_T q[3], COORD_T radius,
+                               vector<neighbor_t>& result) const
+    {
+      const size_t start = result.size();
+      radius_range(0, index.size(), q, radius*radius, result);
+      for (size_t i=start; i<result.size(); i++)
+        {
+          result[i].first = sqrt(result[i].first);
+        }
+    }
+
+    void KDTree::radius_range (size_t begin, size_t end, const COORD_T q[3], COORD_T radius2,
+                               vector<neighbor_t>& result) const
+    {
+      if (end - begin <= leaf_size)
+        {
+          for (size_t i=begin; i<end; i++)
+            {
+              const COORD_T dist2 = distance2(i, q);
+              if (dist2 <= radius2)
+                {
+                  result.push_back(make_pair(dist2, index[i]));
+                }
+            }
+          return;
+        }
+
+      const size_t middle = begin + (end - begin) / 2;
+      const COORD_T dist2 = distance2(middle, q);
+      if (dist2 <= radius2)
+        {
+          result.push_back(make_pair(dist2, index[middle]));
+        }
+
+      const COORD_T diff = q[split_dim[middle]] - points[3*middle+split_dim[middle]];
+      if ((diff <= 0) || (diff*diff <= radius2))
+        {
+          radius_range(begin, middle, q, radius2, result);
+        }
+      if ((diff >= 0) || (diff*diff <= radius2))
+        {
+          radius_range(middle+1, end, q, radius2, result);
+        }
+    }
+
+    void KDTree::knn_query (const COORD_T q[3], size_t k,
+                            vector<neighbor_t>& result) const
+    {
+      if (k == 0)
+        {
+          return;
+        }
+
+      // max-heap of the k nearest points seen so far
+      vector<neighbor_t> heap;
+      heap.reserve(k+1);
+      knn_range(0, index.size(), q, k, heap);
+
+      sort_heap(heap.begin(), heap.end());
+      for (auto& neighbor : heap)
+        {
+          result.push_back(make_pair(sqrt(neighbor.first), neighbor.second));
+        }
+    }
+
+    void KDTree::knn_range (size_t begin, size_t end, const COORD_T q[3], size_t k,
+                            vector<neighbor_t>& heap) const
+    {
+      auto visit = [&] (size_t i)
+        {
+          const neighbor_t candidate = make_pair(distance2(i, q), index[i]);
+          if (heap.size() < k)
+            {
+              heap.push_back(candidate);
+              push_heap(heap.begin(), heap.end());
+            }
+          else if (candidate < heap.front())
+            {
+              pop_heap(heap.begin(), heap.end());
+              heap.back() = candidate;
+              push_heap(heap.begin(), heap.end());
+            }
+        };
+
+      if (end - begin <= leaf_size)
+        {
+          for (size_t i=begin; i<end; i++)
+            {
+              visit(i);
+            }
+          return;
+        }
+
+      const size_t middle = begin + (end - begin) / 2;
+      visit(middle);
+
+      const COORD_T diff = q[split_dim[middle]] - points[3*middle+split_dim[middle]];
+      const size_t near_begin = (diff <= 0) ? begin : middle+1;
+      const size_t near_end   = (diff <= 0) ? middle : end;
+      const size_t far_begin  = (diff <= 0) ? middle+1 : begin;
+      const size_t far_end    = (diff <= 0) ? end : middle;
+
+      knn_range(near_begin, near_end, q, k, heap);
+      if ((heap.size() < k) || (diff*diff <= heap.front().first))
+        {
+          knn_range(far_begin, far_end, q, k, heap);
+        }
+    }
+
+  }
+}
@@ -0,0 +1,123 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file memory_size.cc
+///
+///  Estimates of the heap memory held by the main data structures,
+///  used for memory accounting.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "memory_size.hh"
+
+#include <deque>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    /// Approximate fixed cost of a std::deque (its block map and one
+    /// partially filled block).
+    const size_t deque_overhead = 8 * sizeof(void*);
+
+    template <class T>
+    static size_t nested_vector_bytes (const vector< vector<T> >& v)
+    {
+      size_t bytes = vector_bytes(v);
+      for (const vector<T>& x : v)
+        {
+          bytes += vector_bytes(x);
+        }
+      return bytes;
+    }
+
+    template <class T>
+    static size_t attr_maps_bytes (const vector< map<CELL_IDX_T, deque<T> > >& maps)
+    {
+      size_t bytes = vector_bytes(maps);
+      for (auto const& m : maps)
+        {
+          bytes += m.size() * (map_node_overhead + sizeof(CELL_IDX_T) + sizeof(deque<T>) + deque_overhead);
+          for (auto const& it : m)
+            {
+              bytes += it.second.size() * sizeof(T);
+            }
+        }
+      return bytes;
+    }
+
+    size_t attr_val_bytes (const AttrVal& v)
+    {
+      return
+        nested_vector_bytes(v.float_values) +
+        nested_vector_bytes(v.uint8_values) +
+        nested_vector_bytes(v.int8_values) +
+        nested_vector_bytes(v.uint16_values) +
+        nested_vector_bytes(v.int16_values) +
+        nested_vector_bytes(v.uint32_values) +
+        nested_vector_bytes(v.int32_values);
+    }
+
+    size_t edge_map_bytes (const edge_map_t& edge_map)
+    {
+      size_t bytes = edge_map.size() * (map_node_overhead + sizeof(edge_map_t::value_type));
+      for (auto const& it : edge_map)
+        {
+          const vector<NODE_IDX_T>& adj_vector = get<0>(it.second);
+          const vector<AttrVal>& edge_attr_values = get<1>(it.second);
+          bytes += vector_bytes(adj_vector) + vector_bytes(edge_attr_values);
+          for (const AttrVal& v : edge_attr_values)
+            {
+              bytes += attr_val_bytes(v);
+            }
+        }
+      return bytes;
+    }
+
+    size_t rank_edge_map_bytes (const rank_edge_map_t& rank_edge_map)
+    {
+      size_t bytes = rank_edge_map.size() * (map_node_overhead + sizeof(rank_edge_map_t::value_type));
+      for (auto const& it : rank_edge_map)
+        {
+          bytes += edge_map_bytes(it.second);
+        }
+      return bytes;
+    }
+
+    size_t attr_map_bytes (const AttrMap& attr_map)
+    {
+      return
+        attr_map.index_set.size() * (map_node_overhead + sizeof(CELL_IDX_T)) +
+        attr_maps_bytes(attr_map.float_values) +
+        attr_maps_bytes(attr_map.uint8_values) +
+        attr_maps_bytes(attr_map.int8_values) +
+        attr_maps_bytes(attr_map.uint16_values) +
+        attr_maps_bytes(attr_map.int16_values) +
+        attr_maps_bytes(attr_map.uint32_values) +
+        attr_maps_bytes(attr_map.int32_values);
+    }
+
+    size_t tree_batch_bytes (const TreeBatch& tree_batch)
+    {
+      return
+        vector_bytes(tree_batch.index) +
+        vector_bytes(tree_batch.attr_ptr) +
+        vector_bytes(tree_batch.sec_ptr) +
+        vector_bytes(tree_batch.topo_ptr) +
+        vector_bytes(tree_batch.src) +
+        vector_bytes(tree_batch.dst) +
+        vector_bytes(tree_batch.sections) +
+        vector_bytes(tree_batch.x) +
+        vector_bytes(tree_batch.y) +
+        vector_bytes(tree_batch.z) +
+        vector_bytes(tree_batch.radius) +
+        vector_bytes(tree_batch.layer) +
+        vector_bytes(tree_batch.parent) +
+        vector_bytes(tree_batch.swc_type);
+    }
+
+  }
+}
@@ -156,35 +156,44 @@ namespace neuroh5
                 iarchive(edge_map); // Read the data from the archive
               }
               
-              for (auto it = edge_map.cbegin(); it != edge_map.cend(); ++it)
+              merge_edge_map(edge_map, prj_edge_map, num_unpacked_nodes, num_unpacked_edges);
+            }
+        }
+    }
+
+    void merge_edge_map (edge_map_t& edge_map,
+                         edge_map_t& prj_edge_map,
+                         size_t& num_merged_nodes,
+                         size_t& num_merged_edges
+                         )
+    {
+      for (auto it = edge_map.begin(); it != edge_map.end(); ++it)
+        {
+          NODE_IDX_T key_node = it->first;
+          vector<NODE_IDX_T>&  adj_vector = get<0>(it->second);
+          vector<data::AttrVal>&    edge_attr_values = get<1>(it->second);
+          num_merged_edges += adj_vector.size();
+
+          auto prj_it = prj_edge_map.find(key_node);
+          if (prj_it == prj_edge_map.end())
+            {
+              num_merged_nodes ++;
+              prj_edge_map.insert(make_pair(key_node, std::move(it->second)));
+            }
+          else
+            {
+              vector<NODE_IDX_T> &v = get<0>(prj_it->second);
+              vector <data::AttrVal> &va = get<1>(prj_it->second);
+              v.insert(v.end(),adj_vector.begin(),adj_vector.end());
+              size_t ni=0;
+              for (auto & a : va)
                 {
-                  NODE_IDX_T key_node = it->first;
-                  const vector<NODE_IDX_T>&  adj_vector = get<0>(it->second);
-                  const vector<data::AttrVal>&    edge_attr_values = get<1>(it->second);
-                  num_unpacked_edges += adj_vector.size();
-                  
-                  if (prj_edge_map.find(key_node) == prj_edge_map.end())
-                    {
-                      num_unpacked_nodes ++;
-                      prj_edge_map.insert(make_pair(key_node,make_tuple(adj_vector, edge_attr_values)));
-                    }
-                  else
-                    {
-                      edge_tuple_t et = prj_edge_map[key_node];
-                      vector<NODE_IDX_T> &v = get<0>(et);
-                      vector <data::AttrVal> &va = get<1>(et);
-                      v.insert(v.end(),adj_vector.begin(),adj_vector.end());
-                      size_t ni=0;
-                      for (auto & a : va)
-                        {
-                          a.append(edge_attr_values[ni]);
-                          ni++;
-                        }
-                      prj_edge_map[key_node] = make_tuple(v,va);
-                    }
+                  a.append(edge_attr_values[ni]);
+                  ni++;
                 }
             }
         }
+      edge_map.clear();
     }
 
     
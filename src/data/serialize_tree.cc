@@ -168,5 +168,95 @@ namespace neuroh5
         }
     }
 
+    void serialize_rank_tree_batch (const size_t num_ranks,
+                                    const size_t start_rank,
+                                    const map <rank_t, TreeBatch>& rank_tree_batch,
+                                    vector<int>& sendcounts,
+                                    vector<char> &sendbuf,
+                                    vector<int> &sdispls)
+    {
+      vector<int> rank_sequence;
+
+      sdispls.resize(num_ranks);
+      sendcounts.resize(num_ranks);
+
+      int end_rank = num_ranks;
+      throw_assert(start_rank < end_rank, "serialize_rank_tree_batch: invalid start rank");
+
+      // Recommended all-to-all communication pattern: start at the current rank, then wrap around;
+      // (as opposed to starting at rank 0)
+      for (int key_rank = start_rank; key_rank < end_rank; key_rank++)
+        {
+          rank_sequence.push_back(key_rank);
+        }
+      for (int key_rank = 0; key_rank < (int)start_rank; key_rank++)
+        {
+          rank_sequence.push_back(key_rank);
+        }
+
+      size_t sendpos = 0;
+      std::stringstream ss(ios::in | ios::out | ios::binary);
+      for (const int& key_rank : rank_sequence)
+        {
+          sdispls[key_rank] = sendpos;
+
+          auto it1 = rank_tree_batch.find(key_rank);
+          if (it1 != rank_tree_batch.end())
+            {
+              {
+                cereal::BinaryOutputArchive oarchive(ss);
+                oarchive(it1->second);
+              }
+              ss.seekg(0, ios::end);
+              sendpos = ss.tellg();
+            }
+
+          sendcounts[key_rank] = sendpos - sdispls[key_rank];
+        }
+      const string& sstr = ss.str();
+      sendbuf.reserve(sendbuf.size() + sstr.size());
+      copy(sstr.begin(), sstr.end(), back_inserter(sendbuf));
+    }
+
+
+    void deserialize_rank_tree_batch (const size_t num_ranks,
+                                      const vector<char> &recvbuf,
+                                      const vector<int>& recvcounts,
+                                      const vector<int>& rdispls,
+                                      TreeBatch &all_tree_batch)
+    {
+      const int recvbuf_size = recvbuf.size();
+
+      for (size_t ridx = 0; ridx < num_ranks; ridx++)
+        {
+          if (recvcounts[ridx] > 0)
+            {
+              int recvsize  = recvcounts[ridx];
+              int recvpos   = rdispls[ridx];
+              throw_assert(recvpos < recvbuf_size,
+                           "deserialize_rank_tree_batch: invalid buffer displacement");
+
+              TreeBatch tree_batch;
+              {
+                const string& s = string(recvbuf.begin()+recvpos, recvbuf.begin()+recvpos+recvsize);
+                stringstream ss(s, ios::in | ios::out | ios::binary);
+
+                cereal::BinaryInputArchive iarchive(ss);
+                iarchive(tree_batch);
+              }
+              tree_batch.validate();
+
+              if (all_tree_batch.empty())
+                {
+                  std::swap(all_tree_batch, tree_batch);
+                }
+              else
+                {
+                  all_tree_batch.append(tree_batch);
+                }
+            }
+        }
+    }
+
   }
 }
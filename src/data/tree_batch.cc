@@ -0,0 +1,239 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_batch.cc
+///
+///  Contiguous column storage for a set of trees.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <algorithm>
+#include <numeric>
+
+#include "tree_batch.hh"
+#include "path_names.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    uint32_t tree_field_mask (const set<string>& tree_mask)
+    {
+      if (tree_mask.empty())
+        {
+          return TreeFieldAll;
+        }
+
+      static const map<string, uint32_t> field_names =
+        {
+          { hdf5::X_COORD, TreeFieldX },
+          { hdf5::Y_COORD, TreeFieldY },
+          { hdf5::Z_COORD, TreeFieldZ },
+          { hdf5::RADIUS,  TreeFieldRadius },
+          { hdf5::LAYER,   TreeFieldLayer },
+          { hdf5::PARENT,  TreeFieldParent },
+          { hdf5::SWCTYPE, TreeFieldSWCType },
+          { hdf5::SRCSEC,  TreeFieldSrc },
+          { hdf5::DSTSEC,  TreeFieldDst },
+          { hdf5::SECTION, TreeFieldSections }
+        };
+
+      uint32_t fields = 0;
+      for (const string& name : tree_mask)
+        {
+          auto it = field_names.find(name);
+          throw_assert(it != field_names.end(),
+                       "tree_field_mask: unknown tree attribute " << name);
+          fields |= it->second;
+        }
+      return fields;
+    }
+
+    TreeBatch::TreeBatch ()
+      : fields(TreeFieldAll)
+    {
+      clear();
+    }
+
+    /// Removes all trees; the set of fields is unchanged.
+    void TreeBatch::clear ()
+    {
+      index.clear();
+      attr_ptr.assign(1, 0);
+      sec_ptr.assign(1, 0);
+      topo_ptr.assign(1, 0);
+      src.clear();
+      dst.clear();
+      sections.clear();
+      x.clear();
+      y.clear();
+      z.clear();
+      radius.clear();
+      layer.clear();
+      parent.clear();
+      swc_type.clear();
+    }
+
+    void TreeBatch::validate () const
+    {
+      const size_t n = index.size();
+      throw_assert((attr_ptr.size() == n+1) && (sec_ptr.size() == n+1) && (topo_ptr.size() == n+1),
+                   "TreeBatch: pointer arrays do not match number of trees");
+      throw_assert((attr_ptr[0] == 0) && (sec_ptr[0] == 0) && (topo_ptr[0] == 0),
+                   "TreeBatch: pointer arrays must start at zero");
+      for (size_t i=0; i<n; i++)
+        {
+          throw_assert((attr_ptr[i] <= attr_ptr[i+1]) && (sec_ptr[i] <= sec_ptr[i+1]) &&
+                       (topo_ptr[i] <= topo_ptr[i+1]),
+                       "TreeBatch: pointer arrays must be non-decreasing");
+        }
+      const size_t num_points = attr_ptr[n];
+      auto column_size = [this] (uint32_t f, size_t len) { return has(f) ? len : 0; };
+      throw_assert((x.size() == column_size(TreeFieldX, num_points)) &&
+                   (y.size() == column_size(TreeFieldY, num_points)) &&
+                   (z.size() == column_size(TreeFieldZ, num_points)) &&
+                   (radius.size() == column_size(TreeFieldRadius, num_points)) &&
+                   (layer.size() == column_size(TreeFieldLayer, num_points)) &&
+                   (parent.size() == column_size(TreeFieldParent, num_points)) &&
+                   (swc_type.size() == column_size(TreeFieldSWCType, num_points)),
+                   "TreeBatch: point attribute columns do not match attribute pointer");
+      throw_assert(sections.size() == column_size(TreeFieldSections, sec_ptr[n]),
+                   "TreeBatch: section column does not match section pointer");
+      throw_assert((src.size() == column_size(TreeFieldSrc, topo_ptr[n])) &&
+                   (dst.size() == column_size(TreeFieldDst, topo_ptr[n])),
+                   "TreeBatch: topology columns do not match topology pointer");
+    }
+
+    void TreeBatch::match_fields (const TreeBatch& other)
+    {
+      if (empty())
+        {
+          fields = other.fields;
+        }
+      throw_assert(fields == other.fields,
+                   "TreeBatch::append: batches have different fields");
+    }
+
+    void TreeBatch::append (const neurotree_t& tree)
+    {
+      const std::deque<SECTION_IDX_T> & tree_src=get<1>(tree);
+      const std::deque<SECTION_IDX_T> & tree_dst=get<2>(tree);
+      const std::deque<SECTION_IDX_T> & tree_sections=get<3>(tree);
+      const std::deque<COORD_T> & tree_x=get<4>(tree);
+
+      throw_assert(tree_src.size() == tree_dst.size(),
+                   "TreeBatch::append: mismatch between section source and destination vectors");
+      throw_assert((get<5>(tree).size() == tree_x.size()) && (get<6>(tree).size() == tree_x.size()) &&
+                   (get<7>(tree).size() == tree_x.size()) && (get<8>(tree).size() == tree_x.size()) &&
+                   (get<9>(tree).size() == tree_x.size()) && (get<10>(tree).size() == tree_x.size()),
+                   "TreeBatch::append: mismatch between point attribute vectors");
+
+      index.push_back(get<0>(tree));
+      append_deque(TreeFieldSrc, tree_src, src);
+      append_deque(TreeFieldDst, tree_dst, dst);
+      append_deque(TreeFieldSections, tree_sections, sections);
+      append_deque(TreeFieldX, tree_x, x);
+      append_deque(TreeFieldY, get<5>(tree), y);
+      append_deque(TreeFieldZ, get<6>(tree), z);
+      append_deque(TreeFieldRadius, get<7>(tree), radius);
+      append_deque(TreeFieldLayer, get<8>(tree), layer);
+      append_deque(TreeFieldParent, get<9>(tree), parent);
+      append_deque(TreeFieldSWCType, get<10>(tree), swc_type);
+
+      attr_ptr.push_back(attr_ptr.back() + tree_x.size());
+      sec_ptr.push_back(sec_ptr.back() + tree_sections.size());
+      topo_ptr.push_back(topo_ptr.back() + tree_src.size());
+    }
+
+    void TreeBatch::append (const TreeBatch& other, size_t i)
+    {
+      match_fields(other);
+
+      index.push_back(other.index[i]);
+      append_range(TreeFieldSrc, other.src, other.topo_ptr, i, src);
+      append_range(TreeFieldDst, other.dst, other.topo_ptr, i, dst);
+      append_range(TreeFieldSections, other.sections, other.sec_ptr, i, sections);
+      append_range(TreeFieldX, other.x, other.attr_ptr, i, x);
+      append_range(TreeFieldY, other.y, other.attr_ptr, i, y);
+      append_range(TreeFieldZ, other.z, other.attr_ptr, i, z);
+      append_range(TreeFieldRadius, other.radius, other.attr_ptr, i, radius);
+      append_range(TreeFieldLayer, other.layer, other.attr_ptr, i, layer);
+      append_range(TreeFieldParent, other.parent, other.attr_ptr, i, parent);
+      append_range(TreeFieldSWCType, other.swc_type, other.attr_ptr, i, swc_type);
+
+      attr_ptr.push_back(attr_ptr.back() + other.num_points(i));
+      sec_ptr.push_back(sec_ptr.back() + (other.sec_ptr[i+1] - other.sec_ptr[i]));
+      topo_ptr.push_back(topo_ptr.back() + (other.topo_ptr[i+1] - other.topo_ptr[i]));
+    }
+
+    template <class P>
+    static void append_ptr (const vector<P>& from, vector<P>& to)
+    {
+      const P base = to.back();
+      for (size_t i=1; i<from.size(); i++)
+        {
+          to.push_back(base + from[i]);
+        }
+    }
+
+    void TreeBatch::append (const TreeBatch& other)
+    {
+      match_fields(other);
+
+      index.insert(index.end(), other.index.begin(), other.index.end());
+      append_ptr(other.attr_ptr, attr_ptr);
+      append_ptr(other.sec_ptr, sec_ptr);
+      append_ptr(other.topo_ptr, topo_ptr);
+      src.insert(src.end(), other.src.begin(), other.src.end());
+      dst.insert(dst.end(), other.dst.begin(), other.dst.end());
+      sections.insert(sections.end(), other.sections.begin(), other.sections.end());
+      x.insert(x.end(), other.x.begin(), other.x.end());
+      y.insert(y.end(), other.y.begin(), other.y.end());
+      z.insert(z.end(), other.z.begin(), other.z.end());
+      radius.insert(radius.end(), other.radius.begin(), other.radius.end());
+      layer.insert(layer.end(), other.layer.begin(), other.layer.end());
+      parent.insert(parent.end(), other.parent.begin(), other.parent.end());
+      swc_type.insert(swc_type.end(), other.swc_type.begin(), other.swc_type.end());
+    }
+
+    template <class T>
+    static deque<T> to_deque (const column_view<T>& v)
+    {
+      return deque<T>(v.begin(), v.end());
+    }
+
+    neurotree_t TreeBatch::tree (size_t i) const
+    {
+      return make_tuple(index[i],
+                        to_deque(tree_src(i)), to_deque(tree_dst(i)), to_deque(tree_sections(i)),
+                        to_deque(tree_x(i)), to_deque(tree_y(i)), to_deque(tree_z(i)),
+                        to_deque(tree_radius(i)), to_deque(tree_layer(i)),
+                        to_deque(tree_parent(i)), to_deque(tree_swc_type(i)));
+    }
+
+    void TreeBatch::to_list (forward_list<neurotree_t>& tree_list) const
+    {
+      vector<size_t> order(size());
+      iota(order.begin(), order.end(), 0);
+      stable_sort(order.begin(), order.end(),
+                  [this] (size_t a, size_t b) { return index[a] < index[b]; });
+      for (size_t i : order)
+        {
+          tree_list.push_front(tree(i));
+        }
+    }
+
+    void TreeBatch::to_map (map<CELL_IDX_T, neurotree_t>& tree_map) const
+    {
+      for (size_t i=0; i<size(); i++)
+        {
+          tree_map.insert(make_pair(index[i], tree(i)));
+        }
+    }
+
+  }
+}
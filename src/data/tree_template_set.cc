@@ -0,0 +1,107 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file tree_template_set.cc
+///
+///  Trees given as references to shared morphology templates.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "tree_template_set.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace data
+  {
+
+    void TreeTemplateSet::clear ()
+    {
+      templates.clear();
+      index.clear();
+      template_index.clear();
+      offset.clear();
+      template_pos.clear();
+    }
+
+    size_t TreeTemplateSet::find_template (CELL_IDX_T template_id) const
+    {
+      if (template_pos.size() != templates.size())
+        {
+          template_pos.clear();
+          for (size_t i=0; i<templates.size(); i++)
+            {
+              template_pos.insert(make_pair(templates.index[i], i));
+            }
+        }
+      auto it = template_pos.find(template_id);
+      if (it == template_pos.end())
+        {
+          return templates.size();
+        }
+      return it->second;
+    }
+
+    void TreeTemplateSet::append_ref (CELL_IDX_T gid, CELL_IDX_T template_id,
+                                      COORD_T dx, COORD_T dy, COORD_T dz)
+    {
+      index.push_back(gid);
+      template_index.push_back(template_id);
+      offset.push_back(dx);
+      offset.push_back(dy);
+      offset.push_back(dz);
+    }
+
+    void TreeTemplateSet::append_ref (const TreeTemplateSet& other, size_t i)
+    {
+      const CELL_IDX_T template_id = other.template_index[i];
+      if (find_template(template_id) == templates.size())
+        {
+          size_t pos = other.find_template(template_id);
+          throw_assert(pos < other.templates.size(),
+                       "TreeTemplateSet::append_ref: template " << template_id << " not found");
+          templates.append(other.templates, pos);
+        }
+      append_ref(other.index[i], template_id,
+                 other.offset[3*i], other.offset[3*i+1], other.offset[3*i+2]);
+    }
+
+    static void translate (const TreeBatch& tree_batch, uint32_t f, COORD_T d,
+                           ATTR_PTR_T start, ATTR_PTR_T end, vector<COORD_T>& coords)
+    {
+      if ((d != 0.0) && tree_batch.has(f))
+        {
+          for (ATTR_PTR_T p=start; p<end; p++)
+            {
+              coords[p] += d;
+            }
+        }
+    }
+
+    void TreeTemplateSet::resolve (TreeBatch& tree_batch) const
+    {
+      throw_assert((template_index.size() == index.size()) && (offset.size() == 3*index.size()),
+                   "TreeTemplateSet::resolve: reference arrays do not match number of cells");
+
+      for (size_t i=0; i<index.size(); i++)
+        {
+          size_t pos = find_template(template_index[i]);
+          throw_assert(pos < templates.size(),
+                       "TreeTemplateSet::resolve: template " << template_index[i] <<
+                       " of cell " << index[i] << " not found");
+
+          tree_batch.append(templates, pos);
+          tree_batch.index.back() = index[i];
+
+          const size_t n = tree_batch.size();
+          const ATTR_PTR_T start = tree_batch.attr_ptr[n-1], end = tree_batch.attr_ptr[n];
+          translate(tree_batch, TreeFieldX, offset[3*i], start, end, tree_batch.x);
+          translate(tree_batch, TreeFieldY, offset[3*i+1], start, end, tree_batch.y);
+          translate(tree_batch, TreeFieldZ, offset[3*i+2], start, end, tree_batch.z);
+        }
+    }
+
+  }
+}
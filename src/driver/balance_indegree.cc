@@ -26,6 +26,7 @@
 #include <map>
 #include <set>
 #include <vector>
+#include <algorithm>
 
 #include <mpi.h>
 
@@ -67,7 +68,7 @@ void print_usage_full(char** argv)
 int main(int argc, char** argv)
 {
   std::string input_file_name, output;
-  size_t nparts = 0, iosize = 0;
+  size_t nparts = 0;
   
   throw_assert(MPI_Init(&argc, &argv) >= 0,
                "balance_indegree: error in MPI initialization");
@@ -82,21 +83,18 @@ int main(int argc, char** argv)
   
   // parse arguments
   int optflag_nparts = 0;
-  int optflag_iosize = 0;
   int optflag_output = 0;
   bool opt_nparts = false,
-    opt_iosize = false,
     opt_output = false;
 
   static struct option long_options[] = {
     {"output",    required_argument, &optflag_output,  1 },
     {"nparts",    required_argument, &optflag_nparts,  1 },
-    {"iosize",    required_argument, &optflag_iosize,  1 },
     {0,         0,                 0,  0 }
   };
   char c;
   int option_index = 0;
-  while ((c = getopt_long (argc, argv, "hi:n:o:",
+  while ((c = getopt_long (argc, argv, "hn:o:",
 			   long_options, &option_index)) != -1)
     {
       stringstream ss;
@@ -109,12 +107,6 @@ int main(int argc, char** argv)
             ss >> nparts;
             optflag_nparts=0;
           }
-          if (optflag_iosize == 1) {
-            opt_iosize = true;
-            ss << string(optarg);
-            ss >> iosize;
-            optflag_iosize=0;
-          }
           if (optflag_output == 1) {
             opt_output = true;
             output = string(optarg);
@@ -130,11 +122,6 @@ int main(int argc, char** argv)
           ss << string(optarg);
           ss >> nparts;
           break;
-        case 'i':
-          opt_iosize = true;
-          ss << string(optarg);
-          ss >> iosize;
-          break;
         case 'h':
           print_usage_full(argv);
           exit(0);
@@ -154,30 +141,62 @@ int main(int argc, char** argv)
       exit(1);
     }
 
-  if (!opt_iosize) iosize = 4;
-
   vector< pair<string,string> > prj_names;
   throw_assert(graph::read_projection_names(MPI_COMM_WORLD, input_file_name, prj_names) >= 0,
                "balance_indegree: error reading projection names");
 
-  vector<edge_map_t> prj_list;
-  
-  std::vector<NODE_IDX_T> parts;
+  NODE_IDX_T node_start;
+  std::vector<NODE_IDX_T> local_parts;
   std::vector<double> part_weights;
+  std::vector<size_t> part_sizes;
   
   graph::balance_graph_indegree
   (
    MPI_COMM_WORLD,
    input_file_name,
    prj_names,
-   iosize,
    nparts,
-   parts,
-   part_weights
+   node_start,
+   local_parts,
+   part_weights,
+   part_sizes
    );
 
+  // the ranks hold the parts of consecutive ranges of nodes
+  int num_local_parts = local_parts.size();
+  std::vector<int> recvcounts(size, 0), displs(size, 0);
+  throw_assert(MPI_Gather(&num_local_parts, 1, MPI_INT, &recvcounts[0], 1, MPI_INT,
+                          0, MPI_COMM_WORLD) == MPI_SUCCESS,
+               "balance_indegree: error in MPI_Gather");
+  std::vector<NODE_IDX_T> parts;
   if (rank == 0)
     {
+      for (int r = 1; r < size; r++)
+        {
+          displs[r] = displs[r-1] + recvcounts[r-1];
+        }
+      parts.resize(displs[size-1] + recvcounts[size-1]);
+    }
+  throw_assert(MPI_Gatherv(local_parts.data(), num_local_parts, MPI_NODE_IDX_T,
+                           parts.data(), &recvcounts[0], &displs[0], MPI_NODE_IDX_T,
+                           0, MPI_COMM_WORLD) == MPI_SUCCESS,
+               "balance_indegree: error in MPI_Gatherv");
+
+  if (rank == 0)
+    {
+      double max_weight = 0.0, sum_weight = 0.0;
+      size_t max_size = 0, sum_size = 0;
+      for (size_t p = 0; p < nparts; p++)
+        {
+          max_weight = std::max(max_weight, part_weights[p]);
+          sum_weight += part_weights[p];
+          max_size = std::max(max_size, part_sizes[p]);
+          sum_size += part_sizes[p];
+        }
+      fprintf(stderr, "balance_indegree: max/mean part in-degree %g, max/mean part size %g\n",
+              sum_weight > 0.0 ? max_weight * nparts / sum_weight : 1.0,
+              sum_size > 0 ? (double)max_size * nparts / sum_size : 1.0);
+
       if (!opt_output)
         {
           for (size_t i = 0; i < parts.size(); i++)
@@ -14,9 +14,10 @@
 #include "cell_populations.hh"
 #include "projection_names.hh"
 #include "read_syn_projection.hh"
-#include "read_txt_projection.hh"
+#include "read_txt_edges.hh"
 #include "rank_range.hh"
 #include "write_graph.hh"
+#include "append_graph_edges.hh"
 #include "attr_map.hh"
 #include "attr_val.hh"
 #include "tokenize.hh"
@@ -64,10 +65,10 @@ void throw_err(char const* err_message, int32_t task, int32_t thread)
 
 void print_usage_full(char** argv)
 {
-  printf("Usage: %s  <SRC-POP> <DST-POP> <OUTPUT-FILE> \n\n", argv[0]);
+  printf("Usage: %s  <SRC-POP> <DST-POP> <OUTPUT-FILE> [<INPUT-FILE>...]\n\n", argv[0]);
   printf("Options:\n");
   printf("\t-i <FILE>:\n");
-  printf("\t\tImport from given file\n");
+  printf("\t\tImport from the text files listed in the given file\n");
   printf("\t-f <FORMAT>:\n");
   printf("\t\tInput format\n");
 
@@ -146,134 +147,76 @@ int append_syn_adj_map
 }
 
 
-int append_adj_map
+template <class T>
+static void select_edge_column
+(
+ const vector<size_t>& selection,
+ vector<T>&            column
+ )
+{
+  vector<T> selected_column(selection.size());
+  for (size_t i = 0; i < selection.size(); i++)
+    {
+      selected_column[i] = column[selection[i]];
+    }
+  column.swap(selected_column);
+}
+
+template <class T>
+static void select_edge_attr_columns
+(
+ const vector<size_t>& selection,
+ vector< vector<T> >&  columns
+ )
+{
+  for (auto & column : columns)
+    {
+      select_edge_column(selection, column);
+    }
+}
+
+// Removes edges with source indices outside of the given range and
+// applies the source and destination offsets
+void filter_edge_columns
 (
  const vector<NODE_IDX_T>&   src_range,
  const int src_offset, const int dst_offset,
- const vector<NODE_IDX_T>&   dst_idx,
- const vector<DST_PTR_T>&    src_idx_ptr,
- const vector<NODE_IDX_T>&   src_idx,
- const map <string, data::AttrVal>& edge_attr_map,
- size_t&                     num_edges,
- edge_map_t&                 edge_map
+ vector<NODE_IDX_T>&         dst,
+ vector<NODE_IDX_T>&         src,
+ map <string, data::NamedAttrVal>& edge_attr_map
  )
 {
-  int ierr = 0; 
-  num_edges = 0;
-
-  if (dst_idx.size() > 0)
+  vector<size_t> selection;
+  for (size_t i = 0; i < src.size(); i++)
     {
-      for (size_t d = 0; d < dst_idx.size(); d++)
+      if (src[i] <= src_range[1] && src[i] >= src_range[0])
         {
-          NODE_IDX_T dst = dst_idx[d] + dst_offset;
-
-          size_t low_src_ptr = src_idx_ptr[d],
-            high_src_ptr = src_idx_ptr[d+1];
-
-          vector<NODE_IDX_T> adj_vector;
-          vector <data::AttrVal> edge_attr_values_vector(edge_attr_map.size());
-
-          {
-            size_t ns_index=0;
-            for (auto iter : edge_attr_map)
-              {
-                auto & edge_attrs = iter.second;
-                auto & edge_attr_values = edge_attr_values_vector[ns_index];
-                edge_attr_values.resize<float>(edge_attrs.size_attr_vec<float> ());
-                edge_attr_values.resize<uint8_t>(edge_attrs.size_attr_vec<uint8_t> ());
-                edge_attr_values.resize<uint16_t>(edge_attrs.size_attr_vec<uint16_t> ());
-                edge_attr_values.resize<uint32_t>(edge_attrs.size_attr_vec<uint32_t> ());
-                edge_attr_values.resize<int8_t>(edge_attrs.size_attr_vec<int8_t> ());
-                edge_attr_values.resize<int16_t>(edge_attrs.size_attr_vec<int16_t> ());
-                edge_attr_values.resize<int32_t>(edge_attrs.size_attr_vec<int32_t> ());
-                ns_index++;
-              }
-          }
-          
-          for (size_t i = low_src_ptr; i < high_src_ptr; ++i)
-            {
-              NODE_IDX_T src = src_idx[i];
-              if (src <= src_range[1] && src >= src_range[0])
-                {
-                  NODE_IDX_T src1 = src + src_offset;
-                  adj_vector.push_back(src1);
-                  size_t ns_index = 0;
-                  for (auto iter : edge_attr_map)
-                    {
-                      auto & edge_attrs = iter.second;
-                      auto & edge_attr_values = edge_attr_values_vector[ns_index];
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<float> (); ai++)
-                        {
-                          float v = edge_attrs.at<float>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<uint8_t> (); ai++)
-                        {
-                          uint8_t v = edge_attrs.at<uint8_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<uint16_t> (); ai++)
-                        {
-                          uint16_t v = edge_attrs.at<uint16_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<uint32_t> (); ai++)
-                        {
-                          uint32_t v = edge_attrs.at<uint32_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<int8_t> (); ai++)
-                        {
-                          int8_t v = edge_attrs.at<int8_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<int16_t> (); ai++)
-                        {
-                          int16_t v = edge_attrs.at<int16_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      for (size_t ai=0; ai<edge_attrs.size_attr_vec<int32_t> (); ai++)
-                        {
-                          int32_t v = edge_attrs.at<int32_t>(ai, i);
-                          edge_attr_values.push_back(ai, v);
-                        }
-                      ns_index++;
-                    }
-                  num_edges++;
-                }
-            }
-
-          if (num_edges > 0)
-            {
-              if (edge_map.find(dst) == edge_map.end())
-                {
-                  edge_map.insert(make_pair(dst,make_tuple(adj_vector, edge_attr_values_vector)));
-                }
-              else
-                {
-                  edge_tuple_t et = edge_map[dst];
-                  vector<NODE_IDX_T> &v = get<0>(et);
-                  vector <data::AttrVal> &va = get<1>(et);
-                  v.insert(v.end(),adj_vector.begin(),adj_vector.end());
-                  size_t ns_index = 0;
-                  for (auto & a : va)
-                    {
-                      a.append(edge_attr_values_vector[ns_index]);
-                      ns_index++;
-                    }
-                  edge_map[dst] = make_tuple(v,va);
-                }
-            }
-
+          selection.push_back(i);
         }
     }
 
+  select_edge_column(selection, dst);
+  select_edge_column(selection, src);
+  for (auto & iter : edge_attr_map)
+    {
+      data::NamedAttrVal& edge_attr = iter.second;
+      select_edge_attr_columns(selection, edge_attr.float_values);
+      select_edge_attr_columns(selection, edge_attr.uint8_values);
+      select_edge_attr_columns(selection, edge_attr.uint16_values);
+      select_edge_attr_columns(selection, edge_attr.uint32_values);
+      select_edge_attr_columns(selection, edge_attr.int8_values);
+      select_edge_attr_columns(selection, edge_attr.int16_values);
+      select_edge_attr_columns(selection, edge_attr.int32_values);
+    }
 
-  return ierr;
+  for (size_t i = 0; i < dst.size(); i++)
+    {
+      dst[i] += dst_offset;
+      src[i] += src_offset;
+    }
 }
 
 
-
 /*****************************************************************************
  * Main driver
  *****************************************************************************/
@@ -532,6 +475,10 @@ int main(int argc, char** argv)
       src_pop_name     = std::string(argv[optind]);
       dst_pop_name     = std::string(argv[optind+1]);
       output_file_name = std::string(argv[optind+2]);
+      for (int i = optind+3; i < argc; i++)
+        {
+          txt_input_file_names.push_back(std::string(argv[i]));
+        }
       if (!opt_hdf5_syn && (!opt_txt))
         {
           print_usage_full(argv);
@@ -604,38 +551,35 @@ int main(int argc, char** argv)
 
     }
 
-  if (opt_txt)
-        {
-          ifstream infile(txt_filelist_file_name);
-          string line;
+  if (opt_txt && (!txt_filelist_file_name.empty()))
+    {
+      ifstream infile(txt_filelist_file_name);
+      string line;
           
-          while (getline(infile, line))
+      while (getline(infile, line))
+        {
+          stringstream ss;
+          string file_name;
+          ss << line;
+          ss >> file_name;
+          if (!file_name.empty())
             {
-              stringstream ss;
-              string file_name;
-              ss << line;
-              ss >> file_name;
               txt_input_file_names.push_back(file_name);
             }
         }
+    }
   
-  map <string, data::AttrVal> edge_attrs;
+  // each rank parses an equal share of the bytes of all input files
+  vector<NODE_IDX_T> txt_dst, txt_src;
+  map <string, data::NamedAttrVal> txt_edge_attrs;
   if (opt_txt)
     {
-      // determine which connection files are read by which rank
-      vector< pair<hsize_t,hsize_t> > ranges;
-      mpi::rank_ranges(txt_input_file_names.size(), size, ranges);
-      
-      hsize_t start=ranges[rank].first, end=ranges[rank].first+ranges[rank].second;
-
-      for (size_t i=start; i<end; i++)
-        {
-          string txt_input_file_name = txt_input_file_names[i];
-          
-          status = io::read_txt_projection (txt_input_file_name, num_edge_attrs,
-                                            dst_idx, src_idx_ptr, src_idx,
-                                            edge_attrs);
-        }
+      status = io::read_txt_edges (all_comm, txt_input_file_names, num_edge_attrs,
+                                   txt_dst, txt_src, txt_edge_attrs);
+      throw_assert(status == 0,
+                   "neurograph_import: error in reading text edge lists");
+      filter_edge_columns (src_range, src_offset, dst_offset,
+                           txt_dst, txt_src, txt_edge_attrs);
     }
 
   edge_map_t edge_map;
@@ -664,24 +608,25 @@ int main(int argc, char** argv)
     }
   
 
-  if (syn_idx.size() > 0)
+  if (opt_txt)
+    {
+      // edges are redistributed by destination and written collectively
+      status = graph::append_graph_edges (all_comm, io_size, output_file_name,
+                                          src_pop_name, dst_pop_name,
+                                          edge_attr_index, txt_dst, txt_src,
+                                          txt_edge_attrs);
+    }
+  else
     {
       status = append_syn_adj_map (src_range, src_offset, dst_offset,
                                    dst_idx, src_idx_ptr, src_idx,
                                    syn_idx_ptr, syn_idx,
                                    num_edges, edge_map);
-    }
-  else
-    {
-      status = append_adj_map (src_range, src_offset, dst_offset,
-                               dst_idx, src_idx_ptr, src_idx,
-                               edge_attrs, num_edges, edge_map);
-    }
 
-
-  status = graph::write_graph (all_comm, io_size, output_file_name,
-                               src_pop_name, dst_pop_name,
-                               edge_attr_index, edge_map);
+      status = graph::write_graph (all_comm, io_size, output_file_name,
+                                   src_pop_name, dst_pop_name,
+                                   edge_attr_index, edge_map);
+    }
 
   MPI_Comm_free(&all_comm);
   
@@ -1,22 +1,23 @@
 // -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
 //==============================================================================
-///  @file parts.cc
+///  @file neurograph_parts.cc
 ///
-///  Driver program for graph partitioning functions.
+///  Driver program for the label propagation graph partitioner.
 ///
-///  Copyright (C) 2016-2018 Project NeuroH5.
+///  Copyright (C) 2016-2022 Project NeuroH5.
 //==============================================================================
 
 
 #include "debug.hh"
 
 #include "neuroh5_types.hh"
-#include "read_graph.hh"
-#include "graph_parts.hh"
+#include "cell_populations.hh"
 #include "projection_names.hh"
+#include "partition_graph_lp.hh"
+#include "node_rank_map_attributes.hh"
+#include "throw_assert.hh"
 
 #include <getopt.h>
-#include <cassert>
 #include <cstdio>
 #include <cstdlib>
 #include <iostream>
@@ -28,10 +29,9 @@
 #include <vector>
 
 #include <mpi.h>
-#include <parmetis.h>
 
 using namespace std;
-using namespace ngh5;
+using namespace neuroh5;
 
 void throw_err(char const* err_message)
 {
@@ -54,8 +54,22 @@ void throw_err(char const* err_message, int32_t task, int32_t thread)
 
 void print_usage_full(char** argv)
 {
-  printf("Usage: %s [graphfile] [nparts] [options]\n\n", argv[0]);
+  printf("Usage: %s [graphfile] [options]\n\n", argv[0]);
   printf("Options:\n");
+  printf("\t-n <N>, --nparts=<N>:\n");
+  printf("\t\tNumber of partitions (required)\n");
+  printf("\t-i <N>, --iosize=<N>:\n");
+  printf("\t\tNumber of I/O ranks (default: 4)\n");
+  printf("\t-t <N>, --iterations=<N>:\n");
+  printf("\t\tMaximum number of label propagation rounds (default: 10)\n");
+  printf("\t-b <X>, --imbalance=<X>:\n");
+  printf("\t\tAllowed relative excess of partition size and in-degree (default: 0.05)\n");
+  printf("\t-r <NAMESPACE>, --initial=<NAMESPACE>:\n");
+  printf("\t\tRead the initial partition from attribute %s of the given namespace\n", graph::NODE_RANK.c_str());
+  printf("\t-a <NAMESPACE>, --namespace=<NAMESPACE>:\n");
+  printf("\t\tWrite the partition as attribute %s of the given namespace\n", graph::NODE_RANK.c_str());
+  printf("\t-o <FILE>, --output=<FILE>:\n");
+  printf("\t\tWrite the partition as lines of node index and partition to FILE.<nparts>\n");
 }
 
 
@@ -67,34 +81,48 @@ void print_usage_full(char** argv)
 
 int main(int argc, char** argv)
 {
-  std::string input_file_name, output;
-  size_t nparts = 0, iosize = 0;
-  
-  assert(MPI_Init(&argc, &argv) >= 0);
+  std::string input_file_name, output, initial_namespace, output_namespace;
+  size_t nparts = 0, iosize = 0, iterations = 10;
+  double imbalance = 0.05;
+
+  throw_assert(MPI_Init(&argc, &argv) >= 0,
+               "neurograph_parts: error in MPI initialization");
 
   int rank, size;
-  assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS);
-  assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS);
+  throw_assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS,
+               "neurograph_parts: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS,
+               "neurograph_parts: error in MPI_Comm_rank");
 
   debug_enabled = false;
-  
+
   // parse arguments
   int optflag_nparts = 0;
   int optflag_iosize = 0;
   int optflag_output = 0;
+  int optflag_iterations = 0;
+  int optflag_imbalance = 0;
+  int optflag_initial = 0;
+  int optflag_namespace = 0;
   bool opt_nparts = false,
     opt_iosize = false,
-    opt_output = false;
+    opt_output = false,
+    opt_initial = false,
+    opt_namespace = false;
 
   static struct option long_options[] = {
-    {"output",    required_argument, &optflag_output,  1 },
-    {"nparts",    required_argument, &optflag_nparts,  1 },
-    {"iosize",    required_argument, &optflag_iosize,  1 },
+    {"output",     required_argument, &optflag_output,  1 },
+    {"nparts",     required_argument, &optflag_nparts,  1 },
+    {"iosize",     required_argument, &optflag_iosize,  1 },
+    {"iterations", required_argument, &optflag_iterations,  1 },
+    {"imbalance",  required_argument, &optflag_imbalance,  1 },
+    {"initial",    required_argument, &optflag_initial,  1 },
+    {"namespace",  required_argument, &optflag_namespace,  1 },
     {0,         0,                 0,  0 }
   };
   char c;
   int option_index = 0;
-  while ((c = getopt_long (argc, argv, "hi:n:o:",
+  while ((c = getopt_long (argc, argv, "a:b:hi:n:o:r:t:",
 			   long_options, &option_index)) != -1)
     {
       stringstream ss;
@@ -105,20 +133,48 @@ int main(int argc, char** argv)
             opt_nparts = true;
             ss << string(optarg);
             ss >> nparts;
-            optflag_nparts = 0;
+            optflag_nparts=0;
           }
           if (optflag_iosize == 1) {
             opt_iosize = true;
             ss << string(optarg);
             ss >> iosize;
-            optflag_iosize = 0;
+            optflag_iosize=0;
+          }
+          if (optflag_iterations == 1) {
+            ss << string(optarg);
+            ss >> iterations;
+            optflag_iterations=0;
+          }
+          if (optflag_imbalance == 1) {
+            ss << string(optarg);
+            ss >> imbalance;
+            optflag_imbalance=0;
+          }
+          if (optflag_initial == 1) {
+            opt_initial = true;
+            initial_namespace = string(optarg);
+            optflag_initial=0;
+          }
+          if (optflag_namespace == 1) {
+            opt_namespace = true;
+            output_namespace = string(optarg);
+            optflag_namespace=0;
           }
           if (optflag_output == 1) {
             opt_output = true;
             output = string(optarg);
-            optflag_output = 0;
+            optflag_output=0;
           }
           break;
+        case 'a':
+          opt_namespace = true;
+          output_namespace = string(optarg);
+          break;
+        case 'b':
+          ss << string(optarg);
+          ss >> imbalance;
+          break;
         case 'o':
           opt_output = true;
           output = string(optarg);
@@ -133,6 +189,14 @@ int main(int argc, char** argv)
           ss << string(optarg);
           ss >> iosize;
           break;
+        case 'r':
+          opt_initial = true;
+          initial_namespace = string(optarg);
+          break;
+        case 't':
+          ss << string(optarg);
+          ss >> iterations;
+          break;
         case 'h':
           print_usage_full(argv);
           exit(0);
@@ -154,44 +218,95 @@ int main(int argc, char** argv)
 
   if (!opt_iosize) iosize = 4;
 
-  vector<string> prj_names;
-  assert(graph::read_projection_names(MPI_COMM_WORLD, input_file_name, prj_names) >= 0);
+  vector< pair<string,string> > prj_names;
+  throw_assert(graph::read_projection_names(MPI_COMM_WORLD, input_file_name, prj_names) >= 0,
+               "neurograph_parts: error reading projection names");
+
+  // populations of the partitioned nodes
+  pop_label_map_t pop_labels;
+  pop_range_map_t pop_ranges;
+  size_t total_num_nodes = 0;
+  throw_assert_nomsg(cell::read_population_labels(MPI_COMM_WORLD, input_file_name, pop_labels) >= 0);
+  throw_assert_nomsg(cell::read_population_ranges(MPI_COMM_WORLD, input_file_name, pop_ranges, total_num_nodes) >= 0);
 
-  vector<prj_tuple_t> prj_list;
-  size_t total_num_edges = 0, local_num_edges = 0, total_num_nodes = 0;
-  
-  // read the edges
-  std::vector<idx_t> parts;
-  
-  graph::partition_graph
+  set<string> pop_names;
+  for (const auto& prj : prj_names)
+    {
+      pop_names.insert(prj.first);
+      pop_names.insert(prj.second);
+    }
+
+  node_rank_map_t node_rank_map;
+  if (opt_initial)
+    {
+      for (const auto& label : pop_labels)
+        {
+          if (pop_names.find(label.second) != pop_names.end())
+            {
+              graph::read_node_rank_map(MPI_COMM_WORLD, input_file_name, initial_namespace,
+                                        label.second, pop_ranges[label.first].start, node_rank_map);
+            }
+        }
+    }
+
+  size_t edge_cut = 0;
+  graph::partition_graph_lp
   (
    MPI_COMM_WORLD,
    input_file_name,
    prj_names,
    iosize,
    nparts,
-   parts
+   iterations,
+   imbalance,
+   node_rank_map,
+   edge_cut
    );
 
-  if (!opt_output)
+  if (rank == 0)
     {
-      for (size_t i = 0; i < parts.size(); i++)
+      printf("neurograph_parts: %lu partitions, edge cut %lu\n", nparts, edge_cut);
+    }
+
+  if (opt_namespace)
+    {
+      for (const auto& label : pop_labels)
         {
-          cout << parts[i] << std::endl;
+          if (pop_names.find(label.second) == pop_names.end())
+            continue;
+          const pop_range_t& range = pop_ranges[label.first];
+          node_rank_map_t pop_rank_map(node_rank_map.lower_bound(range.start),
+                                       node_rank_map.lower_bound(range.start + range.count));
+          graph::append_node_rank_map(MPI_COMM_WORLD, input_file_name, output_namespace,
+                                      label.second, range.start, pop_rank_map, iosize);
         }
     }
-  else
+
+  if (rank == 0)
     {
-      ofstream outfile;
-      stringstream outfilename;
-      outfilename << output << "." << nparts << "." << rank;
-      outfile.open(outfilename.str().c_str());
-      for (size_t i = 0; i < parts.size(); i++)
+      if (!opt_output)
+        {
+          if (!opt_namespace)
+            {
+              for (const auto& it : node_rank_map)
+                {
+                  cout << it.first << " " << *(it.second.begin()) << std::endl;
+                }
+            }
+        }
+      else
         {
-          outfile << parts[i] << std::endl;
+          ofstream outfile;
+          stringstream outfilename;
+          outfilename << output << "." << nparts;
+          outfile.open(outfilename.str().c_str());
+          for (const auto& it : node_rank_map)
+            {
+              outfile << it.first << " " << *(it.second.begin()) << std::endl;
+            }
+          outfile.flush();
+          outfile.close();
         }
-      outfile.flush();
-      outfile.close();
     }
 
   MPI_Finalize();
@@ -0,0 +1,917 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file neuroh5_bench.cc
+///
+///  Driver program that times the collective read and write modes of
+///  NeuroH5 on a file and reports throughput and memory use as JSON.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+
+#include "debug.hh"
+
+#include "neuroh5_types.hh"
+#include "cell_populations.hh"
+#include "create_population_h5types.hh"
+#include "projection_names.hh"
+#include "read_graph.hh"
+#include "scatter_read_graph.hh"
+#include "bcast_graph.hh"
+#include "read_graph_selection.hh"
+#include "scatter_read_graph_selection.hh"
+#include "append_graph.hh"
+#include "read_tree.hh"
+#include "scatter_read_tree.hh"
+#include "append_tree.hh"
+#include "cell_attributes.hh"
+#include "attr_index.hh"
+#include "attr_map.hh"
+#include "mpi_memory.hh"
+#include "mpi_trace.hh"
+#include "tokenize.hh"
+#include "throw_assert.hh"
+
+#include <mpi.h>
+#include <hdf5.h>
+#include <getopt.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <sstream>
+#include <map>
+#include <set>
+#include <vector>
+
+
+using namespace std;
+using namespace neuroh5;
+
+
+void throw_err(char const* err_message)
+{
+  fprintf(stderr, "Error: %s\n", err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+void throw_err(char const* err_message, int32_t task)
+{
+  fprintf(stderr, "Task %d Error: %s\n", task, err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+
+void print_usage_full(char** argv)
+{
+  printf("Usage: %s [options] <INPUT-FILE>\n\n", argv[0]);
+  printf("Options:\n");
+  printf("\t-p, --projection <SRC>:<DST>:\n");
+  printf("\t\tProjection to read (default: all projections in the file)\n");
+  printf("\t-n, --edge-namespace <NAMESPACE>:\n");
+  printf("\t\tEdge attribute namespace to read with the projections\n");
+  printf("\t-t, --trees <POP>:\n");
+  printf("\t\tPopulation whose trees are read\n");
+  printf("\t-a, --cell-attributes <POP>:<NAMESPACE>:\n");
+  printf("\t\tCell attribute namespace to read\n");
+  printf("\t-m, --modes <MODE>[,<MODE>...]:\n");
+  printf("\t\tModes to run (default: all modes that apply to the selected data):\n");
+  printf("\t\tread_graph, scatter_read_graph, bcast_graph, read_graph_selection,\n");
+  printf("\t\tscatter_read_graph_selection, append_graph, read_trees, scatter_read_trees,\n");
+  printf("\t\tread_tree_selection, scatter_read_tree_selection, append_trees,\n");
+  printf("\t\tread_cell_attributes, scatter_read_cell_attributes, bcast_cell_attributes,\n");
+  printf("\t\tread_cell_attribute_selection, scatter_read_cell_attribute_selection,\n");
+  printf("\t\tappend_cell_attributes\n");
+  printf("\t-r, --repeat <N>:\n");
+  printf("\t\tNumber of repetitions of each mode (default 3)\n");
+  printf("\t-i, --io-size <N>:\n");
+  printf("\t\tNumber of I/O ranks of the scatter and append modes (default 1)\n");
+  printf("\t-c, --cache-size <N>:\n");
+  printf("\t\tHDF5 chunk cache size of the append modes in bytes (default 1 MB)\n");
+  printf("\t-b, --memory-budget <N>:\n");
+  printf("\t\tPer-rank memory budget of the scatter readers in bytes (default: NEUROH5_MEMORY_BUDGET)\n");
+  printf("\t-l, --selection-size <N>:\n");
+  printf("\t\tTotal number of cells requested by the selection modes (default 1000)\n");
+  printf("\t-w, --scratch <FILE>:\n");
+  printf("\t\tOutput file of the append modes (default <INPUT-FILE>.bench)\n");
+  printf("\t-o, --output <FILE>:\n");
+  printf("\t\tWrite the JSON report to FILE instead of standard output\n");
+  printf("\t--phases:\n");
+  printf("\t\tInclude the per-phase timings and memory high-water marks of each mode in the report\n");
+}
+
+
+/// Peak resident set size of this process in kilobytes.
+static long peak_rss_kb ()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+      return 0;
+    }
+  return usage.ru_maxrss;
+}
+
+/// Current resident set size of this process in kilobytes, where
+/// available.
+static long current_rss_kb ()
+{
+  long pages = 0, resident = 0;
+  ifstream statm("/proc/self/statm");
+  if (!(statm >> pages >> resident))
+    {
+      return 0;
+    }
+  return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+struct bench_result_t
+{
+  string         mode;
+  vector<double> seconds;
+  uint64_t       items;
+  long           rss_delta_kb;
+  long           peak_rss_kb;
+  uint64_t       high_water_bytes;
+  map<string, mpi::phase_summary_t> phases;
+  map<string, mpi::memory_summary_t> memory;
+};
+
+/// Runs a mode the given number of times. The body returns the number
+/// of items (edges, trees or cells) it delivered to this rank; the time
+/// of a repetition is the maximum over all ranks, and the item count
+/// the sum. The result of the body is kept until the next repetition,
+/// so that the resident set growth reflects the size of the result.
+/// The tracked high-water mark is the maximum over all ranks of the
+/// bytes held by the reader data structures.
+static bench_result_t run_mode (MPI_Comm comm, const string& mode, const size_t repeat,
+                                const function<size_t ()>& body)
+{
+  bench_result_t result;
+  result.mode = mode;
+  result.items = 0;
+  result.rss_delta_kb = 0;
+  mpi::trace_reset();
+  mpi::memory_reset();
+
+  for (size_t r = 0; r < repeat; r++)
+    {
+      const long rss_before = current_rss_kb();
+      throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
+      auto start = chrono::steady_clock::now();
+      uint64_t local_items = body();
+      double local_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      long rss_delta = current_rss_kb() - rss_before;
+
+      double seconds = 0.0;
+      uint64_t items = 0;
+      long max_rss_delta = 0;
+      throw_assert_nomsg(MPI_Allreduce(&local_seconds, &seconds, 1, MPI_DOUBLE, MPI_MAX, comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Allreduce(&local_items, &items, 1, MPI_UINT64_T, MPI_SUM, comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Allreduce(&rss_delta, &max_rss_delta, 1, MPI_LONG, MPI_MAX, comm) == MPI_SUCCESS);
+      result.seconds.push_back(seconds);
+      result.items = items;
+      result.rss_delta_kb = max(result.rss_delta_kb, max_rss_delta);
+    }
+
+  long peak_rss = peak_rss_kb();
+  throw_assert_nomsg(MPI_Allreduce(&peak_rss, &result.peak_rss_kb, 1, MPI_LONG, MPI_MAX, comm) == MPI_SUCCESS);
+  result.phases = mpi::trace_summary(comm);
+  result.memory = mpi::memory_summary(comm);
+  auto total_it = result.memory.find(mpi::MEMORY_TOTAL);
+  result.high_water_bytes = (total_it != result.memory.end()) ? total_it->second.max_high_water : 0;
+  return result;
+}
+
+static string json_string (const string& s)
+{
+  stringstream ss;
+  ss << '"';
+  for (char c : s)
+    {
+      if ((c == '"') || (c == '\\'))
+        {
+          ss << '\\';
+        }
+      ss << c;
+    }
+  ss << '"';
+  return ss.str();
+}
+
+static void write_report (ostream& out, const string& file_name, const int size,
+                          const size_t io_size, const size_t cache_size,
+                          const vector<bench_result_t>& results, const bool phases)
+{
+  out << "{\n  \"file\": " << json_string(file_name)
+      << ",\n  \"ranks\": " << size
+      << ",\n  \"io_size\": " << io_size
+      << ",\n  \"cache_size\": " << cache_size
+      << ",\n  \"memory_budget\": " << mpi::memory_budget()
+      << ",\n  \"modes\": [";
+  for (size_t i = 0; i < results.size(); i++)
+    {
+      const bench_result_t& result = results[i];
+      double min_seconds = *min_element(result.seconds.begin(), result.seconds.end());
+      double max_seconds = *max_element(result.seconds.begin(), result.seconds.end());
+      double mean_seconds = 0.0;
+      for (double s : result.seconds)
+        {
+          mean_seconds += s;
+        }
+      mean_seconds /= result.seconds.size();
+
+      char line[512];
+      snprintf(line, sizeof(line),
+               "%s\n    {\"mode\": \"%s\", \"repeat\": %lu, \"items\": %lu, "
+               "\"min_seconds\": %.6f, \"mean_seconds\": %.6f, \"max_seconds\": %.6f, "
+               "\"items_per_second\": %.1f, \"rss_delta_kb\": %ld, \"peak_rss_kb\": %ld, "
+               "\"high_water_bytes\": %lu",
+               (i > 0) ? "," : "", result.mode.c_str(),
+               (unsigned long)result.seconds.size(), (unsigned long)result.items,
+               min_seconds, mean_seconds, max_seconds,
+               (min_seconds > 0.0) ? result.items / min_seconds : 0.0,
+               result.rss_delta_kb, result.peak_rss_kb, (unsigned long)result.high_water_bytes);
+      out << line;
+      if (phases)
+        {
+          out << ", \"phases\": {";
+          for (auto it = result.phases.cbegin(); it != result.phases.cend(); ++it)
+            {
+              const mpi::phase_summary_t& s = it->second;
+              snprintf(line, sizeof(line),
+                       "%s\n      \"%s\": {\"ranks\": %lu, \"calls\": %lu, \"min_seconds\": %.6f, "
+                       "\"mean_seconds\": %.6f, \"max_seconds\": %.6f, \"bytes\": %lu, \"items\": %lu}",
+                       (it != result.phases.cbegin()) ? "," : "", it->first.c_str(),
+                       (unsigned long)s.ranks, (unsigned long)s.calls, s.min_seconds,
+                       s.mean_seconds, s.max_seconds, (unsigned long)s.bytes, (unsigned long)s.items);
+              out << line;
+            }
+          out << "}, \"memory\": {";
+          for (auto it = result.memory.cbegin(); it != result.memory.cend(); ++it)
+            {
+              const mpi::memory_summary_t& s = it->second;
+              snprintf(line, sizeof(line),
+                       "%s\n      \"%s\": {\"ranks\": %lu, \"min_bytes\": %lu, "
+                       "\"mean_bytes\": %.0f, \"max_bytes\": %lu}",
+                       (it != result.memory.cbegin()) ? "," : "", it->first.c_str(),
+                       (unsigned long)s.ranks, (unsigned long)s.min_high_water,
+                       s.mean_high_water, (unsigned long)s.max_high_water);
+              out << line;
+            }
+          out << "}";
+        }
+      out << "}";
+    }
+  out << "\n  ]\n}\n";
+}
+
+static size_t count_edges (const vector<edge_map_t>& prj_vector)
+{
+  size_t num_edges = 0;
+  for (const edge_map_t& edge_map : prj_vector)
+    {
+      for (auto const& it : edge_map)
+        {
+          num_edges += get<0>(it.second).size();
+        }
+    }
+  return num_edges;
+}
+
+/// Returns the cells of a population.
+static vector<CELL_IDX_T> range_gids (const pop_range_t& range)
+{
+  vector<CELL_IDX_T> gids;
+  for (CELL_IDX_T i = 0; i < range.count; i++)
+    {
+      gids.push_back(range.start + i);
+    }
+  return gids;
+}
+
+/// Returns the destinations that have edges in every given projection,
+/// since the selection readers require every selected cell to be
+/// present in the destination index. Collective on comm.
+static vector<NODE_IDX_T> projection_destinations (MPI_Comm comm, const string& file_name,
+                                                   const vector< pair<string, string> >& prj_names)
+{
+  int size;
+  throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+
+  vector<edge_map_t> prj_vector;
+  vector < map <string, vector < vector<string> > > > edge_attr_names_vector;
+  size_t total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+  throw_assert_nomsg(graph::read_graph(comm, file_name, vector<string>(), prj_names, prj_vector,
+                                       edge_attr_names_vector, total_num_nodes,
+                                       local_num_edges, total_num_edges) >= 0);
+
+  vector<NODE_IDX_T> dsts;
+  for (size_t p = 0; p < prj_vector.size(); p++)
+    {
+      vector<NODE_IDX_T> local_dsts, prj_dsts;
+      for (auto const& it : prj_vector[p])
+        {
+          local_dsts.push_back(it.first);
+        }
+      int local_count = local_dsts.size();
+      vector<int> counts(size, 0), displs(size, 0);
+      throw_assert_nomsg(MPI_Allgather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, comm) == MPI_SUCCESS);
+      for (int r = 1; r < size; r++)
+        {
+          displs[r] = displs[r-1] + counts[r-1];
+        }
+      prj_dsts.resize(displs[size-1] + counts[size-1]);
+      throw_assert_nomsg(MPI_Allgatherv(local_dsts.data(), local_count, MPI_NODE_IDX_T,
+                                        prj_dsts.data(), counts.data(), displs.data(), MPI_NODE_IDX_T,
+                                        comm) == MPI_SUCCESS);
+      sort(prj_dsts.begin(), prj_dsts.end());
+      prj_dsts.erase(unique(prj_dsts.begin(), prj_dsts.end()), prj_dsts.end());
+      if (p == 0)
+        {
+          dsts = prj_dsts;
+        }
+      else
+        {
+          vector<NODE_IDX_T> common;
+          set_intersection(dsts.begin(), dsts.end(), prj_dsts.begin(), prj_dsts.end(),
+                           back_inserter(common));
+          dsts = common;
+        }
+    }
+  return dsts;
+}
+
+/// Draws a random sample of the given cells and returns the part of it
+/// assigned to this rank.
+static vector<CELL_IDX_T> random_selection (vector<CELL_IDX_T> gids, const size_t selection_size,
+                                            const int rank, const int size)
+{
+  mt19937 gen(gids.size());
+  shuffle(gids.begin(), gids.end(), gen);
+  gids.resize(min(gids.size(), selection_size));
+  sort(gids.begin(), gids.end());
+
+  vector<CELL_IDX_T> selection;
+  for (size_t i = rank; i < gids.size(); i += size)
+    {
+      selection.push_back(gids[i]);
+    }
+  return selection;
+}
+
+/// Assigns cells to ranks in round-robin order.
+static node_rank_map_t round_robin_rank_map (const pop_range_map_t& pop_ranges, const int size)
+{
+  node_rank_map_t node_rank_map;
+  for (auto const& it : pop_ranges)
+    {
+      for (CELL_IDX_T i = 0; i < it.second.count; i++)
+        {
+          CELL_IDX_T gid = it.second.start + i;
+          node_rank_map[gid].insert(gid % size);
+        }
+    }
+  return node_rank_map;
+}
+
+/// Builds the edge attribute index of append_graph from the attribute
+/// names returned by the graph readers.
+static map <string, pair <size_t, data::AttrIndex > >
+edge_attr_index_from_names (const vector<string>& edge_attr_namespaces,
+                            const map <string, vector < vector<string> > >& edge_attr_names)
+{
+  map <string, pair <size_t, data::AttrIndex > > edge_attr_index;
+  for (size_t ns = 0; ns < edge_attr_namespaces.size(); ns++)
+    {
+      auto names_it = edge_attr_names.find(edge_attr_namespaces[ns]);
+      if (names_it == edge_attr_names.end())
+        {
+          continue;
+        }
+      const vector < vector<string> >& names = names_it->second;
+      data::AttrSet attr_set;
+      for (const string& name : names[data::AttrVal::attr_index_float])  attr_set.add<float>(name);
+      for (const string& name : names[data::AttrVal::attr_index_uint8])  attr_set.add<uint8_t>(name);
+      for (const string& name : names[data::AttrVal::attr_index_int8])   attr_set.add<int8_t>(name);
+      for (const string& name : names[data::AttrVal::attr_index_uint16]) attr_set.add<uint16_t>(name);
+      for (const string& name : names[data::AttrVal::attr_index_int16])  attr_set.add<int16_t>(name);
+      for (const string& name : names[data::AttrVal::attr_index_uint32]) attr_set.add<uint32_t>(name);
+      for (const string& name : names[data::AttrVal::attr_index_int32])  attr_set.add<int32_t>(name);
+      data::AttrIndex attr_index(attr_set);
+
+      // the readers return the attributes of each type in name order,
+      // which is also the order of the attribute index
+      for (size_t t = 0; t < names.size(); t++)
+        {
+          throw_assert(is_sorted(names[t].begin(), names[t].end()),
+                       "neuroh5_bench: attributes of namespace " << edge_attr_namespaces[ns] <<
+                       " are not in name order");
+        }
+      edge_attr_index[edge_attr_namespaces[ns]] = make_pair(ns, attr_index);
+    }
+  return edge_attr_index;
+}
+
+template <class T>
+static void cell_attribute_maps (const data::NamedAttrMap& attr_map,
+                                 map<string, map<CELL_IDX_T, deque<T> > >& values)
+{
+  vector<string> names;
+  attr_map.attr_names_type<T>(names);
+  const vector< map<CELL_IDX_T, deque<T> > >& maps = attr_map.attr_maps<T>();
+  for (size_t i = 0; i < names.size(); i++)
+    {
+      values[names[i]] = maps[i];
+    }
+}
+
+/// Creates the output file of the append modes with the population
+/// definitions of the input file.
+static void create_scratch_file (MPI_Comm comm, const string& input_file_name,
+                                 const string& scratch_file_name)
+{
+  int rank;
+  throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+  pop_label_map_t pop_labels;
+  pop_range_map_t pop_ranges;
+  set< pair<pop_t, pop_t> > pop_pairs;
+  size_t total_num_nodes = 0;
+  throw_assert_nomsg(cell::read_population_labels(comm, input_file_name, pop_labels) >= 0);
+  throw_assert_nomsg(cell::read_population_ranges(comm, input_file_name, pop_ranges, total_num_nodes) >= 0);
+  throw_assert_nomsg(cell::read_population_combos(comm, input_file_name, pop_pairs) >= 0);
+
+  if (rank == 0)
+    {
+      hid_t file = H5Fcreate(scratch_file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(file >= 0, "neuroh5_bench: unable to create file " << scratch_file_name);
+      throw_assert_nomsg(hdf5::create_population_h5types(file, pop_labels, pop_ranges, pop_pairs) == 0);
+      throw_assert_nomsg(H5Fclose(file) >= 0);
+    }
+  throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
+}
+
+
+/*****************************************************************************
+ * Main driver
+ *****************************************************************************/
+
+int main(int argc, char** argv)
+{
+  string input_file_name, scratch_file_name, output_file_name;
+  vector< pair<string, string> > prj_names;
+  vector<string> edge_attr_namespaces;
+  vector<string> tree_pops;
+  vector< pair<string, string> > cell_attr_namespaces;
+  set<string> modes;
+  size_t repeat = 3, io_size = 1, cache_size = 1*1024*1024, selection_size = 1000;
+  bool opt_phases = false;
+
+  throw_assert(MPI_Init(&argc, &argv) >= 0,
+               "neuroh5_bench: error in MPI initialization");
+
+  int rank, size;
+  throw_assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS,
+               "neuroh5_bench: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS,
+               "neuroh5_bench: error in MPI_Comm_rank");
+
+  debug_enabled = false;
+
+  int optflag_phases = 0;
+  static struct option long_options[] = {
+    {"projection",      required_argument, 0, 'p' },
+    {"edge-namespace",  required_argument, 0, 'n' },
+    {"trees",           required_argument, 0, 't' },
+    {"cell-attributes", required_argument, 0, 'a' },
+    {"modes",           required_argument, 0, 'm' },
+    {"repeat",          required_argument, 0, 'r' },
+    {"io-size",         required_argument, 0, 'i' },
+    {"cache-size",      required_argument, 0, 'c' },
+    {"memory-budget",   required_argument, 0, 'b' },
+    {"selection-size",  required_argument, 0, 'l' },
+    {"scratch",         required_argument, 0, 'w' },
+    {"output",          required_argument, 0, 'o' },
+    {"phases",          no_argument, &optflag_phases, 1 },
+    {0,         0,                 0,  0 }
+  };
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long (argc, argv, "hp:n:t:a:m:r:i:c:b:l:w:o:",
+                           long_options, &option_index)) != -1)
+    {
+      vector<string> fields;
+      stringstream ss;
+      ss << string(optarg ? optarg : "");
+      switch (c)
+        {
+        case 0:
+          if (optflag_phases == 1) {
+            opt_phases = true;
+          }
+          break;
+        case 'p':
+          data::tokenize(optarg, ":", fields);
+          throw_assert(fields.size() == 2, "neuroh5_bench: invalid projection " << optarg);
+          prj_names.push_back(make_pair(fields[0], fields[1]));
+          break;
+        case 'n':
+          edge_attr_namespaces.push_back(string(optarg));
+          break;
+        case 't':
+          tree_pops.push_back(string(optarg));
+          break;
+        case 'a':
+          data::tokenize(optarg, ":", fields);
+          throw_assert(fields.size() == 2, "neuroh5_bench: invalid cell attribute namespace " << optarg);
+          cell_attr_namespaces.push_back(make_pair(fields[0], fields[1]));
+          break;
+        case 'm':
+          data::tokenize(optarg, ",", fields);
+          modes.insert(fields.begin(), fields.end());
+          break;
+        case 'r':
+          ss >> repeat;
+          break;
+        case 'i':
+          ss >> io_size;
+          break;
+        case 'c':
+          ss >> cache_size;
+          break;
+        case 'b':
+          {
+            uint64_t memory_budget = 0;
+            ss >> memory_budget;
+            mpi::set_memory_budget(memory_budget);
+          }
+          break;
+        case 'l':
+          ss >> selection_size;
+          break;
+        case 'w':
+          scratch_file_name = string(optarg);
+          break;
+        case 'o':
+          output_file_name = string(optarg);
+          break;
+        case 'h':
+          print_usage_full(argv);
+          exit(0);
+          break;
+        default:
+          throw_err("Input argument format error");
+        }
+    }
+
+  if (optind < argc)
+    {
+      input_file_name = string(argv[optind]);
+    }
+  else
+    {
+      print_usage_full(argv);
+      exit(1);
+    }
+  if (scratch_file_name.empty())
+    {
+      scratch_file_name = input_file_name + ".bench";
+    }
+  throw_assert(repeat > 0, "neuroh5_bench: number of repetitions must be positive");
+
+  auto mode_enabled = [&modes] (const string& mode) -> bool
+    {
+      return modes.empty() || (modes.find(mode) != modes.end());
+    };
+
+  pop_label_map_t pop_labels;
+  pop_range_map_t pop_ranges;
+  map<string, pop_range_t> pop_name_ranges;
+  size_t total_num_nodes = 0;
+  throw_assert_nomsg(cell::read_population_labels(MPI_COMM_WORLD, input_file_name, pop_labels) >= 0);
+  throw_assert_nomsg(cell::read_population_ranges(MPI_COMM_WORLD, input_file_name, pop_ranges, total_num_nodes) >= 0);
+  for (auto const& it : pop_labels)
+    {
+      pop_name_ranges[it.second] = pop_ranges[it.first];
+    }
+  const node_rank_map_t node_rank_map = round_robin_rank_map(pop_ranges, size);
+
+  if (prj_names.empty() && (tree_pops.empty() && cell_attr_namespaces.empty()))
+    {
+      throw_assert_nomsg(graph::read_projection_names(MPI_COMM_WORLD, input_file_name, prj_names) >= 0);
+    }
+
+  vector<bench_result_t> results;
+
+  // projections
+  if (!prj_names.empty())
+    {
+      for (auto const& prj : prj_names)
+        {
+          throw_assert((pop_name_ranges.find(prj.first) != pop_name_ranges.end()) &&
+                       (pop_name_ranges.find(prj.second) != pop_name_ranges.end()),
+                       "neuroh5_bench: unknown population in projection " << prj.first << " -> " << prj.second);
+        }
+      vector<NODE_IDX_T> selection;
+      if (mode_enabled("read_graph_selection") || mode_enabled("scatter_read_graph_selection"))
+        {
+          selection = random_selection(projection_destinations(MPI_COMM_WORLD, input_file_name, prj_names),
+                                       selection_size, rank, size);
+        }
+
+      vector<edge_map_t> prj_vector;
+      vector < map <string, vector < vector<string> > > > edge_attr_names_vector;
+      size_t num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+      auto clear = [&] ()
+        {
+          prj_vector.clear();
+          edge_attr_names_vector.clear();
+        };
+
+      if (mode_enabled("read_graph"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_graph", repeat, [&] () -> size_t
+            {
+              clear();
+              throw_assert_nomsg(graph::read_graph(MPI_COMM_WORLD, input_file_name, edge_attr_namespaces,
+                                                   prj_names, prj_vector, edge_attr_names_vector,
+                                                   num_nodes, local_num_edges, total_num_edges) >= 0);
+              return count_edges(prj_vector);
+            }));
+        }
+      if (mode_enabled("scatter_read_graph"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_graph", repeat, [&] () -> size_t
+            {
+              clear();
+              size_t local_num_nodes = 0;
+              throw_assert_nomsg(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, input_file_name, io_size,
+                                                           edge_attr_namespaces, prj_names, node_rank_map,
+                                                           prj_vector, edge_attr_names_vector,
+                                                           local_num_nodes, num_nodes,
+                                                           local_num_edges, total_num_edges) >= 0);
+              return count_edges(prj_vector);
+            }));
+        }
+      if (mode_enabled("bcast_graph"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "bcast_graph", repeat, [&] () -> size_t
+            {
+              clear();
+              throw_assert_nomsg(graph::bcast_graph(MPI_COMM_WORLD, EdgeMapDst, input_file_name,
+                                                    edge_attr_namespaces, prj_names,
+                                                    prj_vector, edge_attr_names_vector,
+                                                    num_nodes, local_num_edges, total_num_edges) >= 0);
+              return count_edges(prj_vector);
+            }));
+        }
+      if (mode_enabled("read_graph_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_graph_selection", repeat, [&] () -> size_t
+            {
+              clear();
+              throw_assert_nomsg(graph::read_graph_selection(MPI_COMM_WORLD, input_file_name, edge_attr_namespaces,
+                                                             prj_names, selection, prj_vector,
+                                                             edge_attr_names_vector,
+                                                             num_nodes, local_num_edges, total_num_edges) >= 0);
+              return count_edges(prj_vector);
+            }));
+        }
+      if (mode_enabled("scatter_read_graph_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_graph_selection", repeat, [&] () -> size_t
+            {
+              clear();
+              throw_assert_nomsg(graph::scatter_read_graph_selection(MPI_COMM_WORLD, input_file_name, io_size,
+                                                                     edge_attr_namespaces, prj_names, selection,
+                                                                     prj_vector, edge_attr_names_vector,
+                                                                     num_nodes, local_num_edges,
+                                                                     total_num_edges) >= 0);
+              return count_edges(prj_vector);
+            }));
+        }
+      if (mode_enabled("append_graph"))
+        {
+          clear();
+          throw_assert_nomsg(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, input_file_name, io_size,
+                                                       edge_attr_namespaces, prj_names, node_rank_map,
+                                                       prj_vector, edge_attr_names_vector,
+                                                       local_num_edges, num_nodes,
+                                                       local_num_edges, total_num_edges) >= 0);
+          results.push_back(run_mode(MPI_COMM_WORLD, "append_graph", repeat, [&] () -> size_t
+            {
+              create_scratch_file(MPI_COMM_WORLD, input_file_name, scratch_file_name);
+              for (size_t p = 0; p < prj_names.size(); p++)
+                {
+                  const map <string, pair <size_t, data::AttrIndex > > edge_attr_index =
+                    edge_attr_index_from_names(edge_attr_namespaces, edge_attr_names_vector[p]);
+                  throw_assert_nomsg(graph::append_graph(MPI_COMM_WORLD, io_size, scratch_file_name,
+                                                         prj_names[p].first, prj_names[p].second,
+                                                         edge_attr_index, prj_vector[p]) >= 0);
+                }
+              return count_edges(prj_vector);
+            }));
+        }
+    }
+
+  // trees
+  for (const string& pop_name : tree_pops)
+    {
+      throw_assert(pop_name_ranges.find(pop_name) != pop_name_ranges.end(),
+                   "neuroh5_bench: unknown population " << pop_name);
+      const pop_range_t& range = pop_name_ranges[pop_name];
+      const vector<CELL_IDX_T> selection = random_selection(range_gids(range),
+                                                            selection_size, rank, size);
+      const vector<string> no_namespaces;
+      forward_list<neurotree_t> tree_list;
+      map<CELL_IDX_T, neurotree_t> tree_map;
+      map<string, data::NamedAttrMap> attr_maps;
+
+      if (mode_enabled("read_trees"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_trees:" + pop_name, repeat, [&] () -> size_t
+            {
+              tree_list.clear();
+              throw_assert_nomsg(cell::read_trees(MPI_COMM_WORLD, input_file_name, pop_name,
+                                                  range.start, tree_list) >= 0);
+              return distance(tree_list.begin(), tree_list.end());
+            }));
+        }
+      if (mode_enabled("scatter_read_trees"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_trees:" + pop_name, repeat, [&] () -> size_t
+            {
+              tree_map.clear();
+              attr_maps.clear();
+              throw_assert_nomsg(cell::scatter_read_trees(MPI_COMM_WORLD, input_file_name, io_size,
+                                                          no_namespaces, node_rank_map, pop_name,
+                                                          range.start, tree_map, attr_maps) >= 0);
+              return tree_map.size();
+            }));
+        }
+      if (mode_enabled("read_tree_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_tree_selection:" + pop_name, repeat, [&] () -> size_t
+            {
+              tree_list.clear();
+              throw_assert_nomsg(cell::read_tree_selection(MPI_COMM_WORLD, input_file_name, pop_name,
+                                                           range.start, tree_list, selection) >= 0);
+              return distance(tree_list.begin(), tree_list.end());
+            }));
+        }
+      if (mode_enabled("scatter_read_tree_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_tree_selection:" + pop_name, repeat,
+                                     [&] () -> size_t
+            {
+              tree_map.clear();
+              attr_maps.clear();
+              throw_assert_nomsg(cell::scatter_read_tree_selection(MPI_COMM_WORLD, input_file_name, io_size,
+                                                                   no_namespaces, pop_name, range.start,
+                                                                   selection, tree_map, attr_maps) >= 0);
+              return tree_map.size();
+            }));
+        }
+      if (mode_enabled("append_trees"))
+        {
+          tree_list.clear();
+          throw_assert_nomsg(cell::read_trees(MPI_COMM_WORLD, input_file_name, pop_name,
+                                              range.start, tree_list) >= 0);
+          results.push_back(run_mode(MPI_COMM_WORLD, "append_trees:" + pop_name, repeat, [&] () -> size_t
+            {
+              create_scratch_file(MPI_COMM_WORLD, input_file_name, scratch_file_name);
+              throw_assert_nomsg(cell::append_trees(MPI_COMM_WORLD, scratch_file_name, pop_name,
+                                                    range.start, tree_list, io_size) >= 0);
+              return distance(tree_list.begin(), tree_list.end());
+            }));
+        }
+    }
+
+  // cell attributes
+  for (auto const& ns_it : cell_attr_namespaces)
+    {
+      const string& pop_name = ns_it.first;
+      const string& name_space = ns_it.second;
+      throw_assert(pop_name_ranges.find(pop_name) != pop_name_ranges.end(),
+                   "neuroh5_bench: unknown population " << pop_name);
+      const pop_range_t& range = pop_name_ranges[pop_name];
+      const vector<CELL_IDX_T> selection = random_selection(range_gids(range),
+                                                            selection_size, rank, size);
+      const set<string> attr_mask;
+      const string suffix = ":" + pop_name + ":" + name_space;
+      data::NamedAttrMap attr_map;
+
+      if (mode_enabled("read_cell_attributes"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_cell_attributes" + suffix, repeat, [&] () -> size_t
+            {
+              attr_map = data::NamedAttrMap();
+              cell::read_cell_attributes(MPI_COMM_WORLD, input_file_name, name_space, attr_mask,
+                                         pop_name, range.start, attr_map);
+              return attr_map.index_set.size();
+            }));
+        }
+      if (mode_enabled("scatter_read_cell_attributes"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_cell_attributes" + suffix, repeat,
+                                     [&] () -> size_t
+            {
+              attr_map = data::NamedAttrMap();
+              throw_assert_nomsg(cell::scatter_read_cell_attributes(MPI_COMM_WORLD, input_file_name, io_size,
+                                                                    name_space, attr_mask, node_rank_map,
+                                                                    pop_name, range.start, attr_map) >= 0);
+              return attr_map.index_set.size();
+            }));
+        }
+      if (mode_enabled("bcast_cell_attributes"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "bcast_cell_attributes" + suffix, repeat, [&] () -> size_t
+            {
+              attr_map = data::NamedAttrMap();
+              cell::bcast_cell_attributes(MPI_COMM_WORLD, 0, input_file_name, name_space, attr_mask,
+                                          pop_name, range.start, attr_map);
+              return attr_map.index_set.size();
+            }));
+        }
+      if (mode_enabled("read_cell_attribute_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "read_cell_attribute_selection" + suffix, repeat,
+                                     [&] () -> size_t
+            {
+              attr_map = data::NamedAttrMap();
+              cell::read_cell_attribute_selection(MPI_COMM_WORLD, input_file_name, name_space, attr_mask,
+                                                  pop_name, range.start, selection, attr_map);
+              return attr_map.index_set.size();
+            }));
+        }
+      if (mode_enabled("scatter_read_cell_attribute_selection"))
+        {
+          results.push_back(run_mode(MPI_COMM_WORLD, "scatter_read_cell_attribute_selection" + suffix, repeat,
+                                     [&] () -> size_t
+            {
+              attr_map = data::NamedAttrMap();
+              cell::scatter_read_cell_attribute_selection(MPI_COMM_WORLD, input_file_name, io_size,
+                                                          name_space, attr_mask, pop_name, range.start,
+                                                          selection, attr_map);
+              return attr_map.index_set.size();
+            }));
+        }
+      if (mode_enabled("append_cell_attributes"))
+        {
+          attr_map = data::NamedAttrMap();
+          throw_assert_nomsg(cell::scatter_read_cell_attributes(MPI_COMM_WORLD, input_file_name, io_size,
+                                                                name_space, attr_mask, node_rank_map,
+                                                                pop_name, range.start, attr_map) >= 0);
+          map<string, map<CELL_IDX_T, deque<uint32_t> > > uint32_values;
+          map<string, map<CELL_IDX_T, deque<int32_t> > >  int32_values;
+          map<string, map<CELL_IDX_T, deque<uint16_t> > > uint16_values;
+          map<string, map<CELL_IDX_T, deque<int16_t> > >  int16_values;
+          map<string, map<CELL_IDX_T, deque<uint8_t> > >  uint8_values;
+          map<string, map<CELL_IDX_T, deque<int8_t> > >   int8_values;
+          map<string, map<CELL_IDX_T, deque<float> > >    float_values;
+          cell_attribute_maps(attr_map, uint32_values);
+          cell_attribute_maps(attr_map, int32_values);
+          cell_attribute_maps(attr_map, uint16_values);
+          cell_attribute_maps(attr_map, int16_values);
+          cell_attribute_maps(attr_map, uint8_values);
+          cell_attribute_maps(attr_map, int8_values);
+          cell_attribute_maps(attr_map, float_values);
+          results.push_back(run_mode(MPI_COMM_WORLD, "append_cell_attributes" + suffix, repeat,
+                                     [&] () -> size_t
+            {
+              create_scratch_file(MPI_COMM_WORLD, input_file_name, scratch_file_name);
+              cell::append_cell_attribute_maps(MPI_COMM_WORLD, scratch_file_name, name_space, pop_name,
+                                               range.start, uint32_values, int32_values,
+                                               uint16_values, int16_values, uint8_values, int8_values,
+                                               float_values, io_size, data::optional_hid(),
+                                               IndexOwner, CellPtr(PtrOwner), 4000, 4000, cache_size);
+              return attr_map.index_set.size();
+            }));
+        }
+    }
+
+  if (rank == 0)
+    {
+      if (output_file_name.empty())
+        {
+          write_report(cout, input_file_name, size, io_size, cache_size, results, opt_phases);
+        }
+      else
+        {
+          ofstream out(output_file_name.c_str());
+          throw_assert(out.good(), "neuroh5_bench: unable to open " << output_file_name);
+          write_report(out, input_file_name, size, io_size, cache_size, results, opt_phases);
+        }
+    }
+
+  MPI_Finalize();
+  return 0;
+}
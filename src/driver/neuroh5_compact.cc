@@ -0,0 +1,165 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file neuroh5_compact.cc
+///
+///  Driver program that compacts cell attribute namespaces: the
+///  attributes are rewritten sorted by cell index, without duplicate
+///  cells, and with chunk sizes chosen from the sizes of the values.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+
+#include "debug.hh"
+
+#include "neuroh5_types.hh"
+#include "cell_populations.hh"
+#include "compact_cell_attributes.hh"
+#include "throw_assert.hh"
+
+#include <mpi.h>
+#include <hdf5.h>
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace std;
+using namespace neuroh5;
+
+
+void throw_err(char const* err_message)
+{
+  fprintf(stderr, "Error: %s\n", err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+
+void print_usage_full(char** argv)
+{
+  printf("Usage: %s [options] <FILE> <POPULATION> <NAMESPACE>...\n\n", argv[0]);
+  printf("Options:\n");
+  printf("\t-c, --chunk-bytes <N>:\n");
+  printf("\t\tTarget size in bytes of the chunks of the compacted datasets (default %zu)\n",
+         cell::COMPACT_CHUNK_BYTES);
+  printf("\t--cache-size <N>:\n");
+  printf("\t\tHDF5 chunk cache size in bytes\n");
+}
+
+
+template <class T>
+static T parse_number (const string& s)
+{
+  stringstream ss(s);
+  T value;
+  ss >> value;
+  if (ss.fail())
+    {
+      throw_err(("invalid number " + s).c_str());
+    }
+  return value;
+}
+
+
+/*****************************************************************************
+ * Main driver
+ *****************************************************************************/
+
+int main(int argc, char** argv)
+{
+  string file_name, pop_name;
+  vector<string> name_spaces;
+  size_t chunk_bytes = cell::COMPACT_CHUNK_BYTES;
+  size_t cache_size = 1*1024*1024;
+
+  throw_assert(MPI_Init(&argc, &argv) >= 0,
+               "neuroh5_compact: error in MPI initialization");
+
+  int rank, size;
+  throw_assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS,
+               "neuroh5_compact: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS,
+               "neuroh5_compact: error in MPI_Comm_rank");
+
+  debug_enabled = false;
+
+  int optflag_cache_size = 0;
+  static struct option long_options[] = {
+    {"chunk-bytes",      required_argument, 0, 'c' },
+    {"cache-size",       required_argument, &optflag_cache_size, 1 },
+    {0,         0,                 0,  0 }
+  };
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long (argc, argv, "hc:", long_options, &option_index)) != -1)
+    {
+      switch (c)
+        {
+        case 0:
+          if (optflag_cache_size == 1) {
+            cache_size = parse_number<size_t>(optarg);
+            optflag_cache_size = 0;
+          }
+          break;
+        case 'c':
+          chunk_bytes = parse_number<size_t>(optarg);
+          break;
+        case 'h':
+          print_usage_full(argv);
+          exit(0);
+          break;
+        default:
+          throw_err("Input argument format error");
+        }
+    }
+
+  if (optind+2 < argc)
+    {
+      file_name = string(argv[optind]);
+      pop_name = string(argv[optind+1]);
+      for (int i = optind+2; i < argc; i++)
+        {
+          name_spaces.push_back(string(argv[i]));
+        }
+    }
+  else
+    {
+      print_usage_full(argv);
+      exit(1);
+    }
+
+  pop_label_map_t pop_labels;
+  throw_assert(cell::read_population_labels(MPI_COMM_WORLD, file_name, pop_labels) >= 0,
+               "neuroh5_compact: error in read_population_labels");
+  bool pop_set = false;
+  for (auto const& label : pop_labels)
+    {
+      if (label.second == pop_name)
+        {
+          pop_set = true;
+        }
+    }
+  if (!pop_set)
+    {
+      throw_err(("population " + pop_name + " not found").c_str());
+    }
+
+  for (const string& name_space : name_spaces)
+    {
+      double start_time = MPI_Wtime();
+      cell::compact_cell_attributes(MPI_COMM_WORLD, file_name, name_space, pop_name,
+                                    chunk_bytes, cache_size);
+      if (rank == 0)
+        {
+          printf("neuroh5_compact: compacted %s of %s in %.3f s\n",
+                 name_space.c_str(), pop_name.c_str(), MPI_Wtime() - start_time);
+        }
+    }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,644 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file neuroh5_generate.cc
+///
+///  Driver program that writes synthetic NeuroH5 files with populations,
+///  projections, edge attributes, trees and cell attributes of
+///  parametric size, for benchmarking.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+
+#include "debug.hh"
+
+#include "neuroh5_types.hh"
+#include "path_names.hh"
+#include "create_population_h5types.hh"
+#include "append_graph.hh"
+#include "append_tree.hh"
+#include "contract_tree.hh"
+#include "cell_attributes.hh"
+#include "attr_index.hh"
+#include "attr_val.hh"
+#include "tokenize.hh"
+#include "throw_assert.hh"
+
+#include <mpi.h>
+#include <hdf5.h>
+#include <getopt.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <forward_list>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <map>
+#include <set>
+#include <vector>
+
+
+using namespace std;
+using namespace neuroh5;
+
+
+void throw_err(char const* err_message)
+{
+  fprintf(stderr, "Error: %s\n", err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+void throw_err(char const* err_message, int32_t task)
+{
+  fprintf(stderr, "Task %d Error: %s\n", task, err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+
+void print_usage_full(char** argv)
+{
+  printf("Usage: %s [options] <OUTPUT-FILE>\n\n", argv[0]);
+  printf("Options:\n");
+  printf("\t-p, --population <NAME>:<COUNT>:\n");
+  printf("\t\tAdd a population; populations are numbered consecutively in the order given\n");
+  printf("\t-e, --projection <SRC>:<DST>:<DEGREE>[:uniform|powerlaw]:\n");
+  printf("\t\tAdd a projection with the given mean in-degree (default distribution uniform)\n");
+  printf("\t-x, --exponent <ALPHA>:\n");
+  printf("\t\tExponent of power-law in-degree distributions (default 2.5)\n");
+  printf("\t-a, --edge-attribute <NAMESPACE>:<NAME>:<TYPE>:\n");
+  printf("\t\tAdd an edge attribute to every projection; TYPE is one of\n");
+  printf("\t\tfloat, uint8, int8, uint16, int16, uint32, int32\n");
+  printf("\t-t, --trees <POP>:<POINTS>:\n");
+  printf("\t\tAdd a tree with the given mean number of points to every cell of POP\n");
+  printf("\t-c, --cell-attribute <POP>:<NAMESPACE>:<NAME>:<TYPE>[:<LENGTH>]:\n");
+  printf("\t\tAdd a cell attribute with LENGTH values (default 1) to every cell of POP\n");
+  printf("\t-i, --io-size <N>:\n");
+  printf("\t\tNumber of I/O ranks (default 1)\n");
+  printf("\t-b, --batch-size <N>:\n");
+  printf("\t\tNumber of cells generated per rank and append call (default 10000)\n");
+  printf("\t-s, --seed <N>:\n");
+  printf("\t\tRandom seed (default 1); the output does not depend on the number of ranks\n");
+  printf("\t--chunk-size <N>, --value-chunk-size <N>:\n");
+  printf("\t\tHDF5 chunk sizes of the index and value datasets\n");
+}
+
+
+enum synth_type_t { SynthFloat, SynthUInt8, SynthInt8, SynthUInt16, SynthInt16, SynthUInt32, SynthInt32 };
+
+static synth_type_t parse_synth_type (const string& s)
+{
+  if (s == "float") return SynthFloat;
+  if (s == "uint8") return SynthUInt8;
+  if (s == "int8") return SynthInt8;
+  if (s == "uint16") return SynthUInt16;
+  if (s == "int16") return SynthInt16;
+  if (s == "uint32") return SynthUInt32;
+  if (s == "int32") return SynthInt32;
+  throw_err(("unknown attribute type " + s).c_str());
+  return SynthFloat;
+}
+
+struct synth_projection_t
+{
+  string src, dst;
+  double degree;
+  bool   powerlaw;
+};
+
+struct synth_attr_t
+{
+  string       pop, name_space, name;
+  synth_type_t type;
+  size_t       length;
+};
+
+/// Returns a generator seeded by the global seed and a cell, so that the
+/// generated data do not depend on the distribution of cells to ranks.
+static mt19937_64 cell_generator (const uint64_t seed, const uint64_t stream, const CELL_IDX_T gid)
+{
+  seed_seq seq { (uint32_t)seed, (uint32_t)(seed >> 32), (uint32_t)stream, (uint32_t)gid };
+  return mt19937_64(seq);
+}
+
+template <class T>
+static T random_value (mt19937_64& gen)
+{
+  uniform_int_distribution<int> dist(0, 100);
+  return (T)dist(gen);
+}
+
+template <>
+float random_value<float> (mt19937_64& gen)
+{
+  uniform_real_distribution<float> dist(0.0f, 1.0f);
+  return dist(gen);
+}
+
+/// Samples an in-degree with the given mean. Power-law degrees follow a
+/// Pareto distribution with minimum mean * (alpha-2) / (alpha-1).
+static size_t sample_degree (mt19937_64& gen, const synth_projection_t& prj,
+                             const double alpha, const size_t max_degree)
+{
+  size_t k;
+  if (prj.powerlaw)
+    {
+      const double kmin = prj.degree * (alpha - 2.0) / (alpha - 1.0);
+      uniform_real_distribution<double> u(0.0, 1.0);
+      k = (size_t)llround(kmin * pow(1.0 - u(gen), -1.0 / (alpha - 1.0)));
+    }
+  else
+    {
+      uniform_int_distribution<size_t> dist(0, (size_t)llround(2.0 * prj.degree));
+      k = dist(gen);
+    }
+  return min(k, max_degree);
+}
+
+template <class T>
+static void append_edge_values (mt19937_64& gen, const data::AttrIndex& attr_index,
+                                const string& attr_name, const size_t num_edges,
+                                data::AttrVal& attr_val)
+{
+  vector<T> values(num_edges);
+  for (size_t i = 0; i < num_edges; i++)
+    {
+      values[i] = random_value<T>(gen);
+    }
+  attr_val.resize<T>(attr_index.size_attr_index<T>());
+  attr_val.insert(values, attr_index.attr_index<T>(attr_name));
+}
+
+static void generate_edge_values (mt19937_64& gen, const data::AttrIndex& attr_index,
+                                  const synth_attr_t& attr, const size_t num_edges,
+                                  data::AttrVal& attr_val)
+{
+  switch (attr.type)
+    {
+    case SynthFloat:  append_edge_values<float>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthUInt8:  append_edge_values<uint8_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthInt8:   append_edge_values<int8_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthUInt16: append_edge_values<uint16_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthInt16:  append_edge_values<int16_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthUInt32: append_edge_values<uint32_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    case SynthInt32:  append_edge_values<int32_t>(gen, attr_index, attr.name, num_edges, attr_val); break;
+    }
+}
+
+static void add_attr_set (const synth_attr_t& attr, data::AttrSet& attr_set)
+{
+  switch (attr.type)
+    {
+    case SynthFloat:  attr_set.add<float>(attr.name); break;
+    case SynthUInt8:  attr_set.add<uint8_t>(attr.name); break;
+    case SynthInt8:   attr_set.add<int8_t>(attr.name); break;
+    case SynthUInt16: attr_set.add<uint16_t>(attr.name); break;
+    case SynthInt16:  attr_set.add<int16_t>(attr.name); break;
+    case SynthUInt32: attr_set.add<uint32_t>(attr.name); break;
+    case SynthInt32:  attr_set.add<int32_t>(attr.name); break;
+    }
+}
+
+/// Cell attribute values of one namespace, by type
+struct synth_cell_values_t
+{
+  map<string, map<CELL_IDX_T, deque<uint32_t> > > uint32_values;
+  map<string, map<CELL_IDX_T, deque<int32_t> > >  int32_values;
+  map<string, map<CELL_IDX_T, deque<uint16_t> > > uint16_values;
+  map<string, map<CELL_IDX_T, deque<int16_t> > >  int16_values;
+  map<string, map<CELL_IDX_T, deque<uint8_t> > >  uint8_values;
+  map<string, map<CELL_IDX_T, deque<int8_t> > >   int8_values;
+  map<string, map<CELL_IDX_T, deque<float> > >    float_values;
+};
+
+template <class T>
+static void generate_cell_value (mt19937_64& gen, const CELL_IDX_T gid, const synth_attr_t& attr,
+                                 map<string, map<CELL_IDX_T, deque<T> > >& values)
+{
+  deque<T>& v = values[attr.name][gid];
+  for (size_t i = 0; i < attr.length; i++)
+    {
+      v.push_back(random_value<T>(gen));
+    }
+}
+
+static void generate_cell_values (mt19937_64& gen, const CELL_IDX_T gid, const synth_attr_t& attr,
+                                  synth_cell_values_t& values)
+{
+  switch (attr.type)
+    {
+    case SynthFloat:  generate_cell_value(gen, gid, attr, values.float_values); break;
+    case SynthUInt8:  generate_cell_value(gen, gid, attr, values.uint8_values); break;
+    case SynthInt8:   generate_cell_value(gen, gid, attr, values.int8_values); break;
+    case SynthUInt16: generate_cell_value(gen, gid, attr, values.uint16_values); break;
+    case SynthInt16:  generate_cell_value(gen, gid, attr, values.int16_values); break;
+    case SynthUInt32: generate_cell_value(gen, gid, attr, values.uint32_values); break;
+    case SynthInt32:  generate_cell_value(gen, gid, attr, values.int32_values); break;
+    }
+}
+
+/// Generates a random tree: each point continues the branch of the
+/// previous point, or with probability 0.1 starts a new branch at an
+/// earlier point.
+static neurotree_t generate_tree (mt19937_64& gen, const CELL_IDX_T gid, const size_t mean_points)
+{
+  // point ids are stored in sections as SECTION_IDX_T
+  const size_t max_points = numeric_limits<SECTION_IDX_T>::max();
+  uniform_int_distribution<size_t> num_points_dist(1, max((size_t)1, 2*mean_points - 1));
+  const size_t num_points = min(num_points_dist(gen), max_points);
+
+  uniform_real_distribution<float> u(0.0f, 1.0f);
+  deque<PARENT_NODE_IDX_T> parents;
+  deque<SWC_TYPE_T> swc_types;
+  deque<COORD_T> xcoords, ycoords, zcoords;
+  deque<REALVAL_T> radiuses;
+  deque<LAYER_IDX_T> layers;
+  for (size_t i = 0; i < num_points; i++)
+    {
+      PARENT_NODE_IDX_T parent = -1;
+      COORD_T x = 0.0, y = 0.0, z = 0.0;
+      if (i > 0)
+        {
+          parent = i - 1;
+          if (u(gen) < 0.1f)
+            {
+              uniform_int_distribution<size_t> branch_dist(0, i - 1);
+              parent = branch_dist(gen);
+            }
+          x = xcoords[parent] + u(gen) - 0.5f;
+          y = ycoords[parent] + u(gen);
+          z = zcoords[parent] + u(gen) - 0.5f;
+        }
+      parents.push_back(parent);
+      swc_types.push_back(i == 0 ? 1 : 3);
+      xcoords.push_back(x);
+      ycoords.push_back(y);
+      zcoords.push_back(z);
+      radiuses.push_back(i == 0 ? 5.0f : 0.5f + u(gen));
+      layers.push_back((LAYER_IDX_T)(y / 10.0f) % 4);
+    }
+
+  deque<SECTION_IDX_T> src_vector, dst_vector, sec_vector;
+  cell::contract_tree(parents, swc_types, NULL, 0, src_vector, dst_vector, sec_vector);
+
+  return make_tuple(gid, src_vector, dst_vector, sec_vector, xcoords, ycoords, zcoords,
+                    radiuses, layers, parents, swc_types);
+}
+
+static vector<string> split_spec (const string& spec, const size_t min_fields, const size_t max_fields)
+{
+  vector<string> fields;
+  data::tokenize(spec, ":", fields);
+  if ((fields.size() < min_fields) || (fields.size() > max_fields))
+    {
+      throw_err(("invalid specification " + spec).c_str());
+    }
+  return fields;
+}
+
+template <class T>
+static T parse_number (const string& s)
+{
+  stringstream ss(s);
+  T value;
+  ss >> value;
+  if (ss.fail())
+    {
+      throw_err(("invalid number " + s).c_str());
+    }
+  return value;
+}
+
+
+/*****************************************************************************
+ * Main driver
+ *****************************************************************************/
+
+int main(int argc, char** argv)
+{
+  string output_file_name;
+  vector< pair<string, size_t> > populations;
+  vector<synth_projection_t> projections;
+  vector<synth_attr_t> edge_attrs, cell_attrs;
+  map<string, size_t> tree_points;
+  double alpha = 2.5;
+  size_t io_size = 1, batch_size = 10000, chunk_size = 4000, value_chunk_size = 4000;
+  uint64_t seed = 1;
+
+  throw_assert(MPI_Init(&argc, &argv) >= 0,
+               "neuroh5_generate: error in MPI initialization");
+
+  int rank, size;
+  throw_assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS,
+               "neuroh5_generate: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS,
+               "neuroh5_generate: error in MPI_Comm_rank");
+
+  debug_enabled = false;
+
+  int optflag_chunk_size = 0;
+  int optflag_value_chunk_size = 0;
+  static struct option long_options[] = {
+    {"population",       required_argument, 0, 'p' },
+    {"projection",       required_argument, 0, 'e' },
+    {"exponent",         required_argument, 0, 'x' },
+    {"edge-attribute",   required_argument, 0, 'a' },
+    {"trees",            required_argument, 0, 't' },
+    {"cell-attribute",   required_argument, 0, 'c' },
+    {"io-size",          required_argument, 0, 'i' },
+    {"batch-size",       required_argument, 0, 'b' },
+    {"seed",             required_argument, 0, 's' },
+    {"chunk-size",       required_argument, &optflag_chunk_size, 1 },
+    {"value-chunk-size", required_argument, &optflag_value_chunk_size, 1 },
+    {0,         0,                 0,  0 }
+  };
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long (argc, argv, "hp:e:x:a:t:c:i:b:s:",
+                           long_options, &option_index)) != -1)
+    {
+      vector<string> fields;
+      switch (c)
+        {
+        case 0:
+          if (optflag_chunk_size == 1) {
+            chunk_size = parse_number<size_t>(optarg);
+            optflag_chunk_size = 0;
+          }
+          if (optflag_value_chunk_size == 1) {
+            value_chunk_size = parse_number<size_t>(optarg);
+            optflag_value_chunk_size = 0;
+          }
+          break;
+        case 'p':
+          fields = split_spec(optarg, 2, 2);
+          populations.push_back(make_pair(fields[0], parse_number<size_t>(fields[1])));
+          break;
+        case 'e':
+          {
+            fields = split_spec(optarg, 3, 4);
+            synth_projection_t prj;
+            prj.src = fields[0];
+            prj.dst = fields[1];
+            prj.degree = parse_number<double>(fields[2]);
+            prj.powerlaw = (fields.size() > 3) && (fields[3] == "powerlaw");
+            if ((fields.size() > 3) && !prj.powerlaw && (fields[3] != "uniform"))
+              {
+                throw_err(("unknown degree distribution " + fields[3]).c_str());
+              }
+            projections.push_back(prj);
+          }
+          break;
+        case 'x':
+          alpha = parse_number<double>(optarg);
+          break;
+        case 'a':
+          {
+            fields = split_spec(optarg, 3, 3);
+            synth_attr_t attr;
+            attr.name_space = fields[0];
+            attr.name = fields[1];
+            attr.type = parse_synth_type(fields[2]);
+            attr.length = 1;
+            edge_attrs.push_back(attr);
+          }
+          break;
+        case 't':
+          fields = split_spec(optarg, 2, 2);
+          tree_points[fields[0]] = parse_number<size_t>(fields[1]);
+          break;
+        case 'c':
+          {
+            fields = split_spec(optarg, 4, 5);
+            synth_attr_t attr;
+            attr.pop = fields[0];
+            attr.name_space = fields[1];
+            attr.name = fields[2];
+            attr.type = parse_synth_type(fields[3]);
+            attr.length = (fields.size() > 4) ? parse_number<size_t>(fields[4]) : 1;
+            cell_attrs.push_back(attr);
+          }
+          break;
+        case 'i':
+          io_size = parse_number<size_t>(optarg);
+          break;
+        case 'b':
+          batch_size = parse_number<size_t>(optarg);
+          break;
+        case 's':
+          seed = parse_number<uint64_t>(optarg);
+          break;
+        case 'h':
+          print_usage_full(argv);
+          exit(0);
+          break;
+        default:
+          throw_err("Input argument format error");
+        }
+    }
+
+  if ((optind < argc) && (populations.size() > 0))
+    {
+      output_file_name = string(argv[optind]);
+    }
+  else
+    {
+      print_usage_full(argv);
+      exit(1);
+    }
+  throw_assert(alpha > 2.0, "neuroh5_generate: power-law exponent must be greater than 2");
+  throw_assert(batch_size > 0, "neuroh5_generate: batch size must be positive");
+
+  // population ranges are laid out consecutively
+  pop_label_map_t pop_labels;
+  pop_range_map_t pop_ranges;
+  map<string, pop_t> pop_index;
+  uint64_t pop_start = 0;
+  for (size_t i = 0; i < populations.size(); i++)
+    {
+      pop_range_t range;
+      range.start = pop_start;
+      range.count = populations[i].second;
+      range.pop = i;
+      pop_labels[i] = populations[i].first;
+      pop_ranges[i] = range;
+      pop_index[populations[i].first] = i;
+      pop_start += range.count;
+    }
+  throw_assert(pop_start <= numeric_limits<CELL_IDX_T>::max(),
+               "neuroh5_generate: too many cells");
+
+  set< pair<pop_t, pop_t> > pop_pairs;
+  for (const synth_projection_t& prj : projections)
+    {
+      throw_assert((pop_index.find(prj.src) != pop_index.end()) &&
+                   (pop_index.find(prj.dst) != pop_index.end()),
+                   "neuroh5_generate: unknown population in projection " << prj.src << " -> " << prj.dst);
+      pop_pairs.insert(make_pair(pop_index[prj.src], pop_index[prj.dst]));
+    }
+  if (pop_pairs.empty())
+    {
+      pop_pairs.insert(make_pair(0, 0));
+    }
+
+  if (rank == 0)
+    {
+      hid_t file = H5Fcreate(output_file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(file >= 0, "neuroh5_generate: unable to create file " << output_file_name);
+      throw_assert(hdf5::create_population_h5types(file, pop_labels, pop_ranges, pop_pairs) == 0,
+                   "neuroh5_generate: unable to create population definitions");
+      throw_assert(H5Fclose(file) >= 0, "neuroh5_generate: unable to close file");
+    }
+  throw_assert(MPI_Barrier(MPI_COMM_WORLD) == MPI_SUCCESS,
+               "neuroh5_generate: error in MPI_Barrier");
+
+  // every rank takes part in the same number of append calls; rank r
+  // generates the cells with index r mod size
+  const size_t stride = size * batch_size;
+
+  // projections
+  map <string, data::AttrSet> attr_set_map;
+  for (const synth_attr_t& attr : edge_attrs)
+    {
+      add_attr_set(attr, attr_set_map[attr.name_space]);
+    }
+  map <string, pair <size_t, data::AttrIndex > > edge_attr_index;
+  for (auto ns_it = attr_set_map.cbegin(); ns_it != attr_set_map.cend(); ++ns_it)
+    {
+      edge_attr_index[ns_it->first] = make_pair((size_t)distance(attr_set_map.cbegin(), ns_it),
+                                                data::AttrIndex(ns_it->second));
+    }
+
+  for (size_t p = 0; p < projections.size(); p++)
+    {
+      const synth_projection_t& prj = projections[p];
+      const pop_range_t& src_range = pop_ranges[pop_index[prj.src]];
+      const pop_range_t& dst_range = pop_ranges[pop_index[prj.dst]];
+      size_t num_edges = 0;
+
+      for (size_t batch_start = 0; batch_start < max((size_t)dst_range.count, (size_t)1); batch_start += stride)
+        {
+          edge_map_t edge_map;
+          for (size_t i = batch_start + rank; i < min(batch_start + stride, (size_t)dst_range.count); i += size)
+            {
+              const NODE_IDX_T dst = dst_range.start + i;
+              mt19937_64 gen = cell_generator(seed, 1 + p, dst);
+              const size_t degree = (src_range.count > 0) ?
+                sample_degree(gen, prj, alpha, 100 * (size_t)ceil(prj.degree) + 1) : 0;
+              if (degree == 0)
+                {
+                  continue;
+                }
+              uniform_int_distribution<NODE_IDX_T> src_dist(src_range.start, src_range.start + src_range.count - 1);
+              vector<NODE_IDX_T> adj_vector(degree);
+              for (size_t k = 0; k < degree; k++)
+                {
+                  adj_vector[k] = src_dist(gen);
+                }
+              sort(adj_vector.begin(), adj_vector.end());
+
+              vector<data::AttrVal> edge_attr_values(edge_attr_index.size());
+              for (const synth_attr_t& attr : edge_attrs)
+                {
+                  const pair<size_t, data::AttrIndex>& ns_index = edge_attr_index[attr.name_space];
+                  generate_edge_values(gen, ns_index.second, attr, degree,
+                                       edge_attr_values[ns_index.first]);
+                }
+              edge_map.insert(make_pair(dst, make_tuple(adj_vector, edge_attr_values)));
+              num_edges += degree;
+            }
+
+          throw_assert(graph::append_graph(MPI_COMM_WORLD, io_size, output_file_name,
+                                           prj.src, prj.dst, edge_attr_index, edge_map, chunk_size) >= 0,
+                       "neuroh5_generate: error in append_graph");
+        }
+
+      size_t total_num_edges = 0;
+      throw_assert(MPI_Reduce(&num_edges, &total_num_edges, 1, MPI_SIZE_T, MPI_SUM, 0,
+                              MPI_COMM_WORLD) == MPI_SUCCESS,
+                   "neuroh5_generate: error in MPI_Reduce");
+      if (rank == 0)
+        {
+          printf("neuroh5_generate: projection %s -> %s: %zu edges\n",
+                 prj.src.c_str(), prj.dst.c_str(), total_num_edges);
+        }
+    }
+
+  // trees
+  for (auto const& it : tree_points)
+    {
+      const string& pop_name = it.first;
+      throw_assert(pop_index.find(pop_name) != pop_index.end(),
+                   "neuroh5_generate: unknown population " << pop_name);
+      const pop_range_t& range = pop_ranges[pop_index[pop_name]];
+      size_t num_points = 0;
+      for (size_t batch_start = 0; batch_start < range.count; batch_start += stride)
+        {
+          forward_list<neurotree_t> tree_list;
+          for (size_t i = batch_start + rank; i < min(batch_start + stride, (size_t)range.count); i += size)
+            {
+              const CELL_IDX_T gid = range.start + i;
+              mt19937_64 gen = cell_generator(seed, 0, gid);
+              tree_list.push_front(generate_tree(gen, gid, it.second));
+              num_points += get<4>(tree_list.front()).size();
+            }
+          throw_assert(cell::append_trees(MPI_COMM_WORLD, output_file_name, pop_name, range.start,
+                                          tree_list, io_size, chunk_size, value_chunk_size) >= 0,
+                       "neuroh5_generate: error in append_trees");
+        }
+
+      size_t total_num_points = 0;
+      throw_assert(MPI_Reduce(&num_points, &total_num_points, 1, MPI_SIZE_T, MPI_SUM, 0,
+                              MPI_COMM_WORLD) == MPI_SUCCESS,
+                   "neuroh5_generate: error in MPI_Reduce");
+      if (rank == 0)
+        {
+          printf("neuroh5_generate: trees of %s: %zu points\n", pop_name.c_str(), total_num_points);
+        }
+    }
+
+  // cell attributes, by population and namespace
+  map< pair<string, string>, vector<synth_attr_t> > cell_attr_map;
+  for (const synth_attr_t& attr : cell_attrs)
+    {
+      throw_assert(pop_index.find(attr.pop) != pop_index.end(),
+                   "neuroh5_generate: unknown population " << attr.pop);
+      cell_attr_map[make_pair(attr.pop, attr.name_space)].push_back(attr);
+    }
+  for (auto const& it : cell_attr_map)
+    {
+      const string& pop_name = it.first.first;
+      const string& name_space = it.first.second;
+      const pop_range_t& range = pop_ranges[pop_index[pop_name]];
+      for (size_t batch_start = 0; batch_start < range.count; batch_start += stride)
+        {
+          synth_cell_values_t values;
+          for (size_t i = batch_start + rank; i < min(batch_start + stride, (size_t)range.count); i += size)
+            {
+              const CELL_IDX_T gid = range.start + i;
+              for (size_t a = 0; a < it.second.size(); a++)
+                {
+                  mt19937_64 gen = cell_generator(seed, (uint64_t)1 << 32 | a, gid);
+                  generate_cell_values(gen, gid, it.second[a], values);
+                }
+            }
+          cell::append_cell_attribute_maps(MPI_COMM_WORLD, output_file_name, name_space, pop_name, range.start,
+                                           values.uint32_values, values.int32_values,
+                                           values.uint16_values, values.int16_values,
+                                           values.uint8_values, values.int8_values,
+                                           values.float_values, io_size, data::optional_hid(),
+                                           IndexOwner, CellPtr(PtrOwner), chunk_size, value_chunk_size);
+        }
+      if (rank == 0)
+        {
+          printf("neuroh5_generate: cell attributes %s of %s: %zu cells\n",
+                 name_space.c_str(), pop_name.c_str(), (size_t)range.count);
+        }
+    }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,158 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file neuroh5_merge.cc
+///
+///  Driver program that merges the projections and cell attribute
+///  namespaces of several NeuroH5 files into one file, without reading
+///  and rewriting the values.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+
+#include "debug.hh"
+
+#include "neuroh5_types.hh"
+#include "merge_files.hh"
+#include "tokenize.hh"
+#include "throw_assert.hh"
+
+#include <mpi.h>
+#include <getopt.h>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+using namespace std;
+using namespace neuroh5;
+
+
+void throw_err(char const* err_message)
+{
+  fprintf(stderr, "Error: %s\n", err_message);
+  MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+
+void print_usage_full(char** argv)
+{
+  printf("Usage: %s [options] <OUTPUT FILE> <INPUT FILE>...\n\n", argv[0]);
+  printf("Merges the projections and cell attribute namespaces of the input files\n");
+  printf("into a new output file. Projections and namespaces contained in several\n");
+  printf("input files are concatenated in the order of the files. The values are\n");
+  printf("not decoded: the output datasets are virtual datasets over the input\n");
+  printf("files, or over copies of their chunks with --copy.\n\n");
+  printf("Options:\n");
+  printf("\t-p, --projection <SRC>:<DST>:\n");
+  printf("\t\tMerge the given projection (default: all projections)\n");
+  printf("\t-n, --namespace <POPULATION>:<NAMESPACE>:\n");
+  printf("\t\tMerge the given cell attribute namespace (default: all namespaces)\n");
+  printf("\t-c, --copy:\n");
+  printf("\t\tCopy the datasets of the input files into the output file\n");
+}
+
+
+static pair<string,string> parse_pair (const string& s)
+{
+  vector<string> tokens;
+  data::tokenize(s, ":", tokens);
+  if (tokens.size() != 2)
+    {
+      throw_err(("invalid argument " + s).c_str());
+    }
+  return make_pair(tokens[0], tokens[1]);
+}
+
+
+/*****************************************************************************
+ * Main driver
+ *****************************************************************************/
+
+int main(int argc, char** argv)
+{
+  string output_file_name;
+  vector<string> input_file_names;
+  vector< pair<string,string> > prj_names, name_spaces;
+  bool opt_copy = false;
+
+  throw_assert(MPI_Init(&argc, &argv) >= 0,
+               "neuroh5_merge: error in MPI initialization");
+
+  int rank, size;
+  throw_assert(MPI_Comm_size(MPI_COMM_WORLD, &size) == MPI_SUCCESS,
+               "neuroh5_merge: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(MPI_COMM_WORLD, &rank) == MPI_SUCCESS,
+               "neuroh5_merge: error in MPI_Comm_rank");
+
+  debug_enabled = false;
+
+  static struct option long_options[] = {
+    {"projection",       required_argument, 0, 'p' },
+    {"namespace",        required_argument, 0, 'n' },
+    {"copy",             no_argument,       0, 'c' },
+    {0,         0,                 0,  0 }
+  };
+  int c;
+  int option_index = 0;
+  while ((c = getopt_long (argc, argv, "chn:p:", long_options, &option_index)) != -1)
+    {
+      switch (c)
+        {
+        case 'p':
+          prj_names.push_back(parse_pair(optarg));
+          break;
+        case 'n':
+          name_spaces.push_back(parse_pair(optarg));
+          break;
+        case 'c':
+          opt_copy = true;
+          break;
+        case 'h':
+          print_usage_full(argv);
+          exit(0);
+          break;
+        default:
+          throw_err("Input argument format error");
+        }
+    }
+
+  if (optind+1 < argc)
+    {
+      output_file_name = string(argv[optind]);
+      for (int i = optind+1; i < argc; i++)
+        {
+          input_file_names.push_back(string(argv[i]));
+        }
+    }
+  else
+    {
+      print_usage_full(argv);
+      exit(1);
+    }
+
+  double start_time = MPI_Wtime();
+  graph::merge_files(MPI_COMM_WORLD, output_file_name, input_file_names,
+                     prj_names, name_spaces, opt_copy);
+  if (rank == 0)
+    {
+      for (auto const& prj_name : prj_names)
+        {
+          printf("neuroh5_merge: merged projection %s -> %s\n",
+                 prj_name.first.c_str(), prj_name.second.c_str());
+        }
+      for (auto const& name_space : name_spaces)
+        {
+          printf("neuroh5_merge: merged namespace %s of %s\n",
+                 name_space.second.c_str(), name_space.first.c_str());
+        }
+      printf("neuroh5_merge: merged %lu files in %.3f s\n",
+             (unsigned long)input_file_names.size(), MPI_Wtime() - start_time);
+    }
+
+  MPI_Finalize();
+  return 0;
+}
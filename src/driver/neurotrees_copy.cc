@@ -37,8 +37,7 @@
 #include "create_file_toplevel.hh"
 #include "exists_tree_h5types.hh"
 #include "copy_tree_h5types.hh"
-#include "serialize_tree.hh"
-#include "alltoallv_template.hh"
+#include "tree_template_set.hh"
 
 
 using namespace std;
@@ -71,6 +70,7 @@ void print_usage_full(char** argv)
     "Options:" << endl <<
     "-h               Print this help" << endl <<
     "--fill           Copy the given source id to all cell ids in the population" << endl <<
+    "--template       Store the source tree once as a morphology template and make the destination ids refer to it" << endl <<
     "--output FILE    Specify output file " << endl <<
     "--chunk-size SIZE    Specify HDF5 chunk size for index and pointer datasets " << endl <<
     "--value-chunk-size SIZE    Specify HDF5 chunk size for value datasets " << endl <<
@@ -91,7 +91,7 @@ int main(int argc, char** argv)
   size_t write_size=0;
   CELL_IDX_T source_gid;
   std::vector<CELL_IDX_T> target_gid_list;
-  forward_list<neurotree_t> input_tree_list, output_tree_list;
+  forward_list<neurotree_t> output_tree_list;
   size_t chunk_size=10000, value_chunk_size=100000;
   MPI_Comm all_comm;
   
@@ -107,6 +107,7 @@ int main(int argc, char** argv)
                "error in MPI_Comm_size");
 
   int optflag_fill         = 0;
+  int optflag_template     = 0;
   int optflag_output       = 0;
   int optflag_write_size   = 0;
   int optflag_chunk_size   = 0;
@@ -114,6 +115,7 @@ int main(int argc, char** argv)
 
   bool opt_attributes      = false;
   bool opt_fill            = false;
+  bool opt_template        = false;
   bool opt_output_filename = false;
   bool opt_write_size      = false;
   bool opt_chunk_size      = false;
@@ -121,6 +123,7 @@ int main(int argc, char** argv)
   // parse arguments
   static struct option long_options[] = {
     {"fill",    no_argument, &optflag_fill,  1 },
+    {"template",    no_argument, &optflag_template,  1 },
     {"output",  required_argument, &optflag_output,  1 },
     {"write-size",  required_argument, &optflag_write_size,  1 },
     {"chunk-size",  required_argument, &optflag_chunk_size,  1 },
@@ -139,6 +142,10 @@ int main(int argc, char** argv)
             opt_fill = true;
             optflag_fill = 0;
           }
+          if (optflag_template == 1) {
+            opt_template = true;
+            optflag_template = 0;
+          }
           if (optflag_output == 1) {
             opt_output_filename = true;
             output_filename = string(optarg);
@@ -254,73 +261,19 @@ int main(int argc, char** argv)
 
   CELL_IDX_T pop_start = pop_ranges[pop_idx].start;
   
-  throw_assert(cell::read_trees (all_comm, input_filename,
-                                 pop_name, pop_start,
-                                 input_tree_list) >= 0,
-               "error in read_trees");
-  size_t local_tree_list_len = std::distance(input_tree_list.begin(), input_tree_list.end());
-  size_t tree_list_len = 0;
-  throw_assert(MPI_Reduce(&local_tree_list_len, &tree_list_len, 1, MPI_SIZE_T, MPI_SUM, 0, all_comm) == MPI_SUCCESS,
-               "error in MPI_Reduce");
-
-  if (rank == 0)
-    {
-      throw_assert(tree_list_len > 0,
-                   "empty list of input trees");
-    }
-  
-  for_each(input_tree_list.cbegin(),
-           input_tree_list.cend(),
-           [&] (const neurotree_t& tree)
-           { cell::validate_tree(tree); } 
-           );
-
-  
-  auto local_find_it = std::find_if(input_tree_list.begin(), input_tree_list.end(),
-                                    [&](const neurotree_t& e) {return std::get<0>(e) == source_gid;});
-  int find_result = local_find_it != input_tree_list.end();
-  vector<int> find_results;
-  find_results.resize(size, 0);
-  throw_assert(MPI_Allgather(&find_result, 1, MPI_INT, &find_results[0], 1, MPI_INT, all_comm) == MPI_SUCCESS,
-               "error in MPI_Allgather");
-  auto find_it = std::find(find_results.begin(), find_results.end(), 1);
-  throw_assert (find_it != find_results.end(),
-                "unable to find source gid " << source_gid);
-  rank_t found_rank_index = find_it - find_results.begin(); 
-
-  map<rank_t, map<CELL_IDX_T, neurotree_t> > tree_rank_map;
-  if (rank == found_rank_index)
-    {
-      const neurotree_t input_tree = *local_find_it;
-      for (rank_t tree_rank = 0; tree_rank < size; tree_rank++)
-        {
-          tree_rank_map[tree_rank].insert(make_pair(source_gid, input_tree));
-        }
-    }
-
-
+  // only the source tree is needed; every rank reads the same selection
   std::forward_list<neurotree_t> source_tree_list;
   {
-    // Create packed representation of the tree subset arranged per rank
-    vector<char> sendbuf; 
-    vector<int> sendcounts, sdispls;
-    data::serialize_rank_tree_map (size, rank, tree_rank_map,
-                                   sendcounts, sendbuf, sdispls);
-    tree_rank_map.clear();
-    
-    // Send packed representation of the tree subset to the respective ranks
-    vector<char> recvbuf; 
-    vector<int> recvcounts, rdispls;
-    throw_assert(mpi::alltoallv_vector(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
-                                       recvcounts, rdispls, recvbuf) >= 0,
-                 "neurotrees_copy: error while sending tree subset to assigned ranks"); 
-    
-    sendbuf.clear();
-  
-    // Unpack tree subset on the owning ranks
-    data::deserialize_rank_tree_list (size, recvbuf, recvcounts, rdispls, source_tree_list);
-    recvbuf.clear();
+    vector<CELL_IDX_T> source_selection(1, source_gid);
+    throw_assert(cell::read_tree_selection (all_comm, input_filename,
+                                            pop_name, pop_start,
+                                            source_tree_list, source_selection) >= 0,
+                 "error in read_tree_selection");
   }
+  throw_assert (!source_tree_list.empty(),
+                "unable to find source gid " << source_gid);
+  cell::validate_tree(*source_tree_list.begin());
+
   neurotree_t input_tree = *source_tree_list.begin();
       
   const deque<SECTION_IDX_T> & src_vector=get<1>(input_tree);
@@ -399,6 +352,45 @@ int main(int argc, char** argv)
   MPI_Barrier(all_comm);
 
 
+  if (opt_template)
+    {
+      // the source tree is written once, with the source gid as its
+      // template id, unless the output file already has that template
+      data::TreeBatch template_batch;
+      vector<CELL_IDX_T> template_selection(1, source_gid);
+      throw_assert(cell::read_tree_templates(all_comm, output_filename, pop_name,
+                                             template_batch, template_selection) >= 0,
+                   "error in read_tree_templates");
+      if (template_batch.empty())
+        {
+          forward_list<neurotree_t> template_list;
+          if (rank == 0)
+            {
+              neurotree_t template_tree = input_tree;
+              get<0>(template_tree) = source_gid;
+              template_list.push_front(template_tree);
+            }
+          throw_assert(cell::append_tree_templates(all_comm, output_filename, pop_name, template_list,
+                                                   size, chunk_size, value_chunk_size) == 0,
+                       "error in append_tree_templates");
+        }
+
+      data::TreeTemplateSet template_refs;
+      for (size_t i=start; i<end; i++)
+        {
+          template_refs.append_ref(target_gid_list[i], source_gid);
+        }
+      throw_assert(cell::append_tree_template_index(all_comm, output_filename, pop_name, pop_start,
+                                                    template_refs, size,
+                                                    chunk_size, value_chunk_size) == 0,
+                   "error in append_tree_template_index");
+
+      MPI_Barrier(all_comm);
+      MPI_Comm_free(&all_comm);
+      MPI_Finalize();
+      return 0;
+    }
+
   if (write_size == 0)
     {
       write_size = end-start;
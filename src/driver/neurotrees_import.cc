@@ -28,7 +28,9 @@
 #include "neuroh5_types.hh"
 #include "read_layer_swc.hh"
 #include "rank_range.hh"
+#include "mapped_file.hh"
 #include "validate_tree.hh"
+#include "thread_pool.hh"
 #include "append_tree.hh"
 #include "insert_tree_points.hh"
 #include "path_names.hh"
@@ -74,24 +76,83 @@ void print_usage_full(char** argv)
     "-t SWCTYPE Specify default SWC type (indicates that input SWC has layer info instead of type) " << endl <<
     "-y OFFSET  Specify layer offset " << endl <<
     "-i FILE    Read given SWC file and prepend its points into every read file " << endl <<
+    "-j NUM     Number of threads per rank for reading and validating trees " << endl <<
     endl;
 }
 
 
 
+// Assigns a contiguous range of files to each rank, such that each
+// rank reads approximately the same number of bytes
+void compute_file_ranges
+(
+ MPI_Comm comm,
+ const vector<string>& file_names,
+ vector< pair<hsize_t,hsize_t> >& ranges
+ )
+{
+  int rank, size;
+  throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+               "neurotrees_import: error in MPI_Comm_size");
+  throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+               "neurotrees_import: error in MPI_Comm_rank");
+
+  // each rank determines the sizes of a subset of the files
+  vector<uint64_t> file_sizes(file_names.size(), 0);
+  mpi::rank_ranges(file_names.size(), size, ranges);
+  for (size_t i=ranges[rank].first; i<ranges[rank].first+ranges[rank].second; i++)
+    {
+      file_sizes[i] = io::file_size(file_names[i]);
+    }
+  if (file_sizes.size() > 0)
+    {
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, &file_sizes[0], file_sizes.size(),
+                                 MPI_UINT64_T, MPI_SUM, comm) == MPI_SUCCESS,
+                   "neurotrees_import: error in MPI_Allreduce");
+    }
+
+  uint64_t total_size = 0;
+  for (auto s : file_sizes)
+    {
+      total_size += s;
+    }
+
+  // file i is assigned to the rank whose byte range contains the
+  // first byte of the file
+  vector<size_t> file_rank(file_names.size());
+  uint64_t offset = 0;
+  for (size_t i=0; i<file_names.size(); i++)
+    {
+      file_rank[i] = (total_size > 0) ? (size_t)((offset * size) / total_size) : (i * size) / file_names.size();
+      offset += file_sizes[i];
+    }
+  ranges.assign(size, make_pair(0, 0));
+  for (size_t i=0; i<file_names.size(); i++)
+    {
+      size_t r = file_rank[i];
+      if (ranges[r].second == 0)
+        {
+          ranges[r].first = i;
+        }
+      ranges[r].second++;
+    }
+}
+
+
 /*****************************************************************************
  * Main driver
  *****************************************************************************/
 
 int main(int argc, char** argv)
 {
-  int status;
+  int status = 0;
   std::string pop_name;
   std::string output_file_name;
   std::string filelist_name, idfilelist_name, singleton_filename, include_filename;
   std::vector<std::string> input_file_names;
   std::vector<CELL_IDX_T> gid_list;
   int tree_id_offset=0, node_id_offset=0, layer_offset=0; int swc_type=0; int include_layer=0;
+  size_t num_threads = data::default_num_threads();
   forward_list<neurotree_t> tree_list, include_tree_list;
   MPI_Comm all_comm;
   
@@ -122,7 +183,7 @@ int main(int argc, char** argv)
   };
   char c;
   int option_index = 0;
-  while ((c = getopt_long (argc, argv, "hd:e:i:o:r:t:l:n:sy:", long_options, &option_index)) != -1)
+  while ((c = getopt_long (argc, argv, "hd:e:i:j:o:r:t:l:n:sy:", long_options, &option_index)) != -1)
     {
       stringstream ss;
       switch (c)
@@ -140,6 +201,10 @@ int main(int argc, char** argv)
           opt_include = true;
           include_filename = string(optarg);
           break;
+        case 'j':
+          ss << string(optarg);
+          ss >> num_threads;
+          break;
         case 'e':
           opt_include_layer = true;
           ss << string(optarg);
@@ -246,11 +311,13 @@ int main(int argc, char** argv)
 
   // determine which trees are read by which rank
   vector< pair<hsize_t,hsize_t> > ranges;
-  mpi::rank_ranges(input_file_names.size(), size, ranges);
+  compute_file_ranges(all_comm, input_file_names, ranges);
 
   size_t filecount=0;
   hsize_t start=ranges[rank].first, end=ranges[rank].first+ranges[rank].second;
 
+  data::thread_pool pool(num_threads);
+
   throw_assert(gid_list.size() > 0,
                "neurotrees_import: empty list of gids");
   
@@ -280,38 +347,37 @@ int main(int argc, char** argv)
     }
   else
     {
-      if (opt_swctype) 
+      // files are read and contracted in parallel by the threads of
+      // this rank; the trees are then prepended to tree_list in file
+      // order
+      vector< forward_list<neurotree_t> > file_tree_lists(end-start);
+      pool.parallel_for(end-start,
+                        [&] (size_t k, size_t worker)
+                        {
+                          size_t i = start+k;
+                          std::string input_file_name = input_file_names[i];
+                          CELL_IDX_T gid = gid_list[i];
+                          if (opt_swctype) 
+                            {
+                              // if swc type is given, then we are reading an swc file with layer encoding
+                              io::read_layer_swc (input_file_name, gid, node_id_offset, layer_offset,
+                                                  swc_type, opt_split_layers, file_tree_lists[k]);
+                            }
+                          else
+                            {
+                              // if swc type is not given, then we are reading a regular swc file
+                              io::read_swc (input_file_name, gid, node_id_offset, file_tree_lists[k]);
+                            }
+                        });
+      for (size_t k=0; k<file_tree_lists.size(); k++)
         {
-          // if swc type is given, then we are reading an swc file with layer encoding
-          for (size_t i=start; i<end; i++)
+          tree_list.splice_after(tree_list.before_begin(), file_tree_lists[k]);
+          filecount++;
+          if (filecount % 1000 == 0)
             {
-              std::string input_file_name = input_file_names[i];
-              CELL_IDX_T gid = gid_list[i];
-              status = io::read_layer_swc (input_file_name, gid, node_id_offset, layer_offset,
-                                           swc_type, opt_split_layers, tree_list);
-              filecount++;
-              if (filecount % 1000 == 0)
-                {
-                  printf("Task %d: %lu trees read\n", rank,  filecount);
-                }
+              printf("Task %d: %lu trees read\n", rank,  filecount);
             }
         }
-      else
-        {
-          // if swc type is not given, then we are reading a regular swc file
-          for (size_t i=start; i<end; i++)
-            {
-              std::string input_file_name = input_file_names[i];
-              CELL_IDX_T gid = gid_list[i];
-              status = io::read_swc (input_file_name, gid, node_id_offset, tree_list);
-              filecount++;
-              if (filecount % 1000 == 0)
-                {
-                  printf("Task %d: %lu trees read\n", rank,  filecount);
-                }
-            }
-          
-        }
     }
   
   printf("Task %d has read a total of %lu trees\n", rank,  
@@ -327,10 +393,7 @@ int main(int argc, char** argv)
         }
     }
 
-  for (auto & tree : tree_list)
-    {
-      cell::validate_tree(tree);
-    }
+  cell::validate_trees(tree_list, pool);
   
   if (access( output_file_name.c_str(), F_OK ) != 0)
     {
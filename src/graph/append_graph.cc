@@ -17,10 +17,12 @@
 #include "edge_attributes.hh"
 #include "path_names.hh"
 #include "sort_permutation.hh"
+#include "sample_sort.hh"
 #include "serialize_edge.hh"
 #include "range_sample.hh"
 #include "debug.hh"
 #include "mpi_debug.hh"
+#include "mpi_trace.hh"
 #include "throw_assert.hh"
 
 #include <vector>
@@ -51,6 +53,7 @@ namespace neuroh5
      const hsize_t    chunk_size
      )
     {
+      mpi::trace_scope trace_total("append_graph");
       size_t io_size;
       size_t num_edges = 0;
       
@@ -62,8 +65,6 @@ namespace neuroh5
       size_t dst_start, dst_end;
       size_t src_start, src_end;
 
-      auto compare_nodes = [](const NODE_IDX_T& a, const NODE_IDX_T& b) { return (a < b); };
-
       int ssize, srank; size_t size, rank;
       throw_assert_nomsg(MPI_Comm_size(all_comm, &ssize) == MPI_SUCCESS);
       throw_assert_nomsg(MPI_Comm_rank(all_comm, &srank) == MPI_SUCCESS);
@@ -106,63 +107,28 @@ namespace neuroh5
       src_start = pop_ranges[src_pop_idx].start;
       src_end   = src_start + pop_ranges[src_pop_idx].count;
       
-      vector< NODE_IDX_T > node_index;
+      set<size_t> io_rank_set;
+      data::range_sample(size, io_size, io_rank_set);
+      bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
+      vector<rank_t> io_ranks(io_rank_set.begin(), io_rank_set.end());
 
-      { // Determine the destination node indices present in the input
-        // edge map across all ranks
-        size_t num_nodes = input_edge_map.size();
-        vector<size_t> sendbuf_num_nodes(size, num_nodes);
-        vector<size_t> recvbuf_num_nodes(size);
-        vector<int> recvcounts(size, 0);
-        vector<int> displs(size+1, 0);
-        throw_assert_nomsg(MPI_Allgather(&sendbuf_num_nodes[0], 1, MPI_SIZE_T,
-                                         &recvbuf_num_nodes[0], 1, MPI_SIZE_T, all_comm)
-                           == MPI_SUCCESS);
-        throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
-        for (size_t p=0; p<size; p++)
-          {
-            total_num_nodes = total_num_nodes + recvbuf_num_nodes[p];
-            displs[p+1] = displs[p] + recvbuf_num_nodes[p];
-            recvcounts[p] = recvbuf_num_nodes[p];
-          }
-        
+      // Assign contiguous ranges of destination indices to the I/O
+      // ranks, chosen by sampling the destination indices present in
+      // the input edge maps across all ranks
+      vector< NODE_IDX_T > node_splitters;
+      {
         vector< NODE_IDX_T > local_node_index;
         for (auto iter: input_edge_map)
           {
             NODE_IDX_T dst          = iter.first;
             local_node_index.push_back(dst);
           }
-        
-        node_index.resize(total_num_nodes,0);
-        throw_assert_nomsg(MPI_Allgatherv(&local_node_index[0], num_nodes, MPI_NODE_IDX_T,
-                                          &node_index[0], &recvcounts[0], &displs[0], MPI_NODE_IDX_T,
-                                          all_comm) == MPI_SUCCESS);
-        throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
-
-        vector<size_t> p = sort_permutation(node_index, compare_nodes);
-        apply_permutation_in_place(node_index, p);
+        total_num_nodes = local_node_index.size();
+        throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, &total_num_nodes, 1, MPI_SIZE_T, MPI_SUM,
+                                         all_comm) == MPI_SUCCESS);
+        mpi::sample_splitters(all_comm, local_node_index, io_ranks.size(), node_splitters);
       }
 
-      throw_assert_nomsg(node_index.size() == total_num_nodes);
-      
-      set<size_t> io_rank_set;
-      data::range_sample(size, io_size, io_rank_set);
-      bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
-
-      // A vector that maps nodes to compute ranks
-      map< NODE_IDX_T, rank_t > node_rank_map;
-      {
-        rank_t r=0; 
-        for (size_t i = 0; i < node_index.size(); i++)
-          {
-            while (io_rank_set.count(r) == 0)
-              {
-                r++;
-                if ((unsigned int)size <= r) r=0;
-              }
-            node_rank_map.insert(make_pair(node_index[i], r++));
-          }
-      }
       rank_edge_map_t rank_edge_map;
       mpi::MPI_DEBUG(all_comm, "append_graph: ", src_pop_name, " -> ", dst_pop_name, ": ",
                      " total_num_nodes = ", total_num_nodes);
@@ -177,9 +143,8 @@ namespace neuroh5
           const vector<NODE_IDX_T>& v   = get<0>(et);
           vector <AttrVal>& va    = get<1>(et);
 
-          auto it = node_rank_map.find(dst);
-          throw_assert_nomsg(it != node_rank_map.end());
-          size_t dst_rank = it->second;
+          size_t dst_rank = io_ranks[std::upper_bound(node_splitters.begin(), node_splitters.end(), dst) -
+                                     node_splitters.begin()];
           edge_tuple_t& et1 = rank_edge_map[dst_rank][dst];
 
           if (v.size() > 0)
@@ -196,7 +161,8 @@ namespace neuroh5
                   num_edges++;
                 }
             
-              vector<size_t> p = sort_permutation(adj_vector, compare_nodes);
+              vector<size_t> p;
+              mpi::radix_sort_permutation(adj_vector, p);
               
               apply_permutation_in_place(adj_vector, p);
               
@@ -263,8 +229,13 @@ namespace neuroh5
       size_t num_packed_edges = 0; 
 
 
-      data::serialize_rank_edge_map (size, rank, rank_edge_map, num_packed_edges,
-                                     sendcounts, sendbuf, sdispls);
+      {
+        mpi::trace_scope trace("append_graph.serialize");
+        data::serialize_rank_edge_map (size, rank, rank_edge_map, num_packed_edges,
+                                       sendcounts, sendbuf, sdispls);
+        trace.add_items(num_packed_edges);
+        trace.add_bytes(sendbuf.size());
+      }
       rank_edge_map.clear();
       
       // 1. Each ALL_COMM rank sends an edge vector size to
@@ -301,8 +272,11 @@ namespace neuroh5
       edge_map_t prj_edge_map;
       if (recvbuf_size > 0)
         {
+          mpi::trace_scope trace("append_graph.deserialize");
           data::deserialize_rank_edge_map (size, recvbuf, recvcounts, rdispls, 
                                            prj_edge_map, num_unpacked_nodes, num_unpacked_edges);
+          trace.add_items(num_unpacked_edges);
+          trace.add_bytes(recvbuf_size);
         }
 
       recvbuf.clear();
@@ -0,0 +1,310 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file append_graph_edges.cc
+///
+///  Top-level functions for appending edges given as flat arrays
+///  (COO or CSR form) to graphs in DBS (Destination Block Sparse) format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+
+#include "neuroh5_types.hh"
+#include "attr_map.hh"
+#include "cell_populations.hh"
+#include "append_graph_edges.hh"
+#include "append_projection.hh"
+#include "edge_attributes.hh"
+#include "sample_sort.hh"
+#include "range_sample.hh"
+#include "debug.hh"
+#include "mpi_debug.hh"
+#include "throw_assert.hh"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <algorithm>
+
+using namespace neuroh5::data;
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    template <class T>
+    static void exchange_edge_attr_columns
+    (
+     MPI_Comm                   comm,
+     const mpi::bucket_plan_t&  plan,
+     vector< vector<T> >&       columns
+     )
+    {
+      for (size_t i = 0; i < columns.size(); i++)
+        {
+          mpi::bucket_exchange(comm, plan, columns[i]);
+        }
+    }
+
+    template <class T>
+    static void check_edge_attr_columns
+    (
+     const string&                 attr_namespace,
+     const data::AttrIndex&        attr_index,
+     const size_t                  num_edges,
+     vector< vector<T> >&          columns
+     )
+    {
+      // ranks without edges may omit the attribute columns altogether
+      if (columns.size() == 0)
+        {
+          columns.resize(attr_index.size_attr_index<T>());
+        }
+      throw_assert(columns.size() == attr_index.size_attr_index<T>(),
+                   "append_graph_edges: mismatch in number of attributes in namespace " <<
+                   attr_namespace);
+      for (size_t i = 0; i < columns.size(); i++)
+        {
+          throw_assert(columns[i].size() == num_edges,
+                       "append_graph_edges: mismatch in number of edges and number of values in namespace " <<
+                       attr_namespace);
+        }
+    }
+
+
+    void expand_csr_destinations
+    (
+     const vector<NODE_IDX_T>& dst_index,
+     const vector<DST_PTR_T>&  dst_ptr,
+     vector<NODE_IDX_T>&       dst
+     )
+    {
+      throw_assert(dst_ptr.size() == dst_index.size()+1,
+                   "expand_csr_destinations: destination pointer array must have one more element than destination array");
+      dst.clear();
+      dst.reserve(dst_ptr.back() - dst_ptr.front());
+      for (size_t i = 0; i < dst_index.size(); i++)
+        {
+          throw_assert(dst_ptr[i] <= dst_ptr[i+1],
+                       "expand_csr_destinations: destination pointers are not monotonic");
+          dst.insert(dst.end(), dst_ptr[i+1] - dst_ptr[i], dst_index[i]);
+        }
+    }
+
+
+    int append_graph_edges
+    (
+     MPI_Comm         all_comm,
+     const int        io_size_arg,
+     const string&    file_name,
+     const string&    src_pop_name,
+     const string&    dst_pop_name,
+     const std::map <std::string, std::pair <size_t, data::AttrIndex > >& edge_attr_index,
+     vector<NODE_IDX_T>& dst,
+     vector<NODE_IDX_T>& src,
+     map <string, data::NamedAttrVal>& edge_attr_map,
+     const hsize_t    chunk_size
+     )
+    {
+      size_t io_size;
+
+      // read the population info
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      size_t src_pop_idx=0, dst_pop_idx=0; bool src_pop_set=false, dst_pop_set=false;
+      size_t pop_num_nodes=0;
+      size_t dst_start, dst_end;
+      size_t src_start, src_end;
+
+      int ssize, srank; size_t size, rank;
+      throw_assert_nomsg(MPI_Comm_size(all_comm, &ssize) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(all_comm, &srank) == MPI_SUCCESS);
+      throw_assert_nomsg(ssize > 0);
+      throw_assert_nomsg(srank >= 0);
+      size = ssize;
+      rank = srank;
+
+      if (ssize < io_size_arg)
+        {
+          io_size = size > 0 ? size : 1;
+        }
+      else
+        {
+          io_size = io_size_arg > 0 ? (size_t)io_size_arg : 1;
+        }
+      throw_assert_nomsg(cell::read_population_ranges(all_comm, file_name, pop_ranges, pop_num_nodes) >= 0);
+      throw_assert_nomsg(cell::read_population_labels(all_comm, file_name, pop_labels) >= 0);
+
+      for (auto& x: pop_labels)
+        {
+          if (src_pop_name == get<1>(x))
+            {
+              src_pop_idx = get<0>(x);
+              src_pop_set = true;
+            }
+          if (dst_pop_name == get<1>(x))
+            {
+              dst_pop_idx = get<0>(x);
+              dst_pop_set = true;
+            }
+        }
+      throw_assert_nomsg(dst_pop_set && src_pop_set);
+
+      dst_start = pop_ranges[dst_pop_idx].start;
+      dst_end   = dst_start + pop_ranges[dst_pop_idx].count;
+      src_start = pop_ranges[src_pop_idx].start;
+      src_end   = src_start + pop_ranges[src_pop_idx].count;
+
+      const size_t num_edges = dst.size();
+      throw_assert(src.size() == num_edges,
+                   "append_graph_edges: mismatch in number of source and destination indices");
+
+      for (auto const& iter : edge_attr_index)
+        {
+          const string & attr_namespace = iter.first;
+          const data::AttrIndex& attr_index  = iter.second.second;
+          data::NamedAttrVal& edge_attr = edge_attr_map[attr_namespace];
+
+          check_edge_attr_columns<float>(attr_namespace, attr_index, num_edges, edge_attr.float_values);
+          check_edge_attr_columns<uint8_t>(attr_namespace, attr_index, num_edges, edge_attr.uint8_values);
+          check_edge_attr_columns<uint16_t>(attr_namespace, attr_index, num_edges, edge_attr.uint16_values);
+          check_edge_attr_columns<uint32_t>(attr_namespace, attr_index, num_edges, edge_attr.uint32_values);
+          check_edge_attr_columns<int8_t>(attr_namespace, attr_index, num_edges, edge_attr.int8_values);
+          check_edge_attr_columns<int16_t>(attr_namespace, attr_index, num_edges, edge_attr.int16_values);
+          check_edge_attr_columns<int32_t>(attr_namespace, attr_index, num_edges, edge_attr.int32_values);
+        }
+      throw_assert(edge_attr_map.size() == edge_attr_index.size(),
+                   "append_graph_edges: edge attribute namespaces do not match attribute index");
+
+      set<size_t> io_rank_set;
+      data::range_sample(size, io_size, io_rank_set);
+      bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
+      vector<rank_t> io_ranks(io_rank_set.begin(), io_rank_set.end());
+
+      // all source/destination node IDs must be in range
+      for (size_t i = 0; i < num_edges; i++)
+        {
+          const NODE_IDX_T d = dst[i];
+          const NODE_IDX_T s = src[i];
+          throw_assert(dst_start <= d && d < dst_end,
+                       "append_graph_edges: destination index " << d << " out of range");
+          throw_assert(src_start <= s && s < src_end,
+                       "append_graph_edges: source index " << s << " out of range");
+          src[i] = s - src_start;
+        }
+
+      // Each I/O rank is assigned a contiguous range of destination
+      // indices with approximately equal number of edges, so that the
+      // concatenation of the I/O rank outputs is sorted by destination.
+      vector<NODE_IDX_T> splitters;
+      mpi::sample_splitters(all_comm, dst, io_ranks.size(), splitters);
+      mpi::bucket_plan_t plan;
+      mpi::bucket_plan(all_comm, dst, splitters, io_ranks, plan);
+
+      mpi::MPI_DEBUG(all_comm, "append_graph_edges: ", src_pop_name, " -> ", dst_pop_name, ": ",
+                     " num_edges = ", num_edges);
+
+      mpi::bucket_exchange(all_comm, plan, dst);
+      mpi::bucket_exchange(all_comm, plan, src);
+
+      // Sort the received edges by destination, and by source within
+      // each destination; the attribute columns are reordered
+      // accordingly as they are received
+      {
+        vector<size_t>& recv_perm = plan.recv_perm;
+        mpi::radix_sort_permutation(src, recv_perm);
+        mpi::radix_sort_permutation(dst, recv_perm);
+        mpi::permute_column(recv_perm, dst);
+        mpi::permute_column(recv_perm, src);
+      }
+
+      for (auto& iter : edge_attr_map)
+        {
+          data::NamedAttrVal& edge_attr = iter.second;
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.float_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.uint8_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.uint16_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.uint32_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.int8_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.int16_values);
+          exchange_edge_attr_columns(all_comm, plan, edge_attr.int32_values);
+        }
+
+      // Build the compressed sparse row index
+      const size_t num_recv_edges = dst.size();
+      throw_assert_nomsg(is_io_rank || (num_recv_edges == 0));
+      vector<NODE_IDX_T> dst_index;
+      vector<DST_PTR_T> dst_index_ptr(1, 0);
+      for (size_t i = 0; i < num_recv_edges; i++)
+        {
+          if (dst_index.empty() || (dst_index.back() != dst[i]))
+            {
+              if (!dst_index.empty())
+                {
+                  dst_index_ptr.push_back(i);
+                }
+              dst_index.push_back(dst[i]);
+            }
+        }
+      if (!dst_index.empty())
+        {
+          dst_index_ptr.push_back(num_recv_edges);
+        }
+      dst.clear();
+      dst.shrink_to_fit();
+
+      // Create an I/O communicator
+      MPI_Comm  io_comm;
+      // MPI group color value used for I/O ranks
+      int io_color = 1;
+      if (is_io_rank)
+        {
+          MPI_Comm_split(all_comm,io_color,rank,&io_comm);
+          MPI_Comm_set_errhandler(io_comm, MPI_ERRORS_RETURN);
+        }
+      else
+        {
+          MPI_Comm_split(all_comm,0,rank,&io_comm);
+        }
+
+      if (is_io_rank)
+        {
+          hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+          throw_assert_nomsg(fapl >= 0);
+#ifdef HDF5_IS_PARALLEL
+          throw_assert_nomsg(H5Pset_fapl_mpio(fapl, io_comm, MPI_INFO_NULL) >= 0);
+#endif
+
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, fapl);
+          throw_assert_nomsg(file >= 0);
+
+          hdf5::create_projection_groups(file, src_pop_name, dst_pop_name);
+
+          throw_assert_nomsg(H5Fclose(file) >= 0);
+
+          file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, fapl);
+          throw_assert_nomsg(file >= 0);
+
+          append_projection (io_comm, file, src_pop_name, dst_pop_name,
+                             src_start, src_end, dst_start, dst_end,
+                             dst_index, dst_index_ptr, src,
+                             edge_attr_map, edge_attr_index, chunk_size);
+
+          throw_assert_nomsg(MPI_Barrier(io_comm) == MPI_SUCCESS);
+          throw_assert_nomsg(H5Fclose(file) >= 0);
+          throw_assert_nomsg(H5Pclose(fapl) >= 0);
+        }
+      throw_assert_nomsg(MPI_Barrier(io_comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_free(&io_comm) == MPI_SUCCESS);
+
+      src.clear();
+      src.shrink_to_fit();
+      edge_attr_map.clear();
+
+      throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
+      return 0;
+    }
+  }
+}
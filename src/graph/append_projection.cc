@@ -9,6 +9,7 @@
 #include "edge_attributes.hh"
 #include "mpe_seq.hh"
 #include "mpi_debug.hh"
+#include "mpi_trace.hh"
 #include "debug.hh"
 #include "throw_assert.hh"
 
@@ -391,7 +392,7 @@ namespace neuroh5
      const hsize_t             block_size,
      const bool                collective,
      vector<size_t>&           recvbuf_num_edge,
-     vector<NODE_IDX_T>        src_idx
+     const vector<NODE_IDX_T>& src_idx
      )
     {
 
@@ -506,9 +507,91 @@ namespace neuroh5
      const bool collective
      )
     {
+      // create destination index and pointers, and source index
+      vector<NODE_IDX_T> dst_index, src_idx;
+      vector<DST_PTR_T> dst_ptr;
+      dst_index.reserve(prj_edge_map.size());
+      dst_ptr.reserve(prj_edge_map.size()+1);
+      src_idx.reserve(num_edges);
+      dst_ptr.push_back(0);
+      
+      vector <string> edge_attr_name_spaces;
+      map <string, data::NamedAttrVal> edge_attr_map;
+
+      for (auto const& iter : edge_attr_index)
+        {
+          const string & attr_namespace = iter.first;
+          const data::AttrIndex& attr_index  = iter.second.second;
+
+          data::NamedAttrVal& edge_attr = edge_attr_map[attr_namespace];
+
+          edge_attr.float_values.resize(attr_index.size_attr_index<float>());
+          edge_attr.uint8_values.resize(attr_index.size_attr_index<uint8_t>());
+          edge_attr.uint16_values.resize(attr_index.size_attr_index<uint16_t>());
+          edge_attr.uint32_values.resize(attr_index.size_attr_index<uint32_t>());
+          edge_attr.int8_values.resize(attr_index.size_attr_index<int8_t>());
+          edge_attr.int16_values.resize(attr_index.size_attr_index<int16_t>());
+          edge_attr.int32_values.resize(attr_index.size_attr_index<int32_t>());
+
+          edge_attr_name_spaces.push_back(attr_namespace);
+        }
+
+      for (auto const& iter : prj_edge_map)
+        {
+          const NODE_IDX_T dst = iter.first;
+          const edge_tuple_t& et = iter.second;
+          const vector<NODE_IDX_T>& v = get<0>(et);
+          const vector<data::AttrVal>& va = get<1>(et);
+
+          dst_index.push_back(dst);
+          src_idx.insert(src_idx.end(), v.begin(), v.end());
+          dst_ptr.push_back(src_idx.size());
+
+          size_t ni=0;
+          for (auto const& a : va)
+            {
+              const string & attr_namespace = edge_attr_name_spaces[ni];
+              auto & edge_attr = edge_attr_map[attr_namespace];
+              edge_attr.append(a);
+              ni++;
+            }
+        }
+      throw_assert_nomsg(num_edges == src_idx.size());
+
+      append_projection(comm, file, src_pop_name, dst_pop_name,
+                        src_start, src_end, dst_start, dst_end,
+                        dst_index, dst_ptr, src_idx,
+                        edge_attr_map, edge_attr_index,
+                        chunk_size, block_size, collective);
+    }
+
+    
+    void append_projection
+    (
+     MPI_Comm                  comm,
+     hid_t                     file,
+     const string&             src_pop_name,
+     const string&             dst_pop_name,
+     const NODE_IDX_T&         src_start,
+     const NODE_IDX_T&         src_end,
+     const NODE_IDX_T&         dst_start,
+     const NODE_IDX_T&         dst_end,
+     const vector<NODE_IDX_T>& dst_index,
+     const vector<DST_PTR_T>&  dst_index_ptr,
+     const vector<NODE_IDX_T>& src_idx,
+     const map <string, data::NamedAttrVal>& edge_attr_map,
+     const std::map <std::string, std::pair <size_t, data::AttrIndex > >& edge_attr_index,
+     const hsize_t             chunk_size,
+     const hsize_t             block_size,
+     const bool collective
+     )
+    {
+      mpi::trace_scope trace_total("append_projection");
       // do a sanity check on the input
       throw_assert_nomsg(src_start < src_end);
       throw_assert_nomsg(dst_start < dst_end);
+      throw_assert_nomsg(dst_index_ptr.size() == dst_index.size()+1);
+      throw_assert_nomsg(dst_index_ptr.back() == src_idx.size());
       
       int ssize, srank;
       throw_assert_nomsg(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS);
@@ -517,27 +600,27 @@ namespace neuroh5
       size = (size_t)ssize;
       rank = (size_t)srank;
 
-        
-      size_t num_dest = prj_edge_map.size();
+      size_t num_edges = src_idx.size();
+      size_t num_dest = dst_index.size();
       size_t num_blocks = num_dest > 0 ? 1 : 0;
 
-      // create relative destination pointers and source index
+      // create relative destination block pointers and destination pointers
       vector<DST_BLK_PTR_T> dst_blk_ptr; 
       vector<DST_PTR_T> dst_ptr;
-      vector<NODE_IDX_T> dst_blk_idx, src_idx;
+      vector<NODE_IDX_T> dst_blk_idx;
       NODE_IDX_T first_idx = 0, last_idx = 0;
       hsize_t num_block_edges = 0, num_prj_edges = 0;
-      if (!prj_edge_map.empty())
+      if (num_dest > 0)
         {
-          first_idx = (prj_edge_map.begin())->first;
+          first_idx = dst_index[0];
           last_idx  = first_idx;
           dst_blk_idx.push_back(first_idx - dst_start);
           dst_blk_ptr.push_back(0);
-          for (auto iter = prj_edge_map.begin(); iter != prj_edge_map.end(); ++iter)
+          dst_ptr.reserve(num_dest+1);
+          for (size_t i = 0; i < num_dest; ++i)
             {
-              NODE_IDX_T dst = iter->first;
-              edge_tuple_t et = iter->second;
-              vector<NODE_IDX_T> &v = get<0>(et);
+              NODE_IDX_T dst = dst_index[i];
+              size_t dst_num_edges = dst_index_ptr[i+1] - dst_index_ptr[i];
               
               // creates new block if non-contiguous dst indices
               if (((dst > 0) && ((dst-1) > last_idx)) || (num_block_edges > block_size))
@@ -549,13 +632,12 @@ namespace neuroh5
                 }
               last_idx = dst;
               
-              copy(v.begin(), v.end(), back_inserter(src_idx));
               dst_ptr.push_back(num_prj_edges);
-              num_prj_edges += v.size();
-              num_block_edges += v.size();
+              num_prj_edges += dst_num_edges;
+              num_block_edges += dst_num_edges;
             }
         }
-      throw_assert_nomsg(num_edges == src_idx.size());
+      throw_assert_nomsg(num_edges == num_prj_edges);
 
       size_t sum_num_edges = 0;
       throw_assert_nomsg(MPI_Allreduce(&num_edges, &sum_num_edges, 1,
@@ -751,41 +833,6 @@ namespace neuroh5
          src_idx
          );
 
-      vector <string> edge_attr_name_spaces;
-      map <string, data::NamedAttrVal> edge_attr_map;
-
-      for (auto const& iter : edge_attr_index)
-        {
-          const string & attr_namespace = iter.first;
-          const data::AttrIndex& attr_index  = iter.second.second;
-
-          data::NamedAttrVal& edge_attr = edge_attr_map[attr_namespace];
-
-          edge_attr.float_values.resize(attr_index.size_attr_index<float>());
-          edge_attr.uint8_values.resize(attr_index.size_attr_index<uint8_t>());
-          edge_attr.uint16_values.resize(attr_index.size_attr_index<uint16_t>());
-          edge_attr.uint32_values.resize(attr_index.size_attr_index<uint32_t>());
-          edge_attr.int8_values.resize(attr_index.size_attr_index<int8_t>());
-          edge_attr.int16_values.resize(attr_index.size_attr_index<int16_t>());
-          edge_attr.int32_values.resize(attr_index.size_attr_index<int32_t>());
-
-          edge_attr_name_spaces.push_back(attr_namespace);
-        }
-        
-      for (auto const& iter : prj_edge_map)
-	{
-	  const edge_tuple_t& et = iter.second;
-          //const vector<NODE_IDX_T>& v = get<0>(et);
-          const vector<data::AttrVal>& va = get<1>(et);
-          size_t ni=0;
-          for (auto const& a : va)
-            {
-              const string & attr_namespace = edge_attr_name_spaces[ni];
-              auto & edge_attr = edge_attr_map[attr_namespace];
-              edge_attr.append(a);
-              ni++;
-            }
-	}
       throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
 
       append_edge_attribute_map<float>(comm, file, src_pop_name, dst_pop_name,
@@ -11,12 +11,10 @@
 #include "debug.hh"
 
 #include "neuroh5_types.hh"
-#include "read_projection.hh"
+#include "balance_graph_indegree.hh"
 #include "cell_populations.hh"
-#include "scatter_read_graph.hh"
-#include "merge_edge_map.hh"
-#include "vertex_degree.hh"
-#include "validate_edge_list.hh"
+#include "read_projection_datasets.hh"
+#include "alltoallv_template.hh"
 #include "throw_assert.hh"
 
 #include <getopt.h>
@@ -30,6 +28,8 @@
 #include <set>
 #include <vector>
 #include <algorithm>
+#include <cstring>
+#include <queue>
 
 #include <mpi.h>
 
@@ -58,28 +58,6 @@ namespace neuroh5
       MPI_Abort(MPI_COMM_WORLD, 1);
     }
 
-    // Assign each node to a rank 
-    static void compute_node_rank_map
-    (
-     size_t num_ranks,
-     size_t num_nodes,
-     node_rank_map_t &node_rank_map
-     )
-    {
-      hsize_t remainder=0, offset=0, buckets=0;
-    
-      for (size_t i=0; i<num_ranks; i++)
-        {
-          remainder  = num_nodes - offset;
-          buckets    = num_ranks - i;
-          for (size_t j = 0; j < remainder / buckets; j++)
-            {
-              node_rank_map[offset+j].insert(i);
-            }
-          offset    += remainder / buckets;
-        }
-    }
-
     void compute_part_nums
     (
      const size_t&     num_blocks,
@@ -100,6 +78,79 @@ namespace neuroh5
     }
 
   
+    /// Bins of a partial partition, for Karmarkar-Karp merging: the
+    /// load of each bin and the (rank, local bin) pairs it contains.
+    struct partial_bin_t
+    {
+      double load;
+      vector< pair<int, size_t> > members;
+    };
+
+    static bool partial_bin_less (const partial_bin_t& a, const partial_bin_t& b)
+    {
+      return a.load < b.load;
+    }
+
+    /// Merges the partial partitions of all ranks by Karmarkar-Karp
+    /// differencing: the two partitions with the largest differences
+    /// between their heaviest and lightest bins are repeatedly combined
+    /// by joining the heaviest bins of one with the lightest bins of the
+    /// other. Returns the part of each local bin of each rank.
+    static void merge_partial_partitions
+    (
+     const size_t           size,
+     const size_t           Nparts,
+     const vector<double>&  bin_loads,
+     vector<uint32_t>&      bin_parts
+     )
+    {
+      typedef vector<partial_bin_t> partition_t;
+      vector<partition_t> partitions(size, partition_t(Nparts));
+      // queue of (difference, partition index), largest difference first
+      priority_queue< pair<double, size_t> > queue;
+      for (size_t r=0; r<size; r++)
+        {
+          partition_t& partition = partitions[r];
+          for (size_t b=0; b<Nparts; b++)
+            {
+              partition[b].load = bin_loads[r*Nparts+b];
+              partition[b].members.push_back(make_pair(r, b));
+            }
+          sort(partition.begin(), partition.end(), partial_bin_less);
+          queue.push(make_pair(partition.back().load - partition.front().load, r));
+        }
+
+      while (queue.size() > 1)
+        {
+          const size_t i = queue.top().second; queue.pop();
+          const size_t j = queue.top().second; queue.pop();
+          partition_t& a = partitions[i];
+          partition_t& b = partitions[j];
+          // both partitions are sorted by increasing load
+          for (size_t k=0; k<Nparts; k++)
+            {
+              partial_bin_t& x = a[k];
+              partial_bin_t& y = b[Nparts-1-k];
+              x.load += y.load;
+              x.members.insert(x.members.end(), y.members.begin(), y.members.end());
+            }
+          partition_t().swap(b);
+          sort(a.begin(), a.end(), partial_bin_less);
+          queue.push(make_pair(a.back().load - a.front().load, i));
+        }
+
+      bin_parts.assign(size*Nparts, 0);
+      const partition_t& result = partitions[queue.top().second];
+      for (size_t p=0; p<Nparts; p++)
+        {
+          for (const auto& member : result[p].members)
+            {
+              bin_parts[member.first*Nparts + member.second] = p;
+            }
+        }
+    }
+
+
     /*****************************************************************************
      * Main balancing routine
      *****************************************************************************/
@@ -109,146 +160,246 @@ namespace neuroh5
      MPI_Comm comm,
      const std::string& input_file_name,
      const std::vector< std::pair<std::string, std::string> > prj_names,
-     const size_t io_size,
      const size_t Nparts,
+     NODE_IDX_T &node_start,
      std::vector<NODE_IDX_T> &parts,
-     std::vector<double> &part_weights
+     std::vector<double> &part_weights,
+     std::vector<size_t> &part_sizes
      )
     {
       int status=0;
-    
+
       int rank, size;
       throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
       throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+      throw_assert(Nparts > 0, "balance_graph_indegree: number of partitions must be positive");
 
-    
       // Read population info to determine total_num_nodes
-      size_t local_num_nodes, total_num_nodes, local_num_edges, total_num_edges;
-
-      vector <string> edge_attr_name_spaces;
+      size_t total_num_nodes;
+      pop_label_map_t pop_labels;
       pop_range_map_t pop_ranges;
+      throw_assert_nomsg(cell::read_population_labels(comm, input_file_name, pop_labels) >= 0);
       throw_assert_nomsg(cell::read_population_ranges(comm, input_file_name, pop_ranges, total_num_nodes) >= 0);
+      map<string, NODE_IDX_T> pop_starts;
+      for (const auto& label : pop_labels)
+        {
+          pop_starts[label.second] = pop_ranges[label.first].start;
+        }
+
+      // Each rank owns a contiguous range of nodes
+      vector<size_t> node_counts;
+      compute_part_nums(total_num_nodes, size, node_counts);
+      vector<size_t> node_dist(size+1, 0);
+      for (size_t r=0; r<(size_t)size; r++)
+        {
+          node_dist[r+1] = node_dist[r] + node_counts[r];
+        }
+      node_start = node_dist[rank];
+      const size_t num_local_nodes = node_counts[rank];
 
-      // A vector that maps nodes to compute ranks
-      node_rank_map_t node_rank_map;
-      compute_node_rank_map(size, total_num_nodes, node_rank_map);
-    
-      // read the edges
-      vector < edge_map_t > prj_vector;
-      vector < map <string, vector <vector<string> > > > edge_attr_name_vector;
-      scatter_read_graph (comm,
-                          EdgeMapDst,
-                          input_file_name,
-                          io_size,
-                          edge_attr_name_spaces,
-                          prj_names,
-                          node_rank_map,
-                          prj_vector,
-                          edge_attr_name_vector,
-                          local_num_nodes,
-                          total_num_nodes,
-                          local_num_edges,
-                          total_num_edges);
-      
-      vector < std::map<NODE_IDX_T, size_t> > vertex_indegree_maps;
-      vertex_degree (prj_vector, false, vertex_indegree_maps);
-
-      std::vector<double> vertex_norm_indegrees(total_num_nodes, 0.0);
-
-      for (const map< NODE_IDX_T, size_t >& vertex_indegree_map : vertex_indegree_maps)
-        {
-          uint64_t sum_indegree=0, nz_indegree=0;
-          
-          for (auto it = vertex_indegree_map.begin(); it != vertex_indegree_map.end(); it++)
+      // Normalized in-degree of each node, summed over the projections.
+      // The in-degrees are obtained from the destination pointers of
+      // the blocks read by each rank and sent to the owners of the nodes.
+      vector< vector<NODE_IDX_T> > rank_nodes(size);
+      vector< vector<double> > rank_weights(size);
+      for (const auto& prj : prj_names)
+        {
+          const string& src_pop_name = prj.first;
+          const string& dst_pop_name = prj.second;
+          auto start_it = pop_starts.find(dst_pop_name);
+          throw_assert(start_it != pop_starts.end(),
+                       "balance_graph_indegree: population " << dst_pop_name << " not found");
+          const NODE_IDX_T dst_start = start_it->second;
+
+          DST_BLK_PTR_T block_base;
+          DST_PTR_T edge_base;
+          vector<DST_BLK_PTR_T> dst_blk_ptr;
+          vector<NODE_IDX_T> dst_idx;
+          vector<DST_PTR_T> dst_ptr;
+          throw_assert(hdf5::read_projection_node_datasets(comm, input_file_name, src_pop_name, dst_pop_name,
+                                                           block_base, edge_base,
+                                                           dst_blk_ptr, dst_idx, dst_ptr) >= 0,
+                       "balance_graph_indegree: error in read_projection_node_datasets");
+
+          vector<NODE_IDX_T> nodes;
+          vector<DST_PTR_T> degrees;
+          uint64_t sum_indegree=0;
+          if (dst_blk_ptr.size() > 0)
             {
-              size_t degree = it->second;
-              sum_indegree = sum_indegree + degree;
-              if (degree > 0) nz_indegree++;
+              const size_t dst_ptr_size = dst_ptr.size();
+              for (size_t b = 0; b < dst_blk_ptr.size()-1; ++b)
+                {
+                  const size_t low_dst_ptr = dst_blk_ptr[b], high_dst_ptr = dst_blk_ptr[b+1];
+                  const NODE_IDX_T dst_base = dst_idx[b];
+                  for (size_t i = low_dst_ptr, ii = 0; i < high_dst_ptr; ++i, ++ii)
+                    {
+                      if (i < dst_ptr_size-1)
+                        {
+                          const DST_PTR_T degree = dst_ptr[i+1] - dst_ptr[i];
+                          if (degree > 0)
+                            {
+                              nodes.push_back(dst_base + ii + dst_start);
+                              degrees.push_back(degree);
+                              sum_indegree += degree;
+                            }
+                        }
+                    }
+                }
             }
-          for (auto it = vertex_indegree_map.begin(); it != vertex_indegree_map.end(); it++)
+          throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, &sum_indegree, 1, MPI_UINT64_T, MPI_SUM,
+                                           comm) == MPI_SUCCESS);
+          for (size_t i=0; i<nodes.size(); i++)
             {
-              double norm_indegree = (double)it->second / (double)sum_indegree;
-              vertex_norm_indegrees[it->first] += norm_indegree;
+              const size_t owner = upper_bound(node_dist.begin(), node_dist.end(), (size_t)nodes[i]) -
+                node_dist.begin() - 1;
+              throw_assert(owner < (size_t)size,
+                           "balance_graph_indegree: node " << nodes[i] << " is out of range");
+              rank_nodes[owner].push_back(nodes[i]);
+              rank_weights[owner].push_back((double)degrees[i] / (double)sum_indegree);
             }
-          
         }
 
+      vector<int> sendcounts(size, 0), sdispls(size, 0), recvcounts(size, 0), rdispls(size, 0);
+      vector<NODE_IDX_T> node_sendbuf, node_recvbuf;
+      vector<double> weight_sendbuf, weight_recvbuf;
+      for (size_t r=0; r<(size_t)size; r++)
+        {
+          sdispls[r] = node_sendbuf.size();
+          node_sendbuf.insert(node_sendbuf.end(), rank_nodes[r].begin(), rank_nodes[r].end());
+          weight_sendbuf.insert(weight_sendbuf.end(), rank_weights[r].begin(), rank_weights[r].end());
+          sendcounts[r] = node_sendbuf.size() - sdispls[r];
+        }
+      rank_nodes.clear();
+      rank_weights.clear();
+      throw_assert_nomsg(mpi::alltoallv_vector<NODE_IDX_T>(comm, MPI_NODE_IDX_T, sendcounts, sdispls, node_sendbuf,
+                                                           recvcounts, rdispls, node_recvbuf) >= 0);
+      throw_assert_nomsg(mpi::alltoallv_vector<double>(comm, MPI_DOUBLE, sendcounts, sdispls, weight_sendbuf,
+                                                       recvcounts, rdispls, weight_recvbuf) >= 0);
 
-      vector<NODE_IDX_T> node_idx_vector(total_num_nodes, 0);
-      for (NODE_IDX_T i=0; i<total_num_nodes; i++)
+      vector<double> weights(num_local_nodes, 0.0);
+      for (size_t i=0; i<node_recvbuf.size(); i++)
         {
-          node_idx_vector[i] = i;
+          weights[node_recvbuf[i] - node_start] += weight_recvbuf[i];
         }
+      node_recvbuf.clear();
+      weight_recvbuf.clear();
 
-      // Sort node indices according to in-degree
-      std::sort(node_idx_vector.begin(), node_idx_vector.end(),
-                    [&] (NODE_IDX_T const& a, NODE_IDX_T const& b)
-                    {
-                  return vertex_norm_indegrees[a] > vertex_norm_indegrees[b];
-                });
-      part_weights.resize(Nparts);
-      std::vector< size_t > part_nums;
-      compute_part_nums(total_num_nodes,Nparts,part_nums);
-      std::map<NODE_IDX_T, size_t> parts_map;
-      NODE_IDX_T vidx=0;
-      for (size_t p=0; p<Nparts; p++)
+      // Longest processing time first: each rank assigns its nodes in
+      // order of decreasing weight to the lightest of Nparts local bins
+      vector<NODE_IDX_T> order;
+      for (size_t i=0; i<num_local_nodes; i++)
         {
-          double part_norm_indegree=0.0;
-          while (vidx < total_num_nodes)
+          if (weights[i] > 0.0)
             {
-              NODE_IDX_T n = node_idx_vector[vidx];
-              if (vertex_norm_indegrees[n] > 0)
-                {
-                  parts_map.insert(make_pair(n, p));
-                  part_norm_indegree = part_norm_indegree + vertex_norm_indegrees[n];
-                  part_nums[p]--;
-                }
-              vidx++;
+              order.push_back(i);
             }
-          part_weights[p] = part_norm_indegree;
         }
+      sort(order.begin(), order.end(),
+           [&weights] (const NODE_IDX_T a, const NODE_IDX_T b)
+           {
+             return (weights[a] > weights[b]) || ((weights[a] == weights[b]) && (a < b));
+           });
 
+      vector<double> bin_loads(Nparts, 0.0);
+      vector<uint32_t> local_bins(num_local_nodes, 0);
+      {
+        priority_queue< pair<double, size_t>, vector< pair<double, size_t> >,
+                        greater< pair<double, size_t> > > lightest;
+        for (size_t b=0; b<Nparts; b++)
+          {
+            lightest.push(make_pair(0.0, b));
+          }
+        for (const NODE_IDX_T i : order)
+          {
+            pair<double, size_t> bin = lightest.top(); lightest.pop();
+            local_bins[i] = bin.second;
+            bin.first += weights[i];
+            bin_loads[bin.second] = bin.first;
+            lightest.push(bin);
+          }
+      }
 
-      vector<size_t> part_idx_vector;
-      part_idx_vector.resize(Nparts);
-      for (size_t i=0; i<Nparts; i++)
+      // The partial partitions of all ranks are merged on rank 0, which
+      // returns the part of each local bin
+      vector<double> all_bin_loads;
+      vector<uint32_t> all_bin_parts;
+      if (rank == 0)
         {
-          part_idx_vector[i] = i;
+          all_bin_loads.resize(size*Nparts);
         }
-      // Sort partition indices according to number of nodes assigned to them
-      std::sort(part_idx_vector.begin(), part_idx_vector.end(),
-                [&] (size_t const& a, size_t const& b)
-                {
-                  return part_nums[a] < part_nums[b];
-                });
-      
-      vidx=0;
-      while (vidx < total_num_nodes)
+      throw_assert_nomsg(MPI_Gather(&bin_loads[0], Nparts, MPI_DOUBLE,
+                                    rank == 0 ? &all_bin_loads[0] : NULL, Nparts, MPI_DOUBLE,
+                                    0, comm) == MPI_SUCCESS);
+      if (rank == 0)
         {
-          for (size_t pidx=0; pidx<Nparts; pidx++)
+          merge_partial_partitions(size, Nparts, all_bin_loads, all_bin_parts);
+        }
+      vector<uint32_t> bin_parts(Nparts);
+      throw_assert_nomsg(MPI_Scatter(rank == 0 ? &all_bin_parts[0] : NULL, Nparts, MPI_UINT32_T,
+                                     &bin_parts[0], Nparts, MPI_UINT32_T,
+                                     0, comm) == MPI_SUCCESS);
+
+      parts.assign(num_local_nodes, 0);
+      part_weights.assign(Nparts, 0.0);
+      part_sizes.assign(Nparts, 0);
+      for (const NODE_IDX_T i : order)
+        {
+          const uint32_t p = bin_parts[local_bins[i]];
+          parts[i] = p;
+          part_weights[p] += weights[i];
+          part_sizes[p]++;
+        }
+      throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, &part_sizes[0], Nparts, MPI_SIZE_T, MPI_SUM,
+                                       comm) == MPI_SUCCESS);
+
+      // Nodes without incoming edges fill the parts up to equal sizes,
+      // in contiguous ranges
+      size_t num_unweighted = num_local_nodes - order.size(), unweighted_start = 0, total_unweighted = 0;
+      throw_assert_nomsg(MPI_Exscan(&num_unweighted, &unweighted_start, 1, MPI_SIZE_T, MPI_SUM,
+                                    comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Allreduce(&num_unweighted, &total_unweighted, 1, MPI_SIZE_T, MPI_SUM,
+                                       comm) == MPI_SUCCESS);
+      if (rank == 0)
+        {
+          unweighted_start = 0;
+        }
+      vector<double> capacity_end(Nparts, 0.0);
+      double total_capacity = 0.0;
+      for (size_t p=0; p<Nparts; p++)
+        {
+          total_capacity += max(0.0, (double)total_num_nodes / Nparts - part_sizes[p]);
+          capacity_end[p] = total_capacity;
+        }
+      vector<size_t> unweighted_sizes(Nparts, 0);
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          if (weights[i] == 0.0)
             {
-              size_t p = part_idx_vector[pidx];
-              if (part_nums[p] > 0)
+              const double pos = (unweighted_start + 0.5) / total_unweighted;
+              size_t p = Nparts * pos;
+              if (total_capacity > 0.0)
                 {
-                  NODE_IDX_T n = node_idx_vector[vidx];
-                  if (parts_map.find(n) == parts_map.end())
-                    {
-                      parts_map.insert(make_pair(n, p));
-                      part_nums[p]--;
-                    }
-                  vidx++;
+                  p = upper_bound(capacity_end.begin(), capacity_end.end(),
+                                  pos * total_capacity) - capacity_end.begin();
                 }
+              p = min(Nparts-1, p);
+              parts[i] = p;
+              unweighted_sizes[p]++;
+              unweighted_start++;
             }
         }
-      
-      parts.resize(total_num_nodes);
-      for (NODE_IDX_T n=0; n<total_num_nodes; n++)
+
+      throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, &unweighted_sizes[0], Nparts, MPI_SIZE_T, MPI_SUM,
+                                       comm) == MPI_SUCCESS);
+      for (size_t p=0; p<Nparts; p++)
         {
-          parts[n] = parts_map[n];
+          part_sizes[p] += unweighted_sizes[p];
         }
-      
+      throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, &part_weights[0], Nparts, MPI_DOUBLE, MPI_SUM,
+                                       comm) == MPI_SUCCESS);
+
       return status;
     }
-  
+
   }
 }
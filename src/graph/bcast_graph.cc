@@ -12,11 +12,13 @@
 #include "neuroh5_types.hh"
 #include "read_projection_datasets.hh"
 #include "edge_attributes.hh"
+#include "edge_attr_filter.hh"
 #include "cell_populations.hh"
 #include "validate_edge_list.hh"
 #include "append_edge_map.hh"
 #include "serialize_edge.hh"
 #include "serialize_data.hh"
+#include "mpi_trace.hh"
 #include "throw_assert.hh"
 #include "debug.hh"
 
@@ -52,9 +54,11 @@ namespace neuroh5
                           const pop_search_range_map_t& pop_search_ranges,
                           const set< pair<pop_t, pop_t> >& pop_pairs,
                           vector < edge_map_t >& prj_vector,
-                          vector < map <string, vector < vector<string> > > > & edge_attr_names_vector)
+                          vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
+                          const EdgeAttrFilter& edge_filter)
                           
     {
+      mpi::trace_scope trace_total("bcast_projection");
 
       int rank, size;
       throw_assert_nomsg(MPI_Comm_size(all_comm, &size) == MPI_SUCCESS);
@@ -80,41 +84,60 @@ namespace neuroh5
           map <string, data::NamedAttrVal> edge_attr_map;
           
 
-          throw_assert_nomsg(hdf5::read_projection_datasets(io_comm, file_name, src_pop_name, dst_pop_name,
-                                                            block_base, edge_base,
-                                                            dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                            total_prj_num_edges,
-                                                            total_read_blocks, local_read_blocks) >= 0);
+          {
+            mpi::trace_scope trace("bcast_projection.read");
+            throw_assert_nomsg(hdf5::read_projection_datasets(io_comm, file_name, src_pop_name, dst_pop_name,
+                                                              block_base, edge_base,
+                                                              dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                              total_prj_num_edges,
+                                                              total_read_blocks, local_read_blocks) >= 0);
+            trace.add_items(src_idx.size());
+            trace.add_bytes(src_idx.size() * sizeof(NODE_IDX_T) + dst_ptr.size() * sizeof(DST_PTR_T));
+          }
           
           // validate the edges
-          throw_assert_nomsg(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                pop_search_ranges, pop_pairs) == true);
+          {
+            mpi::trace_scope trace("bcast_projection.validate");
+            throw_assert_nomsg(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                  pop_search_ranges, pop_pairs) == true);
+            trace.add_items(src_idx.size());
+          }
           
           
           edge_count = src_idx.size();
 
+          {
+            mpi::trace_scope trace("bcast_projection.attributes");
+            throw_assert_nomsg(graph::read_filtered_edge_attributes(io_comm, file_name, src_pop_name, dst_pop_name,
+                                                                    attr_namespaces, edge_filter,
+                                                                    edge_base, edge_count,
+                                                                    dst_ptr, src_idx, edge_attr_map) >= 0);
+            trace.add_items(edge_count);
+          }
           for (string attr_namespace : attr_namespaces) 
             {
-              vector< pair<string,AttrKind> > edge_attr_info;
-              throw_assert_nomsg(graph::get_edge_attributes(io_comm, file_name, src_pop_name, dst_pop_name,
-                                                attr_namespace, edge_attr_info) >= 0);
-              throw_assert_nomsg(graph::read_all_edge_attributes(io_comm, file_name,
-                                                     src_pop_name, dst_pop_name, attr_namespace,
-                                                     edge_base, edge_count, edge_attr_info,
-                                                     edge_attr_map[attr_namespace]) >= 0);
               edge_attr_map[attr_namespace].attr_names(edge_attr_names[attr_namespace]);
             }
 
           // append to the edge map
           
-          throw_assert_nomsg(data::append_edge_map(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                       attr_namespaces, edge_attr_map, num_edges, prj_edge_map, edge_map_type) >= 0);
+          {
+            mpi::trace_scope trace("bcast_projection.append_edge_map");
+            throw_assert_nomsg(data::append_edge_map(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                         attr_namespaces, edge_attr_map, num_edges, prj_edge_map, edge_map_type) >= 0);
+            trace.add_items(num_edges);
+          }
           
           // ensure that all edges in the projection have been read and appended to edge_list
           throw_assert_nomsg(num_edges == src_idx.size());
           
           size_t num_packed_edges = 0; 
-          data::serialize_edge_map (prj_edge_map, num_packed_edges, sendbuf);
+          {
+            mpi::trace_scope trace("bcast_projection.serialize");
+            data::serialize_edge_map (prj_edge_map, num_packed_edges, sendbuf);
+            trace.add_items(num_packed_edges);
+            trace.add_bytes(sendbuf.size());
+          }
 
           // ensure the correct number of edges is being packed
           throw_assert_nomsg(num_packed_edges == num_edges);
@@ -140,16 +163,25 @@ namespace neuroh5
           }
       }
       
-      uint32_t sendbuf_size = sendbuf.size();
-      throw_assert_nomsg(MPI_Bcast(&sendbuf_size, 1, MPI_UINT32_T, 0, all_comm) == MPI_SUCCESS);
-      sendbuf.resize(sendbuf_size);
-      throw_assert_nomsg(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, all_comm) == MPI_SUCCESS);
+      {
+        mpi::trace_scope trace("bcast_projection.bcast");
+        uint32_t sendbuf_size = sendbuf.size();
+        throw_assert_nomsg(MPI_Bcast(&sendbuf_size, 1, MPI_UINT32_T, 0, all_comm) == MPI_SUCCESS);
+        sendbuf.resize(sendbuf_size);
+        throw_assert_nomsg(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, all_comm) == MPI_SUCCESS);
+        trace.add_bytes(sendbuf_size);
+      }
           
       size_t num_unpacked_edges = 0, num_unpacked_nodes = 0; 
       if (rank > 0)
         {
-          data::deserialize_edge_map (sendbuf, prj_edge_map,
-                                      num_unpacked_nodes, num_unpacked_edges);
+          {
+            mpi::trace_scope trace("bcast_projection.deserialize");
+            data::deserialize_edge_map (sendbuf, prj_edge_map,
+                                        num_unpacked_nodes, num_unpacked_edges);
+            trace.add_items(num_unpacked_edges);
+            trace.add_bytes(sendbuf.size());
+          }
       
         }
       
@@ -174,7 +206,8 @@ namespace neuroh5
      vector < map <string, vector < vector <string> > > >& edge_attr_names_vector,
      size_t                       &total_num_nodes,
      size_t                       &local_num_edges,
-     size_t                       &total_num_edges
+     size_t                       &total_num_edges,
+     const EdgeAttrFilter&         edge_filter
      )
     {
       int ierr = 0;
@@ -264,7 +297,7 @@ namespace neuroh5
                            src_pop_name, dst_pop_name,
                            src_start, dst_start,
                            attr_namespaces, pop_search_ranges, pop_pairs, 
-                           prj_vector, edge_attr_names_vector);
+                           prj_vector, edge_attr_names_vector, edge_filter);
                              
         }
       throw_assert_nomsg(MPI_Barrier(io_comm) == MPI_SUCCESS);
@@ -15,6 +15,9 @@
 #include "cell_populations.hh"
 #include "scatter_read_graph.hh"
 #include "vertex_degree.hh"
+#include "for_each_edge_block.hh"
+#include "range_sample.hh"
+#include "sample_sort.hh"
 #include "validate_edge_list.hh"
 #include "node_attributes.hh"
 #include "throw_assert.hh"
@@ -40,6 +43,9 @@ namespace neuroh5
 {
   namespace graph
   {
+    // Number of DBS blocks read per rank at a time when streaming edges
+    static const size_t indegree_block_window = 1024;
+
     // Assign each node to a rank 
     static void compute_node_rank_map
     (
@@ -146,52 +152,106 @@ namespace neuroh5
       size = (size_t)ssize;
     
       // Read population info to determine total_num_nodes
-      size_t local_num_nodes, total_num_nodes, local_num_edges, total_num_edges;
+      size_t total_num_nodes;
 
-      vector<string> edge_attr_name_spaces;
       pop_range_map_t pop_ranges;
       throw_assert_nomsg(cell::read_population_ranges(comm, file_name, pop_ranges, total_num_nodes) >= 0);
 
-      // A vector that maps nodes to compute ranks
+      // I/O ranks stream the edges of each projection and count the
+      // in-degree and the sources of the destinations in the blocks
+      // they read; a destination may occur in several blocks read by
+      // different ranks (e.g. after appends), so the counts and sources
+      // are then combined and written on rank dst % size
+      set<size_t> io_rank_set;
+      data::range_sample(size, io_size, io_rank_set);
+      const bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
+      MPI_Comm io_comm;
+      throw_assert_nomsg(MPI_Comm_split(comm, is_io_rank ? 1 : 0, rank, &io_comm) == MPI_SUCCESS);
+
       node_rank_map_t node_rank_map;
-      compute_node_rank_map(size, total_num_nodes, node_rank_map);
-    
-      // read the edges
-      vector < map <string, vector <vector<string> > > > edge_attr_name_vector;
-      vector < edge_map_t > prj_vector;
-      scatter_read_graph (comm,
-                          EdgeMapDst,
-                          file_name,
-                          io_size,
-                          edge_attr_name_spaces,
-                          prj_names,
-                          node_rank_map,
-                          prj_vector,
-                          edge_attr_name_vector,
-                          local_num_nodes,
-                          total_num_nodes,
-                          local_num_edges,
-                          total_num_edges);
+      vector < std::map< NODE_IDX_T, size_t> > vertex_indegree_maps, vertex_unique_indegree_maps;
+      for (const pair<string, string>& prj : prj_names)
+        {
+          map< NODE_IDX_T, size_t> indegree_map, unique_indegree_map;
+          map< NODE_IDX_T, set<NODE_IDX_T> > src_map;
+          if (is_io_rank)
+            {
+              for_each_edge_block
+                (io_comm, file_name, prj.first, prj.second, vector<string>(), indegree_block_window,
+                 [&] (const edge_block_t& block)
+                 {
+                   block.for_each_dst([&] (const NODE_IDX_T dst, const size_t low, const size_t high)
+                                      {
+                                        if (high > low)
+                                          {
+                                            indegree_map[dst] += high - low;
+                                            src_map[dst].insert(block.src_idx.begin()+low,
+                                                                block.src_idx.begin()+high);
+                                          }
+                                      });
+                 });
+            }
 
-      {
-        vector < std::map< NODE_IDX_T, size_t> > vertex_indegree_maps; 
-        vertex_degree (prj_vector, false, vertex_indegree_maps);
-        append_vertex_degree_map (comm, node_rank_map, prj_names,
-                                  total_num_nodes, vertex_indegree_maps,
-                                  "Indegree", "Norm indegree",
-                                  file_name);
-      }
+          vector<NODE_IDX_T> degree_dsts;
+          vector<uint64_t> degree_counts;
+          vector<rank_t> degree_ranks;
+          for (auto const& it : indegree_map)
+            {
+              degree_dsts.push_back(it.first);
+              degree_counts.push_back(it.second);
+              degree_ranks.push_back(it.first % size);
+            }
+          mpi::bucket_plan_t degree_plan;
+          mpi::bucket_plan(comm, degree_ranks, degree_plan);
+          mpi::bucket_exchange(comm, degree_plan, degree_dsts);
+          mpi::bucket_exchange(comm, degree_plan, degree_counts);
 
-      {
-        vector < std::map< NODE_IDX_T, size_t> > vertex_unique_indegree_maps;
-        vertex_degree (prj_vector, true, vertex_unique_indegree_maps);
-        append_vertex_degree_map (comm, node_rank_map, prj_names,
-                                  total_num_nodes, vertex_unique_indegree_maps,
-                                  "Unique indegree", "Norm unique indegree",
-                                  file_name);
-      }
+          vector<NODE_IDX_T> src_dsts, srcs;
+          vector<rank_t> src_ranks;
+          for (auto const& it : src_map)
+            {
+              for (const NODE_IDX_T src : it.second)
+                {
+                  src_dsts.push_back(it.first);
+                  srcs.push_back(src);
+                  src_ranks.push_back(it.first % size);
+                }
+            }
+          src_map.clear();
+          mpi::bucket_plan_t src_plan;
+          mpi::bucket_plan(comm, src_ranks, src_plan);
+          mpi::bucket_exchange(comm, src_plan, src_dsts);
+          mpi::bucket_exchange(comm, src_plan, srcs);
+
+          indegree_map.clear();
+          for (size_t i = 0; i < degree_dsts.size(); i++)
+            {
+              indegree_map[degree_dsts[i]] += degree_counts[i];
+              node_rank_map[degree_dsts[i]].insert(rank);
+            }
+          for (size_t i = 0; i < src_dsts.size(); i++)
+            {
+              src_map[src_dsts[i]].insert(srcs[i]);
+            }
+          for (auto const& it : src_map)
+            {
+              unique_indegree_map[it.first] = it.second.size();
+            }
+
+          vertex_indegree_maps.push_back(indegree_map);
+          vertex_unique_indegree_maps.push_back(unique_indegree_map);
+        }
+      throw_assert_nomsg(MPI_Comm_free(&io_comm) == MPI_SUCCESS);
+
+      append_vertex_degree_map (comm, node_rank_map, prj_names,
+                                total_num_nodes, vertex_indegree_maps,
+                                "Indegree", "Norm indegree",
+                                file_name);
+      append_vertex_degree_map (comm, node_rank_map, prj_names,
+                                total_num_nodes, vertex_unique_indegree_maps,
+                                "Unique indegree", "Norm unique indegree",
+                                file_name);
 
-      
       return status;
     }
 
@@ -0,0 +1,215 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file edge_attr_filter.cc
+///
+///  Selection of edge attribute columns and filtering of edges by
+///  attribute values on the I/O ranks, before edges are distributed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "debug.hh"
+
+#include "edge_attr_filter.hh"
+#include "edge_attributes.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Narrows the edge mask by a condition on a column of type T.
+    /// Returns false if the column is not of type T.
+    template<class T>
+    static bool apply_edge_condition (const map<string, size_t>& attr_names,
+                                      const vector< vector<T> >& attr_values,
+                                      const data::attr_condition_t& condition,
+                                      vector<bool>& mask)
+    {
+      auto it = attr_names.find(condition.attr_name);
+      if (it == attr_names.end())
+        {
+          return false;
+        }
+      const vector<T>& values = attr_values[it->second];
+      throw_assert(values.size() == mask.size(),
+                   "read_filtered_edge_attributes: attribute " << condition.attr_name <<
+                   " has " << values.size() << " values for " << mask.size() << " edges");
+      for (size_t i=0; i<values.size(); i++)
+        {
+          mask[i] = mask[i] && data::compare_attr_value(condition.comparison, (double)values[i], condition.value);
+        }
+      return true;
+    }
+
+    static bool apply_edge_condition (const data::NamedAttrVal& attr_values,
+                                      const data::attr_condition_t& condition,
+                                      vector<bool>& mask)
+    {
+      return
+        apply_edge_condition(attr_values.float_names, attr_values.float_values, condition, mask) ||
+        apply_edge_condition(attr_values.uint8_names, attr_values.uint8_values, condition, mask) ||
+        apply_edge_condition(attr_values.int8_names, attr_values.int8_values, condition, mask) ||
+        apply_edge_condition(attr_values.uint16_names, attr_values.uint16_values, condition, mask) ||
+        apply_edge_condition(attr_values.int16_names, attr_values.int16_values, condition, mask) ||
+        apply_edge_condition(attr_values.uint32_names, attr_values.uint32_values, condition, mask) ||
+        apply_edge_condition(attr_values.int32_names, attr_values.int32_values, condition, mask);
+    }
+
+    template<class T>
+    static void select_edge_values (vector< vector<T> >& attr_values, const vector<bool>& mask)
+    {
+      for (vector<T>& values : attr_values)
+        {
+          size_t k = 0;
+          for (size_t i=0; i<values.size(); i++)
+            {
+              if (mask[i])
+                {
+                  values[k++] = values[i];
+                }
+            }
+          values.resize(k);
+        }
+    }
+
+    int read_filtered_edge_attributes
+    (
+     MPI_Comm                            comm,
+     const string&                       file_name,
+     const string&                       src_pop_name,
+     const string&                       dst_pop_name,
+     const vector<string>&               attr_namespaces,
+     const EdgeAttrFilter&               edge_filter,
+     const DST_PTR_T                     edge_base,
+     const DST_PTR_T                     edge_count,
+     vector<DST_PTR_T>&                  dst_ptr,
+     vector<NODE_IDX_T>&                 src_idx,
+     map<string, data::NamedAttrVal>&    edge_attr_map,
+     data::thread_pool*                  pool
+     )
+    {
+      // attributes that are only read to evaluate the predicates
+      map<string, data::NamedAttrVal> predicate_attr_map;
+
+      set<string> name_spaces(attr_namespaces.begin(), attr_namespaces.end());
+      for (auto const& it : edge_filter.predicates)
+        {
+          name_spaces.insert(it.first);
+        }
+
+      for (const string& attr_namespace : name_spaces)
+        {
+          const bool requested = find(attr_namespaces.begin(), attr_namespaces.end(), attr_namespace) !=
+            attr_namespaces.end();
+
+          vector< pair<string,AttrKind> > edge_attr_info;
+          throw_assert_nomsg(graph::get_edge_attributes(comm, file_name, src_pop_name, dst_pop_name,
+                                                        attr_namespace, edge_attr_info) >= 0);
+
+          set<string> predicate_attr_names;
+          auto predicate_it = edge_filter.predicates.find(attr_namespace);
+          if (predicate_it != edge_filter.predicates.end())
+            {
+              for (const data::attr_condition_t& condition : predicate_it->second.conditions)
+                {
+                  predicate_attr_names.insert(condition.attr_name);
+                }
+            }
+
+          auto mask_it = edge_filter.attr_masks.find(attr_namespace);
+          vector< pair<string,AttrKind> > read_attr_info, predicate_attr_info;
+          for (const pair<string,AttrKind>& attr_info : edge_attr_info)
+            {
+              const bool selected = requested &&
+                ((mask_it == edge_filter.attr_masks.end()) ||
+                 (mask_it->second.find(attr_info.first) != mask_it->second.end()));
+              if (selected)
+                {
+                  read_attr_info.push_back(attr_info);
+                }
+              else if (predicate_attr_names.find(attr_info.first) != predicate_attr_names.end())
+                {
+                  predicate_attr_info.push_back(attr_info);
+                }
+            }
+
+          if (requested)
+            {
+              throw_assert_nomsg(graph::read_all_edge_attributes(comm, file_name,
+                                                                 src_pop_name, dst_pop_name, attr_namespace,
+                                                                 edge_base, edge_count, read_attr_info,
+                                                                 edge_attr_map[attr_namespace], pool) >= 0);
+            }
+          if (!predicate_attr_names.empty())
+            {
+              throw_assert_nomsg(graph::read_all_edge_attributes(comm, file_name,
+                                                                 src_pop_name, dst_pop_name, attr_namespace,
+                                                                 edge_base, edge_count, predicate_attr_info,
+                                                                 predicate_attr_map[attr_namespace], pool) >= 0);
+            }
+        }
+
+      if (edge_filter.predicates.empty())
+        {
+          return 0;
+        }
+
+      vector<bool> mask(src_idx.size(), true);
+      for (auto const& it : edge_filter.predicates)
+        {
+          const string& attr_namespace = it.first;
+          for (const data::attr_condition_t& condition : it.second.conditions)
+            {
+              const bool found =
+                ((edge_attr_map.find(attr_namespace) != edge_attr_map.end()) &&
+                 apply_edge_condition(edge_attr_map[attr_namespace], condition, mask)) ||
+                apply_edge_condition(predicate_attr_map[attr_namespace], condition, mask);
+              throw_assert(found,
+                           "read_filtered_edge_attributes: predicate attribute " << condition.attr_name <<
+                           " not found in namespace " << attr_namespace);
+            }
+        }
+
+      // rebuild the destination pointer over the kept edges
+      size_t num_kept = 0, e = 0;
+      for (size_t i=0; i<dst_ptr.size(); i++)
+        {
+          const size_t ptr = min((size_t)dst_ptr[i], src_idx.size());
+          for (; e < ptr; e++)
+            {
+              if (mask[e])
+                {
+                  src_idx[num_kept++] = src_idx[e];
+                }
+            }
+          dst_ptr[i] = num_kept;
+        }
+      src_idx.resize(num_kept);
+
+      for (auto& it : edge_attr_map)
+        {
+          data::NamedAttrVal& attr_values = it.second;
+          select_edge_values(attr_values.float_values, mask);
+          select_edge_values(attr_values.uint8_values, mask);
+          select_edge_values(attr_values.int8_values, mask);
+          select_edge_values(attr_values.uint16_values, mask);
+          select_edge_values(attr_values.int16_values, mask);
+          select_edge_values(attr_values.uint32_values, mask);
+          select_edge_values(attr_values.int32_values, mask);
+        }
+
+      return 0;
+    }
+
+  }
+}
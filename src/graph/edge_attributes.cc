@@ -12,9 +12,12 @@
 #include "edge_attributes.hh"
 #include "exists_dataset.hh"
 #include "exists_group.hh"
+#include "file_access.hh"
 #include "path_names.hh"
 #include "serialize_data.hh"
+#include "read_chunks.hh"
 #include "read_template.hh"
+#include "thread_pool.hh"
 #include "throw_assert.hh"
 
 #include <iostream>
@@ -340,6 +343,29 @@ namespace neuroh5
       return ierr;
     }
 
+    // reads the values of an edge attribute, decompressing the chunks
+    // on the threads of pool if one is given and the dataset allows it
+    static herr_t read_edge_attribute_values
+    (
+     hid_t               dset,
+     hid_t               ntype,
+     hid_t               mspace,
+     hid_t               fspace,
+     hid_t               rapl,
+     const hsize_t       base,
+     const hsize_t       block,
+     void*               buf,
+     data::thread_pool*  pool
+     )
+    {
+      if ((pool != NULL) && hdf5::can_read_chunks(dset, ntype, *pool))
+        {
+          vector< pair<hsize_t,hsize_t> > ranges(1, make_pair(base, block));
+          return hdf5::read_chunks(dset, ntype, ranges, buf, *pool);
+        }
+      return H5Dread(dset, ntype, mspace, fspace, rapl, buf);
+    }
+
     /////////////////////////////////////////////////////////////////////////
     herr_t read_edge_attributes
     (
@@ -353,16 +379,15 @@ namespace neuroh5
      const DST_PTR_T       edge_count,
      const AttrKind        attr_kind,
      data::NamedAttrVal&   attr_values,
-     bool collective
+     bool collective,
+     data::thread_pool*    pool
      )
     {
       hid_t file;
       herr_t ierr = 0;
       hsize_t block = edge_count, base = edge_base;
 
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-      throw_assert_nomsg(fapl >= 0);
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
+      hid_t fapl = hdf5::read_access_plist(comm);
       
       throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
 
@@ -370,15 +395,7 @@ namespace neuroh5
       throw_assert_nomsg(file >= 0);
 
       /* Create property list for collective dataset operations. */
-      hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-#ifdef HDF5_IS_PARALLEL
-      if (collective)
-        {
-          ierr = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-          throw_assert(ierr >= 0,
-                       "read_edge_attributes: error in H5Pset_dxpl_mpio");
-        }
-#endif
+      hid_t rapl = collective ? hdf5::read_transfer_plist(comm) : H5Pcreate (H5P_DATASET_XFER);
       
       string dset_path = hdf5::edge_attribute_path(src_pop_name, dst_pop_name, name_space, attr_name);
       ierr = hdf5::exists_dataset (file, dset_path.c_str());
@@ -417,24 +434,24 @@ namespace neuroh5
                 {
                   vector <uint32_t> attr_values_uint32;
                   attr_values_uint32.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_uint32[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_uint32.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_uint32);
                 }
               else if (attr_size == 2)
                 {
                   vector <uint16_t>    attr_values_uint16;
                   attr_values_uint16.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_uint16[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_uint16.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_uint16);
                 }
               else if (attr_size == 1)
                 {
                   vector <uint8_t> attr_values_uint8;
                   attr_values_uint8.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_uint8[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_uint8.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_uint8);
                 }
               else
@@ -447,24 +464,24 @@ namespace neuroh5
                 {
                   vector <int32_t>  attr_values_int32;
                   attr_values_int32.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_int32[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_int32.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_int32);
                 }
               else if (attr_size == 2)
                 {
                   vector <int16_t>  attr_values_int16;
                   attr_values_int16.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_int16[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_int16.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_int16);
                 }
               else if (attr_size == 1)
                 {
                   vector <int8_t>  attr_values_int8;
                   attr_values_int8.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_int8[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_int8.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_int8);
                 }
               else
@@ -476,8 +493,8 @@ namespace neuroh5
               {
                 vector <float>  attr_values_float;
                 attr_values_float.resize(edge_count);
-                ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                               &attr_values_float[0]);
+                ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_float.data(), pool);
                 attr_values.insert(string(attr_name), attr_values_float);
               }
               break;
@@ -486,8 +503,8 @@ namespace neuroh5
                 {
                   vector <uint8_t>  attr_values_uint8;;
                   attr_values_uint8.resize(edge_count);
-                  ierr = H5Dread(dset, attr_h5type, mspace, fspace, rapl,
-                                 &attr_values_uint8[0]);
+                  ierr = read_edge_attribute_values(dset, attr_h5type, mspace, fspace, rapl,
+                                                    base, block, attr_values_uint8.data(), pool);
                   attr_values.insert(string(attr_name), attr_values_uint8);
                 }
               else
@@ -527,7 +544,8 @@ namespace neuroh5
      const DST_PTR_T                     edge_base,
      const DST_PTR_T                     edge_count,
      const vector< pair<string,AttrKind> >& edge_attr_info,
-     data::NamedAttrVal&                 edge_attr_values
+     data::NamedAttrVal&                 edge_attr_values,
+     data::thread_pool*                  pool
      )
     {
       int ierr = 0;
@@ -539,7 +557,7 @@ namespace neuroh5
           AttrKind attr_kind = edge_attr_info[j].second;
           throw_assert_nomsg ((ierr = read_edge_attributes(comm, file_name, src_pop_name, dst_pop_name,
                                                name_space, attr_name, edge_base, edge_count,
-                                               attr_kind, edge_attr_values))
+                                               attr_kind, edge_attr_values, true, pool))
                   >= 0);
         }
 
@@ -563,29 +581,20 @@ namespace neuroh5
      const vector< pair<hsize_t,hsize_t> >& ranges,
      const AttrKind        attr_kind,
      data::NamedAttrVal&   attr_values,
-     bool collective
+     bool collective,
+     data::thread_pool*    pool
      )
     {
       hid_t file;
       herr_t ierr = 0;
       hsize_t block = 0;
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-      throw_assert_nomsg(fapl >= 0);
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
+      hid_t fapl = hdf5::read_access_plist(comm);
 
       file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
       throw_assert_nomsg(file >= 0);
 
       /* Create property list for collective dataset operations. */
-      hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-#ifdef HDF5_IS_PARALLEL
-      if (collective)
-        {
-          ierr = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-          throw_assert(ierr >= 0,
-                       "read_edge_attribute_selection: error in H5Pset_dxpl_mpio");
-        }
-#endif
+      hid_t rapl = collective ? hdf5::read_transfer_plist(comm) : H5Pcreate (H5P_DATASET_XFER);
 
       for ( const std::pair<hsize_t,hsize_t> &range : ranges )
         {
@@ -608,21 +617,21 @@ namespace neuroh5
                 {
                   vector <uint32_t> attr_values_uint32;
                   ierr = hdf5::read_selection<uint32_t>(file, dset_path, attr_h5type, ranges,
-                                                        attr_values_uint32, rapl);
+                                                        attr_values_uint32, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_uint32);
                 }
               else if (attr_size == 2)
                 {
                   vector <uint16_t>    attr_values_uint16;
                   ierr = hdf5::read_selection<uint16_t>(file, dset_path, attr_h5type, ranges,
-                                                        attr_values_uint16, rapl);
+                                                        attr_values_uint16, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_uint16);
                 }
               else if (attr_size == 1)
                 {
                   vector <uint8_t> attr_values_uint8;
                   ierr = hdf5::read_selection<uint8_t>(file, dset_path, attr_h5type, ranges,
-                                                       attr_values_uint8, rapl);
+                                                       attr_values_uint8, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_uint8);
                 }
               else
@@ -635,21 +644,21 @@ namespace neuroh5
                 {
                   vector <int32_t>  attr_values_int32;
                   ierr = hdf5::read_selection<int32_t>(file, dset_path, attr_h5type, ranges,
-                                                       attr_values_int32, rapl);
+                                                       attr_values_int32, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_int32);
                 }
               else if (attr_size == 2)
                 {
                   vector <int16_t>  attr_values_int16;
                   ierr = hdf5::read_selection<int16_t>(file, dset_path, attr_h5type, ranges,
-                                                       attr_values_int16, rapl);
+                                                       attr_values_int16, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_int16);
                 }
               else if (attr_size == 1)
                 {
                   vector <int8_t>  attr_values_int8;
                   ierr = hdf5::read_selection<int8_t>(file, dset_path, attr_h5type, ranges,
-                                                      attr_values_int8, rapl);
+                                                      attr_values_int8, rapl, pool);
                   attr_values.insert(string(attr_name), attr_values_int8);
                 }
               else
@@ -661,7 +670,7 @@ namespace neuroh5
               {
                 vector <float>  attr_values_float;
                 ierr = hdf5::read_selection<float>(file, dset_path, attr_h5type, ranges,
-                                                   attr_values_float, rapl);
+                                                   attr_values_float, rapl, pool);
                 attr_values.insert(string(attr_name), attr_values_float);
               }
               break;
@@ -670,7 +679,7 @@ namespace neuroh5
                 {
                   vector <uint8_t>  attr_values_uint8;
                   ierr = hdf5::read_selection<uint8_t>(file, dset_path, attr_h5type, ranges,
-                                                       attr_values_uint8, rapl);
+                                                       attr_values_uint8, rapl, pool);
 
                   attr_values.insert(string(attr_name), attr_values_uint8);
                 }
@@ -710,7 +719,8 @@ namespace neuroh5
      const vector<DST_PTR_T>&    selection_dst_ptr,
      const vector< pair<hsize_t,hsize_t> >& src_idx_ranges,
      const vector< pair<string,AttrKind> >& edge_attr_info,
-     data::NamedAttrVal&                 edge_attr_values
+     data::NamedAttrVal&                 edge_attr_values,
+     data::thread_pool*                  pool
      )
     {
       herr_t ierr = 0;
@@ -723,7 +733,7 @@ namespace neuroh5
           ierr = read_edge_attribute_selection(comm, file_name, src_pop_name, dst_pop_name,
                                                name_space, attr_name, edge_base, edge_count,
                                                selection_dst_idx, selection_dst_ptr, src_idx_ranges,
-                                               attr_kind, edge_attr_values);
+                                               attr_kind, edge_attr_values, true, pool);
           throw_assert_nomsg (ierr >= 0);
         }
 
@@ -0,0 +1,187 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file for_each_edge_block.cc
+///
+///  Streaming traversal of the edges of a projection in windows of DBS
+///  (Destination Block Sparse) blocks, without building an edge map.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "debug.hh"
+
+#include "neuroh5_types.hh"
+#include "read_projection_datasets.hh"
+#include "cell_populations.hh"
+#include "for_each_edge_block.hh"
+#include "mpi_debug.hh"
+#include "throw_assert.hh"
+
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Runs the callback on a window, either directly or on a separate
+    /// thread, and waits for the previous window.
+    class edge_block_runner
+    {
+    public:
+      edge_block_runner (const edge_block_callback_t& callback, const bool overlap)
+        : callback(callback), overlap(overlap)
+      {}
+
+      ~edge_block_runner ()
+      {
+        if (worker.joinable())
+          {
+            worker.join();
+          }
+      }
+
+      void run (const edge_block_t& block)
+      {
+        wait();
+        if (overlap)
+          {
+            worker = std::thread(&edge_block_runner::run_block, this, std::cref(block));
+          }
+        else
+          {
+            callback(block);
+          }
+      }
+
+      /// Waits for the running callback and rethrows its exception, if any.
+      void wait ()
+      {
+        if (worker.joinable())
+          {
+            worker.join();
+          }
+        if (error)
+          {
+            std::exception_ptr e = error;
+            error = nullptr;
+            std::rethrow_exception(e);
+          }
+      }
+
+    private:
+      void run_block (const edge_block_t& block)
+      {
+        try
+          {
+            callback(block);
+          }
+        catch (...)
+          {
+            error = std::current_exception();
+          }
+      }
+
+      const edge_block_callback_t& callback;
+      const bool                   overlap;
+      std::thread                  worker;
+      std::exception_ptr           error;
+    };
+
+
+    size_t for_each_edge_block
+    (
+     MPI_Comm                         comm,
+     const string&                    file_name,
+     const string&                    src_pop_name,
+     const string&                    dst_pop_name,
+     const vector<string>&            attr_namespaces,
+     const size_t                     block_window,
+     const edge_block_callback_t&     callback,
+     const bool                       overlap,
+     const EdgeAttrFilter&            edge_filter
+     )
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert(block_window > 0,
+                   "for_each_edge_block: block window must be positive");
+
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      size_t total_num_nodes = 0;
+      throw_assert_nomsg(cell::read_population_labels(comm, file_name, pop_labels) >= 0);
+      throw_assert_nomsg(cell::read_population_ranges(comm, file_name, pop_ranges, total_num_nodes) >= 0);
+
+      NODE_IDX_T src_start = 0, dst_start = 0;
+      bool src_pop_set = false, dst_pop_set = false;
+      for (auto &x : pop_labels)
+        {
+          if (src_pop_name == get<1>(x))
+            {
+              src_start = pop_ranges[get<0>(x)].start;
+              src_pop_set = true;
+            }
+          if (dst_pop_name == get<1>(x))
+            {
+              dst_start = pop_ranges[get<0>(x)].start;
+              dst_pop_set = true;
+            }
+        }
+      throw_assert(src_pop_set && dst_pop_set,
+                   "for_each_edge_block: unknown population in projection " <<
+                   src_pop_name << " -> " << dst_pop_name);
+
+      // the callback may still be running on one window while the next
+      // one is read into the other buffer
+      edge_block_t blocks[2];
+      edge_block_runner runner(callback, overlap);
+
+      size_t num_edges = 0;
+      hsize_t offset = 0;
+      for (size_t w = 0; ; w++)
+        {
+          edge_block_t& block = blocks[w % 2];
+          block = edge_block_t();
+          block.src_start = src_start;
+          block.dst_start = dst_start;
+
+          size_t total_num_edges = 0;
+          hsize_t total_read_blocks = 0, local_read_blocks = 0;
+          throw_assert_nomsg(hdf5::read_projection_datasets(comm, file_name, src_pop_name, dst_pop_name,
+                                                            block.block_base, block.edge_base,
+                                                            block.dst_blk_ptr, block.dst_idx,
+                                                            block.dst_ptr, block.src_idx,
+                                                            total_num_edges, total_read_blocks,
+                                                            local_read_blocks,
+                                                            offset, block_window * size) >= 0);
+          if (total_read_blocks == 0)
+            {
+              break;
+            }
+
+          throw_assert_nomsg(read_filtered_edge_attributes(comm, file_name, src_pop_name, dst_pop_name,
+                                                           attr_namespaces, edge_filter,
+                                                           block.edge_base, block.src_idx.size(),
+                                                           block.dst_ptr, block.src_idx,
+                                                           block.edge_attr_map) >= 0);
+
+          mpi::MPI_DEBUG(comm, "for_each_edge_block: window ", w, " of projection ",
+                         src_pop_name, " -> ", dst_pop_name, " has ", block.src_idx.size(), " edges");
+
+          num_edges += block.src_idx.size();
+          runner.run(block);
+          offset += total_read_blocks;
+        }
+      runner.wait();
+
+      return num_edges;
+    }
+
+  }
+}
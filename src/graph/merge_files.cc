@@ -0,0 +1,179 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file merge_files.cc
+///
+///  Merges the projections and cell attribute namespaces of several
+///  NeuroH5 files into one file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "merge_files.hh"
+#include "cell_populations.hh"
+#include "cell_attributes.hh"
+#include "projection_names.hh"
+#include "create_population_h5types.hh"
+#include "stitch_cell_attributes.hh"
+#include "stitch_projection.hh"
+#include "path_names.hh"
+#include "mpi_debug.hh"
+#include "throw_assert.hh"
+
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    void merge_files
+    (
+     MPI_Comm                         comm,
+     const string&                    file_name,
+     const vector<string>&            input_file_names,
+     vector< pair<string,string> >&   prj_names,
+     vector< pair<string,string> >&   name_spaces,
+     const bool                       copy_parts
+     )
+    {
+      throw_assert(input_file_names.size() > 0,
+                   "merge_files: no input files");
+
+      int rank;
+      throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                   "merge_files: error in MPI_Comm_rank");
+
+      // the input files must define the same populations; the output
+      // file allows the projections of all input files
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      set< pair<pop_t, pop_t> > pop_pairs;
+      for (size_t i = 0; i < input_file_names.size(); i++)
+        {
+          const string& input_file_name = input_file_names[i];
+          pop_label_map_t input_pop_labels;
+          pop_range_map_t input_pop_ranges;
+          set< pair<pop_t, pop_t> > input_pop_pairs;
+          size_t n_nodes;
+          throw_assert(cell::read_population_labels(comm, input_file_name, input_pop_labels) >= 0,
+                       "merge_files: error in read_population_labels");
+          throw_assert(cell::read_population_ranges(comm, input_file_name,
+                                                    input_pop_ranges, n_nodes) >= 0,
+                       "merge_files: error in read_population_ranges");
+          throw_assert(cell::read_population_combos(comm, input_file_name, input_pop_pairs) >= 0,
+                       "merge_files: error in read_population_combos");
+          if (i == 0)
+            {
+              pop_labels = input_pop_labels;
+              pop_ranges = input_pop_ranges;
+            }
+          else
+            {
+              bool same_populations = (input_pop_labels == pop_labels) &&
+                (input_pop_ranges.size() == pop_ranges.size());
+              for (auto const& it : input_pop_ranges)
+                {
+                  auto range_it = pop_ranges.find(it.first);
+                  same_populations = same_populations && (range_it != pop_ranges.end()) &&
+                    (range_it->second.start == it.second.start) &&
+                    (range_it->second.count == it.second.count);
+                }
+              throw_assert(same_populations,
+                           "merge_files: populations of " << input_file_name <<
+                           " differ from those of " << input_file_names[0]);
+            }
+          pop_pairs.insert(input_pop_pairs.begin(), input_pop_pairs.end());
+        }
+
+      if (prj_names.empty() && name_spaces.empty())
+        {
+          set< pair<string,string> > prj_name_set, name_space_set;
+          for (const string& input_file_name : input_file_names)
+            {
+              vector< pair<string,string> > input_prj_names;
+              throw_assert(read_projection_names(comm, input_file_name, input_prj_names) >= 0,
+                           "merge_files: error in read_projection_names");
+              for (auto const& prj_name : input_prj_names)
+                {
+                  if (prj_name_set.insert(prj_name).second)
+                    {
+                      prj_names.push_back(prj_name);
+                    }
+                }
+              for (auto const& label : pop_labels)
+                {
+                  vector<string> input_name_spaces;
+                  throw_assert(cell::get_cell_attribute_name_spaces(input_file_name, label.second,
+                                                                    input_name_spaces) >= 0,
+                               "merge_files: error in get_cell_attribute_name_spaces");
+                  for (const string& name_space : input_name_spaces)
+                    {
+                      // morphologies are stored in a different layout
+                      if ((name_space == hdf5::TREES) || (name_space == hdf5::TREE_TEMPLATES) ||
+                          (name_space == hdf5::TREE_TEMPLATE_INDEX))
+                        {
+                          continue;
+                        }
+                      pair<string,string> pop_name_space = make_pair(label.second, name_space);
+                      if (name_space_set.insert(pop_name_space).second)
+                        {
+                          name_spaces.push_back(pop_name_space);
+                        }
+                    }
+                }
+            }
+        }
+
+      // the output file is created by rank 0 alone, so that the
+      // creation fails on all ranks if the file exists
+      int status = 0;
+      if (rank == 0)
+        {
+          hid_t file = H5Fcreate(file_name.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT);
+          if (file >= 0)
+            {
+              throw_assert(hdf5::create_population_h5types(file, pop_labels, pop_ranges, pop_pairs) >= 0,
+                           "merge_files: error in create_population_h5types");
+              throw_assert(H5Fclose(file) >= 0,
+                           "merge_files: unable to close file " << file_name);
+            }
+          else
+            {
+              status = -1;
+            }
+        }
+      throw_assert(MPI_Bcast(&status, 1, MPI_INT, 0, comm) == MPI_SUCCESS,
+                   "merge_files: error in MPI_Bcast");
+      throw_assert(status == 0,
+                   "merge_files: unable to create output file " << file_name);
+
+      for (auto const& prj_name : prj_names)
+        {
+          double start_time = MPI_Wtime();
+          stitch_projection(comm, file_name, input_file_names,
+                            prj_name.first, prj_name.second, copy_parts);
+          mpi::MPI_DEBUG(comm, "merge_files: merged projection ", prj_name.first, " -> ",
+                         prj_name.second, " in ", MPI_Wtime() - start_time, " s");
+        }
+
+      for (auto const& name_space : name_spaces)
+        {
+          double start_time = MPI_Wtime();
+          cell::stitch_cell_attributes(comm, file_name, input_file_names,
+                                       name_space.second, name_space.first, copy_parts);
+          mpi::MPI_DEBUG(comm, "merge_files: merged namespace ", name_space.second, " of ",
+                         name_space.first, " in ", MPI_Wtime() - start_time, " s");
+        }
+    }
+
+  }
+}
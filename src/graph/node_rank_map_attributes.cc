@@ -0,0 +1,128 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file node_rank_map_attributes.cc
+///
+///  Storage of node-to-rank assignments as cell attributes, so that the
+///  output of a partitioner can be reused across runs.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "node_rank_map_attributes.hh"
+#include "cell_attributes.hh"
+#include "throw_assert.hh"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+#include <mpi.h>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    void append_node_rank_map
+    (
+     MPI_Comm               comm,
+     const string&          file_name,
+     const string&          name_space,
+     const string&          pop_name,
+     const CELL_IDX_T&      pop_start,
+     const node_rank_map_t& node_rank_map,
+     const size_t           io_size,
+     const bool             distributed
+     )
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      // each rank writes its own cells, or an equal share of the cells
+      // of a replicated map
+      map<string, map<CELL_IDX_T, deque<uint32_t> > > attr_values_uint32;
+      map<CELL_IDX_T, deque<uint32_t> >& rank_values = attr_values_uint32[NODE_RANK];
+      size_t i = 0;
+      for (auto it = node_rank_map.begin(); it != node_rank_map.end(); ++it, ++i)
+        {
+          if (distributed || ((int)(i % size) == rank))
+            {
+              rank_values[it->first] = deque<uint32_t>(it->second.begin(), it->second.end());
+            }
+        }
+
+      const data::optional_hid dflt_data_type;
+      cell::append_cell_attribute_maps(comm, file_name, name_space, pop_name, pop_start,
+                                       attr_values_uint32,
+                                       map<string, map<CELL_IDX_T, deque<int32_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<float> > >(),
+                                       io_size, dflt_data_type);
+    }
+
+
+    void read_node_rank_map
+    (
+     MPI_Comm               comm,
+     const string&          file_name,
+     const string&          name_space,
+     const string&          pop_name,
+     const CELL_IDX_T&      pop_start,
+     node_rank_map_t&       node_rank_map
+     )
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+
+      data::NamedAttrMap attr_values;
+      set<string> attr_mask;
+      attr_mask.insert(NODE_RANK);
+      cell::read_cell_attributes(comm, file_name, name_space, attr_mask, pop_name, pop_start,
+                                 attr_values);
+
+      // gid and rank pairs of the cells read by this rank
+      vector<CELL_IDX_T> local_gids;
+      vector<uint32_t> local_ranks;
+      for (CELL_IDX_T gid : attr_values.index_set)
+        {
+          const deque<uint32_t> ranks = attr_values.find_name<uint32_t>(NODE_RANK, gid);
+          for (const uint32_t r : ranks)
+            {
+              local_gids.push_back(gid);
+              local_ranks.push_back(r);
+            }
+        }
+
+      int num_local = local_gids.size();
+      vector<int> counts(size, 0), displs(size+1, 0);
+      throw_assert_nomsg(MPI_Allgather(&num_local, 1, MPI_INT, &counts[0], 1, MPI_INT,
+                                       comm) == MPI_SUCCESS);
+      for (int p = 0; p < size; p++)
+        {
+          displs[p+1] = displs[p] + counts[p];
+        }
+      vector<CELL_IDX_T> all_gids(displs[size]);
+      vector<uint32_t> all_ranks(displs[size]);
+      throw_assert_nomsg(MPI_Allgatherv(local_gids.data(), num_local, MPI_CELL_IDX_T,
+                                        all_gids.data(), &counts[0], &displs[0], MPI_CELL_IDX_T,
+                                        comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Allgatherv(local_ranks.data(), num_local, MPI_UINT32_T,
+                                        all_ranks.data(), &counts[0], &displs[0], MPI_UINT32_T,
+                                        comm) == MPI_SUCCESS);
+
+      for (size_t i = 0; i < all_gids.size(); i++)
+        {
+          node_rank_map[all_gids[i]].insert(all_ranks[i]);
+        }
+    }
+
+  }
+}
@@ -0,0 +1,615 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file partition_graph_lp.cc
+///
+///  Distributed graph partitioning by size-constrained label propagation.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "partition_graph_lp.hh"
+#include "cell_populations.hh"
+#include "read_graph.hh"
+#include "alltoallv_template.hh"
+#include "range_sample.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <numeric>
+#include <set>
+#include <tuple>
+
+#include <mpi.h>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Contiguous ranges of the partitioned nodes, in increasing order;
+    /// the positions of the nodes number the nodes of all ranges
+    /// consecutively.
+    struct node_ranges_t
+    {
+      vector<NODE_IDX_T> start;
+      // position of the first node of each range, and the number of nodes
+      vector<size_t>     offset;
+    };
+
+    /// Position of the given node.
+    static size_t node_position (const node_ranges_t& ranges, const NODE_IDX_T node)
+    {
+      const size_t r = upper_bound(ranges.start.begin(), ranges.start.end(), node) - ranges.start.begin();
+      throw_assert((r > 0) && ((size_t)(node - ranges.start[r-1]) < ranges.offset[r] - ranges.offset[r-1]),
+                   "partition_graph_lp: node " << node << " is not in any of the partitioned populations");
+      return ranges.offset[r-1] + (node - ranges.start[r-1]);
+    }
+
+    /// Node at the given position.
+    static NODE_IDX_T position_node (const node_ranges_t& ranges, const size_t pos)
+    {
+      const size_t r = upper_bound(ranges.offset.begin(), ranges.offset.end(), pos) - ranges.offset.begin() - 1;
+      return ranges.start[r] + (pos - ranges.offset[r]);
+    }
+
+    /// Rank that owns the node at the given position.
+    static rank_t position_owner (const vector<size_t>& node_dist, const size_t pos)
+    {
+      return upper_bound(node_dist.begin(), node_dist.end(), pos) - node_dist.begin() - 1;
+    }
+
+    /// Exchange of the partitions of the ghost nodes of each rank, that
+    /// is, the neighbors of its nodes that are owned by other ranks.
+    struct ghost_exchange_t
+    {
+      vector<int>    sendcounts, sdispls, recvcounts, rdispls;
+      // local indices of the nodes whose partitions are sent
+      vector<size_t> send_nodes;
+    };
+
+    /// Receives the partitions of the ghost nodes, which follow the
+    /// local nodes in parts.
+    static void exchange_ghost_parts (MPI_Comm comm, const ghost_exchange_t& exchange,
+                                      const size_t num_local_nodes, vector<uint32_t>& parts)
+    {
+      vector<uint32_t> sendbuf(exchange.send_nodes.size());
+      for (size_t i=0; i<exchange.send_nodes.size(); i++)
+        {
+          sendbuf[i] = parts[exchange.send_nodes[i]];
+        }
+      throw_assert(MPI_Alltoallv(sendbuf.data(), &exchange.sendcounts[0], &exchange.sdispls[0], MPI_UINT32_T,
+                                 parts.data() + num_local_nodes, &exchange.recvcounts[0],
+                                 &exchange.rdispls[0], MPI_UINT32_T, comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Alltoallv");
+    }
+
+    /// Total node count (constraint 0) and in-degree (constraint 1) of
+    /// each partition.
+    static void compute_loads (MPI_Comm comm, const size_t nparts, const vector<uint32_t>& parts,
+                               const vector<size_t>& in_degree, vector<double>& loads)
+    {
+      loads.assign(2*nparts, 0.0);
+      for (size_t i=0; i<in_degree.size(); i++)
+        {
+          const uint32_t p = parts[i];
+          loads[2*p] += 1.0;
+          loads[2*p+1] += in_degree[i];
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, &loads[0], 2*nparts, MPI_DOUBLE, MPI_SUM,
+                                 comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+    }
+
+    int partition_graph_lp
+    (
+     MPI_Comm                                       comm,
+     const string&                                  file_name,
+     const vector< pair<string, string> >&          prj_names,
+     const size_t                                   io_size,
+     const size_t                                   nparts,
+     const size_t                                   num_iterations,
+     const double                                   imbalance,
+     node_rank_map_t&                               node_rank_map,
+     size_t&                                        edge_cut
+     )
+    {
+      int rank, size;
+      throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                   "partition_graph_lp: unable to obtain MPI communicator size");
+      throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                   "partition_graph_lp: unable to obtain MPI communicator rank");
+      throw_assert(nparts > 0, "partition_graph_lp: number of partitions must be positive");
+      throw_assert(imbalance >= 0.0, "partition_graph_lp: imbalance must be non-negative");
+
+      // the partitioned nodes are those of all source and destination
+      // populations of the given projections
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      size_t total_num_nodes = 0;
+      throw_assert_nomsg(cell::read_population_labels(comm, file_name, pop_labels) >= 0);
+      throw_assert_nomsg(cell::read_population_ranges(comm, file_name, pop_ranges, total_num_nodes) >= 0);
+
+      set<string> pop_names;
+      for (const auto& prj : prj_names)
+        {
+          pop_names.insert(prj.first);
+          pop_names.insert(prj.second);
+        }
+
+      node_ranges_t ranges;
+      vector< pair<NODE_IDX_T, size_t> > pop_node_ranges;
+      for (const auto& label : pop_labels)
+        {
+          if (pop_names.erase(label.second) > 0)
+            {
+              auto range_it = pop_ranges.find(label.first);
+              throw_assert(range_it != pop_ranges.end(),
+                           "partition_graph_lp: population " << label.second << " has no range");
+              pop_node_ranges.push_back(make_pair(range_it->second.start, range_it->second.count));
+            }
+        }
+      throw_assert(pop_names.empty(),
+                   "partition_graph_lp: population " << *pop_names.begin() << " not found");
+      sort(pop_node_ranges.begin(), pop_node_ranges.end());
+      ranges.offset.push_back(0);
+      for (const auto& range : pop_node_ranges)
+        {
+          ranges.start.push_back(range.first);
+          ranges.offset.push_back(ranges.offset.back() + range.second);
+        }
+      const size_t num_nodes = ranges.offset.back();
+
+      // each rank owns a contiguous range of node positions
+      vector<size_t> node_dist(size+1);
+      for (size_t r=0; r<=(size_t)size; r++)
+        {
+          node_dist[r] = num_nodes * r / size;
+        }
+      const size_t node_start = node_dist[rank];
+      const size_t num_local_nodes = node_dist[rank+1] - node_start;
+
+      // the edges are read by io_size ranks; each edge is sent as a
+      // (destination, source) pair to the owner of its destination,
+      // which counts its in-degree, and as a (source, destination) pair
+      // to the owner of its source, so that both endpoints know their
+      // neighbors
+      vector< vector<NODE_IDX_T> > rank_in_edges(size), rank_out_edges(size);
+      {
+        set<size_t> io_rank_set;
+        data::range_sample(size, max((size_t)1, min(io_size, (size_t)size)), io_rank_set);
+        const bool is_io_rank = (io_rank_set.find(rank) != io_rank_set.end());
+        MPI_Comm io_comm;
+        throw_assert_nomsg(MPI_Comm_split(comm, is_io_rank ? 1 : 0, rank, &io_comm) == MPI_SUCCESS);
+
+        vector<edge_map_t> prj_vector;
+        if (is_io_rank)
+          {
+            vector<map<string, vector<vector<string> > > > edge_attr_names_vector;
+            vector<string> attr_namespaces;
+            size_t read_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+            throw_assert_nomsg(read_graph(io_comm, file_name, attr_namespaces, prj_names, prj_vector,
+                                          edge_attr_names_vector, read_num_nodes,
+                                          local_num_edges, total_num_edges) >= 0);
+          }
+        throw_assert_nomsg(MPI_Comm_free(&io_comm) == MPI_SUCCESS);
+        for (const edge_map_t& edge_map : prj_vector)
+          {
+            for (const auto& it : edge_map)
+              {
+                const NODE_IDX_T dst_pos = node_position(ranges, it.first);
+                vector<NODE_IDX_T>& in_edges = rank_in_edges[position_owner(node_dist, dst_pos)];
+                for (const NODE_IDX_T src : get<0>(it.second))
+                  {
+                    const NODE_IDX_T src_pos = node_position(ranges, src);
+                    in_edges.push_back(dst_pos);
+                    in_edges.push_back(src_pos);
+                    if (src_pos != dst_pos)
+                      {
+                        vector<NODE_IDX_T>& out_edges = rank_out_edges[position_owner(node_dist, src_pos)];
+                        out_edges.push_back(src_pos);
+                        out_edges.push_back(dst_pos);
+                      }
+                  }
+              }
+          }
+      }
+
+      vector<NODE_IDX_T> in_recvbuf, out_recvbuf;
+      for (size_t k=0; k<2; k++)
+        {
+          vector< vector<NODE_IDX_T> >& rank_edges = (k == 0) ? rank_in_edges : rank_out_edges;
+          vector<int> sendcounts(size, 0), sdispls(size, 0), recvcounts(size, 0), rdispls(size, 0);
+          vector<NODE_IDX_T> sendbuf;
+          for (size_t r=0; r<(size_t)size; r++)
+            {
+              sdispls[r] = sendbuf.size();
+              sendbuf.insert(sendbuf.end(), rank_edges[r].begin(), rank_edges[r].end());
+              sendcounts[r] = sendbuf.size() - sdispls[r];
+              rank_edges[r].clear();
+            }
+          throw_assert_nomsg(mpi::alltoallv_vector<NODE_IDX_T>(comm, MPI_NODE_IDX_T, sendcounts, sdispls, sendbuf,
+                                                               recvcounts, rdispls,
+                                                               (k == 0) ? in_recvbuf : out_recvbuf) >= 0);
+        }
+
+      // the neighbors owned by other ranks are the ghost nodes of this
+      // rank; they are numbered after the local nodes
+      vector<size_t> ghost_pos;
+      for (const vector<NODE_IDX_T>* recvbuf : { &in_recvbuf, &out_recvbuf })
+        {
+          for (size_t i=0; i<recvbuf->size(); i+=2)
+            {
+              const size_t pos = (*recvbuf)[i+1];
+              if ((pos < node_start) || (pos >= node_start+num_local_nodes))
+                {
+                  ghost_pos.push_back(pos);
+                }
+            }
+        }
+      sort(ghost_pos.begin(), ghost_pos.end());
+      ghost_pos.erase(unique(ghost_pos.begin(), ghost_pos.end()), ghost_pos.end());
+      const size_t num_ghost_nodes = ghost_pos.size();
+
+      auto local_index = [&] (const size_t pos) -> size_t
+        {
+          if ((pos >= node_start) && (pos < node_start+num_local_nodes))
+            return pos - node_start;
+          return num_local_nodes + (lower_bound(ghost_pos.begin(), ghost_pos.end(), pos) - ghost_pos.begin());
+        };
+      auto global_position = [&] (const size_t idx) -> size_t
+        {
+          return (idx < num_local_nodes) ? node_start + idx : ghost_pos[idx - num_local_nodes];
+        };
+
+      // the ghost nodes are sorted and therefore grouped by owner; each
+      // owner is told once which of its nodes this rank needs
+      ghost_exchange_t ghost_exchange;
+      {
+        vector<int> sendcounts(size, 0), sdispls(size, 0);
+        vector<NODE_IDX_T> sendbuf(ghost_pos.begin(), ghost_pos.end()), recvbuf;
+        for (const size_t pos : ghost_pos)
+          {
+            sendcounts[position_owner(node_dist, pos)]++;
+          }
+        for (size_t r=1; r<(size_t)size; r++)
+          {
+            sdispls[r] = sdispls[r-1] + sendcounts[r-1];
+          }
+        vector<int> recvcounts, rdispls;
+        throw_assert_nomsg(mpi::alltoallv_vector<NODE_IDX_T>(comm, MPI_NODE_IDX_T, sendcounts, sdispls, sendbuf,
+                                                             recvcounts, rdispls, recvbuf) >= 0);
+        ghost_exchange.recvcounts = sendcounts;
+        ghost_exchange.rdispls = sdispls;
+        ghost_exchange.sendcounts = recvcounts;
+        ghost_exchange.sdispls = rdispls;
+        for (const NODE_IDX_T pos : recvbuf)
+          {
+            ghost_exchange.send_nodes.push_back(pos - node_start);
+          }
+      }
+
+      // adjacency in compressed sparse row form, by local index; parallel
+      // edges are kept and count as edges of higher weight
+      vector<size_t> in_degree(num_local_nodes, 0);
+      vector<size_t> adj_ptr(num_local_nodes+1, 0);
+      vector<size_t> adj;
+      for (size_t i=0; i<in_recvbuf.size(); i+=2)
+        {
+          const size_t dst_local = in_recvbuf[i] - node_start;
+          in_degree[dst_local]++;
+          if (in_recvbuf[i] != in_recvbuf[i+1])
+            {
+              adj_ptr[dst_local+1]++;
+            }
+        }
+      for (size_t i=0; i<out_recvbuf.size(); i+=2)
+        {
+          adj_ptr[out_recvbuf[i]-node_start+1]++;
+        }
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          adj_ptr[i+1] += adj_ptr[i];
+        }
+      adj.resize(adj_ptr[num_local_nodes]);
+      {
+        vector<size_t> fill(adj_ptr.begin(), adj_ptr.end()-1);
+        for (size_t i=0; i<in_recvbuf.size(); i+=2)
+          {
+            if (in_recvbuf[i] != in_recvbuf[i+1])
+              {
+                adj[fill[in_recvbuf[i]-node_start]++] = local_index(in_recvbuf[i+1]);
+              }
+          }
+        for (size_t i=0; i<out_recvbuf.size(); i+=2)
+          {
+            adj[fill[out_recvbuf[i]-node_start]++] = local_index(out_recvbuf[i+1]);
+          }
+      }
+      in_recvbuf.clear();
+      out_recvbuf.clear();
+
+      // total weights and maximum partition loads of both constraints
+      double totals[2] = { (double)num_local_nodes, 0.0 };
+      double max_weights[2] = { 1.0, 0.0 };
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          totals[1] += in_degree[i];
+          max_weights[1] = max(max_weights[1], (double)in_degree[i]);
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, totals, 2, MPI_DOUBLE, MPI_SUM, comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, max_weights, 2, MPI_DOUBLE, MPI_MAX, comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+      double max_loads[2];
+      for (size_t c=0; c<2; c++)
+        {
+          const double target = totals[c] / nparts;
+          max_loads[c] = max((1.0 + imbalance) * target, target + max_weights[c]);
+        }
+
+      // initial partition of the local nodes, followed by that of the
+      // ghost nodes
+      vector<uint32_t> parts(num_local_nodes + num_ghost_nodes, 0);
+      if (!node_rank_map.empty())
+        {
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              const NODE_IDX_T node = position_node(ranges, node_start+i);
+              auto it = node_rank_map.find(node);
+              throw_assert((it != node_rank_map.end()) && (!it->second.empty()),
+                           "partition_graph_lp: node " << node << " has no initial partition");
+              const rank_t p = *(it->second.begin());
+              throw_assert(p < nparts,
+                           "partition_graph_lp: initial partition " << p << " of node " << node <<
+                           " is out of range");
+              parts[i] = p;
+            }
+        }
+      else
+        {
+          // nodes with incoming edges are cut into contiguous ranges of
+          // equal in-degree, and the remaining nodes into contiguous
+          // ranges that bring every partition to the average node count
+          double local_sums[2] = { 0.0, 0.0 }, starts[2] = { 0.0, 0.0 };
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] > 0)
+                local_sums[1] += in_degree[i];
+              else
+                local_sums[0] += 1.0;
+            }
+          throw_assert(MPI_Exscan(local_sums, starts, 2, MPI_DOUBLE, MPI_SUM,
+                                  comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Exscan");
+          if (rank == 0)
+            {
+              starts[0] = starts[1] = 0.0;
+            }
+
+          vector<double> counts(nparts, 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] > 0)
+                {
+                  const double p = floor(nparts * (starts[1] + 0.5 * in_degree[i]) / totals[1]);
+                  parts[i] = min((double)(nparts-1), max(0.0, p));
+                  counts[parts[i]] += 1.0;
+                  starts[1] += in_degree[i];
+                }
+            }
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &counts[0], nparts, MPI_DOUBLE, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+
+          // remaining capacity of each partition for nodes without
+          // incoming edges
+          vector<double> capacity_end(nparts, 0.0);
+          double total_capacity = 0.0;
+          for (size_t p=0; p<nparts; p++)
+            {
+              total_capacity += max(0.0, totals[0] / nparts - counts[p]);
+              capacity_end[p] = total_capacity;
+            }
+          const double num_unconnected = totals[0] - accumulate(counts.begin(), counts.end(), 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] == 0)
+                {
+                  const double pos = (starts[0] + 0.5) / num_unconnected;
+                  size_t p = nparts * pos;
+                  if (total_capacity > 0.0)
+                    {
+                      p = upper_bound(capacity_end.begin(), capacity_end.end(),
+                                      pos * total_capacity) - capacity_end.begin();
+                    }
+                  parts[i] = min(nparts-1, p);
+                  starts[0] += 1.0;
+                }
+            }
+        }
+      exchange_ghost_parts(comm, ghost_exchange, num_local_nodes, parts);
+
+      vector<double> loads;
+      compute_loads(comm, nparts, parts, in_degree, loads);
+
+      // label propagation rounds
+      vector<double> connectivity(nparts, 0.0);
+      vector<uint32_t> touched;
+      size_t idle_rounds = 0;
+      for (size_t iter=0; (iter<num_iterations) && (idle_rounds < 2) && (num_nodes > 0); iter++)
+        {
+          const bool move_up = (iter % 2) == 0;
+
+          // each node proposes to move to the partition with the most
+          // neighbors in the direction of this round; nodes of
+          // overloaded partitions may also move to any partition that
+          // is not overloaded, preferring the least loaded one
+          vector<bool> overloaded(nparts, false);
+          for (size_t p=0; p<nparts; p++)
+            {
+              overloaded[p] = (loads[2*p] > max_loads[0]) || (loads[2*p+1] > max_loads[1]);
+            }
+          vector< tuple<double, size_t, uint32_t> > proposals;
+          vector<double> inflow(2*nparts, 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              const uint32_t cur = parts[i];
+              for (size_t j=adj_ptr[i]; j<adj_ptr[i+1]; j++)
+                {
+                  const uint32_t p = parts[adj[j]];
+                  if (connectivity[p] == 0.0)
+                    {
+                      touched.push_back(p);
+                    }
+                  connectivity[p] += 1.0;
+                }
+              uint32_t best = cur;
+              double best_connectivity = connectivity[cur];
+              if (overloaded[cur])
+                {
+                  double best_load = 0.0;
+                  for (uint32_t p=0; p<nparts; p++)
+                    {
+                      if ((move_up ? (p <= cur) : (p >= cur)) || overloaded[p])
+                        continue;
+                      const double load = loads[2*p] / max_loads[0] +
+                        ((max_loads[1] > 0.0) ? loads[2*p+1] / max_loads[1] : 0.0);
+                      if ((best == cur) || (connectivity[p] > best_connectivity) ||
+                          ((connectivity[p] == best_connectivity) && (load < best_load)))
+                        {
+                          best = p;
+                          best_connectivity = connectivity[p];
+                          best_load = load;
+                        }
+                    }
+                }
+              else
+                {
+                  for (const uint32_t p : touched)
+                    {
+                      if ((move_up ? (p > cur) : (p < cur)) &&
+                          ((connectivity[p] > best_connectivity) ||
+                           ((connectivity[p] == best_connectivity) && (best != cur) && (p < best))))
+                        {
+                          best = p;
+                          best_connectivity = connectivity[p];
+                        }
+                    }
+                }
+              if (best != cur)
+                {
+                  proposals.push_back(make_tuple(best_connectivity - connectivity[cur], i, best));
+                  inflow[2*best] += 1.0;
+                  inflow[2*best+1] += in_degree[i];
+                }
+              for (const uint32_t p : touched)
+                {
+                  connectivity[p] = 0.0;
+                }
+              touched.clear();
+            }
+
+          // each partition accepts the same fraction of the inflow
+          // proposed on every rank, so that its load stays within the
+          // maximum
+          vector<double> total_inflow(inflow);
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &total_inflow[0], 2*nparts, MPI_DOUBLE, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+          vector<double> accept_limit(2*nparts, 0.0);
+          for (size_t p=0; p<nparts; p++)
+            {
+              double fraction = 1.0;
+              for (size_t c=0; c<2; c++)
+                {
+                  if (total_inflow[2*p+c] > 0.0)
+                    {
+                      const double capacity = max(0.0, max_loads[c] - loads[2*p+c]);
+                      fraction = min(fraction, capacity / total_inflow[2*p+c]);
+                    }
+                }
+              for (size_t c=0; c<2; c++)
+                {
+                  accept_limit[2*p+c] = fraction * inflow[2*p+c];
+                }
+            }
+
+          // accept the proposals with the highest gains first
+          sort(proposals.begin(), proposals.end(),
+               [] (const tuple<double, size_t, uint32_t>& a,
+                   const tuple<double, size_t, uint32_t>& b)
+               {
+                 return (get<0>(a) > get<0>(b)) ||
+                   ((get<0>(a) == get<0>(b)) && (get<1>(a) < get<1>(b)));
+               });
+          vector<double> accepted(2*nparts, 0.0);
+          size_t num_moves = 0;
+          for (const auto& proposal : proposals)
+            {
+              const size_t i = get<1>(proposal);
+              const uint32_t p = get<2>(proposal);
+              const double w[2] = { 1.0, (double)in_degree[i] };
+              if ((accepted[2*p] + w[0] <= accept_limit[2*p] + 1e-9) &&
+                  (accepted[2*p+1] + w[1] <= accept_limit[2*p+1] + 1e-9))
+                {
+                  accepted[2*p] += w[0];
+                  accepted[2*p+1] += w[1];
+                  parts[i] = p;
+                  num_moves++;
+                }
+            }
+
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &num_moves, 1, MPI_SIZE_T, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+          idle_rounds = (num_moves == 0) ? idle_rounds + 1 : 0;
+
+          exchange_ghost_parts(comm, ghost_exchange, num_local_nodes, parts);
+          compute_loads(comm, nparts, parts, in_degree, loads);
+        }
+
+      // every edge is counted once, at its endpoint with the lower position
+      edge_cut = 0;
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          for (size_t j=adj_ptr[i]; j<adj_ptr[i+1]; j++)
+            {
+              if ((global_position(adj[j]) > node_start+i) && (parts[adj[j]] != parts[i]))
+                {
+                  edge_cut++;
+                }
+            }
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, &edge_cut, 1, MPI_SIZE_T, MPI_SUM,
+                                 comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+
+      // the partition of every node is gathered once, at the end
+      vector<uint32_t> all_parts(num_nodes);
+      {
+        vector<int> recvcounts(size), displs(size);
+        for (size_t r=0; r<(size_t)size; r++)
+          {
+            recvcounts[r] = node_dist[r+1] - node_dist[r];
+            displs[r] = node_dist[r];
+          }
+        throw_assert(MPI_Allgatherv(parts.data(), num_local_nodes, MPI_UINT32_T,
+                                    all_parts.data(), &recvcounts[0], &displs[0], MPI_UINT32_T,
+                                    comm) == MPI_SUCCESS,
+                     "partition_graph_lp: error in MPI_Allgatherv");
+      }
+      node_rank_map.clear();
+      for (size_t i=0; i<num_nodes; i++)
+        {
+          node_rank_map[position_node(ranges, i)].insert(all_parts[i]);
+        }
+
+      return 0;
+    }
+  }
+}
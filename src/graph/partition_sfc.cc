@@ -0,0 +1,419 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file partition_sfc.cc
+///
+///  Partitioning of cells along space-filling curves through their
+///  coordinates.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "partition_sfc.hh"
+#include "cell_attributes.hh"
+#include "read_projection_info.hh"
+#include "read_projection_datasets.hh"
+#include "sample_sort.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <set>
+#include <typeindex>
+
+#include <mpi.h>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Interleaves the bits of the three coordinates, with the most
+    /// significant bit of p[0] as the most significant bit of the key.
+    static uint64_t interleave_bits (const uint32_t p[3])
+    {
+      uint64_t key = 0;
+      for (int b = sfc_bits-1; b >= 0; b--)
+        {
+          for (size_t d = 0; d < 3; d++)
+            {
+              key = (key << 1) | ((p[d] >> b) & 1);
+            }
+        }
+      return key;
+    }
+
+    uint64_t morton_key (const uint32_t p[3])
+    {
+      return interleave_bits(p);
+    }
+
+    uint64_t hilbert_key (const uint32_t p[3])
+    {
+      // Converts the coordinates to the transposed Hilbert index as
+      // in J. Skilling, Programming the Hilbert curve (2004).
+      uint32_t x[3] = { p[0], p[1], p[2] };
+      const uint32_t m = 1U << (sfc_bits-1);
+
+      // inverse undo of excess work
+      for (uint32_t q = m; q > 1; q >>= 1)
+        {
+          const uint32_t r = q - 1;
+          for (size_t d = 0; d < 3; d++)
+            {
+              if (x[d] & q)
+                {
+                  x[0] ^= r;
+                }
+              else
+                {
+                  const uint32_t t = (x[0] ^ x[d]) & r;
+                  x[0] ^= t;
+                  x[d] ^= t;
+                }
+            }
+        }
+
+      // Gray encoding
+      for (size_t d = 1; d < 3; d++)
+        {
+          x[d] ^= x[d-1];
+        }
+      uint32_t t = 0;
+      for (uint32_t q = m; q > 1; q >>= 1)
+        {
+          if (x[2] & q)
+            {
+              t ^= q - 1;
+            }
+        }
+      for (size_t d = 0; d < 3; d++)
+        {
+          x[d] ^= t;
+        }
+
+      return interleave_bits(x);
+    }
+
+
+    void partition_sfc
+    (
+     MPI_Comm                  comm,
+     const vector<CELL_IDX_T>& gids,
+     const vector<COORD_T>&    coords,
+     const vector<double>&     weights,
+     const size_t              nparts,
+     const SpaceFillingCurve   curve,
+     node_rank_map_t&          node_rank_map
+     )
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+      throw_assert(nparts > 0, "partition_sfc: number of partitions must be positive");
+      throw_assert(coords.size() == 3*gids.size(),
+                   "partition_sfc: number of coordinates does not match number of cells");
+      throw_assert(weights.empty() || (weights.size() == gids.size()),
+                   "partition_sfc: number of weights does not match number of cells");
+
+      // bounding box of all cells
+      COORD_T lo[3], hi[3];
+      for (size_t d = 0; d < 3; d++)
+        {
+          lo[d] = numeric_limits<COORD_T>::max();
+          hi[d] = numeric_limits<COORD_T>::lowest();
+        }
+      for (size_t i = 0; i < gids.size(); i++)
+        {
+          for (size_t d = 0; d < 3; d++)
+            {
+              lo[d] = min(lo[d], coords[3*i+d]);
+              hi[d] = max(hi[d], coords[3*i+d]);
+            }
+        }
+      throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, lo, 3, MPI_COORD_T, MPI_MIN, comm) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Allreduce(MPI_IN_PLACE, hi, 3, MPI_COORD_T, MPI_MAX, comm) == MPI_SUCCESS);
+
+      // curve keys on a grid of 2^sfc_bits points along the largest
+      // extent, so that the grid cells are cubes
+      double extent = 0.0;
+      for (size_t d = 0; d < 3; d++)
+        {
+          extent = max(extent, (double)hi[d] - (double)lo[d]);
+        }
+      const uint32_t max_grid = (1U << sfc_bits) - 1;
+      const double scale = (extent > 0.0) ? (max_grid / extent) : 0.0;
+
+      vector<uint64_t> keys(gids.size());
+      for (size_t i = 0; i < gids.size(); i++)
+        {
+          uint32_t p[3];
+          for (size_t d = 0; d < 3; d++)
+            {
+              p[d] = min(max_grid, (uint32_t)(((double)coords[3*i+d] - lo[d]) * scale));
+            }
+          keys[i] = (curve == CurveHilbert) ? hilbert_key(p) : morton_key(p);
+        }
+
+      // order all cells along the curve
+      vector<CELL_IDX_T> sorted_gids(gids);
+      vector<double> sorted_weights(weights);
+      if (sorted_weights.empty())
+        {
+          sorted_weights.assign(gids.size(), 1.0);
+        }
+      mpi::bucket_plan_t plan;
+      mpi::sample_sort(comm, keys, plan);
+      mpi::bucket_exchange(comm, plan, sorted_gids);
+      mpi::bucket_exchange(comm, plan, sorted_weights);
+
+      // cut the curve into parts of nearly equal weight; each cell
+      // goes to the part that contains the midpoint of its weight
+      double local_weight = 0.0, weight_offset = 0.0, total_weight = 0.0;
+      for (const double w : sorted_weights)
+        {
+          local_weight += w;
+        }
+      throw_assert_nomsg(MPI_Exscan(&local_weight, &weight_offset, 1, MPI_DOUBLE, MPI_SUM,
+                                    comm) == MPI_SUCCESS);
+      if (rank == 0)
+        {
+          weight_offset = 0.0;
+        }
+      throw_assert_nomsg(MPI_Allreduce(&local_weight, &total_weight, 1, MPI_DOUBLE, MPI_SUM,
+                                       comm) == MPI_SUCCESS);
+
+      vector<rank_t> parts(sorted_gids.size());
+      double cumulative_weight = weight_offset;
+      for (size_t i = 0; i < sorted_gids.size(); i++)
+        {
+          const double w = sorted_weights[i];
+          size_t p = 0;
+          if (total_weight > 0.0)
+            {
+              p = (size_t)(nparts * ((cumulative_weight + 0.5*w) / total_weight));
+            }
+          parts[i] = min(p, nparts-1);
+          cumulative_weight += w;
+        }
+
+      // send the assignment of each cell to the rank of its part
+      vector<rank_t> part_ranks(parts.size());
+      for (size_t i = 0; i < parts.size(); i++)
+        {
+          part_ranks[i] = parts[i] % size;
+        }
+      mpi::bucket_plan_t part_plan;
+      mpi::bucket_plan(comm, part_ranks, part_plan);
+      mpi::bucket_exchange(comm, part_plan, sorted_gids);
+      mpi::bucket_exchange(comm, part_plan, parts);
+
+      for (size_t i = 0; i < sorted_gids.size(); i++)
+        {
+          node_rank_map[sorted_gids[i]].insert(parts[i]);
+        }
+    }
+
+
+    void partition_population_sfc
+    (
+     MPI_Comm                  comm,
+     const string&             file_name,
+     const string&             coord_namespace,
+     const string&             pop_name,
+     const CELL_IDX_T&         pop_start,
+     const vector<string>&     src_pop_names,
+     const size_t              nparts,
+     const SpaceFillingCurve   curve,
+     node_rank_map_t&          node_rank_map,
+     const vector<string>&     coord_names
+     )
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert(coord_names.size() == 3,
+                   "partition_population_sfc: three coordinate attribute names are required");
+
+      data::NamedAttrMap attr_values;
+      set<string> attr_mask(coord_names.begin(), coord_names.end());
+      cell::read_cell_attributes(comm, file_name, coord_namespace, attr_mask, pop_name, pop_start,
+                                 attr_values);
+
+      const map<string, size_t>& name_map = attr_values.attr_name_map[type_index(typeid(COORD_T))];
+      vector<const map<CELL_IDX_T, deque<COORD_T> >*> coord_maps;
+      for (const string& coord_name : coord_names)
+        {
+          auto it = name_map.find(coord_name);
+          throw_assert(it != name_map.end(),
+                       "partition_population_sfc: coordinate attribute " << coord_name <<
+                       " of type float not found in namespace " << coord_namespace);
+          coord_maps.push_back(&attr_values.attr_map<COORD_T>(it->second));
+        }
+
+      vector<CELL_IDX_T> gids;
+      vector<COORD_T> coords;
+      for (const CELL_IDX_T gid : attr_values.index_set)
+        {
+          gids.push_back(gid);
+          for (size_t d = 0; d < 3; d++)
+            {
+              auto it = coord_maps[d]->find(gid);
+              throw_assert((it != coord_maps[d]->end()) && (it->second.size() > 0),
+                           "partition_population_sfc: cell " << gid << " has no value for attribute " <<
+                           coord_names[d]);
+              coords.push_back(it->second[0]);
+            }
+        }
+      attr_values.clear();
+
+      vector<double> weights;
+      if (!src_pop_names.empty())
+        {
+          // in-degree of the cells whose destination pointers were read
+          // by this rank, as (gid, count) pairs
+          vector<CELL_IDX_T> degree_gids;
+          vector<uint32_t> degree_counts;
+          for (const string& src_pop_name : src_pop_names)
+            {
+              bool has_projection_flag = false;
+              throw_assert(has_projection(comm, file_name, src_pop_name, pop_name, has_projection_flag) >= 0,
+                           "partition_population_sfc: error in has_projection");
+              throw_assert(has_projection_flag,
+                           "partition_population_sfc: projection " << src_pop_name << " -> " <<
+                           pop_name << " not found");
+
+              DST_BLK_PTR_T block_base;
+              DST_PTR_T edge_base;
+              vector<DST_BLK_PTR_T> dst_blk_ptr;
+              vector<NODE_IDX_T> dst_idx;
+              vector<DST_PTR_T> dst_ptr;
+              throw_assert(hdf5::read_projection_node_datasets(comm, file_name, src_pop_name, pop_name,
+                                                               block_base, edge_base,
+                                                               dst_blk_ptr, dst_idx, dst_ptr) >= 0,
+                           "partition_population_sfc: error in read_projection_node_datasets");
+
+              if (dst_blk_ptr.size() > 0)
+                {
+                  const size_t dst_ptr_size = dst_ptr.size();
+                  for (size_t b = 0; b < dst_blk_ptr.size()-1; ++b)
+                    {
+                      const size_t low_dst_ptr = dst_blk_ptr[b], high_dst_ptr = dst_blk_ptr[b+1];
+                      const NODE_IDX_T dst_base = dst_idx[b];
+                      for (size_t i = low_dst_ptr, ii = 0; i < high_dst_ptr; ++i, ++ii)
+                        {
+                          if ((i < dst_ptr_size-1) && (dst_ptr[i+1] > dst_ptr[i]))
+                            {
+                              degree_gids.push_back(pop_start + dst_base + ii);
+                              degree_counts.push_back(dst_ptr[i+1] - dst_ptr[i]);
+                            }
+                        }
+                    }
+                }
+            }
+
+          // the in-degree and coordinates of each cell are gathered on
+          // rank gid % size, so that no rank holds the in-degree of the
+          // whole population
+          vector<rank_t> degree_ranks(degree_gids.size());
+          for (size_t i = 0; i < degree_gids.size(); i++)
+            {
+              degree_ranks[i] = degree_gids[i] % size;
+            }
+          mpi::bucket_plan_t degree_plan;
+          mpi::bucket_plan(comm, degree_ranks, degree_plan);
+          mpi::bucket_exchange(comm, degree_plan, degree_gids);
+          mpi::bucket_exchange(comm, degree_plan, degree_counts);
+
+          map<CELL_IDX_T, uint32_t> indegree;
+          for (size_t i = 0; i < degree_gids.size(); i++)
+            {
+              indegree[degree_gids[i]] += degree_counts[i];
+            }
+
+          vector<rank_t> cell_ranks(gids.size());
+          vector<COORD_T> xs(gids.size()), ys(gids.size()), zs(gids.size());
+          for (size_t i = 0; i < gids.size(); i++)
+            {
+              cell_ranks[i] = gids[i] % size;
+              xs[i] = coords[3*i];
+              ys[i] = coords[3*i+1];
+              zs[i] = coords[3*i+2];
+            }
+          mpi::bucket_plan_t cell_plan;
+          mpi::bucket_plan(comm, cell_ranks, cell_plan);
+          mpi::bucket_exchange(comm, cell_plan, gids);
+          mpi::bucket_exchange(comm, cell_plan, xs);
+          mpi::bucket_exchange(comm, cell_plan, ys);
+          mpi::bucket_exchange(comm, cell_plan, zs);
+
+          coords.resize(3*gids.size());
+          weights.resize(gids.size());
+          for (size_t i = 0; i < gids.size(); i++)
+            {
+              coords[3*i] = xs[i];
+              coords[3*i+1] = ys[i];
+              coords[3*i+2] = zs[i];
+              auto it = indegree.find(gids[i]);
+              weights[i] = 1.0 + ((it != indegree.end()) ? it->second : 0);
+            }
+        }
+
+      partition_sfc(comm, gids, coords, weights, nparts, curve, node_rank_map);
+    }
+
+
+
+    void replicate_node_rank_map
+    (
+     MPI_Comm                  comm,
+     node_rank_map_t&          node_rank_map
+     )
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+
+      // one (gid, rank) pair per rank of each cell
+      vector<CELL_IDX_T> local_gids;
+      vector<rank_t> local_ranks;
+      for (auto const& it : node_rank_map)
+        {
+          for (const rank_t r : it.second)
+            {
+              local_gids.push_back(it.first);
+              local_ranks.push_back(r);
+            }
+        }
+
+      int local_count = local_gids.size();
+      vector<int> recvcounts(size), displs(size+1, 0);
+      throw_assert(MPI_Allgather(&local_count, 1, MPI_INT, &recvcounts[0], 1, MPI_INT,
+                                 comm) == MPI_SUCCESS,
+                   "replicate_node_rank_map: error in MPI_Allgather");
+      for (size_t r=0; r<(size_t)size; r++)
+        {
+          displs[r+1] = displs[r] + recvcounts[r];
+        }
+
+      vector<CELL_IDX_T> all_gids(displs[size]);
+      vector<rank_t> all_ranks(displs[size]);
+      throw_assert(MPI_Allgatherv(local_gids.data(), local_count, MPI_CELL_IDX_T,
+                                  all_gids.data(), &recvcounts[0], &displs[0], MPI_CELL_IDX_T,
+                                  comm) == MPI_SUCCESS,
+                   "replicate_node_rank_map: error in MPI_Allgatherv");
+      throw_assert(MPI_Allgatherv(local_ranks.data(), local_count, MPI_UINT32_T,
+                                  all_ranks.data(), &recvcounts[0], &displs[0], MPI_UINT32_T,
+                                  comm) == MPI_SUCCESS,
+                   "replicate_node_rank_map: error in MPI_Allgatherv");
+
+      for (size_t i=0; i<all_gids.size(); i++)
+        {
+          node_rank_map[all_gids[i]].insert(all_ranks[i]);
+        }
+    }
+
+  }
+}
@@ -35,7 +35,8 @@ namespace neuroh5
      vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
      size_t&              total_num_nodes,
      size_t&              local_num_edges,
-     size_t&              total_num_edges
+     size_t&              total_num_edges,
+     const EdgeAttrFilter& edge_filter
      )
     {
       int status = 0;
@@ -103,7 +104,8 @@ namespace neuroh5
                   prj_vector, edge_attr_names_vector,
                   local_prj_num_nodes,
                   local_prj_num_edges, total_prj_num_edges,
-                  local_read_blocks, total_read_blocks) >= 0);
+                  local_read_blocks, total_read_blocks,
+                  0, 0, true, edge_filter) >= 0);
 
           mpi::MPI_DEBUG(comm, "read_graph: projection ", i, " has a total of ", total_prj_num_edges, " edges");
           
@@ -113,10 +115,11 @@ namespace neuroh5
 
       size_t sum_local_num_edges = 0;
       status = MPI_Reduce(&local_num_edges, &sum_local_num_edges, 1,
-                          MPI_SIZE_T, MPI_SUM, 0, MPI_COMM_WORLD);
+                          MPI_SIZE_T, MPI_SUM, 0, comm);
       throw_assert_nomsg(status == MPI_SUCCESS);
       
-      if (rank == 0)
+      // edges removed by the predicates are not read by any rank
+      if ((rank == 0) && edge_filter.predicates.empty())
         {
           if (sum_local_num_edges != total_num_edges)
             {
@@ -16,7 +16,9 @@
 #include "validate_edge_list.hh"
 #include "append_edge_map.hh"
 #include "mpi_debug.hh"
+#include "mpi_trace.hh"
 #include "debug.hh"
+#include "thread_pool.hh"
 
 #include <iostream>
 #include <sstream>
@@ -55,9 +57,11 @@ namespace neuroh5
      hsize_t&                   total_read_blocks,
      size_t                     offset,
      size_t                     numitems,
-     bool collective
+     bool collective,
+     const EdgeAttrFilter&      edge_filter
      )
     {
+      mpi::trace_scope trace_total("read_projection");
       herr_t ierr = 0;
       unsigned int rank, size;
       throw_assert(MPI_Comm_size(comm, (int*)&size) == MPI_SUCCESS,
@@ -74,40 +78,49 @@ namespace neuroh5
       vector<DST_PTR_T> dst_ptr;
       vector<NODE_IDX_T> src_idx;
       map<string, data::NamedAttrVal> edge_attr_map;
+      // the threads given by NEUROH5_NUM_THREADS decompress the datasets
+      data::thread_pool pool;
 
       mpi::MPI_DEBUG(comm, "read_projection: ", src_pop_name, " -> ", dst_pop_name);
-      throw_assert(hdf5::read_projection_datasets(comm, file_name, src_pop_name, dst_pop_name,
-                                                  block_base, edge_base,
-                                                  dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                  total_num_edges, total_read_blocks, local_read_blocks,
-                                                  offset, numitems) >= 0,
-                   "read_projection: read_projection_datasets error");
+      {
+        mpi::trace_scope trace("read_projection.read");
+        throw_assert(hdf5::read_projection_datasets(comm, file_name, src_pop_name, dst_pop_name,
+                                                    block_base, edge_base,
+                                                    dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                    total_num_edges, total_read_blocks, local_read_blocks,
+                                                    offset, numitems, true, &pool) >= 0,
+                     "read_projection: read_projection_datasets error");
+        trace.add_items(src_idx.size());
+        trace.add_bytes(src_idx.size() * sizeof(NODE_IDX_T) + dst_ptr.size() * sizeof(DST_PTR_T));
+      }
       
       mpi::MPI_DEBUG(comm, "read_projection: validating projection ", src_pop_name, " -> ", dst_pop_name);
       
       // validate the edges
-      throw_assert(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx,
-                                      dst_ptr, src_idx, pop_search_ranges, pop_pairs) ==
-                   true, "read_projection: invalid edge list");
+      {
+        mpi::trace_scope trace("read_projection.validate");
+        throw_assert(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx,
+                                        dst_ptr, src_idx, pop_search_ranges, pop_pairs) ==
+                     true, "read_projection: invalid edge list");
+        trace.add_items(src_idx.size());
+      }
       
       edge_count = src_idx.size();
-      local_num_edges = edge_count;
+
+      {
+        mpi::trace_scope trace("read_projection.attributes");
+        throw_assert(graph::read_filtered_edge_attributes
+                     (comm, file_name, src_pop_name, dst_pop_name, attr_namespaces,
+                      edge_filter, edge_base, edge_count,
+                      dst_ptr, src_idx, edge_attr_map, &pool) >= 0,
+                     "read_projection: read_filtered_edge_attributes error");
+        trace.add_items(edge_count);
+      }
+      local_num_edges = src_idx.size();
 
       map <string, vector < vector<string> > > edge_attr_names;
       for (string attr_namespace : attr_namespaces) 
         {
-          vector< pair<string,AttrKind> > edge_attr_info;
-          
-          throw_assert(graph::get_edge_attributes(comm, file_name, src_pop_name, dst_pop_name,
-                                                  attr_namespace, edge_attr_info) >= 0,
-                       "read_projection: get_edge_attributes error");
-          
-          throw_assert(graph::read_all_edge_attributes
-                       (comm, file_name, src_pop_name, dst_pop_name, attr_namespace,
-                        edge_base, edge_count, edge_attr_info,
-                        edge_attr_map[attr_namespace]) >= 0,
-                       "read_projection: read_all_edge_attributes error");
-          
           edge_attr_map[attr_namespace].attr_names(edge_attr_names[attr_namespace]);
         }
       
@@ -116,16 +129,20 @@ namespace neuroh5
       edge_map_t prj_edge_map;
       // append to the vectors representing a projection (sources,
       // destinations, edge attributes)
-      throw_assert(data::append_edge_map(dst_start, src_start, dst_blk_ptr, dst_idx,
-                                         dst_ptr, src_idx, attr_namespaces, edge_attr_map,
-                                         local_prj_num_edges, prj_edge_map,
-                                         EdgeMapDst) >= 0,
-                   "read_projection: error in append_edge_map");
+      {
+        mpi::trace_scope trace("read_projection.append_edge_map");
+        throw_assert(data::append_edge_map(dst_start, src_start, dst_blk_ptr, dst_idx,
+                                           dst_ptr, src_idx, attr_namespaces, edge_attr_map,
+                                           local_prj_num_edges, prj_edge_map,
+                                           EdgeMapDst) >= 0,
+                     "read_projection: error in append_edge_map");
+        trace.add_items(local_prj_num_edges);
+      }
       local_num_nodes = prj_edge_map.size();
       
       // ensure that all edges in the projection have been read and
       // appended to edge_list
-      throw_assert(local_prj_num_edges == edge_count,
+      throw_assert(local_prj_num_edges == local_num_edges,
                    "read_projection: edge count mismatch");
 
       prj_vector.push_back(prj_edge_map);
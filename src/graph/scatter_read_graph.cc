@@ -49,7 +49,8 @@ namespace neuroh5
      size_t                       &local_num_nodes,
      size_t                       &total_num_nodes,
      size_t                       &local_num_edges,
-     size_t                       &total_num_edges
+     size_t                       &total_num_edges,
+     const EdgeAttrFilter&         edge_filter
      )
     {
       int ierr = 0;
@@ -110,7 +111,7 @@ namespace neuroh5
                                   node_rank_map, pop_search_ranges, pop_pairs,
                                   prj_vector, edge_attr_names_vector, 
                                   local_num_nodes, local_num_edges, total_num_edges,
-                                  total_read_blocks);
+                                  total_read_blocks, 0, 0, edge_filter);
 #ifdef NEUROH5_DEBUG
           MPI_Barrier(all_comm); 
 #endif
@@ -13,6 +13,9 @@
 #include "neuroh5_types.hh"
 #include "read_projection_datasets.hh"
 #include "edge_attributes.hh"
+#include "edge_attr_filter.hh"
+#include "dataset_num_elements.hh"
+#include "path_names.hh"
 #include "cell_populations.hh"
 #include "validate_edge_list.hh"
 #include "scatter_read_projection.hh"
@@ -22,8 +25,13 @@
 #include "append_rank_edge_map.hh"
 #include "range_sample.hh"
 #include "mpi_debug.hh"
+#include "mpi_trace.hh"
+#include "mpi_memory.hh"
+#include "memory_size.hh"
+#include "thread_pool.hh"
 #include "throw_assert.hh"
 
+#include <algorithm>
 #include <cstdio>
 #include <iostream>
 #include <sstream>
@@ -41,22 +49,74 @@ namespace neuroh5
   {
     
     /*****************************************************************************
-     * Load and scatter edge data structures 
+     * Determines the number of blocks of a projection and estimates the
+     * number of bytes of its edges and edge attributes
      *****************************************************************************/
 
-    int scatter_read_projection (MPI_Comm all_comm, const int io_size, EdgeMapType edge_map_type, 
-                                 const string& file_name, const string& src_pop_name, const string& dst_pop_name, 
-                                 const NODE_IDX_T& src_start,
-                                 const NODE_IDX_T& dst_start,
-                                 const vector<string> &attr_namespaces,
-                                 const node_rank_map_t&  node_rank_map,
-                                 const pop_search_range_map_t& pop_search_ranges,
-                                 const set< pair<pop_t, pop_t> >& pop_pairs,
-                                 vector < edge_map_t >& prj_vector,
-                                 vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
-                                 size_t &local_num_nodes, size_t &local_num_edges, size_t &total_num_edges,
-                                 hsize_t& total_read_blocks,
-                                 size_t offset, size_t numitems)
+    static void projection_read_size (MPI_Comm all_comm, const string& file_name,
+                                      const string& src_pop_name, const string& dst_pop_name,
+                                      const vector<string> &attr_namespaces,
+                                      hsize_t& num_blocks, uint64_t& data_bytes)
+    {
+      int rank;
+      throw_assert_nomsg(MPI_Comm_rank(all_comm, &rank) == MPI_SUCCESS);
+
+      // number of blocks, destination pointers, and edges
+      vector<uint64_t> counts(3, 0);
+      if (rank == 0)
+        {
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+          throw_assert_nomsg(file >= 0);
+          counts[0] = hdf5::dataset_num_elements
+            (file, hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::DST_BLK_PTR));
+          counts[1] = hdf5::dataset_num_elements
+            (file, hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::DST_PTR));
+          counts[2] = hdf5::dataset_num_elements
+            (file, hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::SRC_IDX));
+          throw_assert_nomsg(H5Fclose(file) >= 0);
+        }
+      throw_assert_nomsg(MPI_Bcast(&counts[0], counts.size(), MPI_UINT64_T, 0, all_comm) == MPI_SUCCESS);
+
+      num_blocks = (counts[0] > 0) ? counts[0] - 1 : 0;
+
+      size_t edge_bytes = sizeof(NODE_IDX_T);
+      for (const string& attr_namespace : attr_namespaces)
+        {
+          vector< pair<string,AttrKind> > edge_attr_info;
+          throw_assert_nomsg(graph::get_edge_attributes(all_comm, file_name, src_pop_name, dst_pop_name,
+                                                        attr_namespace, edge_attr_info) >= 0);
+          for (auto const& attr_info : edge_attr_info)
+            {
+              edge_bytes += attr_info.second.size;
+            }
+        }
+
+      data_bytes = counts[0] * (sizeof(DST_BLK_PTR_T) + sizeof(NODE_IDX_T)) +
+        counts[1] * sizeof(DST_PTR_T) + counts[2] * edge_bytes;
+    }
+
+    /*****************************************************************************
+     * Reads a range of blocks of a projection on the I/O ranks and
+     * scatters the edges to their destination ranks, where they are
+     * appended to prj_edge_map; compressed datasets are decompressed on
+     * the threads of pool
+     *****************************************************************************/
+
+    static void scatter_read_projection_round (MPI_Comm all_comm, const int io_size, EdgeMapType edge_map_type, 
+                                               const string& file_name, const string& src_pop_name, const string& dst_pop_name, 
+                                               const NODE_IDX_T& src_start,
+                                               const NODE_IDX_T& dst_start,
+                                               const vector<string> &attr_namespaces,
+                                               const node_rank_map_t&  node_rank_map,
+                                               const pop_search_range_map_t& pop_search_ranges,
+                                               const set< pair<pop_t, pop_t> >& pop_pairs,
+                                               edge_map_t& prj_edge_map,
+                                               map<string, vector< vector<string> > >& edge_attr_names,
+                                               size_t &local_num_nodes, size_t &local_num_edges, size_t &total_num_edges,
+                                               hsize_t& total_read_blocks,
+                                               size_t offset, size_t numblocks,
+                                               const EdgeAttrFilter& edge_filter,
+                                               data::thread_pool& pool)
     {
       // MPI Communicator for I/O ranks
       MPI_Comm io_comm;
@@ -90,21 +150,18 @@ namespace neuroh5
           MPI_Comm_split(all_comm,0,rank,&io_comm);
         }
 
-      vector<NODE_IDX_T> send_edges, recv_edges, total_recv_edges;
       rank_edge_map_t prj_rank_edge_map;
-      edge_map_t prj_edge_map;
       size_t num_edges = 0;
-      map<string, vector< vector<string> > > edge_attr_names;
-      
-      local_num_nodes=0; local_num_edges=0;
-      
+
       {
         vector<char> recvbuf;
         vector<int> recvcounts, rdispls;
+        mpi::memory_scope recvbuf_memory("scatter_read_projection.recv_buffer");
 
         {
           vector<char> sendbuf; 
           vector<int> sendcounts(size,0), sdispls(size,0);
+          mpi::memory_scope sendbuf_memory("scatter_read_projection.send_buffer");
 
           mpi::MPI_DEBUG(all_comm, "scatter_read_projection: ", src_pop_name, " -> ", dst_pop_name, "\n");
 
@@ -122,40 +179,58 @@ namespace neuroh5
               vector<NODE_IDX_T> src_idx;
               map<string, data::NamedAttrVal> edge_attr_map;
               hsize_t local_read_blocks;
+              mpi::memory_scope dbs_memory("scatter_read_projection.dbs_arrays");
 
               mpi::MPI_DEBUG(io_comm, "scatter_read_projection: reading projection ", src_pop_name, " -> ", dst_pop_name);
-              throw_assert_nomsg(hdf5::read_projection_datasets(io_comm, file_name, src_pop_name, dst_pop_name,
-                                                                block_base, edge_base,
-                                                                dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                                total_num_edges, total_read_blocks, local_read_blocks,
-                                                                offset, numitems * size) >= 0);
+              {
+                mpi::trace_scope trace("scatter_read_projection.read");
+                throw_assert_nomsg(hdf5::read_projection_datasets(io_comm, file_name, src_pop_name, dst_pop_name,
+                                                                  block_base, edge_base,
+                                                                  dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                                  total_num_edges, total_read_blocks, local_read_blocks,
+                                                                  offset, numblocks, true, &pool) >= 0);
+                trace.add_items(src_idx.size());
+                trace.add_bytes(src_idx.size() * sizeof(NODE_IDX_T) + dst_ptr.size() * sizeof(DST_PTR_T));
+              }
+              dbs_memory.set(data::vector_bytes(dst_blk_ptr) + data::vector_bytes(dst_idx) +
+                             data::vector_bytes(dst_ptr) + data::vector_bytes(src_idx));
           
               mpi::MPI_DEBUG(io_comm, "scatter_read_projection: validating projection ", src_pop_name, " -> ", dst_pop_name);
               // validate the edges
-              throw_assert_nomsg(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                    pop_search_ranges, pop_pairs) == true);
+              {
+                mpi::trace_scope trace("scatter_read_projection.validate");
+                throw_assert_nomsg(validate_edge_list(dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                      pop_search_ranges, pop_pairs) == true);
+                trace.add_items(src_idx.size());
+              }
           
               edge_count = src_idx.size();
               mpi::MPI_DEBUG(io_comm, "scatter_read_projection: reading attributes for ", src_pop_name, " -> ", dst_pop_name);
+              {
+                mpi::trace_scope trace("scatter_read_projection.attributes");
+                throw_assert_nomsg(graph::read_filtered_edge_attributes(io_comm, file_name, src_pop_name, dst_pop_name,
+                                                                        attr_namespaces, edge_filter,
+                                                                        edge_base, edge_count,
+                                                                        dst_ptr, src_idx, edge_attr_map, &pool) >= 0);
+                trace.add_items(edge_count);
+              }
               for (const string& attr_namespace : attr_namespaces) 
                 {
-                  vector< pair<string,AttrKind> > edge_attr_info;
-                  throw_assert_nomsg(graph::get_edge_attributes(io_comm, file_name, src_pop_name, dst_pop_name,
-                                                                attr_namespace, edge_attr_info) >= 0);
-
-                  throw_assert_nomsg(graph::read_all_edge_attributes(io_comm, file_name,
-                                                                     src_pop_name, dst_pop_name, attr_namespace,
-                                                                     edge_base, edge_count, edge_attr_info,
-                                                                     edge_attr_map[attr_namespace]) >= 0);
-                  
                   edge_attr_map[attr_namespace].attr_names(edge_attr_names[attr_namespace]);
+                  dbs_memory.add(data::attr_val_bytes(edge_attr_map[attr_namespace]));
                 }
 
               
               // append to the edge map
-              throw_assert_nomsg(data::append_rank_edge_map(rank, size, dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
-                                                            attr_namespaces, edge_attr_map, node_rank_map, num_edges, prj_rank_edge_map,
-                                                            edge_map_type) >= 0);
+              {
+                mpi::trace_scope trace("scatter_read_projection.append_rank_edge_map");
+                throw_assert_nomsg(data::append_rank_edge_map(rank, size, dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                                              attr_namespaces, edge_attr_map, node_rank_map, num_edges, prj_rank_edge_map,
+                                                              edge_map_type) >= 0);
+                trace.add_items(num_edges);
+              }
+              mpi::memory_scope rank_edge_map_memory("scatter_read_projection.rank_edge_map",
+                                                     data::rank_edge_map_bytes(prj_rank_edge_map));
               
               mpi::MPI_DEBUG(io_comm, "scatter_read_projection: read ", num_edges,
                         " edges from projection ", src_pop_name, " -> ", dst_pop_name);
@@ -163,59 +238,189 @@ namespace neuroh5
               // ensure that all edges in the projection have been read and appended to edge_list
               throw_assert_nomsg(num_edges == src_idx.size());
           
-              size_t num_packed_edges = 0;
+              if (size == 1)
+                {
+                  // a single rank moves its edges to the result instead
+                  // of serializing and sending them to itself
+                  mpi::trace_scope trace("scatter_read_projection.merge");
+                  size_t num_merged_edges = 0;
+                  for (auto& it : prj_rank_edge_map)
+                    {
+                      data::merge_edge_map(it.second, prj_edge_map, local_num_nodes, num_merged_edges);
+                    }
+                  throw_assert_nomsg(num_merged_edges == num_edges);
+                  local_num_edges += num_merged_edges;
+                  trace.add_items(num_merged_edges);
+                  rank_edge_map_t().swap(prj_rank_edge_map);
+                  rank_edge_map_memory.set(0);
+                }
+              else
+                {
+                  size_t num_packed_edges = 0;
           
-              data::serialize_rank_edge_map (size, rank, prj_rank_edge_map, 
-                                             num_packed_edges, sendcounts, sendbuf, sdispls);
+                  {
+                    mpi::trace_scope trace("scatter_read_projection.serialize");
+                    data::serialize_rank_edge_map (size, rank, prj_rank_edge_map, 
+                                                   num_packed_edges, sendcounts, sendbuf, sdispls);
+                    trace.add_items(num_packed_edges);
+                    trace.add_bytes(sendbuf.size());
+                  }
+                  sendbuf_memory.set(data::vector_bytes(sendbuf));
+                  // the edges are now held by the send buffer
+                  rank_edge_map_t().swap(prj_rank_edge_map);
+                  rank_edge_map_memory.set(0);
 
-              // ensure the correct number of edges is being packed
-              throw_assert_nomsg(num_packed_edges == num_edges);
-              mpi::MPI_DEBUG(io_comm, "scatter_read_projection: packed ", num_packed_edges,
-                        " edges from projection ", src_pop_name, " -> ", dst_pop_name);
+                  // ensure the correct number of edges is being packed
+                  throw_assert_nomsg(num_packed_edges == num_edges);
+                  mpi::MPI_DEBUG(io_comm, "scatter_read_projection: packed ", num_packed_edges,
+                                 " edges from projection ", src_pop_name, " -> ", dst_pop_name);
+                }
 
             } // is_io_rank
 
           
           MPI_Comm_free(&io_comm);
           throw_assert_nomsg(MPI_Bcast(&total_read_blocks, 1, MPI_SIZE_T, io_rank_root, all_comm) == MPI_SUCCESS);
-          throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
-                                                         recvcounts, rdispls, recvbuf) >= 0);
+          throw_assert_nomsg(MPI_Bcast(&total_num_edges, 1, MPI_SIZE_T, io_rank_root, all_comm) == MPI_SUCCESS);
+          if (size > 1)
+            {
+              throw_assert_nomsg(mpi::alltoallv_vector<char>(all_comm, MPI_CHAR, sendcounts, sdispls, sendbuf,
+                                                             recvcounts, rdispls, recvbuf) >= 0);
+              recvbuf_memory.set(data::vector_bytes(recvbuf));
+            }
         }
 
         if (recvbuf.size() > 0)
           {
-            data::deserialize_rank_edge_map (size, recvbuf, recvcounts, rdispls, 
-                                             prj_edge_map, local_num_nodes, local_num_edges);
+            {
+              mpi::trace_scope trace("scatter_read_projection.deserialize");
+              // the counts accumulate over the rounds of a budgeted read
+              const size_t round_start_edges = local_num_edges;
+              data::deserialize_rank_edge_map (size, recvbuf, recvcounts, rdispls, 
+                                               prj_edge_map, local_num_nodes, local_num_edges);
+              trace.add_items(local_num_edges - round_start_edges);
+              trace.add_bytes(recvbuf.size());
+            }
           }
+      }
+    }
 
-        if (!attr_namespaces.empty())
-          {
-            vector<char> sendbuf; uint32_t sendbuf_size=0;
-            if (rank == 0)
-              {
-                data::serialize_data(edge_attr_names, sendbuf);
-                sendbuf_size = sendbuf.size();
-              }
+    /*****************************************************************************
+     * Load and scatter edge data structures 
+     *****************************************************************************/
 
-            throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
-            throw_assert_nomsg(MPI_Bcast(&sendbuf_size, 1, MPI_UINT32_T, 0, all_comm) == MPI_SUCCESS);
-            sendbuf.resize(sendbuf_size);
-            throw_assert_nomsg(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, all_comm) == MPI_SUCCESS);
-            
-            if (rank != 0)
-              {
-                data::deserialize_data(sendbuf, edge_attr_names);
-              }
-            edge_attr_names_vector.push_back(edge_attr_names);
+    int scatter_read_projection (MPI_Comm all_comm, const int io_size, EdgeMapType edge_map_type, 
+                                 const string& file_name, const string& src_pop_name, const string& dst_pop_name, 
+                                 const NODE_IDX_T& src_start,
+                                 const NODE_IDX_T& dst_start,
+                                 const vector<string> &attr_namespaces,
+                                 const node_rank_map_t&  node_rank_map,
+                                 const pop_search_range_map_t& pop_search_ranges,
+                                 const set< pair<pop_t, pop_t> >& pop_pairs,
+                                 vector < edge_map_t >& prj_vector,
+                                 vector < map <string, vector < vector<string> > > > & edge_attr_names_vector,
+                                 size_t &local_num_nodes, size_t &local_num_edges, size_t &total_num_edges,
+                                 hsize_t& total_read_blocks,
+                                 size_t offset, size_t numitems,
+                                 const EdgeAttrFilter& edge_filter)
+    {
+      mpi::trace_scope trace_total("scatter_read_projection");
+
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(all_comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(all_comm, &rank) == MPI_SUCCESS);
+
+      edge_map_t prj_edge_map;
+      map<string, vector< vector<string> > > edge_attr_names;
+      
+      local_num_nodes=0; local_num_edges=0;
+
+      // the threads given by NEUROH5_NUM_THREADS decompress the
+      // datasets of all rounds
+      data::thread_pool pool;
+
+      // With a memory budget, the I/O set is enlarged and the blocks
+      // are read in rounds so that the I/O ranks, which hold the raw
+      // DBS arrays, the partitioned edges and the send buffer at the
+      // same time, stay within the budget.
+      mpi::read_plan_t plan = { (size_t)io_size, 1 };
+      size_t num_read_blocks = 0;
+      if (mpi::memory_budget() > 0)
+        {
+          hsize_t num_blocks = 0; uint64_t data_bytes = 0;
+          projection_read_size(all_comm, file_name, src_pop_name, dst_pop_name, attr_namespaces,
+                               num_blocks, data_bytes);
+          if (offset < num_blocks)
+            {
+              num_read_blocks = num_blocks - offset;
+              if (numitems > 0)
+                {
+                  num_read_blocks = min(num_read_blocks, numitems * size);
+                }
+              data_bytes = (uint64_t)((double)data_bytes * num_read_blocks / num_blocks);
+            }
+          plan = mpi::plan_read(data_bytes, num_read_blocks, size, io_size, 3.0, 2.0);
+          mpi::MPI_DEBUG(all_comm, "scatter_read_projection: ", src_pop_name, " -> ", dst_pop_name,
+                         ": reading ", num_read_blocks, " blocks with ", plan.io_size,
+                         " I/O ranks in ", plan.rounds, " rounds");
+        }
+
+      mpi::memory_scope edge_map_memory("scatter_read_projection.edge_map");
+      if (plan.rounds <= 1)
+        {
+          scatter_read_projection_round(all_comm, plan.io_size, edge_map_type, file_name,
+                                        src_pop_name, dst_pop_name, src_start, dst_start,
+                                        attr_namespaces, node_rank_map, pop_search_ranges, pop_pairs,
+                                        prj_edge_map, edge_attr_names,
+                                        local_num_nodes, local_num_edges, total_num_edges,
+                                        total_read_blocks, offset, numitems * size, edge_filter, pool);
+          edge_map_memory.set(data::edge_map_bytes(prj_edge_map));
+        }
+      else
+        {
+          const size_t round_blocks = (num_read_blocks + plan.rounds - 1) / plan.rounds;
+          total_read_blocks = 0;
+          for (size_t block = 0; block < num_read_blocks; block += round_blocks)
+            {
+              hsize_t round_read_blocks = 0;
+              scatter_read_projection_round(all_comm, plan.io_size, edge_map_type, file_name,
+                                            src_pop_name, dst_pop_name, src_start, dst_start,
+                                            attr_namespaces, node_rank_map, pop_search_ranges, pop_pairs,
+                                            prj_edge_map, edge_attr_names,
+                                            local_num_nodes, local_num_edges, total_num_edges,
+                                            round_read_blocks, offset + block,
+                                            min(round_blocks, num_read_blocks - block), edge_filter, pool);
+              total_read_blocks += round_read_blocks;
+              edge_map_memory.set(data::edge_map_bytes(prj_edge_map));
+            }
+        }
+
+      if (!attr_namespaces.empty())
+        {
+          vector<char> sendbuf; uint32_t sendbuf_size=0;
+          if (rank == 0)
+            {
+              data::serialize_data(edge_attr_names, sendbuf);
+              sendbuf_size = sendbuf.size();
+            }
+
+          throw_assert_nomsg(MPI_Barrier(all_comm) == MPI_SUCCESS);
+          throw_assert_nomsg(MPI_Bcast(&sendbuf_size, 1, MPI_UINT32_T, 0, all_comm) == MPI_SUCCESS);
+          sendbuf.resize(sendbuf_size);
+          throw_assert_nomsg(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, all_comm) == MPI_SUCCESS);
             
-          }
-      }
+          if (rank != 0)
+            {
+              data::deserialize_data(sendbuf, edge_attr_names);
+            }
+          edge_attr_names_vector.push_back(edge_attr_names);
+        }
 
       
       mpi::MPI_DEBUG(all_comm, "scatter_read_projection: unpacked ", local_num_edges,
                      " edges for projection ", src_pop_name, " -> ", dst_pop_name);
       
-      prj_vector.push_back(prj_edge_map);
+      prj_vector.push_back(std::move(prj_edge_map));
 
       return 0;
     }
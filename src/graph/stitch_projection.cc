@@ -0,0 +1,239 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_projection.cc
+///
+///  Combines the edges of a projection in part files into one projection.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "stitch_projection.hh"
+#include "stitch_datasets.hh"
+#include "path_names.hh"
+#include "exists_dataset.hh"
+#include "group_contents.hh"
+#include "dataset_num_elements.hh"
+#include "file_access.hh"
+#include "serialize_data.hh"
+#include "mpi_trace.hh"
+#include "throw_assert.hh"
+
+#include <hdf5.h>
+#include <mpi.h>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    void stitch_projection
+    (
+     MPI_Comm              comm,
+     const string&         file_name,
+     const vector<string>& part_file_names,
+     const string&         src_pop_name,
+     const string&         dst_pop_name,
+     const bool            copy_parts
+     )
+    {
+      mpi::trace_scope trace_total("stitch_projection");
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      const size_t num_parts = part_file_names.size();
+      const string prj_prefix = hdf5::projection_prefix(src_pop_name, dst_pop_name);
+      const string dst_blk_idx_path =
+        hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::DST_BLK_IDX);
+      const string dst_blk_ptr_path =
+        hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::DST_BLK_PTR);
+      const string dst_ptr_path =
+        hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::DST_PTR);
+      const string src_idx_path =
+        hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::SRC_IDX);
+
+      // numbers of blocks, destinations and edges in each part, and the
+      // paths of the edge attributes
+      tuple< vector<hsize_t>, vector<hsize_t>, vector<hsize_t>, vector<string> > prj_parts;
+      vector<hsize_t>& part_num_blocks = get<0>(prj_parts);
+      vector<hsize_t>& part_num_dests  = get<1>(prj_parts);
+      vector<hsize_t>& part_num_edges  = get<2>(prj_parts);
+      vector<string>&  edge_attr_paths = get<3>(prj_parts);
+      if (rank == 0)
+        {
+          part_num_blocks.resize(num_parts, 0);
+          part_num_dests.resize(num_parts, 0);
+          part_num_edges.resize(num_parts, 0);
+
+          bool has_edges = false;
+          vector<hid_t> edge_attr_ftypes;
+          for (size_t p = 0; p < num_parts; p++)
+            {
+              hid_t part_file = H5Fopen(part_file_names[p].c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+              throw_assert(part_file >= 0,
+                           "stitch_projection: unable to open file " << part_file_names[p]);
+              if (!(hdf5::exists_dataset (part_file, dst_blk_ptr_path) > 0))
+                {
+                  throw_assert(H5Fclose(part_file) >= 0,
+                               "stitch_projection: unable to close file " << part_file_names[p]);
+                  continue;
+                }
+
+              const hsize_t num_blocks = hdf5::dataset_num_elements(part_file, dst_blk_idx_path);
+              const hsize_t num_blk_ptrs = hdf5::dataset_num_elements(part_file, dst_blk_ptr_path);
+              const hsize_t num_dst_ptrs = hdf5::dataset_num_elements(part_file, dst_ptr_path);
+              const hsize_t num_edges = hdf5::dataset_num_elements(part_file, src_idx_path);
+              throw_assert((num_blocks > 0) && (num_blk_ptrs == num_blocks+1) && (num_dst_ptrs > 1),
+                           "stitch_projection: invalid projection " << src_pop_name << " -> " <<
+                           dst_pop_name << " in " << part_file_names[p]);
+              part_num_blocks[p] = num_blocks;
+              part_num_dests[p]  = num_dst_ptrs - 1;
+              part_num_edges[p]  = num_edges;
+
+              vector<string> name_spaces, part_edge_attr_paths;
+              vector<hid_t> part_edge_attr_ftypes;
+              throw_assert(hdf5::group_contents(MPI_COMM_SELF, part_file, prj_prefix, name_spaces) >= 0,
+                           "stitch_projection: unable to read projection " << prj_prefix <<
+                           " of " << part_file_names[p]);
+              for (const string& name_space : name_spaces)
+                {
+                  if (name_space == hdf5::EDGES)
+                    {
+                      continue;
+                    }
+                  vector<string> attr_names;
+                  const string attr_prefix =
+                    hdf5::edge_attribute_prefix(src_pop_name, dst_pop_name, name_space);
+                  throw_assert(hdf5::group_contents(MPI_COMM_SELF, part_file, attr_prefix, attr_names) >= 0,
+                               "stitch_projection: unable to read namespace " << attr_prefix <<
+                               " of " << part_file_names[p]);
+                  for (const string& attr_name : attr_names)
+                    {
+                      const string path =
+                        hdf5::edge_attribute_path(src_pop_name, dst_pop_name, name_space, attr_name);
+                      throw_assert(hdf5::dataset_num_elements(part_file, path) == num_edges,
+                                   "stitch_projection: edge attribute " << path << " of " <<
+                                   part_file_names[p] << " does not have a value for each edge");
+                      hid_t dset = H5Dopen2(part_file, path.c_str(), H5P_DEFAULT);
+                      throw_assert(dset >= 0,
+                                   "stitch_projection: unable to open dataset " << path);
+                      hid_t ftype = H5Dget_type(dset);
+                      throw_assert(ftype >= 0, "stitch_projection: error in H5Dget_type");
+                      throw_assert(H5Dclose(dset) >= 0, "stitch_projection: error in H5Dclose");
+                      part_edge_attr_paths.push_back(path);
+                      part_edge_attr_ftypes.push_back(ftype);
+                    }
+                }
+              throw_assert(H5Fclose(part_file) >= 0,
+                           "stitch_projection: unable to close file " << part_file_names[p]);
+
+              // the edge attributes of all parts are concatenated, and
+              // so must be the same
+              if (!has_edges)
+                {
+                  edge_attr_paths = part_edge_attr_paths;
+                  edge_attr_ftypes = part_edge_attr_ftypes;
+                  has_edges = true;
+                }
+              else
+                {
+                  throw_assert(part_edge_attr_paths == edge_attr_paths,
+                               "stitch_projection: edge attributes of " << part_file_names[p] <<
+                               " differ from those of the preceding parts");
+                  for (size_t i=0; i<part_edge_attr_ftypes.size(); i++)
+                    {
+                      throw_assert(H5Tequal(part_edge_attr_ftypes[i], edge_attr_ftypes[i]) > 0,
+                                   "stitch_projection: edge attribute " << edge_attr_paths[i] <<
+                                   " has a different type in " << part_file_names[p]);
+                      throw_assert(H5Tclose(part_edge_attr_ftypes[i]) >= 0,
+                                   "stitch_projection: error in H5Tclose");
+                    }
+                }
+            }
+
+          hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+          throw_assert(file >= 0,
+                       "stitch_projection: unable to open file " << file_name);
+          hdf5::remove_stitched_group(file, prj_prefix);
+          if (has_edges)
+            {
+              hdf5::create_stitched_dataset(file, file_name, dst_blk_idx_path, NODE_IDX_H5_FILE_T,
+                                            part_file_names, part_num_blocks, copy_parts);
+              hdf5::create_stitched_pointer_dataset(file, dst_blk_ptr_path, DST_BLK_PTR_H5_FILE_T,
+                                                    part_num_blocks);
+              hdf5::create_stitched_pointer_dataset(file, dst_ptr_path, DST_PTR_H5_FILE_T,
+                                                    part_num_dests);
+              hdf5::create_stitched_dataset(file, file_name, src_idx_path, NODE_IDX_H5_FILE_T,
+                                            part_file_names, part_num_edges, copy_parts);
+              for (size_t i=0; i<edge_attr_paths.size(); i++)
+                {
+                  hdf5::create_stitched_dataset(file, file_name, edge_attr_paths[i], edge_attr_ftypes[i],
+                                                part_file_names, part_num_edges, copy_parts);
+                  throw_assert(H5Tclose(edge_attr_ftypes[i]) >= 0,
+                               "stitch_projection: error in H5Tclose");
+                }
+            }
+          throw_assert(H5Fclose(file) >= 0,
+                       "stitch_projection: unable to close file " << file_name);
+        }
+
+      {
+        vector<char> sendbuf; size_t sendbuf_size=0;
+        if (rank == 0)
+          {
+            data::serialize_data(prj_parts, sendbuf);
+            sendbuf_size = sendbuf.size();
+          }
+
+        throw_assert(MPI_Bcast(&sendbuf_size, 1, MPI_SIZE_T, 0, comm) == MPI_SUCCESS,
+                     "stitch_projection: error in MPI_Bcast");
+        sendbuf.resize(sendbuf_size);
+        throw_assert(MPI_Bcast(&sendbuf[0], sendbuf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS,
+                     "stitch_projection: error in MPI_Bcast");
+
+        if (rank != 0)
+          {
+            data::deserialize_data(sendbuf, prj_parts);
+          }
+      }
+
+      hsize_t total_num_edges = 0;
+      for (const hsize_t num_edges : part_num_edges)
+        {
+          total_num_edges += num_edges;
+        }
+      if (total_num_edges > 0)
+        {
+          // destination block pointers are offset by the number of
+          // destinations in the preceding parts, and destination
+          // pointers by the number of edges
+          vector<uint64_t> blk_ptr_offsets(num_parts, 0), dst_ptr_offsets(num_parts, 0);
+          for (size_t p = 1; p < num_parts; p++)
+            {
+              blk_ptr_offsets[p] = blk_ptr_offsets[p-1] + part_num_dests[p-1];
+              dst_ptr_offsets[p] = dst_ptr_offsets[p-1] + part_num_edges[p-1];
+            }
+
+          hid_t file = hdf5::open_file(comm, file_name, true, true);
+          hdf5::write_stitched_pointers(comm, file, dst_blk_ptr_path, part_file_names,
+                                        part_num_blocks, blk_ptr_offsets);
+          hdf5::write_stitched_pointers(comm, file, dst_ptr_path, part_file_names,
+                                        part_num_dests, dst_ptr_offsets);
+          throw_assert(hdf5::close_file(file) >= 0,
+                       "stitch_projection: unable to close file " << file_name);
+        }
+      trace_total.add_items(total_num_edges);
+
+      throw_assert(MPI_Barrier(comm) == MPI_SUCCESS,
+                   "stitch_projection: error in MPI_Barrier");
+    }
+
+  }
+}
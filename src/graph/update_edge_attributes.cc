@@ -0,0 +1,485 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file update_edge_attributes.cc
+///
+///  Functions for overwriting the edge attributes of an existing
+///  projection in place, without rewriting its DBS (Destination Block
+///  Sparse) arrays.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "attr_map.hh"
+#include "cell_populations.hh"
+#include "update_edge_attributes.hh"
+#include "hdf5_edge_attributes.hh"
+#include "infer_datatype.hh"
+#include "read_projection_datasets.hh"
+#include "dataset_num_elements.hh"
+#include "exists_dataset.hh"
+#include "file_access.hh"
+#include "path_names.hh"
+#include "write_template.hh"
+#include "alltoallv_template.hh"
+#include "serialize_data.hh"
+#include "mpi_debug.hh"
+#include "mpi_trace.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace neuroh5::data;
+using namespace std;
+
+namespace neuroh5
+{
+  namespace graph
+  {
+
+    /// Namespace, type index (as in data::AttrMap) and name of an edge
+    /// attribute dataset.
+    typedef tuple<string, size_t, string> edge_attr_dataset_t;
+
+    /// A run of consecutive edges of a destination in the file: the
+    /// file position and number of the edges, and the offset of the
+    /// first edge in the adjacency vector of the destination.
+    struct edge_segment_t
+    {
+      DST_PTR_T  start;
+      DST_PTR_T  count;
+      NODE_IDX_T dst;
+      size_t     offset;
+
+      bool operator< (const edge_segment_t& other) const
+      {
+        return start < other.start;
+      }
+    };
+
+    template <class T>
+    static void pack_rank_vectors (const vector< vector<T> >& rank_values,
+                                   vector<int>& sendcounts, vector<int>& sdispls,
+                                   vector<T>& sendbuf)
+    {
+      const size_t size = rank_values.size();
+      sendcounts.assign(size, 0);
+      sdispls.assign(size, 0);
+      for (size_t r = 0; r < size; r++)
+        {
+          sdispls[r] = sendbuf.size();
+          sendcounts[r] = rank_values[r].size();
+          sendbuf.insert(sendbuf.end(), rank_values[r].begin(), rank_values[r].end());
+        }
+    }
+
+    /*****************************************************************************
+     * Determines the file positions of the edges of the destinations in
+     * edge_map. The destination pointers of the projection are read in
+     * blocks by all ranks and distributed by destination (dst % size);
+     * each rank then requests the edge ranges of its destinations from
+     * the ranks that hold them.
+     *****************************************************************************/
+    static void edge_map_segments (MPI_Comm comm,
+                                   const string& file_name,
+                                   const string& src_pop_name,
+                                   const string& dst_pop_name,
+                                   const NODE_IDX_T dst_start,
+                                   const edge_map_t& edge_map,
+                                   vector<edge_segment_t>& segments)
+    {
+      int ssize, srank;
+      throw_assert_nomsg(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &srank) == MPI_SUCCESS);
+      const size_t size = ssize;
+
+      DST_BLK_PTR_T block_base;
+      DST_PTR_T edge_base;
+      vector<DST_BLK_PTR_T> dst_blk_ptr;
+      vector<NODE_IDX_T> dst_idx;
+      vector<DST_PTR_T> dst_ptr;
+      throw_assert(hdf5::read_projection_node_datasets(comm, file_name, src_pop_name, dst_pop_name,
+                                                       block_base, edge_base,
+                                                       dst_blk_ptr, dst_idx, dst_ptr) >= 0,
+                   "update_edge_attributes: error in read_projection_node_datasets");
+
+      // (destination, start, count) of each destination with edges in
+      // the blocks read by this rank
+      vector< vector<DST_PTR_T> > rank_entries(size);
+      if (dst_blk_ptr.size() > 0)
+        {
+          const size_t dst_ptr_size = dst_ptr.size();
+          for (size_t b = 0; b < dst_blk_ptr.size()-1; ++b)
+            {
+              const size_t low_dst_ptr = dst_blk_ptr[b], high_dst_ptr = dst_blk_ptr[b+1];
+              const NODE_IDX_T dst_base = dst_idx[b];
+              for (size_t i = low_dst_ptr, ii = 0; i < high_dst_ptr; ++i, ++ii)
+                {
+                  if (i < dst_ptr_size-1)
+                    {
+                      const DST_PTR_T count = dst_ptr[i+1] - dst_ptr[i];
+                      if (count > 0)
+                        {
+                          const NODE_IDX_T dst = dst_base + ii + dst_start;
+                          vector<DST_PTR_T>& entries = rank_entries[dst % size];
+                          entries.push_back(dst);
+                          entries.push_back(dst_ptr[i]);
+                          entries.push_back(count);
+                        }
+                    }
+                }
+            }
+        }
+
+      map<NODE_IDX_T, vector< pair<DST_PTR_T, DST_PTR_T> > > dst_ranges;
+      {
+        vector<DST_PTR_T> sendbuf, recvbuf;
+        vector<int> sendcounts, sdispls, recvcounts, rdispls;
+        pack_rank_vectors(rank_entries, sendcounts, sdispls, sendbuf);
+        throw_assert_nomsg(mpi::alltoallv_vector<DST_PTR_T>(comm, MPI_UINT64_T, sendcounts, sdispls, sendbuf,
+                                                            recvcounts, rdispls, recvbuf) >= 0);
+        for (size_t i = 0; i+2 < recvbuf.size(); i += 3)
+          {
+            dst_ranges[recvbuf[i]].push_back(make_pair(recvbuf[i+1], recvbuf[i+2]));
+          }
+        // a destination may occur in several blocks, e.g. after appends
+        for (auto& it : dst_ranges)
+          {
+            sort(it.second.begin(), it.second.end());
+          }
+      }
+
+      // request the edge ranges of the local destinations
+      vector< vector<DST_PTR_T> > rank_requests(size);
+      for (auto const& it : edge_map)
+        {
+          if (get<0>(it.second).size() > 0)
+            {
+              rank_requests[it.first % size].push_back(it.first);
+            }
+        }
+
+      vector<DST_PTR_T> requests;
+      vector<int> request_counts, request_displs;
+      {
+        vector<DST_PTR_T> sendbuf;
+        vector<int> sendcounts, sdispls;
+        pack_rank_vectors(rank_requests, sendcounts, sdispls, sendbuf);
+        throw_assert_nomsg(mpi::alltoallv_vector<DST_PTR_T>(comm, MPI_UINT64_T, sendcounts, sdispls, sendbuf,
+                                                            request_counts, request_displs, requests) >= 0);
+      }
+
+      // reply with the number of ranges of each requested destination,
+      // followed by the (start, count) pairs
+      vector< vector<DST_PTR_T> > rank_replies(size);
+      for (size_t r = 0; r < size; r++)
+        {
+          for (int i = request_displs[r]; i < request_displs[r] + request_counts[r]; i++)
+            {
+              vector<DST_PTR_T>& reply = rank_replies[r];
+              auto it = dst_ranges.find(requests[i]);
+              if (it == dst_ranges.end())
+                {
+                  reply.push_back(0);
+                }
+              else
+                {
+                  reply.push_back(it->second.size());
+                  for (auto const& range : it->second)
+                    {
+                      reply.push_back(range.first);
+                      reply.push_back(range.second);
+                    }
+                }
+            }
+        }
+
+      vector<DST_PTR_T> replies;
+      vector<int> reply_counts, reply_displs;
+      {
+        vector<DST_PTR_T> sendbuf;
+        vector<int> sendcounts, sdispls;
+        pack_rank_vectors(rank_replies, sendcounts, sdispls, sendbuf);
+        throw_assert_nomsg(mpi::alltoallv_vector<DST_PTR_T>(comm, MPI_UINT64_T, sendcounts, sdispls, sendbuf,
+                                                            reply_counts, reply_displs, replies) >= 0);
+      }
+
+      for (size_t r = 0; r < size; r++)
+        {
+          size_t pos = reply_displs[r];
+          for (const NODE_IDX_T dst : rank_requests[r])
+            {
+              const size_t num_ranges = replies[pos++];
+              size_t offset = 0;
+              for (size_t k = 0; k < num_ranges; k++)
+                {
+                  edge_segment_t segment;
+                  segment.start  = replies[pos++];
+                  segment.count  = replies[pos++];
+                  segment.dst    = dst;
+                  segment.offset = offset;
+                  segments.push_back(segment);
+                  offset += segment.count;
+                }
+              const size_t num_edges = get<0>(edge_map.find(dst)->second).size();
+              throw_assert(offset == num_edges,
+                           "update_edge_attributes: destination " << dst << " has " << num_edges <<
+                           " edges, but " << offset << " edges in projection " <<
+                           src_pop_name << " -> " << dst_pop_name);
+            }
+        }
+
+      sort(segments.begin(), segments.end());
+    }
+
+    template <class T>
+    static void local_edge_attr_datasets (const size_t type_index,
+                                          const map <string, pair <size_t, AttrIndex > >& edge_attr_index,
+                                          vector<edge_attr_dataset_t>& datasets)
+    {
+      for (auto const& it : edge_attr_index)
+        {
+          for (const string& attr_name : it.second.second.attr_names<T>())
+            {
+              datasets.push_back(make_tuple(it.first, type_index, attr_name));
+            }
+        }
+    }
+
+    /*****************************************************************************
+     * Forms the union of the attribute datasets of all ranks, so that
+     * ranks without edges take part in the creation of and the
+     * collective writes to each dataset.
+     *****************************************************************************/
+    static void all_edge_attr_datasets (MPI_Comm comm,
+                                        const vector<edge_attr_dataset_t>& local_datasets,
+                                        vector<edge_attr_dataset_t>& datasets)
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+
+      vector<char> sendbuf;
+      data::serialize_data(local_datasets, sendbuf);
+      int sendcount = sendbuf.size();
+
+      vector<int> recvcounts(size, 0), rdispls(size, 0);
+      throw_assert_nomsg(MPI_Allgather(&sendcount, 1, MPI_INT, recvcounts.data(), 1, MPI_INT, comm) == MPI_SUCCESS);
+      for (int r = 1; r < size; r++)
+        {
+          rdispls[r] = rdispls[r-1] + recvcounts[r-1];
+        }
+      vector<char> recvbuf(rdispls[size-1] + recvcounts[size-1]);
+      throw_assert_nomsg(MPI_Allgatherv(sendbuf.data(), sendcount, MPI_CHAR,
+                                        recvbuf.data(), recvcounts.data(), rdispls.data(), MPI_CHAR,
+                                        comm) == MPI_SUCCESS);
+
+      set<edge_attr_dataset_t> dataset_set;
+      for (int r = 0; r < size; r++)
+        {
+          vector<edge_attr_dataset_t> rank_datasets;
+          data::deserialize_data(vector<char>(recvbuf.begin()+rdispls[r],
+                                              recvbuf.begin()+rdispls[r]+recvcounts[r]),
+                                 rank_datasets);
+          dataset_set.insert(rank_datasets.begin(), rank_datasets.end());
+        }
+      datasets.assign(dataset_set.begin(), dataset_set.end());
+    }
+
+    /*****************************************************************************
+     * Writes the values of one attribute to the file positions of the
+     * edge segments, creating the attribute dataset if necessary
+     *****************************************************************************/
+    template <class T>
+    static void update_edge_attribute (MPI_Comm comm,
+                                       hid_t file,
+                                       const string& src_pop_name,
+                                       const string& dst_pop_name,
+                                       const string& attr_namespace,
+                                       const string& attr_name,
+                                       const map <string, pair <size_t, AttrIndex > >& edge_attr_index,
+                                       const edge_map_t& edge_map,
+                                       const vector<edge_segment_t>& segments,
+                                       const hsize_t total_num_edges,
+                                       const size_t chunk_size)
+    {
+      mpi::trace_scope trace("update_edge_attributes.write");
+
+      T dummy;
+      hid_t ftype = infer_datatype(dummy);
+      throw_assert(ftype >= 0, "update_edge_attributes: error in infer_datatype");
+      hid_t mtype = H5Tget_native_type(ftype, H5T_DIR_ASCEND);
+      throw_assert(mtype >= 0, "update_edge_attributes: error in H5Tget_native_type");
+
+      const string path = hdf5::edge_attribute_path(src_pop_name, dst_pop_name, attr_namespace, attr_name);
+      if (!(hdf5::exists_dataset (file, path) > 0))
+        {
+          hdf5::create_edge_attribute_datasets(file, src_pop_name, dst_pop_name,
+                                               attr_namespace, attr_name,
+                                               ftype, chunk_size);
+          hid_t dset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+          throw_assert(dset >= 0, "update_edge_attributes: unable to open dataset " << path);
+          throw_assert(H5Dset_extent(dset, &total_num_edges) >= 0,
+                       "update_edge_attributes: unable to set extent of dataset " << path);
+          throw_assert(H5Dclose(dset) >= 0, "update_edge_attributes: error in H5Dclose");
+        }
+      throw_assert(hdf5::dataset_num_elements(file, path) == total_num_edges,
+                   "update_edge_attributes: dataset " << path << " does not have one value per edge");
+
+      vector<T> values;
+      vector< pair<hsize_t,hsize_t> > ranges;
+      if (segments.size() > 0)
+        {
+          auto ns_it = edge_attr_index.find(attr_namespace);
+          const vector<string> attr_names = (ns_it != edge_attr_index.end()) ?
+            ns_it->second.second.attr_names<T>() : vector<string>();
+          throw_assert(find(attr_names.begin(), attr_names.end(), attr_name) != attr_names.end(),
+                       "update_edge_attributes: attribute " << attr_namespace << "/" << attr_name <<
+                       " is missing from the edges of this rank");
+          const size_t ns_pos = ns_it->second.first;
+          const size_t attr_pos = ns_it->second.second.attr_index<T>(attr_name);
+
+          for (const edge_segment_t& segment : segments)
+            {
+              const edge_tuple_t& et = edge_map.find(segment.dst)->second;
+              const vector<AttrVal>& edge_attr_values = get<1>(et);
+              throw_assert(ns_pos < edge_attr_values.size(),
+                           "update_edge_attributes: missing namespace " << attr_namespace <<
+                           " in the edges of destination " << segment.dst);
+              const vector<T>& attr_values = edge_attr_values[ns_pos].attr_vec<T>(attr_pos);
+              throw_assert(attr_values.size() == get<0>(et).size(),
+                           "update_edge_attributes: attribute " << attr_namespace << "/" << attr_name <<
+                           " of destination " << segment.dst << " does not have one value per edge");
+              values.insert(values.end(),
+                            attr_values.begin() + segment.offset,
+                            attr_values.begin() + segment.offset + segment.count);
+              if ((ranges.size() > 0) && (ranges.back().first + ranges.back().second == segment.start))
+                {
+                  ranges.back().second += segment.count;
+                }
+              else
+                {
+                  ranges.push_back(make_pair(segment.start, segment.count));
+                }
+            }
+        }
+
+      /* Create property list for collective dataset write. */
+      hid_t wapl = H5Pcreate (H5P_DATASET_XFER);
+      throw_assert(H5Pset_dxpl_mpio (wapl, H5FD_MPIO_COLLECTIVE) >= 0,
+                   "update_edge_attributes: error in H5Pset_dxpl_mpio");
+
+      throw_assert(hdf5::write_selection<T>(file, path, mtype, ranges, values, wapl) >= 0,
+                   "update_edge_attributes: error writing dataset " << path);
+      trace.add_items(values.size());
+      trace.add_bytes(values.size() * sizeof(T));
+
+      throw_assert(H5Pclose(wapl) >= 0, "update_edge_attributes: error in H5Pclose");
+      throw_assert(H5Tclose(mtype) >= 0, "update_edge_attributes: error in H5Tclose");
+    }
+
+
+    int update_edge_attributes
+    (
+     MPI_Comm                 comm,
+     const string&            file_name,
+     const string&            src_pop_name,
+     const string&            dst_pop_name,
+     const map <string, pair <size_t, AttrIndex > >& edge_attr_index,
+     const edge_map_t&        edge_map,
+     const size_t             chunk_size
+     )
+    {
+      mpi::trace_scope trace_total("update_edge_attributes");
+
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      size_t total_num_nodes;
+      throw_assert_nomsg(cell::read_population_labels(comm, file_name, pop_labels) >= 0);
+      throw_assert_nomsg(cell::read_population_ranges(comm, file_name, pop_ranges, total_num_nodes) >= 0);
+
+      bool dst_pop_set = false;
+      NODE_IDX_T dst_start = 0;
+      for (auto const& label : pop_labels)
+        {
+          if (label.second == dst_pop_name)
+            {
+              dst_start = pop_ranges[label.first].start;
+              dst_pop_set = true;
+            }
+        }
+      throw_assert(dst_pop_set,
+                   "update_edge_attributes: population " << dst_pop_name << " not found");
+
+      vector<edge_segment_t> segments;
+      {
+        mpi::trace_scope trace("update_edge_attributes.locate");
+        edge_map_segments(comm, file_name, src_pop_name, dst_pop_name, dst_start, edge_map, segments);
+        trace.add_items(segments.size());
+      }
+
+      vector<edge_attr_dataset_t> local_datasets, datasets;
+      local_edge_attr_datasets<float>(AttrMap::attr_index_float, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<uint8_t>(AttrMap::attr_index_uint8, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<int8_t>(AttrMap::attr_index_int8, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<uint16_t>(AttrMap::attr_index_uint16, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<int16_t>(AttrMap::attr_index_int16, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<uint32_t>(AttrMap::attr_index_uint32, edge_attr_index, local_datasets);
+      local_edge_attr_datasets<int32_t>(AttrMap::attr_index_int32, edge_attr_index, local_datasets);
+      all_edge_attr_datasets(comm, local_datasets, datasets);
+
+      hid_t file = hdf5::open_file(comm, file_name, true, true);
+      const hsize_t total_num_edges = hdf5::dataset_num_elements
+        (file, hdf5::edge_attribute_path(src_pop_name, dst_pop_name, hdf5::EDGES, hdf5::SRC_IDX));
+
+      for (auto const& dataset : datasets)
+        {
+          const string& attr_namespace = get<0>(dataset);
+          const string& attr_name = get<2>(dataset);
+          switch (get<1>(dataset))
+            {
+            case AttrMap::attr_index_float:
+              update_edge_attribute<float>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                           edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_uint8:
+              update_edge_attribute<uint8_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                             edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_int8:
+              update_edge_attribute<int8_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                            edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_uint16:
+              update_edge_attribute<uint16_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                              edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_int16:
+              update_edge_attribute<int16_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                             edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_uint32:
+              update_edge_attribute<uint32_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                              edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            case AttrMap::attr_index_int32:
+              update_edge_attribute<int32_t>(comm, file, src_pop_name, dst_pop_name, attr_namespace, attr_name,
+                                             edge_attr_index, edge_map, segments, total_num_edges, chunk_size);
+              break;
+            default:
+              throw_assert(false, "update_edge_attributes: unknown attribute type");
+            }
+        }
+
+      throw_assert(hdf5::close_file(file) >= 0, "update_edge_attributes: error in H5Fclose");
+      throw_assert_nomsg(MPI_Barrier(comm) == MPI_SUCCESS);
+
+      return 0;
+    }
+
+  }
+}
@@ -17,6 +17,7 @@
 #include "write_projection.hh"
 #include "path_names.hh"
 #include "sort_permutation.hh"
+#include "sample_sort.hh"
 #include "serialize_edge.hh"
 #include "throw_assert.hh"
 #include "debug.hh"
@@ -32,21 +33,6 @@ namespace neuroh5
   namespace graph
   {
 
-    // Assign each node to a rank 
-    static void compute_node_rank_map
-    (
-     size_t num_ranks,
-     size_t num_nodes,
-     map< NODE_IDX_T, rank_t > &node_rank_map
-     )
-    {
-      // round-robin node to rank assignment from file
-      for (size_t i = 0; i < num_nodes; i++)
-        {
-            node_rank_map.insert(make_pair(i, i%num_ranks));
-        }
-    }
-    
     int write_graph
     (
      MPI_Comm         all_comm,
@@ -121,12 +107,20 @@ namespace neuroh5
           MPI_Comm_split(all_comm,0,rank,&io_comm);
         }
       
-      // A vector that maps nodes to compute ranks
-      map< NODE_IDX_T, rank_t > node_rank_map;
-      compute_node_rank_map(io_size, total_num_nodes, node_rank_map);
+      // Assign contiguous ranges of destination indices to the I/O
+      // ranks, chosen by sampling the destination indices present in
+      // the input edge maps across all ranks
+      vector< NODE_IDX_T > node_splitters;
+      {
+        vector< NODE_IDX_T > local_node_index;
+        for (auto iter : input_edge_map)
+          {
+            local_node_index.push_back(iter.first);
+          }
+        mpi::sample_splitters(all_comm, local_node_index, io_size, node_splitters);
+      }
 
       // construct a map where each set of edges are arranged by destination I/O rank
-      auto compare_nodes = [](const NODE_IDX_T& a, const NODE_IDX_T& b) { return (a < b); };
       rank_edge_map_t rank_edge_map;
       for (auto iter : input_edge_map)
         {
@@ -148,7 +142,8 @@ namespace neuroh5
               adj_vector.push_back(src - src_start);
               num_edges++;
             }
-          vector<size_t> p = sort_permutation(adj_vector, compare_nodes);
+          vector<size_t> p;
+          mpi::radix_sort_permutation(adj_vector, p);
 
           apply_permutation_in_place(adj_vector, p);
 
@@ -192,9 +187,8 @@ namespace neuroh5
                 }
             }
           
-          auto it = node_rank_map.find(dst);
-          throw_assert_nomsg(it != node_rank_map.end());
-          size_t dst_rank = it->second;
+          size_t dst_rank = std::upper_bound(node_splitters.begin(), node_splitters.end(), dst) -
+            node_splitters.begin();
           edge_tuple_t& et1 = rank_edge_map[dst_rank][dst];
           vector<NODE_IDX_T> &src_vec = get<0>(et1);
           src_vec.insert(src_vec.end(),adj_vector.begin(),adj_vector.end());
@@ -0,0 +1,119 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file create_population_h5types.cc
+///
+///  Creates the population definitions of a NeuroH5 file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "create_population_h5types.hh"
+#include "path_names.hh"
+#include "throw_assert.hh"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    /// Writes a one-dimensional dataset of a committed compound type.
+    static void write_h5types_dataset (hid_t file, const string& path, hid_t ftype, hid_t mtype,
+                                       const size_t num_elems, const void* data)
+    {
+      hsize_t dims[1] = { (hsize_t)num_elems };
+      hid_t fspace = H5Screate_simple(1, dims, NULL);
+      throw_assert(fspace >= 0, "create_population_h5types: unable to create dataspace");
+      hid_t dset = H5Dcreate2(file, path.c_str(), ftype, fspace,
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(dset >= 0, "create_population_h5types: unable to create dataset " << path);
+      throw_assert(H5Dwrite(dset, mtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, data) >= 0,
+                   "create_population_h5types: unable to write dataset " << path);
+      throw_assert_nomsg(H5Dclose(dset) >= 0);
+      throw_assert_nomsg(H5Sclose(fspace) >= 0);
+    }
+
+    int create_population_h5types
+    (
+     hid_t                                        file,
+     const pop_label_map_t&                       pop_labels,
+     const pop_range_map_t&                       pop_ranges,
+     const set< pair<pop_t, pop_t> >&             pop_pairs
+     )
+    {
+      throw_assert(pop_labels.size() > 0, "create_population_h5types: no populations");
+      throw_assert(pop_pairs.size() > 0, "create_population_h5types: no population projections");
+
+      hid_t grp = H5Gcreate2(file, H5_TYPES.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(grp >= 0, "create_population_h5types: unable to create group " << H5_TYPES);
+      throw_assert_nomsg(H5Gclose(grp) >= 0);
+
+      // population label enumeration
+      hid_t label_type = H5Tenum_create(H5T_NATIVE_UINT16);
+      throw_assert_nomsg(label_type >= 0);
+      for (auto const& it : pop_labels)
+        {
+          const pop_t pop = it.first;
+          throw_assert(H5Tenum_insert(label_type, it.second.c_str(), &pop) >= 0,
+                       "create_population_h5types: unable to insert population label " << it.second);
+        }
+      throw_assert(H5Tcommit2(file, h5types_path_join(POP_LABELS).c_str(), label_type,
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT) >= 0,
+                   "create_population_h5types: unable to commit population label type");
+
+      // population ranges
+      hid_t range_type = H5Tcreate(H5T_COMPOUND, sizeof(pop_range_t));
+      throw_assert_nomsg(range_type >= 0);
+      throw_assert_nomsg(H5Tinsert(range_type, "Start", HOFFSET(pop_range_t, start), H5T_NATIVE_UINT64) >= 0);
+      throw_assert_nomsg(H5Tinsert(range_type, "Count", HOFFSET(pop_range_t, count), H5T_NATIVE_UINT32) >= 0);
+      throw_assert_nomsg(H5Tinsert(range_type, "Population", HOFFSET(pop_range_t, pop), label_type) >= 0);
+      throw_assert(H5Tcommit2(file, h5types_path_join(POP_RANGE).c_str(), range_type,
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT) >= 0,
+                   "create_population_h5types: unable to commit population range type");
+
+      vector<pop_range_t> range_vector;
+      for (auto const& it : pop_labels)
+        {
+          auto range_it = pop_ranges.find(it.first);
+          throw_assert(range_it != pop_ranges.end(),
+                       "create_population_h5types: no range for population " << it.second);
+          pop_range_t range = range_it->second;
+          range.pop = it.first;
+          range_vector.push_back(range);
+        }
+      write_h5types_dataset(file, h5types_path_join(POPULATIONS), range_type, range_type,
+                            range_vector.size(), range_vector.data());
+
+      // valid population projections
+      hid_t comb_type = H5Tcreate(H5T_COMPOUND, sizeof(pop_comb_t));
+      throw_assert_nomsg(comb_type >= 0);
+      throw_assert_nomsg(H5Tinsert(comb_type, "Source", HOFFSET(pop_comb_t, src), label_type) >= 0);
+      throw_assert_nomsg(H5Tinsert(comb_type, "Destination", HOFFSET(pop_comb_t, dst), label_type) >= 0);
+      throw_assert(H5Tcommit2(file, h5types_path_join(POP_PRJ_TYPE).c_str(), comb_type,
+                              H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT) >= 0,
+                   "create_population_h5types: unable to commit population projection type");
+
+      vector<pop_comb_t> comb_vector;
+      for (auto const& it : pop_pairs)
+        {
+          pop_comb_t comb;
+          comb.src = it.first;
+          comb.dst = it.second;
+          comb_vector.push_back(comb);
+        }
+      write_h5types_dataset(file, h5types_path_join(POP_COMBS), comb_type, comb_type,
+                            comb_vector.size(), comb_vector.data());
+
+      throw_assert_nomsg(H5Tclose(comb_type) >= 0);
+      throw_assert_nomsg(H5Tclose(range_type) >= 0);
+      throw_assert_nomsg(H5Tclose(label_type) >= 0);
+
+      return 0;
+    }
+
+  }
+}
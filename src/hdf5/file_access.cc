@@ -1,7 +1,9 @@
 
 #include <hdf5.h>
+#include <mpi.h>
 #include <string>
 #include <vector>
+#include "file_access.hh"
 #include "throw_assert.hh"
 
 namespace neuroh5
@@ -16,9 +18,9 @@ namespace neuroh5
     (
      MPI_Comm comm,
      const std::string& file_name,
-     const bool collective = false,
-     const bool rdwr = false,
-     const size_t cache_size = 1*1024*1024
+     const bool collective,
+     const bool rdwr,
+     const size_t cache_size
      )
     {
       hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
@@ -39,8 +41,15 @@ namespace neuroh5
                    "error in H5Pset_cache");
 
       
+      // files opened for writing keep the MPI-IO driver, since the
+      // writers obtain their communicator from the file access plist
+      if (collective && !rdwr && is_serial_comm(comm))
+        {
+          throw_assert_nomsg(H5Pset_fapl_sec2(fapl) >= 0);
+          throw_assert_nomsg(H5Pset_sieve_buf_size(fapl, SERIAL_SIEVE_BUF_SIZE) >= 0);
+        }
 #ifdef HDF5_IS_PARALLEL
-      if (collective)
+      else if (collective)
         {
           throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
         }
@@ -74,6 +83,65 @@ namespace neuroh5
       return status;
     }
 
+    bool is_serial_comm
+    (
+     MPI_Comm comm
+     )
+    {
+      int size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      return size == 1;
+    }
+
+    hid_t read_access_plist
+    (
+     MPI_Comm comm
+     )
+    {
+      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
+      throw_assert_nomsg(fapl >= 0);
+
+      if (is_serial_comm(comm))
+        {
+          throw_assert_nomsg(H5Pset_fapl_sec2(fapl) >= 0);
+          throw_assert_nomsg(H5Pset_sieve_buf_size(fapl, SERIAL_SIEVE_BUF_SIZE) >= 0);
+          throw_assert_nomsg(H5Pset_meta_block_size(fapl, SERIAL_SIEVE_BUF_SIZE) >= 0);
+
+          int nelemts; size_t nslots, nbytes; double w0;
+          throw_assert(H5Pget_cache(fapl, &nelemts, &nslots, &nbytes, &w0) >= 0,
+                       "error in H5Pget_cache");
+          /* a prime number of slots, about 100 times the number of
+             64 KB chunks that fit in the cache */
+          nslots = 102407; nbytes = SERIAL_CHUNK_CACHE_SIZE; w0 = 1.;
+          throw_assert(H5Pset_cache(fapl, nelemts, nslots, nbytes, w0) >= 0,
+                       "error in H5Pset_cache");
+        }
+#ifdef HDF5_IS_PARALLEL
+      else
+        {
+          throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
+        }
+#endif
+      return fapl;
+    }
+
+    hid_t read_transfer_plist
+    (
+     MPI_Comm comm
+     )
+    {
+      hid_t rapl = H5Pcreate(H5P_DATASET_XFER);
+      throw_assert_nomsg(rapl >= 0);
+#ifdef HDF5_IS_PARALLEL
+      if (!is_serial_comm(comm))
+        {
+          throw_assert(H5Pset_dxpl_mpio(rapl, H5FD_MPIO_COLLECTIVE) >= 0,
+                       "error in H5Pset_dxpl_mpio");
+        }
+#endif
+      return rapl;
+    }
+
     int what_is_open(hid_t fid, int mask) 
     {
       ssize_t cnt;
@@ -0,0 +1,105 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file group_flag.cc
+///
+///  Boolean flags stored as HDF5 attributes of a group.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "hdf5.h"
+#include <cstdint>
+#include <string>
+
+#include "exists_group.hh"
+#include "group_flag.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    bool get_group_flag
+    (
+     hid_t  loc,
+     const string& path,
+     const string& name
+     )
+    {
+      if (!(exists_group (loc, path) > 0))
+        {
+          return false;
+        }
+
+      htri_t exists = H5Aexists_by_name(loc, path.c_str(), name.c_str(), H5P_DEFAULT);
+      throw_assert(exists >= 0,
+                   "get_group_flag: error in H5Aexists_by_name for " << path << "/" << name);
+      if (exists == 0)
+        {
+          return false;
+        }
+
+      hid_t attr = H5Aopen_by_name(loc, path.c_str(), name.c_str(), H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(attr >= 0,
+                   "get_group_flag: unable to open attribute " << path << "/" << name);
+      uint8_t value = 0;
+      throw_assert(H5Aread(attr, H5T_NATIVE_UINT8, &value) >= 0,
+                   "get_group_flag: unable to read attribute " << path << "/" << name);
+      throw_assert(H5Aclose(attr) >= 0,
+                   "get_group_flag: error in H5Aclose");
+
+      return (value != 0);
+    }
+
+
+    herr_t set_group_flag
+    (
+     hid_t  loc,
+     const string& path,
+     const string& name
+     )
+    {
+      herr_t status = clear_group_flag(loc, path, name);
+      throw_assert(status >= 0,
+                   "set_group_flag: unable to remove attribute " << path << "/" << name);
+
+      hid_t space = H5Screate(H5S_SCALAR);
+      throw_assert(space >= 0,
+                   "set_group_flag: error in H5Screate");
+      hid_t attr = H5Acreate_by_name(loc, path.c_str(), name.c_str(), H5T_STD_U8LE, space,
+                                     H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+      throw_assert(attr >= 0,
+                   "set_group_flag: unable to create attribute " << path << "/" << name);
+      uint8_t value = 1;
+      status = H5Awrite(attr, H5T_NATIVE_UINT8, &value);
+      throw_assert(status >= 0,
+                   "set_group_flag: unable to write attribute " << path << "/" << name);
+      throw_assert(H5Aclose(attr) >= 0,
+                   "set_group_flag: error in H5Aclose");
+      throw_assert(H5Sclose(space) >= 0,
+                   "set_group_flag: error in H5Sclose");
+
+      return status;
+    }
+
+
+    herr_t clear_group_flag
+    (
+     hid_t  loc,
+     const string& path,
+     const string& name
+     )
+    {
+      herr_t status = 0;
+      if ((exists_group (loc, path) > 0) &&
+          (H5Aexists_by_name(loc, path.c_str(), name.c_str(), H5P_DEFAULT) > 0))
+        {
+          status = H5Adelete_by_name(loc, path.c_str(), name.c_str(), H5P_DEFAULT);
+        }
+      return status;
+    }
+  }
+}
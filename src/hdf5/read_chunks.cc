@@ -0,0 +1,344 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file read_chunks.cc
+///
+///  Reads compressed one-dimensional datasets chunk by chunk, decompressing
+///  the chunks on the worker threads of a rank.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "read_chunks.hh"
+#include "mpi_trace.hh"
+#include "throw_assert.hh"
+
+#include <hdf5.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    // stored chunks fetched before they are decompressed in parallel
+    const size_t READ_CHUNKS_BATCH_SIZE = 16*1024*1024;
+
+    // consecutive elements of a chunk that are read into buf
+    struct chunk_piece
+    {
+      hsize_t chunk_pos;
+      hsize_t buf_pos;
+      hsize_t count;
+    };
+
+
+    // returns true if the filter pipeline of dcpl is deflate, optionally
+    // preceded by shuffle, the pipeline used by the writers
+    static bool supported_filters
+    (
+     hid_t  dcpl,
+     bool&  shuffle
+     )
+    {
+      const int nfilters = H5Pget_nfilters(dcpl);
+      if ((nfilters < 1) || (nfilters > 2))
+        {
+          return false;
+        }
+      vector<H5Z_filter_t> filters;
+      for (int i = 0; i < nfilters; i++)
+        {
+          unsigned int flags, filter_config;
+          size_t cd_nelmts = 0;
+          filters.push_back(H5Pget_filter2(dcpl, i, &flags, &cd_nelmts, NULL,
+                                           0, NULL, &filter_config));
+        }
+      shuffle = (nfilters == 2);
+      return (filters.back() == H5Z_FILTER_DEFLATE) &&
+        ((!shuffle) || (filters.front() == H5Z_FILTER_SHUFFLE));
+    }
+
+
+    // reverses the shuffle filter, which stores the k-th bytes of all
+    // elements of a chunk together
+    static void unshuffle
+    (
+     const char*   src,
+     char*         dst,
+     const size_t  num_elems,
+     const size_t  elem_size
+     )
+    {
+      for (size_t k = 0; k < elem_size; k++)
+        {
+          const char* src_bytes = src + k * num_elems;
+          for (size_t i = 0; i < num_elems; i++)
+            {
+              dst[i * elem_size + k] = src_bytes[i];
+            }
+        }
+    }
+
+
+    bool can_read_chunks
+    (
+     hid_t               dset,
+     hid_t               ntype,
+     data::thread_pool&  pool
+     )
+    {
+#ifdef HAVE_ZLIB
+      if (pool.size() < 2)
+        {
+          return false;
+        }
+
+      bool result = true;
+
+      hid_t fspace = H5Dget_space(dset);
+      throw_assert(fspace >= 0, "can_read_chunks: error in H5Dget_space");
+      result = result && (H5Sget_simple_extent_ndims(fspace) == 1);
+      throw_assert(H5Sclose(fspace) >= 0, "can_read_chunks: error in H5Sclose");
+
+      hid_t dcpl = H5Dget_create_plist(dset);
+      throw_assert(dcpl >= 0, "can_read_chunks: error in H5Dget_create_plist");
+      bool shuffle = false;
+      result = result && (H5Pget_layout(dcpl) == H5D_CHUNKED) && supported_filters(dcpl, shuffle);
+      throw_assert(H5Pclose(dcpl) >= 0, "can_read_chunks: error in H5Pclose");
+
+      hid_t ftype = H5Dget_type(dset);
+      throw_assert(ftype >= 0, "can_read_chunks: error in H5Dget_type");
+      result = result && (H5Tequal(ftype, ntype) > 0);
+      throw_assert(H5Tclose(ftype) >= 0, "can_read_chunks: error in H5Tclose");
+
+#ifdef HDF5_IS_PARALLEL
+      if (result)
+        {
+          hid_t file = H5Iget_file_id(dset);
+          throw_assert(file >= 0, "can_read_chunks: error in H5Iget_file_id");
+          hid_t fapl = H5Fget_access_plist(file);
+          throw_assert(fapl >= 0, "can_read_chunks: error in H5Fget_access_plist");
+          result = (H5Pget_driver(fapl) != H5FD_MPIO);
+          throw_assert(H5Pclose(fapl) >= 0, "can_read_chunks: error in H5Pclose");
+          throw_assert(H5Fclose(file) >= 0, "can_read_chunks: error in H5Fclose");
+        }
+#endif
+
+      return result;
+#else
+      return false;
+#endif
+    }
+
+
+    herr_t read_chunks
+    (
+     hid_t                                  dset,
+     hid_t                                  ntype,
+     const vector< pair<hsize_t,hsize_t> >& ranges,
+     void*                                  buf,
+     data::thread_pool&                     pool
+     )
+    {
+#ifdef HAVE_ZLIB
+      mpi::trace_scope trace("read_chunks");
+
+      hid_t fspace = H5Dget_space(dset);
+      throw_assert(fspace >= 0, "read_chunks: error in H5Dget_space");
+      hsize_t dset_size = 0;
+      throw_assert(H5Sget_simple_extent_dims(fspace, &dset_size, NULL) == 1,
+                   "read_chunks: dataset is not one-dimensional");
+      throw_assert(H5Sclose(fspace) >= 0, "read_chunks: error in H5Sclose");
+
+      const size_t elem_size = H5Tget_size(ntype);
+      throw_assert(elem_size > 0, "read_chunks: error in H5Tget_size");
+
+      hsize_t chunk_size = 0;
+      vector<char> fill_value(elem_size, 0);
+      hid_t dcpl = H5Dget_create_plist(dset);
+      throw_assert(dcpl >= 0, "read_chunks: error in H5Dget_create_plist");
+      throw_assert(H5Pget_chunk(dcpl, 1, &chunk_size) == 1,
+                   "read_chunks: dataset is not chunked");
+      throw_assert(H5Pget_fill_value(dcpl, ntype, &fill_value[0]) >= 0,
+                   "read_chunks: error in H5Pget_fill_value");
+      bool shuffle = false;
+      throw_assert(supported_filters(dcpl, shuffle),
+                   "read_chunks: unsupported filters");
+      throw_assert(H5Pclose(dcpl) >= 0, "read_chunks: error in H5Pclose");
+      const size_t chunk_bytes = chunk_size * elem_size;
+
+      // split the ranges at chunk boundaries
+      map<hsize_t, vector<chunk_piece> > chunk_pieces;
+      hsize_t buf_pos = 0;
+      for (const auto& range : ranges)
+        {
+          hsize_t start = range.first, count = range.second;
+          throw_assert(start + count <= dset_size,
+                       "read_chunks: range " << start << "+" << count <<
+                       " exceeds dataset size " << dset_size);
+          while (count > 0)
+            {
+              hsize_t chunk = start / chunk_size;
+              chunk_piece piece;
+              piece.chunk_pos = start - chunk * chunk_size;
+              piece.buf_pos   = buf_pos;
+              piece.count     = min(count, chunk_size - piece.chunk_pos);
+              chunk_pieces[chunk].push_back(piece);
+              start   += piece.count;
+              buf_pos += piece.count;
+              count   -= piece.count;
+            }
+        }
+
+      vector<hsize_t> chunks;
+      vector< const vector<chunk_piece>* > pieces;
+      for (const auto& it : chunk_pieces)
+        {
+          chunks.push_back(it.first);
+          pieces.push_back(&it.second);
+        }
+
+      // positions of the filters in the pipeline, for the filter masks
+      const uint32_t shuffle_mask = shuffle ? 1 : 0;
+      const uint32_t deflate_mask = shuffle ? 2 : 1;
+      vector< vector<char> > scratch(pool.size()), inflate_scratch(pool.size());
+      vector<char> stored;
+      vector<size_t> stored_pos, stored_size;
+      vector<uint32_t> filter_masks;
+      char* dst_buf = static_cast<char*>(buf);
+
+      size_t batch_start = 0;
+      while (batch_start < chunks.size())
+        {
+          // fetch the stored chunks of the batch in file order; HDF5
+          // calls are made by this thread only
+          stored_pos.clear(); stored_size.clear(); filter_masks.clear();
+          size_t batch_bytes = 0, batch_end = batch_start;
+          while ((batch_end < chunks.size()) &&
+                 ((batch_end == batch_start) || (batch_bytes < READ_CHUNKS_BATCH_SIZE)))
+            {
+              // unallocated chunks have an undefined address, for which
+              // H5Dget_chunk_storage_size fails in some HDF5 versions
+              hsize_t offset = chunks[batch_end] * chunk_size, nbytes = 0;
+              unsigned filter_mask = 0;
+              haddr_t addr = HADDR_UNDEF;
+              throw_assert(H5Dget_chunk_info_by_coord(dset, &offset, &filter_mask, &addr, &nbytes) >= 0,
+                           "read_chunks: error in H5Dget_chunk_info_by_coord");
+              if (addr == HADDR_UNDEF)
+                {
+                  nbytes = 0;
+                }
+              stored_pos.push_back(batch_bytes);
+              stored_size.push_back(nbytes);
+              filter_masks.push_back(0);
+              batch_bytes += nbytes;
+              batch_end++;
+            }
+          stored.resize(batch_bytes);
+          for (size_t i = batch_start; i < batch_end; i++)
+            {
+              const size_t b = i - batch_start;
+              if (stored_size[b] > 0)
+                {
+                  hsize_t offset = chunks[i] * chunk_size;
+                  throw_assert(H5Dread_chunk(dset, H5P_DEFAULT, &offset, &filter_masks[b],
+                                             &stored[stored_pos[b]]) >= 0,
+                               "read_chunks: error in H5Dread_chunk");
+                }
+            }
+          trace.add_bytes(batch_bytes);
+          trace.add_items(batch_end - batch_start);
+
+          pool.parallel_for(batch_end - batch_start, [&] (size_t b, size_t worker)
+            {
+              const vector<chunk_piece>& chunk_piece_list = *pieces[batch_start + b];
+              if (stored_size[b] == 0)
+                {
+                  for (const chunk_piece& piece : chunk_piece_list)
+                    {
+                      for (hsize_t k = 0; k < piece.count; k++)
+                        {
+                          memcpy(dst_buf + (piece.buf_pos + k) * elem_size, &fill_value[0], elem_size);
+                        }
+                    }
+                  return;
+                }
+
+              // a chunk read in full is decoded in place
+              const bool whole_chunk = (chunk_piece_list.size() == 1) &&
+                (chunk_piece_list[0].chunk_pos == 0) && (chunk_piece_list[0].count == chunk_size);
+              char* out;
+              if (whole_chunk)
+                {
+                  out = dst_buf + chunk_piece_list[0].buf_pos * elem_size;
+                }
+              else
+                {
+                  scratch[worker].resize(chunk_bytes);
+                  out = &scratch[worker][0];
+                }
+
+              // filters skipped when the chunk was written are flagged in
+              // its filter mask
+              const bool do_inflate   = !(filter_masks[b] & deflate_mask);
+              const bool do_unshuffle = shuffle && (elem_size > 1) && !(filter_masks[b] & shuffle_mask);
+              const char* data = &stored[stored_pos[b]];
+              size_t data_size = stored_size[b];
+              if (do_inflate)
+                {
+                  char* inflated = out;
+                  if (do_unshuffle)
+                    {
+                      inflate_scratch[worker].resize(chunk_bytes);
+                      inflated = &inflate_scratch[worker][0];
+                    }
+                  uLongf inflated_size = chunk_bytes;
+                  int status = uncompress(reinterpret_cast<Bytef*>(inflated), &inflated_size,
+                                          reinterpret_cast<const Bytef*>(data), data_size);
+                  throw_assert((status == Z_OK) && (inflated_size == chunk_bytes),
+                               "read_chunks: unable to inflate chunk " << chunks[batch_start + b]);
+                  data = inflated;
+                  data_size = inflated_size;
+                }
+              throw_assert(data_size >= chunk_bytes,
+                           "read_chunks: stored chunk " << chunks[batch_start + b] <<
+                           " is too small");
+              if (do_unshuffle)
+                {
+                  unshuffle(data, out, chunk_size, elem_size);
+                  data = out;
+                }
+              if ((data == out) && whole_chunk)
+                {
+                  return;
+                }
+
+              for (const chunk_piece& piece : chunk_piece_list)
+                {
+                  memcpy(dst_buf + piece.buf_pos * elem_size, data + piece.chunk_pos * elem_size,
+                         piece.count * elem_size);
+                }
+            });
+
+          batch_start = batch_end;
+        }
+
+      return 0;
+#else
+      throw_assert(false, "read_chunks: NeuroH5 was built without zlib");
+      return -1;
+#endif
+    }
+
+  }
+}
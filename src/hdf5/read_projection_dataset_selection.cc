@@ -17,6 +17,7 @@
 
 #include "neuroh5_types.hh"
 #include "dataset_num_elements.hh"
+#include "file_access.hh"
 #include "read_template.hh"
 #include "path_names.hh"
 #include "rank_range.hh"
@@ -300,22 +301,10 @@ namespace neuroh5
           {
             
             /* Create property list for parallel file access. */
-            hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-            throw_assert_nomsg(fapl >= 0);
-#ifdef HDF5_IS_PARALLEL
-            throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
-#endif
+            hid_t fapl = read_access_plist(comm);
             
             /* Create property list for collective dataset operations. */
-            hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-#ifdef HDF5_IS_PARALLEL
-            if (collective)
-              {
-                ierr = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-                throw_assert(ierr >= 0,
-                             "read_projection_dataset_selection: error in H5Pset_dxpl_mpio");
-              }
-#endif
+            hid_t rapl = collective ? read_transfer_plist(comm) : H5Pcreate (H5P_DATASET_XFER);
             
             hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
             throw_assert_nomsg(file >= 0);
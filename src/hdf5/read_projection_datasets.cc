@@ -16,7 +16,9 @@
 
 #include "neuroh5_types.hh"
 #include "dataset_num_elements.hh"
+#include "file_access.hh"
 #include "read_template.hh"
+#include "thread_pool.hh"
 #include "path_names.hh"
 #include "rank_range.hh"
 #include "read_projection_datasets.hh"
@@ -52,7 +54,8 @@ namespace neuroh5
      hsize_t&                   local_read_blocks,
      size_t                     offset,
      size_t                     numitems,
-     bool collective
+     bool collective,
+     data::thread_pool*         pool
      )
     {
       herr_t ierr = 0;
@@ -61,11 +64,7 @@ namespace neuroh5
       throw_assert_nomsg(MPI_Comm_rank(comm, (int*)&rank) == MPI_SUCCESS);
 
 
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-      throw_assert_nomsg(fapl >= 0);
-#ifdef HDF5_IS_PARALLEL
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
-#endif
+      hid_t fapl = read_access_plist(comm);
       
       hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
       throw_assert_nomsg(file >= 0);
@@ -101,15 +100,7 @@ namespace neuroh5
       if (read_blocks > 0)
         {
           /* Create property list for collective dataset operations. */
-          hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-#ifdef HDF5_IS_PARALLEL
-          if (collective)
-            {
-              ierr = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-              throw_assert(ierr >= 0,
-                           "read_projection_datasets: error in H5Pset_dxpl_mpio");
-            }
-#endif
+          hid_t rapl = collective ? read_transfer_plist(comm) : H5Pcreate (H5P_DATASET_XFER);
           
           // determine which blocks of block_ptr are read by which rank
           mpi::rank_ranges(read_blocks, size, bins);
@@ -154,7 +145,8 @@ namespace neuroh5
              block,
              DST_BLK_PTR_H5_NATIVE_T,
              dst_blk_ptr,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
           
@@ -197,7 +189,8 @@ namespace neuroh5
              dst_idx_block,
              NODE_IDX_H5_NATIVE_T,
              dst_idx,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
 
@@ -227,7 +220,8 @@ namespace neuroh5
              dst_ptr_block,
              DST_PTR_H5_NATIVE_T,
              dst_ptr,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
           
@@ -262,7 +256,8 @@ namespace neuroh5
              src_idx_block,
              NODE_IDX_H5_NATIVE_T,
              src_idx,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
 
@@ -286,7 +281,8 @@ namespace neuroh5
      vector<DST_BLK_PTR_T>&     dst_blk_ptr,
      vector<NODE_IDX_T>&        dst_idx,
      vector<DST_PTR_T>&         dst_ptr,
-     bool collective
+     bool collective,
+     data::thread_pool*         pool
      )
     {
       herr_t ierr = 0;
@@ -295,11 +291,7 @@ namespace neuroh5
       throw_assert_nomsg(MPI_Comm_rank(comm, (int*)&rank) == MPI_SUCCESS);
 
 
-      hid_t fapl = H5Pcreate(H5P_FILE_ACCESS);
-      throw_assert_nomsg(fapl >= 0);
-#ifdef HDF5_IS_PARALLEL
-      throw_assert_nomsg(H5Pset_fapl_mpio(fapl, comm, MPI_INFO_NULL) >= 0);
-#endif
+      hid_t fapl = read_access_plist(comm);
 
       hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, fapl);
       throw_assert_nomsg(file >= 0);
@@ -316,15 +308,7 @@ namespace neuroh5
       if (read_blocks > 0)
         {
           /* Create property list for collective dataset operations. */
-          hid_t rapl = H5Pcreate (H5P_DATASET_XFER);
-#ifdef HDF5_IS_PARALLEL
-          if (collective)
-            {
-              ierr = H5Pset_dxpl_mpio (rapl, H5FD_MPIO_COLLECTIVE);
-              throw_assert(ierr >= 0,
-                           "read_projection_node_datasets: error in H5Pset_dxpl_mpio");
-            }
-#endif
+          hid_t rapl = collective ? read_transfer_plist(comm) : H5Pcreate (H5P_DATASET_XFER);
 
           // determine which blocks of block_ptr are read by which rank
           mpi::rank_ranges(read_blocks, size, bins);
@@ -360,7 +344,8 @@ namespace neuroh5
              block,
              DST_BLK_PTR_H5_NATIVE_T,
              dst_blk_ptr,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
           
@@ -403,7 +388,8 @@ namespace neuroh5
              dst_idx_block,
              NODE_IDX_H5_NATIVE_T,
              dst_idx,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
 
@@ -432,7 +418,8 @@ namespace neuroh5
              dst_ptr_block,
              DST_PTR_H5_NATIVE_T,
              dst_ptr,
-             rapl
+             rapl,
+             pool
              );
           throw_assert_nomsg(ierr >= 0);
 
@@ -0,0 +1,323 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file stitch_datasets.cc
+///
+///  Datasets that combine the datasets of a sequence of part files.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "stitch_datasets.hh"
+#include "path_names.hh"
+#include "exists_dataset.hh"
+#include "group_contents.hh"
+#include "read_template.hh"
+#include "write_template.hh"
+#include "rank_range.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace hdf5
+  {
+
+    /*****************************************************************************
+     * Name by which a virtual dataset in file_name refers to a part
+     * file. HDF5 looks up relative source file names in the directory
+     * of the file that contains the virtual dataset.
+     *****************************************************************************/
+    static string stitched_source_name (const string& file_name,
+                                        const string& part_file_name)
+    {
+      size_t file_pos = file_name.rfind('/');
+      size_t part_pos = part_file_name.rfind('/');
+      string file_dir = (file_pos == string::npos) ? string("") : file_name.substr(0, file_pos);
+      string part_dir = (part_pos == string::npos) ? string("") : part_file_name.substr(0, part_pos);
+      if (file_dir == part_dir)
+        {
+          return (part_pos == string::npos) ? part_file_name : part_file_name.substr(part_pos+1);
+        }
+      return part_file_name;
+    }
+
+
+    /*****************************************************************************
+     * Path of the copy of the dataset at path of the given part
+     *****************************************************************************/
+    static string stitched_copy_path (const size_t part, const string& path)
+    {
+      return "/" + PARTS + "/" + to_string(part) + path;
+    }
+
+
+    herr_t create_stitched_dataset
+    (
+     hid_t                 file,
+     const string&         file_name,
+     const string&         path,
+     hid_t                 ftype,
+     const vector<string>& part_file_names,
+     const vector<hsize_t>& part_sizes,
+     const bool            copy_parts
+     )
+    {
+      throw_assert(part_file_names.size() == part_sizes.size(),
+                   "create_stitched_dataset: mismatch between number of part files and part sizes");
+
+      hsize_t total_size = 0;
+      for (const hsize_t part_size : part_sizes)
+        {
+          total_size += part_size;
+        }
+
+      hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+      throw_assert(lcpl >= 0, "create_stitched_dataset: error in H5Pcreate");
+      throw_assert(H5Pset_create_intermediate_group(lcpl, 1) >= 0,
+                   "create_stitched_dataset: error in H5Pset_create_intermediate_group");
+      hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+      throw_assert(dcpl >= 0, "create_stitched_dataset: error in H5Pcreate");
+
+      hid_t vspace = H5Screate_simple(1, &total_size, NULL);
+      throw_assert(vspace >= 0, "create_stitched_dataset: error in H5Screate_simple");
+
+      hsize_t start = 0, one = 1;
+      for (size_t p = 0; p < part_file_names.size(); p++)
+        {
+          hsize_t part_size = part_sizes[p];
+          if (part_size == 0)
+            {
+              continue;
+            }
+          throw_assert(H5Sselect_hyperslab(vspace, H5S_SELECT_SET, &start, NULL,
+                                           &one, &part_size) >= 0,
+                       "create_stitched_dataset: error in H5Sselect_hyperslab");
+          hid_t srcspace = H5Screate_simple(1, &part_size, NULL);
+          throw_assert(srcspace >= 0, "create_stitched_dataset: error in H5Screate_simple");
+          string source_name, source_path;
+          if (copy_parts)
+            {
+              // object copies transfer the chunks of a dataset as they
+              // are stored, without passing them through the filters
+              source_name = ".";
+              source_path = stitched_copy_path(p, path);
+              hid_t part_file = H5Fopen(part_file_names[p].c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+              throw_assert(part_file >= 0,
+                           "create_stitched_dataset: unable to open file " << part_file_names[p]);
+              throw_assert(H5Ocopy(part_file, path.c_str(), file, source_path.c_str(),
+                                   H5P_DEFAULT, lcpl) >= 0,
+                           "create_stitched_dataset: unable to copy " << path << " of " <<
+                           part_file_names[p]);
+              throw_assert(H5Fclose(part_file) >= 0,
+                           "create_stitched_dataset: unable to close file " << part_file_names[p]);
+            }
+          else
+            {
+              source_name = stitched_source_name(file_name, part_file_names[p]);
+              source_path = path;
+            }
+          throw_assert(H5Pset_virtual(dcpl, vspace, source_name.c_str(), source_path.c_str(),
+                                      srcspace) >= 0,
+                       "create_stitched_dataset: unable to map " << path << " of " <<
+                       part_file_names[p]);
+          throw_assert(H5Sclose(srcspace) >= 0, "create_stitched_dataset: error in H5Sclose");
+          start += part_size;
+        }
+      throw_assert(H5Sselect_all(vspace) >= 0, "create_stitched_dataset: error in H5Sselect_all");
+
+      hid_t dset = H5Dcreate2(file, path.c_str(), ftype, vspace, lcpl, dcpl, H5P_DEFAULT);
+      throw_assert(dset >= 0, "create_stitched_dataset: unable to create dataset " << path);
+
+      throw_assert(H5Dclose(dset) >= 0, "create_stitched_dataset: error in H5Dclose");
+      throw_assert(H5Sclose(vspace) >= 0, "create_stitched_dataset: error in H5Sclose");
+      throw_assert(H5Pclose(dcpl) >= 0, "create_stitched_dataset: error in H5Pclose");
+      throw_assert(H5Pclose(lcpl) >= 0, "create_stitched_dataset: error in H5Pclose");
+
+      return 0;
+    }
+
+
+    herr_t remove_stitched_group
+    (
+     hid_t         file,
+     const string& path
+     )
+    {
+      if (exists_dataset (file, path) > 0)
+        {
+          throw_assert(H5Ldelete(file, path.c_str(), H5P_DEFAULT) >= 0,
+                       "remove_stitched_group: unable to remove " << path);
+        }
+      if (exists_dataset (file, "/" + PARTS) > 0)
+        {
+          vector<string> parts;
+          throw_assert(group_contents(MPI_COMM_SELF, file, "/" + PARTS, parts) >= 0,
+                       "remove_stitched_group: unable to read group " << PARTS);
+          for (const string& part : parts)
+            {
+              const string copy_path = "/" + PARTS + "/" + part + path;
+              if (exists_dataset (file, copy_path) > 0)
+                {
+                  throw_assert(H5Ldelete(file, copy_path.c_str(), H5P_DEFAULT) >= 0,
+                               "remove_stitched_group: unable to remove " << copy_path);
+                }
+            }
+        }
+      return 0;
+    }
+
+
+    herr_t create_stitched_pointer_dataset
+    (
+     hid_t                  file,
+     const string&          path,
+     hid_t                  ftype,
+     const vector<hsize_t>& part_sizes,
+     const hsize_t          chunk_size
+     )
+    {
+      hsize_t size = 0;
+      for (const hsize_t part_size : part_sizes)
+        {
+          size += part_size;
+        }
+      if (size > 0)
+        {
+          size++;
+        }
+
+      hid_t lcpl = H5Pcreate(H5P_LINK_CREATE);
+      throw_assert(lcpl >= 0, "create_stitched_pointer_dataset: error in H5Pcreate");
+      throw_assert(H5Pset_create_intermediate_group(lcpl, 1) >= 0,
+                   "create_stitched_pointer_dataset: error in H5Pset_create_intermediate_group");
+
+      hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+      throw_assert(dcpl >= 0, "create_stitched_pointer_dataset: error in H5Pcreate");
+      if (size > 0)
+        {
+          hsize_t chunk = std::min(chunk_size, size);
+          throw_assert(H5Pset_layout(dcpl, H5D_CHUNKED) >= 0,
+                       "create_stitched_pointer_dataset: unable to set chunked layout");
+          throw_assert(H5Pset_chunk(dcpl, 1, &chunk) >= 0,
+                       "create_stitched_pointer_dataset: unable to set chunk size");
+          throw_assert(H5Pset_alloc_time(dcpl, H5D_ALLOC_TIME_EARLY) >= 0,
+                       "create_stitched_pointer_dataset: unable to set allocation time");
+#ifdef H5_HAS_PARALLEL_DEFLATE
+          throw_assert(H5Pset_deflate(dcpl, 9) >= 0,
+                       "create_stitched_pointer_dataset: unable to add deflate filter");
+#endif
+        }
+
+      hid_t fspace = H5Screate_simple(1, &size, NULL);
+      throw_assert(fspace >= 0, "create_stitched_pointer_dataset: error in H5Screate_simple");
+
+      hid_t dset = H5Dcreate2(file, path.c_str(), ftype, fspace, lcpl, dcpl, H5P_DEFAULT);
+      throw_assert(dset >= 0, "create_stitched_pointer_dataset: unable to create dataset " << path);
+
+      throw_assert(H5Dclose(dset) >= 0, "create_stitched_pointer_dataset: error in H5Dclose");
+      throw_assert(H5Sclose(fspace) >= 0, "create_stitched_pointer_dataset: error in H5Sclose");
+      throw_assert(H5Pclose(dcpl) >= 0, "create_stitched_pointer_dataset: error in H5Pclose");
+      throw_assert(H5Pclose(lcpl) >= 0, "create_stitched_pointer_dataset: error in H5Pclose");
+
+      return 0;
+    }
+
+
+    void write_stitched_pointers
+    (
+     MPI_Comm                 comm,
+     hid_t                    file,
+     const string&            path,
+     const vector<string>&    part_file_names,
+     const vector<hsize_t>&   part_sizes,
+     const vector<uint64_t>&  part_offsets
+     )
+    {
+      int ssize, srank;
+      throw_assert(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS,
+                   "write_stitched_pointers: error in MPI_Comm_size");
+      throw_assert(MPI_Comm_rank(comm, &srank) == MPI_SUCCESS,
+                   "write_stitched_pointers: error in MPI_Comm_rank");
+      throw_assert((part_file_names.size() == part_sizes.size()) &&
+                   (part_file_names.size() == part_offsets.size()),
+                   "write_stitched_pointers: mismatch between number of part files and part sizes");
+
+      const size_t num_parts = part_file_names.size();
+
+      // positions of the parts in the stitched dataset; the final
+      // pointer is taken from the last non-empty part
+      vector<hsize_t> part_starts(num_parts, 0);
+      size_t last_part = num_parts;
+      hsize_t total_size = 0;
+      for (size_t p = 0; p < num_parts; p++)
+        {
+          part_starts[p] = total_size;
+          total_size += part_sizes[p];
+          if (part_sizes[p] > 0)
+            {
+              last_part = p;
+            }
+        }
+      if (total_size == 0)
+        {
+          return;
+        }
+
+      vector< pair<hsize_t,hsize_t> > ranges;
+      mpi::rank_ranges(num_parts, ssize, ranges);
+      const size_t part_start = ranges[srank].first;
+      const size_t part_end   = part_start + ranges[srank].second;
+
+      vector<uint64_t> ptr;
+      for (size_t p = part_start; p < part_end; p++)
+        {
+          if (part_sizes[p] == 0)
+            {
+              continue;
+            }
+          const hsize_t len = part_sizes[p] + ((p == last_part) ? 1 : 0);
+
+          hid_t part_file = H5Fopen(part_file_names[p].c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+          throw_assert(part_file >= 0,
+                       "write_stitched_pointers: unable to open file " << part_file_names[p]);
+          vector<uint64_t> part_ptr(len);
+          throw_assert(hdf5::read<uint64_t>(part_file, path, 0, len, H5T_NATIVE_UINT64,
+                                            part_ptr, H5P_DEFAULT) >= 0,
+                       "write_stitched_pointers: unable to read " << path << " of " <<
+                       part_file_names[p]);
+          throw_assert(H5Fclose(part_file) >= 0,
+                       "write_stitched_pointers: unable to close file " << part_file_names[p]);
+
+          for (size_t i = 0; i < len; i++)
+            {
+              ptr.push_back(part_ptr[i] + part_offsets[p]);
+            }
+        }
+
+      // the parts of a rank are contiguous, and so are their pointers
+      const hsize_t start = (ptr.size() > 0) ? part_starts[part_start] : 0;
+      const hsize_t len = ptr.size();
+      if (len == 0)
+        {
+          ptr.resize(1, 0);
+        }
+
+      hid_t wapl = H5Pcreate(H5P_DATASET_XFER);
+      throw_assert(wapl >= 0, "write_stitched_pointers: error in H5Pcreate");
+#ifdef HDF5_IS_PARALLEL
+      throw_assert(H5Pset_dxpl_mpio(wapl, H5FD_MPIO_COLLECTIVE) >= 0,
+                   "write_stitched_pointers: error in H5Pset_dxpl_mpio");
+#endif
+      throw_assert(hdf5::write<uint64_t>(file, path, 0, start, len, H5T_NATIVE_UINT64,
+                                         ptr, wapl) >= 0,
+                   "write_stitched_pointers: unable to write " << path);
+      throw_assert(H5Pclose(wapl) >= 0, "write_stitched_pointers: error in H5Pclose");
+    }
+
+  }
+}
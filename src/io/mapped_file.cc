@@ -0,0 +1,90 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mapped_file.cc
+///
+///  Read-only memory mapping of a byte range of a file.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "mapped_file.hh"
+#include "throw_assert.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace io
+  {
+
+    size_t file_size (const string& file_name)
+    {
+      struct stat st;
+      throw_assert(stat(file_name.c_str(), &st) == 0,
+                   "file_size: unable to stat file " << file_name);
+      return st.st_size;
+    }
+
+    mapped_file::mapped_file (const string& file_name, size_t offset, size_t length)
+      : map_addr(NULL), map_length(0), data_begin(NULL), data_end(NULL)
+    {
+      map(file_name, offset, length);
+    }
+
+    mapped_file::mapped_file (const string& file_name)
+      : map_addr(NULL), map_length(0), data_begin(NULL), data_end(NULL)
+    {
+      map(file_name, 0, file_size(file_name));
+    }
+
+    void mapped_file::map (const string& file_name, size_t offset, size_t length)
+    {
+      int fd = open(file_name.c_str(), O_RDONLY);
+      throw_assert(fd >= 0, "mapped_file: unable to open file " << file_name);
+
+      struct stat st;
+      throw_assert(fstat(fd, &st) == 0,
+                   "mapped_file: unable to stat file " << file_name);
+      size_t fsize = st.st_size;
+
+      if (offset > fsize)
+        {
+          offset = fsize;
+        }
+      if (length > fsize - offset)
+        {
+          length = fsize - offset;
+        }
+
+      if (length > 0)
+        {
+          // mmap offsets must be aligned to the page size
+          size_t page_size = sysconf(_SC_PAGE_SIZE);
+          size_t map_offset = (offset / page_size) * page_size;
+          map_length = length + (offset - map_offset);
+          map_addr = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, map_offset);
+          throw_assert(map_addr != MAP_FAILED,
+                       "mapped_file: unable to map file " << file_name);
+          madvise(map_addr, map_length, MADV_SEQUENTIAL);
+          data_begin = (const char*)map_addr + (offset - map_offset);
+          data_end   = data_begin + length;
+        }
+
+      close(fd);
+    }
+
+    mapped_file::~mapped_file ()
+    {
+      if (map_addr != NULL)
+        {
+          munmap(map_addr, map_length);
+        }
+    }
+
+  }
+}
@@ -19,13 +19,13 @@
 #include <vector>
 #include <forward_list>
 
-#include "ngraph.hh"
 #include "neuroh5_types.hh"
 #include "contract_tree.hh"
+#include "mapped_file.hh"
+#include "text_parser.hh"
 #include "throw_assert.hh"
 
 using namespace std;
-using namespace NGraph;
 
 namespace neuroh5
 {
@@ -49,36 +49,50 @@ namespace neuroh5
      )
     {
       int status = 0;
-      Graph A, S;
       std::deque<COORD_T> xcoords, ycoords, zcoords;  // coordinates of nodes
       std::deque<REALVAL_T> radiuses;   // Radius
       std::deque<LAYER_IDX_T> layers;   // Layer
       std::deque<PARENT_NODE_IDX_T> parents;   // Parent point ids
       std::deque<SWC_TYPE_T> swc_types;   // SWC types
-      Graph::vertex_set roots;
+      NODE_IDX_T node_base = 0;
 
-      ifstream infile(file_name);
-      string line;
+      mapped_file swc_file(file_name);
+      const char* p = swc_file.begin();
+      const char* end = swc_file.end();
       size_t i = 0;
     
-      while (getline(infile, line))
+      while (p < end)
         {
-          istringstream iss(line);
-          NODE_IDX_T id, idpar; int opt_idpar;
+          NODE_IDX_T id; int opt_idpar;
           int layer_value; LAYER_IDX_T layer;
           REALVAL_T radius;
           COORD_T x, y, z;
 
-          iss >> id;
+          // lines that do not start with a number are skipped
+          if (!is_number_next(p, end))
+            {
+              skip_line(p, end);
+              continue;
+            }
+          throw_assert(parse_unsigned(p, end, id),
+                       "read_layer_swc: invalid point id in file " << file_name);
           id = id+id_offset;
-          if (iss.fail()) continue;
+          if (i == 0)
+            {
+              node_base = id;
+            }
+          throw_assert(id == node_base + i,
+                       "read_layer_swc: point ids must be consecutive in file " << file_name);
         
-          throw_assert_nomsg (iss >> layer_value);
-          throw_assert_nomsg (iss >> x);
-          throw_assert_nomsg (iss >> y);
-          throw_assert_nomsg (iss >> z);
-          throw_assert_nomsg (iss >> radius);
-          throw_assert_nomsg (iss >> opt_idpar);
+          throw_assert(parse_signed(p, end, layer_value),
+                       "read_layer_swc: invalid layer in file " << file_name);
+          throw_assert(parse_real(p, end, x) && parse_real(p, end, y) && parse_real(p, end, z),
+                       "read_layer_swc: invalid coordinates in file " << file_name);
+          throw_assert(parse_real(p, end, radius),
+                       "read_layer_swc: invalid radius in file " << file_name);
+          throw_assert(parse_signed(p, end, opt_idpar),
+                       "read_layer_swc: invalid parent in file " << file_name);
+          skip_line(p, end);
 
           if (layer_value < 0)
             {
@@ -89,17 +103,6 @@ namespace neuroh5
               layer = layer_value + layer_offset;
             }
         
-          A.insert_vertex(id);
-          if (opt_idpar > -1)
-            {
-              idpar = opt_idpar+id_offset;
-              A.insert_edge(idpar,id);
-            }
-          else
-            {
-              roots.insert(id);
-            }
-        
           if (opt_idpar > -1)
             {
               parents.push_back(opt_idpar+id_offset);
@@ -118,56 +121,18 @@ namespace neuroh5
         
           i++;
         }
-    
-      infile.close();
 
-      //cout << A;
 
-      contraction_map_t contraction_map;
       deque<SECTION_IDX_T> src_vector, dst_vector;
       deque<SECTION_IDX_T> sec_vector;
-      S.insert_vertex(0);
 
-      if (split_layers)
-        cell::contract_tree_regions_dfs (A, layers, swc_types, roots, S, contraction_map, 0, 0);
-      else
-        cell::contract_tree_dfs (A, swc_types, roots, S, contraction_map, 0, 0);
-    
-      //cout << S;
-      size_t num_sections = contraction_map.size();
-      throw_assert_nomsg(num_sections > 0);
-    
-      sec_vector.push_back(contraction_map.size());
-      size_t sec_idx = 0;
-      for(auto it = contraction_map.cbegin(); it != contraction_map.end(); it++)
-        {
-          // iterator->first = key
-          // iterator->second = value
-          size_t size = it->second.size();
-          sec_vector.push_back(size);
-          sec_vector.insert(std::end(sec_vector),std::begin(it->second),std::end(it->second));
-          sec_idx++;
-        }
-      throw_assert_nomsg(sec_idx == num_sections);
+      cell::contract_tree (parents, swc_types, split_layers ? &layers : NULL, node_base,
+                           src_vector, dst_vector, sec_vector);
 
-      
-      for ( Graph::const_iterator p = S.begin(); p != S.end(); p++)
-        {
-          Graph::vertex u = Graph::node (p); 
-          Graph::vertex_set outs = S.out_neighbors(u);
-          throw_assert_nomsg(u < num_sections);
+      size_t num_sections = sec_vector[0];
+      throw_assert(num_sections > 0,
+                   "read_layer_swc: no sections in file " << file_name);
 
-          for ( Graph::vertex_set::const_iterator s = outs.begin(); s != outs.end(); s++)
-            {
-              Graph::vertex v = Graph::node (s);
-              throw_assert_nomsg(v < num_sections);
-              throw_assert_nomsg(u != v);
-              src_vector.push_back(u);
-              dst_vector.push_back(v);
-            }
-        }
-
-    
       neurotree_t tree = make_tuple(gid,src_vector,dst_vector,sec_vector,xcoords,ycoords,zcoords,radiuses,layers,parents,swc_types);
       tree_list.push_front(tree);
 
@@ -185,7 +150,7 @@ namespace neuroh5
           cout << "src_vector: " << endl;
           for_each(src_vector.cbegin(),
                    src_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
@@ -193,7 +158,7 @@ namespace neuroh5
           cout << "dst_vector: " << endl;
           for_each(dst_vector.cbegin(),
                    dst_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
@@ -201,7 +166,7 @@ namespace neuroh5
           cout << "sec_vector: " << endl;
           for_each(sec_vector.cbegin(),
                    sec_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
@@ -219,56 +184,58 @@ namespace neuroh5
      )
     {
       int status = 0;
-      Graph A, S;
       std::deque<COORD_T> xcoords, ycoords, zcoords;  // coordinates of nodes
       std::deque<REALVAL_T> radiuses;   // Radius
       std::deque<LAYER_IDX_T> layers;   // Layer
       std::deque<PARENT_NODE_IDX_T> parents;   // Parent point ids
       std::deque<SWC_TYPE_T> swc_types;   // SWC types
-      Graph::vertex_set roots;
+      NODE_IDX_T node_base = 0;
 
-      ifstream infile(file_name);
-      string line;
+      mapped_file swc_file(file_name);
+      const char* p = swc_file.begin();
+      const char* end = swc_file.end();
       size_t i = 0;
     
-      while (getline(infile, line))
+      while (p < end)
         {
-          istringstream iss(line);
-          NODE_IDX_T id, idpar; int opt_idpar;
+          NODE_IDX_T id; int opt_idpar;
           int swc_value; int opt_layer; LAYER_IDX_T layer=-1;
           SWC_TYPE_T swc_type;
           REALVAL_T radius;
           COORD_T x, y, z;
 
-          iss >> id;
+          // lines that do not start with a number are skipped
+          if (!is_number_next(p, end))
+            {
+              skip_line(p, end);
+              continue;
+            }
+          throw_assert(parse_unsigned(p, end, id),
+                       "read_swc: invalid point id in file " << file_name);
           id = id+id_offset;
-          if (iss.fail()) continue;
+          if (i == 0)
+            {
+              node_base = id;
+            }
+          throw_assert(id == node_base + i,
+                       "read_swc: point ids must be consecutive in file " << file_name);
         
-          throw_assert_nomsg (iss >> swc_value);
+          throw_assert(parse_signed(p, end, swc_value),
+                       "read_swc: invalid SWC type in file " << file_name);
           swc_type = swc_value;
-          throw_assert_nomsg (iss >> x);
-          throw_assert_nomsg (iss >> y);
-          throw_assert_nomsg (iss >> z);
-          throw_assert_nomsg (iss >> radius);
-          throw_assert_nomsg (iss >> opt_idpar);
-          iss >> opt_layer;
-          if (!iss.fail())
+          throw_assert(parse_real(p, end, x) && parse_real(p, end, y) && parse_real(p, end, z),
+                       "read_swc: invalid coordinates in file " << file_name);
+          throw_assert(parse_real(p, end, radius),
+                       "read_swc: invalid radius in file " << file_name);
+          throw_assert(parse_signed(p, end, opt_idpar),
+                       "read_swc: invalid parent in file " << file_name);
+          if (parse_signed(p, end, opt_layer))
             {
               layer = opt_layer;
             }
+          skip_line(p, end);
           
           
-          A.insert_vertex(id);
-          if (opt_idpar > -1)
-            {
-              idpar = opt_idpar+id_offset;
-              A.insert_edge(idpar,id);
-            }
-          else
-            {
-              roots.insert(id);
-            }
-        
           if (opt_idpar > -1)
             {
               parents.push_back(opt_idpar+id_offset);
@@ -287,52 +254,18 @@ namespace neuroh5
         
           i++;
         }
-    
-      infile.close();
 
-      //cout << A;
-    
-      contraction_map_t contraction_map;
+
       deque<SECTION_IDX_T> src_vector, dst_vector;
       deque<SECTION_IDX_T> sec_vector;
-      S.insert_vertex(0);
 
-      cell::contract_tree_dfs (A, swc_types, roots, S, contraction_map, 0, 0);
-    
-      //cout << S;
-      size_t num_sections = contraction_map.size();
-      throw_assert_nomsg(num_sections > 0);
-    
-      sec_vector.push_back(contraction_map.size());
-      size_t sec_idx = 0;
-      for(auto it = contraction_map.cbegin(); it != contraction_map.end(); it++)
-        {
-          // iterator->first = key
-          // iterator->second = value
-          size_t size = it->second.size();
-          sec_vector.push_back(size);
-          sec_vector.insert(std::end(sec_vector),std::begin(it->second),std::end(it->second));
-          sec_idx++;
-        }
-      throw_assert_nomsg(sec_idx == num_sections);
-    
-      for ( Graph::const_iterator p = S.begin(); p != S.end(); p++)
-        {
-          Graph::vertex u = Graph::node (p); 
-          Graph::vertex_set outs = S.out_neighbors(u);
-          throw_assert_nomsg(u < num_sections);
+      cell::contract_tree (parents, swc_types, NULL, node_base,
+                           src_vector, dst_vector, sec_vector);
 
-          for ( Graph::vertex_set::const_iterator s = outs.begin(); s != outs.end(); s++)
-            {
-              Graph::vertex v = Graph::node (s);
-              throw_assert_nomsg(v < num_sections);
-              throw_assert_nomsg(u != v);
-              src_vector.push_back(u);
-              dst_vector.push_back(v);
-            }
-        }
+      size_t num_sections = sec_vector[0];
+      throw_assert(num_sections > 0,
+                   "read_swc: no sections in file " << file_name);
 
-    
       neurotree_t tree = make_tuple(gid,src_vector,dst_vector,sec_vector,xcoords,ycoords,zcoords,radiuses,layers,parents,swc_types);
       tree_list.push_front(tree);
 
@@ -357,7 +290,7 @@ namespace neuroh5
           cout << "src_vector: " << endl;
           for_each(src_vector.cbegin(),
                    src_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
@@ -365,7 +298,7 @@ namespace neuroh5
           cout << "dst_vector: " << endl;
           for_each(dst_vector.cbegin(),
                    dst_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
@@ -373,7 +306,7 @@ namespace neuroh5
           cout << "sec_vector: " << endl;
           for_each(sec_vector.cbegin(),
                    sec_vector.cend(),
-                   [] (const Graph::vertex i)
+                   [] (const SECTION_IDX_T i)
                    { cout << " " << i; } 
                    );
           cout << endl;
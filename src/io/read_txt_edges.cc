@@ -0,0 +1,186 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file read_txt_edges.cc
+///
+///  Parallel reading of edge lists in text format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "read_txt_edges.hh"
+#include "mapped_file.hh"
+#include "text_parser.hh"
+#include "rank_range.hh"
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "throw_assert.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace io
+  {
+
+    template <class T>
+    static void parse_attr_columns (const string& file_name,
+                                    const char*& p, const char* end,
+                                    bool (*parse)(const char*&, const char*, T&),
+                                    vector< vector<T> >& columns)
+    {
+      for (size_t a=0; a<columns.size(); a++)
+        {
+          T v;
+          throw_assert(parse(p, end, v),
+                       "read_txt_edges: missing or invalid attribute value in file " << file_name);
+          columns[a].push_back(v);
+        }
+    }
+
+    // Parses the lines of a file that start in the byte range [begin, end)
+    static void parse_txt_edges (const string&           file_name,
+                                 const size_t            begin,
+                                 const size_t            end,
+                                 vector <NODE_IDX_T>&    dst,
+                                 vector <NODE_IDX_T>&    src,
+                                 map <string, data::NamedAttrVal>& edge_attr_map)
+    {
+      // The mapping starts one byte before the range, in order to
+      // determine whether the range starts at the beginning of a line,
+      // and extends to the end of the file, because the last line may
+      // cross the end of the range.
+      size_t map_begin = (begin > 0) ? begin-1 : 0;
+      mapped_file mf(file_name, map_begin, file_size(file_name) - map_begin);
+
+      const char* p = mf.begin();
+      const char* data_end = mf.end();
+      const char* range_end = mf.begin() + (end - map_begin);
+
+      if (begin > 0)
+        {
+          // the line that includes the first byte of the range belongs
+          // to the preceding range, unless it starts at that byte
+          if (*p != '\n')
+            {
+              skip_line(p, data_end);
+            }
+          else
+            {
+              p++;
+            }
+        }
+
+      while (p < range_end)
+        {
+          if (is_empty_line(p, data_end))
+            {
+              skip_line(p, data_end);
+              continue;
+            }
+
+          NODE_IDX_T d, s;
+          throw_assert(parse_unsigned(p, data_end, d),
+                       "read_txt_edges: invalid destination index in file " << file_name);
+          throw_assert(parse_unsigned(p, data_end, s),
+                       "read_txt_edges: invalid source index in file " << file_name);
+          dst.push_back(d);
+          src.push_back(s);
+
+          for (auto & iter : edge_attr_map)
+            {
+              data::NamedAttrVal& edge_attr = iter.second;
+              parse_attr_columns<float>(file_name, p, data_end, parse_real<float>, edge_attr.float_values);
+              parse_attr_columns<uint8_t>(file_name, p, data_end, parse_unsigned<uint8_t>, edge_attr.uint8_values);
+              parse_attr_columns<uint16_t>(file_name, p, data_end, parse_unsigned<uint16_t>, edge_attr.uint16_values);
+              parse_attr_columns<uint32_t>(file_name, p, data_end, parse_unsigned<uint32_t>, edge_attr.uint32_values);
+              parse_attr_columns<int8_t>(file_name, p, data_end, parse_signed<int8_t>, edge_attr.int8_values);
+              parse_attr_columns<int16_t>(file_name, p, data_end, parse_signed<int16_t>, edge_attr.int16_values);
+              parse_attr_columns<int32_t>(file_name, p, data_end, parse_signed<int32_t>, edge_attr.int32_values);
+            }
+
+          skip_line(p, data_end);
+        }
+    }
+
+
+    int read_txt_edges (MPI_Comm                   comm,
+                        const vector<string>&      file_names,
+                        const map <string, vector <size_t> >&  num_attrs,
+                        vector <NODE_IDX_T>&       dst,
+                        vector <NODE_IDX_T>&       src,
+                        map <string, data::NamedAttrVal>& edge_attr_map)
+    {
+      int rank, size;
+      throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                   "read_txt_edges: unable to obtain size of MPI communicator");
+      throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                   "read_txt_edges: unable to obtain rank of MPI communicator");
+
+      for (auto iter : num_attrs)
+        {
+          const vector<size_t>& attr_counts = iter.second;
+          throw_assert(attr_counts.size() == data::AttrVal::num_attr_types,
+                       "read_txt_edges: invalid attribute counts for namespace " << iter.first);
+          data::NamedAttrVal& edge_attr = edge_attr_map[iter.first];
+          edge_attr.float_values.resize(attr_counts[data::AttrVal::attr_index_float]);
+          edge_attr.uint8_values.resize(attr_counts[data::AttrVal::attr_index_uint8]);
+          edge_attr.uint16_values.resize(attr_counts[data::AttrVal::attr_index_uint16]);
+          edge_attr.uint32_values.resize(attr_counts[data::AttrVal::attr_index_uint32]);
+          edge_attr.int8_values.resize(attr_counts[data::AttrVal::attr_index_int8]);
+          edge_attr.int16_values.resize(attr_counts[data::AttrVal::attr_index_int16]);
+          edge_attr.int32_values.resize(attr_counts[data::AttrVal::attr_index_int32]);
+        }
+
+      // Determine the file sizes; each rank stats a subset of the files
+      vector<uint64_t> file_sizes(file_names.size(), 0);
+      {
+        vector< pair<hsize_t,hsize_t> > ranges;
+        mpi::rank_ranges(file_names.size(), size, ranges);
+        for (size_t i=ranges[rank].first; i<ranges[rank].first+ranges[rank].second; i++)
+          {
+            file_sizes[i] = file_size(file_names[i]);
+          }
+        if (file_sizes.size() > 0)
+          {
+            throw_assert(MPI_Allreduce(MPI_IN_PLACE, &file_sizes[0], file_sizes.size(),
+                                       MPI_UINT64_T, MPI_SUM, comm) == MPI_SUCCESS,
+                         "read_txt_edges: error in MPI_Allreduce");
+          }
+      }
+
+      // Split the concatenation of all files into equal byte ranges
+      uint64_t total_size = 0;
+      for (auto s : file_sizes)
+        {
+          total_size += s;
+        }
+      vector< pair<hsize_t,hsize_t> > byte_ranges;
+      mpi::rank_ranges(total_size, size, byte_ranges);
+      const uint64_t range_begin = byte_ranges[rank].first;
+      const uint64_t range_end   = byte_ranges[rank].first + byte_ranges[rank].second;
+
+      uint64_t file_offset = 0;
+      for (size_t i=0; i<file_names.size(); i++)
+        {
+          const uint64_t file_begin = file_offset, file_end = file_offset + file_sizes[i];
+          file_offset = file_end;
+
+          uint64_t begin = max(range_begin, file_begin), end = min(range_end, file_end);
+          if (begin >= end)
+            {
+              continue;
+            }
+          parse_txt_edges(file_names[i], begin - file_begin, end - file_begin,
+                          dst, src, edge_attr_map);
+        }
+
+      return 0;
+    }
+
+  }
+}
@@ -19,6 +19,7 @@
 #include "read_txt_projection.hh"
 #include "neuroh5_types.hh"
 #include "attr_val.hh"
+#include "sample_sort.hh"
 #include "throw_assert.hh"
 
 using namespace std;
@@ -37,8 +38,7 @@ namespace neuroh5
     {
       ifstream infile(file_name.c_str());
       string line;
-      size_t i = 0;
-      map<NODE_IDX_T, vector<NODE_IDX_T> > dst_src_map;
+      vector<NODE_IDX_T> dst_col, src_col;
       
       map <string, vector <vector <float> > >    float_attr_map;
       map <string, vector <vector <uint8_t> > >  uint8_attr_map;
@@ -56,7 +56,8 @@ namespace neuroh5
           throw_assert_nomsg (iss >> dst);
           throw_assert_nomsg (iss >> src);
 
-          dst_src_map[dst].push_back(src);
+          dst_col.push_back(dst);
+          src_col.push_back(src);
 
           for (auto iter : num_attrs)
             {
@@ -135,16 +136,31 @@ namespace neuroh5
             }
         }
       infile.close();
-      i = 0;
+
+      // group the edges by destination, preserving the order of the
+      // edges within each destination
+      vector<size_t> perm;
+      mpi::radix_sort_permutation(dst_col, perm);
+      mpi::permute_column(perm, dst_col);
+      mpi::permute_column(perm, src_col);
+
       src_idx_ptr.push_back(0);
-      for (auto & element : dst_src_map)
+      for (size_t e = 0; e < dst_col.size(); e++)
+        {
+          if ((e == 0) || (dst_col[e] != dst_col[e-1]))
+            {
+              if (e > 0)
+                {
+                  src_idx_ptr.push_back(e);
+                }
+              dst_idx.push_back(dst_col[e]);
+            }
+        }
+      if (!dst_col.empty())
         {
-          dst_idx.push_back(element.first);
-          vector<NODE_IDX_T>& src = element.second;
-          src_idx.insert(src_idx.end(), src.begin(), src.end());
-          src_idx_ptr.push_back(src_idx_ptr[i] + src.size());
-          i++;
+          src_idx_ptr.push_back(dst_col.size());
         }
+      src_idx.insert(src_idx.end(), src_col.begin(), src_col.end());
       
       for (auto iter : num_attrs)
         {
@@ -156,34 +172,41 @@ namespace neuroh5
           auto &  int16_attrs  = int16_attr_map[iter.first];
           auto &  int32_attrs  = int32_attr_map[iter.first];
 
-          auto attrs = attrs_map[iter.first];
+          auto & attrs = attrs_map[iter.first];
           
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_float]; a++)
             {
+              mpi::permute_column(perm, float_attrs[a]);
               attrs.insert(float_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_uint8]; a++)
             {
+              mpi::permute_column(perm, uint8_attrs[a]);
               attrs.insert(uint8_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_uint16]; a++)
             {
+              mpi::permute_column(perm, uint16_attrs[a]);
               attrs.insert(uint16_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_uint32]; a++)
             {
+              mpi::permute_column(perm, uint32_attrs[a]);
               attrs.insert(uint32_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_int8]; a++)
             {
+              mpi::permute_column(perm, int8_attrs[a]);
               attrs.insert(int8_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_int16]; a++)
             {
+              mpi::permute_column(perm, int16_attrs[a]);
               attrs.insert(int16_attrs[a]);
             }
           for (size_t a=0; a<iter.second[data::AttrVal::attr_index_int32]; a++)
             {
+              mpi::permute_column(perm, int32_attrs[a]);
               attrs.insert(int32_attrs[a]);
             }
         }
@@ -0,0 +1,318 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mpi_memory.cc
+///
+///  Accounting of the bytes held by the major data structures of the
+///  collective readers, with per-rank high-water marks, and a per-rank
+///  memory budget used to plan the I/O ranks and rounds of a read.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "mpi_memory.hh"
+#include "serialize_data.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    const char* const MEMORY_TOTAL = "total";
+
+    /// Parses a byte count with an optional K, M or G suffix (powers of
+    /// 1024); returns 0 if the string is not a valid size.
+    static uint64_t parse_memory_size (const char* s)
+    {
+      char* end = NULL;
+      double value = strtod(s, &end);
+      if ((end == s) || (value < 0.0))
+        {
+          return 0;
+        }
+      while (isspace(*end))
+        {
+          end++;
+        }
+      switch (toupper(*end))
+        {
+        case 'G':
+          value *= 1024.0;
+          // fall through
+        case 'M':
+          value *= 1024.0;
+          // fall through
+        case 'K':
+          value *= 1024.0;
+          break;
+        case '\0':
+          break;
+        default:
+          return 0;
+        }
+      return (uint64_t)value;
+    }
+
+    struct memory_state_t
+    {
+      std::mutex mutex;
+      uint64_t budget;
+      map<string, memory_stats_t> stats;
+
+      memory_state_t ()
+        : budget(0)
+      {
+        const char* s = getenv("NEUROH5_MEMORY_BUDGET");
+        if (s != NULL)
+          {
+            budget = parse_memory_size(s);
+          }
+      }
+    };
+
+    static memory_state_t& memory_state ()
+    {
+      static memory_state_t state;
+      return state;
+    }
+
+    static void memory_add (map<string, memory_stats_t>& stats, const char* category, const uint64_t bytes)
+    {
+      memory_stats_t& s = stats[category];
+      s.current += bytes;
+      s.high_water = max(s.high_water, s.current);
+    }
+
+    static void memory_sub (map<string, memory_stats_t>& stats, const char* category, const uint64_t bytes)
+    {
+      memory_stats_t& s = stats[category];
+      s.current -= min(s.current, bytes);
+    }
+
+    void memory_acquire (const char* category, const uint64_t bytes)
+    {
+      if (bytes == 0)
+        {
+          return;
+        }
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      memory_add(state.stats, category, bytes);
+      memory_add(state.stats, MEMORY_TOTAL, bytes);
+    }
+
+    void memory_release (const char* category, const uint64_t bytes)
+    {
+      if (bytes == 0)
+        {
+          return;
+        }
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      memory_sub(state.stats, category, bytes);
+      memory_sub(state.stats, MEMORY_TOTAL, bytes);
+    }
+
+    void memory_reset ()
+    {
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      for (auto& it : state.stats)
+        {
+          it.second.high_water = it.second.current;
+        }
+    }
+
+    map<string, memory_stats_t> memory_local_stats ()
+    {
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      return state.stats;
+    }
+
+    map<string, memory_summary_t> memory_summary (MPI_Comm comm)
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      // the categories are gathered by name, since ranks that did not
+      // take part in a phase may not know all of them
+      map<string, uint64_t> local_high_water;
+      for (auto const& it : memory_local_stats())
+        {
+          local_high_water[it.first] = it.second.high_water;
+        }
+      vector<char> sendbuf, recvbuf;
+      data::serialize_data(local_high_water, sendbuf);
+
+      int sendcount = sendbuf.size();
+      vector<int> recvcounts(size, 0), rdispls(size, 0);
+      throw_assert_nomsg(MPI_Gather(&sendcount, 1, MPI_INT, recvcounts.data(), 1, MPI_INT, 0, comm) == MPI_SUCCESS);
+      if (rank == 0)
+        {
+          for (int r=1; r<size; r++)
+            {
+              rdispls[r] = rdispls[r-1] + recvcounts[r-1];
+            }
+          recvbuf.resize(rdispls[size-1] + recvcounts[size-1]);
+        }
+      throw_assert_nomsg(MPI_Gatherv(sendbuf.data(), sendcount, MPI_CHAR,
+                                     recvbuf.data(), recvcounts.data(), rdispls.data(), MPI_CHAR,
+                                     0, comm) == MPI_SUCCESS);
+
+      // category -> ranks, min, max, sum of high-water marks
+      map<string, vector<double> > summary_values;
+      if (rank == 0)
+        {
+          for (int r=0; r<size; r++)
+            {
+              map<string, uint64_t> rank_high_water;
+              data::deserialize_data(vector<char>(recvbuf.begin()+rdispls[r],
+                                                  recvbuf.begin()+rdispls[r]+recvcounts[r]),
+                                     rank_high_water);
+              for (auto const& it : rank_high_water)
+                {
+                  const double v = (double)it.second;
+                  auto summary_it = summary_values.find(it.first);
+                  if (summary_it == summary_values.end())
+                    {
+                      summary_values[it.first] = { 1.0, v, v, v };
+                    }
+                  else
+                    {
+                      vector<double>& s = summary_it->second;
+                      s[0] += 1.0;
+                      s[1] = min(s[1], v);
+                      s[2] = max(s[2], v);
+                      s[3] += v;
+                    }
+                }
+            }
+        }
+
+      vector<char> summary_buf;
+      uint32_t summary_buf_size = 0;
+      if (rank == 0)
+        {
+          data::serialize_data(summary_values, summary_buf);
+          summary_buf_size = summary_buf.size();
+        }
+      throw_assert_nomsg(MPI_Bcast(&summary_buf_size, 1, MPI_UINT32_T, 0, comm) == MPI_SUCCESS);
+      summary_buf.resize(summary_buf_size);
+      throw_assert_nomsg(MPI_Bcast(summary_buf.data(), summary_buf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS);
+      if (rank != 0)
+        {
+          data::deserialize_data(summary_buf, summary_values);
+        }
+
+      map<string, memory_summary_t> summary;
+      for (auto const& it : summary_values)
+        {
+          const vector<double>& s = it.second;
+          memory_summary_t& category_summary = summary[it.first];
+          category_summary.ranks           = (uint64_t)s[0];
+          category_summary.min_high_water  = (uint64_t)s[1];
+          category_summary.max_high_water  = (uint64_t)s[2];
+          category_summary.mean_high_water = s[3] / s[0];
+        }
+      return summary;
+    }
+
+    string format_memory_summary (const map<string, memory_summary_t>& summary)
+    {
+      size_t width = 8;
+      for (auto const& it : summary)
+        {
+          width = max(width, it.first.size());
+        }
+
+      stringstream ss;
+      char line[256];
+      snprintf(line, sizeof(line), "%-*s %6s %14s %14s %14s\n", (int)width,
+               "category", "ranks", "min (bytes)", "mean (bytes)", "max (bytes)");
+      ss << line;
+      for (auto const& it : summary)
+        {
+          const memory_summary_t& s = it.second;
+          snprintf(line, sizeof(line), "%-*s %6lu %14lu %14.0f %14lu\n", (int)width,
+                   it.first.c_str(), (unsigned long)s.ranks, (unsigned long)s.min_high_water,
+                   s.mean_high_water, (unsigned long)s.max_high_water);
+          ss << line;
+        }
+      return ss.str();
+    }
+
+    void set_memory_budget (const uint64_t bytes)
+    {
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      state.budget = bytes;
+    }
+
+    uint64_t memory_budget ()
+    {
+      memory_state_t& state = memory_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      return state.budget;
+    }
+
+    read_plan_t plan_read (const uint64_t data_bytes, const size_t num_items,
+                           const size_t comm_size, const size_t io_size,
+                           const double io_factor, const double recv_factor)
+    {
+      throw_assert_nomsg(comm_size > 0);
+
+      read_plan_t plan;
+      plan.io_size = max((size_t)1, min(io_size, comm_size));
+      plan.rounds  = 1;
+
+      const uint64_t budget = memory_budget();
+      if ((budget == 0) || (data_bytes == 0) || (num_items == 0))
+        {
+          return plan;
+        }
+
+      const double recv_bytes = recv_factor * (double)data_bytes / (double)comm_size;
+      const double io_bytes   = io_factor * (double)data_bytes;
+      if (recv_bytes + io_bytes / (double)plan.io_size <= (double)budget)
+        {
+          return plan;
+        }
+
+      if (recv_bytes >= (double)budget)
+        {
+          // the budget cannot be met; keep the transient data of each
+          // round within the budget
+          plan.io_size = comm_size;
+          plan.rounds  = min(num_items, (size_t)ceil(io_bytes / ((double)comm_size * (double)budget)));
+          return plan;
+        }
+
+      const double available = (double)budget - recv_bytes;
+      const double io_needed = ceil(io_bytes / available);
+      if (io_needed <= (double)comm_size)
+        {
+          plan.io_size = max(plan.io_size, (size_t)io_needed);
+        }
+      else
+        {
+          plan.io_size = comm_size;
+          plan.rounds  = min(num_items, (size_t)ceil(io_bytes / ((double)comm_size * available)));
+        }
+      return plan;
+    }
+
+  }
+}
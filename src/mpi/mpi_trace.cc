@@ -0,0 +1,306 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file mpi_trace.cc
+///
+///  Timing and volume counters for the phases of the collective readers
+///  and writers, with aggregation across ranks and export to the Chrome
+///  trace event format.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "mpi_trace.hh"
+#include "serialize_data.hh"
+#include "throw_assert.hh"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    struct trace_event_t
+    {
+      const char* phase;
+      chrono::steady_clock::time_point start;
+      chrono::steady_clock::time_point end;
+      uint64_t bytes, items;
+      size_t tid;
+    };
+
+    struct trace_state_t
+    {
+      std::mutex mutex;
+      bool enabled;
+      map<string, phase_stats_t> stats;
+      vector<trace_event_t> events;
+      map<std::thread::id, size_t> thread_ids;
+      // offset of the steady clock from the system clock, used to align
+      // the events of different ranks
+      chrono::system_clock::time_point system_origin;
+      chrono::steady_clock::time_point steady_origin;
+
+      trace_state_t ()
+        : system_origin(chrono::system_clock::now()),
+          steady_origin(chrono::steady_clock::now())
+      {
+        const char* s = getenv("NEUROH5_TRACE");
+        enabled = (s != NULL) && (atoi(s) != 0);
+      }
+    };
+
+    static trace_state_t& trace_state ()
+    {
+      static trace_state_t state;
+      return state;
+    }
+
+    void set_trace_enabled (const bool enabled)
+    {
+      trace_state_t& state = trace_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      state.enabled = enabled;
+    }
+
+    bool trace_enabled ()
+    {
+      trace_state_t& state = trace_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      return state.enabled;
+    }
+
+    void trace_record (const char* phase, const chrono::steady_clock::time_point& start,
+                       const chrono::steady_clock::time_point& end,
+                       const uint64_t bytes, const uint64_t items)
+    {
+      trace_state_t& state = trace_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      phase_stats_t& stats = state.stats[phase];
+      stats.calls++;
+      stats.seconds += chrono::duration<double>(end - start).count();
+      stats.bytes += bytes;
+      stats.items += items;
+      if (state.enabled)
+        {
+          auto it = state.thread_ids.find(std::this_thread::get_id());
+          if (it == state.thread_ids.end())
+            {
+              it = state.thread_ids.insert(make_pair(std::this_thread::get_id(),
+                                                     state.thread_ids.size())).first;
+            }
+          trace_event_t event = { phase, start, end, bytes, items, it->second };
+          state.events.push_back(event);
+        }
+    }
+
+    void trace_reset ()
+    {
+      trace_state_t& state = trace_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      state.stats.clear();
+      state.events.clear();
+    }
+
+    map<string, phase_stats_t> trace_local_stats ()
+    {
+      trace_state_t& state = trace_state();
+      std::lock_guard<std::mutex> guard(state.mutex);
+      return state.stats;
+    }
+
+    /// Gathers a buffer from every rank on rank 0.
+    static void gather_buffers (MPI_Comm comm, const vector<char>& sendbuf,
+                                vector<char>& recvbuf, vector<int>& recvcounts, vector<int>& rdispls)
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      int sendcount = sendbuf.size();
+      recvcounts.assign(size, 0);
+      rdispls.assign(size, 0);
+      throw_assert_nomsg(MPI_Gather(&sendcount, 1, MPI_INT, recvcounts.data(), 1, MPI_INT, 0, comm) == MPI_SUCCESS);
+      if (rank == 0)
+        {
+          for (int r=1; r<size; r++)
+            {
+              rdispls[r] = rdispls[r-1] + recvcounts[r-1];
+            }
+          recvbuf.resize(rdispls[size-1] + recvcounts[size-1]);
+        }
+      throw_assert_nomsg(MPI_Gatherv(sendbuf.data(), sendcount, MPI_CHAR,
+                                     recvbuf.data(), recvcounts.data(), rdispls.data(), MPI_CHAR,
+                                     0, comm) == MPI_SUCCESS);
+    }
+
+    map<string, phase_summary_t> trace_summary (MPI_Comm comm)
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      // phase -> calls, seconds, bytes, items
+      map<string, vector<double> > local_stats;
+      for (auto const& it : trace_local_stats())
+        {
+          local_stats[it.first] = { (double)it.second.calls, it.second.seconds,
+                                    (double)it.second.bytes, (double)it.second.items };
+        }
+      vector<char> sendbuf, recvbuf;
+      vector<int> recvcounts, rdispls;
+      data::serialize_data(local_stats, sendbuf);
+      gather_buffers(comm, sendbuf, recvbuf, recvcounts, rdispls);
+
+      // phase -> ranks, calls, min, max, sum of seconds, bytes, items
+      map<string, vector<double> > summary_values;
+      if (rank == 0)
+        {
+          for (int r=0; r<size; r++)
+            {
+              map<string, vector<double> > rank_stats;
+              data::deserialize_data(vector<char>(recvbuf.begin()+rdispls[r],
+                                                  recvbuf.begin()+rdispls[r]+recvcounts[r]),
+                                     rank_stats);
+              for (auto const& it : rank_stats)
+                {
+                  const vector<double>& v = it.second;
+                  auto summary_it = summary_values.find(it.first);
+                  if (summary_it == summary_values.end())
+                    {
+                      summary_values[it.first] = { 1.0, v[0], v[1], v[1], v[1], v[2], v[3] };
+                    }
+                  else
+                    {
+                      vector<double>& s = summary_it->second;
+                      s[0] += 1.0;
+                      s[1] += v[0];
+                      s[2] = min(s[2], v[1]);
+                      s[3] = max(s[3], v[1]);
+                      s[4] += v[1];
+                      s[5] += v[2];
+                      s[6] += v[3];
+                    }
+                }
+            }
+        }
+
+      vector<char> summary_buf;
+      uint32_t summary_buf_size = 0;
+      if (rank == 0)
+        {
+          data::serialize_data(summary_values, summary_buf);
+          summary_buf_size = summary_buf.size();
+        }
+      throw_assert_nomsg(MPI_Bcast(&summary_buf_size, 1, MPI_UINT32_T, 0, comm) == MPI_SUCCESS);
+      summary_buf.resize(summary_buf_size);
+      throw_assert_nomsg(MPI_Bcast(summary_buf.data(), summary_buf_size, MPI_CHAR, 0, comm) == MPI_SUCCESS);
+      if (rank != 0)
+        {
+          data::deserialize_data(summary_buf, summary_values);
+        }
+
+      map<string, phase_summary_t> summary;
+      for (auto const& it : summary_values)
+        {
+          const vector<double>& s = it.second;
+          phase_summary_t& phase_summary = summary[it.first];
+          phase_summary.ranks        = (uint64_t)s[0];
+          phase_summary.calls        = (uint64_t)s[1];
+          phase_summary.min_seconds  = s[2];
+          phase_summary.max_seconds  = s[3];
+          phase_summary.mean_seconds = s[4] / s[0];
+          phase_summary.bytes        = (uint64_t)s[5];
+          phase_summary.items        = (uint64_t)s[6];
+        }
+      return summary;
+    }
+
+    string format_trace_summary (const map<string, phase_summary_t>& summary)
+    {
+      size_t width = 5;
+      for (auto const& it : summary)
+        {
+          width = max(width, it.first.size());
+        }
+
+      stringstream ss;
+      char line[256];
+      snprintf(line, sizeof(line), "%-*s %6s %9s %11s %11s %11s %14s %12s\n", (int)width,
+               "phase", "ranks", "calls", "min (s)", "mean (s)", "max (s)", "bytes", "items");
+      ss << line;
+      for (auto const& it : summary)
+        {
+          const phase_summary_t& s = it.second;
+          snprintf(line, sizeof(line), "%-*s %6lu %9lu %11.4f %11.4f %11.4f %14lu %12lu\n", (int)width,
+                   it.first.c_str(), (unsigned long)s.ranks, (unsigned long)s.calls,
+                   s.min_seconds, s.mean_seconds, s.max_seconds,
+                   (unsigned long)s.bytes, (unsigned long)s.items);
+          ss << line;
+        }
+      return ss.str();
+    }
+
+    void write_trace (MPI_Comm comm, const string& file_name)
+    {
+      int rank, size;
+      throw_assert_nomsg(MPI_Comm_size(comm, &size) == MPI_SUCCESS);
+      throw_assert_nomsg(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS);
+
+      trace_state_t& state = trace_state();
+      stringstream ss;
+      {
+        std::lock_guard<std::mutex> guard(state.mutex);
+        const double origin_us =
+          chrono::duration<double, micro>(state.system_origin.time_since_epoch()).count();
+        ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << rank
+           << ",\"args\":{\"name\":\"rank " << rank << "\"}}";
+        char event[512];
+        for (const trace_event_t& e : state.events)
+          {
+            const double ts = origin_us +
+              chrono::duration<double, micro>(e.start - state.steady_origin).count();
+            const double dur = chrono::duration<double, micro>(e.end - e.start).count();
+            snprintf(event, sizeof(event),
+                     ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f,"
+                     "\"args\":{\"bytes\":%lu,\"items\":%lu}}",
+                     e.phase, rank, (unsigned long)e.tid, ts, dur,
+                     (unsigned long)e.bytes, (unsigned long)e.items);
+            ss << event;
+          }
+      }
+
+      const string& s = ss.str();
+      vector<char> sendbuf(s.begin(), s.end()), recvbuf;
+      vector<int> recvcounts, rdispls;
+      gather_buffers(comm, sendbuf, recvbuf, recvcounts, rdispls);
+
+      if (rank == 0)
+        {
+          ofstream out(file_name.c_str());
+          throw_assert(out.good(), "write_trace: unable to open " << file_name);
+          out << "{\"traceEvents\":[\n";
+          for (int r=0; r<size; r++)
+            {
+              if (r > 0)
+                {
+                  out << ",\n";
+                }
+              out.write(recvbuf.data() + rdispls[r], recvcounts[r]);
+            }
+          out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+          out.close();
+        }
+    }
+
+  }
+}
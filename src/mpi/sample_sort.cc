@@ -0,0 +1,66 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file sample_sort.cc
+///
+///  Distributed sample sort and bucket redistribution of integer keys.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include "sample_sort.hh"
+
+using namespace std;
+
+namespace neuroh5
+{
+  namespace mpi
+  {
+
+    void bucket_plan
+    (
+     MPI_Comm              comm,
+     const vector<rank_t>& dest_ranks,
+     bucket_plan_t&        plan
+     )
+    {
+      int ssize;
+      throw_assert(MPI_Comm_size(comm, &ssize) == MPI_SUCCESS,
+                   "bucket_plan: unable to obtain size of MPI communicator");
+      const size_t size = ssize;
+
+      plan.sendcounts.assign(size, 0);
+      plan.sdispls.assign(size, 0);
+      plan.recvcounts.assign(size, 0);
+      plan.rdispls.assign(size, 0);
+      plan.recv_perm.clear();
+
+      for (size_t i = 0; i < dest_ranks.size(); i++)
+        {
+          throw_assert(dest_ranks[i] < size,
+                       "bucket_plan: invalid destination rank " << dest_ranks[i]);
+          plan.sendcounts[dest_ranks[i]]++;
+        }
+      for (size_t p = 1; p < size; p++)
+        {
+          plan.sdispls[p] = plan.sdispls[p-1] + plan.sendcounts[p-1];
+        }
+
+      // stable counting sort of the elements by destination rank
+      plan.send_perm.resize(dest_ranks.size());
+      vector<int> offsets(plan.sdispls);
+      for (size_t i = 0; i < dest_ranks.size(); i++)
+        {
+          plan.send_perm[offsets[dest_ranks[i]]++] = i;
+        }
+
+      throw_assert(MPI_Alltoall(&plan.sendcounts[0], 1, MPI_INT,
+                                &plan.recvcounts[0], 1, MPI_INT, comm) == MPI_SUCCESS,
+                   "bucket_plan: error in MPI_Alltoall");
+      for (size_t p = 1; p < size; p++)
+        {
+          plan.rdispls[p] = plan.rdispls[p-1] + plan.recvcounts[p-1];
+        }
+    }
+
+  }
+}
@@ -0,0 +1,242 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_append_graph_edges.cc
+///
+///  Test for append_graph_edges: a projection appended in two batches
+///  from edges given in coordinate (COO) form, from edges given in
+///  compressed sparse row (CSR) form and from an edge map is read back
+///  with the edges and attributes written, by the serial and by the
+///  scatter reader.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "append_graph_edges.hh"
+#include "read_graph.hh"
+#include "scatter_read_graph.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 200, num_dst = 300;
+
+// the destinations given by a rank: those with dst % size == rank,
+// except that the last rank gives none and its destinations are given
+// by rank 0
+bool gives_destination (const NODE_IDX_T dst, const int rank, const int size)
+{
+  int giver = dst % size;
+  if ((size > 1) && (giver == size - 1))
+    giver = 0;
+  return giver == rank;
+}
+
+// the destinations of this rank, in descending order
+vector<NODE_IDX_T> rank_destinations (const edge_map_t& edges, const int rank, const int size)
+{
+  vector<NODE_IDX_T> dsts;
+  for (auto it = edges.crbegin(); it != edges.crend(); ++it)
+    {
+      if (gives_destination(it->first, rank, size))
+        dsts.push_back(it->first);
+    }
+  return dsts;
+}
+
+// appends the edges of this rank in coordinate form, with the edges of
+// the destinations interleaved
+void append_coo (const string& file_name, const edge_map_t& edges, const int rank, const int size)
+{
+  map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+  test::test_edge_attr_index(edge_attr_index);
+  vector<NODE_IDX_T> dst, src;
+  map<string, data::NamedAttrVal> edge_attr_map;
+  data::NamedAttrVal& synapses = edge_attr_map["Synapses"];
+  synapses.resize<float>(1);
+  synapses.resize<uint8_t>(1);
+  const vector<NODE_IDX_T> dsts = rank_destinations(edges, rank, size);
+  for (size_t e = 0; ; e++)
+    {
+      bool found = false;
+      for (const NODE_IDX_T d : dsts)
+        {
+          const edge_tuple_t& et = edges.at(d);
+          if (e >= get<0>(et).size())
+            continue;
+          found = true;
+          dst.push_back(d);
+          src.push_back(get<0>(et)[e]);
+          synapses.float_values[0].push_back(get<1>(et)[0].float_values[0][e]);
+          synapses.uint8_values[0].push_back(get<1>(et)[0].uint8_values[0][e]);
+        }
+      if (!found)
+        break;
+    }
+  assert(graph::append_graph_edges(MPI_COMM_WORLD, 1, file_name, "A", "B", edge_attr_index,
+                                   dst, src, edge_attr_map) == 0);
+  assert(dst.empty() && src.empty() && edge_attr_map.empty());
+}
+
+// appends the edges of this rank in compressed sparse row form, with
+// the destinations in descending order
+void append_csr (const string& file_name, const edge_map_t& edges, const int rank, const int size)
+{
+  map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+  test::test_edge_attr_index(edge_attr_index);
+  vector<NODE_IDX_T> dst_index, src;
+  vector<DST_PTR_T> dst_ptr(1, 0);
+  map<string, data::NamedAttrVal> edge_attr_map;
+  data::NamedAttrVal& synapses = edge_attr_map["Synapses"];
+  synapses.resize<float>(1);
+  synapses.resize<uint8_t>(1);
+  for (const NODE_IDX_T d : rank_destinations(edges, rank, size))
+    {
+      const edge_tuple_t& et = edges.at(d);
+      const data::AttrVal& attrs = get<1>(et)[0];
+      dst_index.push_back(d);
+      src.insert(src.end(), get<0>(et).begin(), get<0>(et).end());
+      synapses.float_values[0].insert(synapses.float_values[0].end(),
+                                      attrs.float_values[0].begin(), attrs.float_values[0].end());
+      synapses.uint8_values[0].insert(synapses.uint8_values[0].end(),
+                                      attrs.uint8_values[0].begin(), attrs.uint8_values[0].end());
+      dst_ptr.push_back(src.size());
+    }
+  vector<NODE_IDX_T> dst;
+  graph::expand_csr_destinations(dst_index, dst_ptr, dst);
+  assert(dst.size() == src.size());
+  for (size_t i = 0; i < dst_index.size(); i++)
+    {
+      for (DST_PTR_T e = dst_ptr[i]; e < dst_ptr[i+1]; e++)
+        assert(dst[e] == dst_index[i]);
+    }
+  assert(graph::append_graph_edges(MPI_COMM_WORLD, 1, file_name, "A", "B", edge_attr_index,
+                                   dst, src, edge_attr_map) == 0);
+}
+
+// appends the edges of this rank as an edge map
+void append_edge_map (const string& file_name, const edge_map_t& edges, const int rank, const int size)
+{
+  map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+  test::test_edge_attr_index(edge_attr_index);
+  edge_map_t rank_edge_map;
+  for (const NODE_IDX_T d : rank_destinations(edges, rank, size))
+    rank_edge_map.insert(*edges.find(d));
+  assert(graph::append_graph(MPI_COMM_WORLD, 1, file_name, "A", "B", edge_attr_index,
+                             rank_edge_map, 16) >= 0);
+}
+
+// asserts that the serial reader on each rank reads all edges, and the
+// scatter reader the edges of the nodes with node % size == rank
+void assert_file_edges (const string& file_name, const edge_map_t& edges, const int rank, const int size)
+{
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  size_t num_edges = 0;
+  for (auto const& it : edges)
+    num_edges += get<0>(it.second).size();
+
+  {
+    vector<edge_map_t> prj_vector;
+    vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+    size_t total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+    assert(graph::read_graph(MPI_COMM_SELF, file_name, vector<string>(1, "Synapses"), prj_names,
+                             prj_vector, edge_attr_names_vector,
+                             total_num_nodes, local_num_edges, total_num_edges) >= 0);
+    assert(prj_vector.size() == 1);
+    assert(total_num_edges == num_edges);
+    test::assert_same_edges(prj_vector[0], edges);
+  }
+
+  {
+    node_rank_map_t node_rank_map;
+    for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+      {
+        node_rank_map[n].insert(n % size);
+      }
+    vector<edge_map_t> prj_vector;
+    vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+    size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+    assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size,
+                                     vector<string>(1, "Synapses"), prj_names, node_rank_map,
+                                     prj_vector, edge_attr_names_vector,
+                                     local_num_nodes, total_num_nodes,
+                                     local_num_edges, total_num_edges) >= 0);
+    assert(prj_vector.size() == 1);
+    assert(total_num_edges == num_edges);
+    test::assert_same_edges(prj_vector[0], test::rank_edges(edges, rank, size));
+  }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const vector<string> file_names({ "test_append_graph_edges.coo.h5",
+                                    "test_append_graph_edges.csr.h5",
+                                    "test_append_graph_edges.map.h5" });
+
+  srand(53);
+  vector<edge_map_t> batches(2);
+  for (edge_map_t& batch : batches)
+    {
+      test::random_edge_map(0, num_src, num_src, num_dst, 6, batch);
+    }
+
+  if (rank == 0)
+    {
+      for (const string& file_name : file_names)
+        {
+          pop_range_map_t pop_ranges;
+          vector< pair<string,size_t> > populations;
+          populations.push_back(make_pair("A", (size_t)num_src));
+          populations.push_back(make_pair("B", (size_t)num_dst));
+          test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                                 set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+        }
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // each batch is appended to all files, and the files are read after
+  // each batch
+  edge_map_t edges;
+  for (const edge_map_t& batch : batches)
+    {
+      append_coo(file_names[0], batch, rank, size);
+      append_csr(file_names[1], batch, rank, size);
+      append_edge_map(file_names[2], batch, rank, size);
+      test::merge_edge_maps(edges, batch);
+      for (const string& file_name : file_names)
+        {
+          assert_file_edges(file_name, edges, rank, size);
+        }
+    }
+
+  for (const string& file_name : file_names)
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
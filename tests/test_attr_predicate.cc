@@ -0,0 +1,216 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_attr_predicate.cc
+///
+///  Test for the attribute predicates of the scatter reads: the cells
+///  that match are returned with exactly the attributes of the mask,
+///  including when the predicate uses attributes outside the mask.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "attr_predicate.hh"
+#include "cell_attributes.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+int32_t cell_layer (CELL_IDX_T gid) { return gid % 3; }
+// blocks of 7 cells are assigned round-robin, so that every rank has
+// cells of each layer
+int cell_rank (CELL_IDX_T gid, int size) { return (gid / 7) % size; }
+int32_t cell_zone (CELL_IDX_T gid) { return gid % 5; }
+deque<float> cell_weights (CELL_IDX_T gid)
+{
+  deque<float> weights;
+  for (size_t i = 0; i < 2 + gid % 3; i++)
+    weights.push_back(gid + 0.25f * i);
+  return weights;
+}
+
+// asserts that the attributes read are exactly the expected ones, in
+// the order of the file
+void assert_attrs (const data::NamedAttrMap& attr_map, const vector<string>& float_names,
+                   const vector<string>& int32_names)
+{
+  vector< vector<string> > attr_names;
+  attr_map.attr_names(attr_names);
+  for (size_t i = 0; i < attr_names.size(); i++)
+    {
+      if (i == data::AttrMap::attr_index_float)
+        assert(attr_names[i] == float_names);
+      else if (i == data::AttrMap::attr_index_int32)
+        assert(attr_names[i] == int32_names);
+      else
+        assert(attr_names[i].empty());
+    }
+  assert(attr_map.num_attr<float>() == float_names.size());
+  assert(attr_map.num_attr<int32_t>() == int32_names.size());
+}
+
+// asserts that the local cells are the expected ones with their values
+void assert_values (data::NamedAttrMap& attr_map, const set<CELL_IDX_T>& expected,
+                    const vector<string>& float_names, const vector<string>& int32_names)
+{
+  assert(attr_map.index_set == expected);
+  for (const CELL_IDX_T gid : expected)
+    {
+      for (const string& name : float_names)
+        {
+          assert(name == "Weight");
+          CELL_IDX_T index = gid;
+          assert(attr_map.find_name<float>(name, index) == cell_weights(gid));
+        }
+      for (const string& name : int32_names)
+        {
+          CELL_IDX_T index = gid;
+          const deque<int32_t> values = attr_map.find_name<int32_t>(name, index);
+          assert(values.size() == 1);
+          assert(values[0] == ((name == "Layer") ? cell_layer(gid) : cell_zone(gid)));
+        }
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_attr_predicate.h5";
+  const string pop_name = "GC", name_space = "Attributes";
+  const CELL_IDX_T num_cells = 600;
+
+  // the file is written by rank 0 alone and read by all ranks; the
+  // predicate attribute Layer is written before Zone, so that removing
+  // it renumbers the int32 attributes
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      test::create_test_file(MPI_COMM_SELF, file_name,
+                             vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                             set< pair<pop_t,pop_t> >(), pop_ranges);
+      map<string, map<CELL_IDX_T, deque<int32_t> > > int32_values;
+      map<string, map<CELL_IDX_T, deque<float> > > float_values;
+      for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+        {
+          int32_values["Layer"][gid] = deque<int32_t>(1, cell_layer(gid));
+          int32_values["Zone"][gid] = deque<int32_t>(1, cell_zone(gid));
+          float_values["Weight"][gid] = cell_weights(gid);
+        }
+      cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, name_space, pop_name, 0,
+                                       map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                       int32_values,
+                                       map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                       float_values, 1, data::optional_hid());
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  node_rank_map_t node_rank_map;
+  vector<CELL_IDX_T> selection;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      node_rank_map[gid].insert(cell_rank(gid, size));
+      if ((cell_rank(gid, size) == rank) && (gid % 4 != 0))
+        selection.push_back(gid);
+    }
+
+  // Layer == 1 && Zone >= 2
+  data::AttrPredicate predicate;
+  predicate.add("Layer", data::AttrEqual, 1).add("Zone", data::AttrGreaterEqual, 2);
+  set<CELL_IDX_T> expected, expected_selection;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      if ((cell_rank(gid, size) == rank) && (cell_layer(gid) == 1) && (cell_zone(gid) >= 2))
+        {
+          expected.insert(gid);
+          if (gid % 4 != 0)
+            expected_selection.insert(gid);
+        }
+    }
+  assert(!expected_selection.empty());
+
+  for (const int io_size : { 1, size })
+    {
+      // Layer is read only to evaluate the predicate; Zone is also in
+      // the mask and is kept
+      {
+        set<string> attr_mask;
+        attr_mask.insert("Weight");
+        attr_mask.insert("Zone");
+        const vector<string> float_names(1, "Weight"), int32_names(1, "Zone");
+
+        data::NamedAttrMap attr_map;
+        cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, io_size, name_space, attr_mask,
+                                           node_rank_map, pop_name, 0, attr_map, 0, 0, predicate);
+        assert_attrs(attr_map, float_names, int32_names);
+        assert_values(attr_map, expected, float_names, int32_names);
+
+        data::NamedAttrMap selection_map;
+        cell::scatter_read_cell_attribute_selection(MPI_COMM_WORLD, file_name, io_size, name_space, attr_mask,
+                                                    pop_name, 0, selection, selection_map, predicate);
+        assert_attrs(selection_map, float_names, int32_names);
+        assert_values(selection_map, expected_selection, float_names, int32_names);
+      }
+
+      // the mask holds none of the predicate attributes
+      {
+        const set<string> attr_mask({ "Weight" });
+        const vector<string> float_names(1, "Weight"), int32_names;
+
+        data::NamedAttrMap attr_map;
+        cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, io_size, name_space, attr_mask,
+                                           node_rank_map, pop_name, 0, attr_map, 0, 0, predicate);
+        assert_attrs(attr_map, float_names, int32_names);
+        assert_values(attr_map, expected, float_names, int32_names);
+
+        data::NamedAttrMap selection_map;
+        cell::scatter_read_cell_attribute_selection(MPI_COMM_WORLD, file_name, io_size, name_space, attr_mask,
+                                                    pop_name, 0, selection, selection_map, predicate);
+        assert_attrs(selection_map, float_names, int32_names);
+        assert_values(selection_map, expected_selection, float_names, int32_names);
+      }
+
+      // an empty mask reads all attributes
+      {
+        const vector<string> float_names(1, "Weight");
+        vector<string> int32_names;
+        int32_names.push_back("Layer");
+        int32_names.push_back("Zone");
+
+        data::NamedAttrMap attr_map;
+        cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, io_size, name_space, set<string>(),
+                                           node_rank_map, pop_name, 0, attr_map, 0, 0, predicate);
+        assert_attrs(attr_map, float_names, int32_names);
+        assert_values(attr_map, expected, float_names, int32_names);
+      }
+    }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,208 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_balance_indegree.cc
+///
+///  Test for in-degree balancing: the part weights must be the sums of
+///  the normalized in-degrees computed from the edges read with
+///  scatter_read_graph, and no worse balanced than the serpentine deal
+///  of the nodes sorted by in-degree.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "vertex_degree.hh"
+#include "balance_graph_indegree.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// edges with a few heavy destinations
+void append_test_edges (const CELL_IDX_T src_start, const CELL_IDX_T src_count,
+                        const CELL_IDX_T dst_start, const CELL_IDX_T dst_count,
+                        const size_t seed, edge_map_t& edge_map)
+{
+  srand(seed);
+  for (CELL_IDX_T d = 0; d < dst_count; d++)
+    {
+      vector<NODE_IDX_T> srcs;
+      const size_t num_edges = (d % 37 == 0) ? 40 + rand() % 60 : rand() % 6;
+      for (size_t e = 0; e < num_edges; e++)
+        {
+          srcs.push_back(src_start + rand() % src_count);
+        }
+      if (!srcs.empty())
+        {
+          edge_map[dst_start + d] = make_tuple(srcs, vector<data::AttrVal>());
+        }
+    }
+}
+
+// maximum part weight of the nodes sorted by decreasing in-degree and
+// dealt to the parts in serpentine order
+double serpentine_max_weight (const vector<double>& weights, const size_t nparts)
+{
+  vector< pair<float, NODE_IDX_T> > order;
+  for (NODE_IDX_T n = 0; n < weights.size(); n++)
+    {
+      order.push_back(make_pair(-(float)weights[n], n));
+    }
+  sort(order.begin(), order.end());
+  vector<double> part_weights(nparts, 0.0);
+  for (size_t pos = 0; pos < order.size(); pos++)
+    {
+      const size_t round = pos / nparts, j = pos % nparts;
+      const size_t p = (round % 2 == 0) ? j : (nparts - 1 - j);
+      part_weights[p] += weights[order[pos].second];
+    }
+  return *max_element(part_weights.begin(), part_weights.end());
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_balance_indegree.h5";
+  const CELL_IDX_T num_a = 500, num_b = 400, num_c = 100;
+  const size_t num_nodes = num_a + num_b + num_c;
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  prj_names.push_back(make_pair("B", "B"));
+  prj_names.push_back(make_pair("C", "A"));
+
+  // the file is written by rank 0 alone and read by all ranks
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_a));
+      populations.push_back(make_pair("B", (size_t)num_b));
+      populations.push_back(make_pair("C", (size_t)num_c));
+      set< pair<pop_t,pop_t> > pop_pairs;
+      pop_pairs.insert(make_pair(0, 1));
+      pop_pairs.insert(make_pair(1, 1));
+      pop_pairs.insert(make_pair(2, 0));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations, pop_pairs, pop_ranges);
+
+      const map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      edge_map_t ab_edges, bb_edges, ca_edges;
+      append_test_edges(0, num_a, num_a, num_b, 21, ab_edges);
+      append_test_edges(num_a, num_b, num_a, num_b, 23, bb_edges);
+      append_test_edges(num_a + num_b, num_c, 0, num_a / 2, 29, ca_edges);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, ab_edges, 64) >= 0);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "B", "B", edge_attr_index, bb_edges, 64) >= 0);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "C", "A", edge_attr_index, ca_edges, 64) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // normalized in-degree of every node from the edges
+  vector<double> weights(num_nodes, 0.0);
+  {
+    node_rank_map_t node_rank_map;
+    for (NODE_IDX_T n = 0; n < num_nodes; n++)
+      {
+        node_rank_map[n].insert(n % size);
+      }
+    vector<edge_map_t> prj_vector;
+    vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+    size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+    assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size, vector<string>(),
+                                     prj_names, node_rank_map, prj_vector, edge_attr_names_vector,
+                                     local_num_nodes, total_num_nodes,
+                                     local_num_edges, total_num_edges) >= 0);
+    vector< map<NODE_IDX_T, size_t> > degree_maps;
+    graph::vertex_degree(prj_vector, false, degree_maps);
+    for (const map<NODE_IDX_T, size_t>& degree_map : degree_maps)
+      {
+        uint64_t sum_indegree = 0;
+        for (auto const& it : degree_map) sum_indegree += it.second;
+        MPI_Allreduce(MPI_IN_PLACE, &sum_indegree, 1, MPI_UINT64_T, MPI_SUM, MPI_COMM_WORLD);
+        for (auto const& it : degree_map)
+          {
+            weights[it.first] += (double)it.second / (double)sum_indegree;
+          }
+      }
+    MPI_Allreduce(MPI_IN_PLACE, &weights[0], num_nodes, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  }
+  size_t num_weighted = 0;
+  for (const double w : weights) num_weighted += (w > 0.0) ? 1 : 0;
+  assert((num_weighted > 0) && (num_weighted < num_nodes));
+
+  for (const size_t nparts : { (size_t)1, (size_t)3, (size_t)(2*size + 5) })
+    {
+      NODE_IDX_T node_start = 0;
+      vector<NODE_IDX_T> parts;
+      vector<double> part_weights;
+      vector<size_t> part_sizes;
+      assert(graph::balance_graph_indegree(MPI_COMM_WORLD, file_name, prj_names, nparts,
+                                           node_start, parts, part_weights, part_sizes) >= 0);
+      assert(part_weights.size() == nparts);
+      assert(part_sizes.size() == nparts);
+
+      // the ranges of the ranks cover all nodes in order
+      int num_local = parts.size();
+      vector<int> counts(size), displs(size, 0);
+      MPI_Allgather(&num_local, 1, MPI_INT, &counts[0], 1, MPI_INT, MPI_COMM_WORLD);
+      for (int r = 1; r < size; r++)
+        {
+          displs[r] = displs[r-1] + counts[r-1];
+        }
+      assert((size_t)(displs[size-1] + counts[size-1]) == num_nodes);
+      assert(node_start == (NODE_IDX_T)displs[rank]);
+      vector<NODE_IDX_T> all_parts(num_nodes);
+      MPI_Allgatherv(parts.data(), num_local, MPI_NODE_IDX_T, all_parts.data(), &counts[0], &displs[0],
+                     MPI_NODE_IDX_T, MPI_COMM_WORLD);
+
+      vector<double> expected_weights(nparts, 0.0);
+      vector<size_t> expected_sizes(nparts, 0);
+      for (NODE_IDX_T n = 0; n < num_nodes; n++)
+        {
+          assert(all_parts[n] < nparts);
+          expected_weights[all_parts[n]] += weights[n];
+          expected_sizes[all_parts[n]]++;
+        }
+      assert(part_sizes == expected_sizes);
+      double total_weight = 0.0;
+      for (size_t p = 0; p < nparts; p++)
+        {
+          assert(fabs(part_weights[p] - expected_weights[p]) <= 1e-9);
+          total_weight += part_weights[p];
+        }
+      assert(fabs(total_weight - prj_names.size()) <= 1e-9);
+
+      const double max_weight = *max_element(part_weights.begin(), part_weights.end());
+      assert(max_weight <= serpentine_max_weight(weights, nparts) + 1e-9);
+      const size_t max_size = *max_element(part_sizes.begin(), part_sizes.end());
+      const size_t min_size = *min_element(part_sizes.begin(), part_sizes.end());
+      assert(max_size - min_size <= num_nodes / nparts / 4 + 1);
+    }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
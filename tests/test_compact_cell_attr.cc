@@ -0,0 +1,266 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_compact_cell_attr.cc
+///
+///  Test for compact_cell_attributes: a namespace appended with
+///  duplicate cells out of order is rewritten with unique cells in
+///  ascending order, keeping the values appended last, replaces the
+///  original namespace and is marked as sorted until the next append.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+#include <hdf5.h>
+
+#include "neuroh5_types.hh"
+#include "cell_attributes.hh"
+#include "compact_cell_attributes.hh"
+#include "group_flag.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const string pop_name = "GC", name_space = "Attributes";
+const CELL_IDX_T num_cells = 200;
+
+deque<float> cell_weights (const CELL_IDX_T gid, const int part)
+{
+  deque<float> weights;
+  for (int i = 0; i < 1 + (int)(gid + part) % 3; i++)
+    weights.push_back(gid + 0.25f * i + 1000.0f * part);
+  return weights;
+}
+
+int32_t cell_layer (const CELL_IDX_T gid, const int part) { return gid % 4 + 10 * part; }
+
+// cells of the three appended parts: the later parts repeat cells of
+// the earlier ones and hold cells that precede them
+bool in_part (const CELL_IDX_T gid, const int part)
+{
+  switch (part)
+    {
+    case 1: return gid >= 100;
+    case 2: return (gid < 150) && (gid % 3 == 0);
+    case 3: return (gid >= 50) && (gid < 120) && (gid % 5 == 0);
+    }
+  return false;
+}
+
+// Layer is not appended in part 2, so that each attribute has its own
+// cell index
+bool has_layer (const int part) { return part != 2; }
+
+void append_part (const string& file_name, const int part)
+{
+  map<string, map<CELL_IDX_T, deque<int32_t> > > int32_values;
+  map<string, map<CELL_IDX_T, deque<float> > > float_values;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      if (in_part(gid, part))
+        {
+          float_values["Weight"][gid] = cell_weights(gid, part);
+          if (has_layer(part))
+            int32_values["Layer"][gid] = deque<int32_t>(1, cell_layer(gid, part));
+        }
+    }
+  cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, name_space, pop_name, 0,
+                                   map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                   int32_values,
+                                   map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                   float_values, 1, data::optional_hid());
+}
+
+// returns the cell index of an attribute, in file order
+vector<CELL_IDX_T> read_cell_index (hid_t file, const string& attr_name)
+{
+  const string path = hdf5::cell_attribute_path(name_space, pop_name, attr_name) + "/" + hdf5::CELL_INDEX;
+  hid_t dset = H5Dopen2(file, path.c_str(), H5P_DEFAULT);
+  assert(dset >= 0);
+  hid_t fspace = H5Dget_space(dset);
+  assert(fspace >= 0);
+  vector<CELL_IDX_T> index(H5Sget_simple_extent_npoints(fspace));
+  if (index.size() > 0)
+    assert(H5Dread(dset, H5T_NATIVE_UINT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, index.data()) >= 0);
+  assert(H5Sclose(fspace) >= 0);
+  assert(H5Dclose(dset) >= 0);
+  return index;
+}
+
+// returns the value of the last part that holds gid, or -1 if none
+int last_part (const CELL_IDX_T gid, const bool layer)
+{
+  for (int part = 3; part >= 1; part--)
+    {
+      if (in_part(gid, part) && (!layer || has_layer(part)))
+        return part;
+    }
+  return -1;
+}
+
+// asserts that the cells of this rank have the values appended last
+void assert_values (data::NamedAttrMap& attr_map, const int rank, const int size,
+                    const CELL_IDX_T extra_gid)
+{
+  set<CELL_IDX_T> expected;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      if (((int)(gid % size) != rank) || ((last_part(gid, false) < 0) && (gid != extra_gid)))
+        continue;
+      expected.insert(gid);
+      CELL_IDX_T index = gid;
+      const int weight_part = (gid == extra_gid) ? 4 : last_part(gid, false);
+      assert(attr_map.find_name<float>("Weight", index) == cell_weights(gid, weight_part));
+      const int layer_part = (gid == extra_gid) ? 4 : last_part(gid, true);
+      index = gid;
+      const deque<int32_t> layers = attr_map.find_name<int32_t>("Layer", index);
+      if (layer_part < 0)
+        assert(layers.empty());
+      else
+        assert(layers == deque<int32_t>(1, cell_layer(gid, layer_part)));
+    }
+  assert(attr_map.index_set == expected);
+}
+
+// reads the namespace with the scatter reader and the selection reader
+void read_and_check (const string& file_name, const int rank, const int size,
+                     const CELL_IDX_T extra_gid)
+{
+  node_rank_map_t node_rank_map;
+  vector<CELL_IDX_T> selection;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      node_rank_map[gid].insert(gid % size);
+    }
+  // the selection is in descending order
+  for (CELL_IDX_T gid = num_cells; gid > 0; gid--)
+    {
+      if ((int)((gid - 1) % size) == rank)
+        selection.push_back(gid - 1);
+    }
+
+  data::NamedAttrMap attr_map;
+  cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, size, name_space, set<string>(),
+                                     node_rank_map, pop_name, 0, attr_map);
+  assert_values(attr_map, rank, size, extra_gid);
+
+  data::NamedAttrMap selection_map;
+  cell::read_cell_attribute_selection(MPI_COMM_WORLD, file_name, name_space, set<string>(),
+                                      pop_name, 0, selection, selection_map);
+  assert_values(selection_map, rank, size, extra_gid);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_compact_cell_attr.h5";
+  const string attr_prefix = hdf5::cell_attribute_prefix(name_space, pop_name);
+  const string compact_attr_prefix = hdf5::cell_attribute_prefix(name_space + ".compact", pop_name);
+
+  // the file is written and compacted by rank 0 alone and read by all
+  // ranks
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      test::create_test_file(MPI_COMM_SELF, file_name,
+                             vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                             set< pair<pop_t,pop_t> >(), pop_ranges);
+      for (int part = 1; part <= 3; part++)
+        {
+          append_part(file_name, part);
+        }
+
+      hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      assert(file >= 0);
+      assert(!hdf5::get_group_flag(file, attr_prefix, hdf5::SORTED));
+      const vector<CELL_IDX_T> index = read_cell_index(file, "Weight");
+      size_t num_weights = 0;
+      for (int part = 1; part <= 3; part++)
+        for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+          num_weights += in_part(gid, part);
+      assert(index.size() == num_weights);
+      assert(H5Fclose(file) >= 0);
+
+      cell::compact_cell_attributes(MPI_COMM_SELF, file_name, name_space, pop_name, 64);
+
+      // the compacted namespace replaced the original one, is marked as
+      // sorted, and each attribute holds its cells once in ascending
+      // order
+      file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      assert(file >= 0);
+      assert(hdf5::get_group_flag(file, attr_prefix, hdf5::SORTED));
+      assert(H5Lexists(file, compact_attr_prefix.c_str(), H5P_DEFAULT) <= 0);
+      for (const bool layer : { false, true })
+        {
+          vector<CELL_IDX_T> expected;
+          for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+            {
+              if (last_part(gid, layer) >= 0)
+                expected.push_back(gid);
+            }
+          assert(read_cell_index(file, layer ? "Layer" : "Weight") == expected);
+        }
+      assert(H5Fclose(file) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the values read are those appended last, with the scatter reader
+  // and with the selection reader, which searches the sorted index
+  read_and_check(file_name, rank, size, num_cells);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // an append removes the flag; the cell appended is read with the
+  // others
+  const CELL_IDX_T extra_gid = 1;
+  assert(last_part(extra_gid, false) < 0);
+  if (rank == 0)
+    {
+      map<string, map<CELL_IDX_T, deque<int32_t> > > int32_values;
+      map<string, map<CELL_IDX_T, deque<float> > > float_values;
+      float_values["Weight"][extra_gid] = cell_weights(extra_gid, 4);
+      int32_values["Layer"][extra_gid] = deque<int32_t>(1, cell_layer(extra_gid, 4));
+      cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, name_space, pop_name, 0,
+                                       map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                       int32_values,
+                                       map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                       float_values, 1, data::optional_hid());
+      hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+      assert(file >= 0);
+      assert(!hdf5::get_group_flag(file, attr_prefix, hdf5::SORTED));
+      assert(H5Fclose(file) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+  read_and_check(file_name, rank, size, extra_gid);
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,207 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_contract_tree.cc
+///
+///  Test for the array-based tree contraction, compared with the
+///  recursive graph-based contraction it replaces.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include "neuroh5_types.hh"
+#include "ngraph.hh"
+#include "contract_tree.hh"
+#include "validate_tree.hh"
+
+using namespace std;
+using namespace neuroh5;
+using namespace NGraph;
+
+
+// The recursive depth-first contraction used by the SWC readers before
+// the array-based contraction, with the region test enabled when
+// regions is not NULL.
+void reference_contract_tree_dfs (const Graph &A,
+                                  const deque<LAYER_IDX_T>* regions,
+                                  const deque<SWC_TYPE_T>& types,
+                                  Graph::vertex_set& roots,
+                                  Graph &S, contraction_map_t& contraction_map,
+                                  Graph::vertex sp, Graph::vertex spp)
+{
+  for ( Graph::vertex_set::const_iterator p = roots.begin(); p != roots.end(); ++p)
+    {
+      deque <Graph::vertex> section_members;
+      Graph::vertex s, v = Graph::node (p);
+      LAYER_IDX_T p_region = regions ? (*regions)[v] : 0;
+      SWC_TYPE_T p_type = types[v];
+
+      if (contraction_map[sp].size() > 1)
+        {
+          section_members.push_back(v);
+          s = contraction_map.size();
+          contraction_map.insert(make_pair(s,section_members));
+          S.insert_vertex(s);
+          S.insert_edge(sp,s);
+        }
+      else
+        {
+          s = sp;
+          contraction_map[s].push_back(v);
+        }
+
+      Graph::vertex_set outs = A.out_neighbors(v);
+      bool region_change = false;
+      bool type_change = false;
+
+      while ((outs.size() == 1) && (!(region_change || type_change)))
+        {
+          v = Graph::node(outs.cbegin());
+          if (regions && ((*regions)[v] != p_region))
+            {
+              region_change = true;
+            }
+          else if (types[v] != p_type)
+            {
+              type_change = true;
+            }
+          else
+            {
+              contraction_map[s].push_back(v);
+              outs = A.out_neighbors(v);
+            }
+        }
+
+      if ((outs.size() == 0) && (contraction_map[s].size() == 1))
+        {
+          if (spp != v)
+            contraction_map[s].insert (contraction_map[s].begin(), spp);
+        }
+
+      if ((outs.size() > 1) || region_change || type_change)
+        {
+          for ( Graph::vertex_set::const_iterator out = outs.begin(); out != outs.end(); ++out)
+            {
+              Graph::vertex_set new_root;
+              new_root.insert(*out);
+              reference_contract_tree_dfs(A, regions, types, new_root, S, contraction_map, s, v);
+            }
+        }
+    }
+}
+
+
+// Builds the section vectors as the SWC readers did from the section
+// graph and contraction map.
+void reference_contract_tree (const deque<PARENT_NODE_IDX_T>& parents,
+                              const deque<SWC_TYPE_T>& types,
+                              const deque<LAYER_IDX_T>* regions,
+                              deque<SECTION_IDX_T>& src_vector,
+                              deque<SECTION_IDX_T>& dst_vector,
+                              deque<SECTION_IDX_T>& sec_vector)
+{
+  Graph A, S;
+  Graph::vertex_set roots;
+  for (size_t i=0; i<parents.size(); i++)
+    {
+      A.insert_vertex(i);
+      if (parents[i] > -1)
+        {
+          A.insert_edge(parents[i], i);
+        }
+      else
+        {
+          roots.insert(i);
+        }
+    }
+
+  contraction_map_t contraction_map;
+  S.insert_vertex(0);
+  reference_contract_tree_dfs(A, regions, types, roots, S, contraction_map, 0, 0);
+
+  sec_vector.push_back(contraction_map.size());
+  for (auto it = contraction_map.cbegin(); it != contraction_map.cend(); it++)
+    {
+      sec_vector.push_back(it->second.size());
+      sec_vector.insert(sec_vector.end(), it->second.begin(), it->second.end());
+    }
+  for (Graph::const_iterator p = S.begin(); p != S.end(); p++)
+    {
+      Graph::vertex u = Graph::node (p);
+      Graph::vertex_set outs = S.out_neighbors(u);
+      for (Graph::vertex_set::const_iterator s = outs.begin(); s != outs.end(); s++)
+        {
+          src_vector.push_back(u);
+          dst_vector.push_back(Graph::node (s));
+        }
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  srand(37);
+  cell::tree_workspace_t ws;
+  size_t num_multi_section = 0;
+
+  for (size_t t=0; t<2000; t++)
+    {
+      // random tree with runs of equal types and regions; long
+      // unbranched paths are likely when the parent is the previous point
+      const size_t num_points = 1 + rand() % 300;
+      const int branch_percent = rand() % 40;
+      deque<PARENT_NODE_IDX_T> parents;
+      deque<SWC_TYPE_T> types;
+      deque<LAYER_IDX_T> regions;
+      deque<COORD_T> xcoords, ycoords, zcoords;
+      deque<REALVAL_T> radiuses;
+      for (size_t i=0; i<num_points; i++)
+        {
+          if (i == 0)
+            parents.push_back(-1);
+          else if ((rand() % 100) < branch_percent)
+            parents.push_back(rand() % i);
+          else
+            parents.push_back(i-1);
+          types.push_back(((i == 0) || (rand() % 10 == 0)) ? (SWC_TYPE_T)(1 + rand() % 4) : types[parents[i]]);
+          regions.push_back(((i == 0) || (rand() % 15 == 0)) ? (LAYER_IDX_T)(rand() % 3) : regions[parents[i]]);
+          xcoords.push_back(i); ycoords.push_back(0.5 * i); zcoords.push_back(0.0);
+          radiuses.push_back(1.0);
+        }
+
+      for (int split_regions = 0; split_regions < 2; split_regions++)
+        {
+          const deque<LAYER_IDX_T>* region_ptr = split_regions ? &regions : NULL;
+
+          deque<SECTION_IDX_T> ref_src, ref_dst, ref_sec;
+          reference_contract_tree(parents, types, region_ptr, ref_src, ref_dst, ref_sec);
+
+          deque<SECTION_IDX_T> src, dst, sec;
+          cell::contract_tree(parents, types, region_ptr, 0, src, dst, sec, ws);
+
+          assert(src == ref_src);
+          assert(dst == ref_dst);
+          assert(sec == ref_sec);
+
+          // the validation without the section graph accepts the output
+          if (src.size() > 0)
+            {
+              neurotree_t tree = make_tuple(t, src, dst, sec, xcoords, ycoords, zcoords,
+                                            radiuses, regions, parents, types);
+              cell::validate_tree(tree, ws);
+              num_multi_section++;
+            }
+        }
+    }
+  assert(num_multi_section > 0);
+
+  return 0;
+}
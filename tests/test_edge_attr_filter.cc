@@ -0,0 +1,218 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_edge_attr_filter.cc
+///
+///  Test for the filtering of edges by attribute values: the destination
+///  pointer, source index and attribute columns of the edges read must
+///  hold exactly the edges that satisfy the predicates, with only the
+///  requested attributes.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "attr_index.hh"
+#include "append_graph.hh"
+#include "edge_attr_filter.hh"
+#include "read_projection_datasets.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 200, num_dst = 300;
+
+// every fifth destination has no edges, and every seventh has only
+// edges of type 0, which are all filtered out
+size_t num_edges (NODE_IDX_T d) { return (d % 5 == 4) ? 0 : 1 + d % 6; }
+NODE_IDX_T edge_src (NODE_IDX_T d, size_t e) { return (d * 7 + e * 13) % num_src; }
+uint8_t edge_type (NODE_IDX_T d, size_t e) { return (d % 7 == 0) ? 0 : (d + e) % 3; }
+float edge_weight (NODE_IDX_T d, size_t e) { return d + 0.5f * e; }
+uint16_t edge_distance (NODE_IDX_T d, size_t e) { return (e * 5 + d) % 25; }
+bool edge_kept (NODE_IDX_T d, size_t e) { return (edge_type(d, e) != 0) && (edge_distance(d, e) < 20); }
+
+typedef tuple<NODE_IDX_T, float, uint16_t> edge_t;
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_edge_attr_filter.h5";
+  const NODE_IDX_T dst_start = num_src;
+
+  // the file is written by rank 0 alone and read by all ranks
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("S", (size_t)num_src));
+      populations.push_back(make_pair("D", (size_t)num_dst));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+
+      data::AttrSet geometry_attrs, synapse_attrs;
+      geometry_attrs.add<uint16_t>("Distance");
+      synapse_attrs.add<float>("Weight");
+      synapse_attrs.add<uint8_t>("Type");
+      map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      edge_attr_index["Geometry"] = make_pair((size_t)0, data::AttrIndex(geometry_attrs));
+      edge_attr_index["Synapses"] = make_pair((size_t)1, data::AttrIndex(synapse_attrs));
+
+      edge_map_t edge_map;
+      for (NODE_IDX_T d = 0; d < num_dst; d++)
+        {
+          const size_t n = num_edges(d);
+          if (n == 0)
+            continue;
+          vector<NODE_IDX_T> srcs;
+          vector<float> weights;
+          vector<uint8_t> types;
+          vector<uint16_t> distances;
+          for (size_t e = 0; e < n; e++)
+            {
+              srcs.push_back(edge_src(d, e));
+              weights.push_back(edge_weight(d, e));
+              types.push_back(edge_type(d, e));
+              distances.push_back(edge_distance(d, e));
+            }
+          vector<data::AttrVal> edge_attr_values(2);
+          edge_attr_values[0].resize<uint16_t>(1);
+          edge_attr_values[0].insert(distances, edge_attr_index["Geometry"].second.attr_index<uint16_t>("Distance"));
+          edge_attr_values[1].resize<float>(1);
+          edge_attr_values[1].resize<uint8_t>(1);
+          edge_attr_values[1].insert(weights, edge_attr_index["Synapses"].second.attr_index<float>("Weight"));
+          edge_attr_values[1].insert(types, edge_attr_index["Synapses"].second.attr_index<uint8_t>("Type"));
+          edge_map[dst_start + d] = make_tuple(srcs, edge_attr_values);
+        }
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "S", "D", edge_attr_index, edge_map, 16) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Synapses: Type != 0, only Weight is returned; Geometry: Distance < 20
+  graph::EdgeAttrFilter edge_filter;
+  edge_filter.attr_masks["Synapses"].insert("Weight");
+  edge_filter.predicates["Synapses"].add("Type", data::AttrNotEqual, 0);
+  edge_filter.predicates["Geometry"].add("Distance", data::AttrLess, 20);
+  vector<string> attr_namespaces;
+  attr_namespaces.push_back("Geometry");
+  attr_namespaces.push_back("Synapses");
+
+  DST_BLK_PTR_T block_base;
+  DST_PTR_T edge_base;
+  vector<DST_BLK_PTR_T> dst_blk_ptr;
+  vector<NODE_IDX_T> dst_idx;
+  vector<DST_PTR_T> dst_ptr;
+  vector<NODE_IDX_T> src_idx;
+  size_t total_num_edges = 0;
+  hsize_t total_read_blocks = 0, local_read_blocks = 0;
+  assert(hdf5::read_projection_datasets(MPI_COMM_WORLD, file_name, "S", "D", block_base, edge_base,
+                                        dst_blk_ptr, dst_idx, dst_ptr, src_idx,
+                                        total_num_edges, total_read_blocks, local_read_blocks) >= 0);
+  const size_t num_read_dsts = dst_ptr.empty() ? 0 : dst_ptr.size() - 1;
+  const DST_PTR_T edge_count = src_idx.size();
+
+  map<string, data::NamedAttrVal> edge_attr_map;
+  assert(graph::read_filtered_edge_attributes(MPI_COMM_WORLD, file_name, "S", "D", attr_namespaces,
+                                              edge_filter, edge_base, edge_count,
+                                              dst_ptr, src_idx, edge_attr_map) >= 0);
+
+  // the destination pointer keeps one entry per destination read, and
+  // the columns are those requested, with one value per kept edge
+  assert(dst_ptr.size() == num_read_dsts + (num_read_dsts > 0 ? 1 : 0));
+  assert(dst_ptr.empty() || (dst_ptr.back() == src_idx.size()));
+  assert(edge_attr_map.size() == 2);
+  const data::NamedAttrVal& geometry = edge_attr_map["Geometry"];
+  const data::NamedAttrVal& synapses = edge_attr_map["Synapses"];
+  assert(geometry.uint16_names.size() == 1);
+  assert(geometry.uint16_values.size() == 1);
+  assert(geometry.uint16_values[geometry.uint16_names.at("Distance")].size() == src_idx.size());
+  assert(geometry.float_values.empty() && geometry.uint8_values.empty());
+  assert(synapses.float_names.size() == 1);
+  assert(synapses.float_values.size() == 1);
+  assert(synapses.float_values[synapses.float_names.at("Weight")].size() == src_idx.size());
+  assert(synapses.uint8_names.empty() && synapses.uint8_values.empty());
+  assert(synapses.uint16_values.empty());
+  const vector<uint16_t>& distances = geometry.uint16_values[geometry.uint16_names.at("Distance")];
+  const vector<float>& weights = synapses.float_values[synapses.float_names.at("Weight")];
+
+  // the kept edges of each destination read by this rank
+  size_t num_dsts = 0, num_kept = 0, num_emptied = 0;
+  for (size_t b = 0; b + 1 < dst_blk_ptr.size(); b++)
+    {
+      for (size_t i = dst_blk_ptr[b], ii = 0; i < dst_blk_ptr[b+1]; i++, ii++)
+        {
+          if (i + 1 >= dst_ptr.size())
+            continue;
+          const NODE_IDX_T d = dst_idx[b] + ii;
+          assert(d < num_dst);
+          vector<edge_t> expected, edges;
+          for (size_t e = 0; e < num_edges(d); e++)
+            {
+              if (edge_kept(d, e))
+                expected.push_back(make_tuple(edge_src(d, e), edge_weight(d, e), edge_distance(d, e)));
+            }
+          assert(dst_ptr[i] <= dst_ptr[i+1]);
+          for (size_t j = dst_ptr[i]; j < dst_ptr[i+1]; j++)
+            {
+              edges.push_back(make_tuple(src_idx[j], weights[j], distances[j]));
+            }
+          sort(expected.begin(), expected.end());
+          sort(edges.begin(), edges.end());
+          assert(edges == expected);
+          num_dsts++;
+          num_kept += edges.size();
+          if ((num_edges(d) > 0) && (d % 7 == 0))
+            {
+              assert(dst_ptr[i] == dst_ptr[i+1]);
+              num_emptied++;
+            }
+        }
+    }
+  assert(num_kept == src_idx.size());
+
+  // together the ranks read every destination with edges, including
+  // the ones whose edges are all filtered out
+  size_t expected_dsts = 0, expected_kept = 0, expected_emptied = 0;
+  for (NODE_IDX_T d = 0; d < num_dst; d++)
+    {
+      if (num_edges(d) == 0)
+        continue;
+      expected_dsts++;
+      expected_emptied += (d % 7 == 0) ? 1 : 0;
+      for (size_t e = 0; e < num_edges(d); e++)
+        expected_kept += edge_kept(d, e) ? 1 : 0;
+    }
+  MPI_Allreduce(MPI_IN_PLACE, &num_dsts, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &num_kept, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+  MPI_Allreduce(MPI_IN_PLACE, &num_emptied, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+  assert(num_dsts >= expected_dsts);
+  assert(num_kept == expected_kept);
+  assert(num_emptied == expected_emptied);
+  assert((expected_emptied > 0) && (expected_kept < total_num_edges));
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
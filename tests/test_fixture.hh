@@ -0,0 +1,288 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_fixture.hh
+///
+///  Helpers shared by the tests that write and read NeuroH5 files.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#ifndef TEST_FIXTURE_HH
+#define TEST_FIXTURE_HH
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+#include <hdf5.h>
+
+#include "neuroh5_types.hh"
+#include "create_population_h5types.hh"
+#include "contract_tree.hh"
+#include "attr_index.hh"
+#include "attr_val.hh"
+
+namespace neuroh5
+{
+  namespace test
+  {
+
+    /// Creates file_name on rank 0 of comm with the given populations,
+    /// laid out consecutively from gid 0, and the given projection
+    /// population pairs (at least one pair is required by the file
+    /// format). Collective on comm.
+    inline void create_test_file
+    (
+     MPI_Comm                                                comm,
+     const std::string&                                      file_name,
+     const std::vector< std::pair<std::string, size_t> >&    populations,
+     const std::set< std::pair<pop_t, pop_t> >&              pop_pairs,
+     pop_range_map_t&                                        pop_ranges
+     )
+    {
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+
+      pop_label_map_t pop_labels;
+      CELL_IDX_T pop_start = 0;
+      pop_ranges.clear();
+      for (size_t i=0; i<populations.size(); i++)
+        {
+          pop_range_t range;
+          range.start = pop_start;
+          range.count = populations[i].second;
+          range.pop = i;
+          pop_labels[i] = populations[i].first;
+          pop_ranges[i] = range;
+          pop_start += range.count;
+        }
+
+      std::set< std::pair<pop_t, pop_t> > file_pop_pairs(pop_pairs);
+      if (file_pop_pairs.empty())
+        {
+          file_pop_pairs.insert(std::make_pair(0, 0));
+        }
+
+      if (rank == 0)
+        {
+          hid_t file = H5Fcreate(file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+          assert(file >= 0);
+          assert(hdf5::create_population_h5types(file, pop_labels, pop_ranges, file_pop_pairs) == 0);
+          assert(H5Fclose(file) >= 0);
+        }
+      MPI_Barrier(comm);
+    }
+
+    /// Sets the edge attribute index of the projections written with
+    /// random_edge_map: a Synapses namespace with a float Weight and a
+    /// uint8 Type.
+    inline void test_edge_attr_index
+    (
+     std::map<std::string, std::pair<size_t, data::AttrIndex> >& edge_attr_index
+     )
+    {
+      data::AttrSet synapse_attrs;
+      synapse_attrs.add<float>("Weight");
+      synapse_attrs.add<uint8_t>("Type");
+      edge_attr_index.clear();
+      edge_attr_index["Synapses"] = std::make_pair((size_t)0, data::AttrIndex(synapse_attrs));
+    }
+
+    /// Returns random edges from the sources [src_start, src_start +
+    /// num_src) to the destinations [dst_start, dst_start + num_dst),
+    /// with up to max_edges edges per destination (some destinations
+    /// have none) and the attributes of test_edge_attr_index.
+    inline void random_edge_map
+    (
+     const NODE_IDX_T src_start,
+     const size_t num_src,
+     const NODE_IDX_T dst_start,
+     const size_t num_dst,
+     const size_t max_edges,
+     edge_map_t& edge_map
+     )
+    {
+      std::map<std::string, std::pair<size_t, data::AttrIndex> > edge_attr_index;
+      test_edge_attr_index(edge_attr_index);
+      const data::AttrIndex& attr_index = edge_attr_index["Synapses"].second;
+      edge_map.clear();
+      for (size_t d=0; d<num_dst; d++)
+        {
+          const size_t n = rand() % (max_edges + 1);
+          if (n == 0)
+            continue;
+          std::vector<NODE_IDX_T> srcs;
+          std::vector<float> weights;
+          std::vector<uint8_t> types;
+          for (size_t e=0; e<n; e++)
+            {
+              srcs.push_back(src_start + rand() % num_src);
+              weights.push_back((rand() % 1000) / 8.0);
+              types.push_back(rand() % 4);
+            }
+          std::vector<data::AttrVal> edge_attr_values(1);
+          edge_attr_values[0].resize<float>(1);
+          edge_attr_values[0].resize<uint8_t>(1);
+          edge_attr_values[0].insert(weights, attr_index.attr_index<float>("Weight"));
+          edge_attr_values[0].insert(types, attr_index.attr_index<uint8_t>("Type"));
+          edge_map[dst_start + d] = make_tuple(srcs, edge_attr_values);
+        }
+    }
+
+    /// Appends the edges of b to those of the same node in a, as an
+    /// appended projection holds them.
+    inline void merge_edge_maps (edge_map_t& a, const edge_map_t& b)
+    {
+      for (auto const& it : b)
+        {
+          auto a_it = a.find(it.first);
+          if (a_it == a.end())
+            {
+              a.insert(it);
+              continue;
+            }
+          std::vector<NODE_IDX_T>& adj = std::get<0>(a_it->second);
+          std::vector<data::AttrVal>& attrs = std::get<1>(a_it->second);
+          const std::vector<NODE_IDX_T>& b_adj = std::get<0>(it.second);
+          const std::vector<data::AttrVal>& b_attrs = std::get<1>(it.second);
+          adj.insert(adj.end(), b_adj.begin(), b_adj.end());
+          assert(attrs.size() == b_attrs.size());
+          for (size_t i=0; i<attrs.size(); i++)
+            {
+              attrs[i].append(b_attrs[i]);
+            }
+        }
+    }
+
+    /// Returns the edges of a node as (adjacent node, attribute values)
+    /// pairs in sorted order, with the values of all namespaces and types.
+    inline std::vector< std::pair<NODE_IDX_T, std::vector<double> > > sorted_edges
+    (
+     const std::tuple< std::vector<NODE_IDX_T>, std::vector<data::AttrVal> >& node_edges
+     )
+    {
+      const std::vector<NODE_IDX_T>& adj = std::get<0>(node_edges);
+      const std::vector<data::AttrVal>& attrs = std::get<1>(node_edges);
+      std::vector< std::pair<NODE_IDX_T, std::vector<double> > > edges;
+      for (size_t e=0; e<adj.size(); e++)
+        {
+          std::vector<double> values;
+          for (const data::AttrVal& v : attrs)
+            {
+              for (auto const& a : v.float_values) values.push_back(a.at(e));
+              for (auto const& a : v.uint8_values) values.push_back(a.at(e));
+              for (auto const& a : v.int8_values) values.push_back(a.at(e));
+              for (auto const& a : v.uint16_values) values.push_back(a.at(e));
+              for (auto const& a : v.int16_values) values.push_back(a.at(e));
+              for (auto const& a : v.uint32_values) values.push_back(a.at(e));
+              for (auto const& a : v.int32_values) values.push_back(a.at(e));
+            }
+          edges.push_back(std::make_pair(adj[e], values));
+        }
+      std::sort(edges.begin(), edges.end());
+      return edges;
+    }
+
+    /// Asserts that two edge maps have the same nodes with the same
+    /// edges; the edges of a node may be in any order.
+    inline void assert_same_edges (const edge_map_t& a, const edge_map_t& b)
+    {
+      assert(a.size() == b.size());
+      for (auto a_it = a.cbegin(), b_it = b.cbegin(); a_it != a.cend(); ++a_it, ++b_it)
+        {
+          assert(a_it->first == b_it->first);
+          assert(sorted_edges(a_it->second) == sorted_edges(b_it->second));
+        }
+    }
+
+    /// Returns the edges of the nodes assigned to rank by node % size.
+    inline edge_map_t rank_edges (const edge_map_t& edge_map, const int rank, const int size)
+    {
+      edge_map_t result;
+      for (auto const& it : edge_map)
+        {
+          if ((int)(it.first % size) == rank)
+            result.insert(it);
+        }
+      return result;
+    }
+
+    /// Removes file_name on rank 0 of comm once all ranks are done
+    /// with it.
+    inline void remove_test_file (MPI_Comm comm, const std::string& file_name)
+    {
+      int rank;
+      MPI_Comm_rank(comm, &rank);
+      MPI_Barrier(comm);
+      if (rank == 0)
+        {
+          remove(file_name.c_str());
+        }
+    }
+
+    /// Returns a random tree with the given number of points, mostly
+    /// unbranched, contracted into sections.
+    inline neurotree_t random_tree (const CELL_IDX_T gid, const size_t num_points)
+    {
+      std::deque<PARENT_NODE_IDX_T> parents;
+      std::deque<SWC_TYPE_T> swc_types;
+      std::deque<COORD_T> xcoords, ycoords, zcoords;
+      std::deque<REALVAL_T> radiuses;
+      std::deque<LAYER_IDX_T> layers;
+      for (size_t i=0; i<num_points; i++)
+        {
+          PARENT_NODE_IDX_T parent = -1;
+          COORD_T x = 0.0, y = 0.0, z = 0.0;
+          if (i > 0)
+            {
+              parent = (rand() % 10 == 0) ? rand() % i : i - 1;
+              x = xcoords[parent] + (rand() % 100) / 100.0 - 0.5;
+              y = ycoords[parent] + (rand() % 100) / 100.0;
+              z = zcoords[parent] + (rand() % 100) / 100.0 - 0.5;
+            }
+          parents.push_back(parent);
+          swc_types.push_back((i == 0) ? 1 : 3 + (rand() % 10 == 0));
+          xcoords.push_back(x);
+          ycoords.push_back(y);
+          zcoords.push_back(z);
+          radiuses.push_back((i == 0) ? 5.0 : 0.5 + (rand() % 100) / 100.0);
+          layers.push_back((LAYER_IDX_T)(y / 10.0) % 4);
+        }
+
+      std::deque<SECTION_IDX_T> src_vector, dst_vector, sec_vector;
+      cell::contract_tree(parents, swc_types, NULL, 0, src_vector, dst_vector, sec_vector);
+
+      return make_tuple(gid, src_vector, dst_vector, sec_vector, xcoords, ycoords, zcoords,
+                        radiuses, layers, parents, swc_types);
+    }
+
+    /// Asserts that two trees have the same gid and columns.
+    inline void assert_same_tree (const neurotree_t& a, const neurotree_t& b)
+    {
+      assert(std::get<0>(a) == std::get<0>(b));
+      assert(std::get<1>(a) == std::get<1>(b));
+      assert(std::get<2>(a) == std::get<2>(b));
+      assert(std::get<3>(a) == std::get<3>(b));
+      assert(std::get<4>(a) == std::get<4>(b));
+      assert(std::get<5>(a) == std::get<5>(b));
+      assert(std::get<6>(a) == std::get<6>(b));
+      assert(std::get<7>(a) == std::get<7>(b));
+      assert(std::get<8>(a) == std::get<8>(b));
+      assert(std::get<9>(a) == std::get<9>(b));
+      assert(std::get<10>(a) == std::get<10>(b));
+    }
+
+  }
+}
+
+#endif
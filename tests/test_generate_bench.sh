@@ -0,0 +1,47 @@
+#!/bin/bash
+
+set -e
+
+GENERATE_OPTS="-p A:2000 -p B:1500 -e A:B:8 -e B:B:4:powerlaw \
+  -a Synapses:weight:float -a Synapses:syn_type:uint8 \
+  -t B:40 -c B:Coordinates:X:float -c B:Coordinates:Y:float -s 7"
+
+## Generate the same file with one and with three ranks; the output
+## must not depend on the number of ranks or I/O ranks
+mpirun -n 1 ./build/neuroh5_generate $GENERATE_OPTS data/generate_test.h5
+mpirun -n 3 ./build/neuroh5_generate -i 2 $GENERATE_OPTS data/generate_test.3.h5
+h5diff data/generate_test.h5 data/generate_test.3.h5
+
+## Read the edges with the serial reader, and with the scatter reader
+## on one and on three ranks
+mpirun -n 1 ./build/neurograph_reader data/generate_test.h5
+mpirun -n 1 ./build/neurograph_scatter_read -a Synapses -i 1 -o data/generate_test.scatter1 data/generate_test.h5
+mpirun -n 3 ./build/neurograph_scatter_read -a Synapses -i 2 -o data/generate_test.scatter3 data/generate_test.h5
+
+num_edges=0
+for i in 0 1; do
+    ## Remove the leading space of the serial reader output
+    sed 's/^ //' data/generate_test.h5.$i.0.edges | cut -d' ' -f1,2 | sort > data/generate_test.$i.base.edges
+    cat data/generate_test.scatter1.$i.[0-9]*.edges | sort > data/generate_test.$i.scatter1.edges
+    cat data/generate_test.scatter3.$i.[0-9]*.edges | sort > data/generate_test.$i.scatter3.edges
+    cut -d' ' -f1,2 data/generate_test.$i.scatter3.edges | sort | diff -u - data/generate_test.$i.base.edges
+    diff -u data/generate_test.$i.scatter3.edges data/generate_test.$i.scatter1.edges
+    num_edges=$((num_edges + $(wc -l < data/generate_test.$i.base.edges)))
+done
+
+## The benchmark reads the same number of edges, trees and cells
+mpirun -n 3 ./build/neuroh5_bench -r 1 -i 2 -p A:B -p B:B -n Synapses -t B -a B:Coordinates \
+    -m read_graph,scatter_read_graph,bcast_graph,read_trees,scatter_read_trees,read_cell_attributes,scatter_read_cell_attributes \
+    -o data/generate_test.bench.json data/generate_test.h5
+
+bench_items () {
+    grep -o "\"mode\": \"$1\", \"repeat\": [0-9]*, \"items\": [0-9]*" data/generate_test.bench.json | sed 's/.*: //'
+}
+
+test "$(bench_items read_graph)" -eq $num_edges
+test "$(bench_items scatter_read_graph)" -eq $num_edges
+test "$(bench_items bcast_graph)" -eq $((3 * num_edges))
+test "$(bench_items read_trees:B)" -eq 1500
+test "$(bench_items scatter_read_trees:B)" -eq 1500
+test "$(bench_items read_cell_attributes:B:Coordinates)" -eq 1500
+test "$(bench_items scatter_read_cell_attributes:B:Coordinates)" -eq 1500
@@ -0,0 +1,246 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_merge.cc
+///
+///  Test for merge_files: the projections and a cell attribute namespace
+///  of two input files merged into one file are read with the edges and
+///  attributes read from the input files, and the merged file with
+///  copies of the inputs is read the same after the inputs are removed.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "cell_attributes.hh"
+#include "merge_files.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_a = 200, num_b = 300;
+const string name_space = "Attributes";
+
+deque<float> cell_weights (const CELL_IDX_T gid)
+{
+  deque<float> weights;
+  for (size_t i = 0; i < 1 + gid % 3; i++)
+    weights.push_back(gid + 0.125f * i);
+  return weights;
+}
+
+// writes input file i: the projection A -> B, the projection B -> A
+// in the second file only, and the Weight attribute of the cells of B
+// in the alternate blocks of 50 cells that start with block i
+void write_input (const string& file_name, const size_t i,
+                  const edge_map_t& ab_edges, const edge_map_t& ba_edges)
+{
+  pop_range_map_t pop_ranges;
+  vector< pair<string,size_t> > populations;
+  populations.push_back(make_pair("A", (size_t)num_a));
+  populations.push_back(make_pair("B", (size_t)num_b));
+  set< pair<pop_t,pop_t> > pop_pairs({ make_pair(0, 1) });
+  if (i == 1)
+    pop_pairs.insert(make_pair(1, 0));
+  test::create_test_file(MPI_COMM_SELF, file_name, populations, pop_pairs, pop_ranges);
+
+  map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+  test::test_edge_attr_index(edge_attr_index);
+  assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, ab_edges, 16) >= 0);
+  if (i == 1)
+    assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "B", "A", edge_attr_index, ba_edges, 16) >= 0);
+
+  map<string, map<CELL_IDX_T, deque<float> > > float_values;
+  for (CELL_IDX_T gid = num_a; gid < num_a + num_b; gid++)
+    {
+      if ((gid / 50) % 2 == i)
+        float_values["Weight"][gid] = cell_weights(gid);
+    }
+  cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, name_space, "B", num_a,
+                                   map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int32_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                   float_values, 1, data::optional_hid());
+}
+
+// the nodes assigned to ranks by node % size
+node_rank_map_t test_node_rank_map (const int size)
+{
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < num_a + num_b; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  return node_rank_map;
+}
+
+// reads the edges of this rank of the projection, and their total number
+void read_projection (const string& file_name, const pair<string,string>& prj_name,
+                      edge_map_t& edge_map, size_t& total_num_edges)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0;
+  total_num_edges = 0;
+  assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size,
+                                   vector<string>(1, "Synapses"),
+                                   vector< pair<string,string> >(1, prj_name),
+                                   test_node_rank_map(size), prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  edge_map = prj_vector[0];
+}
+
+// reads the Weight attribute of the cells of this rank
+map<CELL_IDX_T, vector<float> > read_weights (const string& file_name)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  data::NamedAttrMap attr_map;
+  cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, size, name_space, set<string>(),
+                                     test_node_rank_map(size), "B", num_a, attr_map);
+  map<CELL_IDX_T, vector<float> > weights;
+  for (const CELL_IDX_T gid : attr_map.index_set)
+    {
+      CELL_IDX_T index = gid;
+      const deque<float> values = attr_map.find_name<float>("Weight", index);
+      assert(!values.empty());
+      weights[gid] = vector<float>(values.begin(), values.end());
+    }
+  return weights;
+}
+
+// asserts that the merged file holds the edges and attributes read
+// from the input files
+void assert_merged_file (const string& file_name,
+                         const map< pair<string,string>, edge_map_t >& expected_edges,
+                         const map< pair<string,string>, size_t >& expected_num_edges,
+                         const map<CELL_IDX_T, vector<float> >& expected_weights)
+{
+  for (auto const& it : expected_edges)
+    {
+      edge_map_t edge_map;
+      size_t total_num_edges = 0;
+      read_projection(file_name, it.first, edge_map, total_num_edges);
+      assert(total_num_edges == expected_num_edges.at(it.first));
+      test::assert_same_edges(edge_map, it.second);
+    }
+  assert(read_weights(file_name) == expected_weights);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string merged_name = "test_merge.h5", copy_name = "test_merge.copy.h5";
+  const vector<string> input_names({ "test_merge.0.h5", "test_merge.1.h5" });
+  const pair<string,string> ab = make_pair("A", "B"), ba = make_pair("B", "A");
+
+  srand(47);
+  vector<edge_map_t> ab_edges(2);
+  edge_map_t ba_edges;
+  for (size_t i = 0; i < input_names.size(); i++)
+    {
+      test::random_edge_map(0, num_a, num_a, num_b, 4, ab_edges[i]);
+    }
+  test::random_edge_map(num_a, num_b, 0, num_a, 3, ba_edges);
+
+  if (rank == 0)
+    {
+      for (size_t i = 0; i < input_names.size(); i++)
+        {
+          write_input(input_names[i], i, ab_edges[i], ba_edges);
+        }
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the edges and attributes of this rank in the input files; the
+  // edges of a destination in both files are concatenated
+  map< pair<string,string>, edge_map_t > expected_edges;
+  map< pair<string,string>, size_t > expected_num_edges;
+  map<CELL_IDX_T, vector<float> > expected_weights;
+  for (size_t i = 0; i < input_names.size(); i++)
+    {
+      for (const pair<string,string>& prj_name : { ab, ba })
+        {
+          if ((prj_name == ba) && (i == 0))
+            continue;
+          edge_map_t edge_map;
+          size_t total_num_edges = 0;
+          read_projection(input_names[i], prj_name, edge_map, total_num_edges);
+          test::merge_edge_maps(expected_edges[prj_name], edge_map);
+          expected_num_edges[prj_name] += total_num_edges;
+        }
+      for (auto const& it : read_weights(input_names[i]))
+        {
+          assert(expected_weights.insert(it).second);
+        }
+    }
+  assert(expected_num_edges.at(ba) > 0);
+  assert(!expected_weights.empty());
+  edge_map_t all_ab_edges = ab_edges[0];
+  test::merge_edge_maps(all_ab_edges, ab_edges[1]);
+  test::assert_same_edges(expected_edges.at(ab), test::rank_edges(all_ab_edges, rank, size));
+  test::assert_same_edges(expected_edges.at(ba), test::rank_edges(ba_edges, rank, size));
+
+  // the inputs are merged by rank 0, once with all projections and
+  // namespaces of the inputs, referring to the input files, and once
+  // with the given projections and namespaces, with copies of the inputs
+  if (rank == 0)
+    {
+      vector< pair<string,string> > prj_names, name_spaces;
+      graph::merge_files(MPI_COMM_SELF, merged_name, input_names, prj_names, name_spaces);
+      const set< pair<string,string> > prj_name_set(prj_names.begin(), prj_names.end());
+      assert(prj_name_set.size() == 2);
+      assert(prj_name_set.count(ab) && prj_name_set.count(ba));
+      assert(name_spaces.size() == 1);
+      assert(name_spaces[0] == make_pair(string("B"), name_space));
+
+      vector< pair<string,string> > copy_prj_names({ ab, ba });
+      vector< pair<string,string> > copy_name_spaces(1, make_pair("B", name_space));
+      graph::merge_files(MPI_COMM_SELF, copy_name, input_names, copy_prj_names, copy_name_spaces, true);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  assert_merged_file(merged_name, expected_edges, expected_num_edges, expected_weights);
+  assert_merged_file(copy_name, expected_edges, expected_num_edges, expected_weights);
+
+  // the merged file with copies of the inputs does not need the inputs
+  for (const string& file_name : input_names)
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+  assert_merged_file(copy_name, expected_edges, expected_num_edges, expected_weights);
+
+  for (const string& file_name : { merged_name, copy_name })
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
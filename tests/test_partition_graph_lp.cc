@@ -0,0 +1,643 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_partition_graph_lp.cc
+///
+///  Test for label propagation partitioning, compared with the
+///  implementation that gathers the partitions of all nodes on every
+///  rank in each round.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "cell_populations.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "alltoallv_template.hh"
+#include "partition_graph_lp.hh"
+#include "throw_assert.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// the partitioner as it was before the ghost exchange
+namespace neuroh5
+{
+  namespace reference
+  {
+    using namespace graph;
+
+    /// Position of node in the sorted vector of all nodes.
+    static NODE_IDX_T node_position (const vector<NODE_IDX_T>& nodes, const NODE_IDX_T node)
+    {
+      auto it = lower_bound(nodes.begin(), nodes.end(), node);
+      throw_assert((it != nodes.end()) && (*it == node),
+                   "partition_graph_lp: node " << node << " is not in any of the partitioned populations");
+      return it - nodes.begin();
+    }
+
+    /// Rank that owns the node at the given position.
+    static rank_t position_owner (const vector<size_t>& node_dist, const NODE_IDX_T pos)
+    {
+      return upper_bound(node_dist.begin(), node_dist.end(), (size_t)pos) - node_dist.begin() - 1;
+    }
+
+    /// Gathers the partitions of the nodes owned by each rank into the
+    /// partitions of all nodes.
+    static void allgather_parts (MPI_Comm comm, const vector<size_t>& node_dist,
+                                 vector<uint32_t>& parts)
+    {
+      const size_t size = node_dist.size() - 1;
+      vector<int> recvcounts(size), displs(size);
+      for (size_t r=0; r<size; r++)
+        {
+          recvcounts[r] = node_dist[r+1] - node_dist[r];
+          displs[r] = node_dist[r];
+        }
+      throw_assert(MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL,
+                                  &parts[0], &recvcounts[0], &displs[0], MPI_UINT32_T,
+                                  comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allgatherv");
+    }
+
+    /// Total node count (constraint 0) and in-degree (constraint 1) of
+    /// each partition.
+    static void compute_loads (MPI_Comm comm, const size_t nparts, const vector<uint32_t>& parts,
+                               const size_t node_start, const vector<size_t>& in_degree,
+                               vector<double>& loads)
+    {
+      loads.assign(2*nparts, 0.0);
+      for (size_t i=0; i<in_degree.size(); i++)
+        {
+          const uint32_t p = parts[node_start+i];
+          loads[2*p] += 1.0;
+          loads[2*p+1] += in_degree[i];
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, &loads[0], 2*nparts, MPI_DOUBLE, MPI_SUM,
+                                 comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+    }
+
+    int partition_graph_lp
+    (
+     MPI_Comm                                       comm,
+     const string&                                  file_name,
+     const vector< pair<string, string> >&          prj_names,
+     const size_t                                   io_size,
+     const size_t                                   nparts,
+     const size_t                                   num_iterations,
+     const double                                   imbalance,
+     node_rank_map_t&                               node_rank_map,
+     size_t&                                        edge_cut
+     )
+    {
+      int rank, size;
+      throw_assert(MPI_Comm_size(comm, &size) == MPI_SUCCESS,
+                   "partition_graph_lp: unable to obtain MPI communicator size");
+      throw_assert(MPI_Comm_rank(comm, &rank) == MPI_SUCCESS,
+                   "partition_graph_lp: unable to obtain MPI communicator rank");
+      throw_assert(nparts > 0, "partition_graph_lp: number of partitions must be positive");
+      throw_assert(imbalance >= 0.0, "partition_graph_lp: imbalance must be non-negative");
+
+      // the partitioned nodes are those of all source and destination
+      // populations of the given projections
+      pop_label_map_t pop_labels;
+      pop_range_map_t pop_ranges;
+      size_t total_num_nodes = 0;
+      throw_assert_nomsg(cell::read_population_labels(comm, file_name, pop_labels) >= 0);
+      throw_assert_nomsg(cell::read_population_ranges(comm, file_name, pop_ranges, total_num_nodes) >= 0);
+
+      set<string> pop_names;
+      for (const auto& prj : prj_names)
+        {
+          pop_names.insert(prj.first);
+          pop_names.insert(prj.second);
+        }
+
+      vector<NODE_IDX_T> nodes;
+      for (const auto& label : pop_labels)
+        {
+          if (pop_names.erase(label.second) > 0)
+            {
+              auto range_it = pop_ranges.find(label.first);
+              throw_assert(range_it != pop_ranges.end(),
+                           "partition_graph_lp: population " << label.second << " has no range");
+              for (size_t i=0; i<range_it->second.count; i++)
+                {
+                  nodes.push_back(range_it->second.start + i);
+                }
+            }
+        }
+      throw_assert(pop_names.empty(),
+                   "partition_graph_lp: population " << *pop_names.begin() << " not found");
+      sort(nodes.begin(), nodes.end());
+      const size_t num_nodes = nodes.size();
+
+      // each rank owns a contiguous range of nodes and reads their
+      // incoming edges
+      vector<size_t> node_dist(size+1);
+      for (size_t r=0; r<=(size_t)size; r++)
+        {
+          node_dist[r] = num_nodes * r / size;
+        }
+      const size_t node_start = node_dist[rank];
+      const size_t num_local_nodes = node_dist[rank+1] - node_start;
+
+      vector<edge_map_t> prj_vector;
+      {
+        node_rank_map_t read_rank_map;
+        for (size_t r=0; r<(size_t)size; r++)
+          {
+            for (size_t i=node_dist[r]; i<node_dist[r+1]; i++)
+              {
+                read_rank_map[nodes[i]].insert(r);
+              }
+          }
+        vector<map<string, vector<vector<string> > > > edge_attr_names_vector;
+        vector<string> attr_namespaces;
+        size_t local_num_nodes = 0, local_num_edges = 0, total_num_edges = 0, total_read_nodes = 0;
+        throw_assert_nomsg(scatter_read_graph(comm, EdgeMapDst, file_name, io_size, attr_namespaces,
+                                              prj_names, read_rank_map, prj_vector, edge_attr_names_vector,
+                                              local_num_nodes, total_read_nodes,
+                                              local_num_edges, total_num_edges) >= 0);
+      }
+
+      // undirected adjacency of the local nodes: incoming edges are
+      // local, outgoing edges are sent to the owner of their source
+      vector<size_t> in_degree(num_local_nodes, 0);
+      vector<NODE_IDX_T> in_edges; // (local destination, source position) pairs
+      vector< vector<NODE_IDX_T> > rank_out_edges(size);
+      for (const edge_map_t& edge_map : prj_vector)
+        {
+          for (const auto& it : edge_map)
+            {
+              const NODE_IDX_T dst_pos = node_position(nodes, it.first);
+              throw_assert(position_owner(node_dist, dst_pos) == (rank_t)rank,
+                           "partition_graph_lp: node " << it.first << " was read on the wrong rank");
+              const NODE_IDX_T dst_local = dst_pos - node_start;
+              const vector<NODE_IDX_T>& src_vector = get<0>(it.second);
+              in_degree[dst_local] += src_vector.size();
+              for (const NODE_IDX_T src : src_vector)
+                {
+                  const NODE_IDX_T src_pos = node_position(nodes, src);
+                  if (src_pos == dst_pos)
+                    continue;
+                  in_edges.push_back(dst_local);
+                  in_edges.push_back(src_pos);
+                  vector<NODE_IDX_T>& out_edges = rank_out_edges[position_owner(node_dist, src_pos)];
+                  out_edges.push_back(src_pos);
+                  out_edges.push_back(dst_pos);
+                }
+            }
+        }
+      prj_vector.clear();
+
+      vector<int> sendcounts(size, 0), sdispls(size, 0), recvcounts(size, 0), rdispls(size, 0);
+      vector<NODE_IDX_T> out_sendbuf, out_recvbuf;
+      for (size_t r=0; r<(size_t)size; r++)
+        {
+          sdispls[r] = out_sendbuf.size();
+          out_sendbuf.insert(out_sendbuf.end(), rank_out_edges[r].begin(), rank_out_edges[r].end());
+          sendcounts[r] = out_sendbuf.size() - sdispls[r];
+          rank_out_edges[r].clear();
+        }
+      throw_assert_nomsg(mpi::alltoallv_vector<NODE_IDX_T>(comm, MPI_NODE_IDX_T, sendcounts, sdispls, out_sendbuf,
+                                                           recvcounts, rdispls, out_recvbuf) >= 0);
+      out_sendbuf.clear();
+
+      // adjacency in compressed sparse row form; parallel edges are kept
+      // and count as edges of higher weight
+      vector<size_t> adj_ptr(num_local_nodes+1, 0);
+      vector<NODE_IDX_T> adj;
+      for (size_t i=0; i<in_edges.size(); i+=2)
+        {
+          adj_ptr[in_edges[i]+1]++;
+        }
+      for (size_t i=0; i<out_recvbuf.size(); i+=2)
+        {
+          adj_ptr[out_recvbuf[i]-node_start+1]++;
+        }
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          adj_ptr[i+1] += adj_ptr[i];
+        }
+      adj.resize(adj_ptr[num_local_nodes]);
+      {
+        vector<size_t> fill(adj_ptr.begin(), adj_ptr.end()-1);
+        for (size_t i=0; i<in_edges.size(); i+=2)
+          {
+            adj[fill[in_edges[i]]++] = in_edges[i+1];
+          }
+        for (size_t i=0; i<out_recvbuf.size(); i+=2)
+          {
+            adj[fill[out_recvbuf[i]-node_start]++] = out_recvbuf[i+1];
+          }
+      }
+      in_edges.clear();
+      out_recvbuf.clear();
+
+      // total weights and maximum partition loads of both constraints
+      double totals[2] = { (double)num_local_nodes, 0.0 };
+      double max_weights[2] = { 1.0, 0.0 };
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          totals[1] += in_degree[i];
+          max_weights[1] = max(max_weights[1], (double)in_degree[i]);
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, totals, 2, MPI_DOUBLE, MPI_SUM, comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, max_weights, 2, MPI_DOUBLE, MPI_MAX, comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+      double max_loads[2];
+      for (size_t c=0; c<2; c++)
+        {
+          const double target = totals[c] / nparts;
+          max_loads[c] = max((1.0 + imbalance) * target, target + max_weights[c]);
+        }
+
+      // initial partition
+      vector<uint32_t> parts(num_nodes, 0);
+      if (!node_rank_map.empty())
+        {
+          for (size_t i=node_start; i<node_start+num_local_nodes; i++)
+            {
+              auto it = node_rank_map.find(nodes[i]);
+              throw_assert((it != node_rank_map.end()) && (!it->second.empty()),
+                           "partition_graph_lp: node " << nodes[i] << " has no initial partition");
+              const rank_t p = *(it->second.begin());
+              throw_assert(p < nparts,
+                           "partition_graph_lp: initial partition " << p << " of node " << nodes[i] <<
+                           " is out of range");
+              parts[i] = p;
+            }
+        }
+      else
+        {
+          // nodes with incoming edges are cut into contiguous ranges of
+          // equal in-degree, and the remaining nodes into contiguous
+          // ranges that bring every partition to the average node count
+          double local_sums[2] = { 0.0, 0.0 }, starts[2] = { 0.0, 0.0 };
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] > 0)
+                local_sums[1] += in_degree[i];
+              else
+                local_sums[0] += 1.0;
+            }
+          throw_assert(MPI_Exscan(local_sums, starts, 2, MPI_DOUBLE, MPI_SUM,
+                                  comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Exscan");
+          if (rank == 0)
+            {
+              starts[0] = starts[1] = 0.0;
+            }
+
+          vector<double> counts(nparts, 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] > 0)
+                {
+                  const double p = floor(nparts * (starts[1] + 0.5 * in_degree[i]) / totals[1]);
+                  parts[node_start+i] = min((double)(nparts-1), max(0.0, p));
+                  counts[parts[node_start+i]] += 1.0;
+                  starts[1] += in_degree[i];
+                }
+            }
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &counts[0], nparts, MPI_DOUBLE, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+
+          // remaining capacity of each partition for nodes without
+          // incoming edges
+          vector<double> capacity_end(nparts, 0.0);
+          double total_capacity = 0.0;
+          for (size_t p=0; p<nparts; p++)
+            {
+              total_capacity += max(0.0, totals[0] / nparts - counts[p]);
+              capacity_end[p] = total_capacity;
+            }
+          const double num_unconnected = totals[0] - accumulate(counts.begin(), counts.end(), 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              if (in_degree[i] == 0)
+                {
+                  const double pos = (starts[0] + 0.5) / num_unconnected;
+                  size_t p = nparts * pos;
+                  if (total_capacity > 0.0)
+                    {
+                      p = upper_bound(capacity_end.begin(), capacity_end.end(),
+                                      pos * total_capacity) - capacity_end.begin();
+                    }
+                  parts[node_start+i] = min(nparts-1, p);
+                  starts[0] += 1.0;
+                }
+            }
+        }
+      if (num_nodes > 0)
+        {
+          allgather_parts(comm, node_dist, parts);
+        }
+
+      vector<double> loads;
+      compute_loads(comm, nparts, parts, node_start, in_degree, loads);
+
+      // label propagation rounds
+      vector<double> connectivity(nparts, 0.0);
+      vector<uint32_t> touched;
+      size_t idle_rounds = 0;
+      for (size_t iter=0; (iter<num_iterations) && (idle_rounds < 2) && (num_nodes > 0); iter++)
+        {
+          const bool move_up = (iter % 2) == 0;
+
+          // each node proposes to move to the partition with the most
+          // neighbors in the direction of this round; nodes of
+          // overloaded partitions may also move to any partition that
+          // is not overloaded, preferring the least loaded one
+          vector<bool> overloaded(nparts, false);
+          for (size_t p=0; p<nparts; p++)
+            {
+              overloaded[p] = (loads[2*p] > max_loads[0]) || (loads[2*p+1] > max_loads[1]);
+            }
+          vector< tuple<double, NODE_IDX_T, uint32_t> > proposals;
+          vector<double> inflow(2*nparts, 0.0);
+          for (size_t i=0; i<num_local_nodes; i++)
+            {
+              const uint32_t cur = parts[node_start+i];
+              for (size_t j=adj_ptr[i]; j<adj_ptr[i+1]; j++)
+                {
+                  const uint32_t p = parts[adj[j]];
+                  if (connectivity[p] == 0.0)
+                    {
+                      touched.push_back(p);
+                    }
+                  connectivity[p] += 1.0;
+                }
+              uint32_t best = cur;
+              double best_connectivity = connectivity[cur];
+              if (overloaded[cur])
+                {
+                  double best_load = 0.0;
+                  for (uint32_t p=0; p<nparts; p++)
+                    {
+                      if ((move_up ? (p <= cur) : (p >= cur)) || overloaded[p])
+                        continue;
+                      const double load = loads[2*p] / max_loads[0] +
+                        ((max_loads[1] > 0.0) ? loads[2*p+1] / max_loads[1] : 0.0);
+                      if ((best == cur) || (connectivity[p] > best_connectivity) ||
+                          ((connectivity[p] == best_connectivity) && (load < best_load)))
+                        {
+                          best = p;
+                          best_connectivity = connectivity[p];
+                          best_load = load;
+                        }
+                    }
+                }
+              else
+                {
+                  for (const uint32_t p : touched)
+                    {
+                      if ((move_up ? (p > cur) : (p < cur)) &&
+                          ((connectivity[p] > best_connectivity) ||
+                           ((connectivity[p] == best_connectivity) && (best != cur) && (p < best))))
+                        {
+                          best = p;
+                          best_connectivity = connectivity[p];
+                        }
+                    }
+                }
+              if (best != cur)
+                {
+                  proposals.push_back(make_tuple(best_connectivity - connectivity[cur], i, best));
+                  inflow[2*best] += 1.0;
+                  inflow[2*best+1] += in_degree[i];
+                }
+              for (const uint32_t p : touched)
+                {
+                  connectivity[p] = 0.0;
+                }
+              touched.clear();
+            }
+
+          // each partition accepts the same fraction of the inflow
+          // proposed on every rank, so that its load stays within the
+          // maximum
+          vector<double> total_inflow(inflow);
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &total_inflow[0], 2*nparts, MPI_DOUBLE, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+          vector<double> accept_limit(2*nparts, 0.0);
+          for (size_t p=0; p<nparts; p++)
+            {
+              double fraction = 1.0;
+              for (size_t c=0; c<2; c++)
+                {
+                  if (total_inflow[2*p+c] > 0.0)
+                    {
+                      const double capacity = max(0.0, max_loads[c] - loads[2*p+c]);
+                      fraction = min(fraction, capacity / total_inflow[2*p+c]);
+                    }
+                }
+              for (size_t c=0; c<2; c++)
+                {
+                  accept_limit[2*p+c] = fraction * inflow[2*p+c];
+                }
+            }
+
+          // accept the proposals with the highest gains first
+          sort(proposals.begin(), proposals.end(),
+               [] (const tuple<double, NODE_IDX_T, uint32_t>& a,
+                   const tuple<double, NODE_IDX_T, uint32_t>& b)
+               {
+                 return (get<0>(a) > get<0>(b)) ||
+                   ((get<0>(a) == get<0>(b)) && (get<1>(a) < get<1>(b)));
+               });
+          vector<double> accepted(2*nparts, 0.0);
+          size_t num_moves = 0;
+          for (const auto& proposal : proposals)
+            {
+              const NODE_IDX_T i = get<1>(proposal);
+              const uint32_t p = get<2>(proposal);
+              const double w[2] = { 1.0, (double)in_degree[i] };
+              if ((accepted[2*p] + w[0] <= accept_limit[2*p] + 1e-9) &&
+                  (accepted[2*p+1] + w[1] <= accept_limit[2*p+1] + 1e-9))
+                {
+                  accepted[2*p] += w[0];
+                  accepted[2*p+1] += w[1];
+                  parts[node_start+i] = p;
+                  num_moves++;
+                }
+            }
+
+          throw_assert(MPI_Allreduce(MPI_IN_PLACE, &num_moves, 1, MPI_SIZE_T, MPI_SUM,
+                                     comm) == MPI_SUCCESS,
+                       "partition_graph_lp: error in MPI_Allreduce");
+          idle_rounds = (num_moves == 0) ? idle_rounds + 1 : 0;
+
+          allgather_parts(comm, node_dist, parts);
+          compute_loads(comm, nparts, parts, node_start, in_degree, loads);
+        }
+
+      // every edge is counted once, at its endpoint with the lower position
+      edge_cut = 0;
+      for (size_t i=0; i<num_local_nodes; i++)
+        {
+          for (size_t j=adj_ptr[i]; j<adj_ptr[i+1]; j++)
+            {
+              if ((adj[j] > node_start+i) && (parts[adj[j]] != parts[node_start+i]))
+                {
+                  edge_cut++;
+                }
+            }
+        }
+      throw_assert(MPI_Allreduce(MPI_IN_PLACE, &edge_cut, 1, MPI_SIZE_T, MPI_SUM,
+                                 comm) == MPI_SUCCESS,
+                   "partition_graph_lp: error in MPI_Allreduce");
+
+      node_rank_map.clear();
+      for (size_t i=0; i<num_nodes; i++)
+        {
+          node_rank_map[nodes[i]].insert(parts[i]);
+        }
+
+      return 0;
+    }
+  }
+}
+
+
+// edges within each population mostly connect nearby cells
+void append_test_edges (const CELL_IDX_T src_start, const CELL_IDX_T src_count,
+                        const CELL_IDX_T dst_start, const CELL_IDX_T dst_count,
+                        const size_t seed, edge_map_t& edge_map)
+{
+  srand(seed);
+  for (CELL_IDX_T d = 0; d < dst_count; d++)
+    {
+      vector<NODE_IDX_T> srcs;
+      const size_t num_edges = rand() % 8;
+      for (size_t e = 0; e < num_edges; e++)
+        {
+          const CELL_IDX_T near = (d * src_count) / dst_count;
+          const CELL_IDX_T s = (rand() % 4 == 0) ? rand() % src_count :
+            (near + src_count + (rand() % 21) - 10) % src_count;
+          srcs.push_back(src_start + s);
+        }
+      if (!srcs.empty())
+        {
+          edge_map[dst_start + d] = make_tuple(srcs, vector<data::AttrVal>());
+        }
+    }
+}
+
+void assert_same_partition (const node_rank_map_t& a, const node_rank_map_t& b)
+{
+  assert(a.size() == b.size());
+  for (auto const& it : a)
+    {
+      auto b_it = b.find(it.first);
+      assert(b_it != b.end());
+      assert(b_it->second == it.second);
+      assert(it.second.size() == 1);
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_partition_graph_lp.h5";
+  const CELL_IDX_T num_a = 400, num_b = 300;
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  prj_names.push_back(make_pair("B", "B"));
+  prj_names.push_back(make_pair("B", "A"));
+
+  // the file is written by rank 0 alone and read by all ranks
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_a));
+      populations.push_back(make_pair("B", (size_t)num_b));
+      set< pair<pop_t,pop_t> > pop_pairs;
+      pop_pairs.insert(make_pair(0, 1));
+      pop_pairs.insert(make_pair(1, 1));
+      pop_pairs.insert(make_pair(1, 0));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations, pop_pairs, pop_ranges);
+
+      const map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      edge_map_t ab_edges, bb_edges, ba_edges;
+      append_test_edges(0, num_a, num_a, num_b, 11, ab_edges);
+      append_test_edges(num_a, num_b, num_a, num_b, 13, bb_edges);
+      append_test_edges(num_a, num_b, 0, num_a, 17, ba_edges);
+      // self-loops count towards the in-degree but not the cut
+      for (CELL_IDX_T d = 0; d < num_b; d += 7)
+        get<0>(bb_edges[num_a + d]).push_back(num_a + d);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, ab_edges, 64) >= 0);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "B", "B", edge_attr_index, bb_edges, 64) >= 0);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "B", "A", edge_attr_index, ba_edges, 64) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  for (const size_t nparts : { (size_t)4, (size_t)(size + 2) })
+    {
+      for (const size_t io_size : { (size_t)1, (size_t)size })
+        {
+          // contiguous initial partition
+          node_rank_map_t ref_map, node_rank_map;
+          size_t ref_edge_cut = 0, edge_cut = 0;
+          assert(reference::partition_graph_lp(MPI_COMM_WORLD, file_name, prj_names, io_size, nparts,
+                                               10, 0.05, ref_map, ref_edge_cut) == 0);
+          assert(graph::partition_graph_lp(MPI_COMM_WORLD, file_name, prj_names, io_size, nparts,
+                                           10, 0.05, node_rank_map, edge_cut) == 0);
+          assert(node_rank_map.size() == (size_t)(num_a + num_b));
+          assert_same_partition(node_rank_map, ref_map);
+          assert(edge_cut == ref_edge_cut);
+          assert(edge_cut > 0);
+
+          // given initial partition
+          ref_map.clear();
+          node_rank_map.clear();
+          for (CELL_IDX_T gid = 0; gid < num_a + num_b; gid++)
+            {
+              ref_map[gid].insert((gid * 7) % nparts);
+              node_rank_map[gid].insert((gid * 7) % nparts);
+            }
+          assert(reference::partition_graph_lp(MPI_COMM_WORLD, file_name, prj_names, io_size, nparts,
+                                               6, 0.1, ref_map, ref_edge_cut) == 0);
+          assert(graph::partition_graph_lp(MPI_COMM_WORLD, file_name, prj_names, io_size, nparts,
+                                           6, 0.1, node_rank_map, edge_cut) == 0);
+          assert_same_partition(node_rank_map, ref_map);
+          assert(edge_cut == ref_edge_cut);
+        }
+    }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,292 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_partition_sfc.cc
+///
+///  Test for space-filling curve partitioning, compared with cutting
+///  the curve through all cells on a single rank.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "cell_attributes.hh"
+#include "append_graph.hh"
+#include "partition_sfc.hh"
+#include "node_rank_map_attributes.hh"
+#include "scatter_read_graph.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// the part of every cell, computed on one rank from all cells
+void serial_partition (const vector<CELL_IDX_T>& gids, const vector<COORD_T>& coords,
+                       const vector<double>& weights, const size_t nparts,
+                       const graph::SpaceFillingCurve curve, map<CELL_IDX_T, rank_t>& parts)
+{
+  COORD_T lo[3], hi[3];
+  for (size_t d = 0; d < 3; d++)
+    {
+      lo[d] = numeric_limits<COORD_T>::max();
+      hi[d] = numeric_limits<COORD_T>::lowest();
+      for (size_t i = 0; i < gids.size(); i++)
+        {
+          lo[d] = min(lo[d], coords[3*i+d]);
+          hi[d] = max(hi[d], coords[3*i+d]);
+        }
+    }
+  double extent = 0.0;
+  for (size_t d = 0; d < 3; d++)
+    {
+      extent = max(extent, (double)hi[d] - (double)lo[d]);
+    }
+  const uint32_t max_grid = (1U << graph::sfc_bits) - 1;
+  const double scale = (extent > 0.0) ? (max_grid / extent) : 0.0;
+
+  vector< pair<uint64_t, size_t> > order;
+  for (size_t i = 0; i < gids.size(); i++)
+    {
+      uint32_t p[3];
+      for (size_t d = 0; d < 3; d++)
+        {
+          p[d] = min(max_grid, (uint32_t)(((double)coords[3*i+d] - lo[d]) * scale));
+        }
+      order.push_back(make_pair((curve == graph::CurveHilbert) ? graph::hilbert_key(p) : graph::morton_key(p), i));
+    }
+  sort(order.begin(), order.end());
+
+  double total_weight = 0.0, cumulative_weight = 0.0;
+  for (const double w : weights) total_weight += w;
+  for (const pair<uint64_t, size_t>& o : order)
+    {
+      const double w = weights[o.second];
+      const size_t p = (size_t)(nparts * ((cumulative_weight + 0.5*w) / total_weight));
+      parts[gids[o.second]] = min(p, nparts-1);
+      cumulative_weight += w;
+    }
+}
+
+// asserts that each rank holds exactly the cells of its parts
+void assert_local_parts (const node_rank_map_t& node_rank_map, const map<CELL_IDX_T, rank_t>& parts,
+                         int rank, int size)
+{
+  size_t num_local = 0;
+  for (auto const& it : parts)
+    {
+      auto node_it = node_rank_map.find(it.first);
+      if ((int)(it.second % size) == rank)
+        {
+          assert(node_it != node_rank_map.end());
+          assert(node_it->second.size() == 1);
+          assert(*(node_it->second.begin()) == it.second);
+          num_local++;
+        }
+      else
+        {
+          assert(node_it == node_rank_map.end());
+        }
+    }
+  assert(node_rank_map.size() == num_local);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // distinct cells on a grid, with integer weights so that the sums
+  // of weights do not depend on the order of summation
+  const CELL_IDX_T num_cells = 2000;
+  vector<CELL_IDX_T> all_gids, gids;
+  vector<COORD_T> all_coords, coords;
+  vector<double> all_weights, weights;
+  srand(47);
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      const CELL_IDX_T g = (gid * 7919) % 8000;
+      const COORD_T xyz[3] = { (COORD_T)(g % 20), (COORD_T)((g / 20) % 20), (COORD_T)(g / 400) };
+      const double w = 1 + rand() % 5;
+      all_gids.push_back(gid);
+      all_coords.insert(all_coords.end(), xyz, xyz+3);
+      all_weights.push_back(w);
+      if ((int)((gid * 13) % size) == rank)
+        {
+          gids.push_back(gid);
+          coords.insert(coords.end(), xyz, xyz+3);
+          weights.push_back(w);
+        }
+    }
+
+  for (const graph::SpaceFillingCurve curve : { graph::CurveHilbert, graph::CurveMorton })
+    {
+      for (const size_t nparts : { (size_t)size, (size_t)(2*size + 1) })
+        {
+          map<CELL_IDX_T, rank_t> parts;
+          serial_partition(all_gids, all_coords, all_weights, nparts, curve, parts);
+          node_rank_map_t node_rank_map;
+          graph::partition_sfc(MPI_COMM_WORLD, gids, coords, weights, nparts, curve, node_rank_map);
+          assert_local_parts(node_rank_map, parts, rank, size);
+
+          vector<double> unit_weights(all_gids.size(), 1.0);
+          parts.clear();
+          node_rank_map.clear();
+          serial_partition(all_gids, all_coords, unit_weights, nparts, curve, parts);
+          graph::partition_sfc(MPI_COMM_WORLD, gids, coords, vector<double>(), nparts, curve, node_rank_map);
+          assert_local_parts(node_rank_map, parts, rank, size);
+        }
+    }
+
+  // partition of a population weighted by the in-degree of a
+  // projection, which is summed from the destination pointers
+  {
+    const string file_name = "test_partition_sfc.h5";
+    const string src_pop_name = "MPP", pop_name = "GC";
+    const string name_space = "Coordinates", rank_namespace = "Partition";
+    const CELL_IDX_T num_src_cells = 300;
+    pop_range_map_t pop_ranges;
+    vector< pair<string,size_t> > populations;
+    populations.push_back(make_pair(src_pop_name, (size_t)num_src_cells));
+    populations.push_back(make_pair(pop_name, (size_t)num_cells));
+    set< pair<pop_t,pop_t> > pop_pairs;
+    pop_pairs.insert(make_pair(0, 1));
+    test::create_test_file(MPI_COMM_WORLD, file_name, populations, pop_pairs, pop_ranges);
+    const CELL_IDX_T pop_start = pop_ranges[1].start;
+
+    map<string, map<CELL_IDX_T, deque<float> > > float_values;
+    for (size_t i = 0; i < gids.size(); i++)
+      {
+        float_values[hdf5::X_COORD][pop_start + gids[i]] = deque<float>(1, coords[3*i]);
+        float_values[hdf5::Y_COORD][pop_start + gids[i]] = deque<float>(1, coords[3*i+1]);
+        float_values[hdf5::Z_COORD][pop_start + gids[i]] = deque<float>(1, coords[3*i+2]);
+      }
+    cell::append_cell_attribute_maps(MPI_COMM_WORLD, file_name, name_space, pop_name, pop_start,
+                                     map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                     map<string, map<CELL_IDX_T, deque<int32_t> > >(),
+                                     map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                     map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                     map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                     map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                     float_values, size, data::optional_hid());
+
+    // every third cell has no edges
+    vector<double> all_degree_weights(num_cells, 1.0);
+    edge_map_t edge_map;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += size)
+      {
+        if (gid % 3 == 0)
+          continue;
+        vector<NODE_IDX_T> srcs;
+        const size_t num_edges = 1 + (gid * 31) % 17;
+        for (size_t e = 0; e < num_edges; e++)
+          srcs.push_back((gid + 11 * e) % num_src_cells);
+        edge_map[pop_start + gid] = make_tuple(srcs, vector<data::AttrVal>());
+      }
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        if (gid % 3 != 0)
+          all_degree_weights[gid] += 1 + (gid * 31) % 17;
+      }
+    assert(graph::append_graph(MPI_COMM_WORLD, size, file_name, src_pop_name, pop_name,
+                               map<string, pair<size_t, data::AttrIndex> >(), edge_map, 64) >= 0);
+
+    const size_t nparts = 2*size + 3;
+    map<CELL_IDX_T, rank_t> parts, pop_parts;
+    serial_partition(all_gids, all_coords, all_degree_weights, nparts, graph::CurveHilbert, parts);
+    for (auto const& it : parts)
+      pop_parts[pop_start + it.first] = it.second;
+
+    node_rank_map_t node_rank_map;
+    graph::partition_population_sfc(MPI_COMM_WORLD, file_name, name_space, pop_name, pop_start,
+                                    vector<string>(1, src_pop_name), nparts, graph::CurveHilbert,
+                                    node_rank_map);
+    assert_local_parts(node_rank_map, pop_parts, rank, size);
+
+    // the in-degree changes the partition
+    map<CELL_IDX_T, rank_t> unit_parts;
+    serial_partition(all_gids, all_coords, vector<double>(num_cells, 1.0), nparts, graph::CurveHilbert, unit_parts);
+    assert(unit_parts != parts);
+
+    // the distributed assignment is written once and read back whole
+    graph::append_node_rank_map(MPI_COMM_WORLD, file_name, rank_namespace, pop_name, pop_start,
+                                node_rank_map, size, true);
+    node_rank_map_t read_map;
+    graph::read_node_rank_map(MPI_COMM_WORLD, file_name, rank_namespace, pop_name, pop_start, read_map);
+    assert(read_map.size() == pop_parts.size());
+    for (auto const& it : pop_parts)
+      {
+        assert(read_map[it.first] == set<rank_t>({ it.second }));
+      }
+
+    // a partition into one part per rank, once replicated, drives the
+    // scatter readers: each rank receives the edges and coordinates of
+    // the cells of its part
+    map<CELL_IDX_T, rank_t> rank_parts;
+    serial_partition(all_gids, all_coords, all_degree_weights, size, graph::CurveHilbert, rank_parts);
+    node_rank_map_t rank_map;
+    graph::partition_population_sfc(MPI_COMM_WORLD, file_name, name_space, pop_name, pop_start,
+                                    vector<string>(1, src_pop_name), size, graph::CurveHilbert,
+                                    rank_map);
+    graph::replicate_node_rank_map(MPI_COMM_WORLD, rank_map);
+    assert(rank_map.size() == rank_parts.size());
+    edge_map_t expected_edges;
+    set<CELL_IDX_T> expected_cells;
+    for (auto const& it : rank_parts)
+      {
+        assert(rank_map[pop_start + it.first] == set<rank_t>({ it.second }));
+        if ((int)it.second != rank)
+          continue;
+        expected_cells.insert(pop_start + it.first);
+        if (it.first % 3 == 0)
+          continue;
+        vector<NODE_IDX_T> srcs;
+        const size_t num_edges = 1 + (it.first * 31) % 17;
+        for (size_t e = 0; e < num_edges; e++)
+          srcs.push_back((it.first + 11 * e) % num_src_cells);
+        expected_edges[pop_start + it.first] = make_tuple(srcs, vector<data::AttrVal>());
+      }
+
+    vector< pair<string, string> > prj_names;
+    prj_names.push_back(make_pair(src_pop_name, pop_name));
+    vector<edge_map_t> prj_vector;
+    vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+    size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+    assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size, vector<string>(),
+                                     prj_names, rank_map, prj_vector, edge_attr_names_vector,
+                                     local_num_nodes, total_num_nodes,
+                                     local_num_edges, total_num_edges) >= 0);
+    assert(prj_vector.size() == 1);
+    test::assert_same_edges(prj_vector[0], expected_edges);
+
+    data::NamedAttrMap coord_map;
+    cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, size, name_space, set<string>(),
+                                       rank_map, pop_name, pop_start, coord_map);
+    assert(coord_map.index_set == expected_cells);
+
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
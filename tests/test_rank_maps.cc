@@ -0,0 +1,336 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_rank_maps.cc
+///
+///  Test for the in-memory hot paths timed by the microbenchmarks: the
+///  rank partitioning of edges, cell attributes and trees, their
+///  serialization, attribute map insertion and permutation sorting, each
+///  compared with a direct computation on the same inputs.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <numeric>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include "neuroh5_types.hh"
+#include "path_names.hh"
+#include "attr_map.hh"
+#include "attr_val.hh"
+#include "append_rank_edge_map.hh"
+#include "append_rank_attr_map.hh"
+#include "append_rank_tree_map.hh"
+#include "serialize_edge.hh"
+#include "serialize_cell_attributes.hh"
+#include "sort_permutation.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const size_t num_ranks = 7;
+
+// cells are assigned to one rank by gid % num_ranks, except every
+// eleventh cell, which is assigned to two ranks
+node_rank_map_t test_rank_map (const size_t num_cells)
+{
+  node_rank_map_t node_rank_map;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+    {
+      node_rank_map[gid].insert(gid % num_ranks);
+      if (gid % 11 == 0)
+        node_rank_map[gid].insert((gid + 3) % num_ranks);
+    }
+  return node_rank_map;
+}
+
+// partitions the edges of a projection in two destination blocks
+void test_rank_edge_map ()
+{
+  const NODE_IDX_T dst_start = 1000, src_start = 0;
+  const size_t num_cells = dst_start + 600;
+  const node_rank_map_t node_rank_map = test_rank_map(num_cells);
+
+  // blocks of destinations [0, 250) and [400, 600) relative to dst_start
+  vector<DST_BLK_PTR_T> dst_blk_ptr = { 0, 250, 450 };
+  vector<NODE_IDX_T> dst_idx = { 0, 400 };
+  vector<DST_PTR_T> dst_ptr(1, 0);
+  vector<NODE_IDX_T> src_idx;
+  vector<float> weights;
+  edge_map_t expected;
+  for (size_t b = 0; b < 2; b++)
+    {
+      for (size_t ii = 0; ii < dst_blk_ptr[b+1] - dst_blk_ptr[b]; ii++)
+        {
+          const NODE_IDX_T dst = dst_start + dst_idx[b] + ii;
+          const size_t n = rand() % 9;
+          vector<NODE_IDX_T> srcs;
+          vector<float> dst_weights;
+          for (size_t e = 0; e < n; e++)
+            {
+              srcs.push_back(rand() % dst_start);
+              dst_weights.push_back((rand() % 1000) / 4.0f);
+            }
+          src_idx.insert(src_idx.end(), srcs.begin(), srcs.end());
+          weights.insert(weights.end(), dst_weights.begin(), dst_weights.end());
+          dst_ptr.push_back(src_idx.size());
+          if (n > 0)
+            {
+              vector<data::AttrVal> attrs(1);
+              attrs[0].float_values.push_back(dst_weights);
+              expected[dst] = make_tuple(srcs, attrs);
+            }
+        }
+    }
+  const vector<string> attr_namespaces(1, "Synapses");
+  map<string, data::NamedAttrVal> edge_attr_map;
+  edge_attr_map["Synapses"].insert(string("weight"), weights);
+
+  size_t num_edges = 0;
+  rank_edge_map_t rank_edge_map;
+  assert(data::append_rank_edge_map(0, num_ranks, dst_start, src_start, dst_blk_ptr, dst_idx, dst_ptr,
+                                    src_idx, attr_namespaces, edge_attr_map, node_rank_map,
+                                    num_edges, rank_edge_map, EdgeMapDst) >= 0);
+
+  // each destination is sent with all its edges, in file order, to each
+  // of its ranks
+  map<rank_t, edge_map_t> expected_rank_edge_map;
+  size_t num_rank_edges = 0;
+  for (auto const& it : expected)
+    {
+      for (const rank_t r : node_rank_map.at(it.first))
+        {
+          expected_rank_edge_map[r].insert(it);
+          num_rank_edges += get<0>(it.second).size();
+        }
+    }
+  assert(num_edges == num_rank_edges);
+  assert(rank_edge_map.size() == expected_rank_edge_map.size());
+  for (auto const& it : expected_rank_edge_map)
+    {
+      const edge_map_t& edge_map = rank_edge_map[it.first];
+      test::assert_same_edges(edge_map, it.second);
+      for (auto const& dst_it : it.second)
+        {
+          assert(get<0>(edge_map.at(dst_it.first)) == get<0>(dst_it.second));
+          assert(get<1>(edge_map.at(dst_it.first))[0].float_values == get<1>(dst_it.second)[0].float_values);
+        }
+    }
+
+  // the serialized edges of each rank deserialize to the edges of that
+  // rank
+  size_t num_packed_edges = 0;
+  vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+  vector<char> sendbuf;
+  data::serialize_rank_edge_map(num_ranks, 0, rank_edge_map, num_packed_edges,
+                                sendcounts, sendbuf, sdispls);
+  assert(num_packed_edges == num_rank_edges);
+  for (size_t r = 0; r < num_ranks; r++)
+    {
+      vector<int> recvcounts(num_ranks, 0), rdispls(num_ranks, 0);
+      recvcounts[r] = sendcounts[r];
+      rdispls[r] = sdispls[r];
+      edge_map_t edge_map;
+      size_t num_unpacked_nodes = 0, num_unpacked_edges = 0;
+      data::deserialize_rank_edge_map(num_ranks, sendbuf, recvcounts, rdispls, edge_map,
+                                      num_unpacked_nodes, num_unpacked_edges);
+      const edge_map_t& rank_edges = expected_rank_edge_map[r];
+      test::assert_same_edges(edge_map, rank_edges);
+      assert(num_unpacked_nodes == rank_edges.size());
+    }
+}
+
+// partitions cell attributes with variable-length values
+void test_rank_attr_map ()
+{
+  const size_t num_cells = 900;
+  const node_rank_map_t node_rank_map = test_rank_map(num_cells);
+
+  // every fifth cell has no values
+  vector<CELL_IDX_T> cell_index;
+  vector<ATTR_PTR_T> ptr(1, 0);
+  vector<float> float_values;
+  vector<uint32_t> uint32_values;
+  for (CELL_IDX_T gid = 0; gid < num_cells; gid += 1 + gid % 2)
+    {
+      cell_index.push_back(gid);
+      const size_t n = (gid % 5 == 0) ? 0 : 1 + gid % 4;
+      for (size_t i = 0; i < n; i++)
+        {
+          float_values.push_back(gid + 0.5f * i);
+          uint32_values.push_back(gid * 10 + i);
+        }
+      ptr.push_back(float_values.size());
+    }
+
+  data::NamedAttrMap attr_map;
+  attr_map.insert(string("x"), cell_index, ptr, float_values);
+  attr_map.insert(string("index"), cell_index, ptr, uint32_values);
+
+  // AttrMap::insert holds the values of each cell given by the pointer
+  assert(attr_map.index_set == set<CELL_IDX_T>(cell_index.begin(), cell_index.end()));
+  for (size_t p = 0; p < cell_index.size(); p++)
+    {
+      const CELL_IDX_T gid = cell_index[p];
+      CELL_IDX_T index = gid;
+      assert(attr_map.find_name<float>("x", index) ==
+             deque<float>(float_values.begin() + ptr[p], float_values.begin() + ptr[p+1]));
+      assert(attr_map.find_name<uint32_t>("index", index) ==
+             deque<uint32_t>(uint32_values.begin() + ptr[p], uint32_values.begin() + ptr[p+1]));
+    }
+
+  map <rank_t, data::AttrMap> rank_attr_map;
+  data::append_rank_attr_map(attr_map, node_rank_map, rank_attr_map);
+  for (size_t r = 0; r < num_ranks; r++)
+    {
+      data::AttrMap& rank_attrs = rank_attr_map[r];
+      set<CELL_IDX_T> expected_index;
+      for (const CELL_IDX_T gid : cell_index)
+        {
+          if (node_rank_map.at(gid).count(r) > 0)
+            expected_index.insert(gid);
+        }
+      assert(rank_attrs.index_set == expected_index);
+      for (const CELL_IDX_T gid : expected_index)
+        {
+          assert(rank_attrs.attr_maps<float>()[0][gid] == attr_map.attr_maps<float>()[0][gid]);
+          assert(rank_attrs.attr_maps<uint32_t>()[0][gid] == attr_map.attr_maps<uint32_t>()[0][gid]);
+        }
+
+      // the serialized attributes of the rank deserialize to the same
+      // attributes
+      vector<int> sendcounts(num_ranks, 0), sdispls(num_ranks, 0);
+      vector<char> sendbuf;
+      map <rank_t, data::AttrMap> single_rank_attr_map;
+      single_rank_attr_map[r] = rank_attrs;
+      data::serialize_rank_attr_map(num_ranks, 0, single_rank_attr_map, sendcounts, sendbuf, sdispls);
+      data::NamedAttrMap all_attr_map;
+      all_attr_map.insert_name<float>("x");
+      all_attr_map.insert_name<uint32_t>("index");
+      data::deserialize_rank_attr_map(num_ranks, sendbuf, sendcounts, sdispls, all_attr_map);
+      assert(all_attr_map.index_set == expected_index);
+      for (const CELL_IDX_T gid : expected_index)
+        {
+          CELL_IDX_T index = gid;
+          assert(all_attr_map.find_name<float>("x", index) == attr_map.attr_maps<float>()[0][gid]);
+          assert(all_attr_map.find_name<uint32_t>("index", index) == attr_map.attr_maps<uint32_t>()[0][gid]);
+        }
+    }
+}
+
+template <class T>
+void insert_tree_column (data::NamedAttrMap& attr_map, const string& name,
+                         const CELL_IDX_T gid, const deque<T>& values)
+{
+  attr_map.AttrMap::insert(attr_map.insert_name<T>(name), gid, values);
+}
+
+// partitions trees in the layout returned by the tree readers
+void test_rank_tree_map ()
+{
+  const size_t num_trees = 120;
+  const node_rank_map_t node_rank_map = test_rank_map(num_trees);
+  map<CELL_IDX_T, neurotree_t> trees;
+  data::NamedAttrMap attr_map;
+  for (CELL_IDX_T gid = 0; gid < num_trees; gid++)
+    {
+      const neurotree_t tree = test::random_tree(gid, 2 + rand() % 60);
+      trees.insert(make_pair(gid, tree));
+      insert_tree_column(attr_map, hdf5::SRCSEC, gid, get<1>(tree));
+      insert_tree_column(attr_map, hdf5::DSTSEC, gid, get<2>(tree));
+      insert_tree_column(attr_map, hdf5::SECTION, gid, get<3>(tree));
+      insert_tree_column(attr_map, hdf5::X_COORD, gid, get<4>(tree));
+      insert_tree_column(attr_map, hdf5::Y_COORD, gid, get<5>(tree));
+      insert_tree_column(attr_map, hdf5::Z_COORD, gid, get<6>(tree));
+      insert_tree_column(attr_map, hdf5::RADIUS, gid, get<7>(tree));
+      insert_tree_column(attr_map, hdf5::LAYER, gid, get<8>(tree));
+      insert_tree_column(attr_map, hdf5::PARENT, gid, get<9>(tree));
+      insert_tree_column(attr_map, hdf5::SWCTYPE, gid, get<10>(tree));
+    }
+
+  map <rank_t, map<CELL_IDX_T, neurotree_t> > rank_tree_map;
+  data::append_rank_tree_map(attr_map, node_rank_map, rank_tree_map);
+  size_t num_rank_trees = 0;
+  for (auto const& it : rank_tree_map)
+    {
+      for (auto const& tree_it : it.second)
+        {
+          assert(node_rank_map.at(tree_it.first).count(it.first) > 0);
+          test::assert_same_tree(tree_it.second, trees.at(tree_it.first));
+          num_rank_trees++;
+        }
+    }
+  size_t expected_rank_trees = 0;
+  for (auto const& it : node_rank_map)
+    expected_rank_trees += it.second.size();
+  assert(num_rank_trees == expected_rank_trees);
+}
+
+// sorts value ranges as the selection readers do
+void test_sort_permutation ()
+{
+  for (const size_t num_ranges : { (size_t)0, (size_t)1, (size_t)1000 })
+    {
+      // distinct offsets, so that the sorting order is unique
+      vector<hsize_t> offsets(num_ranges);
+      iota(offsets.begin(), offsets.end(), 0);
+      random_shuffle(offsets.begin(), offsets.end());
+      vector< pair<hsize_t, hsize_t> > ranges;
+      for (const hsize_t offset : offsets)
+        ranges.push_back(make_pair(offset * 10, rand() % 10));
+      auto compare_range_idx = [](const pair<hsize_t, hsize_t>& a, const pair<hsize_t, hsize_t>& b)
+        { return (a.first < b.first); };
+
+      const vector<size_t> p = data::sort_permutation(ranges, compare_range_idx);
+      vector<size_t> expected(num_ranges);
+      iota(expected.begin(), expected.end(), 0);
+      stable_sort(expected.begin(), expected.end(),
+                  [&](size_t i, size_t j) { return compare_range_idx(ranges[i], ranges[j]); });
+      assert(p == expected);
+
+      vector< pair<hsize_t, hsize_t> > sorted_ranges(ranges);
+      sort(sorted_ranges.begin(), sorted_ranges.end());
+      assert(data::apply_permutation(ranges, p) == sorted_ranges);
+      data::apply_permutation_in_place(ranges, p);
+      assert(ranges == sorted_ranges);
+    }
+
+  // with repeated keys, the permuted keys are still sorted
+  vector<CELL_IDX_T> keys;
+  for (size_t i = 0; i < 500; i++)
+    keys.push_back(rand() % 20);
+  auto compare_keys = [](const CELL_IDX_T a, const CELL_IDX_T b) { return a < b; };
+  vector<size_t> p = data::sort_permutation(keys, compare_keys);
+  vector<size_t> q(p);
+  sort(q.begin(), q.end());
+  for (size_t i = 0; i < q.size(); i++)
+    assert(q[i] == i);
+  vector<CELL_IDX_T> sorted_keys(keys);
+  sort(sorted_keys.begin(), sorted_keys.end());
+  assert(data::apply_permutation(keys, p) == sorted_keys);
+  data::apply_permutation_in_place(keys, p);
+  assert(keys == sorted_keys);
+}
+
+
+int main (int argc, char **argv)
+{
+  srand(11);
+  test_rank_edge_map();
+  test_rank_attr_map();
+  test_rank_tree_map();
+  test_sort_permutation();
+  return 0;
+}
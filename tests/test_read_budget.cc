@@ -0,0 +1,278 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_read_budget.cc
+///
+///  Test for the reads of scatter_read_projection and scatter_read_trees
+///  in several rounds under a memory budget: the edges read are those of
+///  the single-round read, including for destinations whose edges are in
+///  blocks read in different rounds, and the trees read include the
+///  cells that refer to a template beyond the range of the stored trees.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <forward_list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "append_tree.hh"
+#include "scatter_read_tree.hh"
+#include "tree_template_set.hh"
+#include "mpi_memory.hh"
+#include "mpi_trace.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 300, num_dst = 400, num_templated = 150;
+const CELL_IDX_T num_templates = 3;
+
+// a few cells of population B store a tree and the others refer to a
+// template; population C only has template references
+bool has_stored_tree (const CELL_IDX_T gid) { return (gid < num_src + num_dst) && (gid % 8 == 0); }
+CELL_IDX_T template_of (const CELL_IDX_T gid) { return gid % num_templates; }
+COORD_T offset_of (const CELL_IDX_T gid, const int axis) { return 0.5 * gid * (axis - 1); }
+
+neurotree_t gid_tree (const CELL_IDX_T gid, const size_t seed)
+{
+  srand(seed + gid);
+  return test::random_tree(gid, 1 + rand() % 60);
+}
+
+// the tree a cell is expected to have
+neurotree_t cell_tree (const CELL_IDX_T gid)
+{
+  if (has_stored_tree(gid))
+    {
+      return gid_tree(gid, 3000);
+    }
+  neurotree_t tree = gid_tree(template_of(gid), 6000);
+  get<0>(tree) = gid;
+  for (COORD_T& x : get<4>(tree)) x += offset_of(gid, 0);
+  for (COORD_T& y : get<5>(tree)) y += offset_of(gid, 1);
+  for (COORD_T& z : get<6>(tree)) z += offset_of(gid, 2);
+  return tree;
+}
+
+// writes the stored trees, the templates and the template references
+// of a population
+void append_population_trees (const string& file_name, const string& pop_name,
+                              const CELL_IDX_T pop_start, const CELL_IDX_T pop_count)
+{
+  forward_list<neurotree_t> stored_list, template_list;
+  data::TreeTemplateSet template_refs;
+  for (CELL_IDX_T gid = pop_start; gid < pop_start + pop_count; gid++)
+    {
+      if (has_stored_tree(gid))
+        {
+          stored_list.push_front(cell_tree(gid));
+        }
+      else
+        {
+          template_refs.append_ref(gid, template_of(gid), offset_of(gid, 0),
+                                   offset_of(gid, 1), offset_of(gid, 2));
+        }
+    }
+  for (CELL_IDX_T t = 0; t < num_templates; t++)
+    {
+      template_list.push_front(gid_tree(t, 6000));
+    }
+  if (!stored_list.empty())
+    {
+      assert(cell::append_trees(MPI_COMM_SELF, file_name, pop_name, pop_start, stored_list, 1) >= 0);
+    }
+  assert(cell::append_tree_templates(MPI_COMM_SELF, file_name, pop_name, template_list, 1) >= 0);
+  assert(cell::append_tree_template_index(MPI_COMM_SELF, file_name, pop_name, pop_start,
+                                          template_refs, 1) >= 0);
+}
+
+// reads the trees of a population with the cells assigned to ranks by
+// gid % size, asserts that they are those written, and returns the
+// phase totals of the read
+map<string, mpi::phase_summary_t> read_population_trees (const string& file_name, const string& pop_name,
+                                                         const CELL_IDX_T pop_start, const CELL_IDX_T pop_count)
+{
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  node_rank_map_t node_rank_map;
+  for (CELL_IDX_T gid = pop_start; gid < pop_start + pop_count; gid++)
+    {
+      node_rank_map[gid].insert(gid % size);
+    }
+  map<CELL_IDX_T, neurotree_t> tree_map;
+  map<string, data::NamedAttrMap> attr_maps;
+  mpi::trace_reset();
+  assert(cell::scatter_read_trees(MPI_COMM_WORLD, file_name, 1, vector<string>(), node_rank_map,
+                                  pop_name, pop_start, tree_map, attr_maps) >= 0);
+  size_t num_rank_cells = 0;
+  for (CELL_IDX_T gid = pop_start; gid < pop_start + pop_count; gid++)
+    {
+      if ((int)(gid % size) == rank)
+        {
+          num_rank_cells++;
+          test::assert_same_tree(tree_map.at(gid), cell_tree(gid));
+        }
+    }
+  assert(tree_map.size() == num_rank_cells);
+  return mpi::trace_summary(MPI_COMM_WORLD);
+}
+
+// reads the projection A -> B with io_size I/O ranks and the nodes
+// assigned to ranks by node % size, and returns the phase totals of
+// the read
+map<string, mpi::phase_summary_t> read_projection (const string& file_name, const int io_size,
+                                                   edge_map_t& edge_map, size_t& local_num_edges,
+                                                   size_t& total_num_edges)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0;
+  mpi::trace_reset();
+  assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, io_size,
+                                   vector<string>(1, "Synapses"), prj_names, node_rank_map,
+                                   prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  assert(edge_attr_names_vector.size() == 1);
+  edge_map = prj_vector[0];
+  assert(local_num_nodes == edge_map.size());
+  return mpi::trace_summary(MPI_COMM_WORLD);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_read_budget.h5";
+
+  // the projection is appended in three parts, so that destinations
+  // have edges in several blocks
+  srand(29);
+  edge_map_t edges;
+  vector<edge_map_t> parts(3);
+  for (size_t part = 0; part < parts.size(); part++)
+    {
+      test::random_edge_map(0, num_src, num_src, num_dst, 5, parts[part]);
+      test::merge_edge_maps(edges, parts[part]);
+    }
+  size_t num_edges = 0;
+  for (auto const& it : edges)
+    num_edges += get<0>(it.second).size();
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_src));
+      populations.push_back(make_pair("B", (size_t)num_dst));
+      populations.push_back(make_pair("C", (size_t)num_templated));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+      map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      test::test_edge_attr_index(edge_attr_index);
+      for (const edge_map_t& part : parts)
+        {
+          assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, part, 32) >= 0);
+        }
+      append_population_trees(file_name, "B", num_src, num_dst);
+      append_population_trees(file_name, "C", num_src + num_dst, num_templated);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+  const edge_map_t local_edges = test::rank_edges(edges, rank, size);
+
+  const uint64_t initial_budget = mpi::memory_budget();
+  const bool initial_trace = mpi::trace_enabled();
+  mpi::set_trace_enabled(false);
+
+  // without a budget, the blocks are read in a single round by one I/O
+  // rank
+  mpi::set_memory_budget(0);
+  edge_map_t edge_map;
+  size_t local_num_edges = 0, total_num_edges = 0;
+  map<string, mpi::phase_summary_t> summary = read_projection(file_name, 1, edge_map,
+                                                              local_num_edges, total_num_edges);
+  test::assert_same_edges(edge_map, local_edges);
+  assert(total_num_edges == num_edges);
+  assert(summary["scatter_read_projection.read"].calls == 1);
+  const size_t single_round_edges = local_num_edges;
+
+  // with a budget that cannot be met, every rank reads and each round
+  // reads few blocks; the edges of each destination are merged over
+  // the rounds
+  for (const uint64_t budget : { (uint64_t)1, (uint64_t)16 * 1024 })
+    {
+      mpi::set_memory_budget(budget);
+      edge_map_t round_edge_map;
+      summary = read_projection(file_name, 1, round_edge_map, local_num_edges, total_num_edges);
+      test::assert_same_edges(round_edge_map, local_edges);
+      assert(local_num_edges == single_round_edges);
+      assert(total_num_edges == num_edges);
+      // each rank reads in every round
+      assert(summary["scatter_read_projection.read"].calls > (uint64_t)size);
+      assert(summary["scatter_read_projection.read"].items == num_edges);
+      assert(summary["scatter_read_projection.append_rank_edge_map"].items == num_edges);
+      if (size == 1)
+        {
+          assert(summary["scatter_read_projection.merge"].items == num_edges);
+        }
+      else
+        {
+          assert(summary["scatter_read_projection.deserialize"].items == num_edges);
+        }
+    }
+
+  // the trees of B are mostly template references, more than the
+  // stored trees, and those of C are template references only; the
+  // rounds cover all references
+  for (const uint64_t budget : { (uint64_t)0, (uint64_t)1024, (uint64_t)16 * 1024 })
+    {
+      mpi::set_memory_budget(budget);
+      summary = read_population_trees(file_name, "B", num_src, num_dst);
+      assert((budget == 0) ?
+             (summary["scatter_read_trees.read"].calls == 1) :
+             (summary["scatter_read_trees.read"].calls > (uint64_t)size));
+      summary = read_population_trees(file_name, "C", num_src + num_dst, num_templated);
+      if (budget == 0)
+        assert(summary["scatter_read_trees.read"].calls == 1);
+      else if (budget == 1024)
+        assert(summary["scatter_read_trees.read"].calls > (uint64_t)size);
+    }
+
+  mpi::set_memory_budget(initial_budget);
+  mpi::set_trace_enabled(initial_trace);
+  mpi::trace_reset();
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
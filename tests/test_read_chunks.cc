@@ -0,0 +1,184 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_read_chunks.cc
+///
+///  Test for read_chunks: ranges of one-dimensional datasets compressed
+///  with shuffle and deflate, some of whose chunks were never written,
+///  are read with the same values as with H5Dread.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+#include <hdf5.h>
+
+#include "read_chunks.hh"
+#include "thread_pool.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// the chunk size does not divide the dataset size, and the elements
+// from first_unwritten to last_unwritten are left to the fill value,
+// so that the chunks within that range are not allocated
+const hsize_t num_elems = 10007, chunk_size = 311;
+const hsize_t first_unwritten = 3000, last_unwritten = 4500;
+
+template<class T>
+T elem_value (const hsize_t i) { return (T)((i * 7919) % 65521); }
+
+template<class T>
+void create_dataset (hid_t file, const string& name, hid_t ntype, const T fill_value)
+{
+  const hsize_t dims = num_elems, chunk = chunk_size;
+  hid_t fspace = H5Screate_simple(1, &dims, NULL);
+  assert(fspace >= 0);
+  hid_t dcpl = H5Pcreate(H5P_DATASET_CREATE);
+  assert(dcpl >= 0);
+  assert(H5Pset_chunk(dcpl, 1, &chunk) >= 0);
+  assert(H5Pset_shuffle(dcpl) >= 0);
+  assert(H5Pset_deflate(dcpl, 6) >= 0);
+  assert(H5Pset_fill_value(dcpl, ntype, &fill_value) >= 0);
+  hid_t dset = H5Dcreate2(file, name.c_str(), ntype, fspace, H5P_DEFAULT, dcpl, H5P_DEFAULT);
+  assert(dset >= 0);
+
+  // the elements before and after the unwritten range
+  vector<T> values;
+  for (hsize_t i = 0; i < num_elems; i++)
+    values.push_back(elem_value<T>(i));
+  const hsize_t starts[2] = { 0, last_unwritten };
+  const hsize_t counts[2] = { first_unwritten, num_elems - last_unwritten };
+  for (size_t r = 0; r < 2; r++)
+    {
+      hid_t mspace = H5Screate_simple(1, &counts[r], NULL);
+      assert(mspace >= 0);
+      assert(H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &starts[r], NULL, &counts[r], NULL) >= 0);
+      assert(H5Dwrite(dset, ntype, mspace, fspace, H5P_DEFAULT, &values[starts[r]]) >= 0);
+      assert(H5Sclose(mspace) >= 0);
+    }
+
+  assert(H5Dclose(dset) >= 0);
+  assert(H5Pclose(dcpl) >= 0);
+  assert(H5Sclose(fspace) >= 0);
+}
+
+// reads the ranges with H5Dread, into consecutive positions
+template<class T>
+vector<T> read_hyperslabs (hid_t dset, hid_t ntype, const vector< pair<hsize_t,hsize_t> >& ranges)
+{
+  hsize_t total = 0;
+  for (auto const& range : ranges)
+    total += range.second;
+  vector<T> values(total);
+  hid_t fspace = H5Dget_space(dset);
+  assert(fspace >= 0);
+  hsize_t pos = 0;
+  for (auto const& range : ranges)
+    {
+      if (range.second == 0)
+        continue;
+      hid_t mspace = H5Screate_simple(1, &range.second, NULL);
+      assert(mspace >= 0);
+      assert(H5Sselect_hyperslab(fspace, H5S_SELECT_SET, &range.first, NULL, &range.second, NULL) >= 0);
+      assert(H5Dread(dset, ntype, mspace, fspace, H5P_DEFAULT, &values[pos]) >= 0);
+      assert(H5Sclose(mspace) >= 0);
+      pos += range.second;
+    }
+  assert(H5Sclose(fspace) >= 0);
+  return values;
+}
+
+template<class T>
+void check_dataset (hid_t file, const string& name, hid_t ntype)
+{
+  hid_t dset = H5Dopen2(file, name.c_str(), H5P_DEFAULT);
+  assert(dset >= 0);
+
+  data::thread_pool serial_pool(1), pool(3);
+  assert(!hdf5::can_read_chunks(dset, ntype, serial_pool));
+#ifdef HAVE_ZLIB
+  assert(hdf5::can_read_chunks(dset, ntype, pool));
+#else
+  assert(!hdf5::can_read_chunks(dset, ntype, pool));
+  assert(H5Dclose(dset) >= 0);
+  return;
+#endif
+
+  // whole dataset; ranges within one chunk, across chunk boundaries,
+  // within and around the unallocated chunks, and at the end of the
+  // last, partial chunk; ranges that are out of order or empty
+  vector< vector< pair<hsize_t,hsize_t> > > range_sets;
+  range_sets.push_back({ make_pair(0, num_elems) });
+  range_sets.push_back({ make_pair(5, 17), make_pair(chunk_size - 3, 9),
+                         make_pair(2 * chunk_size, chunk_size) });
+  range_sets.push_back({ make_pair(first_unwritten - 100, 1700),
+                         make_pair(first_unwritten + 400, 200) });
+  range_sets.push_back({ make_pair(num_elems - 20, 20), make_pair(1, 1),
+                         make_pair(700, 0), make_pair(100, 5000) });
+  srand(43);
+  vector< pair<hsize_t,hsize_t> > random_ranges;
+  for (size_t r = 0; r < 50; r++)
+    {
+      const hsize_t start = rand() % num_elems;
+      random_ranges.push_back(make_pair(start, rand() % (num_elems - start + 1)));
+    }
+  range_sets.push_back(random_ranges);
+
+  for (auto const& ranges : range_sets)
+    {
+      const vector<T> expected = read_hyperslabs<T>(dset, ntype, ranges);
+      vector<T> values(expected.size());
+      assert(hdf5::read_chunks(dset, ntype, ranges, values.data(), pool) >= 0);
+      assert(values == expected);
+    }
+
+  assert(H5Dclose(dset) >= 0);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  const string file_name = "test_read_chunks.h5";
+
+  // the file is written by rank 0 alone, with the default serial
+  // driver, and read by each rank alone
+  if (rank == 0)
+    {
+      hid_t file = H5Fcreate(file_name.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+      assert(file >= 0);
+      create_dataset<float>(file, "float", H5T_NATIVE_FLOAT, -1.5f);
+      create_dataset<uint32_t>(file, "uint32", H5T_NATIVE_UINT32, 0);
+      create_dataset<uint16_t>(file, "uint16", H5T_NATIVE_UINT16, 7);
+      assert(H5Fclose(file) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  assert(file >= 0);
+  check_dataset<float>(file, "float", H5T_NATIVE_FLOAT);
+  check_dataset<uint32_t>(file, "uint32", H5T_NATIVE_UINT32);
+  check_dataset<uint16_t>(file, "uint16", H5T_NATIVE_UINT16);
+  assert(H5Fclose(file) >= 0);
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,111 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_sample_sort.cc
+///
+///  Test for the distributed sample sort and radix sort permutation.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "sample_sort.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // local radix sort, lexicographic by (a, b)
+  {
+    vector<NODE_IDX_T> a, b;
+    srand(17);
+    for (size_t i=0; i<5000; i++)
+      {
+        a.push_back(rand() % 300);
+        b.push_back(rand());
+      }
+    vector<size_t> perm;
+    mpi::radix_sort_permutation(b, perm);
+    mpi::radix_sort_permutation(a, perm);
+    mpi::permute_column(perm, a);
+    mpi::permute_column(perm, b);
+    for (size_t i=1; i<a.size(); i++)
+      {
+        assert((a[i-1] < a[i]) || ((a[i-1] == a[i]) && (b[i-1] <= b[i])));
+      }
+  }
+
+  // distributed sort with a payload column
+  {
+    vector<NODE_IDX_T> keys;
+    vector<uint64_t> payload;
+    srand(rank+1);
+    size_t num_keys = 1000 * (rank + 1);
+    for (size_t i=0; i<num_keys; i++)
+      {
+        NODE_IDX_T k = rand() % 10000;
+        keys.push_back(k);
+        payload.push_back(2*(uint64_t)k);
+      }
+
+    mpi::bucket_plan_t plan;
+    mpi::sample_sort(MPI_COMM_WORLD, keys, plan);
+    mpi::bucket_exchange(MPI_COMM_WORLD, plan, payload);
+
+    assert(keys.size() == payload.size());
+    for (size_t i=0; i<keys.size(); i++)
+      {
+        assert(payload[i] == 2*(uint64_t)keys[i]);
+        if (i > 0)
+          {
+            assert(keys[i-1] <= keys[i]);
+          }
+      }
+
+    size_t total_keys = keys.size(), expected_total_keys = 0;
+    MPI_Allreduce(MPI_IN_PLACE, &total_keys, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+    for (int p=0; p<size; p++)
+      {
+        expected_total_keys += 1000 * (p + 1);
+      }
+    assert(total_keys == expected_total_keys);
+
+    // the last key of each rank is not greater than the first key of
+    // the next non-empty rank
+    NODE_IDX_T last_key = keys.empty() ? 0 : keys.back();
+    vector<NODE_IDX_T> last_keys(size);
+    vector<int> nonempty(size);
+    int is_nonempty = keys.empty() ? 0 : 1;
+    MPI_Allgather(&last_key, 1, MPI_NODE_IDX_T, &last_keys[0], 1, MPI_NODE_IDX_T, MPI_COMM_WORLD);
+    MPI_Allgather(&is_nonempty, 1, MPI_INT, &nonempty[0], 1, MPI_INT, MPI_COMM_WORLD);
+    if (!keys.empty())
+      {
+        for (int p=0; p<rank; p++)
+          {
+            if (nonempty[p])
+              {
+                assert(last_keys[p] < keys.front());
+              }
+          }
+      }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
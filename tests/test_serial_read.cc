@@ -0,0 +1,198 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_serial_read.cc
+///
+///  Test for the serial fast path of the readers: the edges, trees and
+///  cell attributes read by each rank alone on MPI_COMM_SELF are those
+///  read by all ranks together on MPI_COMM_WORLD, and those written.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <forward_list>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "append_tree.hh"
+#include "scatter_read_tree.hh"
+#include "cell_attributes.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 300, num_dst = 200;
+
+// trees are generated from the gid, so that any rank can rebuild them
+neurotree_t gid_tree (const CELL_IDX_T gid)
+{
+  srand(1000 + gid);
+  return test::random_tree(gid, 1 + rand() % 80);
+}
+
+deque<float> cell_weights (const CELL_IDX_T gid)
+{
+  deque<float> weights;
+  for (size_t i = 0; i < 1 + gid % 4; i++)
+    weights.push_back(gid + 0.5f * i);
+  return weights;
+}
+
+// assigns all nodes to rank 0 of a single-rank communicator, or the
+// nodes to ranks by node % size
+node_rank_map_t make_node_rank_map (MPI_Comm comm)
+{
+  int size;
+  MPI_Comm_size(comm, &size);
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  return node_rank_map;
+}
+
+// reads the projection A -> B with one I/O rank per rank of comm
+edge_map_t read_edges (MPI_Comm comm, const string& file_name, size_t& total_num_edges)
+{
+  int size;
+  MPI_Comm_size(comm, &size);
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0;
+  assert(graph::scatter_read_graph(comm, EdgeMapDst, file_name, size,
+                                   vector<string>(1, "Synapses"), prj_names, make_node_rank_map(comm),
+                                   prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  return prj_vector[0];
+}
+
+// reads the trees and the Weight attribute of population B
+void read_cells (MPI_Comm comm, const string& file_name,
+                 map<CELL_IDX_T, neurotree_t>& tree_map, data::NamedAttrMap& attr_map)
+{
+  int size;
+  MPI_Comm_size(comm, &size);
+  const node_rank_map_t node_rank_map = make_node_rank_map(comm);
+  map<string, data::NamedAttrMap> tree_attr_maps;
+  assert(cell::scatter_read_trees(comm, file_name, size, vector<string>(), node_rank_map,
+                                  "B", num_src, tree_map, tree_attr_maps) >= 0);
+  cell::scatter_read_cell_attributes(comm, file_name, size, "Attributes", set<string>(),
+                                     node_rank_map, "B", num_src, attr_map);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_serial_read.h5";
+
+  // the file is written by rank 0 alone on MPI_COMM_SELF, so that the
+  // writers also open it on a single-rank communicator
+  srand(31);
+  edge_map_t edges;
+  test::random_edge_map(0, num_src, num_src, num_dst, 6, edges);
+  size_t num_edges = 0;
+  for (auto const& it : edges)
+    num_edges += get<0>(it.second).size();
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_src));
+      populations.push_back(make_pair("B", (size_t)num_dst));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+      map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      test::test_edge_attr_index(edge_attr_index);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, edges, 32) >= 0);
+
+      forward_list<neurotree_t> tree_list;
+      map<string, map<CELL_IDX_T, deque<float> > > float_values;
+      for (CELL_IDX_T gid = num_src; gid < num_src + num_dst; gid++)
+        {
+          tree_list.push_front(gid_tree(gid));
+          float_values["Weight"][gid] = cell_weights(gid);
+        }
+      assert(cell::append_trees(MPI_COMM_SELF, file_name, "B", num_src, tree_list, 1, 50, 500) >= 0);
+      cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, "Attributes", "B", num_src,
+                                       map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int32_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                       map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                       float_values, 1, data::optional_hid());
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the parallel read on MPI_COMM_WORLD
+  size_t world_total_num_edges = 0;
+  const edge_map_t world_edges = read_edges(MPI_COMM_WORLD, file_name, world_total_num_edges);
+  assert(world_total_num_edges == num_edges);
+  test::assert_same_edges(world_edges, test::rank_edges(edges, rank, size));
+  map<CELL_IDX_T, neurotree_t> world_trees;
+  data::NamedAttrMap world_attrs;
+  read_cells(MPI_COMM_WORLD, file_name, world_trees, world_attrs);
+
+  // the serial read of every rank on MPI_COMM_SELF returns all edges,
+  // trees and attributes; those of the nodes of this rank are the ones
+  // of the parallel read
+  size_t self_total_num_edges = 0;
+  const edge_map_t self_edges = read_edges(MPI_COMM_SELF, file_name, self_total_num_edges);
+  assert(self_total_num_edges == num_edges);
+  test::assert_same_edges(self_edges, edges);
+  test::assert_same_edges(test::rank_edges(self_edges, rank, size), world_edges);
+
+  map<CELL_IDX_T, neurotree_t> self_trees;
+  data::NamedAttrMap self_attrs;
+  read_cells(MPI_COMM_SELF, file_name, self_trees, self_attrs);
+  assert(self_trees.size() == num_dst);
+  assert(self_attrs.index_set.size() == num_dst);
+  size_t num_rank_cells = 0;
+  for (CELL_IDX_T gid = num_src; gid < num_src + num_dst; gid++)
+    {
+      test::assert_same_tree(self_trees.at(gid), gid_tree(gid));
+      CELL_IDX_T index = gid;
+      const deque<float> weights = self_attrs.find_name<float>("Weight", index);
+      assert(weights == cell_weights(gid));
+      if ((int)(gid % size) == rank)
+        {
+          num_rank_cells++;
+          test::assert_same_tree(world_trees.at(gid), self_trees.at(gid));
+          index = gid;
+          assert(world_attrs.find_name<float>("Weight", index) == weights);
+        }
+    }
+  assert(world_trees.size() == num_rank_cells);
+  assert(world_attrs.index_set.size() == num_rank_cells);
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,195 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_spatial_index.cc
+///
+///  Test for the distributed spatial index, compared with a linear scan
+///  over the coordinates of all cells.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "cell_attributes.hh"
+#include "spatial_index.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+typedef pair<COORD_T, CELL_IDX_T> neighbor_t;
+
+// the neighbors of q among all cells, ordered by distance and gid
+void scan_neighbors (const vector<CELL_IDX_T>& all_gids, const vector<COORD_T>& all_coords,
+                     const COORD_T* q, vector<neighbor_t>& result)
+{
+  result.clear();
+  for (size_t i=0; i<all_gids.size(); i++)
+    {
+      const COORD_T dx = all_coords[3*i] - q[0], dy = all_coords[3*i+1] - q[1], dz = all_coords[3*i+2] - q[2];
+      result.push_back(make_pair(dx*dx + dy*dy + dz*dz, all_gids[i]));
+    }
+  sort(result.begin(), result.end());
+  for (neighbor_t& neighbor : result)
+    {
+      neighbor.first = sqrt(neighbor.first);
+    }
+}
+
+void assert_neighbors (const cell::neighbor_csr_t& neighbors, size_t i, const vector<neighbor_t>& expected)
+{
+  assert(neighbors.ptr[i+1] - neighbors.ptr[i] == expected.size());
+  for (size_t j=0; j<expected.size(); j++)
+    {
+      assert(neighbors.distance[neighbors.ptr[i] + j] == expected[j].first);
+      assert(neighbors.index[neighbors.ptr[i] + j] == expected[j].second);
+    }
+}
+
+void assert_same_neighbors (const cell::neighbor_csr_t& a, const cell::neighbor_csr_t& b)
+{
+  assert(a.ptr == b.ptr);
+  assert(a.index == b.index);
+  assert(a.distance == b.distance);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // cells on a coarse grid, so that many distances are equal and the
+  // order by gid matters; rank r holds the cells with gid % size == r
+  const CELL_IDX_T num_cells = 3000;
+  vector<CELL_IDX_T> all_gids, gids;
+  vector<COORD_T> all_coords, coords;
+  srand(43);
+  for (CELL_IDX_T gid=0; gid<num_cells; gid++)
+    {
+      COORD_T xyz[3] = { (rand() % 200) * 0.5f, (rand() % 100) * 0.5f, (rand() % 40) * 0.5f };
+      all_gids.push_back(gid);
+      all_coords.insert(all_coords.end(), xyz, xyz+3);
+      if ((int)(gid % size) == rank)
+        {
+          gids.push_back(gid);
+          coords.insert(coords.end(), xyz, xyz+3);
+        }
+    }
+
+  vector<COORD_T> queries;
+  for (size_t i=0; i<200; i++)
+    {
+      queries.push_back((rand() % 220) * 0.5f - 5.0f);
+      queries.push_back((rand() % 100) * 0.5f);
+      queries.push_back((rand() % 40) * 0.5f);
+    }
+  // each rank asks a different number of queries
+  queries.resize(3 * (200 - 17 * rank));
+  const size_t num_queries = queries.size() / 3;
+
+  cell::spatial_index_t index;
+  cell::build_spatial_index(MPI_COMM_WORLD, gids, coords, index);
+  assert(index.rank_bounds.size() == 6 * (size_t)size);
+
+  data::thread_pool pool(3);
+  vector<neighbor_t> expected;
+
+  // radius queries
+  const COORD_T radius = 6.0;
+  cell::neighbor_csr_t radius_neighbors;
+  cell::spatial_radius_query(MPI_COMM_WORLD, index, queries, radius, pool, radius_neighbors);
+  assert(radius_neighbors.ptr.size() == num_queries + 1);
+  size_t num_radius_neighbors = 0;
+  for (size_t i=0; i<num_queries; i++)
+    {
+      scan_neighbors(all_gids, all_coords, &queries[3*i], expected);
+      // the index compares squared distances with the squared radius
+      vector<neighbor_t> within;
+      for (const neighbor_t& neighbor : expected)
+        {
+          const COORD_T dx = all_coords[3*neighbor.second] - queries[3*i];
+          const COORD_T dy = all_coords[3*neighbor.second+1] - queries[3*i+1];
+          const COORD_T dz = all_coords[3*neighbor.second+2] - queries[3*i+2];
+          if (dx*dx + dy*dy + dz*dz <= radius * radius)
+            within.push_back(neighbor);
+        }
+      assert_neighbors(radius_neighbors, i, within);
+      num_radius_neighbors += within.size();
+    }
+  assert(num_radius_neighbors > num_queries);
+
+  // nearest-neighbor queries
+  const size_t k = 12;
+  cell::neighbor_csr_t knn_neighbors;
+  cell::spatial_knn_query(MPI_COMM_WORLD, index, queries, k, pool, knn_neighbors);
+  assert(knn_neighbors.ptr.size() == num_queries + 1);
+  for (size_t i=0; i<num_queries; i++)
+    {
+      scan_neighbors(all_gids, all_coords, &queries[3*i], expected);
+      expected.resize(k);
+      assert_neighbors(knn_neighbors, i, expected);
+    }
+
+  // the index built from the coordinate attributes of a file answers
+  // the same queries as the index built from memory
+  {
+    const string file_name = "test_spatial_index.h5";
+    const string pop_name = "GC";
+    const string name_space = "Coordinates";
+    pop_range_map_t pop_ranges;
+    test::create_test_file(MPI_COMM_WORLD, file_name,
+                           vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                           set< pair<pop_t,pop_t> >(), pop_ranges);
+
+    map<string, map<CELL_IDX_T, deque<uint32_t> > > uint32_values;
+    map<string, map<CELL_IDX_T, deque<int32_t> > > int32_values;
+    map<string, map<CELL_IDX_T, deque<uint16_t> > > uint16_values;
+    map<string, map<CELL_IDX_T, deque<int16_t> > > int16_values;
+    map<string, map<CELL_IDX_T, deque<uint8_t> > > uint8_values;
+    map<string, map<CELL_IDX_T, deque<int8_t> > > int8_values;
+    map<string, map<CELL_IDX_T, deque<float> > > float_values;
+    for (size_t i=0; i<gids.size(); i++)
+      {
+        float_values[hdf5::X_COORD][gids[i]] = deque<float>(1, coords[3*i]);
+        float_values[hdf5::Y_COORD][gids[i]] = deque<float>(1, coords[3*i+1]);
+        float_values[hdf5::Z_COORD][gids[i]] = deque<float>(1, coords[3*i+2]);
+      }
+    cell::append_cell_attribute_maps(MPI_COMM_WORLD, file_name, name_space, pop_name, 0,
+                                     uint32_values, int32_values, uint16_values, int16_values,
+                                     uint8_values, int8_values, float_values, size,
+                                     data::optional_hid());
+
+    cell::spatial_index_t file_index;
+    cell::build_spatial_index(MPI_COMM_WORLD, file_name, name_space, pop_name, 0, file_index);
+
+    cell::neighbor_csr_t file_radius_neighbors, file_knn_neighbors;
+    cell::spatial_radius_query(MPI_COMM_WORLD, file_index, queries, radius, pool, file_radius_neighbors);
+    cell::spatial_knn_query(MPI_COMM_WORLD, file_index, queries, k, pool, file_knn_neighbors);
+    assert_same_neighbors(file_radius_neighbors, radius_neighbors);
+    assert_same_neighbors(file_knn_neighbors, knn_neighbors);
+
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+  }
+
+  MPI_Finalize();
+  return 0;
+}
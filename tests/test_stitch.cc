@@ -0,0 +1,213 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_stitch.cc
+///
+///  Test for stitch_projection and stitch_cell_attributes: a projection
+///  and a cell attribute namespace written to two part files and
+///  stitched into a master file are read as if both parts had been
+///  appended to a single file, with and without copying the parts.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "cell_attributes.hh"
+#include "stitch_projection.hh"
+#include "stitch_cell_attributes.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 200, num_dst = 300;
+const string name_space = "Attributes";
+
+deque<float> cell_weights (const CELL_IDX_T gid)
+{
+  deque<float> weights;
+  for (size_t i = 0; i < 1 + gid % 3; i++)
+    weights.push_back(gid + 0.125f * i);
+  return weights;
+}
+
+void create_file (const string& file_name)
+{
+  pop_range_map_t pop_ranges;
+  vector< pair<string,size_t> > populations;
+  populations.push_back(make_pair("A", (size_t)num_src));
+  populations.push_back(make_pair("B", (size_t)num_dst));
+  test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                         set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+}
+
+// appends the edges of part p and the Weight attribute of its cells,
+// the alternate blocks of 50 cells that start with block p; the
+// destinations may have edges in both parts
+void append_part (const string& file_name, const edge_map_t& edges, const size_t p)
+{
+  map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+  test::test_edge_attr_index(edge_attr_index);
+  assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, edges, 16) >= 0);
+
+  map<string, map<CELL_IDX_T, deque<float> > > float_values;
+  for (CELL_IDX_T gid = num_src; gid < num_src + num_dst; gid++)
+    {
+      if ((gid / 50) % 2 == p)
+        float_values["Weight"][gid] = cell_weights(gid);
+    }
+  cell::append_cell_attribute_maps(MPI_COMM_SELF, file_name, name_space, "B", num_src,
+                                   map<string, map<CELL_IDX_T, deque<uint32_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int32_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<uint16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int16_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<uint8_t> > >(),
+                                   map<string, map<CELL_IDX_T, deque<int8_t> > >(),
+                                   float_values, 1, data::optional_hid());
+}
+
+// reads the edges and the Weight attribute with the nodes assigned to
+// ranks by node % size
+void read_file (const string& file_name, edge_map_t& edge_map, size_t& total_num_edges,
+                data::NamedAttrMap& attr_map)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0;
+  assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size,
+                                   vector<string>(1, "Synapses"), prj_names, node_rank_map,
+                                   prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  edge_map = prj_vector[0];
+  cell::scatter_read_cell_attributes(MPI_COMM_WORLD, file_name, size, name_space, set<string>(),
+                                     node_rank_map, "B", num_src, attr_map);
+}
+
+// asserts that file_name holds the same edges and attributes as the
+// file written directly
+void assert_same_file (const string& file_name, const edge_map_t& direct_edges,
+                       const size_t direct_num_edges, data::NamedAttrMap& direct_attrs)
+{
+  edge_map_t edge_map;
+  size_t total_num_edges = 0;
+  data::NamedAttrMap attr_map;
+  read_file(file_name, edge_map, total_num_edges, attr_map);
+  assert(total_num_edges == direct_num_edges);
+  test::assert_same_edges(edge_map, direct_edges);
+  assert(attr_map.index_set == direct_attrs.index_set);
+  for (const CELL_IDX_T gid : direct_attrs.index_set)
+    {
+      CELL_IDX_T index = gid, direct_index = gid;
+      assert(attr_map.find_name<float>("Weight", index) ==
+             direct_attrs.find_name<float>("Weight", direct_index));
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string direct_name = "test_stitch.direct.h5", master_name = "test_stitch.h5",
+    copy_name = "test_stitch.copy.h5";
+  const vector<string> part_names({ "test_stitch.0.h5", "test_stitch.1.h5" });
+
+  srand(41);
+  vector<edge_map_t> parts(2);
+  edge_map_t edges;
+  for (size_t p = 0; p < parts.size(); p++)
+    {
+      test::random_edge_map(0, num_src, num_src, num_dst, 4, parts[p]);
+      test::merge_edge_maps(edges, parts[p]);
+    }
+
+  // each part is written by its own rank, as separate I/O groups would
+  // write them, and the same data is appended to one file by rank 0
+  for (size_t p = 0; p < parts.size(); p++)
+    {
+      if ((int)(p % size) == rank)
+        {
+          create_file(part_names[p]);
+          append_part(part_names[p], parts[p], p);
+        }
+    }
+  if (rank == 0)
+    {
+      create_file(direct_name);
+      for (size_t p = 0; p < parts.size(); p++)
+        {
+          append_part(direct_name, parts[p], p);
+        }
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the parts are stitched by rank 0, once referring to the part files
+  // and once into a file that holds copies of them
+  if (rank == 0)
+    {
+      for (const string& file_name : { master_name, copy_name })
+        {
+          const bool copy_parts = (file_name == copy_name);
+          create_file(file_name);
+          graph::stitch_projection(MPI_COMM_SELF, file_name, part_names, "A", "B", copy_parts);
+          cell::stitch_cell_attributes(MPI_COMM_SELF, file_name, part_names, name_space, "B", copy_parts);
+        }
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  edge_map_t direct_edges;
+  size_t direct_num_edges = 0;
+  data::NamedAttrMap direct_attrs;
+  read_file(direct_name, direct_edges, direct_num_edges, direct_attrs);
+  size_t num_edges = 0;
+  for (auto const& it : edges)
+    num_edges += get<0>(it.second).size();
+  assert(direct_num_edges == num_edges);
+  test::assert_same_edges(direct_edges, test::rank_edges(edges, rank, size));
+  assert(!direct_attrs.index_set.empty());
+
+  assert_same_file(master_name, direct_edges, direct_num_edges, direct_attrs);
+  assert_same_file(copy_name, direct_edges, direct_num_edges, direct_attrs);
+
+  // the file with copies of the parts does not need the part files
+  for (const string& file_name : part_names)
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+  assert_same_file(copy_name, direct_edges, direct_num_edges, direct_attrs);
+
+  for (const string& file_name : { direct_name, master_name, copy_name })
+    test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,211 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_text_parser.cc
+///
+///  Test for the text record parsers and the parallel text edge reader,
+///  compared with parsing through iostreams.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "attr_val.hh"
+#include "text_parser.hh"
+#include "read_txt_edges.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+template <class T>
+bool parse_unsigned_str (const string& s, T& value)
+{
+  const char* p = s.c_str();
+  return io::parse_unsigned(p, p + s.size(), value);
+}
+
+template <class T>
+bool parse_signed_str (const string& s, T& value)
+{
+  const char* p = s.c_str();
+  return io::parse_signed(p, p + s.size(), value);
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  // values in range agree with iostreams
+  {
+    srand(29);
+    for (size_t i=0; i<10000; i++)
+      {
+        uint32_t u = ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+        int32_t  v = (int32_t)u;
+        double   x = ((double)rand() / RAND_MAX - 0.5) * pow(10.0, (rand() % 20) - 10);
+        ostringstream os;
+        os.precision(17);
+        os << u << " " << v << ", " << x << "\n";
+
+        const string line = os.str();
+        const char* p = line.c_str();
+        const char* end = p + line.size();
+        uint32_t pu; int32_t pv; double px;
+        assert(io::parse_unsigned(p, end, pu));
+        assert(io::parse_signed(p, end, pv));
+        assert(io::parse_real(p, end, px));
+        assert(!io::parse_real(p, end, px));
+        assert(*p == '\n');
+
+        istringstream is(line);
+        uint32_t su; int32_t sv; double sx; char sep;
+        is >> su >> sv >> sep >> sx;
+        assert(pu == su);
+        assert(pv == sv);
+        // exact for up to 19 significant digits and small exponents
+        assert(fabs(px - sx) <= 1e-15 * fabs(sx));
+      }
+  }
+
+  // values outside the range of the result type are rejected
+  {
+    uint8_t u8; uint16_t u16; uint32_t u32; uint64_t u64;
+    int8_t i8; int16_t i16; int32_t i32; int64_t i64;
+
+    assert(parse_unsigned_str("255", u8) && (u8 == 255));
+    assert(!parse_unsigned_str("256", u8));
+    assert(parse_unsigned_str("65535", u16) && (u16 == 65535));
+    assert(!parse_unsigned_str("65536", u16));
+    assert(parse_unsigned_str("4294967295", u32) && (u32 == 4294967295U));
+    assert(!parse_unsigned_str("4294967296", u32));
+    assert(parse_unsigned_str("18446744073709551615", u64) &&
+           (u64 == 18446744073709551615ULL));
+    assert(!parse_unsigned_str("18446744073709551616", u64));
+    assert(!parse_unsigned_str("99999999999999999999", u64));
+
+    assert(parse_signed_str("-128", i8) && (i8 == -128));
+    assert(parse_signed_str("127", i8) && (i8 == 127));
+    assert(!parse_signed_str("-129", i8));
+    assert(!parse_signed_str("128", i8));
+    assert(parse_signed_str("-32768", i16) && (i16 == -32768));
+    assert(!parse_signed_str("32768", i16));
+    assert(parse_signed_str("-2147483648", i32) && (i32 == INT32_MIN));
+    assert(!parse_signed_str("2147483648", i32));
+    assert(parse_signed_str("-9223372036854775808", i64) && (i64 == INT64_MIN));
+    assert(parse_signed_str("9223372036854775807", i64) && (i64 == INT64_MAX));
+    assert(!parse_signed_str("9223372036854775808", i64));
+    assert(!parse_signed_str("-9223372036854775809", i64));
+
+    assert(!parse_unsigned_str("", u32));
+    assert(!parse_unsigned_str("  \n1", u32));
+    assert(io::is_number_next(" -3", " -3" + 3));
+    assert(!io::is_number_next("# 3", "# 3" + 3));
+  }
+
+  // parallel edge reader agrees with reading the file through iostreams
+  {
+    const string file_name = "test_text_parser_edges.txt";
+    const size_t num_edges = 20000;
+    if (rank == 0)
+      {
+        ofstream out(file_name.c_str());
+        srand(31);
+        out << "# dst src distance weight\n";
+        for (size_t i=0; i<num_edges; i++)
+          {
+            out << rand() % 1000 << "\t" << rand() % 5000 << " "
+                << (rand() % 100000) / 100.0 << " " << rand() % 60000 << "\n";
+            if (i % 997 == 0)
+              {
+                out << "\n";
+              }
+          }
+      }
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    map<string, vector<size_t> > num_attrs;
+    num_attrs["Attributes"] = vector<size_t>(data::AttrVal::num_attr_types, 0);
+    num_attrs["Attributes"][data::AttrVal::attr_index_float] = 1;
+    num_attrs["Attributes"][data::AttrVal::attr_index_uint16] = 1;
+
+    vector<NODE_IDX_T> dst, src;
+    map<string, data::NamedAttrVal> edge_attr_map;
+    assert(io::read_txt_edges(MPI_COMM_WORLD, vector<string>(1, file_name),
+                              num_attrs, dst, src, edge_attr_map) == 0);
+    const data::NamedAttrVal& edge_attr = edge_attr_map["Attributes"];
+    assert(edge_attr.float_values.size() == 1);
+    assert(edge_attr.uint16_values.size() == 1);
+    assert(edge_attr.float_values[0].size() == dst.size());
+    assert(edge_attr.uint16_values[0].size() == dst.size());
+
+    // gather the edges of all ranks in rank order
+    int local_count = dst.size();
+    vector<int> counts(size), displs(size, 0);
+    MPI_Allgather(&local_count, 1, MPI_INT, &counts[0], 1, MPI_INT, MPI_COMM_WORLD);
+    for (int i=1; i<size; i++)
+      {
+        displs[i] = displs[i-1] + counts[i-1];
+      }
+    const size_t total = displs[size-1] + counts[size-1];
+    assert(total == num_edges);
+    vector<NODE_IDX_T> all_dst(total), all_src(total);
+    vector<float> all_distance(total);
+    vector<uint16_t> all_weight(total);
+    MPI_Allgatherv(&dst[0], local_count, MPI_UINT32_T,
+                   &all_dst[0], &counts[0], &displs[0], MPI_UINT32_T, MPI_COMM_WORLD);
+    MPI_Allgatherv(&src[0], local_count, MPI_UINT32_T,
+                   &all_src[0], &counts[0], &displs[0], MPI_UINT32_T, MPI_COMM_WORLD);
+    MPI_Allgatherv(&edge_attr.float_values[0][0], local_count, MPI_FLOAT,
+                   &all_distance[0], &counts[0], &displs[0], MPI_FLOAT, MPI_COMM_WORLD);
+    MPI_Allgatherv(&edge_attr.uint16_values[0][0], local_count, MPI_UINT16_T,
+                   &all_weight[0], &counts[0], &displs[0], MPI_UINT16_T, MPI_COMM_WORLD);
+
+    ifstream in(file_name.c_str());
+    string line;
+    size_t i = 0;
+    while (getline(in, line))
+      {
+        if (line.empty() || (line[0] == '#'))
+          continue;
+        istringstream is(line);
+        NODE_IDX_T d, s; float distance; uint16_t weight;
+        is >> d >> s >> distance >> weight;
+        assert(!is.fail());
+        assert(all_dst[i] == d);
+        assert(all_src[i] == s);
+        assert(all_distance[i] == distance);
+        assert(all_weight[i] == weight);
+        i++;
+      }
+    assert(i == num_edges);
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    if (rank == 0)
+      {
+        remove(file_name.c_str());
+      }
+  }
+
+  MPI_Finalize();
+  return 0;
+}
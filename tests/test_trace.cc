@@ -0,0 +1,192 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_trace.cc
+///
+///  Test for the phase tracing of scatter_read_projection: the edges read
+///  with and without tracing are the same, and the phase totals and trace
+///  events account for every call and every edge read.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "mpi_trace.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// returns the number of occurrences of pattern in text
+size_t count_occurrences (const string& text, const string& pattern)
+{
+  size_t n = 0;
+  for (size_t pos = text.find(pattern); pos != string::npos; pos = text.find(pattern, pos + 1))
+    n++;
+  return n;
+}
+
+// reads the projection A -> B into edge_map with the nodes assigned to
+// ranks by node % size
+void read_projection (const string& file_name, const vector<string>& attr_namespaces,
+                      edge_map_t& edge_map, size_t& total_num_edges)
+{
+  int size;
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < 700; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0;
+  assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size, attr_namespaces,
+                                   prj_names, node_rank_map, prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  edge_map = prj_vector[0];
+}
+
+// reads the trace written by write_trace on rank 0
+string read_trace (const string& file_name)
+{
+  ifstream in(file_name.c_str());
+  assert(in.good());
+  stringstream ss;
+  ss << in.rdbuf();
+  const string text = ss.str();
+  assert(text.find("{\"traceEvents\":[") == 0);
+  return text;
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_trace.h5", trace_name = "test_trace.json";
+  const vector<string> attr_namespaces(1, "Synapses");
+
+  // the file is written by rank 0 alone and read by all ranks
+  srand(17);
+  edge_map_t edges;
+  test::random_edge_map(0, 400, 400, 300, 6, edges);
+  size_t num_edges = 0;
+  for (auto const& it : edges)
+    num_edges += get<0>(it.second).size();
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)400));
+      populations.push_back(make_pair("B", (size_t)300));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+      map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      test::test_edge_attr_index(edge_attr_index);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, edges, 16) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+  const edge_map_t local_edges = test::rank_edges(edges, rank, size);
+
+  // the edges read without tracing are the edges written; the phase
+  // totals are kept, but no trace events are recorded
+  const bool was_enabled = mpi::trace_enabled();
+  mpi::set_trace_enabled(false);
+  mpi::trace_reset();
+  edge_map_t untraced_edges;
+  size_t total_num_edges = 0;
+  read_projection(file_name, attr_namespaces, untraced_edges, total_num_edges);
+  assert(total_num_edges == num_edges);
+  test::assert_same_edges(untraced_edges, local_edges);
+  assert(mpi::trace_local_stats()["scatter_read_projection"].calls == 1);
+  mpi::write_trace(MPI_COMM_WORLD, trace_name);
+  if (rank == 0)
+    {
+      const string text = read_trace(trace_name);
+      assert(count_occurrences(text, "\"ph\":\"X\"") == 0);
+      assert(count_occurrences(text, "\"name\":\"process_name\"") == (size_t)size);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the edges read with tracing are the same
+  mpi::set_trace_enabled(true);
+  mpi::trace_reset();
+  edge_map_t traced_edges;
+  read_projection(file_name, attr_namespaces, traced_edges, total_num_edges);
+  assert(total_num_edges == num_edges);
+  test::assert_same_edges(traced_edges, local_edges);
+
+  // every rank calls scatter_read_projection once, the I/O ranks read
+  // and validate each edge once, and each edge reaches its rank once
+  map<string, mpi::phase_summary_t> summary = mpi::trace_summary(MPI_COMM_WORLD);
+  assert(summary["scatter_read_projection"].calls == (uint64_t)size);
+  assert(summary["scatter_read_projection"].ranks == (uint64_t)size);
+  assert(summary["scatter_read_projection.read"].items == num_edges);
+  assert(summary["scatter_read_projection.validate"].items == num_edges);
+  assert(summary["scatter_read_projection.attributes"].items == num_edges);
+  assert(summary["scatter_read_projection.append_rank_edge_map"].items == num_edges);
+  if (size == 1)
+    {
+      assert(summary["scatter_read_projection.merge"].items == num_edges);
+      assert(summary.count("scatter_read_projection.deserialize") == 0);
+    }
+  else
+    {
+      assert(summary["scatter_read_projection.serialize"].items == num_edges);
+      assert(summary["scatter_read_projection.deserialize"].items == num_edges);
+    }
+  for (auto const& it : summary)
+    {
+      assert(it.second.min_seconds <= it.second.mean_seconds);
+      assert(it.second.mean_seconds <= it.second.max_seconds);
+    }
+  assert(!mpi::format_trace_summary(summary).empty());
+
+  // the trace holds one event per call of each phase
+  mpi::write_trace(MPI_COMM_WORLD, trace_name);
+  if (rank == 0)
+    {
+      const string text = read_trace(trace_name);
+      size_t num_events = 0;
+      for (auto const& it : summary)
+        {
+          assert(count_occurrences(text, "{\"name\":\"" + it.first + "\",\"ph\":\"X\"") == it.second.calls);
+          num_events += it.second.calls;
+        }
+      assert(count_occurrences(text, "\"ph\":\"X\"") == num_events);
+      remove(trace_name.c_str());
+    }
+
+  mpi::set_trace_enabled(was_enabled);
+  mpi::trace_reset();
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
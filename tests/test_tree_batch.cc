@@ -0,0 +1,250 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_tree_batch.cc
+///
+///  Test for reading trees into a TreeBatch, compared with reading the
+///  Trees namespace through the generic cell attribute reader.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <forward_list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "tree_batch.hh"
+#include "cell_attributes.hh"
+#include "append_tree.hh"
+#include "read_tree.hh"
+#include "scatter_read_tree.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// trees are generated from the gid, so that any rank can rebuild them
+neurotree_t gid_tree (const CELL_IDX_T gid)
+{
+  srand(1000 + gid);
+  return test::random_tree(gid, 1 + rand() % 120);
+}
+
+bool has_tree (const CELL_IDX_T gid)
+{
+  return (gid % 7) != 3;
+}
+
+// the trees of the Trees namespace, as the tree readers built them
+// from the cell attribute reader
+void attr_map_trees (data::NamedAttrMap& attr_values, map<CELL_IDX_T, neurotree_t>& trees)
+{
+  for (CELL_IDX_T idx : attr_values.index_set)
+    {
+      trees[idx] =
+        make_tuple(idx,
+                   attr_values.find_name<SECTION_IDX_T>(hdf5::SRCSEC, idx),
+                   attr_values.find_name<SECTION_IDX_T>(hdf5::DSTSEC, idx),
+                   attr_values.find_name<SECTION_IDX_T>(hdf5::SECTION, idx),
+                   attr_values.find_name<COORD_T>(hdf5::X_COORD, idx),
+                   attr_values.find_name<COORD_T>(hdf5::Y_COORD, idx),
+                   attr_values.find_name<COORD_T>(hdf5::Z_COORD, idx),
+                   attr_values.find_name<REALVAL_T>(hdf5::RADIUS, idx),
+                   attr_values.find_name<LAYER_IDX_T>(hdf5::LAYER, idx),
+                   attr_values.find_name<PARENT_NODE_IDX_T>(hdf5::PARENT, idx),
+                   attr_values.find_name<SWC_TYPE_T>(hdf5::SWCTYPE, idx));
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_tree_batch.h5";
+  const string pop_name = "GC";
+  const CELL_IDX_T num_cells = 300;
+
+  pop_range_map_t pop_ranges;
+  test::create_test_file(MPI_COMM_WORLD, file_name,
+                         vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                         set< pair<pop_t,pop_t> >(), pop_ranges);
+
+  {
+    forward_list<neurotree_t> tree_list;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += size)
+      {
+        if (has_tree(gid))
+          {
+            tree_list.push_front(gid_tree(gid));
+          }
+      }
+    assert(cell::append_trees(MPI_COMM_WORLD, file_name, pop_name, 0, tree_list, size, 50, 500) >= 0);
+  }
+
+  // full read: the batch holds the same trees as the cell attribute
+  // reader, in file order
+  {
+    data::NamedAttrMap attr_values;
+    cell::read_cell_attributes(MPI_COMM_WORLD, file_name, hdf5::TREES, set<string>(),
+                               pop_name, 0, attr_values);
+    map<CELL_IDX_T, neurotree_t> ref_trees;
+    attr_map_trees(attr_values, ref_trees);
+
+    data::TreeBatch tree_batch;
+    assert(cell::read_trees(MPI_COMM_WORLD, file_name, pop_name, 0, tree_batch) == 0);
+    tree_batch.validate();
+    assert(tree_batch.fields == data::TreeFieldAll);
+    assert(tree_batch.size() == ref_trees.size());
+
+    set<CELL_IDX_T> batch_gids;
+    for (size_t i = 0; i < tree_batch.size(); i++)
+      {
+        auto it = ref_trees.find(tree_batch.index[i]);
+        assert(it != ref_trees.end());
+        batch_gids.insert(it->first);
+        neurotree_t tree = tree_batch.tree(i);
+        test::assert_same_tree(tree, it->second);
+        test::assert_same_tree(tree, gid_tree(it->first));
+        assert(tree_batch.tree_x(i).size() == get<4>(tree).size());
+        assert(tree_batch.tree_sections(i).size() == get<3>(tree).size());
+      }
+    assert(batch_gids.size() == ref_trees.size());
+
+    size_t local_num_trees = tree_batch.size(), num_trees = 0;
+    MPI_Allreduce(&local_num_trees, &num_trees, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+    size_t expected_num_trees = 0;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        expected_num_trees += has_tree(gid) ? 1 : 0;
+      }
+    assert(num_trees == expected_num_trees);
+
+    // the list conversion is ordered by decreasing gid
+    forward_list<neurotree_t> tree_list;
+    assert(cell::read_trees(MPI_COMM_WORLD, file_name, pop_name, 0, tree_list) == 0);
+    auto ref_it = ref_trees.crbegin();
+    for (const neurotree_t& tree : tree_list)
+      {
+        assert(ref_it != ref_trees.crend());
+        test::assert_same_tree(tree, ref_it->second);
+        ++ref_it;
+      }
+    assert(ref_it == ref_trees.crend());
+  }
+
+  // masked read: only the requested columns are present
+  {
+    set<string> tree_mask;
+    tree_mask.insert(hdf5::X_COORD);
+    tree_mask.insert(hdf5::SECTION);
+
+    data::NamedAttrMap attr_values;
+    cell::read_cell_attributes(MPI_COMM_WORLD, file_name, hdf5::TREES, tree_mask,
+                               pop_name, 0, attr_values);
+
+    data::TreeBatch tree_batch;
+    assert(cell::read_trees(MPI_COMM_WORLD, file_name, pop_name, 0, tree_batch,
+                            0, 0, tree_mask) == 0);
+    tree_batch.validate();
+    assert(tree_batch.fields == (data::TreeFieldX | data::TreeFieldSections));
+    assert(tree_batch.y.empty() && tree_batch.src.empty() && tree_batch.parent.empty());
+    assert(tree_batch.size() == attr_values.index_set.size());
+    for (size_t i = 0; i < tree_batch.size(); i++)
+      {
+        CELL_IDX_T idx = tree_batch.index[i];
+        assert(attr_values.index_set.count(idx) > 0);
+        deque<COORD_T> x = attr_values.find_name<COORD_T>(hdf5::X_COORD, idx);
+        deque<SECTION_IDX_T> sections = attr_values.find_name<SECTION_IDX_T>(hdf5::SECTION, idx);
+        assert(equal(x.begin(), x.end(), tree_batch.tree_x(i).begin()));
+        assert(x.size() == tree_batch.tree_x(i).size());
+        assert(equal(sections.begin(), sections.end(), tree_batch.tree_sections(i).begin()));
+        assert(tree_batch.tree_y(i).size() == 0);
+      }
+  }
+
+  // selection read, including gids without a tree
+  {
+    vector<CELL_IDX_T> selection;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += 3 * size)
+      {
+        selection.push_back(gid);
+      }
+
+    data::NamedAttrMap attr_values;
+    cell::read_cell_attribute_selection(MPI_COMM_WORLD, file_name, hdf5::TREES, set<string>(),
+                                        pop_name, 0, selection, attr_values);
+    map<CELL_IDX_T, neurotree_t> ref_trees;
+    attr_map_trees(attr_values, ref_trees);
+
+    data::TreeBatch tree_batch;
+    assert(cell::read_tree_selection(MPI_COMM_WORLD, file_name, pop_name, 0,
+                                     tree_batch, selection) == 0);
+    tree_batch.validate();
+    assert(tree_batch.size() == ref_trees.size());
+    for (size_t i = 0; i < tree_batch.size(); i++)
+      {
+        auto it = ref_trees.find(tree_batch.index[i]);
+        assert(it != ref_trees.end());
+        assert(has_tree(it->first));
+        test::assert_same_tree(tree_batch.tree(i), it->second);
+      }
+  }
+
+  // scattered read: every rank receives the trees it is assigned
+  {
+    node_rank_map_t node_rank_map;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        node_rank_map[gid].insert((gid * 7) % size);
+      }
+
+    data::TreeBatch tree_batch;
+    map<string, data::NamedAttrMap> attr_maps;
+    assert(cell::scatter_read_trees(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                    node_rank_map, pop_name, 0, tree_batch, attr_maps) == 0);
+    tree_batch.validate();
+
+    set<CELL_IDX_T> expected_gids, received_gids;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        if (has_tree(gid) && ((int)((gid * 7) % size) == rank))
+          expected_gids.insert(gid);
+      }
+    for (size_t i = 0; i < tree_batch.size(); i++)
+      {
+        received_gids.insert(tree_batch.index[i]);
+        test::assert_same_tree(tree_batch.tree(i), gid_tree(tree_batch.index[i]));
+      }
+    assert(received_gids == expected_gids);
+
+    map<CELL_IDX_T, neurotree_t> tree_map;
+    assert(cell::scatter_read_trees(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                    node_rank_map, pop_name, 0, tree_map, attr_maps) == 0);
+    assert(tree_map.size() == tree_batch.size());
+    for (size_t i = 0; i < tree_batch.size(); i++)
+      {
+        test::assert_same_tree(tree_map[tree_batch.index[i]], tree_batch.tree(i));
+      }
+  }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
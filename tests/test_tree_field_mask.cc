@@ -0,0 +1,247 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_tree_field_mask.cc
+///
+///  Test for partial tree reads: each column read with a tree field
+///  mask must equal the same column of a full read, and the columns
+///  outside the mask must be empty.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <forward_list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "tree_batch.hh"
+#include "tree_template_set.hh"
+#include "append_tree.hh"
+#include "read_tree.hh"
+#include "scatter_read_tree.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+neurotree_t gid_tree (const CELL_IDX_T gid)
+{
+  srand(3000 + gid);
+  return test::random_tree(gid, 1 + rand() % 100);
+}
+
+template <class T>
+void assert_same_column (bool present, const data::column_view<T>& masked, const data::column_view<T>& full)
+{
+  if (present)
+    {
+      assert(masked.size() == full.size());
+      assert(equal(full.begin(), full.end(), masked.begin()));
+    }
+  else
+    {
+      assert(masked.size() == 0);
+    }
+}
+
+// compares the trees of a masked batch with the same trees of a full batch
+void assert_masked_batch (const data::TreeBatch& masked, const data::TreeBatch& full,
+                          const uint32_t fields)
+{
+  masked.validate();
+  assert(masked.fields == fields);
+  assert(masked.size() == full.size());
+
+  map<CELL_IDX_T, size_t> full_pos;
+  for (size_t i = 0; i < full.size(); i++)
+    {
+      full_pos[full.index[i]] = i;
+    }
+
+  if (!masked.has(data::TreeFieldX)) assert(masked.x.empty());
+  if (!masked.has(data::TreeFieldParent)) assert(masked.parent.empty());
+  if (!masked.has(data::TreeFieldSections)) assert(masked.sections.empty());
+  if (!masked.has(data::TreeFieldSrc)) assert(masked.src.empty());
+  if ((fields & data::TreeFieldPoints) == 0)
+    {
+      for (ATTR_PTR_T p : masked.attr_ptr) assert(p == 0);
+    }
+  if ((fields & (data::TreeFieldSrc | data::TreeFieldDst)) == 0)
+    {
+      for (TOPO_PTR_T p : masked.topo_ptr) assert(p == 0);
+    }
+
+  for (size_t i = 0; i < masked.size(); i++)
+    {
+      auto it = full_pos.find(masked.index[i]);
+      assert(it != full_pos.end());
+      const size_t j = it->second;
+      assert_same_column(masked.has(data::TreeFieldSrc), masked.tree_src(i), full.tree_src(j));
+      assert_same_column(masked.has(data::TreeFieldDst), masked.tree_dst(i), full.tree_dst(j));
+      assert_same_column(masked.has(data::TreeFieldSections), masked.tree_sections(i), full.tree_sections(j));
+      assert_same_column(masked.has(data::TreeFieldX), masked.tree_x(i), full.tree_x(j));
+      assert_same_column(masked.has(data::TreeFieldY), masked.tree_y(i), full.tree_y(j));
+      assert_same_column(masked.has(data::TreeFieldZ), masked.tree_z(i), full.tree_z(j));
+      assert_same_column(masked.has(data::TreeFieldRadius), masked.tree_radius(i), full.tree_radius(j));
+      assert_same_column(masked.has(data::TreeFieldLayer), masked.tree_layer(i), full.tree_layer(j));
+      assert_same_column(masked.has(data::TreeFieldParent), masked.tree_parent(i), full.tree_parent(j));
+      assert_same_column(masked.has(data::TreeFieldSWCType), masked.tree_swc_type(i), full.tree_swc_type(j));
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_tree_field_mask.h5";
+  const string pop_name = "GC";
+  const CELL_IDX_T num_cells = 160;
+  const CELL_IDX_T num_templates = 2;
+
+  pop_range_map_t pop_ranges;
+  test::create_test_file(MPI_COMM_WORLD, file_name,
+                         vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                         set< pair<pop_t,pop_t> >(), pop_ranges);
+
+  // odd cells store a tree, even cells refer to a translated template
+  {
+    forward_list<neurotree_t> tree_list, template_list;
+    data::TreeTemplateSet template_refs;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += size)
+      {
+        if (gid % 2 == 1)
+          tree_list.push_front(gid_tree(gid));
+        else
+          template_refs.append_ref(gid, gid % num_templates, 1.0 * gid, -2.0, 0.5);
+      }
+    if (rank == 0)
+      {
+        for (CELL_IDX_T t = 0; t < num_templates; t++)
+          {
+            // the gid of a template tree is its template id
+            neurotree_t template_tree = gid_tree(num_cells + t);
+            get<0>(template_tree) = t;
+            template_list.push_front(template_tree);
+          }
+      }
+    assert(cell::append_trees(MPI_COMM_WORLD, file_name, pop_name, 0, tree_list, size) >= 0);
+    assert(cell::append_tree_templates(MPI_COMM_WORLD, file_name, pop_name, template_list, size) >= 0);
+    assert(cell::append_tree_template_index(MPI_COMM_WORLD, file_name, pop_name, 0,
+                                            template_refs, size) >= 0);
+  }
+
+  vector< set<string> > tree_masks(4);
+  tree_masks[0].insert(hdf5::X_COORD);
+  tree_masks[0].insert(hdf5::Y_COORD);
+  tree_masks[0].insert(hdf5::Z_COORD);
+  tree_masks[1].insert(hdf5::SECTION);
+  tree_masks[1].insert(hdf5::SRCSEC);
+  tree_masks[1].insert(hdf5::DSTSEC);
+  tree_masks[2].insert(hdf5::RADIUS);
+  tree_masks[2].insert(hdf5::PARENT);
+  tree_masks[2].insert(hdf5::SWCTYPE);
+  tree_masks[3].insert(hdf5::LAYER);
+  tree_masks[3].insert(hdf5::SECTION);
+
+  assert(data::tree_field_mask(set<string>()) == data::TreeFieldAll);
+  assert(data::tree_field_mask(tree_masks[0]) == data::TreeFieldCoords);
+  assert(data::tree_field_mask(tree_masks[1]) == data::TreeFieldTopology);
+
+  // local reads, with the templates expanded
+  {
+    data::TreeBatch full_batch;
+    assert(cell::read_trees(MPI_COMM_WORLD, file_name, pop_name, 0, full_batch) == 0);
+    for (const set<string>& tree_mask : tree_masks)
+      {
+        data::TreeBatch masked_batch;
+        assert(cell::read_trees(MPI_COMM_WORLD, file_name, pop_name, 0, masked_batch,
+                                0, 0, tree_mask) == 0);
+        assert_masked_batch(masked_batch, full_batch, data::tree_field_mask(tree_mask));
+      }
+
+    vector<CELL_IDX_T> selection;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += 5)
+      selection.push_back(gid);
+    data::TreeBatch full_selection;
+    assert(cell::read_tree_selection(MPI_COMM_WORLD, file_name, pop_name, 0,
+                                     full_selection, selection) == 0);
+    for (const set<string>& tree_mask : tree_masks)
+      {
+        data::TreeBatch masked_selection;
+        assert(cell::read_tree_selection(MPI_COMM_WORLD, file_name, pop_name, 0,
+                                         masked_selection, selection, tree_mask) == 0);
+        assert_masked_batch(masked_selection, full_selection, data::tree_field_mask(tree_mask));
+      }
+
+    vector<CELL_IDX_T> template_selection;
+    for (CELL_IDX_T t = 0; t < num_templates; t++)
+      template_selection.push_back(t);
+    data::TreeBatch full_templates;
+    assert(cell::read_tree_templates(MPI_COMM_WORLD, file_name, pop_name,
+                                     full_templates, template_selection) == 0);
+    assert(full_templates.size() == (size_t)num_templates);
+    for (const set<string>& tree_mask : tree_masks)
+      {
+        data::TreeBatch masked_templates;
+        assert(cell::read_tree_templates(MPI_COMM_WORLD, file_name, pop_name,
+                                         masked_templates, template_selection, tree_mask) == 0);
+        assert_masked_batch(masked_templates, full_templates, data::tree_field_mask(tree_mask));
+      }
+  }
+
+  // scattered reads: only the masked columns are sent
+  {
+    node_rank_map_t node_rank_map;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      node_rank_map[gid].insert((gid + 1) % size);
+    map<string, data::NamedAttrMap> attr_maps;
+
+    data::TreeBatch full_batch;
+    assert(cell::scatter_read_trees(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                    node_rank_map, pop_name, 0, full_batch, attr_maps) == 0);
+    for (const set<string>& tree_mask : tree_masks)
+      {
+        data::TreeBatch masked_batch;
+        assert(cell::scatter_read_trees(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                        node_rank_map, pop_name, 0, masked_batch, attr_maps,
+                                        0, 0, tree_mask) == 0);
+        assert_masked_batch(masked_batch, full_batch, data::tree_field_mask(tree_mask));
+      }
+
+    vector<CELL_IDX_T> selection;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += 3)
+      selection.push_back(gid);
+    data::TreeBatch full_selection;
+    assert(cell::scatter_read_tree_selection(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                             pop_name, 0, selection, full_selection, attr_maps) == 0);
+    for (const set<string>& tree_mask : tree_masks)
+      {
+        data::TreeBatch masked_selection;
+        assert(cell::scatter_read_tree_selection(MPI_COMM_WORLD, file_name, size, vector<string>(),
+                                                 pop_name, 0, selection, masked_selection, attr_maps,
+                                                 tree_mask) == 0);
+        assert_masked_batch(masked_selection, full_selection, data::tree_field_mask(tree_mask));
+      }
+  }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
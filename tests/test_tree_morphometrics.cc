@@ -0,0 +1,272 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_tree_morphometrics.cc
+///
+///  Test for the threaded morphometrics kernels, compared with a
+///  recursive computation over the section graph of each tree.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include "neuroh5_types.hh"
+#include "ngraph.hh"
+#include "tree_batch.hh"
+#include "thread_pool.hh"
+#include "tree_morphometrics.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+using namespace NGraph;
+
+
+struct reference_morphometrics_t
+{
+  vector<float>    section_length;
+  vector<uint16_t> section_branch_order;
+  vector<float>    path_distance;
+  vector<float>    layer_length;
+  vector<float>    bounding_box;
+  float            total_length;
+};
+
+
+float distance (const neurotree_t& tree, size_t a, size_t b)
+{
+  const float dx = get<4>(tree)[b] - get<4>(tree)[a];
+  const float dy = get<5>(tree)[b] - get<5>(tree)[a];
+  const float dz = get<6>(tree)[b] - get<6>(tree)[a];
+  return sqrt(dx*dx + dy*dy + dz*dz);
+}
+
+void path_distance_dfs (const neurotree_t& tree, const Graph& points, Graph::vertex v,
+                        vector<float>& path_distance)
+{
+  const Graph::vertex_set& outs = points.out_neighbors(v);
+  for (Graph::vertex_set::const_iterator it = outs.begin(); it != outs.end(); ++it)
+    {
+      Graph::vertex c = Graph::node(it);
+      path_distance[c] = path_distance[v] + distance(tree, v, c);
+      path_distance_dfs(tree, points, c, path_distance);
+    }
+}
+
+void branch_order_dfs (const Graph& sections, Graph::vertex s, vector<uint16_t>& branch_order)
+{
+  const Graph::vertex_set& outs = sections.out_neighbors(s);
+  for (Graph::vertex_set::const_iterator it = outs.begin(); it != outs.end(); ++it)
+    {
+      Graph::vertex c = Graph::node(it);
+      branch_order[c] = branch_order[s] + ((outs.size() > 1) ? 1 : 0);
+      branch_order_dfs(sections, c, branch_order);
+    }
+}
+
+void reference_morphometrics (const neurotree_t& tree, const size_t num_layers,
+                              reference_morphometrics_t& morph)
+{
+  const deque<SECTION_IDX_T>& src = get<1>(tree);
+  const deque<SECTION_IDX_T>& dst = get<2>(tree);
+  const deque<SECTION_IDX_T>& sections = get<3>(tree);
+  const deque<COORD_T>& x = get<4>(tree);
+  const deque<COORD_T>& y = get<5>(tree);
+  const deque<COORD_T>& z = get<6>(tree);
+  const deque<LAYER_IDX_T>& layers = get<8>(tree);
+  const deque<PARENT_NODE_IDX_T>& parents = get<9>(tree);
+  const deque<SWC_TYPE_T>& swc_types = get<10>(tree);
+  const size_t num_points = x.size();
+
+  Graph points;
+  vector<Graph::vertex> roots;
+  for (size_t k=0; k<num_points; k++)
+    {
+      points.insert_vertex(k);
+      if (parents[k] < 0)
+        roots.push_back(k);
+      else
+        points.insert_edge(parents[k], k);
+    }
+  morph.path_distance.assign(num_points, 0.0);
+  for (Graph::vertex r : roots)
+    {
+      path_distance_dfs(tree, points, r, morph.path_distance);
+    }
+
+  morph.total_length = 0.0;
+  morph.layer_length.assign(num_layers, 0.0);
+  for (size_t k=0; k<num_points; k++)
+    {
+      const float segment_length = (parents[k] < 0) ? 0.0 : distance(tree, parents[k], k);
+      morph.total_length += segment_length;
+      if ((layers[k] >= 0) && ((swc_types[k] == 3) || (swc_types[k] == 4)))
+        morph.layer_length[layers[k]] += segment_length;
+    }
+
+  morph.bounding_box.clear();
+  morph.bounding_box.push_back(*min_element(x.begin(), x.end()));
+  morph.bounding_box.push_back(*min_element(y.begin(), y.end()));
+  morph.bounding_box.push_back(*min_element(z.begin(), z.end()));
+  morph.bounding_box.push_back(*max_element(x.begin(), x.end()));
+  morph.bounding_box.push_back(*max_element(y.begin(), y.end()));
+  morph.bounding_box.push_back(*max_element(z.begin(), z.end()));
+
+  const size_t num_sections = sections[0];
+  morph.section_length.clear();
+  size_t pos = 1;
+  for (size_t s=0; s<num_sections; s++)
+    {
+      const size_t n = sections[pos++];
+      float length = 0.0;
+      for (size_t p=1; p<n; p++)
+        length += distance(tree, sections[pos+p-1], sections[pos+p]);
+      morph.section_length.push_back(length);
+      pos += n;
+    }
+
+  Graph section_graph;
+  set<Graph::vertex> section_roots;
+  for (size_t s=0; s<num_sections; s++)
+    {
+      section_graph.insert_vertex(s);
+      section_roots.insert(s);
+    }
+  for (size_t e=0; e<src.size(); e++)
+    {
+      section_graph.insert_edge(src[e], dst[e]);
+      section_roots.erase(dst[e]);
+    }
+  morph.section_branch_order.assign(num_sections, 0);
+  for (Graph::vertex r : section_roots)
+    {
+      branch_order_dfs(section_graph, r, morph.section_branch_order);
+    }
+}
+
+void assert_close (float a, float b)
+{
+  assert(fabs(a - b) <= 1e-4 * max(1.0f, fabs(b)));
+}
+
+// renumbers the points of a tree so that parents no longer precede
+// their children
+neurotree_t permute_points (const neurotree_t& tree)
+{
+  const size_t n = get<4>(tree).size();
+  vector<size_t> perm(n);
+  for (size_t k=0; k<n; k++) perm[k] = n - 1 - k;
+
+  neurotree_t result = tree;
+  // the section array holds the number of sections and the point count
+  // of each section, followed by its point indices
+  const deque<SECTION_IDX_T>& sections = get<3>(tree);
+  deque<SECTION_IDX_T>& new_sections = get<3>(result);
+  size_t pos = 1;
+  for (size_t s=0; s<sections[0]; s++)
+    {
+      const size_t count = sections[pos++];
+      for (size_t p=0; p<count; p++, pos++)
+        new_sections[pos] = perm[sections[pos]];
+    }
+  for (size_t k=0; k<n; k++)
+    {
+      get<4>(result)[perm[k]] = get<4>(tree)[k];
+      get<5>(result)[perm[k]] = get<5>(tree)[k];
+      get<6>(result)[perm[k]] = get<6>(tree)[k];
+      get<7>(result)[perm[k]] = get<7>(tree)[k];
+      get<8>(result)[perm[k]] = get<8>(tree)[k];
+      get<10>(result)[perm[k]] = get<10>(tree)[k];
+      const PARENT_NODE_IDX_T p = get<9>(tree)[k];
+      get<9>(result)[perm[k]] = (p < 0) ? p : (PARENT_NODE_IDX_T)perm[p];
+    }
+  return result;
+}
+
+
+int main (int argc, char **argv)
+{
+  srand(41);
+
+  data::TreeBatch tree_batch;
+  vector<neurotree_t> trees;
+  for (CELL_IDX_T gid=0; gid<500; gid++)
+    {
+      neurotree_t tree = test::random_tree(gid, 1 + rand() % 200);
+      if (gid % 5 == 0)
+        {
+          tree = permute_points(tree);
+        }
+      trees.push_back(tree);
+      tree_batch.append(tree);
+    }
+  tree_batch.validate();
+
+  LAYER_IDX_T max_layer = -1;
+  for (LAYER_IDX_T layer : tree_batch.layer)
+    max_layer = max(max_layer, layer);
+  const size_t num_layers = max_layer + 1;
+
+  data::thread_pool serial_pool(1), pool(4);
+  cell::tree_morphometrics_t serial_morph, morph;
+  cell::compute_tree_morphometrics(tree_batch, serial_pool, serial_morph);
+  cell::compute_tree_morphometrics(tree_batch, pool, morph);
+
+  // the threaded kernels write the same values as the serial ones
+  assert(morph.index == serial_morph.index);
+  assert(morph.section_ptr == serial_morph.section_ptr);
+  assert(morph.point_ptr == serial_morph.point_ptr);
+  assert(morph.section_length == serial_morph.section_length);
+  assert(morph.section_branch_order == serial_morph.section_branch_order);
+  assert(morph.path_distance == serial_morph.path_distance);
+  assert(morph.layer_length == serial_morph.layer_length);
+  assert(morph.bounding_box == serial_morph.bounding_box);
+  assert(morph.total_length == serial_morph.total_length);
+  assert(morph.num_layers == num_layers);
+
+  // and agree with the recursive computation
+  map<string, map<CELL_IDX_T, deque<float> > > float_values;
+  map<string, map<CELL_IDX_T, deque<uint16_t> > > uint16_values;
+  morph.append_attr_maps(float_values, uint16_values);
+  for (size_t i=0; i<trees.size(); i++)
+    {
+      const CELL_IDX_T gid = get<0>(trees[i]);
+      assert(morph.index[i] == gid);
+
+      reference_morphometrics_t ref;
+      reference_morphometrics(trees[i], num_layers, ref);
+
+      const deque<float>& section_length = float_values[cell::SECTION_LENGTH][gid];
+      const deque<uint16_t>& branch_order = uint16_values[cell::SECTION_BRANCH_ORDER][gid];
+      const deque<float>& path_distance = float_values[cell::PATH_DISTANCE][gid];
+      const deque<float>& layer_length = float_values[cell::LAYER_LENGTH][gid];
+      const deque<float>& bounding_box = float_values[cell::BOUNDING_BOX][gid];
+      const deque<float>& total_length = float_values[cell::TOTAL_LENGTH][gid];
+
+      assert(section_length.size() == ref.section_length.size());
+      for (size_t s=0; s<section_length.size(); s++)
+        assert_close(section_length[s], ref.section_length[s]);
+      assert(branch_order.size() == ref.section_branch_order.size());
+      assert(equal(branch_order.begin(), branch_order.end(), ref.section_branch_order.begin()));
+      assert(path_distance.size() == ref.path_distance.size());
+      for (size_t k=0; k<path_distance.size(); k++)
+        assert_close(path_distance[k], ref.path_distance[k]);
+      assert(layer_length.size() == num_layers);
+      for (size_t l=0; l<num_layers; l++)
+        assert_close(layer_length[l], ref.layer_length[l]);
+      assert(equal(bounding_box.begin(), bounding_box.end(), ref.bounding_box.begin()));
+      assert(total_length.size() == 1);
+      assert_close(total_length[0], ref.total_length);
+    }
+
+  return 0;
+}
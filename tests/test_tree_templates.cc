@@ -0,0 +1,240 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_tree_templates.cc
+///
+///  Test for morphology templates: a file whose cells refer to shared
+///  template trees must read back the same as a file that stores a
+///  translated copy of the template for each cell.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <forward_list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "tree_batch.hh"
+#include "tree_template_set.hh"
+#include "append_tree.hh"
+#include "read_tree.hh"
+#include "scatter_read_tree.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const CELL_IDX_T num_templates = 3;
+
+neurotree_t gid_tree (const CELL_IDX_T gid, const size_t seed)
+{
+  srand(seed + gid);
+  return test::random_tree(gid, 1 + rand() % 80);
+}
+
+// cells with gid % 4 == 0 store a tree, cells with gid % 4 == 1 or 2
+// refer to a template, and every tenth cell does both
+bool has_stored_tree (const CELL_IDX_T gid) { return (gid % 4 == 0) || (gid % 10 == 1); }
+bool has_template (const CELL_IDX_T gid) { return (gid % 4 == 1) || (gid % 4 == 2); }
+CELL_IDX_T template_of (const CELL_IDX_T gid) { return gid % num_templates; }
+COORD_T offset_of (const CELL_IDX_T gid, const int axis) { return 0.25 * gid * (axis - 1); }
+
+// the tree a cell is expected to have
+neurotree_t cell_tree (const CELL_IDX_T gid)
+{
+  if (has_stored_tree(gid))
+    {
+      return gid_tree(gid, 2000);
+    }
+  neurotree_t tree = gid_tree(template_of(gid), 5000);
+  get<0>(tree) = gid;
+  for (COORD_T& x : get<4>(tree)) x += offset_of(gid, 0);
+  for (COORD_T& y : get<5>(tree)) y += offset_of(gid, 1);
+  for (COORD_T& z : get<6>(tree)) z += offset_of(gid, 2);
+  return tree;
+}
+
+void batch_trees (const data::TreeBatch& tree_batch, map<CELL_IDX_T, neurotree_t>& trees)
+{
+  tree_batch.validate();
+  for (size_t i = 0; i < tree_batch.size(); i++)
+    {
+      assert(trees.find(tree_batch.index[i]) == trees.end());
+      trees[tree_batch.index[i]] = tree_batch.tree(i);
+    }
+}
+
+void assert_same_trees (const map<CELL_IDX_T, neurotree_t>& a, const map<CELL_IDX_T, neurotree_t>& b)
+{
+  assert(a.size() == b.size());
+  for (auto const& it : a)
+    {
+      auto b_it = b.find(it.first);
+      assert(b_it != b.end());
+      test::assert_same_tree(it.second, b_it->second);
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string copy_file_name = "test_tree_templates_copy.h5";
+  const string template_file_name = "test_tree_templates_ref.h5";
+  const string pop_name = "GC";
+  const CELL_IDX_T num_cells = 200;
+
+  pop_range_map_t pop_ranges;
+  for (const string& file_name : { copy_file_name, template_file_name })
+    {
+      test::create_test_file(MPI_COMM_WORLD, file_name,
+                             vector< pair<string,size_t> >(1, make_pair(pop_name, (size_t)num_cells)),
+                             set< pair<pop_t,pop_t> >(), pop_ranges);
+    }
+
+  // one file stores a copy of each tree, the other stores the
+  // templates once and a reference per cell
+  {
+    forward_list<neurotree_t> copy_list, stored_list, template_list;
+    data::TreeTemplateSet template_refs;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += size)
+      {
+        if (has_stored_tree(gid))
+          {
+            stored_list.push_front(cell_tree(gid));
+          }
+        if (has_template(gid))
+          {
+            template_refs.append_ref(gid, template_of(gid), offset_of(gid, 0),
+                                     offset_of(gid, 1), offset_of(gid, 2));
+          }
+        if (has_stored_tree(gid) || has_template(gid))
+          {
+            copy_list.push_front(cell_tree(gid));
+          }
+      }
+    if (rank == 0)
+      {
+        for (CELL_IDX_T t = 0; t < num_templates; t++)
+          {
+            template_list.push_front(gid_tree(t, 5000));
+          }
+      }
+
+    assert(cell::append_trees(MPI_COMM_WORLD, copy_file_name, pop_name, 0, copy_list, size) >= 0);
+    assert(cell::append_trees(MPI_COMM_WORLD, template_file_name, pop_name, 0, stored_list, size) >= 0);
+    assert(cell::append_tree_templates(MPI_COMM_WORLD, template_file_name, pop_name,
+                                       template_list, size) >= 0);
+    assert(cell::append_tree_template_index(MPI_COMM_WORLD, template_file_name, pop_name, 0,
+                                            template_refs, size) >= 0);
+  }
+
+  // full read; the files do not assign the same trees to a rank, so
+  // each rank reads the whole population
+  {
+    map<CELL_IDX_T, neurotree_t> copy_trees, template_trees;
+    forward_list<neurotree_t> copy_list, template_list;
+    assert(cell::read_trees(MPI_COMM_SELF, copy_file_name, pop_name, 0, copy_list) == 0);
+    assert(cell::read_trees(MPI_COMM_SELF, template_file_name, pop_name, 0, template_list) == 0);
+    for (const neurotree_t& tree : copy_list) copy_trees[get<0>(tree)] = tree;
+    for (const neurotree_t& tree : template_list) template_trees[get<0>(tree)] = tree;
+    assert_same_trees(template_trees, copy_trees);
+
+    size_t num_expected = 0;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        if (has_stored_tree(gid) || has_template(gid))
+          {
+            num_expected++;
+            test::assert_same_tree(template_trees[gid], cell_tree(gid));
+          }
+      }
+    assert(template_trees.size() == num_expected);
+
+    // the templates are read once, without being expanded
+    data::TreeBatch stored_batch;
+    data::TreeTemplateSet template_set;
+    assert(cell::read_trees(MPI_COMM_SELF, template_file_name, pop_name, 0,
+                            stored_batch, template_set) == 0);
+    assert(template_set.templates.size() <= (size_t)num_templates);
+    for (size_t i = 0; i < template_set.size(); i++)
+      {
+        assert(has_template(template_set.index[i]));
+        assert(template_set.template_index[i] == template_of(template_set.index[i]));
+      }
+    for (size_t i = 0; i < stored_batch.size(); i++)
+      {
+        assert(has_stored_tree(stored_batch.index[i]));
+      }
+
+    vector<CELL_IDX_T> tree_index;
+    assert(cell::read_tree_index(MPI_COMM_SELF, template_file_name, pop_name, 0, tree_index) == 0);
+    assert(tree_index.size() == num_expected);
+    for (CELL_IDX_T gid : tree_index)
+      {
+        assert(copy_trees.find(gid) != copy_trees.end());
+      }
+  }
+
+  // selection read
+  {
+    vector<CELL_IDX_T> selection;
+    for (CELL_IDX_T gid = rank; gid < num_cells; gid += 3 * size)
+      {
+        selection.push_back(gid);
+      }
+    data::TreeBatch copy_batch, template_batch;
+    assert(cell::read_tree_selection(MPI_COMM_WORLD, copy_file_name, pop_name, 0,
+                                     copy_batch, selection) == 0);
+    assert(cell::read_tree_selection(MPI_COMM_WORLD, template_file_name, pop_name, 0,
+                                     template_batch, selection) == 0);
+    map<CELL_IDX_T, neurotree_t> copy_trees, template_trees;
+    batch_trees(copy_batch, copy_trees);
+    batch_trees(template_batch, template_trees);
+    assert_same_trees(template_trees, copy_trees);
+  }
+
+  // scattered read: templates are expanded on the destination ranks
+  {
+    node_rank_map_t node_rank_map;
+    for (CELL_IDX_T gid = 0; gid < num_cells; gid++)
+      {
+        node_rank_map[gid].insert((gid / 3) % size);
+      }
+    map<string, data::NamedAttrMap> attr_maps;
+    data::TreeBatch copy_batch, template_batch;
+    assert(cell::scatter_read_trees(MPI_COMM_WORLD, copy_file_name, size, vector<string>(),
+                                    node_rank_map, pop_name, 0, copy_batch, attr_maps) == 0);
+    assert(cell::scatter_read_trees(MPI_COMM_WORLD, template_file_name, size, vector<string>(),
+                                    node_rank_map, pop_name, 0, template_batch, attr_maps) == 0);
+    map<CELL_IDX_T, neurotree_t> copy_trees, template_trees;
+    batch_trees(copy_batch, copy_trees);
+    batch_trees(template_batch, template_trees);
+    assert_same_trees(template_trees, copy_trees);
+    for (auto const& it : template_trees)
+      {
+        assert((int)((it.first / 3) % size) == rank);
+      }
+  }
+
+  test::remove_test_file(MPI_COMM_WORLD, copy_file_name);
+  test::remove_test_file(MPI_COMM_WORLD, template_file_name);
+
+  MPI_Finalize();
+  return 0;
+}
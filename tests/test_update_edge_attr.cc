@@ -0,0 +1,170 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_update_edge_attr.cc
+///
+///  Test for update_edge_attributes: an existing attribute of a
+///  projection appended in two parts is overwritten and a new attribute
+///  is added, and both are read back with the unchanged edges.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "update_edge_attributes.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+const NODE_IDX_T num_src = 250, num_dst = 150;
+
+float updated_weight (const float weight) { return 2.0f * weight + 1.0f; }
+float edge_delay (const NODE_IDX_T src, const NODE_IDX_T dst) { return 0.5f * src + dst; }
+
+// reads the projection A -> B with the Synapses namespace, and the
+// positions of its float attributes
+edge_map_t read_edges (MPI_Comm comm, const string& file_name, vector<string>& float_names)
+{
+  int size;
+  MPI_Comm_size(comm, &size);
+  node_rank_map_t node_rank_map;
+  for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+    {
+      node_rank_map[n].insert(n % size);
+    }
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+  vector<edge_map_t> prj_vector;
+  vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+  size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+  assert(graph::scatter_read_graph(comm, EdgeMapDst, file_name, size,
+                                   vector<string>(1, "Synapses"), prj_names, node_rank_map,
+                                   prj_vector, edge_attr_names_vector,
+                                   local_num_nodes, total_num_nodes,
+                                   local_num_edges, total_num_edges) >= 0);
+  assert(prj_vector.size() == 1);
+  float_names = edge_attr_names_vector[0]["Synapses"][data::AttrVal::attr_index_float];
+  return prj_vector[0];
+}
+
+size_t name_position (const vector<string>& names, const string& name)
+{
+  auto it = find(names.begin(), names.end(), name);
+  assert(it != names.end());
+  return it - names.begin();
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_update_edge_attr.h5";
+
+  // the projection is appended in two parts, so that destinations have
+  // edges in two ranges of the file
+  srand(37);
+  edge_map_t edges, part;
+  test::random_edge_map(0, num_src, num_src, num_dst, 5, edges);
+  test::random_edge_map(0, num_src, num_src, num_dst, 5, part);
+
+  // the file is written and updated by rank 0 alone and read by all
+  // ranks
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_src));
+      populations.push_back(make_pair("B", (size_t)num_dst));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+      map<string, pair<size_t, data::AttrIndex> > edge_attr_index;
+      test::test_edge_attr_index(edge_attr_index);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, edges, 16) >= 0);
+      assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B", edge_attr_index, part, 16) >= 0);
+
+      // the edges read back are updated in place: Weight is
+      // overwritten and Delay is added to the Synapses namespace
+      vector<string> float_names;
+      edge_map_t file_edges = read_edges(MPI_COMM_SELF, file_name, float_names);
+      const size_t weight_pos = name_position(float_names, "Weight");
+      data::AttrSet synapse_set;
+      synapse_set.add<float>("Weight");
+      synapse_set.add<float>("Delay");
+      const data::AttrIndex synapse_attrs(synapse_set);
+      map<string, pair<size_t, data::AttrIndex> > update_attr_index;
+      update_attr_index["Synapses"] = make_pair((size_t)0, synapse_attrs);
+      edge_map_t update_edges;
+      for (auto const& it : file_edges)
+        {
+          const vector<NODE_IDX_T>& srcs = get<0>(it.second);
+          const vector<float>& weights = get<1>(it.second)[0].float_values[weight_pos];
+          vector<float> new_weights, delays;
+          for (size_t e = 0; e < srcs.size(); e++)
+            {
+              new_weights.push_back(updated_weight(weights[e]));
+              delays.push_back(edge_delay(srcs[e], it.first));
+            }
+          vector<data::AttrVal> edge_attr_values(1);
+          edge_attr_values[0].resize<float>(2);
+          edge_attr_values[0].insert(new_weights, synapse_attrs.attr_index<float>("Weight"));
+          edge_attr_values[0].insert(delays, synapse_attrs.attr_index<float>("Delay"));
+          update_edges[it.first] = make_tuple(srcs, edge_attr_values);
+        }
+      assert(graph::update_edge_attributes(MPI_COMM_SELF, file_name, "A", "B",
+                                           update_attr_index, update_edges, 16) >= 0);
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+  test::merge_edge_maps(edges, part);
+
+  // the edges are read with the updated weights, the new delays and
+  // the unchanged types
+  vector<string> float_names;
+  const edge_map_t edge_map = read_edges(MPI_COMM_WORLD, file_name, float_names);
+  assert(float_names.size() == 2);
+  const size_t weight_pos = name_position(float_names, "Weight");
+  const size_t delay_pos = name_position(float_names, "Delay");
+  edge_map_t expected_edges;
+  for (auto const& it : test::rank_edges(edges, rank, size))
+    {
+      const vector<NODE_IDX_T>& srcs = get<0>(it.second);
+      const data::AttrVal& written = get<1>(it.second)[0];
+      vector<data::AttrVal> edge_attr_values(1);
+      edge_attr_values[0].resize<float>(2);
+      edge_attr_values[0].resize<uint8_t>(1);
+      for (size_t e = 0; e < srcs.size(); e++)
+        {
+          edge_attr_values[0].float_values[weight_pos].push_back(updated_weight(written.float_values[0][e]));
+          edge_attr_values[0].float_values[delay_pos].push_back(edge_delay(srcs[e], it.first));
+        }
+      edge_attr_values[0].uint8_values[0] = written.uint8_values[0];
+      expected_edges[it.first] = make_tuple(srcs, edge_attr_values);
+    }
+  test::assert_same_edges(edge_map, expected_edges);
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}
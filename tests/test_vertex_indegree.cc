@@ -0,0 +1,190 @@
+// -*- mode: c++; tab-width: 4; indent-tabs-mode: nil; c-basic-offset: 2 -*-
+//==============================================================================
+///  @file test_vertex_indegree.cc
+///
+///  Test for the streamed in-degree metrics of a projection that was
+///  appended in several parts, so that destinations occur in several
+///  blocks, compared with the degrees of the edges read with
+///  scatter_read_graph.
+///
+///  Copyright (C) 2016-2022 Project NeuroH5.
+//==============================================================================
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#undef NDEBUG
+#include <cassert>
+
+#include <mpi.h>
+#include <hdf5.h>
+
+#include "neuroh5_types.hh"
+#include "append_graph.hh"
+#include "scatter_read_graph.hh"
+#include "vertex_degree.hh"
+#include "compute_vertex_metrics.hh"
+#include "path_names.hh"
+#include "test_fixture.hh"
+
+using namespace std;
+using namespace neuroh5;
+
+
+// reads the node indices and values of a vertex metric
+template <class T>
+void read_vertex_metric (const string& file_name, const string& attr_name, const hid_t mtype,
+                         map<NODE_IDX_T, T>& values)
+{
+  hid_t file = H5Fopen(file_name.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+  assert(file >= 0);
+  const string path = hdf5::node_attribute_path("Vertex Metrics", attr_name);
+  hid_t index_dset = H5Dopen2(file, (path + "/" + hdf5::NODE_INDEX).c_str(), H5P_DEFAULT);
+  hid_t value_dset = H5Dopen2(file, (path + "/" + hdf5::ATTR_VAL).c_str(), H5P_DEFAULT);
+  assert((index_dset >= 0) && (value_dset >= 0));
+  hid_t space = H5Dget_space(index_dset);
+  const size_t n = H5Sget_simple_extent_npoints(space);
+  assert(H5Sclose(space) >= 0);
+  vector<NODE_IDX_T> index(n);
+  vector<T> value(n);
+  if (n > 0)
+    {
+      assert(H5Dread(index_dset, H5T_NATIVE_UINT32, H5S_ALL, H5S_ALL, H5P_DEFAULT, index.data()) >= 0);
+      assert(H5Dread(value_dset, mtype, H5S_ALL, H5S_ALL, H5P_DEFAULT, value.data()) >= 0);
+    }
+  assert(H5Dclose(index_dset) >= 0);
+  assert(H5Dclose(value_dset) >= 0);
+  assert(H5Fclose(file) >= 0);
+  values.clear();
+  for (size_t i = 0; i < n; i++)
+    {
+      assert(values.count(index[i]) == 0);
+      values[index[i]] = value[i];
+    }
+}
+
+
+int main (int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  int rank, size;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+  const string file_name = "test_vertex_indegree.h5";
+  const NODE_IDX_T num_src = 300, num_dst = 200;
+  vector< pair<string, string> > prj_names;
+  prj_names.push_back(make_pair("A", "B"));
+
+  // the projection is appended in three parts with overlapping
+  // destinations, and repeated sources within and across the parts
+  if (rank == 0)
+    {
+      pop_range_map_t pop_ranges;
+      vector< pair<string,size_t> > populations;
+      populations.push_back(make_pair("A", (size_t)num_src));
+      populations.push_back(make_pair("B", (size_t)num_dst));
+      test::create_test_file(MPI_COMM_SELF, file_name, populations,
+                             set< pair<pop_t,pop_t> >({ make_pair(0, 1) }), pop_ranges);
+      srand(53);
+      for (size_t part = 0; part < 3; part++)
+        {
+          edge_map_t edge_map;
+          for (NODE_IDX_T d = 0; d < num_dst; d++)
+            {
+              if ((d + part) % 3 == 0)
+                continue;
+              vector<NODE_IDX_T> srcs;
+              const size_t n = 1 + rand() % 8;
+              for (size_t e = 0; e < n; e++)
+                srcs.push_back((d + 17 * (rand() % 6)) % num_src);
+              edge_map[num_src + d] = make_tuple(srcs, vector<data::AttrVal>());
+            }
+          assert(graph::append_graph(MPI_COMM_SELF, 1, file_name, "A", "B",
+                                     map<string, pair<size_t, data::AttrIndex> >(), edge_map, 16) >= 0);
+        }
+    }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // the degrees of the edges read by destination
+  vector< map<NODE_IDX_T, size_t> > degree_maps, unique_degree_maps;
+  {
+    node_rank_map_t node_rank_map;
+    for (NODE_IDX_T n = 0; n < num_src + num_dst; n++)
+      {
+        node_rank_map[n].insert(n % size);
+      }
+    vector<edge_map_t> prj_vector;
+    vector< map<string, vector< vector<string> > > > edge_attr_names_vector;
+    size_t local_num_nodes = 0, total_num_nodes = 0, local_num_edges = 0, total_num_edges = 0;
+    assert(graph::scatter_read_graph(MPI_COMM_WORLD, EdgeMapDst, file_name, size, vector<string>(),
+                                     prj_names, node_rank_map, prj_vector, edge_attr_names_vector,
+                                     local_num_nodes, total_num_nodes,
+                                     local_num_edges, total_num_edges) >= 0);
+    graph::vertex_degree(prj_vector, false, degree_maps);
+    graph::vertex_degree(prj_vector, true, unique_degree_maps);
+  }
+  assert((degree_maps.size() == 1) && (unique_degree_maps.size() == 1));
+  map<NODE_IDX_T, size_t>& degree_map = degree_maps[0];
+  map<NODE_IDX_T, size_t>& unique_degree_map = unique_degree_maps[0];
+  size_t num_unique_less = 0;
+  for (auto const& it : degree_map)
+    {
+      num_unique_less += (unique_degree_map[it.first] < it.second) ? 1 : 0;
+    }
+  assert(num_unique_less > 0);
+
+  assert(graph::compute_vertex_indegree(MPI_COMM_WORLD, file_name, prj_names, size) >= 0);
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // each destination is written once, by rank dst % size, with the
+  // degree summed over all of its blocks and normalized by the sum of
+  // the degrees written by that rank
+  map<NODE_IDX_T, uint64_t> indegree, unique_indegree;
+  map<NODE_IDX_T, float> norm_indegree, norm_unique_indegree;
+  read_vertex_metric(file_name, "Indegree A -> B", H5T_NATIVE_UINT64, indegree);
+  read_vertex_metric(file_name, "Unique indegree A -> B", H5T_NATIVE_UINT64, unique_indegree);
+  read_vertex_metric(file_name, "Norm indegree A -> B", H5T_NATIVE_FLOAT, norm_indegree);
+  read_vertex_metric(file_name, "Norm unique indegree A -> B", H5T_NATIVE_FLOAT, norm_unique_indegree);
+
+  for (const pair< map<NODE_IDX_T, size_t>*, map<NODE_IDX_T, uint64_t>* >& maps :
+         { make_pair(&degree_map, &indegree), make_pair(&unique_degree_map, &unique_indegree) })
+    {
+      size_t num_local = 0;
+      for (auto const& it : *maps.first)
+        {
+          assert((*maps.second)[it.first] == it.second);
+          num_local++;
+        }
+      MPI_Allreduce(MPI_IN_PLACE, &num_local, 1, MPI_SIZE_T, MPI_SUM, MPI_COMM_WORLD);
+      assert(maps.second->size() == num_local);
+    }
+
+  for (const pair< map<NODE_IDX_T, uint64_t>*, map<NODE_IDX_T, float>* >& maps :
+         { make_pair(&indegree, &norm_indegree), make_pair(&unique_indegree, &norm_unique_indegree) })
+    {
+      vector<uint64_t> rank_sums(size, 0);
+      for (auto const& it : *maps.first)
+        {
+          rank_sums[it.first % size] += it.second;
+        }
+      assert(maps.second->size() == maps.first->size());
+      for (auto const& it : *maps.first)
+        {
+          const float norm = (float)it.second / (float)rank_sums[it.first % size];
+          assert(fabs((*maps.second)[it.first] - norm) <= 1e-6 * norm);
+        }
+    }
+
+  test::remove_test_file(MPI_COMM_WORLD, file_name);
+
+  MPI_Finalize();
+  return 0;
+}